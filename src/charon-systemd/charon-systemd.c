@@ -38,6 +38,8 @@
 #include <utils/backtrace.h>
 #include <threading/thread.h>
 #include <threading/rwlock.h>
+#include <threading/mutex.h>
+#include <threading/condvar.h>
 
 /**
  * Default user and group
@@ -73,6 +75,53 @@ static void dbg_stderr(debug_t group, level_t level, char *fmt, ...)
 }
 
 typedef struct journal_logger_t journal_logger_t;
+typedef struct journal_entry_t journal_entry_t;
+
+/**
+ * A buffered log message, with structured fields captured at log time
+ */
+struct journal_entry_t {
+
+	/**
+	 * Hash of the format string, used as message ID
+	 */
+	u_int32_t hash;
+
+	/**
+	 * Journal priority derived from the loglevel
+	 */
+	int priority;
+
+	/**
+	 * Debug group
+	 */
+	debug_t group;
+
+	/**
+	 * Loglevel of the message
+	 */
+	level_t level;
+
+	/**
+	 * Thread that logged the message
+	 */
+	int thread;
+
+	/**
+	 * IKE_SA_UNIQUE_ID field, empty string if not associated to an IKE_SA
+	 */
+	char unique[64];
+
+	/**
+	 * IKE_SA_NAME field, empty string if not available
+	 */
+	char name[256];
+
+	/**
+	 * Formatted message text
+	 */
+	char *msg;
+};
 
 /**
  * Logger implementation using systemd-journal
@@ -93,8 +142,154 @@ struct journal_logger_t {
 	 * Lock for levels
 	 */
 	rwlock_t *lock;
+
+	/**
+	 * Ring of buffered messages not yet passed to the journal
+	 */
+	journal_entry_t **ring;
+
+	/**
+	 * Number of slots in ring
+	 */
+	u_int size;
+
+	/**
+	 * Index of the oldest buffered message
+	 */
+	u_int head;
+
+	/**
+	 * Number of messages currently buffered
+	 */
+	u_int count;
+
+	/**
+	 * Messages dropped since the writer drained the ring last
+	 */
+	u_int dropped;
+
+	/**
+	 * TRUE to shut the writer thread down
+	 */
+	bool stop;
+
+	/**
+	 * Mutex protecting the ring
+	 */
+	mutex_t *mutex;
+
+	/**
+	 * Condvar the writer thread waits on for new messages
+	 */
+	condvar_t *condvar;
+
+	/**
+	 * Writer thread draining the ring
+	 */
+	thread_t *writer;
 };
 
+/**
+ * Destroy a buffered journal entry
+ */
+static void journal_entry_destroy(journal_entry_t *entry)
+{
+	free(entry->msg);
+	free(entry);
+}
+
+/**
+ * Pass a single coalesced entry to the journal
+ */
+static void journal_entry_send(journal_entry_t *entry, u_int repeated)
+{
+	char repeats[32] = "";
+
+	if (repeated)
+	{
+		snprintf(repeats, sizeof(repeats), "REPEATED=%u", repeated);
+	}
+	sd_journal_send(
+		"MESSAGE=%s", entry->msg,
+		"MESSAGE_ID=57d2708c-d607-43bd-8c39-66bf%.8x", entry->hash,
+		"PRIORITY=%d", entry->priority,
+		"GROUP=%N", debug_names, entry->group,
+		"LEVEL=%d", entry->level,
+		"THREAD=%d", entry->thread,
+		entry->unique[0] ? entry->unique : NULL,
+		entry->name[0] ? entry->name : NULL,
+		repeats[0] ? repeats : NULL,
+		NULL);
+}
+
+/**
+ * Writer thread, drains the ring batch-wise and coalesces repeats
+ */
+static void* journal_write(journal_logger_t *this)
+{
+	while (TRUE)
+	{
+		journal_entry_t **batch, *entry, *pending = NULL;
+		u_int i, count, dropped, repeated = 0;
+
+		this->mutex->lock(this->mutex);
+		while (!this->count && !this->stop)
+		{
+			this->condvar->wait(this->condvar, this->mutex);
+		}
+		if (!this->count)
+		{	/* stopped and fully drained */
+			this->mutex->unlock(this->mutex);
+			break;
+		}
+		count = this->count;
+		batch = malloc(count * sizeof(journal_entry_t*));
+		for (i = 0; i < count; i++)
+		{
+			batch[i] = this->ring[(this->head + i) % this->size];
+		}
+		this->head = (this->head + count) % this->size;
+		this->count = 0;
+		dropped = this->dropped;
+		this->dropped = 0;
+		this->mutex->unlock(this->mutex);
+
+		for (i = 0; i < count; i++)
+		{
+			entry = batch[i];
+			if (pending && entry->hash == pending->hash &&
+				streq(entry->msg, pending->msg))
+			{	/* sample repeated identical messages within the batch */
+				repeated++;
+				journal_entry_destroy(entry);
+				continue;
+			}
+			if (pending)
+			{
+				journal_entry_send(pending, repeated);
+				journal_entry_destroy(pending);
+			}
+			pending = entry;
+			repeated = 0;
+		}
+		if (pending)
+		{
+			journal_entry_send(pending, repeated);
+			journal_entry_destroy(pending);
+		}
+		free(batch);
+
+		if (dropped)
+		{
+			sd_journal_send(
+				"MESSAGE=journal buffer full, %u messages dropped", dropped,
+				"PRIORITY=%d", LOG_WARNING,
+				NULL);
+		}
+	}
+	return NULL;
+}
+
 METHOD(logger_t, vlog, void,
 	journal_logger_t *this, debug_t group, level_t level, int thread,
 	ike_sa_t *ike_sa, const char *fmt, va_list args)
@@ -117,42 +312,51 @@ METHOD(logger_t, vlog, void,
 	}
 	if (len > 0)
 	{
-		char unique[64] = "", name[256] = "";
-		int priority;
+		journal_entry_t *entry;
+
+		INIT(entry,
+			.hash = chunk_hash_static(chunk_from_str((char*)fmt)),
+			.group = group,
+			.level = level,
+			.thread = thread,
+			.msg = msg == buf ? strdup(msg) : msg,
+		);
+		msg = buf;
 
 		if (ike_sa)
 		{
-			snprintf(unique, sizeof(unique), "IKE_SA_UNIQUE_ID=%u",
+			snprintf(entry->unique, sizeof(entry->unique), "IKE_SA_UNIQUE_ID=%u",
 					 ike_sa->get_unique_id(ike_sa));
 			if (ike_sa->get_peer_cfg(ike_sa))
 			{
-				snprintf(name, sizeof(name), "IKE_SA_NAME=%s",
+				snprintf(entry->name, sizeof(entry->name), "IKE_SA_NAME=%s",
 						 ike_sa->get_name(ike_sa));
 			}
 		}
 		switch (level)
 		{
 			case LEVEL_AUDIT:
-				priority = LOG_NOTICE;
+				entry->priority = LOG_NOTICE;
 				break;
 			case LEVEL_CTRL:
-				priority = LOG_INFO;
+				entry->priority = LOG_INFO;
 				break;
 			default:
-				priority = LOG_DEBUG;
+				entry->priority = LOG_DEBUG;
 				break;
 		}
-		sd_journal_send(
-			"MESSAGE=%s", msg,
-			"MESSAGE_ID=57d2708c-d607-43bd-8c39-66bf%.8x",
-				chunk_hash_static(chunk_from_str((char*)fmt)),
-			"PRIORITY=%d", priority,
-			"GROUP=%N", debug_names, group,
-			"LEVEL=%d", level,
-			"THREAD=%d", thread,
-			unique[0] ? unique : NULL,
-			name[0] ? name : NULL,
-			NULL);
+		this->mutex->lock(this->mutex);
+		if (this->count == this->size)
+		{	/* never block the logging thread, account the message instead */
+			this->dropped++;
+			journal_entry_destroy(entry);
+		}
+		else
+		{
+			this->ring[(this->head + this->count++) % this->size] = entry;
+			this->condvar->signal(this->condvar);
+		}
+		this->mutex->unlock(this->mutex);
 	}
 	if (msg != buf)
 	{
@@ -214,7 +418,22 @@ static bool journal_register(void *plugin, plugin_feature_t *feature,
 				.get_level = _get_level,
 			},
 			.lock = rwlock_create(RWLOCK_TYPE_DEFAULT),
+			.size = max(1, lib->settings->get_int(lib->settings,
+								"%s.journal.buffer_size", 1024, lib->ns)),
+			.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+			.condvar = condvar_create(CONDVAR_TYPE_DEFAULT),
 		);
+		this->ring = calloc(this->size, sizeof(journal_entry_t*));
+		this->writer = thread_create((thread_main_t)journal_write, this);
+		if (!this->writer)
+		{
+			this->condvar->destroy(this->condvar);
+			this->mutex->destroy(this->mutex);
+			this->lock->destroy(this->lock);
+			free(this->ring);
+			free(this);
+			return FALSE;
+		}
 
 		journal_reload(&this);
 
@@ -227,7 +446,16 @@ static bool journal_register(void *plugin, plugin_feature_t *feature,
 
 		charon->bus->remove_logger(charon->bus, &this->logger);
 
+		this->mutex->lock(this->mutex);
+		this->stop = TRUE;
+		this->condvar->signal(this->condvar);
+		this->mutex->unlock(this->mutex);
+		this->writer->join(this->writer);
+
+		this->condvar->destroy(this->condvar);
+		this->mutex->destroy(this->mutex);
 		this->lock->destroy(this->lock);
+		free(this->ring);
 		free(this);
 
 		return TRUE;
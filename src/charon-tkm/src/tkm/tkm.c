@@ -90,6 +90,7 @@ bool tkm_init()
 		tkmlib_final();
 		return FALSE;
 	}
+	DBG1(DBG_DMN, "TKM accepts %llu concurrent requests", max_requests);
 
 	INIT(this,
 		.public = {
@@ -19,6 +19,7 @@
 #include <linux/xfrm.h>
 #include <utils/debug.h>
 #include <utils/chunk.h>
+#include <processing/jobs/callback_job.h>
 #include <tkm/constants.h>
 #include <tkm/client.h>
 
@@ -86,7 +87,8 @@ METHOD(kernel_ipsec_t, add_sa, status_t,
 	u_int32_t tfc, lifetime_cfg_t *lifetime, u_int16_t enc_alg, chunk_t enc_key,
 	u_int16_t int_alg, chunk_t int_key, ipsec_mode_t mode,
 	u_int16_t ipcomp, u_int16_t cpi, u_int32_t replay_window,
-	bool initiator, bool encap, bool esn, bool inbound, bool update,
+	bool initiator, bool encap, bool esn, bool hw_offload, bool inbound,
+	bool update,
 	linked_list_t* src_ts, linked_list_t* dst_ts)
 {
 	esa_info_t esa;
@@ -213,24 +215,53 @@ METHOD(kernel_ipsec_t, query_sa, status_t,
 	return NOT_SUPPORTED;
 }
 
+typedef struct {
+	/** id of the ESA context to reset */
+	esa_id_type esa_id;
+} esa_reset_t;
+
+/**
+ * Release the ESA id once the reset request completed
+ */
+static void esa_reset_destroy(esa_reset_t *reset)
+{
+	tkm->idmgr->release_id(tkm->idmgr, TKM_CTX_ESA, reset->esa_id);
+	free(reset);
+}
+
+/**
+ * Reset an ESA context asynchronously, off the exchange critical path
+ */
+static job_requeue_t esa_reset_execute(esa_reset_t *reset)
+{
+	if (ike_esa_reset(reset->esa_id) != TKM_OK)
+	{
+		DBG1(DBG_KNL, "child SA (%llu) deletion failed", reset->esa_id);
+	}
+	return JOB_REQUEUE_NONE;
+}
+
 METHOD(kernel_ipsec_t, del_sa, status_t,
 	private_tkm_kernel_ipsec_t *this, host_t *src, host_t *dst,
 	u_int32_t spi, u_int8_t protocol, u_int16_t cpi, mark_t mark)
 {
 	esa_id_type esa_id;
+	esa_reset_t *reset;
 
 	esa_id = tkm->sad->get_esa_id(tkm->sad, src, dst, spi, protocol);
 	if (esa_id)
 	{
 		DBG1(DBG_KNL, "deleting child SA (esa: %llu, spi: %x)", esa_id,
 			 ntohl(spi));
-		if (ike_esa_reset(esa_id) != TKM_OK)
-		{
-			DBG1(DBG_KNL, "child SA (%llu) deletion failed", esa_id);
-			return FAILED;
-		}
+		/* remove the entry up-front, but issue the TKM round trip from a
+		 * separate job so rekeyings do not stall on the old SA teardown */
 		tkm->sad->remove(tkm->sad, esa_id);
-		tkm->idmgr->release_id(tkm->idmgr, TKM_CTX_ESA, esa_id);
+		INIT(reset,
+			.esa_id = esa_id,
+		);
+		lib->processor->queue_job(lib->processor,
+			(job_t*)callback_job_create((callback_job_cb_t)esa_reset_execute,
+										reset, (void*)esa_reset_destroy, NULL));
 	}
 	return SUCCESS;
 }
@@ -33,6 +33,7 @@
 #include <daemon.h>
 
 #include <library.h>
+#include <settings/settings_watcher.h>
 #include <utils/backtrace.h>
 #include <threading/thread.h>
 
@@ -294,6 +295,7 @@ int main(int argc, char *argv[])
 	struct sigaction action;
 	int group, status = SS_RC_INITIALIZATION_FAILED;
 	struct utsname utsname;
+	settings_watcher_t *watcher = NULL;
 
 	/* logging for library during initialization, as we have no bus yet */
 	dbg = dbg_stderr;
@@ -452,10 +454,17 @@ int main(int argc, char *argv[])
 	/* start daemon (i.e. the threads in the thread-pool) */
 	charon->start(charon);
 
+	/* reload changed config files automatically, if enabled */
+	if (lib->settings->get_bool(lib->settings, "charon.watch_config", FALSE))
+	{
+		watcher = settings_watcher_create(lib->settings, lib->conf);
+	}
+
 	/* main thread goes to run loop */
 	run();
 
 	/* normal termination, cleanup and exit */
+	DESTROY_IF(watcher);
 	unlink_pidfile();
 	status = 0;
 
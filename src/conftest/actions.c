@@ -20,7 +20,6 @@
 #include <processing/jobs/callback_job.h>
 #include <processing/jobs/rekey_ike_sa_job.h>
 #include <processing/jobs/rekey_child_sa_job.h>
-#include <processing/jobs/send_dpd_job.h>
 
 typedef struct private_actions_t private_actions_t;
 
@@ -159,7 +158,7 @@ static job_requeue_t rekey_child(char *config)
 static job_requeue_t liveness(char *config)
 {
 	enumerator_t *enumerator;
-	job_t *job = NULL;
+	ike_sa_id_t *id = NULL;
 	ike_sa_t *ike_sa;
 
 	enumerator = charon->controller->create_ike_sa_enumerator(
@@ -168,16 +167,30 @@ static job_requeue_t liveness(char *config)
 	{
 		if (strcaseeq(config, ike_sa->get_name(ike_sa)))
 		{
-			job = (job_t*)send_dpd_job_create(ike_sa->get_id(ike_sa));
+			id = ike_sa->get_id(ike_sa);
+			id = id->clone(id);
 			break;
 		}
 	}
 	enumerator->destroy(enumerator);
 
-	if (job)
+	if (id)
 	{
 		DBG1(DBG_CFG, "starting liveness check of IKE_SA '%s'", config);
-		lib->processor->queue_job(lib->processor, job);
+		ike_sa = charon->ike_sa_manager->checkout(charon->ike_sa_manager, id);
+		if (ike_sa)
+		{
+			if (ike_sa->send_dpd(ike_sa) == DESTROY_ME)
+			{
+				charon->ike_sa_manager->checkin_and_destroy(
+												charon->ike_sa_manager, ike_sa);
+			}
+			else
+			{
+				charon->ike_sa_manager->checkin(charon->ike_sa_manager, ike_sa);
+			}
+		}
+		id->destroy(id);
 	}
 	else
 	{
@@ -414,7 +414,7 @@ static void load_loggers(file_logger_t *logger)
 		{
 			logger = file_logger_create(section);
 			load_logger_options(logger, section);
-			logger->open(logger, FALSE, FALSE);
+			logger->open(logger, FALSE, FALSE, FALSE);
 			load_log_levels(logger, section);
 			charon->bus->add_logger(charon->bus, &logger->logger);
 			conftest->loggers->insert_last(conftest->loggers, logger);
@@ -464,7 +464,7 @@ int main(int argc, char *argv[])
 
 	logger = file_logger_create("stdout");
 	logger->set_options(logger, NULL, FALSE);
-	logger->open(logger, FALSE, FALSE);
+	logger->open(logger, FALSE, FALSE, FALSE);
 	logger->set_level(logger, DBG_ANY, LEVEL_CTRL);
 	charon->bus->add_logger(charon->bus, &logger->logger);
 	conftest->loggers->insert_last(conftest->loggers, logger);
@@ -0,0 +1,327 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Copyright (C) 2015 revosec AG
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include "hook.h"
+
+#include <stdio.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <encoding/payloads/sa_payload.h>
+
+typedef struct private_bench_t private_bench_t;
+
+/**
+ * Private data of an bench_t object.
+ */
+struct private_bench_t {
+
+	/**
+	 * Implements the hook_t interface.
+	 */
+	hook_t hook;
+
+	/**
+	 * Number of parse/generate/select iterations per message
+	 */
+	int iterations;
+
+	/**
+	 * Allowed regression over the baseline, in percent
+	 */
+	int tolerance;
+
+	/**
+	 * File to write results to, NULL to use the log only
+	 */
+	char *output;
+
+	/**
+	 * Baseline file to compare results against, NULL to skip the gate
+	 */
+	char *baseline;
+
+	/**
+	 * Accumulated parse/generate/select times, in us
+	 */
+	u_int64_t parse_us, generate_us, select_us;
+
+	/**
+	 * Number of timed parse/generate/select runs
+	 */
+	u_int64_t parse_count, generate_count, select_count;
+
+	/**
+	 * Number of established IKE_SAs
+	 */
+	u_int handshakes;
+
+	/**
+	 * Process CPU time when the hook was created, in us
+	 */
+	u_int64_t cpu_start_us;
+
+	/**
+	 * TRUE if a metric regressed over the baseline
+	 */
+	bool failed;
+};
+
+/**
+ * Get the process CPU time (user + system), in us
+ */
+static u_int64_t cpu_time_us()
+{
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+	{
+		return 0;
+	}
+	return (u_int64_t)usage.ru_utime.tv_sec * 1000000 + usage.ru_utime.tv_usec +
+		   (u_int64_t)usage.ru_stime.tv_sec * 1000000 + usage.ru_stime.tv_usec;
+}
+
+/**
+ * Get the time elapsed since start, in us
+ */
+static u_int64_t elapsed_us(timeval_t *start)
+{
+	timeval_t now;
+
+	time_monotonic(&now);
+	timersub(&now, start, &now);
+	return (u_int64_t)now.tv_sec * 1000000 + now.tv_usec;
+}
+
+/**
+ * Measure proposal selection against the received SA payload
+ */
+static void bench_select(private_bench_t *this, ike_sa_t *ike_sa,
+						 message_t *message)
+{
+	enumerator_t *enumerator;
+	payload_t *payload;
+	sa_payload_t *sa_payload = NULL;
+	linked_list_t *proposals;
+	proposal_t *selected;
+	ike_cfg_t *ike_cfg;
+	timeval_t start;
+	int i;
+
+	ike_cfg = ike_sa->get_ike_cfg(ike_sa);
+	if (!ike_cfg)
+	{
+		return;
+	}
+	enumerator = message->create_payload_enumerator(message);
+	while (enumerator->enumerate(enumerator, &payload))
+	{
+		if (payload->get_type(payload) == PLV2_SECURITY_ASSOCIATION)
+		{
+			sa_payload = (sa_payload_t*)payload;
+			break;
+		}
+	}
+	enumerator->destroy(enumerator);
+	if (!sa_payload)
+	{
+		return;
+	}
+	proposals = sa_payload->get_proposals(sa_payload);
+	for (i = 0; i < this->iterations; i++)
+	{
+		time_monotonic(&start);
+		selected = ike_cfg->select_proposal(ike_cfg, proposals, FALSE);
+		this->select_us += elapsed_us(&start);
+		this->select_count++;
+		DESTROY_IF(selected);
+	}
+	proposals->destroy_offset(proposals, offsetof(proposal_t, destroy));
+}
+
+METHOD(listener_t, message, bool,
+	private_bench_t *this, ike_sa_t *ike_sa, message_t *message,
+	bool incoming, bool plain)
+{
+	packet_t *packet, *copy;
+	message_t *parsed;
+	timeval_t start;
+	int i;
+
+	if (!plain || !incoming ||
+		message->get_exchange_type(message) != IKE_SA_INIT)
+	{
+		return TRUE;
+	}
+	/* measure parse/generate throughput on the unencrypted IKE_SA_INIT */
+	packet = message->get_packet(message);
+	for (i = 0; i < this->iterations; i++)
+	{
+		copy = packet->clone(packet);
+		time_monotonic(&start);
+		parsed = message_create_from_packet(copy);
+		if (parsed->parse_header(parsed) != SUCCESS ||
+			parsed->parse_body(parsed, NULL) != SUCCESS)
+		{
+			parsed->destroy(parsed);
+			break;
+		}
+		this->parse_us += elapsed_us(&start);
+		this->parse_count++;
+
+		time_monotonic(&start);
+		if (parsed->generate(parsed, NULL, &copy) == SUCCESS)
+		{
+			this->generate_us += elapsed_us(&start);
+			this->generate_count++;
+			copy->destroy(copy);
+		}
+		parsed->destroy(parsed);
+	}
+	packet->destroy(packet);
+
+	if (message->get_request(message))
+	{
+		bench_select(this, ike_sa, message);
+	}
+	return TRUE;
+}
+
+METHOD(listener_t, ike_updown, bool,
+	private_bench_t *this, ike_sa_t *ike_sa, bool up)
+{
+	if (up)
+	{
+		this->handshakes++;
+	}
+	return TRUE;
+}
+
+/**
+ * Look up a metric in the baseline file
+ */
+static bool find_baseline(private_bench_t *this, char *key, u_int64_t *value)
+{
+	char line[128], name[64];
+	unsigned long long ll;
+	bool found = FALSE;
+	FILE *f;
+
+	f = fopen(this->baseline, "r");
+	if (!f)
+	{
+		DBG1(DBG_CFG, "bench: opening baseline '%s' failed", this->baseline);
+		return FALSE;
+	}
+	while (fgets(line, sizeof(line), f))
+	{
+		if (sscanf(line, "%63[^=]=%llu", name, &ll) == 2 && streq(name, key))
+		{
+			*value = ll;
+			found = TRUE;
+			break;
+		}
+	}
+	fclose(f);
+	return found;
+}
+
+/**
+ * Report a metric, comparing it against the baseline
+ */
+static void report(private_bench_t *this, FILE *out, char *key,
+				   u_int64_t value)
+{
+	u_int64_t base;
+
+	if (out)
+	{
+		fprintf(out, "%s=%llu\n", key, (unsigned long long)value);
+	}
+	DBG1(DBG_CFG, "bench: %s=%llu", key, (unsigned long long)value);
+
+	if (this->baseline && find_baseline(this, key, &base) &&
+		value > base + base * this->tolerance / 100)
+	{
+		DBG1(DBG_CFG, "bench: %s regressed more than %d%% over baseline "
+			 "(%llu > %llu)", key, this->tolerance,
+			 (unsigned long long)value, (unsigned long long)base);
+		this->failed = TRUE;
+	}
+}
+
+METHOD(hook_t, destroy, void,
+	private_bench_t *this)
+{
+	u_int64_t cpu_us;
+	FILE *out = NULL;
+
+	cpu_us = cpu_time_us() - this->cpu_start_us;
+	if (this->output)
+	{
+		out = fopen(this->output, "w");
+		if (!out)
+		{
+			DBG1(DBG_CFG, "bench: opening output '%s' failed", this->output);
+		}
+	}
+	report(this, out, "parse_ns",
+		   this->parse_count ? this->parse_us * 1000 / this->parse_count : 0);
+	report(this, out, "generate_ns",
+		   this->generate_count ?
+				this->generate_us * 1000 / this->generate_count : 0);
+	report(this, out, "select_ns",
+		   this->select_count ?
+				this->select_us * 1000 / this->select_count : 0);
+	report(this, out, "cpu_per_handshake_us",
+		   this->handshakes ? cpu_us / this->handshakes : 0);
+	if (out)
+	{
+		fprintf(out, "result=%s\n", this->failed ? "FAIL" : "PASS");
+		fclose(out);
+	}
+	DBG1(DBG_CFG, "bench: result=%s", this->failed ? "FAIL" : "PASS");
+	free(this);
+}
+
+/**
+ * Create the benchmark hook
+ */
+hook_t *bench_hook_create(char *name)
+{
+	private_bench_t *this;
+
+	INIT(this,
+		.hook = {
+			.listener = {
+				.message = _message,
+				.ike_updown = _ike_updown,
+			},
+			.destroy = _destroy,
+		},
+		.iterations = conftest->test->get_int(conftest->test,
+										"hooks.%s.iterations", 1000, name),
+		.tolerance = conftest->test->get_int(conftest->test,
+										"hooks.%s.tolerance", 10, name),
+		.output = conftest->test->get_str(conftest->test,
+										"hooks.%s.output", NULL, name),
+		.baseline = conftest->test->get_str(conftest->test,
+										"hooks.%s.baseline", NULL, name),
+		.cpu_start_us = cpu_time_us(),
+	);
+
+	return &this->hook;
+}
@@ -20,6 +20,32 @@
 #include <threading/rwlock.h>
 
 typedef struct private_attribute_manager_t private_attribute_manager_t;
+typedef struct snapshot_t snapshot_t;
+
+/**
+ * Immutable, reference counted snapshot of registered providers/handlers.
+ *
+ * Register/unregister swaps the snapshot under the write lock, while
+ * lookups just grab a reference under the read lock and then invoke the
+ * provider/handler callbacks without holding any lock.
+ */
+struct snapshot_t {
+
+	/**
+	 * reference count, last put frees the snapshot
+	 */
+	refcount_t refs;
+
+	/**
+	 * number of registered items
+	 */
+	int count;
+
+	/**
+	 * registered items
+	 */
+	void *items[];
+};
 
 /**
  * private data of attribute_manager
@@ -32,21 +58,144 @@ struct private_attribute_manager_t {
 	attribute_manager_t public;
 
 	/**
-	 * list of registered providers
+	 * current snapshot of registered providers
 	 */
-	linked_list_t *providers;
+	snapshot_t *providers;
 
 	/**
-	 * list of registered handlers
+	 * current snapshot of registered handlers
 	 */
-	linked_list_t *handlers;
+	snapshot_t *handlers;
 
 	/**
-	 * rwlock provider list
+	 * lock to swap and reference snapshots
 	 */
 	rwlock_t *lock;
 };
 
+/**
+ * Create an empty snapshot with space for count items
+ */
+static snapshot_t *snapshot_create(int count)
+{
+	snapshot_t *snapshot;
+
+	snapshot = malloc(sizeof(snapshot_t) + count * sizeof(void*));
+	snapshot->refs = 1;
+	snapshot->count = 0;
+
+	return snapshot;
+}
+
+/**
+ * Release a snapshot reference, freeing it with the last one
+ */
+static void snapshot_put(snapshot_t *snapshot)
+{
+	if (ref_put(&snapshot->refs))
+	{
+		free(snapshot);
+	}
+}
+
+/**
+ * Get a reference to the current snapshot
+ */
+static snapshot_t *snapshot_get(private_attribute_manager_t *this,
+								snapshot_t **slot)
+{
+	snapshot_t *snapshot;
+
+	this->lock->read_lock(this->lock);
+	snapshot = *slot;
+	ref_get(&snapshot->refs);
+	this->lock->unlock(this->lock);
+
+	return snapshot;
+}
+
+/**
+ * Replace the current snapshot by a copy with an item added/removed
+ */
+static void snapshot_mutate(private_attribute_manager_t *this,
+							snapshot_t **slot, void *item, bool add)
+{
+	snapshot_t *old, *new;
+	int i;
+
+	this->lock->write_lock(this->lock);
+	old = *slot;
+	new = snapshot_create(old->count + (add ? 1 : 0));
+	for (i = 0; i < old->count; i++)
+	{
+		if (!add && old->items[i] == item)
+		{	/* remove first match only, as linked_list_t remove did */
+			item = NULL;
+			continue;
+		}
+		new->items[new->count++] = old->items[i];
+	}
+	if (add)
+	{
+		new->items[new->count++] = item;
+	}
+	*slot = new;
+	this->lock->unlock(this->lock);
+
+	snapshot_put(old);
+}
+
+/**
+ * Enumerator over the items of a snapshot
+ */
+typedef struct {
+	/** implements enumerator_t */
+	enumerator_t public;
+	/** enumerated snapshot, reference held */
+	snapshot_t *snapshot;
+	/** current enumeration position */
+	int index;
+} snapshot_enumerator_t;
+
+/**
+ * Enumerate function of snapshot enumerator
+ */
+static bool snapshot_enumerate(snapshot_enumerator_t *this, void **item)
+{
+	if (this->index < this->snapshot->count)
+	{
+		*item = this->snapshot->items[this->index++];
+		return TRUE;
+	}
+	return FALSE;
+}
+
+/**
+ * Destroy function of snapshot enumerator
+ */
+static void snapshot_enumerator_destroy(snapshot_enumerator_t *this)
+{
+	snapshot_put(this->snapshot);
+	free(this);
+}
+
+/**
+ * Create an enumerator over a snapshot, adopting a reference to it
+ */
+static enumerator_t *snapshot_create_enumerator(snapshot_t *snapshot)
+{
+	snapshot_enumerator_t *enumerator;
+
+	INIT(enumerator,
+		.public = {
+			.enumerate = (void*)snapshot_enumerate,
+			.destroy = (void*)snapshot_enumerator_destroy,
+		},
+		.snapshot = snapshot,
+	);
+	return &enumerator->public;
+}
+
 /**
  * Data to pass to enumerator filters
  */
@@ -63,22 +212,18 @@ METHOD(attribute_manager_t, acquire_address, host_t*,
 	private_attribute_manager_t *this, linked_list_t *pools,
 	ike_sa_t *ike_sa, host_t *requested)
 {
-	enumerator_t *enumerator;
+	snapshot_t *snapshot;
 	attribute_provider_t *current;
 	host_t *host = NULL;
+	int i;
 
-	this->lock->read_lock(this->lock);
-	enumerator = this->providers->create_enumerator(this->providers);
-	while (enumerator->enumerate(enumerator, &current))
+	snapshot = snapshot_get(this, &this->providers);
+	for (i = 0; i < snapshot->count && !host; i++)
 	{
+		current = snapshot->items[i];
 		host = current->acquire_address(current, pools, ike_sa, requested);
-		if (host)
-		{
-			break;
-		}
 	}
-	enumerator->destroy(enumerator);
-	this->lock->unlock(this->lock);
+	snapshot_put(snapshot);
 
 	return host;
 }
@@ -87,22 +232,18 @@ METHOD(attribute_manager_t, release_address, bool,
 	private_attribute_manager_t *this, linked_list_t *pools, host_t *address,
 	ike_sa_t *ike_sa)
 {
-	enumerator_t *enumerator;
+	snapshot_t *snapshot;
 	attribute_provider_t *current;
 	bool found = FALSE;
+	int i;
 
-	this->lock->read_lock(this->lock);
-	enumerator = this->providers->create_enumerator(this->providers);
-	while (enumerator->enumerate(enumerator, &current))
+	snapshot = snapshot_get(this, &this->providers);
+	for (i = 0; i < snapshot->count && !found; i++)
 	{
-		if (current->release_address(current, pools, address, ike_sa))
-		{
-			found = TRUE;
-			break;
-		}
+		current = snapshot->items[i];
+		found = current->release_address(current, pools, address, ike_sa);
 	}
-	enumerator->destroy(enumerator);
-	this->lock->unlock(this->lock);
+	snapshot_put(snapshot);
 
 	return found;
 }
@@ -128,28 +269,22 @@ METHOD(attribute_manager_t, create_responder_enumerator, enumerator_t*,
 		.ike_sa = ike_sa,
 		.vips = vips,
 	);
-	this->lock->read_lock(this->lock);
-	return enumerator_create_cleaner(
-				enumerator_create_nested(
-					this->providers->create_enumerator(this->providers),
-					(void*)responder_enum_create, data, free),
-				(void*)this->lock->unlock, this->lock);
+	return enumerator_create_nested(
+				snapshot_create_enumerator(
+									snapshot_get(this, &this->providers)),
+				(void*)responder_enum_create, data, free);
 }
 
 METHOD(attribute_manager_t, add_provider, void,
 	private_attribute_manager_t *this, attribute_provider_t *provider)
 {
-	this->lock->write_lock(this->lock);
-	this->providers->insert_last(this->providers, provider);
-	this->lock->unlock(this->lock);
+	snapshot_mutate(this, &this->providers, provider, TRUE);
 }
 
 METHOD(attribute_manager_t, remove_provider, void,
 	private_attribute_manager_t *this, attribute_provider_t *provider)
 {
-	this->lock->write_lock(this->lock);
-	this->providers->remove(this->providers, provider, NULL);
-	this->lock->unlock(this->lock);
+	snapshot_mutate(this, &this->providers, provider, FALSE);
 }
 
 METHOD(attribute_manager_t, handle, attribute_handler_t*,
@@ -157,36 +292,33 @@ METHOD(attribute_manager_t, handle, attribute_handler_t*,
 	attribute_handler_t *handler, configuration_attribute_type_t type,
 	chunk_t data)
 {
-	enumerator_t *enumerator;
+	snapshot_t *snapshot;
 	attribute_handler_t *current, *handled = NULL;
+	int i;
 
-	this->lock->read_lock(this->lock);
+	snapshot = snapshot_get(this, &this->handlers);
 
 	/* try to find the passed handler */
-	enumerator = this->handlers->create_enumerator(this->handlers);
-	while (enumerator->enumerate(enumerator, &current))
+	for (i = 0; i < snapshot->count && !handled; i++)
 	{
+		current = snapshot->items[i];
 		if (current == handler && current->handle(current, ike_sa, type, data))
 		{
 			handled = current;
-			break;
 		}
 	}
-	enumerator->destroy(enumerator);
 	if (!handled)
 	{	/* handler requesting this attribute not found, try any other */
-		enumerator = this->handlers->create_enumerator(this->handlers);
-		while (enumerator->enumerate(enumerator, &current))
+		for (i = 0; i < snapshot->count && !handled; i++)
 		{
+			current = snapshot->items[i];
 			if (current->handle(current, ike_sa, type, data))
 			{
 				handled = current;
-				break;
 			}
 		}
-		enumerator->destroy(enumerator);
 	}
-	this->lock->unlock(this->lock);
+	snapshot_put(snapshot);
 
 	if (!handled)
 	{
@@ -200,21 +332,21 @@ METHOD(attribute_manager_t, release, void,
 	private_attribute_manager_t *this, attribute_handler_t *handler,
 	ike_sa_t *ike_sa, configuration_attribute_type_t type, chunk_t data)
 {
-	enumerator_t *enumerator;
+	snapshot_t *snapshot;
 	attribute_handler_t *current;
+	int i;
 
-	this->lock->read_lock(this->lock);
-	enumerator = this->handlers->create_enumerator(this->handlers);
-	while (enumerator->enumerate(enumerator, &current))
+	snapshot = snapshot_get(this, &this->handlers);
+	for (i = 0; i < snapshot->count; i++)
 	{
+		current = snapshot->items[i];
 		if (current == handler)
 		{
 			current->release(current, ike_sa, type, data);
 			break;
 		}
 	}
-	enumerator->destroy(enumerator);
-	this->lock->unlock(this->lock);
+	snapshot_put(snapshot);
 }
 
 /**
@@ -223,8 +355,6 @@ METHOD(attribute_manager_t, release, void,
 typedef struct {
 	/** implements enumerator_t */
 	enumerator_t public;
-	/** back ref */
-	private_attribute_manager_t *this;
 	/** currently processing handler */
 	attribute_handler_t *handler;
 	/** outer enumerator over handlers */
@@ -266,7 +396,6 @@ static bool initiator_enumerate(initiator_enumerator_t *this,
  */
 static void initiator_destroy(initiator_enumerator_t *this)
 {
-	this->this->lock->unlock(this->this->lock);
 	this->outer->destroy(this->outer);
 	DESTROY_IF(this->inner);
 	free(this);
@@ -277,17 +406,15 @@ METHOD(attribute_manager_t, create_initiator_enumerator, enumerator_t*,
 {
 	initiator_enumerator_t *enumerator;
 
-	this->lock->read_lock(this->lock);
-
 	INIT(enumerator,
 		.public = {
 			.enumerate = (void*)initiator_enumerate,
 			.destroy = (void*)initiator_destroy,
 		},
-		.this = this,
 		.ike_sa = ike_sa,
 		.vips = vips,
-		.outer = this->handlers->create_enumerator(this->handlers),
+		.outer = snapshot_create_enumerator(
+									snapshot_get(this, &this->handlers)),
 	);
 	return &enumerator->public;
 }
@@ -295,24 +422,20 @@ METHOD(attribute_manager_t, create_initiator_enumerator, enumerator_t*,
 METHOD(attribute_manager_t, add_handler, void,
 	private_attribute_manager_t *this, attribute_handler_t *handler)
 {
-	this->lock->write_lock(this->lock);
-	this->handlers->insert_last(this->handlers, handler);
-	this->lock->unlock(this->lock);
+	snapshot_mutate(this, &this->handlers, handler, TRUE);
 }
 
 METHOD(attribute_manager_t, remove_handler, void,
 	private_attribute_manager_t *this, attribute_handler_t *handler)
 {
-	this->lock->write_lock(this->lock);
-	this->handlers->remove(this->handlers, handler, NULL);
-	this->lock->unlock(this->lock);
+	snapshot_mutate(this, &this->handlers, handler, FALSE);
 }
 
 METHOD(attribute_manager_t, destroy, void,
 	private_attribute_manager_t *this)
 {
-	this->providers->destroy(this->providers);
-	this->handlers->destroy(this->handlers);
+	snapshot_put(this->providers);
+	snapshot_put(this->handlers);
 	this->lock->destroy(this->lock);
 	free(this);
 }
@@ -338,8 +461,8 @@ attribute_manager_t *attribute_manager_create()
 			.remove_handler = _remove_handler,
 			.destroy = _destroy,
 		},
-		.providers = linked_list_create(),
-		.handlers = linked_list_create(),
+		.providers = snapshot_create(0),
+		.handlers = snapshot_create(0),
 		.lock = rwlock_create(RWLOCK_TYPE_DEFAULT),
 	);
 
@@ -22,10 +22,36 @@
 #include <collections/hashtable.h>
 #include <collections/array.h>
 #include <threading/mutex.h>
+#include <threading/spinlock.h>
 
 #define POOL_LIMIT (sizeof(u_int)*8 - 1)
 
+/** number of lock-striped lease table shards */
+#define POOL_SHARDS 8
+
 typedef struct private_mem_pool_t private_mem_pool_t;
+typedef struct pool_shard_t pool_shard_t;
+
+/**
+ * A lock-striped shard of the pool, owning a lease table
+ */
+struct pool_shard_t {
+
+	/**
+	 * lease hashtable [identity => entry] for identities mapped to the shard
+	 */
+	hashtable_t *leases;
+
+	/**
+	 * number of offline leases in this shards lease table
+	 */
+	u_int offline;
+
+	/**
+	 * lock for this shards lease table
+	 */
+	mutex_t *mutex;
+};
 
 /**
  * private data of mem_pool_t
@@ -57,19 +83,19 @@ struct private_mem_pool_t {
 	u_int size;
 
 	/**
-	 * next unused address
+	 * lease table shards
 	 */
-	u_int unused;
+	pool_shard_t shards[POOL_SHARDS];
 
 	/**
-	 * lease hashtable [identity => entry]
+	 * number of fresh offsets handed out in sequence, protected by alloc_lock
 	 */
-	hashtable_t *leases;
+	u_int unused;
 
 	/**
-	 * lock to safely access the pool
+	 * lock protecting the fresh offset counter
 	 */
-	mutex_t *mutex;
+	spinlock_t *alloc_lock;
 };
 
 /**
@@ -136,6 +162,30 @@ static bool id_equals(identification_t *a, identification_t *b)
 	return a->equals(a, b);
 }
 
+/**
+ * Get the shard an identity is mapped to
+ */
+static pool_shard_t *id_shard(private_mem_pool_t *this, identification_t *id)
+{
+	return &this->shards[id_hash(id) % POOL_SHARDS];
+}
+
+/**
+ * Allocate the next fresh offset, in sequential order
+ */
+static u_int alloc_fresh(private_mem_pool_t *this)
+{
+	u_int offset = 0;
+
+	this->alloc_lock->lock(this->alloc_lock);
+	if (this->unused < this->size)
+	{	/* assigned offsets start by 1 */
+		offset = ++this->unused;
+	}
+	this->alloc_lock->unlock(this->alloc_lock);
+	return offset;
+}
+
 /**
  * convert a pool offset to an address
  */
@@ -221,37 +271,38 @@ METHOD(mem_pool_t, get_online, u_int,
 	private_mem_pool_t *this)
 {
 	enumerator_t *enumerator;
+	pool_shard_t *shard;
 	entry_t *entry;
-	u_int count = 0;
+	u_int i, count = 0;
 
-	this->mutex->lock(this->mutex);
-	enumerator = this->leases->create_enumerator(this->leases);
-	while (enumerator->enumerate(enumerator, NULL, &entry))
+	for (i = 0; i < POOL_SHARDS; i++)
 	{
-		count += array_count(entry->online);
+		shard = &this->shards[i];
+		shard->mutex->lock(shard->mutex);
+		enumerator = shard->leases->create_enumerator(shard->leases);
+		while (enumerator->enumerate(enumerator, NULL, &entry))
+		{
+			count += array_count(entry->online);
+		}
+		enumerator->destroy(enumerator);
+		shard->mutex->unlock(shard->mutex);
 	}
-	enumerator->destroy(enumerator);
-	this->mutex->unlock(this->mutex);
-
 	return count;
 }
 
 METHOD(mem_pool_t, get_offline, u_int,
 	private_mem_pool_t *this)
 {
-	enumerator_t *enumerator;
-	entry_t *entry;
-	u_int count = 0;
+	pool_shard_t *shard;
+	u_int i, count = 0;
 
-	this->mutex->lock(this->mutex);
-	enumerator = this->leases->create_enumerator(this->leases);
-	while (enumerator->enumerate(enumerator, NULL, &entry))
+	for (i = 0; i < POOL_SHARDS; i++)
 	{
-		count += array_count(entry->offline);
+		shard = &this->shards[i];
+		shard->mutex->lock(shard->mutex);
+		count += shard->offline;
+		shard->mutex->unlock(shard->mutex);
 	}
-	enumerator->destroy(enumerator);
-	this->mutex->unlock(this->mutex);
-
 	return count;
 }
 
@@ -268,10 +319,10 @@ static u_int hash_addr(host_t *addr)
 }
 
 /**
- * Get an existing lease for id
+ * Get an existing lease for id, with the shards lock held
  */
-static int get_existing(private_mem_pool_t *this, identification_t *id,
-						host_t *requested, host_t *peer)
+static int get_existing(private_mem_pool_t *this, pool_shard_t *shard,
+						identification_t *id, host_t *requested, host_t *peer)
 {
 	enumerator_t *enumerator;
 	unique_lease_t *lease, reassign;
@@ -279,7 +330,7 @@ static int get_existing(private_mem_pool_t *this, identification_t *id,
 	entry_t *entry;
 	int offset = 0;
 
-	entry = this->leases->get(this->leases, id);
+	entry = shard->leases->get(shard->leases, id);
 	if (!entry)
 	{
 		return 0;
@@ -293,6 +344,7 @@ static int get_existing(private_mem_pool_t *this, identification_t *id,
 		reassign.hash = hash_addr(peer);
 		array_insert(entry->online, ARRAY_TAIL, &reassign);
 		array_remove_at(entry->offline, enumerator);
+		shard->offline--;
 	}
 	enumerator->destroy(enumerator);
 	if (offset)
@@ -326,23 +378,25 @@ static int get_existing(private_mem_pool_t *this, identification_t *id,
 }
 
 /**
- * Get a new lease for id
+ * Get a new lease for id, with the shards lock held
  */
-static int get_new(private_mem_pool_t *this, identification_t *id, host_t *peer)
+static int get_new(private_mem_pool_t *this, pool_shard_t *shard,
+				   identification_t *id, host_t *peer)
 {
 	entry_t *entry;
 	unique_lease_t lease = {};
+	u_int offset;
 
-	if (this->unused < this->size)
+	offset = alloc_fresh(this);
+	if (offset)
 	{
-		entry = this->leases->get(this->leases, id);
+		entry = shard->leases->get(shard->leases, id);
 		if (!entry)
 		{
 			entry = entry_create(id);
-			this->leases->put(this->leases, entry->id, entry);
+			shard->leases->put(shard->leases, entry->id, entry);
 		}
-		/* assigning offset, starting by 1 */
-		lease.offset = ++this->unused + (this->base_is_network_id ? 1 : 0);
+		lease.offset = offset + (this->base_is_network_id ? 1 : 0);
 		lease.hash = hash_addr(peer);
 		array_insert(entry->online, ARRAY_TAIL, &lease);
 		DBG1(DBG_CFG, "assigning new lease to '%Y'", id);
@@ -351,47 +405,63 @@ static int get_new(private_mem_pool_t *this, identification_t *id, host_t *peer)
 }
 
 /**
- * Get a reassigned lease for id in case the pool is full
+ * Get a reassigned lease for id in case the pool is full. Called without
+ * any shard lock held; shards are scanned and locked one after the other,
+ * skipping those without offline leases.
  */
 static int get_reassigned(private_mem_pool_t *this, identification_t *id,
 						  host_t *peer)
 {
 	enumerator_t *enumerator;
+	pool_shard_t *shard, *target;
 	entry_t *entry;
-	u_int current;
+	u_int i, current;
 	unique_lease_t lease = {};
 
-	enumerator = this->leases->create_enumerator(this->leases);
-	while (enumerator->enumerate(enumerator, NULL, &entry))
+	target = id_shard(this, id);
+	for (i = 0; i < POOL_SHARDS && !lease.offset; i++)
 	{
-		if (array_remove(entry->offline, ARRAY_HEAD, &current))
-		{
-			lease.offset = current;
-			DBG1(DBG_CFG, "reassigning existing offline lease by '%Y' "
-				 "to '%Y'", entry->id, id);
-		}
-		if (!array_count(entry->online) && !array_count(entry->offline))
-		{
-			this->leases->remove_at(this->leases, enumerator);
-			entry_destroy(entry);
-		}
-		if (lease.offset)
+		shard = &this->shards[(target - this->shards + i) % POOL_SHARDS];
+		shard->mutex->lock(shard->mutex);
+		if (shard->offline)
 		{
-			break;
+			enumerator = shard->leases->create_enumerator(shard->leases);
+			while (enumerator->enumerate(enumerator, NULL, &entry))
+			{
+				if (array_remove(entry->offline, ARRAY_HEAD, &current))
+				{
+					lease.offset = current;
+					shard->offline--;
+					DBG1(DBG_CFG, "reassigning existing offline lease by '%Y' "
+						 "to '%Y'", entry->id, id);
+				}
+				if (!array_count(entry->online) && !array_count(entry->offline))
+				{
+					shard->leases->remove_at(shard->leases, enumerator);
+					entry_destroy(entry);
+				}
+				if (lease.offset)
+				{
+					break;
+				}
+			}
+			enumerator->destroy(enumerator);
 		}
+		shard->mutex->unlock(shard->mutex);
 	}
-	enumerator->destroy(enumerator);
 
 	if (lease.offset)
-	{
-		entry = this->leases->get(this->leases, id);
+	{	/* the stolen offset is owned exclusively until inserted below */
+		target->mutex->lock(target->mutex);
+		entry = target->leases->get(target->leases, id);
 		if (!entry)
 		{
 			entry = entry_create(id);
-			this->leases->put(this->leases, entry->id, entry);
+			target->leases->put(target->leases, entry->id, entry);
 		}
 		lease.hash = hash_addr(peer);
 		array_insert(entry->online, ARRAY_TAIL, &lease);
+		target->mutex->unlock(target->mutex);
 	}
 	return lease.offset;
 }
@@ -400,6 +470,7 @@ METHOD(mem_pool_t, acquire_address, host_t*,
 	private_mem_pool_t *this, identification_t *id, host_t *requested,
 	mem_pool_op_t operation, host_t *peer)
 {
+	pool_shard_t *shard;
 	int offset = 0;
 
 	/* if the pool is empty (e.g. in the %config case) we simply return the
@@ -415,14 +486,18 @@ METHOD(mem_pool_t, acquire_address, host_t*,
 		return NULL;
 	}
 
-	this->mutex->lock(this->mutex);
+	shard = id_shard(this, id);
 	switch (operation)
 	{
 		case MEM_POOL_EXISTING:
-			offset = get_existing(this, id, requested, peer);
+			shard->mutex->lock(shard->mutex);
+			offset = get_existing(this, shard, id, requested, peer);
+			shard->mutex->unlock(shard->mutex);
 			break;
 		case MEM_POOL_NEW:
-			offset = get_new(this, id, peer);
+			shard->mutex->lock(shard->mutex);
+			offset = get_new(this, shard, id, peer);
+			shard->mutex->unlock(shard->mutex);
 			break;
 		case MEM_POOL_REASSIGN:
 			offset = get_reassigned(this, id, peer);
@@ -435,7 +510,6 @@ METHOD(mem_pool_t, acquire_address, host_t*,
 		default:
 			break;
 	}
-	this->mutex->unlock(this->mutex);
 
 	if (offset)
 	{
@@ -455,8 +529,10 @@ METHOD(mem_pool_t, release_address, bool,
 
 	if (this->size != 0)
 	{
-		this->mutex->lock(this->mutex);
-		entry = this->leases->get(this->leases, id);
+		pool_shard_t *shard = id_shard(this, id);
+
+		shard->mutex->lock(shard->mutex);
+		entry = shard->leases->get(shard->leases, id);
 		if (entry)
 		{
 			offset = host2offset(this, address);
@@ -484,10 +560,11 @@ METHOD(mem_pool_t, release_address, bool,
 			{
 				/* no tunnels are online anymore for this lease, make offline */
 				array_insert(entry->offline, ARRAY_TAIL, &offset);
+				shard->offline++;
 				DBG1(DBG_CFG, "lease %H by '%Y' went offline", address, id);
 			}
 		}
-		this->mutex->unlock(this->mutex);
+		shard->mutex->unlock(shard->mutex);
 	}
 	return found;
 }
@@ -498,8 +575,10 @@ METHOD(mem_pool_t, release_address, bool,
 typedef struct {
 	/** implemented enumerator interface */
 	enumerator_t public;
-	/** hash-table enumerator */
+	/** hash-table enumerator of the current shard */
 	enumerator_t *entries;
+	/** index of the current shard */
+	u_int shard;
 	/** online enumerator */
 	enumerator_t *online;
 	/** offline enumerator */
@@ -543,9 +622,15 @@ METHOD(enumerator_t, lease_enumerate, bool,
 			this->offline->destroy(this->offline);
 			this->online = this->offline = NULL;
 		}
-		if (!this->entries->enumerate(this->entries, NULL, &this->entry))
+		while (!this->entries->enumerate(this->entries, NULL, &this->entry))
 		{
-			return FALSE;
+			if (++this->shard == POOL_SHARDS)
+			{
+				return FALSE;
+			}
+			this->entries->destroy(this->entries);
+			this->entries = this->pool->shards[this->shard].leases->
+					create_enumerator(this->pool->shards[this->shard].leases);
 		}
 		this->online = array_create_enumerator(this->entry->online);
 		this->offline = array_create_enumerator(this->entry->offline);
@@ -555,11 +640,18 @@ METHOD(enumerator_t, lease_enumerate, bool,
 METHOD(enumerator_t, lease_enumerator_destroy, void,
 	lease_enumerator_t *this)
 {
+	pool_shard_t *shard;
+	u_int i;
+
 	DESTROY_IF(this->addr);
 	DESTROY_IF(this->online);
 	DESTROY_IF(this->offline);
 	this->entries->destroy(this->entries);
-	this->pool->mutex->unlock(this->pool->mutex);
+	for (i = 0; i < POOL_SHARDS; i++)
+	{
+		shard = &this->pool->shards[i];
+		shard->mutex->unlock(shard->mutex);
+	}
 	free(this);
 }
 
@@ -567,15 +659,24 @@ METHOD(mem_pool_t, create_lease_enumerator, enumerator_t*,
 	   private_mem_pool_t *this)
 {
 	lease_enumerator_t *enumerator;
+	pool_shard_t *shard;
+	u_int i;
 
-	this->mutex->lock(this->mutex);
+	/* lock all shards in order for a consistent snapshot; concurrent
+	 * assignments take a single shard lock only, so no cycle can occur */
+	for (i = 0; i < POOL_SHARDS; i++)
+	{
+		shard = &this->shards[i];
+		shard->mutex->lock(shard->mutex);
+	}
 	INIT(enumerator,
 		.public = {
 			.enumerate = (void*)_lease_enumerate,
 			.destroy = _lease_enumerator_destroy,
 		},
 		.pool = this,
-		.entries = this->leases->create_enumerator(this->leases),
+		.entries = this->shards[0].leases->create_enumerator(
+													this->shards[0].leases),
 	);
 	return &enumerator->public;
 }
@@ -584,17 +685,23 @@ METHOD(mem_pool_t, destroy, void,
 	private_mem_pool_t *this)
 {
 	enumerator_t *enumerator;
+	pool_shard_t *shard;
 	entry_t *entry;
+	u_int i;
 
-	enumerator = this->leases->create_enumerator(this->leases);
-	while (enumerator->enumerate(enumerator, NULL, &entry))
+	for (i = 0; i < POOL_SHARDS; i++)
 	{
-		entry_destroy(entry);
+		shard = &this->shards[i];
+		enumerator = shard->leases->create_enumerator(shard->leases);
+		while (enumerator->enumerate(enumerator, NULL, &entry))
+		{
+			entry_destroy(entry);
+		}
+		enumerator->destroy(enumerator);
+		shard->leases->destroy(shard->leases);
+		shard->mutex->destroy(shard->mutex);
 	}
-	enumerator->destroy(enumerator);
-
-	this->leases->destroy(this->leases);
-	this->mutex->destroy(this->mutex);
+	this->alloc_lock->destroy(this->alloc_lock);
 	DESTROY_IF(this->base);
 	free(this->name);
 	free(this);
@@ -606,6 +713,7 @@ METHOD(mem_pool_t, destroy, void,
 static private_mem_pool_t *create_generic(char *name)
 {
 	private_mem_pool_t *this;
+	u_int i;
 
 	INIT(this,
 		.public = {
@@ -620,11 +728,14 @@ static private_mem_pool_t *create_generic(char *name)
 			.destroy = _destroy,
 		},
 		.name = strdup(name),
-		.leases = hashtable_create((hashtable_hash_t)id_hash,
-								   (hashtable_equals_t)id_equals, 16),
-		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+		.alloc_lock = spinlock_create(),
 	);
-
+	for (i = 0; i < POOL_SHARDS; i++)
+	{
+		this->shards[i].leases = hashtable_create((hashtable_hash_t)id_hash,
+											(hashtable_equals_t)id_equals, 16);
+		this->shards[i].mutex = mutex_create(MUTEX_TYPE_DEFAULT);
+	}
 	return this;
 }
 
@@ -22,6 +22,7 @@
 #include <threading/thread_value.h>
 #include <threading/mutex.h>
 #include <threading/rwlock.h>
+#include <threading/spinlock.h>
 
 /**
  * These operations allow us to speed up the log level checks on some platforms.
@@ -48,7 +49,55 @@
 
 #endif
 
+/**
+ * Hooks of listener_t a separate listener array is published for
+ */
+typedef enum {
+	BUS_HOOK_ALERT,
+	BUS_HOOK_IKE_STATE_CHANGE,
+	BUS_HOOK_CHILD_STATE_CHANGE,
+	BUS_HOOK_MESSAGE,
+	BUS_HOOK_IKE_KEYS,
+	BUS_HOOK_CHILD_KEYS,
+	BUS_HOOK_IKE_UPDOWN,
+	BUS_HOOK_IKE_REKEY,
+	BUS_HOOK_IKE_UPDATE,
+	BUS_HOOK_IKE_REESTABLISH_PRE,
+	BUS_HOOK_IKE_REESTABLISH_POST,
+	BUS_HOOK_CHILD_UPDOWN,
+	BUS_HOOK_CHILD_REKEY,
+	BUS_HOOK_AUTHORIZE,
+	BUS_HOOK_NARROW,
+	BUS_HOOK_ASSIGN_VIPS,
+	BUS_HOOK_HANDLE_VIPS,
+	BUS_HOOK_MAX,
+} bus_hook_t;
+
+/**
+ * listener_t member backing each hook
+ */
+static const size_t bus_hook_offset[BUS_HOOK_MAX] = {
+	[BUS_HOOK_ALERT] = offsetof(listener_t, alert),
+	[BUS_HOOK_IKE_STATE_CHANGE] = offsetof(listener_t, ike_state_change),
+	[BUS_HOOK_CHILD_STATE_CHANGE] = offsetof(listener_t, child_state_change),
+	[BUS_HOOK_MESSAGE] = offsetof(listener_t, message),
+	[BUS_HOOK_IKE_KEYS] = offsetof(listener_t, ike_keys),
+	[BUS_HOOK_CHILD_KEYS] = offsetof(listener_t, child_keys),
+	[BUS_HOOK_IKE_UPDOWN] = offsetof(listener_t, ike_updown),
+	[BUS_HOOK_IKE_REKEY] = offsetof(listener_t, ike_rekey),
+	[BUS_HOOK_IKE_UPDATE] = offsetof(listener_t, ike_update),
+	[BUS_HOOK_IKE_REESTABLISH_PRE] = offsetof(listener_t, ike_reestablish_pre),
+	[BUS_HOOK_IKE_REESTABLISH_POST] = offsetof(listener_t, ike_reestablish_post),
+	[BUS_HOOK_CHILD_UPDOWN] = offsetof(listener_t, child_updown),
+	[BUS_HOOK_CHILD_REKEY] = offsetof(listener_t, child_rekey),
+	[BUS_HOOK_AUTHORIZE] = offsetof(listener_t, authorize),
+	[BUS_HOOK_NARROW] = offsetof(listener_t, narrow),
+	[BUS_HOOK_ASSIGN_VIPS] = offsetof(listener_t, assign_vips),
+	[BUS_HOOK_HANDLE_VIPS] = offsetof(listener_t, handle_vips),
+};
+
 typedef struct private_bus_t private_bus_t;
+typedef struct entry_t entry_t;
 
 /**
  * Private data of a bus_t object.
@@ -64,6 +113,52 @@ struct private_bus_t {
 	 */
 	linked_list_t *listeners;
 
+	/**
+	 * Published array of entries implementing each hook, scanned without
+	 * locks by dispatching threads, rebuilt as a whole on registration
+	 * changes.
+	 */
+	entry_t **arrays[BUS_HOOK_MAX];
+
+	/**
+	 * Number of entries in each published array.
+	 */
+	u_int counts[BUS_HOOK_MAX];
+
+	/**
+	 * Read-biased lock synchronizing array publication with dispatch.
+	 */
+	rwlock_t *listener_lock;
+
+	/**
+	 * Registration changes queued by threads currently dispatching, as
+	 * pending_op_t.
+	 */
+	linked_list_t *pending;
+
+	/**
+	 * Short-held lock protecting the pending list, safe to take while
+	 * dispatching.
+	 */
+	spinlock_t *pending_lock;
+
+	/**
+	 * Removed entries that may still be referenced by published arrays,
+	 * freed with the next publication.
+	 */
+	linked_list_t *stale;
+
+	/**
+	 * TRUE if pending operations wait for publication, checked racily by
+	 * dispatching threads and verified under the mutex.
+	 */
+	bool dirty;
+
+	/**
+	 * Innermost call frame of the current thread, as bus_frame_t.
+	 */
+	thread_value_t *calling;
+
 	/**
 	 * List of registered loggers for each log group as log_entry_t.
 	 * Loggers are ordered by descending log level.
@@ -83,7 +178,13 @@ struct private_bus_t {
 	level_t max_vlevel[DBG_MAX + 1];
 
 	/**
-	 * Mutex for the list of listeners, recursively.
+	 * Combined maximum of max_level and max_vlevel, so disabled-level log
+	 * calls bail out after a single check.
+	 */
+	level_t max_any_level[DBG_MAX + 1];
+
+	/**
+	 * Mutex serializing listener registration and array publication.
 	 */
 	mutex_t *mutex;
 
@@ -98,8 +199,6 @@ struct private_bus_t {
 	thread_value_t *thread_sa;
 };
 
-typedef struct entry_t entry_t;
-
 /**
  * a listener entry
  */
@@ -110,10 +209,44 @@ struct entry_t {
 	 */
 	listener_t *listener;
 
+};
+
+typedef struct pending_op_t pending_op_t;
+
+/**
+ * a queued registration change
+ */
+struct pending_op_t {
+
 	/**
-	 * are we currently calling this listener
+	 * TRUE to register the listener, FALSE to unregister it
 	 */
-	int calling;
+	bool add;
+
+	/**
+	 * affected listener
+	 */
+	listener_t *listener;
+
+};
+
+typedef struct bus_frame_t bus_frame_t;
+
+/**
+ * per-thread, stack-allocated frame of a listener invocation, used to
+ * detect and skip recursive invocations of the same listener
+ */
+struct bus_frame_t {
+
+	/**
+	 * entry the thread is currently calling
+	 */
+	entry_t *entry;
+
+	/**
+	 * frame of the invocation this event was raised from, if any
+	 */
+	bus_frame_t *prev;
 
 };
 
@@ -136,38 +269,160 @@ struct log_entry_t {
 
 };
 
-METHOD(bus_t, add_listener, void,
-	private_bus_t *this, listener_t *listener)
+/**
+ * Add a listener to the listener list (mutex must be held)
+ */
+static void insert_entry(private_bus_t *this, listener_t *listener)
 {
 	entry_t *entry;
 
 	INIT(entry,
 		.listener = listener,
 	);
-
-	this->mutex->lock(this->mutex);
 	this->listeners->insert_last(this->listeners, entry);
-	this->mutex->unlock(this->mutex);
 }
 
-METHOD(bus_t, remove_listener, void,
-	private_bus_t *this, listener_t *listener)
+/**
+ * Move the entry of a listener from the listener list to the stale list,
+ * it gets freed once no published array references it anymore (mutex must
+ * be held)
+ */
+static void remove_entry(private_bus_t *this, listener_t *listener)
 {
 	enumerator_t *enumerator;
 	entry_t *entry;
 
-	this->mutex->lock(this->mutex);
 	enumerator = this->listeners->create_enumerator(this->listeners);
 	while (enumerator->enumerate(enumerator, &entry))
 	{
 		if (entry->listener == listener)
 		{
 			this->listeners->remove_at(this->listeners, enumerator);
-			free(entry);
+			this->stale->insert_last(this->stale, entry);
 			break;
 		}
 	}
 	enumerator->destroy(enumerator);
+}
+
+/**
+ * Apply registration changes queued by dispatching threads (mutex must
+ * be held)
+ */
+static void apply_pending(private_bus_t *this)
+{
+	pending_op_t *op;
+
+	this->pending_lock->lock(this->pending_lock);
+	while (this->pending->remove_first(this->pending, (void**)&op) == SUCCESS)
+	{
+		this->pending_lock->unlock(this->pending_lock);
+		if (op->add)
+		{
+			insert_entry(this, op->listener);
+		}
+		else
+		{
+			remove_entry(this, op->listener);
+		}
+		free(op);
+		this->pending_lock->lock(this->pending_lock);
+	}
+	this->pending_lock->unlock(this->pending_lock);
+}
+
+/**
+ * Queue a registration change from a thread that currently dispatches an
+ * event, published once the outermost dispatch on this thread completed
+ */
+static void queue_pending(private_bus_t *this, listener_t *listener, bool add)
+{
+	pending_op_t *op;
+
+	INIT(op,
+		.add = add,
+		.listener = listener,
+	);
+	this->pending_lock->lock(this->pending_lock);
+	this->pending->insert_last(this->pending, op);
+	this->dirty = TRUE;
+	this->pending_lock->unlock(this->pending_lock);
+}
+
+/**
+ * Rebuild the per-hook listener arrays from the listener list and publish
+ * them, waiting out all dispatching threads.  Frees stale entries, as no
+ * thread references them anymore afterwards (mutex must be held).
+ */
+static void publish_listeners(private_bus_t *this)
+{
+	entry_t **arrays[BUS_HOOK_MAX], *entry;
+	u_int counts[BUS_HOOK_MAX] = {};
+	enumerator_t *enumerator;
+	bus_hook_t hook;
+	u_int total;
+
+	total = this->listeners->get_count(this->listeners);
+	for (hook = 0; hook < BUS_HOOK_MAX; hook++)
+	{
+		arrays[hook] = total ? malloc(sizeof(entry_t*) * total) : NULL;
+	}
+	enumerator = this->listeners->create_enumerator(this->listeners);
+	while (enumerator->enumerate(enumerator, &entry))
+	{
+		for (hook = 0; hook < BUS_HOOK_MAX; hook++)
+		{
+			if (*(void**)((char*)entry->listener + bus_hook_offset[hook]))
+			{
+				arrays[hook][counts[hook]++] = entry;
+			}
+		}
+	}
+	enumerator->destroy(enumerator);
+
+	this->listener_lock->write_lock(this->listener_lock);
+	for (hook = 0; hook < BUS_HOOK_MAX; hook++)
+	{
+		free(this->arrays[hook]);
+		this->arrays[hook] = arrays[hook];
+		this->counts[hook] = counts[hook];
+	}
+	this->listener_lock->unlock(this->listener_lock);
+
+	this->stale->destroy_function(this->stale, free);
+	this->stale = linked_list_create();
+	this->dirty = FALSE;
+}
+
+METHOD(bus_t, add_listener, void,
+	private_bus_t *this, listener_t *listener)
+{
+	if (this->calling->get(this->calling))
+	{	/* we can neither take the mutex nor wait out dispatching threads
+		 * while being one ourselves, defer the registration */
+		queue_pending(this, listener, TRUE);
+		return;
+	}
+	this->mutex->lock(this->mutex);
+	apply_pending(this);
+	insert_entry(this, listener);
+	publish_listeners(this);
+	this->mutex->unlock(this->mutex);
+}
+
+METHOD(bus_t, remove_listener, void,
+	private_bus_t *this, listener_t *listener)
+{
+	if (this->calling->get(this->calling))
+	{	/* deferred, the listener might see a few more events until the
+		 * outermost dispatch on this thread publishes the change */
+		queue_pending(this, listener, FALSE);
+		return;
+	}
+	this->mutex->lock(this->mutex);
+	apply_pending(this);
+	remove_entry(this, listener);
+	publish_listeners(this);
 	this->mutex->unlock(this->mutex);
 }
 
@@ -205,6 +460,8 @@ static inline void register_logger(private_bus_t *this, debug_t group,
 		set_level(&this->max_vlevel[group],
 				  max(this->max_vlevel[group], level));
 	}
+	set_level(&this->max_any_level[group],
+			  max(this->max_level[group], this->max_vlevel[group]));
 }
 
 /**
@@ -254,6 +511,7 @@ static inline void unregister_logger(private_bus_t *this, logger_t *logger)
 				}
 				set_level(&this->max_level[group], level);
 				set_level(&this->max_vlevel[group], vlevel);
+				set_level(&this->max_any_level[group], max(level, vlevel));
 			}
 		}
 		free(found);
@@ -364,8 +622,7 @@ METHOD(bus_t, vlog, void,
 	 * 2) We might have to acquire the read lock below even if it wouldn't be
 	 * necessary anymore due to another thread concurrently unregistering a
 	 * logger or reducing the level. */
-	if (skip_level(&this->max_level[group], level) &&
-		skip_level(&this->max_vlevel[group], level))
+	if (skip_level(&this->max_any_level[group], level))
 	{
 		return;
 	}
@@ -373,17 +630,18 @@ METHOD(bus_t, vlog, void,
 	this->log_lock->read_lock(this->log_lock);
 	loggers = this->loggers[group];
 
+	data.ike_sa = this->thread_sa->get(this->thread_sa);
+	data.thread = thread_current_id();
+	data.group = group;
+	data.level = level;
+
 	if (this->max_level[group] >= level)
-	{
+	{	/* a traditional logger consumes the message, format it once for all
+		 * of them; pure vlog() loggers don't pay for this */
 		char buf[1024];
 		ssize_t len;
 
-		data.ike_sa = this->thread_sa->get(this->thread_sa);
-		data.thread = thread_current_id();
-		data.group = group;
-		data.level = level;
 		data.message = buf;
-
 		va_copy(data.args, args);
 		len = vsnprintf(data.message, sizeof(buf), format, data.args);
 		va_end(data.args);
@@ -407,10 +665,6 @@ METHOD(bus_t, vlog, void,
 	}
 	if (this->max_vlevel[group] >= level)
 	{
-		data.ike_sa = this->thread_sa->get(this->thread_sa);
-		data.thread = thread_current_id();
-		data.group = group;
-		data.level = level;
 		data.message = format;
 
 		va_copy(data.args, args);
@@ -432,135 +686,177 @@ METHOD(bus_t, log_, void,
 }
 
 /**
- * unregister a listener
+ * Enter the dispatch of an event, locks out array publication
  */
-static inline void unregister_listener(private_bus_t *this, entry_t *entry,
-									   enumerator_t *enumerator)
+static void dispatch_enter(private_bus_t *this, bus_frame_t *frame)
 {
-	this->listeners->remove_at(this->listeners, enumerator);
-	free(entry);
+	this->listener_lock->read_lock(this->listener_lock);
+	frame->prev = this->calling->get(this->calling);
+	frame->entry = NULL;
+}
+
+/**
+ * Get the next entry of a hook the current thread is not already calling,
+ * pushing the call frame, NULL when the array is exhausted
+ */
+static entry_t *dispatch_next(private_bus_t *this, bus_hook_t hook, u_int *idx,
+							  bus_frame_t *frame)
+{
+	bus_frame_t *current;
+	entry_t *entry;
+
+	while (*idx < this->counts[hook])
+	{
+		entry = this->arrays[hook][(*idx)++];
+		for (current = frame->prev; current; current = current->prev)
+		{
+			if (current->entry == entry)
+			{	/* this thread raised the event from within this very
+				 * listener, skip it to avoid recursion */
+				entry = NULL;
+				break;
+			}
+		}
+		if (entry)
+		{
+			frame->entry = entry;
+			this->calling->set(this->calling, frame);
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Pop the call frame after invoking a listener, collecting it for
+ * unregistration if it does not want to stay registered
+ */
+static void dispatch_done(private_bus_t *this, bus_frame_t *frame, bool keep,
+						  linked_list_t **remove)
+{
+	this->calling->set(this->calling, frame->prev);
+	if (!keep)
+	{
+		*remove = *remove ?: linked_list_create();
+		(*remove)->insert_last(*remove, frame->entry->listener);
+	}
+}
+
+/**
+ * Leave the dispatch of an event, unregistering collected listeners and
+ * publishing deferred registration changes
+ */
+static void dispatch_exit(private_bus_t *this, linked_list_t *remove)
+{
+	listener_t *listener;
+
+	this->listener_lock->unlock(this->listener_lock);
+	if (remove)
+	{
+		while (remove->remove_first(remove, (void**)&listener) == SUCCESS)
+		{
+			remove_listener(this, listener);
+		}
+		remove->destroy(remove);
+	}
+	if (this->dirty && !this->calling->get(this->calling))
+	{	/* we left the outermost dispatch on this thread, publish changes
+		 * deferred while it was in progress */
+		this->mutex->lock(this->mutex);
+		if (this->dirty)
+		{
+			apply_pending(this);
+			publish_listeners(this);
+		}
+		this->mutex->unlock(this->mutex);
+	}
 }
 
 METHOD(bus_t, alert, void,
 	private_bus_t *this, alert_t alert, ...)
 {
-	enumerator_t *enumerator;
+	linked_list_t *remove = NULL;
 	ike_sa_t *ike_sa;
+	bus_frame_t frame;
 	entry_t *entry;
 	va_list args;
+	u_int i = 0;
 	bool keep;
 
 	ike_sa = this->thread_sa->get(this->thread_sa);
 
-	this->mutex->lock(this->mutex);
-	enumerator = this->listeners->create_enumerator(this->listeners);
-	while (enumerator->enumerate(enumerator, &entry))
+	dispatch_enter(this, &frame);
+	while ((entry = dispatch_next(this, BUS_HOOK_ALERT, &i, &frame)))
 	{
-		if (entry->calling || !entry->listener->alert)
-		{
-			continue;
-		}
-		entry->calling++;
 		va_start(args, alert);
 		keep = entry->listener->alert(entry->listener, ike_sa, alert, args);
 		va_end(args);
-		entry->calling--;
-		if (!keep)
-		{
-			unregister_listener(this, entry, enumerator);
-		}
+		dispatch_done(this, &frame, keep, &remove);
 	}
-	enumerator->destroy(enumerator);
-	this->mutex->unlock(this->mutex);
+	dispatch_exit(this, remove);
 }
 
 METHOD(bus_t, ike_state_change, void,
 	private_bus_t *this, ike_sa_t *ike_sa, ike_sa_state_t state)
 {
-	enumerator_t *enumerator;
+	linked_list_t *remove = NULL;
+	bus_frame_t frame;
 	entry_t *entry;
-	bool keep;
+	u_int i = 0;
 
-	this->mutex->lock(this->mutex);
-	enumerator = this->listeners->create_enumerator(this->listeners);
-	while (enumerator->enumerate(enumerator, &entry))
+	dispatch_enter(this, &frame);
+	while ((entry = dispatch_next(this, BUS_HOOK_IKE_STATE_CHANGE, &i, &frame)))
 	{
-		if (entry->calling || !entry->listener->ike_state_change)
-		{
-			continue;
-		}
-		entry->calling++;
-		keep = entry->listener->ike_state_change(entry->listener, ike_sa, state);
-		entry->calling--;
-		if (!keep)
-		{
-			unregister_listener(this, entry, enumerator);
-		}
+		dispatch_done(this, &frame,
+					  entry->listener->ike_state_change(entry->listener,
+														ike_sa, state),
+					  &remove);
 	}
-	enumerator->destroy(enumerator);
-	this->mutex->unlock(this->mutex);
+	dispatch_exit(this, remove);
 }
 
 METHOD(bus_t, child_state_change, void,
 	private_bus_t *this, child_sa_t *child_sa, child_sa_state_t state)
 {
-	enumerator_t *enumerator;
+	linked_list_t *remove = NULL;
 	ike_sa_t *ike_sa;
+	bus_frame_t frame;
 	entry_t *entry;
-	bool keep;
+	u_int i = 0;
 
 	ike_sa = this->thread_sa->get(this->thread_sa);
 
-	this->mutex->lock(this->mutex);
-	enumerator = this->listeners->create_enumerator(this->listeners);
-	while (enumerator->enumerate(enumerator, &entry))
+	dispatch_enter(this, &frame);
+	while ((entry = dispatch_next(this, BUS_HOOK_CHILD_STATE_CHANGE, &i, &frame)))
 	{
-		if (entry->calling || !entry->listener->child_state_change)
-		{
-			continue;
-		}
-		entry->calling++;
-		keep = entry->listener->child_state_change(entry->listener, ike_sa,
-												   child_sa, state);
-		entry->calling--;
-		if (!keep)
-		{
-			unregister_listener(this, entry, enumerator);
-		}
+		dispatch_done(this, &frame,
+					  entry->listener->child_state_change(entry->listener,
+														  ike_sa, child_sa, state),
+					  &remove);
 	}
-	enumerator->destroy(enumerator);
-	this->mutex->unlock(this->mutex);
+	dispatch_exit(this, remove);
 }
 
 METHOD(bus_t, message, void,
 	private_bus_t *this, message_t *message, bool incoming, bool plain)
 {
-	enumerator_t *enumerator;
+	linked_list_t *remove = NULL;
 	ike_sa_t *ike_sa;
+	bus_frame_t frame;
 	entry_t *entry;
-	bool keep;
+	u_int i = 0;
 
 	ike_sa = this->thread_sa->get(this->thread_sa);
 
-	this->mutex->lock(this->mutex);
-	enumerator = this->listeners->create_enumerator(this->listeners);
-	while (enumerator->enumerate(enumerator, &entry))
+	dispatch_enter(this, &frame);
+	while ((entry = dispatch_next(this, BUS_HOOK_MESSAGE, &i, &frame)))
 	{
-		if (entry->calling || !entry->listener->message)
-		{
-			continue;
-		}
-		entry->calling++;
-		keep = entry->listener->message(entry->listener, ike_sa,
-										message, incoming, plain);
-		entry->calling--;
-		if (!keep)
-		{
-			unregister_listener(this, entry, enumerator);
-		}
+		dispatch_done(this, &frame,
+					  entry->listener->message(entry->listener, ike_sa,
+											   message, incoming, plain),
+					  &remove);
 	}
-	enumerator->destroy(enumerator);
-	this->mutex->unlock(this->mutex);
+	dispatch_exit(this, remove);
 }
 
 METHOD(bus_t, ike_keys, void,
@@ -568,150 +864,107 @@ METHOD(bus_t, ike_keys, void,
 	chunk_t dh_other, chunk_t nonce_i, chunk_t nonce_r,
 	ike_sa_t *rekey, shared_key_t *shared)
 {
-	enumerator_t *enumerator;
+	linked_list_t *remove = NULL;
+	bus_frame_t frame;
 	entry_t *entry;
-	bool keep;
+	u_int i = 0;
 
-	this->mutex->lock(this->mutex);
-	enumerator = this->listeners->create_enumerator(this->listeners);
-	while (enumerator->enumerate(enumerator, &entry))
+	dispatch_enter(this, &frame);
+	while ((entry = dispatch_next(this, BUS_HOOK_IKE_KEYS, &i, &frame)))
 	{
-		if (entry->calling || !entry->listener->ike_keys)
-		{
-			continue;
-		}
-		entry->calling++;
-		keep = entry->listener->ike_keys(entry->listener, ike_sa, dh, dh_other,
-										 nonce_i, nonce_r, rekey, shared);
-		entry->calling--;
-		if (!keep)
-		{
-			unregister_listener(this, entry, enumerator);
-		}
+		dispatch_done(this, &frame,
+					  entry->listener->ike_keys(entry->listener, ike_sa, dh,
+												dh_other, nonce_i, nonce_r,
+												rekey, shared),
+					  &remove);
 	}
-	enumerator->destroy(enumerator);
-	this->mutex->unlock(this->mutex);
+	dispatch_exit(this, remove);
 }
 
 METHOD(bus_t, child_keys, void,
 	private_bus_t *this, child_sa_t *child_sa, bool initiator,
 	diffie_hellman_t *dh, chunk_t nonce_i, chunk_t nonce_r)
 {
-	enumerator_t *enumerator;
+	linked_list_t *remove = NULL;
 	ike_sa_t *ike_sa;
+	bus_frame_t frame;
 	entry_t *entry;
-	bool keep;
+	u_int i = 0;
 
 	ike_sa = this->thread_sa->get(this->thread_sa);
 
-	this->mutex->lock(this->mutex);
-	enumerator = this->listeners->create_enumerator(this->listeners);
-	while (enumerator->enumerate(enumerator, &entry))
+	dispatch_enter(this, &frame);
+	while ((entry = dispatch_next(this, BUS_HOOK_CHILD_KEYS, &i, &frame)))
 	{
-		if (entry->calling || !entry->listener->child_keys)
-		{
-			continue;
-		}
-		entry->calling++;
-		keep = entry->listener->child_keys(entry->listener, ike_sa,
-								child_sa, initiator, dh, nonce_i, nonce_r);
-		entry->calling--;
-		if (!keep)
-		{
-			unregister_listener(this, entry, enumerator);
-		}
+		dispatch_done(this, &frame,
+					  entry->listener->child_keys(entry->listener, ike_sa,
+												  child_sa, initiator, dh,
+												  nonce_i, nonce_r),
+					  &remove);
 	}
-	enumerator->destroy(enumerator);
-	this->mutex->unlock(this->mutex);
+	dispatch_exit(this, remove);
 }
 
 METHOD(bus_t, child_updown, void,
 	private_bus_t *this, child_sa_t *child_sa, bool up)
 {
-	enumerator_t *enumerator;
+	linked_list_t *remove = NULL;
 	ike_sa_t *ike_sa;
+	bus_frame_t frame;
 	entry_t *entry;
-	bool keep;
+	u_int i = 0;
 
 	ike_sa = this->thread_sa->get(this->thread_sa);
 
-	this->mutex->lock(this->mutex);
-	enumerator = this->listeners->create_enumerator(this->listeners);
-	while (enumerator->enumerate(enumerator, &entry))
+	dispatch_enter(this, &frame);
+	while ((entry = dispatch_next(this, BUS_HOOK_CHILD_UPDOWN, &i, &frame)))
 	{
-		if (entry->calling || !entry->listener->child_updown)
-		{
-			continue;
-		}
-		entry->calling++;
-		keep = entry->listener->child_updown(entry->listener,
-											 ike_sa, child_sa, up);
-		entry->calling--;
-		if (!keep)
-		{
-			unregister_listener(this, entry, enumerator);
-		}
+		dispatch_done(this, &frame,
+					  entry->listener->child_updown(entry->listener,
+													ike_sa, child_sa, up),
+					  &remove);
 	}
-	enumerator->destroy(enumerator);
-	this->mutex->unlock(this->mutex);
+	dispatch_exit(this, remove);
 }
 
 METHOD(bus_t, child_rekey, void,
 	private_bus_t *this, child_sa_t *old, child_sa_t *new)
 {
-	enumerator_t *enumerator;
+	linked_list_t *remove = NULL;
 	ike_sa_t *ike_sa;
+	bus_frame_t frame;
 	entry_t *entry;
-	bool keep;
+	u_int i = 0;
 
 	ike_sa = this->thread_sa->get(this->thread_sa);
 
-	this->mutex->lock(this->mutex);
-	enumerator = this->listeners->create_enumerator(this->listeners);
-	while (enumerator->enumerate(enumerator, &entry))
+	dispatch_enter(this, &frame);
+	while ((entry = dispatch_next(this, BUS_HOOK_CHILD_REKEY, &i, &frame)))
 	{
-		if (entry->calling || !entry->listener->child_rekey)
-		{
-			continue;
-		}
-		entry->calling++;
-		keep = entry->listener->child_rekey(entry->listener, ike_sa,
-											old, new);
-		entry->calling--;
-		if (!keep)
-		{
-			unregister_listener(this, entry, enumerator);
-		}
+		dispatch_done(this, &frame,
+					  entry->listener->child_rekey(entry->listener, ike_sa,
+												   old, new),
+					  &remove);
 	}
-	enumerator->destroy(enumerator);
-	this->mutex->unlock(this->mutex);
+	dispatch_exit(this, remove);
 }
 
 METHOD(bus_t, ike_updown, void,
 	private_bus_t *this, ike_sa_t *ike_sa, bool up)
 {
-	enumerator_t *enumerator;
+	linked_list_t *remove = NULL;
+	bus_frame_t frame;
 	entry_t *entry;
-	bool keep;
+	u_int i = 0;
 
-	this->mutex->lock(this->mutex);
-	enumerator = this->listeners->create_enumerator(this->listeners);
-	while (enumerator->enumerate(enumerator, &entry))
+	dispatch_enter(this, &frame);
+	while ((entry = dispatch_next(this, BUS_HOOK_IKE_UPDOWN, &i, &frame)))
 	{
-		if (entry->calling || !entry->listener->ike_updown)
-		{
-			continue;
-		}
-		entry->calling++;
-		keep = entry->listener->ike_updown(entry->listener, ike_sa, up);
-		entry->calling--;
-		if (!keep)
-		{
-			unregister_listener(this, entry, enumerator);
-		}
+		dispatch_done(this, &frame,
+					  entry->listener->ike_updown(entry->listener, ike_sa, up),
+					  &remove);
 	}
-	enumerator->destroy(enumerator);
-	this->mutex->unlock(this->mutex);
+	dispatch_exit(this, remove);
 
 	/* a down event for IKE_SA implicitly downs all CHILD_SAs */
 	if (!up)
@@ -731,145 +984,103 @@ METHOD(bus_t, ike_updown, void,
 METHOD(bus_t, ike_rekey, void,
 	private_bus_t *this, ike_sa_t *old, ike_sa_t *new)
 {
-	enumerator_t *enumerator;
+	linked_list_t *remove = NULL;
+	bus_frame_t frame;
 	entry_t *entry;
-	bool keep;
+	u_int i = 0;
 
-	this->mutex->lock(this->mutex);
-	enumerator = this->listeners->create_enumerator(this->listeners);
-	while (enumerator->enumerate(enumerator, &entry))
+	dispatch_enter(this, &frame);
+	while ((entry = dispatch_next(this, BUS_HOOK_IKE_REKEY, &i, &frame)))
 	{
-		if (entry->calling || !entry->listener->ike_rekey)
-		{
-			continue;
-		}
-		entry->calling++;
-		keep = entry->listener->ike_rekey(entry->listener, old, new);
-		entry->calling--;
-		if (!keep)
-		{
-			unregister_listener(this, entry, enumerator);
-		}
+		dispatch_done(this, &frame,
+					  entry->listener->ike_rekey(entry->listener, old, new),
+					  &remove);
 	}
-	enumerator->destroy(enumerator);
-	this->mutex->unlock(this->mutex);
+	dispatch_exit(this, remove);
 }
 
 METHOD(bus_t, ike_update, void,
 	private_bus_t *this, ike_sa_t *ike_sa, bool local, host_t *new)
 {
-	enumerator_t *enumerator;
+	linked_list_t *remove = NULL;
+	bus_frame_t frame;
 	entry_t *entry;
-	bool keep;
+	u_int i = 0;
 
-	this->mutex->lock(this->mutex);
-	enumerator = this->listeners->create_enumerator(this->listeners);
-	while (enumerator->enumerate(enumerator, &entry))
+	dispatch_enter(this, &frame);
+	while ((entry = dispatch_next(this, BUS_HOOK_IKE_UPDATE, &i, &frame)))
 	{
-		if (entry->calling || !entry->listener->ike_update)
-		{
-			continue;
-		}
-		entry->calling++;
-		keep = entry->listener->ike_update(entry->listener, ike_sa, local, new);
-		entry->calling--;
-		if (!keep)
-		{
-			unregister_listener(this, entry, enumerator);
-		}
+		dispatch_done(this, &frame,
+					  entry->listener->ike_update(entry->listener, ike_sa,
+												  local, new),
+					  &remove);
 	}
-	enumerator->destroy(enumerator);
-	this->mutex->unlock(this->mutex);
+	dispatch_exit(this, remove);
 }
 
 METHOD(bus_t, ike_reestablish_pre, void,
 	private_bus_t *this, ike_sa_t *old, ike_sa_t *new)
 {
-	enumerator_t *enumerator;
+	linked_list_t *remove = NULL;
+	bus_frame_t frame;
 	entry_t *entry;
-	bool keep;
+	u_int i = 0;
 
-	this->mutex->lock(this->mutex);
-	enumerator = this->listeners->create_enumerator(this->listeners);
-	while (enumerator->enumerate(enumerator, &entry))
+	dispatch_enter(this, &frame);
+	while ((entry = dispatch_next(this, BUS_HOOK_IKE_REESTABLISH_PRE, &i, &frame)))
 	{
-		if (entry->calling || !entry->listener->ike_reestablish_pre)
-		{
-			continue;
-		}
-		entry->calling++;
-		keep = entry->listener->ike_reestablish_pre(entry->listener, old, new);
-		entry->calling--;
-		if (!keep)
-		{
-			unregister_listener(this, entry, enumerator);
-		}
+		dispatch_done(this, &frame,
+					  entry->listener->ike_reestablish_pre(entry->listener,
+														   old, new),
+					  &remove);
 	}
-	enumerator->destroy(enumerator);
-	this->mutex->unlock(this->mutex);
+	dispatch_exit(this, remove);
 }
 
 METHOD(bus_t, ike_reestablish_post, void,
 	private_bus_t *this, ike_sa_t *old, ike_sa_t *new, bool initiated)
 {
-	enumerator_t *enumerator;
+	linked_list_t *remove = NULL;
+	bus_frame_t frame;
 	entry_t *entry;
-	bool keep;
+	u_int i = 0;
 
-	this->mutex->lock(this->mutex);
-	enumerator = this->listeners->create_enumerator(this->listeners);
-	while (enumerator->enumerate(enumerator, &entry))
+	dispatch_enter(this, &frame);
+	while ((entry = dispatch_next(this, BUS_HOOK_IKE_REESTABLISH_POST, &i, &frame)))
 	{
-		if (entry->calling || !entry->listener->ike_reestablish_post)
-		{
-			continue;
-		}
-		entry->calling++;
-		keep = entry->listener->ike_reestablish_post(entry->listener, old, new,
-													 initiated);
-		entry->calling--;
-		if (!keep)
-		{
-			unregister_listener(this, entry, enumerator);
-		}
+		dispatch_done(this, &frame,
+					  entry->listener->ike_reestablish_post(entry->listener,
+															old, new, initiated),
+					  &remove);
 	}
-	enumerator->destroy(enumerator);
-	this->mutex->unlock(this->mutex);
+	dispatch_exit(this, remove);
 }
 
 METHOD(bus_t, authorize, bool,
 	private_bus_t *this, bool final)
 {
-	enumerator_t *enumerator;
+	linked_list_t *remove = NULL;
 	ike_sa_t *ike_sa;
+	bus_frame_t frame;
 	entry_t *entry;
-	bool keep, success = TRUE;
+	u_int i = 0;
+	bool success = TRUE;
 
 	ike_sa = this->thread_sa->get(this->thread_sa);
 
-	this->mutex->lock(this->mutex);
-	enumerator = this->listeners->create_enumerator(this->listeners);
-	while (enumerator->enumerate(enumerator, &entry))
+	dispatch_enter(this, &frame);
+	while ((entry = dispatch_next(this, BUS_HOOK_AUTHORIZE, &i, &frame)))
 	{
-		if (entry->calling || !entry->listener->authorize)
-		{
-			continue;
-		}
-		entry->calling++;
-		keep = entry->listener->authorize(entry->listener, ike_sa,
-										  final, &success);
-		entry->calling--;
-		if (!keep)
-		{
-			unregister_listener(this, entry, enumerator);
-		}
+		dispatch_done(this, &frame,
+					  entry->listener->authorize(entry->listener, ike_sa,
+												 final, &success),
+					  &remove);
 		if (!success)
 		{
 			break;
 		}
 	}
-	enumerator->destroy(enumerator);
-	this->mutex->unlock(this->mutex);
+	dispatch_exit(this, remove);
 	if (!success)
 	{
 		alert(this, ALERT_AUTHORIZATION_FAILED);
@@ -881,86 +1092,61 @@ METHOD(bus_t, narrow, void,
 	private_bus_t *this, child_sa_t *child_sa, narrow_hook_t type,
 	linked_list_t *local, linked_list_t *remote)
 {
-	enumerator_t *enumerator;
+	linked_list_t *remove = NULL;
 	ike_sa_t *ike_sa;
+	bus_frame_t frame;
 	entry_t *entry;
-	bool keep;
+	u_int i = 0;
 
 	ike_sa = this->thread_sa->get(this->thread_sa);
 
-	this->mutex->lock(this->mutex);
-	enumerator = this->listeners->create_enumerator(this->listeners);
-	while (enumerator->enumerate(enumerator, &entry))
+	dispatch_enter(this, &frame);
+	while ((entry = dispatch_next(this, BUS_HOOK_NARROW, &i, &frame)))
 	{
-		if (entry->calling || !entry->listener->narrow)
-		{
-			continue;
-		}
-		entry->calling++;
-		keep = entry->listener->narrow(entry->listener, ike_sa, child_sa,
-									   type, local, remote);
-		entry->calling--;
-		if (!keep)
-		{
-			unregister_listener(this, entry, enumerator);
-		}
+		dispatch_done(this, &frame,
+					  entry->listener->narrow(entry->listener, ike_sa,
+											  child_sa, type, local, remote),
+					  &remove);
 	}
-	enumerator->destroy(enumerator);
-	this->mutex->unlock(this->mutex);
+	dispatch_exit(this, remove);
 }
 
 METHOD(bus_t, assign_vips, void,
 	private_bus_t *this, ike_sa_t *ike_sa, bool assign)
 {
-	enumerator_t *enumerator;
+	linked_list_t *remove = NULL;
+	bus_frame_t frame;
 	entry_t *entry;
-	bool keep;
+	u_int i = 0;
 
-	this->mutex->lock(this->mutex);
-	enumerator = this->listeners->create_enumerator(this->listeners);
-	while (enumerator->enumerate(enumerator, &entry))
+	dispatch_enter(this, &frame);
+	while ((entry = dispatch_next(this, BUS_HOOK_ASSIGN_VIPS, &i, &frame)))
 	{
-		if (entry->calling || !entry->listener->assign_vips)
-		{
-			continue;
-		}
-		entry->calling++;
-		keep = entry->listener->assign_vips(entry->listener, ike_sa, assign);
-		entry->calling--;
-		if (!keep)
-		{
-			unregister_listener(this, entry, enumerator);
-		}
+		dispatch_done(this, &frame,
+					  entry->listener->assign_vips(entry->listener, ike_sa,
+												   assign),
+					  &remove);
 	}
-	enumerator->destroy(enumerator);
-	this->mutex->unlock(this->mutex);
+	dispatch_exit(this, remove);
 }
 
 METHOD(bus_t, handle_vips, void,
 	private_bus_t *this, ike_sa_t *ike_sa, bool handle)
 {
-	enumerator_t *enumerator;
+	linked_list_t *remove = NULL;
+	bus_frame_t frame;
 	entry_t *entry;
-	bool keep;
+	u_int i = 0;
 
-	this->mutex->lock(this->mutex);
-	enumerator = this->listeners->create_enumerator(this->listeners);
-	while (enumerator->enumerate(enumerator, &entry))
+	dispatch_enter(this, &frame);
+	while ((entry = dispatch_next(this, BUS_HOOK_HANDLE_VIPS, &i, &frame)))
 	{
-		if (entry->calling || !entry->listener->handle_vips)
-		{
-			continue;
-		}
-		entry->calling++;
-		keep = entry->listener->handle_vips(entry->listener, ike_sa, handle);
-		entry->calling--;
-		if (!keep)
-		{
-			unregister_listener(this, entry, enumerator);
-		}
+		dispatch_done(this, &frame,
+					  entry->listener->handle_vips(entry->listener, ike_sa,
+												   handle),
+					  &remove);
 	}
-	enumerator->destroy(enumerator);
-	this->mutex->unlock(this->mutex);
+	dispatch_exit(this, remove);
 }
 
 /**
@@ -991,6 +1177,7 @@ static void hook_creds(private_bus_t *this, credential_hook_type_t type,
 METHOD(bus_t, destroy, void,
 	private_bus_t *this)
 {
+	bus_hook_t hook;
 	debug_t group;
 
 	lib->credmgr->set_hook(lib->credmgr, NULL, NULL);
@@ -1001,6 +1188,15 @@ METHOD(bus_t, destroy, void,
 	this->loggers[DBG_MAX]->destroy_function(this->loggers[DBG_MAX],
 											 (void*)free);
 	this->listeners->destroy_function(this->listeners, (void*)free);
+	this->stale->destroy_function(this->stale, (void*)free);
+	this->pending->destroy_function(this->pending, (void*)free);
+	for (hook = 0; hook < BUS_HOOK_MAX; hook++)
+	{
+		free(this->arrays[hook]);
+	}
+	this->pending_lock->destroy(this->pending_lock);
+	this->listener_lock->destroy(this->listener_lock);
+	this->calling->destroy(this->calling);
 	this->thread_sa->destroy(this->thread_sa);
 	this->log_lock->destroy(this->log_lock);
 	this->mutex->destroy(this->mutex);
@@ -1045,8 +1241,13 @@ bus_t *bus_create()
 			.destroy = _destroy,
 		},
 		.listeners = linked_list_create(),
-		.mutex = mutex_create(MUTEX_TYPE_RECURSIVE),
+		.pending = linked_list_create(),
+		.stale = linked_list_create(),
+		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+		.listener_lock = rwlock_create(RWLOCK_TYPE_READ_BIASED),
+		.pending_lock = spinlock_create(),
 		.log_lock = rwlock_create(RWLOCK_TYPE_DEFAULT),
+		.calling = thread_value_create(NULL),
 		.thread_sa = thread_value_create(NULL),
 	);
 
@@ -1055,6 +1256,7 @@ bus_t *bus_create()
 		this->loggers[group] = linked_list_create();
 		this->max_level[group] = LEVEL_SILENT;
 		this->max_vlevel[group] = LEVEL_SILENT;
+		this->max_any_level[group] = LEVEL_SILENT;
 	}
 
 	lib->credmgr->set_hook(lib->credmgr, (credential_hook_t)hook_creds, this);
@@ -24,9 +24,22 @@
 #include "file_logger.h"
 
 #include <daemon.h>
+#include <threading/thread.h>
 #include <threading/mutex.h>
+#include <threading/condvar.h>
+#include <threading/spinlock.h>
 #include <threading/rwlock.h>
 
+/**
+ * Size of the buffer pending async writes, messages get dropped when full
+ */
+#define ASYNC_BUFFER_SIZE 65536
+
+/**
+ * Interval between timed flushes of the async writer thread, in ms
+ */
+#define ASYNC_FLUSH_INTERVAL 100
+
 typedef struct private_file_logger_t private_file_logger_t;
 
 /**
@@ -78,8 +91,198 @@ struct private_file_logger_t {
 	 * Lock to read/write options (FD, levels, time_format, etc.)
 	 */
 	rwlock_t *lock;
+
+	/**
+	 * Async mode state, only the buffer fields are used while a writer
+	 * thread is running
+	 */
+	struct {
+
+		/**
+		 * Writer thread draining the buffer, NULL in synchronous mode
+		 */
+		thread_t *writer;
+
+		/**
+		 * Lock protecting the buffer fields below
+		 */
+		spinlock_t *lock;
+
+		/**
+		 * Buffer with formatted messages waiting for the writer
+		 */
+		chunk_t buf;
+
+		/**
+		 * Number of bytes used in buf
+		 */
+		size_t used;
+
+		/**
+		 * Number of messages dropped because the buffer was full
+		 */
+		u_int dropped;
+
+		/**
+		 * Mutex for the flush condvar below
+		 */
+		mutex_t *mutex;
+
+		/**
+		 * Condvar the writer waits on between flushes
+		 */
+		condvar_t *notify;
+
+		/**
+		 * TRUE to terminate the writer thread
+		 */
+		bool stop;
+
+	} async;
 };
 
+/**
+ * Format the prefix for a message line into buf
+ */
+static size_t format_prefix(private_file_logger_t *this, char *buf, size_t size,
+							char *timestr, int thread, char *namestr,
+							debug_t group)
+{
+	if (this->time_format)
+	{
+		return snprintf(buf, size, "%s %.2d[%N]%s ",
+						timestr, thread, debug_names, group, namestr);
+	}
+	return snprintf(buf, size, "%.2d[%N]%s ",
+					thread, debug_names, group, namestr);
+}
+
+/**
+ * Queue a formatted message for the async writer thread, a memcpy under
+ * a spinlock on the calling thread
+ */
+static void enqueue_message(private_file_logger_t *this, char *buf, size_t len)
+{
+	this->async.lock->lock(this->async.lock);
+	if (this->async.used + len <= this->async.buf.len)
+	{
+		memcpy(this->async.buf.ptr + this->async.used, buf, len);
+		this->async.used += len;
+	}
+	else
+	{
+		this->async.dropped++;
+	}
+	this->async.lock->unlock(this->async.lock);
+}
+
+/**
+ * Swap the async buffer against the spare one and write out the drained data
+ */
+static void drain_messages(private_file_logger_t *this, chunk_t *spare)
+{
+	chunk_t data;
+	size_t used;
+	u_int dropped;
+
+	this->async.lock->lock(this->async.lock);
+	data = this->async.buf;
+	used = this->async.used;
+	dropped = this->async.dropped;
+	this->async.buf = *spare;
+	this->async.used = 0;
+	this->async.dropped = 0;
+	this->async.lock->unlock(this->async.lock);
+	*spare = data;
+
+	if (used || dropped)
+	{
+		this->lock->read_lock(this->lock);
+		if (this->out)
+		{
+			this->mutex->lock(this->mutex);
+			if (used)
+			{
+				fwrite(data.ptr, 1, used, this->out);
+			}
+			if (dropped)
+			{
+				fprintf(this->out, "00[DMN] dropped %u log message%s due to "
+						"full async buffer\n", dropped, dropped > 1 ? "s" : "");
+			}
+#ifndef HAVE_SETLINEBUF
+			if (this->flush_line)
+			{
+				fflush(this->out);
+			}
+#endif /* !HAVE_SETLINEBUF */
+			this->mutex->unlock(this->mutex);
+		}
+		this->lock->unlock(this->lock);
+	}
+}
+
+/**
+ * Writer thread draining queued messages with timed flushes
+ */
+static void *writer_thread(private_file_logger_t *this)
+{
+	chunk_t spare = chunk_alloc(ASYNC_BUFFER_SIZE);
+	bool stop = FALSE;
+
+	thread_cancelability(FALSE);
+
+	while (!stop)
+	{
+		this->async.mutex->lock(this->async.mutex);
+		if (!this->async.stop)
+		{
+			this->async.notify->timed_wait(this->async.notify,
+										   this->async.mutex,
+										   ASYNC_FLUSH_INTERVAL);
+		}
+		stop = this->async.stop;
+		this->async.mutex->unlock(this->async.mutex);
+
+		drain_messages(this, &spare);
+	}
+	chunk_free(&spare);
+	return NULL;
+}
+
+/**
+ * Start the async writer thread, if not running yet
+ */
+static void start_writer(private_file_logger_t *this)
+{
+	if (!this->async.writer)
+	{
+		this->async.stop = FALSE;
+		this->async.buf = chunk_alloc(ASYNC_BUFFER_SIZE);
+		this->async.used = 0;
+		this->async.dropped = 0;
+		this->async.writer = thread_create((thread_main_t)writer_thread, this);
+	}
+}
+
+/**
+ * Stop the async writer thread and drain pending messages, if running
+ */
+static void stop_writer(private_file_logger_t *this)
+{
+	if (this->async.writer)
+	{
+		this->async.mutex->lock(this->async.mutex);
+		this->async.stop = TRUE;
+		this->async.notify->signal(this->async.notify);
+		this->async.mutex->unlock(this->async.mutex);
+
+		this->async.writer->join(this->async.writer);
+		this->async.writer = NULL;
+		chunk_free(&this->async.buf);
+	}
+}
+
 METHOD(logger_t, log_, void,
 	private_file_logger_t *this, debug_t group, level_t level, int thread,
 	ike_sa_t* ike_sa, const char *message)
@@ -119,6 +322,39 @@ METHOD(logger_t, log_, void,
 		namestr[0] = '\0';
 	}
 
+	if (this->async.writer)
+	{	/* prefix every line and queue the whole message for the writer */
+		char buf[4096];
+		size_t len = 0;
+
+		while (len < sizeof(buf) - 1)
+		{
+			next = strchr(current, '\n');
+			len += format_prefix(this, buf + len, sizeof(buf) - len,
+								 timestr, thread, namestr, group);
+			if (len >= sizeof(buf) - 1)
+			{
+				break;
+			}
+			if (next == NULL)
+			{
+				len += snprintf(buf + len, sizeof(buf) - len, "%s\n", current);
+				break;
+			}
+			len += snprintf(buf + len, sizeof(buf) - len, "%.*s\n",
+							(int)(next - current), current);
+			current = next + 1;
+		}
+		len = min(len, sizeof(buf) - 1);
+		if (len && buf[len - 1] != '\n')
+		{	/* overly long messages get truncated, keep a trailing newline */
+			buf[len - 1] = '\n';
+		}
+		enqueue_message(this, buf, len);
+		this->lock->unlock(this->lock);
+		return;
+	}
+
 	/* prepend a prefix in front of every line */
 	this->mutex->lock(this->mutex);
 	while (TRUE)
@@ -204,7 +440,7 @@ static void close_file(private_file_logger_t *this)
 }
 
 METHOD(file_logger_t, open_, void,
-	private_file_logger_t *this, bool flush_line, bool append)
+	private_file_logger_t *this, bool flush_line, bool append, bool async_write)
 {
 	FILE *file;
 
@@ -237,14 +473,27 @@ METHOD(file_logger_t, open_, void,
 	this->out = file;
 	this->flush_line = flush_line;
 	this->lock->unlock(this->lock);
+
+	if (async_write)
+	{
+		start_writer(this);
+	}
+	else
+	{
+		stop_writer(this);
+	}
 }
 
 METHOD(file_logger_t, destroy, void,
 	private_file_logger_t *this)
 {
+	stop_writer(this);
 	this->lock->write_lock(this->lock);
 	close_file(this);
 	this->lock->unlock(this->lock);
+	this->async.notify->destroy(this->async.notify);
+	this->async.mutex->destroy(this->async.mutex);
+	this->async.lock->destroy(this->async.lock);
 	this->mutex->destroy(this->mutex);
 	this->lock->destroy(this->lock);
 	free(this->time_format);
@@ -273,6 +522,11 @@ file_logger_t *file_logger_create(char *filename)
 		.filename = strdup(filename),
 		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
 		.lock = rwlock_create(RWLOCK_TYPE_DEFAULT),
+		.async = {
+			.lock = spinlock_create(),
+			.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+			.notify = condvar_create(CONDVAR_TYPE_DEFAULT),
+		},
 	);
 
 	set_level(this, DBG_ANY, LEVEL_SILENT);
@@ -57,8 +57,10 @@ struct file_logger_t {
 	 *
 	 * @param flush_line	TRUE to flush buffers after every logged line
 	 * @param append		FALSE to overwrite an existing file, TRUE to append
+	 * @param async			TRUE to buffer messages for a dedicated writer thread
 	 */
-	void (*open) (file_logger_t *this, bool flush_line, bool append);
+	void (*open) (file_logger_t *this, bool flush_line, bool append,
+				  bool async);
 
 	/**
 	 * Destroys a file_logger_t object.
@@ -19,7 +19,12 @@
 
 #include <daemon.h>
 #include <collections/linked_list.h>
+#include <collections/hashtable.h>
 #include <threading/rwlock.h>
+#include <threading/mutex.h>
+
+/** default limit for cached ike_cfg lookup results */
+#define DEFAULT_IKE_CFG_CACHE_SIZE 1024
 
 
 typedef struct private_backend_manager_t private_backend_manager_t;
@@ -43,8 +48,172 @@ struct private_backend_manager_t {
 	 * rwlock for backends
 	 */
 	rwlock_t *lock;
+
+	/**
+	 * cache of resolved ike_cfg lookups
+	 */
+	hashtable_t *cache;
+
+	/**
+	 * mutex protecting the lookup cache
+	 */
+	mutex_t *cache_lock;
+
+	/**
+	 * maximum number of cached lookups, 0 to disable caching
+	 */
+	u_int cache_size;
+
+	/**
+	 * cache generation, incremented whenever the cache gets flushed
+	 */
+	u_int generation;
 };
 
+/**
+ * Cached result of an ike_cfg lookup
+ */
+typedef struct {
+	/** local address the lookup was done for */
+	host_t *me;
+	/** remote address the lookup was done for */
+	host_t *other;
+	/** IKE version the lookup was done for */
+	ike_version_t version;
+	/** ike_cfg the lookup resolved to */
+	ike_cfg_t *cfg;
+} cache_entry_t;
+
+/**
+ * Destroy a cached lookup result
+ */
+static void cache_entry_destroy(cache_entry_t *entry)
+{
+	DESTROY_IF(entry->me);
+	DESTROY_IF(entry->other);
+	entry->cfg->destroy(entry->cfg);
+	free(entry);
+}
+
+/**
+ * Hashtable hash function for cached lookups
+ */
+static u_int cache_hash(cache_entry_t *key)
+{
+	u_int hash = key->version;
+
+	if (key->me)
+	{
+		hash = chunk_hash_inc(key->me->get_address(key->me), hash);
+	}
+	if (key->other)
+	{
+		hash = chunk_hash_inc(key->other->get_address(key->other), hash);
+	}
+	return hash;
+}
+
+/**
+ * Hashtable equals function for cached lookups
+ */
+static bool cache_equals(cache_entry_t *a, cache_entry_t *b)
+{
+	if (a->version != b->version ||
+		(a->me == NULL) != (b->me == NULL) ||
+		(a->other == NULL) != (b->other == NULL))
+	{
+		return FALSE;
+	}
+	if (a->me && !a->me->ip_equals(a->me, b->me))
+	{
+		return FALSE;
+	}
+	if (a->other && !a->other->ip_equals(a->other, b->other))
+	{
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * Remove all cached lookups, cache lock is held by caller
+ */
+static void cache_flush_locked(private_backend_manager_t *this)
+{
+	enumerator_t *enumerator;
+	cache_entry_t *entry;
+
+	enumerator = this->cache->create_enumerator(this->cache);
+	while (enumerator->enumerate(enumerator, NULL, (void**)&entry))
+	{
+		this->cache->remove_at(this->cache, enumerator);
+		cache_entry_destroy(entry);
+	}
+	enumerator->destroy(enumerator);
+	this->generation++;
+}
+
+/**
+ * Look up a previously resolved ike_cfg, returns a reference.
+ *
+ * Returns the cache generation the lookup was done under.
+ */
+static ike_cfg_t *cache_lookup(private_backend_manager_t *this, host_t *me,
+							   host_t *other, ike_version_t version,
+							   u_int *generation)
+{
+	cache_entry_t *entry, key = {
+		.me = me,
+		.other = other,
+		.version = version,
+	};
+	ike_cfg_t *found = NULL;
+
+	this->cache_lock->lock(this->cache_lock);
+	*generation = this->generation;
+	entry = this->cache->get(this->cache, &key);
+	if (entry)
+	{
+		found = entry->cfg->get_ref(entry->cfg);
+	}
+	this->cache_lock->unlock(this->cache_lock);
+	return found;
+}
+
+/**
+ * Cache a resolved ike_cfg, unless the cache got flushed since the lookup
+ * started under the given generation.
+ */
+static void cache_insert(private_backend_manager_t *this, host_t *me,
+						 host_t *other, ike_version_t version, ike_cfg_t *cfg,
+						 u_int generation)
+{
+	cache_entry_t *entry, key = {
+		.me = me,
+		.other = other,
+		.version = version,
+	};
+
+	this->cache_lock->lock(this->cache_lock);
+	if (this->generation == generation &&
+		!this->cache->get(this->cache, &key))
+	{
+		if (this->cache->get_count(this->cache) >= this->cache_size)
+		{	/* simply flush instead of maintaining an LRU, the cache
+			 * repopulates quickly from the lookups that actually recur */
+			cache_flush_locked(this);
+		}
+		INIT(entry,
+			.me = me ? me->clone(me) : NULL,
+			.other = other ? other->clone(other) : NULL,
+			.version = version,
+			.cfg = cfg->get_ref(cfg),
+		);
+		this->cache->put(this->cache, entry, entry);
+	}
+	this->cache_lock->unlock(this->cache_lock);
+}
+
 /**
  * match of an ike_cfg
  */
@@ -137,20 +306,31 @@ METHOD(backend_manager_t, get_ike_cfg, ike_cfg_t*,
 	char *my_addr, *other_addr;
 	enumerator_t *enumerator;
 	ike_cfg_match_t match, best = MATCH_ANY;
-	ike_data_t *data;
-
-	INIT(data,
+	enumerator_nested_t nested;
+	u_int generation = 0;
+	ike_data_t data = {
 		.this = this,
 		.me = me,
 		.other = other,
-	);
+	};
 
 	DBG2(DBG_CFG, "looking for an ike config for %H...%H", me, other);
 
+	if (this->cache_size)
+	{
+		found = cache_lookup(this, me, other, version, &generation);
+		if (found)
+		{
+			DBG2(DBG_CFG, "found cached ike config: %s...%s",
+				 found->get_my_addr(found), found->get_other_addr(found));
+			return found;
+		}
+	}
+
 	this->lock->read_lock(this->lock);
-	enumerator = enumerator_create_nested(
+	enumerator = enumerator_init_nested(&nested,
 						this->backends->create_enumerator(this->backends),
-						(void*)ike_enum_create, data, (void*)free);
+						(void*)ike_enum_create, &data, NULL);
 	while (enumerator->enumerate(enumerator, (void**)&current))
 	{
 		match = get_ike_match(current, me, other, version);
@@ -179,6 +359,10 @@ METHOD(backend_manager_t, get_ike_cfg, ike_cfg_t*,
 		other_addr = found->get_other_addr(found);
 		DBG2(DBG_CFG, "found matching ike config: %s...%s with prio %d",
 			 my_addr, other_addr, best);
+		if (this->cache_size)
+		{
+			cache_insert(this, me, other, version, found, generation);
+		}
 	}
 	return found;
 }
@@ -401,12 +585,21 @@ METHOD(backend_manager_t, get_peer_cfg_by_name, peer_cfg_t*,
 	return config;
 }
 
+METHOD(backend_manager_t, flush_cache, void,
+	private_backend_manager_t *this)
+{
+	this->cache_lock->lock(this->cache_lock);
+	cache_flush_locked(this);
+	this->cache_lock->unlock(this->cache_lock);
+}
+
 METHOD(backend_manager_t, remove_backend, void,
 	private_backend_manager_t *this, backend_t *backend)
 {
 	this->lock->write_lock(this->lock);
 	this->backends->remove(this->backends, backend, NULL);
 	this->lock->unlock(this->lock);
+	flush_cache(this);
 }
 
 METHOD(backend_manager_t, add_backend, void,
@@ -415,11 +608,15 @@ METHOD(backend_manager_t, add_backend, void,
 	this->lock->write_lock(this->lock);
 	this->backends->insert_last(this->backends, backend);
 	this->lock->unlock(this->lock);
+	flush_cache(this);
 }
 
 METHOD(backend_manager_t, destroy, void,
 	private_backend_manager_t *this)
 {
+	flush_cache(this);
+	this->cache->destroy(this->cache);
+	this->cache_lock->destroy(this->cache_lock);
 	this->backends->destroy(this->backends);
 	this->lock->destroy(this->lock);
 	free(this);
@@ -440,10 +637,17 @@ backend_manager_t *backend_manager_create()
 			.create_peer_cfg_enumerator = _create_peer_cfg_enumerator,
 			.add_backend = _add_backend,
 			.remove_backend = _remove_backend,
+			.flush_cache = _flush_cache,
 			.destroy = _destroy,
 		},
 		.backends = linked_list_create(),
 		.lock = rwlock_create(RWLOCK_TYPE_DEFAULT),
+		.cache = hashtable_create((hashtable_hash_t)cache_hash,
+								  (hashtable_equals_t)cache_equals, 8),
+		.cache_lock = mutex_create(MUTEX_TYPE_DEFAULT),
+		.cache_size = lib->settings->get_int(lib->settings,
+								"%s.ike_cfg_cache_size",
+								DEFAULT_IKE_CFG_CACHE_SIZE, lib->ns),
 	);
 
 	return &this->public;
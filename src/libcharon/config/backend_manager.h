@@ -101,6 +101,15 @@ struct backend_manager_t {
 	 */
 	void (*remove_backend)(backend_manager_t *this, backend_t *backend);
 
+	/**
+	 * Flush the cache of resolved config lookups.
+	 *
+	 * The manager caches the result of IKE config lookups by peer address.
+	 * Backends serving a mutable set of configs must invoke this whenever
+	 * their configs change, so that cached results do not get stale.
+	 */
+	void (*flush_cache)(backend_manager_t *this);
+
 	/**
 	 * Destroys a backend_manager_t object.
 	 */
@@ -0,0 +1,202 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Copyright (C) 2015 revosec AG
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include "cfg_intern.h"
+
+#include <collections/hashtable.h>
+#include <threading/mutex.h>
+
+/**
+ * Mutex protecting both pools
+ */
+static mutex_t *mutex;
+
+/**
+ * Pool of canonical proposals
+ */
+static hashtable_t *proposals;
+
+/**
+ * Pool of canonical traffic selectors
+ */
+static hashtable_t *selectors;
+
+/**
+ * Hashtable hash function for proposals
+ */
+static u_int hash_proposal(proposal_t *proposal)
+{
+	transform_type_t types[] = {
+		ENCRYPTION_ALGORITHM, INTEGRITY_ALGORITHM, PSEUDO_RANDOM_FUNCTION,
+		DIFFIE_HELLMAN_GROUP, EXTENDED_SEQUENCE_NUMBERS,
+	};
+	enumerator_t *enumerator;
+	u_int16_t alg, key_size;
+	u_int hash;
+	int i;
+
+	hash = proposal->get_protocol(proposal);
+	for (i = 0; i < countof(types); i++)
+	{
+		enumerator = proposal->create_enumerator(proposal, types[i]);
+		while (enumerator->enumerate(enumerator, &alg, &key_size))
+		{
+			hash = chunk_hash_inc(chunk_from_thing(alg),
+					chunk_hash_inc(chunk_from_thing(key_size), hash));
+		}
+		enumerator->destroy(enumerator);
+	}
+	return hash;
+}
+
+/**
+ * Hashtable equals function for proposals
+ */
+static bool equals_proposal(proposal_t *a, proposal_t *b)
+{
+	/* equals() compares the transforms only, but a shared instance must
+	 * additionally agree in all other properties a config hands out */
+	return a->get_protocol(a) == b->get_protocol(b) &&
+		   a->get_number(a) == b->get_number(b) &&
+		   a->get_spi(a) == b->get_spi(b) &&
+		   a->equals(a, b);
+}
+
+/**
+ * Hashtable hash function for traffic selectors
+ */
+static u_int hash_ts(traffic_selector_t *ts)
+{
+	return ts->hash(ts, 0);
+}
+
+/**
+ * Hashtable equals function for traffic selectors
+ */
+static bool equals_ts(traffic_selector_t *a, traffic_selector_t *b)
+{
+	/* never conflate a dynamic selector with its current address range */
+	return a->is_dynamic(a) == b->is_dynamic(b) &&
+		   a->equals(a, b);
+}
+
+/*
+ * Described in header
+ */
+proposal_t *cfg_intern_proposal(proposal_t *proposal)
+{
+	proposal_t *found;
+
+	if (!mutex)
+	{	/* pools not initialized, keep the private instance */
+		return proposal;
+	}
+	mutex->lock(mutex);
+	found = proposals->get(proposals, proposal);
+	if (found)
+	{
+		found = found->get_ref(found);
+	}
+	else
+	{	/* the pool keeps its own reference to the canonical instance */
+		proposals->put(proposals, proposal, proposal->get_ref(proposal));
+	}
+	mutex->unlock(mutex);
+
+	if (found)
+	{
+		proposal->destroy(proposal);
+		return found;
+	}
+	return proposal;
+}
+
+/*
+ * Described in header
+ */
+traffic_selector_t *cfg_intern_ts(traffic_selector_t *ts)
+{
+	traffic_selector_t *found;
+
+	if (!mutex)
+	{
+		return ts;
+	}
+	mutex->lock(mutex);
+	found = selectors->get(selectors, ts);
+	if (found)
+	{
+		found = found->get_ref(found);
+	}
+	else
+	{
+		selectors->put(selectors, ts, ts->get_ref(ts));
+	}
+	mutex->unlock(mutex);
+
+	if (found)
+	{
+		ts->destroy(ts);
+		return found;
+	}
+	return ts;
+}
+
+/*
+ * Described in header
+ */
+void cfg_intern_init()
+{
+	mutex = mutex_create(MUTEX_TYPE_DEFAULT);
+	proposals = hashtable_create((hashtable_hash_t)hash_proposal,
+								 (hashtable_equals_t)equals_proposal, 32);
+	selectors = hashtable_create((hashtable_hash_t)hash_ts,
+								 (hashtable_equals_t)equals_ts, 32);
+}
+
+/*
+ * Described in header
+ */
+void cfg_intern_deinit()
+{
+	enumerator_t *enumerator;
+	traffic_selector_t *ts;
+	proposal_t *proposal;
+
+	if (!mutex)
+	{
+		return;
+	}
+	enumerator = proposals->create_enumerator(proposals);
+	while (enumerator->enumerate(enumerator, NULL, (void**)&proposal))
+	{
+		proposal->destroy(proposal);
+	}
+	enumerator->destroy(enumerator);
+	proposals->destroy(proposals);
+	proposals = NULL;
+
+	enumerator = selectors->create_enumerator(selectors);
+	while (enumerator->enumerate(enumerator, NULL, (void**)&ts))
+	{
+		ts->destroy(ts);
+	}
+	enumerator->destroy(enumerator);
+	selectors->destroy(selectors);
+	selectors = NULL;
+
+	mutex->destroy(mutex);
+	mutex = NULL;
+}
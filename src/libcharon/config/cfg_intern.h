@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Copyright (C) 2015 revosec AG
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/**
+ * @defgroup cfg_intern cfg_intern
+ * @{ @ingroup config
+ */
+
+#ifndef CFG_INTERN_H_
+#define CFG_INTERN_H_
+
+#include <config/proposal.h>
+#include <selectors/traffic_selector.h>
+
+/**
+ * Intern a proposal, sharing a single instance between equal configs.
+ *
+ * Takes ownership of the passed proposal and returns a reference to a
+ * canonical instance with the same content, which may be the passed object
+ * itself. The returned instance is shared and must not get modified; it
+ * gets released through its regular destroy() method.
+ *
+ * @param proposal		proposal to intern, gets owned
+ * @return				canonical shared instance
+ */
+proposal_t *cfg_intern_proposal(proposal_t *proposal);
+
+/**
+ * Intern a traffic selector, sharing a single instance between equal configs.
+ *
+ * Behaves like cfg_intern_proposal(), but for traffic selectors.
+ *
+ * @param ts			traffic selector to intern, gets owned
+ * @return				canonical shared instance
+ */
+traffic_selector_t *cfg_intern_ts(traffic_selector_t *ts);
+
+/**
+ * Initialize the intern pools, called by libcharon_init().
+ */
+void cfg_intern_init();
+
+/**
+ * Release the intern pools and their canonical instances.
+ */
+void cfg_intern_deinit();
+
+#endif /** CFG_INTERN_H_ @}*/
@@ -16,10 +16,12 @@
  */
 
 #include "child_cfg.h"
+#include "cfg_intern.h"
 
 #include <stdint.h>
 
 #include <daemon.h>
+#include <collections/array.h>
 
 ENUM(action_names, ACTION_NONE, ACTION_RESTART,
 	"clear",
@@ -146,6 +148,11 @@ struct private_child_cfg_t {
 	 * anti-replay window size
 	 */
 	u_int32_t replay_window;
+
+	/**
+	 * offload SAs to hardware, if supported
+	 */
+	bool hw_offload;
 };
 
 METHOD(child_cfg_t, get_name, char*,
@@ -159,7 +166,8 @@ METHOD(child_cfg_t, add_proposal, void,
 {
 	if (proposal)
 	{
-		this->proposals->insert_last(this->proposals, proposal);
+		this->proposals->insert_last(this->proposals,
+									 cfg_intern_proposal(proposal));
 	}
 }
 
@@ -248,6 +256,7 @@ METHOD(child_cfg_t, select_proposal, proposal_t*,
 METHOD(child_cfg_t, add_traffic_selector, void,
 	private_child_cfg_t *this, bool local, traffic_selector_t *ts)
 {
+	ts = cfg_intern_ts(ts);
 	if (local)
 	{
 		this->my_ts->insert_last(this->my_ts, ts);
@@ -258,12 +267,236 @@ METHOD(child_cfg_t, add_traffic_selector, void,
 	}
 }
 
+
+/**
+ * Entry in a sorted index over supplied traffic selectors
+ */
+typedef struct {
+	/** supplied traffic selector */
+	traffic_selector_t *ts;
+	/** position in the supplied list, to keep the result order stable */
+	int pos;
+} ts_entry_t;
+
+/**
+ * Sort index entries like traffic_selector_cmp, stable by list position
+ */
+static int ts_entry_sort(const void *a_pub, const void *b_pub, void *user)
+{
+	const ts_entry_t *a = a_pub, *b = b_pub;
+	int res;
+
+	res = traffic_selector_cmp(a->ts, b->ts, NULL);
+	if (res)
+	{
+		return res;
+	}
+	return a->pos - b->pos;
+}
+
+/**
+ * Entry for a matching subset, with the position of the supplied selector
+ */
+typedef struct {
+	/** narrowed subset */
+	traffic_selector_t *ts;
+	/** position of the matched selector in the supplied list */
+	int pos;
+} ts_match_t;
+
+/**
+ * Sort matching subsets back into the order the peer supplied them
+ */
+static int ts_match_sort(const void *a_pub, const void *b_pub, void *user)
+{
+	const ts_match_t *a = a_pub, *b = b_pub;
+
+	return a->pos - b->pos;
+}
+
+/**
+ * Select subsets of derived and supplied selectors using a sorted index
+ * over the supplied list, pruning non-overlapping address ranges instead
+ * of doing a full pairwise comparison.
+ */
+static void select_ts_subsets(linked_list_t *derived, linked_list_t *supplied,
+							  linked_list_t *result)
+{
+	enumerator_t *e1, *e2;
+	traffic_selector_t *ts1, *ts2, *selected;
+	array_t *index, *matches;
+	ts_entry_t entry;
+	ts_match_t match;
+	chunk_t *maxs, from, to;
+	int i, pos = 0, count, lo, hi, mid, start, end;
+
+	if (derived->get_count(derived) * supplied->get_count(supplied) <= 16)
+	{	/* don't bother with indexing small lists */
+		e1 = derived->create_enumerator(derived);
+		e2 = supplied->create_enumerator(supplied);
+		while (e1->enumerate(e1, &ts1))
+		{
+			while (e2->enumerate(e2, &ts2))
+			{
+				selected = ts1->get_subset(ts1, ts2);
+				if (selected)
+				{
+					DBG2(DBG_CFG, " config: %R, received: %R => match: %R",
+						 ts1, ts2, selected);
+					result->insert_last(result, selected);
+				}
+				else
+				{
+					DBG2(DBG_CFG, " config: %R, received: %R => no match",
+						 ts1, ts2);
+				}
+			}
+			supplied->reset_enumerator(supplied, e2);
+		}
+		e1->destroy(e1);
+		e2->destroy(e2);
+		return;
+	}
+
+	index = array_create(sizeof(ts_entry_t), 0);
+	e2 = supplied->create_enumerator(supplied);
+	while (e2->enumerate(e2, &ts2))
+	{
+		entry = (ts_entry_t){ .ts = ts2, .pos = pos++ };
+		array_insert(index, ARRAY_TAIL, &entry);
+	}
+	e2->destroy(e2);
+	array_sort(index, ts_entry_sort, NULL);
+
+	/* running maximum of to-addresses, restarted for each selector type,
+	 * the equivalent of the subtree maximum in an interval tree */
+	count = array_count(index);
+	maxs = malloc(count * sizeof(chunk_t));
+	for (i = 0; i < count; i++)
+	{
+		array_get(index, i, &entry);
+		to = entry.ts->get_to_address(entry.ts);
+		if (i)
+		{
+			array_get(index, i - 1, &entry);
+			if (maxs[i - 1].len == to.len &&
+				chunk_compare(maxs[i - 1], to) > 0)
+			{
+				to = maxs[i - 1];
+			}
+		}
+		maxs[i] = to;
+	}
+
+	matches = array_create(sizeof(ts_match_t), 0);
+	e1 = derived->create_enumerator(derived);
+	while (e1->enumerate(e1, &ts1))
+	{
+		from = ts1->get_from_address(ts1);
+		to = ts1->get_to_address(ts1);
+
+		/* find the subrange of entries with the same address family */
+		lo = 0;
+		hi = count;
+		while (lo < hi)
+		{
+			mid = (lo + hi) / 2;
+			array_get(index, mid, &entry);
+			if (entry.ts->get_from_address(entry.ts).len < from.len)
+			{
+				lo = mid + 1;
+			}
+			else
+			{
+				hi = mid;
+			}
+		}
+		start = lo;
+		hi = count;
+		while (lo < hi)
+		{
+			mid = (lo + hi) / 2;
+			array_get(index, mid, &entry);
+			if (entry.ts->get_from_address(entry.ts).len <= from.len)
+			{
+				lo = mid + 1;
+			}
+			else
+			{
+				hi = mid;
+			}
+		}
+		end = lo;
+
+		/* skip entries whose ranges all end before this selector starts */
+		lo = start;
+		hi = end;
+		while (lo < hi)
+		{
+			mid = (lo + hi) / 2;
+			if (maxs[mid].len == from.len &&
+				chunk_compare(maxs[mid], from) < 0)
+			{
+				lo = mid + 1;
+			}
+			else
+			{
+				hi = mid;
+			}
+		}
+		start = lo;
+		/* skip entries starting after this selector ends */
+		hi = end;
+		while (lo < hi)
+		{
+			mid = (lo + hi) / 2;
+			array_get(index, mid, &entry);
+			if (chunk_compare(entry.ts->get_from_address(entry.ts), to) <= 0)
+			{
+				lo = mid + 1;
+			}
+			else
+			{
+				hi = mid;
+			}
+		}
+		end = lo;
+
+		for (i = start; i < end; i++)
+		{
+			array_get(index, i, &entry);
+			selected = ts1->get_subset(ts1, entry.ts);
+			if (selected)
+			{
+				DBG2(DBG_CFG, " config: %R, received: %R => match: %R",
+					 ts1, entry.ts, selected);
+				match = (ts_match_t){ .ts = selected, .pos = entry.pos };
+				array_insert(matches, ARRAY_TAIL, &match);
+			}
+		}
+		array_sort(matches, ts_match_sort, NULL);
+		for (i = 0; i < array_count(matches); i++)
+		{
+			array_get(matches, i, &match);
+			result->insert_last(result, match.ts);
+		}
+		while (array_remove(matches, ARRAY_TAIL, NULL))
+		{
+			/* clear for the next derived selector */
+		}
+	}
+	e1->destroy(e1);
+	array_destroy(matches);
+	array_destroy(index);
+	free(maxs);
+}
+
 METHOD(child_cfg_t, get_traffic_selectors, linked_list_t*,
 	private_child_cfg_t *this, bool local, linked_list_t *supplied,
 	linked_list_t *hosts)
 {
 	enumerator_t *e1, *e2;
-	traffic_selector_t *ts1, *ts2, *selected;
+	traffic_selector_t *ts1, *ts2;
 	linked_list_t *result, *derived;
 	host_t *host;
 
@@ -312,31 +545,7 @@ METHOD(child_cfg_t, get_traffic_selectors, linked_list_t*,
 	}
 	else
 	{
-		e1 = derived->create_enumerator(derived);
-		e2 = supplied->create_enumerator(supplied);
-		/* enumerate all configured/derived selectors */
-		while (e1->enumerate(e1, &ts1))
-		{
-			/* enumerate all supplied traffic selectors */
-			while (e2->enumerate(e2, &ts2))
-			{
-				selected = ts1->get_subset(ts1, ts2);
-				if (selected)
-				{
-					DBG2(DBG_CFG, " config: %R, received: %R => match: %R",
-						 ts1, ts2, selected);
-					result->insert_last(result, selected);
-				}
-				else
-				{
-					DBG2(DBG_CFG, " config: %R, received: %R => no match",
-						 ts1, ts2);
-				}
-			}
-			supplied->reset_enumerator(supplied, e2);
-		}
-		e1->destroy(e1);
-		e2->destroy(e2);
+		select_ts_subsets(derived, supplied, result);
 
 		/* check if we/peer did any narrowing, raise alert */
 		e1 = derived->create_enumerator(derived);
@@ -512,6 +721,18 @@ METHOD(child_cfg_t, set_replay_window, void,
 	this->replay_window = replay_window;
 }
 
+METHOD(child_cfg_t, use_hw_offload, bool,
+	private_child_cfg_t *this)
+{
+	return this->hw_offload;
+}
+
+METHOD(child_cfg_t, set_hw_offload, void,
+	private_child_cfg_t *this, bool hw_offload)
+{
+	this->hw_offload = hw_offload;
+}
+
 METHOD(child_cfg_t, set_mipv6_options, void,
 	private_child_cfg_t *this, bool proxy_mode, bool install_policy)
 {
@@ -591,6 +812,8 @@ child_cfg_t *child_cfg_create(char *name, lifetime_cfg_t *lifetime,
 			.get_tfc = _get_tfc,
 			.get_replay_window = _get_replay_window,
 			.set_replay_window = _set_replay_window,
+			.use_hw_offload = _use_hw_offload,
+			.set_hw_offload = _set_hw_offload,
 			.use_proxy_mode = _use_proxy_mode,
 			.install_policy = _install_policy,
 			.get_ref = _get_ref,
@@ -248,6 +248,21 @@ struct child_cfg_t {
 	 */
 	void (*set_replay_window)(child_cfg_t *this, u_int32_t window);
 
+	/**
+	 * Check whether SAs should be offloaded to hardware, if supported.
+	 *
+	 * @return				TRUE, if SAs should be offloaded
+	 *						FALSE, otherwise
+	 */
+	bool (*use_hw_offload)(child_cfg_t *this);
+
+	/**
+	 * Set whether SAs should be offloaded to hardware, if supported.
+	 *
+	 * @param hw_offload	TRUE to offload SAs (default FALSE)
+	 */
+	void (*set_hw_offload)(child_cfg_t *this, bool hw_offload);
+
 	/**
 	 * Sets two options needed for Mobile IPv6 interoperability.
 	 *
@@ -18,6 +18,7 @@
 #include <string.h>
 
 #include "ike_cfg.h"
+#include "cfg_intern.h"
 
 #include <daemon.h>
 
@@ -283,7 +284,8 @@ METHOD(ike_cfg_t, add_proposal, void,
 {
 	if (proposal)
 	{
-		this->proposals->insert_last(this->proposals, proposal);
+		this->proposals->insert_last(this->proposals,
+									 cfg_intern_proposal(proposal));
 	}
 }
 
@@ -66,6 +66,16 @@ struct private_proposal_t {
 	 * Proposal number
 	 */
 	u_int number;
+
+	/**
+	 * Summary bitsets over transforms, indexed by transform type
+	 */
+	u_int64_t bitsets[EXTENDED_SEQUENCE_NUMBERS];
+
+	/**
+	 * Reference counter
+	 */
+	refcount_t refcount;
 };
 
 /**
@@ -80,6 +90,42 @@ typedef struct {
 	u_int16_t key_size;
 } entry_t;
 
+/**
+ * Map a transform to a bit in the per-type summary bitset.
+ *
+ * Equal algorithm/key size pairs map to equal bits, so an empty bitset
+ * intersection proves that no exact transform match exists.
+ */
+static u_int64_t transform_bit(u_int16_t alg, u_int16_t key_size)
+{
+	u_int32_t hash;
+
+	hash = (((u_int32_t)alg << 16) | key_size) * 2654435761u;
+	return 1ULL << (hash >> 26);
+}
+
+/**
+ * Recompile the summary bitsets from the transform list
+ */
+static void compile_bitsets(private_proposal_t *this)
+{
+	enumerator_t *enumerator;
+	entry_t *entry;
+
+	memset(this->bitsets, 0, sizeof(this->bitsets));
+	enumerator = array_create_enumerator(this->transforms);
+	while (enumerator->enumerate(enumerator, &entry))
+	{
+		if (entry->type >= ENCRYPTION_ALGORITHM &&
+			entry->type <= EXTENDED_SEQUENCE_NUMBERS)
+		{
+			this->bitsets[entry->type - 1] |= transform_bit(entry->alg,
+															entry->key_size);
+		}
+	}
+	enumerator->destroy(enumerator);
+}
+
 METHOD(proposal_t, add_algorithm, void,
 	private_proposal_t *this, transform_type_t type,
 	u_int16_t alg, u_int16_t key_size)
@@ -91,6 +137,20 @@ METHOD(proposal_t, add_algorithm, void,
 	};
 
 	array_insert(this->transforms, ARRAY_TAIL, &entry);
+	if (type >= ENCRYPTION_ALGORITHM && type <= EXTENDED_SEQUENCE_NUMBERS)
+	{
+		this->bitsets[type - 1] |= transform_bit(alg, key_size);
+	}
+}
+
+METHOD(proposal_t, get_transform_bits, u_int64_t,
+	private_proposal_t *this, transform_type_t type)
+{
+	if (type >= ENCRYPTION_ALGORITHM && type <= EXTENDED_SEQUENCE_NUMBERS)
+	{
+		return this->bitsets[type - 1];
+	}
+	return 0;
 }
 
 /**
@@ -183,6 +243,7 @@ METHOD(proposal_t, strip_dh, void,
 		}
 	}
 	enumerator->destroy(enumerator);
+	compile_bitsets(this);
 }
 
 /**
@@ -268,12 +329,36 @@ METHOD(proposal_t, select_proposal, proposal_t*,
 
 	DBG2(DBG_CFG, "selecting proposal:");
 
+	/* types that require an exact transform match if both sides propose any;
+	 * integrity is excluded, as AEAD proposals pass without a match */
+	static const transform_type_t strict_types[] = {
+		ENCRYPTION_ALGORITHM,
+		PSEUDO_RANDOM_FUNCTION,
+		DIFFIE_HELLMAN_GROUP,
+		EXTENDED_SEQUENCE_NUMBERS,
+	};
+	u_int64_t ours, theirs;
+	int i;
+
 	if (this->protocol != other->get_protocol(other))
 	{
 		DBG2(DBG_CFG, "  protocol mismatch, skipping");
 		return NULL;
 	}
 
+	/* quickly reject proposals using the precompiled transform bitsets */
+	for (i = 0; i < countof(strict_types); i++)
+	{
+		ours = this->bitsets[strict_types[i] - 1];
+		theirs = other->get_transform_bits(other, strict_types[i]);
+		if (ours && theirs && !(ours & theirs))
+		{
+			DBG2(DBG_CFG, "  no acceptable %N found",
+				 transform_type_names, strict_types[i]);
+			return NULL;
+		}
+	}
+
 	selected = proposal_create(this->protocol, other->get_number(other));
 
 	if (!select_algo(this, other, selected, ENCRYPTION_ALGORITHM, private) ||
@@ -387,6 +472,7 @@ METHOD(proposal_t, clone_, proposal_t*,
 
 	clone->spi = this->spi;
 	clone->number = this->number;
+	compile_bitsets(clone);
 
 	return &clone->public;
 }
@@ -472,6 +558,7 @@ static void check_proposal(private_proposal_t *this)
 				}
 			}
 			e->destroy(e);
+			compile_bitsets(this);
 		}
 	}
 
@@ -588,11 +675,21 @@ int proposal_printf_hook(printf_hook_data_t *data, printf_hook_spec_t *spec,
 	return written;
 }
 
+METHOD(proposal_t, get_ref, proposal_t*,
+	private_proposal_t *this)
+{
+	ref_get(&this->refcount);
+	return &this->public;
+}
+
 METHOD(proposal_t, destroy, void,
 	private_proposal_t *this)
 {
-	array_destroy(this->transforms);
-	free(this);
+	if (ref_put(&this->refcount))
+	{
+		array_destroy(this->transforms);
+		free(this);
+	}
 }
 
 /*
@@ -609,6 +706,7 @@ proposal_t *proposal_create(protocol_id_t protocol, u_int number)
 			.get_algorithm = _get_algorithm,
 			.has_dh_group = _has_dh_group,
 			.strip_dh = _strip_dh,
+			.get_transform_bits = _get_transform_bits,
 			.select = _select_proposal,
 			.get_protocol = _get_protocol,
 			.set_spi = _set_spi,
@@ -616,11 +714,13 @@ proposal_t *proposal_create(protocol_id_t protocol, u_int number)
 			.get_number = _get_number,
 			.equals = _equals,
 			.clone = _clone_,
+			.get_ref = _get_ref,
 			.destroy = _destroy,
 		},
 		.protocol = protocol,
 		.number = number,
 		.transforms = array_create(sizeof(entry_t), 0),
+		.refcount = 1,
 	);
 
 	return &this->public;
@@ -116,6 +116,19 @@ struct proposal_t {
 	 */
 	void (*strip_dh)(proposal_t *this, diffie_hellman_group_t keep);
 
+	/**
+	 * Get a bitset summarizing the transforms of a given type.
+	 *
+	 * Each algorithm/key size pair deterministically maps to one of 64 bits,
+	 * so a disjoint bitset intersection proves that two proposals have no
+	 * transform of that type in common. A non-empty intersection is a hint
+	 * only, as different transforms may map to the same bit.
+	 *
+	 * @param type			kind of algorithm to summarize
+	 * @return				bitset over transforms of the given type
+	 */
+	u_int64_t (*get_transform_bits)(proposal_t *this, transform_type_t type);
+
 	/**
 	 * Compare two proposal, and select a matching subset.
 	 *
@@ -173,7 +186,16 @@ struct proposal_t {
 	proposal_t *(*clone) (proposal_t *this);
 
 	/**
-	 * Destroys the proposal object.
+	 * Get an additional reference to this proposal.
+	 *
+	 * The proposal must not get modified while multiple references exist.
+	 *
+	 * @return				this, with an increased refcount
+	 */
+	proposal_t* (*get_ref)(proposal_t *this);
+
+	/**
+	 * Destroys the proposal object, or releases a reference to it.
 	 */
 	void (*destroy) (proposal_t *this);
 };
@@ -26,10 +26,14 @@
 #include <threading/thread.h>
 #include <threading/spinlock.h>
 #include <threading/semaphore.h>
+#include <threading/mutex.h>
+#include <threading/condvar.h>
+#include <processing/jobs/callback_job.h>
 
 typedef struct private_controller_t private_controller_t;
 typedef struct interface_listener_t interface_listener_t;
 typedef struct interface_logger_t interface_logger_t;
+typedef struct interface_job_t interface_job_t;
 
 /**
  * Private data of an stroke_t object.
@@ -116,10 +120,33 @@ struct interface_listener_t {
 	 * spinlock to update the IKE_SA handle properly
 	 */
 	spinlock_t *lock;
-};
 
+	/**
+	 * TRUE for asynchronous operations with completion callback
+	 */
+	bool async;
+
+	/**
+	 * TRUE once the completion of an asynchronous operation got scheduled
+	 */
+	bool completed;
+
+	/**
+	 * completion callback for asynchronous operations
+	 */
+	controller_done_cb_t done_cb;
+
+	/**
+	 * user parameter to pass to done_cb
+	 */
+	void *done_param;
+
+	/**
+	 * associated job, to release the async completion reference
+	 */
+	interface_job_t *job;
+};
 
-typedef struct interface_job_t interface_job_t;
 
 /**
  * job for asynchronous listen operations
@@ -144,12 +171,60 @@ struct interface_job_t {
 	refcount_t refcount;
 };
 
+METHOD(job_t, destroy_job, void,
+	interface_job_t *this)
+{
+	if (ref_put(&this->refcount))
+	{
+		this->listener.lock->destroy(this->listener.lock);
+		DESTROY_IF(this->listener.done);
+		free(this);
+	}
+}
+
+/**
+ * Unregister an asynchronous operation and invoke its completion callback.
+ *
+ * Runs as separate job, as the listener may not get unregistered and freed
+ * while bus threads are still dispatching to it.
+ */
+static job_requeue_t complete_async(interface_job_t *job)
+{
+	interface_listener_t *listener = &job->listener;
+
+	charon->bus->remove_listener(charon->bus, &listener->public);
+	if (listener->done_cb)
+	{
+		listener->done_cb(listener->done_param, listener->status);
+	}
+	return JOB_REQUEUE_NONE;
+}
+
 /**
  * This function wakes a thread that is waiting in wait_for_listener(),
- * either from a listener or from a job.
+ * either from a listener or from a job. For asynchronous operations, it
+ * schedules completion instead.
  */
 static inline bool listener_done(interface_listener_t *listener)
 {
+	if (listener->async)
+	{
+		bool first;
+
+		listener->lock->lock(listener->lock);
+		first = !listener->completed;
+		listener->completed = TRUE;
+		listener->lock->unlock(listener->lock);
+
+		if (first)
+		{
+			lib->processor->queue_job(lib->processor,
+				(job_t*)callback_job_create((callback_job_cb_t)complete_async,
+								listener->job, (callback_job_cleanup_t)destroy_job,
+								NULL));
+		}
+		return FALSE;
+	}
 	if (listener->done)
 	{
 		listener->done->post(listener->done);
@@ -326,17 +401,6 @@ METHOD(listener_t, child_state_change, bool,
 	return TRUE;
 }
 
-METHOD(job_t, destroy_job, void,
-	interface_job_t *this)
-{
-	if (ref_put(&this->refcount))
-	{
-		this->listener.lock->destroy(this->listener.lock);
-		DESTROY_IF(this->listener.done);
-		free(this);
-	}
-}
-
 METHOD(controller_t, create_ike_sa_enumerator, enumerator_t*,
 	private_controller_t *this, bool wait)
 {
@@ -632,6 +696,145 @@ METHOD(controller_t, terminate_child, status_t,
 	return status;
 }
 
+/**
+ * Create a job for an asynchronous operation, tracking completion over bus
+ * state change events
+ */
+static interface_job_t *create_async_job(void *execute,
+									controller_done_cb_t done, void *param)
+{
+	interface_job_t *job;
+
+	INIT(job,
+		.listener = {
+			.public = {
+				.ike_state_change = _ike_state_change,
+				.child_state_change = _child_state_change,
+			},
+			.logger = {
+				.public = {
+					.log = _listener_log,
+					.get_level = _listener_get_level,
+				},
+				/* no log streaming, but track completion over state changes */
+				.callback = controller_cb_empty,
+			},
+			.status = FAILED,
+			.async = TRUE,
+			.done_cb = done,
+			.done_param = param,
+			.lock = spinlock_create(),
+		},
+		.public = {
+			.execute = execute,
+			.get_priority = _get_priority_medium,
+			.destroy = _destroy_job,
+		},
+		/* one reference for the executing job, one for the completion job */
+		.refcount = 2,
+	);
+	job->listener.logger.listener = &job->listener;
+	job->listener.job = job;
+	return job;
+}
+
+METHOD(controller_t, initiate_async, void,
+	private_controller_t *this, peer_cfg_t *peer_cfg, child_cfg_t *child_cfg,
+	controller_done_cb_t done, void *param)
+{
+	interface_job_t *job;
+
+	job = create_async_job(_initiate_execute, done, param);
+	job->listener.peer_cfg = peer_cfg;
+	job->listener.child_cfg = child_cfg;
+
+	charon->bus->add_listener(charon->bus, &job->listener.public);
+	lib->processor->queue_job(lib->processor, &job->public);
+}
+
+METHOD(controller_t, terminate_ike_async, void,
+	private_controller_t *this, u_int32_t unique_id,
+	controller_done_cb_t done, void *param)
+{
+	interface_job_t *job;
+
+	job = create_async_job(_terminate_ike_execute, done, param);
+	job->listener.id = unique_id;
+
+	charon->bus->add_listener(charon->bus, &job->listener.public);
+	lib->processor->queue_job(lib->processor, &job->public);
+}
+
+/**
+ * State shared between a bulk initiation and its completion callbacks
+ */
+typedef struct {
+	/** lock for counters */
+	mutex_t *mutex;
+	/** condvar to wait for completed initiations */
+	condvar_t *condvar;
+	/** number of initiations in flight */
+	u_int outstanding;
+	/** number of failed initiations */
+	u_int failed;
+} bulk_data_t;
+
+/**
+ * Completion callback of a single initiation in a bulk
+ */
+static void bulk_done(bulk_data_t *data, status_t status)
+{
+	data->mutex->lock(data->mutex);
+	if (status != SUCCESS)
+	{
+		data->failed++;
+	}
+	data->outstanding--;
+	data->condvar->signal(data->condvar);
+	data->mutex->unlock(data->mutex);
+}
+
+METHOD(controller_t, initiate_bulk, u_int,
+	private_controller_t *this, enumerator_t *cfgs, u_int window)
+{
+	bulk_data_t data = {
+		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+		.condvar = condvar_create(CONDVAR_TYPE_DEFAULT),
+	};
+	peer_cfg_t *peer_cfg;
+	child_cfg_t *child_cfg;
+	u_int failed;
+
+	window = max(window, 1);
+
+	while (cfgs->enumerate(cfgs, &peer_cfg, &child_cfg))
+	{
+		data.mutex->lock(data.mutex);
+		while (data.outstanding >= window)
+		{
+			data.condvar->wait(data.condvar, data.mutex);
+		}
+		data.outstanding++;
+		data.mutex->unlock(data.mutex);
+
+		initiate_async(this, peer_cfg, child_cfg,
+					   (controller_done_cb_t)bulk_done, &data);
+	}
+
+	data.mutex->lock(data.mutex);
+	while (data.outstanding)
+	{
+		data.condvar->wait(data.condvar, data.mutex);
+	}
+	failed = data.failed;
+	data.mutex->unlock(data.mutex);
+
+	data.condvar->destroy(data.condvar);
+	data.mutex->destroy(data.mutex);
+
+	return failed;
+}
+
 /**
  * See header
  */
@@ -658,7 +861,10 @@ controller_t *controller_create(void)
 		.public = {
 			.create_ike_sa_enumerator = _create_ike_sa_enumerator,
 			.initiate = _initiate,
+			.initiate_async = _initiate_async,
+			.initiate_bulk = _initiate_bulk,
 			.terminate_ike = _terminate_ike,
+			.terminate_ike_async = _terminate_ike_async,
 			.terminate_child = _terminate_child,
 			.destroy = _destroy,
 		},
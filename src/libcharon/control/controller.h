@@ -45,6 +45,17 @@ typedef bool (*controller_cb_t)(void* param, debug_t group, level_t level,
 bool controller_cb_empty(void *param, debug_t group, level_t level,
 						 ike_sa_t *ike_sa, const char *message);
 
+/**
+ * Callback to notify completion of an asynchronous controller operation.
+ *
+ * The callback is invoked by a worker thread once the initiated operation
+ * reached a final state.
+ *
+ * @param param			parameter supplied when starting the operation
+ * @param status		result of the operation
+ */
+typedef void (*controller_done_cb_t)(void *param, status_t status);
+
 typedef struct controller_t controller_t;
 
 /**
@@ -92,6 +103,36 @@ struct controller_t {
 						 peer_cfg_t *peer_cfg, child_cfg_t *child_cfg,
 						 controller_cb_t callback, void *param, u_int timeout);
 
+	/**
+	 * Initiate a CHILD_SA without blocking the calling thread.
+	 *
+	 * The call returns immediately; once the CHILD_SA is established or its
+	 * setup failed, the completion callback gets invoked with the result.
+	 *
+	 * @param peer_cfg		peer_cfg to use for IKE_SA setup, gets owned
+	 * @param child_cfg		child_cfg to set up CHILD_SA from, gets owned
+	 * @param done			completion callback to invoke
+	 * @param param			parameter to pass to done
+	 */
+	void (*initiate_async)(controller_t *this,
+						   peer_cfg_t *peer_cfg, child_cfg_t *child_cfg,
+						   controller_done_cb_t done, void *param);
+
+	/**
+	 * Initiate a batch of CHILD_SAs with a window of concurrent exchanges.
+	 *
+	 * Enumerates peer/child config pairs, keeping up to window initiations
+	 * in flight concurrently, and blocks until all of them have completed.
+	 * The enumerated configs get owned, the enumerator stays owned by the
+	 * caller.
+	 *
+	 * @param cfgs			enumerator over (peer_cfg_t*, child_cfg_t*)
+	 * @param window		maximum number of concurrent initiations
+	 * @return				number of failed initiations
+	 */
+	u_int (*initiate_bulk)(controller_t *this, enumerator_t *cfgs,
+						   u_int window);
+
 	/**
 	 * Terminate an IKE_SA and all of its CHILD_SAs.
 	 *
@@ -112,6 +153,19 @@ struct controller_t {
 							  controller_cb_t callback, void *param,
 							  u_int timeout);
 
+	/**
+	 * Terminate an IKE_SA without blocking the calling thread.
+	 *
+	 * The call returns immediately; once the IKE_SA is gone, the completion
+	 * callback gets invoked with the result.
+	 *
+	 * @param unique_id		unique id of the IKE_SA to terminate
+	 * @param done			completion callback to invoke
+	 * @param param			parameter to pass to done
+	 */
+	void (*terminate_ike_async)(controller_t *this, u_int32_t unique_id,
+								controller_done_cb_t done, void *param);
+
 	/**
 	 * Terminate a CHILD_SA.
 	 *
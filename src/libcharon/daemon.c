@@ -32,6 +32,9 @@
 #include <bus/listeners/sys_logger.h>
 #include <bus/listeners/file_logger.h>
 #include <config/proposal.h>
+#include <config/cfg_intern.h>
+#include <encoding/message.h>
+#include <encoding/payloads/payload.h>
 #include <plugins/plugin_feature.h>
 #include <kernel/kernel_handler.h>
 #include <processing/jobs/start_action_job.h>
@@ -324,7 +327,7 @@ static void load_file_logger(private_daemon_t *this, char *filename,
 	file_logger_t *file_logger;
 	debug_t group;
 	level_t def;
-	bool ike_name, flush_line, append;
+	bool ike_name, flush_line, append, async_write;
 	char *time_format;
 
 	time_format = lib->settings->get_str(lib->settings,
@@ -335,10 +338,12 @@ static void load_file_logger(private_daemon_t *this, char *filename,
 						"%s.filelog.%s.flush_line", FALSE, lib->ns, filename);
 	append = lib->settings->get_bool(lib->settings,
 						"%s.filelog.%s.append", TRUE, lib->ns, filename);
+	async_write = lib->settings->get_bool(lib->settings,
+						"%s.filelog.%s.async", FALSE, lib->ns, filename);
 
 	file_logger = add_file_logger(this, filename, current_loggers);
 	file_logger->set_options(file_logger, time_format, ike_name);
-	file_logger->open(file_logger, flush_line, append);
+	file_logger->open(file_logger, flush_line, append, async_write);
 
 	def = lib->settings->get_int(lib->settings, "%s.filelog.%s.default", 1,
 								 lib->ns, filename);
@@ -386,7 +391,7 @@ METHOD(daemon_t, load_loggers, void,
 
 		sys_logger = add_sys_logger(this, "daemon", current_loggers);
 		file_logger = add_file_logger(this, "stdout", current_loggers);
-		file_logger->open(file_logger, FALSE, FALSE);
+		file_logger->open(file_logger, FALSE, FALSE, FALSE);
 
 		for (group = 0; group < DBG_MAX; group++)
 		{
@@ -484,6 +489,9 @@ static void destroy(private_daemon_t *this)
 	DESTROY_IF(this->public.shunts);
 	DESTROY_IF(this->public.child_sa_manager);
 	DESTROY_IF(this->public.ike_sa_manager);
+	DESTROY_IF(this->public.response_cache);
+	DESTROY_IF(this->public.keepalives);
+	DESTROY_IF(this->public.dpd);
 	DESTROY_IF(this->public.controller);
 	DESTROY_IF(this->public.eap);
 	DESTROY_IF(this->public.xauth);
@@ -610,6 +618,7 @@ METHOD(daemon_t, initialize, bool,
 		return FALSE;
 	}
 	this->public.child_sa_manager = child_sa_manager_create();
+	this->public.response_cache = response_cache_create();
 
 	/* Queue start_action job */
 	lib->processor->queue_job(lib->processor, (job_t*)start_action_job_create());
@@ -654,6 +663,8 @@ private_daemon_t *daemon_create()
 	this->public.socket = socket_manager_create();
 	this->public.traps = trap_manager_create();
 	this->public.shunts = shunt_manager_create();
+	this->public.keepalives = keepalive_manager_create();
+	this->public.dpd = dpd_coordinator_create();
 	this->kernel_handler = kernel_handler_create();
 
 	return this;
@@ -674,6 +685,9 @@ void libcharon_deinit()
 	run_scripts(this, "stop");
 
 	destroy(this);
+	message_rules_deinit();
+	payload_pool_deinit();
+	cfg_intern_deinit();
 	charon = NULL;
 }
 
@@ -693,6 +707,15 @@ bool libcharon_init()
 
 	this = daemon_create();
 
+	/* pool frequently used payload objects per thread */
+	payload_pool_init();
+
+	/* share immutable proposal/traffic selector objects between configs */
+	cfg_intern_init();
+
+	/* index the message rule tables for O(1) payload rule lookups */
+	message_rules_init();
+
 	/* for uncritical pseudo random numbers */
 	srandom(time(NULL) + getpid());
 
@@ -159,12 +159,15 @@ typedef struct daemon_t daemon_t;
 #include <network/sender.h>
 #include <network/receiver.h>
 #include <network/socket_manager.h>
+#include <network/response_cache.h>
 #include <control/controller.h>
 #include <bus/bus.h>
 #include <sa/ike_sa_manager.h>
 #include <sa/child_sa_manager.h>
 #include <sa/trap_manager.h>
 #include <sa/shunt_manager.h>
+#include <sa/keepalive_manager.h>
+#include <sa/dpd_coordinator.h>
 #include <config/backend_manager.h>
 #include <sa/eap/eap_manager.h>
 #include <sa/xauth/xauth_manager.h>
@@ -234,6 +237,16 @@ struct daemon_t {
 	 */
 	shunt_manager_t *shunts;
 
+	/**
+	 * Manager emitting NAT-T keepalives for registered IKE_SAs
+	 */
+	keepalive_manager_t *keepalives;
+
+	/**
+	 * Coordinator batching DPD checks over all IKE_SAs
+	 */
+	dpd_coordinator_t *dpd;
+
 	/**
 	 * Manager for the different configuration backends.
 	 */
@@ -249,6 +262,11 @@ struct daemon_t {
 	 */
 	receiver_t *receiver;
 
+	/**
+	 * Cache of generated responses, answering retransmits without an IKE_SA.
+	 */
+	response_cache_t *response_cache;
+
 	/**
 	 * Manager for IKE configuration attributes
 	 */
@@ -49,10 +49,6 @@
  */
 #define GENERATOR_DATA_BUFFER_SIZE 500
 
-/**
- * Number of bytes to increase the buffer, if it is too small.
- */
-#define GENERATOR_DATA_BUFFER_INCREASE_VALUE 500
 
 typedef struct private_generator_t private_generator_t;
 
@@ -113,6 +109,11 @@ struct private_generator_t {
 	 * TRUE, if debug messages should be logged during generation.
 	 */
 	bool debug;
+
+	/**
+	 * Arena the buffer is drawn from, NULL if heap allocated
+	 */
+	arena_t *arena;
 };
 
 /**
@@ -152,13 +153,19 @@ static u_int32_t get_offset(private_generator_t *this)
  */
 static void make_space_available(private_generator_t *this, int bits)
 {
-	while ((get_space(this) * 8 - this->current_bit) < bits)
+	if ((get_space(this) * 8 - this->current_bit) < bits)
 	{
 		int old_buffer_size, new_buffer_size, out_position_offset;
 
-		old_buffer_size = get_size(this);
-		new_buffer_size = old_buffer_size + GENERATOR_DATA_BUFFER_INCREASE_VALUE;
+		old_buffer_size = new_buffer_size = get_size(this);
 		out_position_offset = this->out_position - this->buffer;
+		do
+		{	/* grow geometrically, so even large messages need only a
+			 * handful of reallocations */
+			new_buffer_size *= 2;
+		}
+		while (((new_buffer_size - out_position_offset) * 8 -
+				this->current_bit) < bits);
 
 		if (this->debug)
 		{
@@ -166,7 +173,18 @@ static void make_space_available(private_generator_t *this, int bits)
 				 old_buffer_size, new_buffer_size);
 		}
 
-		this->buffer = realloc(this->buffer,new_buffer_size);
+		if (this->arena)
+		{	/* bump allocators cannot realloc, move to a larger block */
+			u_int8_t *buffer;
+
+			buffer = this->arena->alloc(this->arena, new_buffer_size);
+			memcpy(buffer, this->buffer, out_position_offset);
+			this->buffer = buffer;
+		}
+		else
+		{
+			this->buffer = realloc(this->buffer, new_buffer_size);
+		}
 		this->out_position = (this->buffer + out_position_offset);
 		this->roof_position = (this->buffer + new_buffer_size);
 	}
@@ -440,6 +458,32 @@ METHOD(generator_t, get_chunk, chunk_t,
 	return data;
 }
 
+METHOD(generator_t, skip_bytes, void,
+	private_generator_t *this, size_t bytes)
+{
+	make_space_available(this, bytes * 8);
+	this->out_position += bytes;
+}
+
+METHOD(generator_t, extract_chunk, chunk_t,
+	private_generator_t *this, u_int32_t **lenpos)
+{
+	chunk_t data;
+
+	data = get_chunk(this, lenpos);
+	if (this->arena)
+	{	/* arena memory gets recycled, hand over a copy instead */
+		data = chunk_clone(data);
+		*lenpos = (u_int32_t*)(data.ptr + this->header_length_offset);
+		return data;
+	}
+	/* the buffer is handed over to the caller, detach it */
+	this->buffer = NULL;
+	this->out_position = NULL;
+	this->roof_position = NULL;
+	return data;
+}
+
 METHOD(generator_t, generate_payload, void,
 	private_generator_t *this, payload_t *payload)
 {
@@ -572,7 +616,10 @@ METHOD(generator_t, generate_payload, void,
 METHOD(generator_t, destroy, void,
 	private_generator_t *this)
 {
-	free(this->buffer);
+	if (!this->arena)
+	{
+		free(this->buffer);
+	}
 	free(this);
 }
 
@@ -586,6 +633,8 @@ generator_t *generator_create()
 	INIT(this,
 		.public = {
 			.get_chunk = _get_chunk,
+			.skip_bytes = _skip_bytes,
+			.extract_chunk = _extract_chunk,
 			.generate_payload = _generate_payload,
 			.destroy = _destroy,
 		},
@@ -610,3 +659,19 @@ generator_t *generator_create_no_dbg()
 
 	return &this->public;
 }
+
+/*
+ * Described in header
+ */
+generator_t *generator_create_from_arena(arena_t *arena)
+{
+	private_generator_t *this = (private_generator_t*)generator_create();
+
+	free(this->buffer);
+	this->arena = arena;
+	this->buffer = arena->alloc(arena, GENERATOR_DATA_BUFFER_SIZE);
+	this->out_position = this->buffer;
+	this->roof_position = this->buffer + GENERATOR_DATA_BUFFER_SIZE;
+
+	return &this->public;
+}
@@ -25,6 +25,7 @@
 typedef struct generator_t generator_t;
 
 #include <library.h>
+#include <utils/arena.h>
 #include <encoding/payloads/encodings.h>
 #include <encoding/payloads/payload.h>
 
@@ -59,6 +60,28 @@ struct generator_t {
 	 */
 	chunk_t (*get_chunk) (generator_t *this, u_int32_t **lenpos);
 
+	/**
+	 * Advance the write position without generating data.
+	 *
+	 * Leaves a gap of uninitialized bytes in the buffer, e.g. to reserve
+	 * room for an IV in front of payloads that get encrypted in place.
+	 *
+	 * @param bytes			number of bytes to skip
+	 */
+	void (*skip_bytes) (generator_t *this, size_t bytes);
+
+	/**
+	 * Hand over the generation buffer with the generated data.
+	 *
+	 * Like get_chunk(), but ownership of the buffer is transferred to the
+	 * caller, avoiding a copy of the complete message. The generator may not
+	 * be used for further generation afterwards, only destroyed.
+	 *
+	 * @param lenpos		receives a pointer to fill in length value
+	 * @param return		chunk with generated data, free after use
+	 */
+	chunk_t (*extract_chunk) (generator_t *this, u_int32_t **lenpos);
+
 	/**
 	 * Destroys a generator_t object.
 	 */
@@ -79,5 +102,18 @@ generator_t *generator_create(void);
  */
 generator_t *generator_create_no_dbg(void);
 
+/**
+ * Constructor to create a generator drawing its buffer from an arena.
+ *
+ * The buffer is scratch memory owned by the arena, the generator does not
+ * free it. extract_chunk() returns an allocated copy instead of handing
+ * over the buffer, so repeated generation reuses the same arena memory.
+ * The arena may not get reset while chunks from get_chunk() are in use.
+ *
+ * @param arena			arena to draw the generation buffer from
+ * @return generator_t object.
+ */
+generator_t *generator_create_from_arena(arena_t *arena);
+
 
 #endif /** GENERATOR_H_ @}*/
@@ -29,6 +29,7 @@
 #include <sa/ikev1/keymat_v1.h>
 #include <encoding/generator.h>
 #include <encoding/parser.h>
+#include <utils/probes.h>
 #include <encoding/payloads/encodings.h>
 #include <encoding/payloads/payload.h>
 #include <encoding/payloads/hash_payload.h>
@@ -117,6 +118,9 @@ typedef struct {
 	int order_count;
 	/** payload ordering rules */
 	payload_order_t *order;
+	/* payload positions in rules (offset by one), indexed by payload type,
+	 * built by message_rules_init(); NULL to fall back to a linear scan */
+	u_int8_t *index;
 } message_rule_t;
 
 /**
@@ -729,90 +733,114 @@ static payload_order_t transaction_payload_order_v1[] = {
 
 /**
  * Message rules, defines allowed payloads.
- */
-static message_rule_t message_rules[] = {
-	{IKE_SA_INIT,		TRUE,	FALSE,
-		countof(ike_sa_init_i_rules), ike_sa_init_i_rules,
-		countof(ike_sa_init_i_order), ike_sa_init_i_order,
-	},
-	{IKE_SA_INIT,		FALSE,	FALSE,
-		countof(ike_sa_init_r_rules), ike_sa_init_r_rules,
-		countof(ike_sa_init_r_order), ike_sa_init_r_order,
-	},
-	{IKE_AUTH,			TRUE,	TRUE,
-		countof(ike_auth_i_rules), ike_auth_i_rules,
-		countof(ike_auth_i_order), ike_auth_i_order,
-	},
-	{IKE_AUTH,			FALSE,	TRUE,
-		countof(ike_auth_r_rules), ike_auth_r_rules,
-		countof(ike_auth_r_order), ike_auth_r_order,
-	},
-	{INFORMATIONAL,		TRUE,	TRUE,
-		countof(informational_i_rules), informational_i_rules,
-		countof(informational_i_order), informational_i_order,
+ *
+ * The table is indexed directly by exchange type and the request flag, so
+ * looking up the rule of a message is a single array load. Unused exchange
+ * types leave their entries zeroed, recognizable by the NULL rules pointer.
+ */
+static message_rule_t message_rules[256][2] = {
+	[IKE_SA_INIT] = {
+		[1] = {IKE_SA_INIT,		TRUE,	FALSE,
+			countof(ike_sa_init_i_rules), ike_sa_init_i_rules,
+			countof(ike_sa_init_i_order), ike_sa_init_i_order,
+		},
+		[0] = {IKE_SA_INIT,		FALSE,	FALSE,
+			countof(ike_sa_init_r_rules), ike_sa_init_r_rules,
+			countof(ike_sa_init_r_order), ike_sa_init_r_order,
+		},
 	},
-	{INFORMATIONAL,		FALSE,	TRUE,
-		countof(informational_r_rules), informational_r_rules,
-		countof(informational_r_order), informational_r_order,
+	[IKE_AUTH] = {
+		[1] = {IKE_AUTH,		TRUE,	TRUE,
+			countof(ike_auth_i_rules), ike_auth_i_rules,
+			countof(ike_auth_i_order), ike_auth_i_order,
+		},
+		[0] = {IKE_AUTH,		FALSE,	TRUE,
+			countof(ike_auth_r_rules), ike_auth_r_rules,
+			countof(ike_auth_r_order), ike_auth_r_order,
+		},
 	},
-	{CREATE_CHILD_SA,	TRUE,	TRUE,
-		countof(create_child_sa_i_rules), create_child_sa_i_rules,
-		countof(create_child_sa_i_order), create_child_sa_i_order,
+	[INFORMATIONAL] = {
+		[1] = {INFORMATIONAL,	TRUE,	TRUE,
+			countof(informational_i_rules), informational_i_rules,
+			countof(informational_i_order), informational_i_order,
+		},
+		[0] = {INFORMATIONAL,	FALSE,	TRUE,
+			countof(informational_r_rules), informational_r_rules,
+			countof(informational_r_order), informational_r_order,
+		},
 	},
-	{CREATE_CHILD_SA,	FALSE,	TRUE,
-		countof(create_child_sa_r_rules), create_child_sa_r_rules,
-		countof(create_child_sa_r_order), create_child_sa_r_order,
+	[CREATE_CHILD_SA] = {
+		[1] = {CREATE_CHILD_SA,	TRUE,	TRUE,
+			countof(create_child_sa_i_rules), create_child_sa_i_rules,
+			countof(create_child_sa_i_order), create_child_sa_i_order,
+		},
+		[0] = {CREATE_CHILD_SA,	FALSE,	TRUE,
+			countof(create_child_sa_r_rules), create_child_sa_r_rules,
+			countof(create_child_sa_r_order), create_child_sa_r_order,
+		},
 	},
 #ifdef ME
-	{ME_CONNECT,		TRUE,	TRUE,
-		countof(me_connect_i_rules), me_connect_i_rules,
-		countof(me_connect_i_order), me_connect_i_order,
-	},
-	{ME_CONNECT,		FALSE,	TRUE,
-		countof(me_connect_r_rules), me_connect_r_rules,
-		countof(me_connect_r_order), me_connect_r_order,
+	[ME_CONNECT] = {
+		[1] = {ME_CONNECT,		TRUE,	TRUE,
+			countof(me_connect_i_rules), me_connect_i_rules,
+			countof(me_connect_i_order), me_connect_i_order,
+		},
+		[0] = {ME_CONNECT,		FALSE,	TRUE,
+			countof(me_connect_r_rules), me_connect_r_rules,
+			countof(me_connect_r_order), me_connect_r_order,
+		},
 	},
 #endif /* ME */
 #ifdef USE_IKEV1
-	{ID_PROT,			TRUE,	FALSE,
-		countof(id_prot_i_rules), id_prot_i_rules,
-		countof(id_prot_i_order), id_prot_i_order,
-	},
-	{ID_PROT,			FALSE,	FALSE,
-		countof(id_prot_r_rules), id_prot_r_rules,
-		countof(id_prot_r_order), id_prot_r_order,
-	},
-	{AGGRESSIVE,		TRUE,	FALSE,
-		countof(aggressive_i_rules), aggressive_i_rules,
-		countof(aggressive_i_order), aggressive_i_order,
-	},
-	{AGGRESSIVE,		FALSE,	FALSE,
-		countof(aggressive_r_rules), aggressive_r_rules,
-		countof(aggressive_r_order), aggressive_r_order,
-	},
-	{INFORMATIONAL_V1,	TRUE,	TRUE,
-		countof(informational_i_rules_v1), informational_i_rules_v1,
-		countof(informational_i_order_v1), informational_i_order_v1,
-	},
-	{INFORMATIONAL_V1,	FALSE,	TRUE,
-		countof(informational_r_rules_v1), informational_r_rules_v1,
-		countof(informational_r_order_v1), informational_r_order_v1,
+	[ID_PROT] = {
+		[1] = {ID_PROT,			TRUE,	FALSE,
+			countof(id_prot_i_rules), id_prot_i_rules,
+			countof(id_prot_i_order), id_prot_i_order,
+		},
+		[0] = {ID_PROT,			FALSE,	FALSE,
+			countof(id_prot_r_rules), id_prot_r_rules,
+			countof(id_prot_r_order), id_prot_r_order,
+		},
 	},
-	{QUICK_MODE,		TRUE,	TRUE,
-		countof(quick_mode_i_rules), quick_mode_i_rules,
-		countof(quick_mode_i_order), quick_mode_i_order,
+	[AGGRESSIVE] = {
+		[1] = {AGGRESSIVE,		TRUE,	FALSE,
+			countof(aggressive_i_rules), aggressive_i_rules,
+			countof(aggressive_i_order), aggressive_i_order,
+		},
+		[0] = {AGGRESSIVE,		FALSE,	FALSE,
+			countof(aggressive_r_rules), aggressive_r_rules,
+			countof(aggressive_r_order), aggressive_r_order,
+		},
 	},
-	{QUICK_MODE,		FALSE,	TRUE,
-		countof(quick_mode_r_rules), quick_mode_r_rules,
-		countof(quick_mode_r_order), quick_mode_r_order,
+	[INFORMATIONAL_V1] = {
+		[1] = {INFORMATIONAL_V1,	TRUE,	TRUE,
+			countof(informational_i_rules_v1), informational_i_rules_v1,
+			countof(informational_i_order_v1), informational_i_order_v1,
+		},
+		[0] = {INFORMATIONAL_V1,	FALSE,	TRUE,
+			countof(informational_r_rules_v1), informational_r_rules_v1,
+			countof(informational_r_order_v1), informational_r_order_v1,
+		},
 	},
-	{TRANSACTION,		TRUE,	TRUE,
-		countof(transaction_payload_rules_v1), transaction_payload_rules_v1,
-		countof(transaction_payload_order_v1), transaction_payload_order_v1,
+	[QUICK_MODE] = {
+		[1] = {QUICK_MODE,		TRUE,	TRUE,
+			countof(quick_mode_i_rules), quick_mode_i_rules,
+			countof(quick_mode_i_order), quick_mode_i_order,
+		},
+		[0] = {QUICK_MODE,		FALSE,	TRUE,
+			countof(quick_mode_r_rules), quick_mode_r_rules,
+			countof(quick_mode_r_order), quick_mode_r_order,
+		},
 	},
-	{TRANSACTION,		FALSE,	TRUE,
-		countof(transaction_payload_rules_v1), transaction_payload_rules_v1,
-		countof(transaction_payload_order_v1), transaction_payload_order_v1,
+	[TRANSACTION] = {
+		[1] = {TRANSACTION,		TRUE,	TRUE,
+			countof(transaction_payload_rules_v1), transaction_payload_rules_v1,
+			countof(transaction_payload_order_v1), transaction_payload_order_v1,
+		},
+		[0] = {TRANSACTION,		FALSE,	TRUE,
+			countof(transaction_payload_rules_v1), transaction_payload_rules_v1,
+			countof(transaction_payload_order_v1), transaction_payload_order_v1,
+		},
 	},
 	/* TODO-IKEv1: define rules for other exchanges */
 #endif /* USE_IKEV1 */
@@ -940,6 +968,11 @@ struct private_message_t {
 	 * Data used to reassemble a fragmented message
 	 */
 	fragment_data_t *frag;
+
+	/**
+	 * Arena for generation scratch buffers, NULL to use the heap
+	 */
+	arena_t *arena;
 };
 
 /**
@@ -958,11 +991,14 @@ typedef struct {
 	/** fragment data */
 	chunk_t data;
 
+	/** buffer backing the fragment data */
+	chunk_t buf;
+
 } fragment_t;
 
 static void fragment_destroy(fragment_t *this)
 {
-	chunk_free(&this->data);
+	chunk_free(&this->buf);
 	free(this);
 }
 
@@ -979,17 +1015,18 @@ static void reset_defrag(private_message_t *this)
  */
 static message_rule_t* get_message_rule(private_message_t *this)
 {
-	int i;
+	message_rule_t *rule;
 
-	for (i = 0; i < countof(message_rules); i++)
+	if (this->exchange_type >= countof(message_rules))
 	{
-		if ((this->exchange_type == message_rules[i].exchange_type) &&
-			(this->is_request == message_rules[i].is_request))
-		{
-			return &message_rules[i];
-		}
+		return NULL;
 	}
-	return NULL;
+	rule = &message_rules[this->exchange_type][this->is_request ? 1 : 0];
+	if (!rule->rules)
+	{
+		return NULL;
+	}
+	return rule;
 }
 
 /**
@@ -1000,6 +1037,19 @@ static payload_rule_t* get_payload_rule(private_message_t *this,
 {
 	int i;
 
+	if (this->rule->index)
+	{
+		if (type > PLV1_FRAGMENT)
+		{	/* only wire payload types are indexed */
+			return NULL;
+		}
+		i = this->rule->index[type];
+		if (!i)
+		{
+			return NULL;
+		}
+		return &this->rule->rules[i - 1];
+	}
 	for (i = 0; i < this->rule->rule_count;i++)
 	{
 		if (this->rule->rules[i].type == type)
@@ -1010,6 +1060,49 @@ static payload_rule_t* get_payload_rule(private_message_t *this,
 	return NULL;
 }
 
+/*
+ * Described in header.
+ */
+void message_rules_init()
+{
+	message_rule_t *rule;
+	int e, r, i;
+
+	for (e = 0; e < countof(message_rules); e++)
+	{
+		for (r = 0; r < 2; r++)
+		{
+			rule = &message_rules[e][r];
+			if (!rule->rules || rule->index)
+			{
+				continue;
+			}
+			rule->index = calloc(PLV1_FRAGMENT + 1, sizeof(u_int8_t));
+			for (i = 0; i < rule->rule_count; i++)
+			{
+				rule->index[rule->rules[i].type] = i + 1;
+			}
+		}
+	}
+}
+
+/*
+ * Described in header.
+ */
+void message_rules_deinit()
+{
+	int e, r;
+
+	for (e = 0; e < countof(message_rules); e++)
+	{
+		for (r = 0; r < 2; r++)
+		{
+			free(message_rules[e][r].index);
+			message_rules[e][r].index = NULL;
+		}
+	}
+}
+
 METHOD(message_t, set_ike_sa_id, void,
 	private_message_t *this,ike_sa_id_t *ike_sa_id)
 {
@@ -1186,6 +1279,12 @@ METHOD(message_t, add_notify, void,
 	add_payload(this, (payload_t*)notify);
 }
 
+METHOD(message_t, set_arena, void,
+	private_message_t *this, arena_t *arena)
+{
+	this->arena = arena;
+}
+
 METHOD(message_t, set_source, void,
 	private_message_t *this, host_t *host)
 {
@@ -1703,7 +1802,15 @@ static status_t generate_message(private_message_t *this, keymat_t *keymat,
 	}
 
 	/* generate all payloads with proper next type */
-	*out_generator = generator = generator_create();
+	if (this->arena)
+	{
+		generator = generator_create_from_arena(this->arena);
+	}
+	else
+	{
+		generator = generator_create();
+	}
+	*out_generator = generator;
 	ike_header = create_header(this);
 	payload = (payload_t*)ike_header;
 	enumerator = create_payload_enumerator(this);
@@ -1768,9 +1875,9 @@ static status_t finalize_message(private_message_t *this, keymat_t *keymat,
 		}
 		generator->generate_payload(generator, &encrypted->payload_interface);
 	}
-	chunk = generator->get_chunk(generator, &lenpos);
+	chunk = generator->extract_chunk(generator, &lenpos);
 	htoun32(lenpos, chunk.len);
-	this->packet->set_data(this->packet, chunk_clone(chunk));
+	this->packet->set_data(this->packet, chunk);
 	if (this->is_encrypted && this->exchange_type != INFORMATIONAL_V1)
 	{
 		/* update the IV for the next IKEv1 message */
@@ -1799,6 +1906,7 @@ METHOD(message_t, generate, status_t,
 	encrypted_payload_t *encrypted = NULL;
 	status_t status;
 
+	PROBE2(message_generate, this->exchange_type, this->message_id);
 	status = generate_message(this, keymat, &generator, &encrypted);
 	if (status != SUCCESS)
 	{
@@ -2012,7 +2120,14 @@ METHOD(message_t, fragment, status_t,
 		if (generator)
 		{
 			generator->destroy(generator);
-			generator = generator_create();
+			if (this->arena)
+			{
+				generator = generator_create_from_arena(this->arena);
+			}
+			else
+			{
+				generator = generator_create();
+			}
 		}
 		else
 		{	/* do not log again if it was generated previously */
@@ -2559,6 +2674,7 @@ METHOD(message_t, parse_body, status_t,
 	status_t status = SUCCESS;
 	char str[BUF_LEN];
 
+	PROBE2(message_parse, this->exchange_type, this->message_id);
 	DBG2(DBG_ENC, "parsing body of message, first payload is %N",
 		 payload_type_names, this->first_payload);
 
@@ -2646,9 +2762,10 @@ METHOD(message_t, parse_body, status_t,
 
 /**
  * Store the fragment data for the fragment with the given fragment number.
+ * The buffer backing the data gets owned, also if the fragment is not stored.
  */
 static status_t add_fragment(private_message_t *this, u_int16_t num,
-							 chunk_t data)
+							 chunk_t data, chunk_t buf)
 {
 	fragment_t *fragment;
 	int i, insert_at = -1;
@@ -2660,6 +2777,7 @@ static status_t add_fragment(private_message_t *this, u_int16_t num,
 		{
 			/* ignore a duplicate fragment */
 			DBG1(DBG_ENC, "received duplicate fragment #%hu", num);
+			free(buf.ptr);
 			return NEED_MORE;
 		}
 		if (fragment->num > num)
@@ -2672,12 +2790,14 @@ static status_t add_fragment(private_message_t *this, u_int16_t num,
 	if (this->frag->len > this->frag->max_packet)
 	{
 		DBG1(DBG_ENC, "fragmented IKE message is too large");
+		free(buf.ptr);
 		reset_defrag(this);
 		return FAILED;
 	}
 	INIT(fragment,
 		.num = num,
-		.data = chunk_clone(data),
+		.data = data,
+		.buf = buf,
 	);
 	array_insert(this->fragments, insert_at, fragment);
 	return SUCCESS;
@@ -2742,12 +2862,12 @@ METHOD(message_t, add_fragment_v1, status_t,
 	}
 
 	num = payload->get_number(payload);
-	data = payload->get_data(payload);
+	data = chunk_clone(payload->get_data(payload));
 	if (!this->frag->last && payload->is_last(payload))
 	{
 		this->frag->last = num;
 	}
-	status = add_fragment(this, num, data);
+	status = add_fragment(this, num, data, data);
 	if (status != SUCCESS)
 	{
 		return status;
@@ -2783,7 +2903,7 @@ METHOD(message_t, add_fragment_v2, status_t,
 	encrypted_payload_t *encrypted;
 	payload_t *payload;
 	enumerator_t *enumerator;
-	chunk_t data;
+	chunk_t data, buf;
 	u_int16_t total, num;
 	status_t status;
 
@@ -2811,8 +2931,9 @@ METHOD(message_t, add_fragment_v2, status_t,
 		this->fragments = array_create(0, total);
 	}
 	num = encrypted_fragment->get_fragment_number(encrypted_fragment);
-	data = encrypted_fragment->get_content(encrypted_fragment);
-	status = add_fragment(this, num, data);
+	/* take over the decrypted content instead of copying it out */
+	data = encrypted_fragment->extract_content(encrypted_fragment, &buf);
+	status = add_fragment(this, num, data, buf);
 	if (status != SUCCESS)
 	{
 		return status;
@@ -2910,6 +3031,7 @@ message_t *message_create_from_packet(packet_t *packet)
 			.is_fragmented = _is_fragmented,
 			.fragment = _fragment,
 			.add_fragment = _add_fragment_v2,
+			.set_arena = _set_arena,
 			.set_source = _set_source,
 			.get_source = _get_source,
 			.set_destination = _set_destination,
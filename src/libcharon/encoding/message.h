@@ -27,6 +27,7 @@
 typedef struct message_t message_t;
 
 #include <library.h>
+#include <utils/arena.h>
 #include <encoding/payloads/ike_header.h>
 #include <encoding/payloads/notify_payload.h>
 #include <sa/keymat.h>
@@ -257,6 +258,18 @@ struct message_t {
 	 */
 	status_t (*generate) (message_t *this, keymat_t *keymat, packet_t **packet);
 
+	/**
+	 * Use an arena for scratch buffers during message generation.
+	 *
+	 * If set before generate() or fragment(), intermediate generation
+	 * buffers are drawn from the given arena instead of the heap. The
+	 * caller keeps ownership of the arena and may reset it once the
+	 * message has been generated.
+	 *
+	 * @param arena		arena for generation scratch memory
+	 */
+	void (*set_arena) (message_t *this, arena_t *arena);
+
 	/**
 	 * Check if the message has already been encoded using generate().
 	 *
@@ -444,4 +457,17 @@ message_t *message_create(int major, int minor);
  */
 message_t *message_create_defrag(message_t *fragment);
 
+/**
+ * Build the payload position indexes of the message rule tables.
+ *
+ * Turns payload rule lookups into O(1) array loads. Optional, without it
+ * lookups fall back to a linear scan over the rule arrays.
+ */
+void message_rules_init();
+
+/**
+ * Release the payload position indexes built by message_rules_init().
+ */
+void message_rules_deinit();
+
 #endif /** MESSAGE_H_ @}*/
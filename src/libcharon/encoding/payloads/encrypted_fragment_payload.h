@@ -58,6 +58,19 @@ struct encrypted_fragment_payload_t {
 	 */
 	chunk_t (*get_content)(encrypted_fragment_payload_t *this);
 
+	/**
+	 * Extract the (decrypted) content of this payload.
+	 *
+	 * Ownership is transferred to the caller, which receives the buffer
+	 * backing the content in buf (the content is just a view into it if the
+	 * payload was decrypted in place).
+	 *
+	 * @param buf		receives the buffer backing the content (gets owned)
+	 * @return			payload content
+	 */
+	chunk_t (*extract_content)(encrypted_fragment_payload_t *this,
+							   chunk_t *buf);
+
 	/**
 	 * Destroys an encrypted_fragment_payload_t object.
 	 */
@@ -124,6 +124,11 @@ struct private_encrypted_fragment_payload_t {
 	 * Chunk containing the plain packet data.
 	 */
 	chunk_t plain;
+
+	/**
+	 * TRUE if plain is a view into encrypted (decrypted in place)
+	 */
+	bool plain_inline;
 };
 
 /**
@@ -488,9 +493,12 @@ static status_t encrypt_content(char *label, aead_t *aead, u_int64_t mid,
 METHOD(encrypted_payload_t, encrypt, status_t,
 	private_encrypted_payload_t *this, u_int64_t mid, chunk_t assoc)
 {
+	chunk_t iv, plain, padding, icv, crypt;
 	generator_t *generator;
-	chunk_t plain;
-	status_t status;
+	u_int32_t *lenpos;
+	iv_gen_t *iv_gen;
+	rng_t *rng;
+	size_t bs;
 
 	if (this->aead == NULL)
 	{
@@ -498,15 +506,79 @@ METHOD(encrypted_payload_t, encrypt, status_t,
 		return INVALID_STATE;
 	}
 
+	rng = lib->crypto->create_rng(lib->crypto, RNG_WEAK);
+	if (!rng)
+	{
+		DBG1(DBG_ENC, "encrypting encrypted payload failed, no RNG found");
+		return NOT_SUPPORTED;
+	}
+
+	iv_gen = this->aead->get_iv_gen(this->aead);
+	if (!iv_gen)
+	{
+		DBG1(DBG_ENC, "encrypting encrypted payload failed, no IV generator");
+		rng->destroy(rng);
+		return NOT_SUPPORTED;
+	}
+
 	free(this->encrypted.ptr);
+	this->encrypted = chunk_empty;
+
+	bs = this->aead->get_block_size(this->aead);
+	iv.len = this->aead->get_iv_size(this->aead);
+	icv.len = this->aead->get_icv_size(this->aead);
+
+	/* lay out the plaintext with room for the IV in front, so the AEAD
+	 * can transform the buffer in place without assembling a copy:
+	 * | IV | plain | padding | ICV |
+	 *       \____crypt______/   ^
+	 *              |           /
+	 *              v          /
+	 *     assoc -> + ------->/
+	 */
 	generator = generator_create();
+	generator->skip_bytes(generator, iv.len);
 	plain = generate(this, generator);
-	assoc = append_header(this, assoc);
-	status = encrypt_content("encrypted payload", this->aead, mid, plain, assoc,
-							 &this->encrypted);
+	plain = chunk_skip(plain, iv.len);
+	/* we need at least one byte padding to store the padding length */
+	padding.len = bs - (plain.len % bs);
+	generator->skip_bytes(generator, padding.len + icv.len);
+	this->encrypted = generator->extract_chunk(generator, &lenpos);
 	generator->destroy(generator);
+
+	iv.ptr = this->encrypted.ptr;
+	plain.ptr = iv.ptr + iv.len;
+	padding.ptr = plain.ptr + plain.len;
+	icv.ptr = padding.ptr + padding.len;
+	crypt = chunk_create(plain.ptr, plain.len + padding.len);
+
+	if (!iv_gen->get_iv(iv_gen, mid, iv.len, iv.ptr) ||
+		!rng->get_bytes(rng, padding.len - 1, padding.ptr))
+	{
+		DBG1(DBG_ENC, "encrypting encrypted payload failed, no IV or padding");
+		rng->destroy(rng);
+		return FAILED;
+	}
+	padding.ptr[padding.len - 1] = padding.len - 1;
+	rng->destroy(rng);
+
+	assoc = append_header(this, assoc);
+
+	DBG3(DBG_ENC, "encrypted payload encryption:");
+	DBG3(DBG_ENC, "IV %B", &iv);
+	DBG3(DBG_ENC, "plain %B", &plain);
+	DBG3(DBG_ENC, "padding %B", &padding);
+	DBG3(DBG_ENC, "assoc %B", &assoc);
+
+	if (!this->aead->encrypt(this->aead, crypt, assoc, iv, NULL))
+	{
+		free(assoc.ptr);
+		return FAILED;
+	}
+	DBG3(DBG_ENC, "encrypted %B", &crypt);
+	DBG3(DBG_ENC, "ICV %B", &icv);
 	free(assoc.ptr);
-	return status;
+	return SUCCESS;
 }
 
 METHOD(encrypted_payload_t, encrypt_v1, status_t,
@@ -730,7 +802,7 @@ METHOD2(payload_t, encrypted_payload_t, destroy, void,
 {
 	this->payloads->destroy_offset(this->payloads, offsetof(payload_t, destroy));
 	free(this->encrypted.ptr);
-	free(this);
+	payload_pool_put(this->type, this);
 }
 
 /*
@@ -740,7 +812,7 @@ encrypted_payload_t *encrypted_payload_create(payload_type_t type)
 {
 	private_encrypted_payload_t *this;
 
-	INIT(this,
+	INIT_POOLED(type, this,
 		.public = {
 			.payload_interface = {
 				.verify = _verify,
@@ -885,6 +957,25 @@ METHOD(encrypted_fragment_payload_t, frag_get_content, chunk_t,
 	return this->plain;
 }
 
+METHOD(encrypted_fragment_payload_t, frag_extract_content, chunk_t,
+	private_encrypted_fragment_payload_t *this, chunk_t *buf)
+{
+	chunk_t content = this->plain;
+
+	if (this->plain_inline)
+	{	/* decrypted in place, hand over the backing buffer */
+		*buf = this->encrypted;
+		this->encrypted = chunk_empty;
+		this->plain_inline = FALSE;
+	}
+	else
+	{
+		*buf = this->plain;
+	}
+	this->plain = chunk_empty;
+	return content;
+}
+
 METHOD(encrypted_payload_t, frag_add_payload, void,
 	private_encrypted_fragment_payload_t *this, payload_t* payload)
 {
@@ -949,11 +1040,16 @@ METHOD(encrypted_payload_t, frag_decrypt, status_t,
 			 "transform missing");
 		return INVALID_STATE;
 	}
-	free(this->plain.ptr);
+	if (!this->plain_inline)
+	{
+		free(this->plain.ptr);
+	}
+	this->plain = chunk_empty;
 	assoc = append_header_frag(this, assoc);
 	status = decrypt_content("encrypted fragment payload", this->aead,
 							 this->encrypted, assoc, &this->plain);
-	this->plain = chunk_clone(this->plain);
+	/* the content is decrypted in place, do not copy it out of the buffer */
+	this->plain_inline = TRUE;
 	free(assoc.ptr);
 	return status;
 }
@@ -962,7 +1058,10 @@ METHOD2(payload_t, encrypted_payload_t, frag_destroy, void,
 	private_encrypted_fragment_payload_t *this)
 {
 	free(this->encrypted.ptr);
-	free(this->plain.ptr);
+	if (!this->plain_inline)
+	{
+		free(this->plain.ptr);
+	}
 	free(this);
 }
 
@@ -998,6 +1097,7 @@ encrypted_fragment_payload_t *encrypted_fragment_payload_create()
 			.get_fragment_number = _get_fragment_number,
 			.get_total_fragments = _get_total_fragments,
 			.get_content = _frag_get_content,
+			.extract_content = _frag_extract_content,
 		},
 		.next_payload = PL_NONE,
 	);
@@ -183,7 +183,7 @@ METHOD2(payload_t, nonce_payload_t, destroy, void,
 	private_nonce_payload_t *this)
 {
 	free(this->nonce.ptr);
-	free(this);
+	payload_pool_put(this->type, this);
 }
 
 /*
@@ -193,7 +193,7 @@ nonce_payload_t *nonce_payload_create(payload_type_t type)
 {
 	private_nonce_payload_t *this;
 
-	INIT(this,
+	INIT_POOLED(type, this,
 		.public = {
 			.payload_interface = {
 				.verify = _verify,
@@ -705,7 +705,7 @@ METHOD2(payload_t, notify_payload_t, destroy, void,
 {
 	free(this->notify_data.ptr);
 	free(this->spi.ptr);
-	free(this);
+	payload_pool_put(this->type, this);
 }
 
 /*
@@ -715,7 +715,7 @@ notify_payload_t *notify_payload_create(payload_type_t type)
 {
 	private_notify_payload_t *this;
 
-	INIT(this,
+	INIT_POOLED(type, this,
 		.public = {
 			.payload_interface = {
 				.verify = _verify,
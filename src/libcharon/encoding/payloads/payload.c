@@ -18,6 +18,8 @@
 
 #include "payload.h"
 
+#include <threading/thread_value.h>
+
 #include <encoding/payloads/ike_header.h>
 #include <encoding/payloads/sa_payload.h>
 
@@ -179,6 +181,165 @@ ENUM_NEXT(payload_type_short_names, PL_HEADER, PLV1_ENCRYPTED, PLV1_FRAGMENT,
 	"E");
 ENUM_END(payload_type_short_names, PLV1_ENCRYPTED);
 
+/**
+ * Maximum number of recycled blocks kept per payload type and thread
+ */
+#define POOL_MAX_BLOCKS 8
+
+/**
+ * Number of pooled payload types, see pool_slot()
+ */
+#define POOL_SLOTS 4
+
+typedef struct pool_block_t pool_block_t;
+
+/**
+ * Recycled memory block, the object memory itself links the free list
+ */
+struct pool_block_t {
+	pool_block_t *next;
+};
+
+/**
+ * Per-thread payload pool
+ */
+typedef struct {
+	/** free list for each pooled payload type */
+	pool_block_t *blocks[POOL_SLOTS];
+	/** number of blocks in each free list */
+	u_int count[POOL_SLOTS];
+} pool_t;
+
+/**
+ * Thread specific pools, NULL if pooling is not initialized
+ */
+static thread_value_t *pools;
+
+/**
+ * Map a payload type to its pool slot, -1 if the type is not pooled.
+ *
+ * Types sharing a slot must use the same private structure.
+ */
+static int pool_slot(payload_type_t type)
+{
+	switch (type)
+	{
+		case PLV2_SECURITY_ASSOCIATION:
+		case PLV1_SECURITY_ASSOCIATION:
+			return 0;
+		case PLV2_NONCE:
+		case PLV1_NONCE:
+			return 1;
+		case PLV2_NOTIFY:
+		case PLV1_NOTIFY:
+			return 2;
+		case PLV2_ENCRYPTED:
+		case PLV1_ENCRYPTED:
+			return 3;
+		default:
+			return -1;
+	}
+}
+
+/**
+ * Destroy a pool with all recycled blocks, used as thread cleanup handler
+ */
+static void pool_destroy(pool_t *pool)
+{
+	pool_block_t *block;
+	int i;
+
+	for (i = 0; i < POOL_SLOTS; i++)
+	{
+		while ((block = pool->blocks[i]))
+		{
+			pool->blocks[i] = block->next;
+			free(block);
+		}
+	}
+	free(pool);
+}
+
+/*
+ * see header
+ */
+void *payload_pool_get(payload_type_t type)
+{
+	pool_block_t *block = NULL;
+	pool_t *pool;
+	int slot;
+
+	slot = pool_slot(type);
+	if (slot >= 0 && pools)
+	{
+		pool = pools->get(pools);
+		if (pool && pool->blocks[slot])
+		{
+			block = pool->blocks[slot];
+			pool->blocks[slot] = block->next;
+			pool->count[slot]--;
+		}
+	}
+	return block;
+}
+
+/*
+ * see header
+ */
+void payload_pool_put(payload_type_t type, void *object)
+{
+	pool_block_t *block = object;
+	pool_t *pool;
+	int slot;
+
+	slot = pool_slot(type);
+	if (slot >= 0 && pools)
+	{
+		pool = pools->get(pools);
+		if (!pool)
+		{
+			pool = calloc(1, sizeof(pool_t));
+			pools->set(pools, pool);
+		}
+		if (pool->count[slot] < POOL_MAX_BLOCKS)
+		{
+			block->next = pool->blocks[slot];
+			pool->blocks[slot] = block;
+			pool->count[slot]++;
+			return;
+		}
+	}
+	free(object);
+}
+
+/*
+ * see header
+ */
+void payload_pool_init()
+{
+	pools = thread_value_create((thread_cleanup_t)pool_destroy);
+}
+
+/*
+ * see header
+ */
+void payload_pool_deinit()
+{
+	pool_t *pool;
+
+	if (pools)
+	{	/* worker threads released their pools on termination, the value of
+		 * the thread calling deinit has to be released explicitly */
+		pool = pools->get(pools);
+		if (pool)
+		{
+			pool_destroy(pool);
+		}
+		pools->destroy(pools);
+		pools = NULL;
+	}
+}
+
 /*
  * see header
  */
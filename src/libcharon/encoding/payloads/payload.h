@@ -401,6 +401,49 @@ struct payload_t {
  */
 payload_t *payload_create(payload_type_t type);
 
+/**
+ * INIT()-style object allocation drawing from the payload pool first.
+ *
+ * @param type		payload type the object is created for
+ * @param this		object to allocate and initialize
+ */
+#define INIT_POOLED(type, this, ...) { \
+	(this) = payload_pool_get(type) ?: malloc(sizeof(*(this))); \
+	*(this) = (typeof(*(this))){ __VA_ARGS__ }; }
+
+/**
+ * Get a recycled memory block for a payload of the given type.
+ *
+ * Frequently parsed payload types are pooled per thread to take their
+ * allocations off the per-message hot path. The returned block is
+ * uninitialized, create functions overwrite it completely.
+ *
+ * @param type		payload type to create
+ * @return			memory block for the payload object, NULL if none pooled
+ */
+void *payload_pool_get(payload_type_t type);
+
+/**
+ * Return the memory block of a payload object to the pool of its type.
+ *
+ * The block is freed if the type is not pooled or the current thread
+ * already caches enough blocks of it.
+ *
+ * @param type		payload type the object was created for
+ * @param block		memory block of the payload object
+ */
+void payload_pool_put(payload_type_t type, void *block);
+
+/**
+ * Initialize the per-thread payload pools.
+ */
+void payload_pool_init();
+
+/**
+ * Release the payload pools, including the calling thread's blocks.
+ */
+void payload_pool_deinit();
+
 /**
  * Check if a specific payload is implemented, or handled as unknown payload.
  *
@@ -476,7 +476,7 @@ METHOD2(payload_t, sa_payload_t, destroy, void,
 {
 	this->proposals->destroy_offset(this->proposals,
 									offsetof(payload_t, destroy));
-	free(this);
+	payload_pool_put(this->type, this);
 }
 
 /*
@@ -486,7 +486,7 @@ sa_payload_t *sa_payload_create(payload_type_t type)
 {
 	private_sa_payload_t *this;
 
-	INIT(this,
+	INIT_POOLED(type, this,
 		.public = {
 			.payload_interface = {
 				.verify = _verify,
@@ -17,7 +17,11 @@
 
 #include <hydra.h>
 #include <daemon.h>
+#include <collections/array.h>
+#include <collections/hashtable.h>
+#include <threading/mutex.h>
 #include <processing/jobs/acquire_job.h>
+#include <processing/jobs/callback_job.h>
 #include <processing/jobs/delete_child_sa_job.h>
 #include <processing/jobs/migrate_job.h>
 #include <processing/jobs/rekey_child_sa_job.h>
@@ -35,8 +39,62 @@ struct private_kernel_handler_t {
 	 * Public part of kernel_handler_t object.
 	 */
 	kernel_handler_t public;
+
+	/**
+	 * Mutex to lock event coalescing state
+	 */
+	mutex_t *mutex;
+
+	/**
+	 * Queued expire events not yet processed, as expire_entry_t
+	 */
+	array_t *expires;
+
+	/**
+	 * Whether a job draining the expire queue is scheduled
+	 */
+	bool expire_job;
+
+	/**
+	 * Time of the last acquire per reqid, to suppress duplicates
+	 */
+	hashtable_t *acquires;
+
+	/**
+	 * Seconds to suppress duplicate acquires per reqid, 0 to disable
+	 */
+	u_int acquire_window;
+
+	/**
+	 * Whether a coalesced roam job is pending
+	 */
+	bool roam_pending;
+
+	/**
+	 * Whether a pending roam event includes an address change
+	 */
+	bool roam_address;
+
+	/**
+	 * Milliseconds to coalesce roam events before sweeping, 0 to disable
+	 */
+	u_int roam_window;
 };
 
+/**
+ * Expire event queued for batched processing
+ */
+typedef struct {
+	/** IKEv2 protocol identifier of the expired SA */
+	protocol_id_t proto;
+	/** SPI of the expired SA */
+	u_int32_t spi;
+	/** Destination address of the expired SA */
+	host_t *dst;
+	/** TRUE for a hard expire, FALSE for a soft one */
+	bool hard;
+} expire_entry_t;
+
 /**
  * convert an IP protocol identifier to the IKEv2 specific protocol identifier.
  */
@@ -57,6 +115,27 @@ METHOD(kernel_listener_t, acquire, bool,
 	private_kernel_handler_t *this, u_int32_t reqid,
 	traffic_selector_t *src_ts, traffic_selector_t *dst_ts)
 {
+	if (this->acquire_window)
+	{	/* suppress duplicate acquires for the same reqid within the
+		 * configured window, e.g. from multiple policies of a flapping
+		 * connection */
+		time_t now, last;
+
+		now = time_monotonic(NULL);
+		this->mutex->lock(this->mutex);
+		last = (time_t)(uintptr_t)this->acquires->get(this->acquires,
+												(void*)(uintptr_t)reqid);
+		if (last && now < last + this->acquire_window)
+		{
+			this->mutex->unlock(this->mutex);
+			DBG2(DBG_KNL, "suppressing duplicate acquire for policy with "
+				 "reqid {%u}", reqid);
+			return TRUE;
+		}
+		this->acquires->put(this->acquires, (void*)(uintptr_t)reqid,
+							(void*)(uintptr_t)now);
+		this->mutex->unlock(this->mutex);
+	}
 	if (src_ts && dst_ts)
 	{
 		DBG1(DBG_KNL, "creating acquire job for policy %R === %R with "
@@ -71,24 +150,74 @@ METHOD(kernel_listener_t, acquire, bool,
 	return TRUE;
 }
 
+/**
+ * Job draining the expire queue, creating the per-SA jobs from a worker
+ * thread instead of the kernel event dispatcher
+ */
+static job_requeue_t process_expires(private_kernel_handler_t *this)
+{
+	expire_entry_t *entry;
+
+	while (TRUE)
+	{
+		this->mutex->lock(this->mutex);
+		if (!array_remove(this->expires, ARRAY_HEAD, &entry))
+		{
+			this->expire_job = FALSE;
+			this->mutex->unlock(this->mutex);
+			break;
+		}
+		this->mutex->unlock(this->mutex);
+
+		if (entry->hard)
+		{
+			lib->processor->queue_job(lib->processor,
+					(job_t*)delete_child_sa_job_create(entry->proto,
+										entry->spi, entry->dst, entry->hard));
+		}
+		else
+		{
+			lib->processor->queue_job(lib->processor,
+					(job_t*)rekey_child_sa_job_create(entry->proto,
+													  entry->spi, entry->dst));
+		}
+		entry->dst->destroy(entry->dst);
+		free(entry);
+	}
+	return JOB_REQUEUE_NONE;
+}
+
 METHOD(kernel_listener_t, expire, bool,
 	private_kernel_handler_t *this, u_int8_t protocol, u_int32_t spi,
 	host_t *dst, bool hard)
 {
 	protocol_id_t proto = proto_ip2ike(protocol);
+	expire_entry_t *entry;
+	bool queued;
 
 	DBG1(DBG_KNL, "creating %s job for CHILD_SA %N/0x%08x/%H",
 		 hard ? "delete" : "rekey", protocol_id_names, proto, ntohl(spi), dst);
 
-	if (hard)
-	{
-		lib->processor->queue_job(lib->processor,
-				(job_t*)delete_child_sa_job_create(proto, spi, dst, hard));
-	}
-	else
+	INIT(entry,
+		.proto = proto,
+		.spi = spi,
+		.dst = dst->clone(dst),
+		.hard = hard,
+	);
+
+	/* batch expires into a single drain job, so a large batch of expiring
+	 * SAs does not flood the processor from the event dispatcher */
+	this->mutex->lock(this->mutex);
+	array_insert(this->expires, ARRAY_TAIL, entry);
+	queued = this->expire_job;
+	this->expire_job = TRUE;
+	this->mutex->unlock(this->mutex);
+
+	if (!queued)
 	{
 		lib->processor->queue_job(lib->processor,
-				(job_t*)rekey_child_sa_job_create(proto, spi, dst));
+				(job_t*)callback_job_create((callback_job_cb_t)process_expires,
+											this, NULL, NULL));
 	}
 	return TRUE;
 }
@@ -122,21 +251,69 @@ METHOD(kernel_listener_t, migrate, bool,
 	return TRUE;
 }
 
+/**
+ * Fire the coalesced roam job once the debounce window elapsed
+ */
+static job_requeue_t process_roam(private_kernel_handler_t *this)
+{
+	bool address;
+
+	this->mutex->lock(this->mutex);
+	address = this->roam_address;
+	this->roam_address = FALSE;
+	this->roam_pending = FALSE;
+	this->mutex->unlock(this->mutex);
+
+	lib->processor->queue_job(lib->processor, (job_t*)roam_job_create(address));
+	return JOB_REQUEUE_NONE;
+}
+
 METHOD(kernel_listener_t, roam, bool,
 	private_kernel_handler_t *this, bool address)
 {
+	bool pending;
+
 	DBG2(DBG_KNL, "creating roam job %s",
 		 address ? "due to address/link change" : "due to route change");
 
-	lib->processor->queue_job(lib->processor, (job_t*)roam_job_create(address));
+	if (!this->roam_window)
+	{
+		lib->processor->queue_job(lib->processor,
+								  (job_t*)roam_job_create(address));
+		return TRUE;
+	}
+	/* coalesce bursts of roam events from a flapping interface into a
+	 * single sweep per debounce window */
+	this->mutex->lock(this->mutex);
+	this->roam_address |= address;
+	pending = this->roam_pending;
+	this->roam_pending = TRUE;
+	this->mutex->unlock(this->mutex);
+
+	if (!pending)
+	{
+		lib->scheduler->schedule_job_ms(lib->scheduler,
+			(job_t*)callback_job_create((callback_job_cb_t)process_roam,
+										this, NULL, NULL), this->roam_window);
+	}
 	return TRUE;
 }
 
 METHOD(kernel_handler_t, destroy, void,
 	private_kernel_handler_t *this)
 {
+	expire_entry_t *entry;
+
 	hydra->kernel_interface->remove_listener(hydra->kernel_interface,
 											 &this->public.listener);
+	while (array_remove(this->expires, ARRAY_HEAD, &entry))
+	{
+		entry->dst->destroy(entry->dst);
+		free(entry);
+	}
+	array_destroy(this->expires);
+	this->acquires->destroy(this->acquires);
+	this->mutex->destroy(this->mutex);
 	free(this);
 }
 
@@ -155,6 +332,14 @@ kernel_handler_t *kernel_handler_create()
 			},
 			.destroy = _destroy,
 		},
+		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+		.expires = array_create(0, 0),
+		.acquires = hashtable_create(hashtable_hash_ptr,
+									 hashtable_equals_ptr, 8),
+		.acquire_window = lib->settings->get_int(lib->settings,
+										"%s.acquire_window", 1, lib->ns),
+		.roam_window = lib->settings->get_int(lib->settings,
+										"%s.roam_window", 100, lib->ns),
 	);
 
 	hydra->kernel_interface->add_listener(hydra->kernel_interface,
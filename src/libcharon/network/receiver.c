@@ -26,7 +26,6 @@
 #include <processing/jobs/job.h>
 #include <processing/jobs/process_message_job.h>
 #include <processing/jobs/callback_job.h>
-#include <crypto/hashers/hasher.h>
 #include <threading/mutex.h>
 #include <networking/packet.h>
 
@@ -40,10 +39,21 @@
 #define COOKIE_THRESHOLD_DEFAULT 10
 /** default value for private_receiver_t.block_threshold */
 #define BLOCK_THRESHOLD_DEFAULT 5
-/** length of the secret to use for cookie calculation */
+/** length of the secret to use for cookie calculation, matches the
+ * SipHash-2-4 key size */
 #define SECRET_LENGTH 16
+/** length of a generated cookie: timestamp and SipHash-2-4 output */
+#define COOKIE_LENGTH (sizeof(u_int32_t) + sizeof(u_int64_t))
 /** Length of a notify payload header */
 #define NOTIFY_PAYLOAD_HEADER_LENGTH 8
+/** number of shards in the init rate sketch, a power of two */
+#define INIT_SKETCH_SHARDS 8
+/** number of counter rows in each init rate sketch shard */
+#define INIT_SKETCH_ROWS 4
+/** number of counters per row, a power of two */
+#define INIT_SKETCH_COLS 256
+/** seconds after which the init rate sketch epochs rotate */
+#define INIT_SKETCH_EPOCH 10
 
 typedef struct private_receiver_t private_receiver_t;
 
@@ -69,6 +79,12 @@ struct private_receiver_t {
 	 */
 	mutex_t *esp_cb_mutex;
 
+	/**
+	 * Mutex protecting the cookie secrets, shared when multiple receiver
+	 * threads are configured
+	 */
+	mutex_t *cookie_mutex;
+
 	/**
 	 * current secret to use for cookie calculation
 	 */
@@ -99,11 +115,6 @@ struct private_receiver_t {
 	 */
 	rng_t *rng;
 
-	/**
-	 * hasher to use for cookie calculation
-	 */
-	hasher_t *hasher;
-
 	/**
 	 * require cookies after this many half open IKE_SAs
 	 */
@@ -115,10 +126,27 @@ struct private_receiver_t {
 	time_t last_cookie;
 
 	/**
-	 * how many half open IKE_SAs per peer before blocking
+	 * how many IKE_SA_INITs per peer and epoch before blocking
 	 */
 	u_int32_t block_threshold;
 
+	/**
+	 * Sharded count-min sketch tracking IKE_SA_INITs per peer address.
+	 * Each shard keeps counters for two epochs; decay is handled by
+	 * discarding the older epoch wholesale instead of per-entry timers.
+	 */
+	struct {
+		mutex_t *mutex;
+		u_int32_t epoch;
+		u_int8_t active;
+		u_int8_t counter[2][INIT_SKETCH_ROWS][INIT_SKETCH_COLS];
+	} sketch[INIT_SKETCH_SHARDS];
+
+	/**
+	 * SipHash key for the init rate sketch
+	 */
+	char sketch_key[SECRET_LENGTH];
+
 	/**
 	 * Drop IKE_SA_INIT requests if processor job load exceeds this limit
 	 */
@@ -192,23 +220,21 @@ static void send_notify(message_t *request, int major, exchange_type_t exchange,
 /**
  * build a cookie
  */
-static bool cookie_build(private_receiver_t *this, message_t *message,
+static void cookie_build(private_receiver_t *this, message_t *message,
 						 u_int32_t t, chunk_t secret, chunk_t *cookie)
 {
 	u_int64_t spi = message->get_initiator_spi(message);
 	host_t *ip = message->get_source(message);
-	chunk_t input, hash;
-
-	/* COOKIE = t | sha1( IPi | SPIi | t | secret ) */
-	input = chunk_cata("cccc", ip->get_address(ip), chunk_from_thing(spi),
-					  chunk_from_thing(t), secret);
-	hash = chunk_alloca(this->hasher->get_hash_size(this->hasher));
-	if (!this->hasher->get_hash(this->hasher, input, hash.ptr))
-	{
-		return FALSE;
-	}
-	*cookie = chunk_cat("cc", chunk_from_thing(t), hash);
-	return TRUE;
+	chunk_t input;
+	u_int64_t mac;
+
+	/* COOKIE = t | siphash( IPi | SPIi | t ), keyed with the secret. A
+	 * keyed SipHash-2-4 is much cheaper than a full hasher, which matters
+	 * as cookies get computed per packet exactly when we are flooded. */
+	input = chunk_cata("ccc", ip->get_address(ip), chunk_from_thing(spi),
+					   chunk_from_thing(t));
+	mac = chunk_mac(input, secret.ptr);
+	*cookie = chunk_cat("cc", chunk_from_thing(t), chunk_from_thing(mac));
 }
 
 /**
@@ -224,8 +250,7 @@ static bool cookie_verify(private_receiver_t *this, message_t *message,
 	now = time_monotonic(NULL);
 	t = *(u_int32_t*)cookie.ptr;
 
-	if (cookie.len != sizeof(u_int32_t) +
-			this->hasher->get_hash_size(this->hasher) ||
+	if (cookie.len != COOKIE_LENGTH ||
 		t < now - this->secret_offset - COOKIE_LIFETIME)
 	{
 		DBG2(DBG_NET, "received cookie lifetime expired, rejecting");
@@ -243,10 +268,7 @@ static bool cookie_verify(private_receiver_t *this, message_t *message,
 	}
 
 	/* compare own calculation against received */
-	if (!cookie_build(this, message, t, secret, &reference))
-	{
-		return FALSE;
-	}
+	cookie_build(this, message, t, secret, &reference);
 	if (chunk_equals(reference, cookie))
 	{
 		chunk_free(&reference);
@@ -270,7 +292,7 @@ static bool check_cookie(private_receiver_t *this, message_t *message)
 	data = message->get_packet_data(message);
 	if (data.len <
 		 IKE_HEADER_LENGTH + NOTIFY_PAYLOAD_HEADER_LENGTH +
-		 sizeof(u_int32_t) + this->hasher->get_hash_size(this->hasher) ||
+		 COOKIE_LENGTH ||
 		*(data.ptr + 16) != PLV2_NOTIFY ||
 		*(u_int16_t*)(data.ptr + IKE_HEADER_LENGTH + 6) != htons(COOKIE))
 	{
@@ -278,7 +300,7 @@ static bool check_cookie(private_receiver_t *this, message_t *message)
 		return FALSE;
 	}
 	data.ptr += IKE_HEADER_LENGTH + NOTIFY_PAYLOAD_HEADER_LENGTH;
-	data.len = sizeof(u_int32_t) + this->hasher->get_hash_size(this->hasher);
+	data.len = COOKIE_LENGTH;
 	if (!cookie_verify(this, message, data))
 	{
 		DBG2(DBG_NET, "found cookie, but content invalid");
@@ -287,6 +309,55 @@ static bool check_cookie(private_receiver_t *this, message_t *message)
 	return TRUE;
 }
 
+/**
+ * Count an IKE_SA_INIT from the given peer and check its budget.
+ *
+ * The sketch answers "is this peer over its init budget?" without
+ * consulting the IKE_SA manager. A single SipHash over the address
+ * yields the shard and all row indices; the estimate is the minimum
+ * over the rows, summed over the current and the previous epoch.
+ */
+static bool peer_over_init_budget(private_receiver_t *this, host_t *src,
+								  u_int32_t now)
+{
+	u_int64_t mac;
+	u_int32_t count = UINT8_MAX * 2;
+	u_int8_t *cur, *old;
+	int shard, row, col;
+
+	mac = chunk_mac(src->get_address(src), this->sketch_key);
+	shard = (mac >> 32) & (INIT_SKETCH_SHARDS - 1);
+
+	this->sketch[shard].mutex->lock(this->sketch[shard].mutex);
+	if (now - this->sketch[shard].epoch >= 2 * INIT_SKETCH_EPOCH)
+	{	/* shard was idle for a while, both epochs are stale */
+		memset(this->sketch[shard].counter, 0,
+			   sizeof(this->sketch[shard].counter));
+		this->sketch[shard].epoch = now;
+	}
+	else if (now - this->sketch[shard].epoch >= INIT_SKETCH_EPOCH)
+	{	/* rotate epochs, recycling the counters of the older one */
+		this->sketch[shard].active = !this->sketch[shard].active;
+		memset(this->sketch[shard].counter[this->sketch[shard].active], 0,
+			   sizeof(this->sketch[shard].counter[0]));
+		this->sketch[shard].epoch = now;
+	}
+	for (row = 0; row < INIT_SKETCH_ROWS; row++)
+	{
+		col = (mac >> (row * 8)) & (INIT_SKETCH_COLS - 1);
+		cur = &this->sketch[shard].counter[this->sketch[shard].active][row][col];
+		old = &this->sketch[shard].counter[!this->sketch[shard].active][row][col];
+		if (*cur < UINT8_MAX)
+		{
+			(*cur)++;
+		}
+		count = min(count, (u_int32_t)*cur + *old);
+	}
+	this->sketch[shard].mutex->unlock(this->sketch[shard].mutex);
+
+	return count > this->block_threshold;
+}
+
 /**
  * Check if we currently require cookies
  */
@@ -330,49 +401,58 @@ static bool drop_ike_sa_init(private_receiver_t *this, message_t *message)
 										charon->ike_sa_manager, NULL);
 
 	/* check for cookies in IKEv2 */
-	if (message->get_major_version(message) == IKEV2_MAJOR_VERSION &&
-		cookie_required(this, half_open, now) && !check_cookie(this, message))
+	if (message->get_major_version(message) == IKEV2_MAJOR_VERSION)
 	{
-		chunk_t cookie;
+		bool cookie_missing;
 
-		DBG2(DBG_NET, "received packet from: %#H to %#H",
-			 message->get_source(message),
-			 message->get_destination(message));
-		if (!cookie_build(this, message, now - this->secret_offset,
-						  chunk_from_thing(this->secret), &cookie))
-		{
-			return TRUE;
-		}
-		DBG2(DBG_NET, "sending COOKIE notify to %H",
-			 message->get_source(message));
-		send_notify(message, IKEV2_MAJOR_VERSION, IKE_SA_INIT, COOKIE, cookie);
-		chunk_free(&cookie);
-		if (++this->secret_used > COOKIE_REUSE)
+		this->cookie_mutex->lock(this->cookie_mutex);
+		cookie_missing = cookie_required(this, half_open, now) &&
+						 !check_cookie(this, message);
+		if (cookie_missing)
 		{
-			char secret[SECRET_LENGTH];
-
-			DBG1(DBG_NET, "generating new cookie secret after %d uses",
-				 this->secret_used);
-			if (this->rng->get_bytes(this->rng, SECRET_LENGTH, secret))
-			{
-				memcpy(this->secret_old, this->secret, SECRET_LENGTH);
-				memcpy(this->secret, secret, SECRET_LENGTH);
-				memwipe(secret, SECRET_LENGTH);
-				this->secret_switch = now;
-				this->secret_used = 0;
-			}
-			else
+			chunk_t cookie;
+
+			DBG2(DBG_NET, "received packet from: %#H to %#H",
+				 message->get_source(message),
+				 message->get_destination(message));
+			cookie_build(this, message, now - this->secret_offset,
+						 chunk_from_thing(this->secret), &cookie);
+			DBG2(DBG_NET, "sending COOKIE notify to %H",
+				 message->get_source(message));
+			send_notify(message, IKEV2_MAJOR_VERSION, IKE_SA_INIT, COOKIE,
+						cookie);
+			chunk_free(&cookie);
+			if (++this->secret_used > COOKIE_REUSE)
 			{
-				DBG1(DBG_NET, "failed to allocated cookie secret, keeping old");
+				char secret[SECRET_LENGTH];
+
+				DBG1(DBG_NET, "generating new cookie secret after %d uses",
+					 this->secret_used);
+				if (this->rng->get_bytes(this->rng, SECRET_LENGTH, secret))
+				{
+					memcpy(this->secret_old, this->secret, SECRET_LENGTH);
+					memcpy(this->secret, secret, SECRET_LENGTH);
+					memwipe(secret, SECRET_LENGTH);
+					this->secret_switch = now;
+					this->secret_used = 0;
+				}
+				else
+				{
+					DBG1(DBG_NET, "failed to allocated cookie secret, "
+						 "keeping old");
+				}
 			}
 		}
-		return TRUE;
+		this->cookie_mutex->unlock(this->cookie_mutex);
+		if (cookie_missing)
+		{
+			return TRUE;
+		}
 	}
 
-	/* check if peer has too many IKE_SAs half open */
+	/* check if the peer exceeded its IKE_SA_INIT budget */
 	if (this->block_threshold &&
-		charon->ike_sa_manager->get_half_open_count(charon->ike_sa_manager,
-				message->get_source(message)) >= this->block_threshold)
+		peer_over_init_budget(this, message->get_source(message), now))
 	{
 		DBG1(DBG_NET, "ignoring IKE_SA setup from %H, "
 			 "peer too aggressive", message->get_source(message));
@@ -419,6 +499,7 @@ static job_requeue_t receive_packets(private_receiver_t *this)
 	message_t *message;
 	host_t *src, *dst;
 	status_t status;
+	u_int64_t spi;
 	bool supported = TRUE;
 	chunk_t data, marker = chunk_from_chars(0x00, 0x00, 0x00, 0x00);
 
@@ -433,6 +514,7 @@ static job_requeue_t receive_packets(private_receiver_t *this)
 		DBG2(DBG_NET, "receiving from socket failed!");
 		return JOB_REQUEUE_FAIR;
 	}
+	lib->metrics->increment(lib->metrics, METRIC_PACKETS_RECEIVED);
 
 	data = packet->get_data(packet);
 	if (data.len == 1 && data.ptr[0] == 0xFF)
@@ -577,8 +659,13 @@ static job_requeue_t receive_packets(private_receiver_t *this)
 			}
 		}
 	}
-	lib->processor->queue_job(lib->processor,
-							  (job_t*)process_message_job_create(message));
+	/* bind messages of an IKE_SA to the same worker thread, the initiator
+	 * SPI is stable over the lifetime of the SA */
+	id = message->get_ike_sa_id(message);
+	spi = id->get_initiator_spi(id);
+	lib->processor->queue_job_group(lib->processor,
+							  (job_t*)process_message_job_create(message),
+							  (u_int)(spi ^ (spi >> 32)));
 	return JOB_REQUEUE_DIRECT;
 }
 
@@ -606,9 +693,15 @@ METHOD(receiver_t, del_esp_cb, void,
 METHOD(receiver_t, destroy, void,
 	private_receiver_t *this)
 {
+	int i;
+
+	for (i = 0; i < INIT_SKETCH_SHARDS; i++)
+	{
+		this->sketch[i].mutex->destroy(this->sketch[i].mutex);
+	}
 	this->rng->destroy(this->rng);
-	this->hasher->destroy(this->hasher);
 	this->esp_cb_mutex->destroy(this->esp_cb_mutex);
+	this->cookie_mutex->destroy(this->cookie_mutex);
 	free(this);
 }
 
@@ -619,6 +712,7 @@ receiver_t *receiver_create()
 {
 	private_receiver_t *this;
 	u_int32_t now = time_monotonic(NULL);
+	u_int i, threads;
 
 	INIT(this,
 		.public = {
@@ -627,10 +721,17 @@ receiver_t *receiver_create()
 			.destroy = _destroy,
 		},
 		.esp_cb_mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+		.cookie_mutex = mutex_create(MUTEX_TYPE_DEFAULT),
 		.secret_switch = now,
 		.secret_offset = random() % now,
 	);
 
+	for (i = 0; i < INIT_SKETCH_SHARDS; i++)
+	{
+		this->sketch[i].mutex = mutex_create(MUTEX_TYPE_DEFAULT);
+		this->sketch[i].epoch = now;
+	}
+
 	if (lib->settings->get_bool(lib->settings,
 								"%s.dos_protection", TRUE, lib->ns))
 	{
@@ -654,22 +755,15 @@ receiver_t *receiver_create()
 	this->initiator_only = lib->settings->get_bool(lib->settings,
 					"%s.initiator_only", FALSE, lib->ns),
 
-	this->hasher = lib->crypto->create_hasher(lib->crypto, HASH_SHA1);
-	if (!this->hasher)
-	{
-		DBG1(DBG_NET, "creating cookie hasher failed, no hashers supported");
-		free(this);
-		return NULL;
-	}
 	this->rng = lib->crypto->create_rng(lib->crypto, RNG_STRONG);
 	if (!this->rng)
 	{
 		DBG1(DBG_NET, "creating cookie RNG failed, no RNG supported");
-		this->hasher->destroy(this->hasher);
 		free(this);
 		return NULL;
 	}
-	if (!this->rng->get_bytes(this->rng, SECRET_LENGTH, this->secret))
+	if (!this->rng->get_bytes(this->rng, SECRET_LENGTH, this->secret) ||
+		!this->rng->get_bytes(this->rng, SECRET_LENGTH, this->sketch_key))
 	{
 		DBG1(DBG_NET, "creating cookie secret failed");
 		destroy(this);
@@ -677,9 +771,17 @@ receiver_t *receiver_create()
 	}
 	memcpy(this->secret_old, this->secret, SECRET_LENGTH);
 
-	lib->processor->queue_job(lib->processor,
-		(job_t*)callback_job_create_with_prio((callback_job_cb_t)receive_packets,
-			this, NULL, (callback_job_cancel_t)return_false, JOB_PRIO_CRITICAL));
+	/* with multiple receiver threads, inbound processing scales with
+	 * SO_REUSEPORT socket groups opened by the socket backend */
+	threads = max(1, lib->settings->get_int(lib->settings,
+					"%s.receiver_threads", 1, lib->ns));
+	for (i = 0; i < threads; i++)
+	{
+		lib->processor->queue_job(lib->processor,
+			(job_t*)callback_job_create_with_prio(
+				(callback_job_cb_t)receive_packets, this, NULL,
+				(callback_job_cancel_t)return_false, JOB_PRIO_CRITICAL));
+	}
 
 	return &this->public;
 }
@@ -0,0 +1,273 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Hochschule fuer Technik Rapperswil
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include "response_cache.h"
+
+#include <daemon.h>
+#include <threading/mutex.h>
+#include <collections/hashtable.h>
+
+/**
+ * Number of individually locked cache segments
+ */
+#define CACHE_SEGMENTS 8
+
+typedef struct private_response_cache_t private_response_cache_t;
+
+/**
+ * Individually locked segment of the cache
+ */
+typedef struct {
+
+	/**
+	 * Lock for this segment
+	 */
+	mutex_t *mutex;
+
+	/**
+	 * Cached responses in this segment (ike_sa_id_t* => cache_entry_t*)
+	 */
+	hashtable_t *entries;
+} segment_t;
+
+/**
+ * Private data of a response_cache_t object.
+ */
+struct private_response_cache_t {
+
+	/**
+	 * Public response_cache_t interface.
+	 */
+	response_cache_t public;
+
+	/**
+	 * Cache segments, hashed by IKE_SA identifier
+	 */
+	segment_t segments[CACHE_SEGMENTS];
+};
+
+/**
+ * Cached response of an IKE_SA
+ */
+typedef struct {
+	/** identifier of the IKE_SA the response belongs to, cloned */
+	ike_sa_id_t *id;
+	/** message ID of the answered request */
+	u_int32_t mid;
+	/** raw packet data of the authenticated request, cloned */
+	chunk_t request;
+	/** response packet(s), as packet_t* clones */
+	array_t *packets;
+} cache_entry_t;
+
+/**
+ * Destroy a cache entry
+ */
+static void cache_entry_destroy(cache_entry_t *entry)
+{
+	entry->id->destroy(entry->id);
+	free(entry->request.ptr);
+	array_destroy_offset(entry->packets, offsetof(packet_t, destroy));
+	free(entry);
+}
+
+/**
+ * Hashtable hash function for IKE_SA identifiers
+ */
+static u_int id_hash(ike_sa_id_t *id)
+{
+	u_int64_t spis[2] = {
+		id->get_initiator_spi(id),
+		id->get_responder_spi(id),
+	};
+
+	return chunk_hash(chunk_from_thing(spis));
+}
+
+/**
+ * Hashtable equals function for IKE_SA identifiers
+ */
+static bool id_equals(ike_sa_id_t *a, ike_sa_id_t *b)
+{
+	return a->equals(a, b);
+}
+
+/**
+ * Get the segment an IKE_SA identifier is cached in
+ */
+static segment_t *get_segment(private_response_cache_t *this, ike_sa_id_t *id)
+{
+	return &this->segments[id_hash(id) % CACHE_SEGMENTS];
+}
+
+METHOD(response_cache_t, set, void,
+	private_response_cache_t *this, ike_sa_id_t *id, u_int32_t mid,
+	chunk_t request, array_t *packets)
+{
+	cache_entry_t *entry, *old;
+	segment_t *segment;
+	packet_t *packet;
+	int i;
+
+	INIT(entry,
+		.id = id->clone(id),
+		.mid = mid,
+		.request = chunk_clone(request),
+		.packets = array_create(0, 0),
+	);
+	for (i = 0; i < array_count(packets); i++)
+	{
+		array_get(packets, i, &packet);
+		array_insert(entry->packets, ARRAY_TAIL, packet->clone(packet));
+	}
+
+	segment = get_segment(this, entry->id);
+	segment->mutex->lock(segment->mutex);
+	old = segment->entries->put(segment->entries, entry->id, entry);
+	segment->mutex->unlock(segment->mutex);
+
+	if (old)
+	{
+		cache_entry_destroy(old);
+	}
+}
+
+METHOD(response_cache_t, reply, bool,
+	private_response_cache_t *this, message_t *request)
+{
+	cache_entry_t *entry;
+	segment_t *segment;
+	array_t *packets = NULL;
+	packet_t *packet, *clone;
+	ike_sa_id_t *id;
+	u_int32_t mid;
+	int i;
+
+	if (!request->get_request(request) ||
+		request->get_first_payload_type(request) == PLV2_FRAGMENT)
+	{	/* fragmented requests get reassembled by the task manager before
+		 * the response is retransmitted once */
+		return FALSE;
+	}
+	mid = request->get_message_id(request);
+
+	/* apply our initiator flag view, as checkout_by_message() does */
+	id = request->get_ike_sa_id(request);
+	id = id->clone(id);
+	id->switch_initiator(id);
+
+	segment = get_segment(this, id);
+	segment->mutex->lock(segment->mutex);
+	entry = segment->entries->get(segment->entries, id);
+	if (entry && entry->mid == mid &&
+		chunk_equals(entry->request, request->get_packet_data(request)))
+	{	/* the unauthenticated datagram is byte-identical to the request we
+		 * verified and answered, so it is a genuine retransmit */
+		for (i = 0; i < array_count(entry->packets); i++)
+		{
+			array_get(entry->packets, i, &packet);
+			clone = packet->clone(packet);
+			clone->set_source(clone,
+					request->get_destination(request)->clone(
+										request->get_destination(request)));
+			clone->set_destination(clone,
+					request->get_source(request)->clone(
+										request->get_source(request)));
+			array_insert_create(&packets, ARRAY_TAIL, clone);
+		}
+	}
+	segment->mutex->unlock(segment->mutex);
+	id->destroy(id);
+
+	if (!packets)
+	{
+		return FALSE;
+	}
+	DBG1(DBG_NET, "received retransmit of request with ID %d, "
+		 "retransmitting cached response", mid);
+	while (array_remove(packets, ARRAY_HEAD, &packet))
+	{
+		charon->sender->send(charon->sender, packet);
+	}
+	array_destroy(packets);
+	return TRUE;
+}
+
+METHOD(response_cache_t, uncache, void,
+	private_response_cache_t *this, ike_sa_id_t *id)
+{
+	cache_entry_t *entry;
+	segment_t *segment;
+
+	segment = get_segment(this, id);
+	segment->mutex->lock(segment->mutex);
+	entry = segment->entries->remove(segment->entries, id);
+	segment->mutex->unlock(segment->mutex);
+
+	if (entry)
+	{
+		cache_entry_destroy(entry);
+	}
+}
+
+METHOD(response_cache_t, destroy, void,
+	private_response_cache_t *this)
+{
+	enumerator_t *enumerator;
+	cache_entry_t *entry;
+	segment_t *segment;
+	int i;
+
+	for (i = 0; i < CACHE_SEGMENTS; i++)
+	{
+		segment = &this->segments[i];
+		enumerator = segment->entries->create_enumerator(segment->entries);
+		while (enumerator->enumerate(enumerator, NULL, &entry))
+		{
+			cache_entry_destroy(entry);
+		}
+		enumerator->destroy(enumerator);
+		segment->entries->destroy(segment->entries);
+		segment->mutex->destroy(segment->mutex);
+	}
+	free(this);
+}
+
+/**
+ * See header
+ */
+response_cache_t *response_cache_create()
+{
+	private_response_cache_t *this;
+	int i;
+
+	INIT(this,
+		.public = {
+			.set = _set,
+			.reply = _reply,
+			.uncache = _uncache,
+			.destroy = _destroy,
+		},
+	);
+
+	for (i = 0; i < CACHE_SEGMENTS; i++)
+	{
+		this->segments[i].mutex = mutex_create(MUTEX_TYPE_DEFAULT);
+		this->segments[i].entries = hashtable_create(
+									(hashtable_hash_t)id_hash,
+									(hashtable_equals_t)id_equals, 8);
+	}
+	return &this->public;
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Hochschule fuer Technik Rapperswil
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/**
+ * @defgroup response_cache response_cache
+ * @{ @ingroup network
+ */
+
+#ifndef RESPONSE_CACHE_H_
+#define RESPONSE_CACHE_H_
+
+typedef struct response_cache_t response_cache_t;
+
+#include <encoding/message.h>
+#include <sa/ike_sa_id.h>
+#include <collections/array.h>
+
+/**
+ * Cache of generated responses, answering retransmits without an IKE_SA.
+ *
+ * The task managers feed the cache with the latest generated response of
+ * each IKE_SA. Retransmitted requests then get answered directly from the
+ * cache, before the processing path checks out the IKE_SA and takes its
+ * locks.
+ */
+struct response_cache_t {
+
+	/**
+	 * Cache the latest generated response of an IKE_SA.
+	 *
+	 * Replaces any previously cached response of the same IKE_SA.
+	 *
+	 * @param id		IKE_SA identifier the response belongs to, cloned
+	 * @param mid		message ID of the answered request
+	 * @param request	raw packet data of the authenticated request, cloned
+	 * @param packets	generated response packet(s), cloned
+	 */
+	void (*set)(response_cache_t *this, ike_sa_id_t *id, u_int32_t mid,
+				chunk_t request, array_t *packets);
+
+	/**
+	 * Try to answer a request from the cache.
+	 *
+	 * The request has not been authenticated at this point, only its header
+	 * has been parsed. The cached response is therefore sent only if the
+	 * received datagram is byte-identical to the authenticated request it
+	 * answered; anything else falls through to regular processing.
+	 *
+	 * If the request matches, the response is sent to the requests'
+	 * originator and TRUE is returned; the message then does not need any
+	 * further processing.
+	 *
+	 * @param request	request message with parsed header
+	 * @return			TRUE if answered from the cache
+	 */
+	bool (*reply)(response_cache_t *this, message_t *request);
+
+	/**
+	 * Remove the cached response of an IKE_SA, if any.
+	 *
+	 * @param id		IKE_SA identifier to flush the response for
+	 */
+	void (*uncache)(response_cache_t *this, ike_sa_id_t *id);
+
+	/**
+	 * Destroy a response_cache_t.
+	 */
+	void (*destroy)(response_cache_t *this);
+};
+
+/**
+ * Create a response_cache instance.
+ */
+response_cache_t *response_cache_create();
+
+#endif /** RESPONSE_CACHE_H_ @}*/
@@ -28,6 +28,11 @@
 #include <threading/mutex.h>
 
 
+/**
+ * Maximum number of packets to hand to the socket in one batch
+ */
+#define SEND_BATCH_MAX 32
+
 typedef struct private_sender_t private_sender_t;
 
 /**
@@ -139,7 +144,8 @@ METHOD(sender_t, send_, void,
  */
 static job_requeue_t send_packets(private_sender_t *this)
 {
-	packet_t *packet;
+	packet_t *packets[SEND_BATCH_MAX];
+	int i, count = 0;
 	bool oldstate;
 
 	this->mutex->lock(this->mutex);
@@ -154,12 +160,21 @@ static job_requeue_t send_packets(private_sender_t *this)
 		thread_cancelability(oldstate);
 		thread_cleanup_pop(FALSE);
 	}
-	this->list->remove_first(this->list, (void**)&packet);
-	this->sent->signal(this->sent);
+	/* drain a batch of packets to amortize syscall and wakeup cost */
+	while (count < countof(packets) &&
+		   this->list->remove_first(this->list,
+									(void**)&packets[count]) == SUCCESS)
+	{
+		count++;
+	}
+	this->sent->broadcast(this->sent);
 	this->mutex->unlock(this->mutex);
 
-	charon->socket->send(charon->socket, packet);
-	packet->destroy(packet);
+	charon->socket->send_batch(charon->socket, packets, count);
+	for (i = 0; i < count; i++)
+	{
+		packets[i]->destroy(packets[i]);
+	}
 	return JOB_REQUEUE_DIRECT;
 }
 
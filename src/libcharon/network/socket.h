@@ -93,6 +93,20 @@ struct socket_t {
 	 */
 	status_t (*send)(socket_t *this, packet_t *packet);
 
+	/**
+	 * Send a batch of packets with as few syscalls as possible.
+	 *
+	 * Implementing this method is optional. If it is NULL, the socket
+	 * manager falls back to calling send() for each packet.
+	 *
+	 * @param packets		array of packets to send
+	 * @param count			number of packets in the array
+	 * @return
+	 *						- SUCCESS when all packets successfully sent
+	 *						- FAILED when unable to send some of them
+	 */
+	status_t (*send_batch)(socket_t *this, packet_t **packets, int count);
+
 	/**
 	 * Get the port this socket is listening on.
 	 *
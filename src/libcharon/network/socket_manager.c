@@ -89,6 +89,37 @@ METHOD(socket_manager_t, sender, status_t,
 	return status;
 }
 
+METHOD(socket_manager_t, sender_batch, status_t,
+	private_socket_manager_t *this, packet_t **packets, int count)
+{
+	status_t status = SUCCESS;
+	int i;
+
+	this->lock->read_lock(this->lock);
+	if (!this->socket)
+	{
+		DBG1(DBG_NET, "no socket implementation registered, sending failed");
+		this->lock->unlock(this->lock);
+		return NOT_SUPPORTED;
+	}
+	if (this->socket->send_batch)
+	{
+		status = this->socket->send_batch(this->socket, packets, count);
+	}
+	else
+	{	/* fall back to sending the packets one by one */
+		for (i = 0; i < count; i++)
+		{
+			if (this->socket->send(this->socket, packets[i]) != SUCCESS)
+			{
+				status = FAILED;
+			}
+		}
+	}
+	this->lock->unlock(this->lock);
+	return status;
+}
+
 METHOD(socket_manager_t, get_port, u_int16_t,
 	private_socket_manager_t *this, bool nat_t)
 {
@@ -178,6 +209,7 @@ socket_manager_t *socket_manager_create()
 	INIT(this,
 		.public = {
 			.send = _sender,
+			.send_batch = _sender_batch,
 			.receive = _receiver,
 			.get_port = _get_port,
 			.supported_families = _supported_families,
@@ -52,6 +52,19 @@ struct socket_manager_t {
 	 */
 	status_t (*send)(socket_manager_t *this, packet_t *packet);
 
+	/**
+	 * Send a batch of packets through the registered socket.
+	 *
+	 * @param packets		array of packets to send out
+	 * @param count			number of packets in the array
+	 * @return
+	 *						- SUCCESS when all packets successfully sent
+	 *						- NOT_SUPPORTED if no socket is registered
+	 *						- FAILED when unable to send some of them
+	 */
+	status_t (*send_batch)(socket_manager_t *this, packet_t **packets,
+						   int count);
+
 	/**
 	 * Get the port the registered socket is listening on.
 	 *
@@ -17,9 +17,15 @@
 
 #include <utils/debug.h>
 #include <library.h>
+#include <collections/linked_list.h>
+#include <threading/mutex.h>
+#include <processing/jobs/callback_job.h>
 
 #include "attr_sql_provider.h"
 
+/** maximum number of queued history records before flushing inline */
+#define QUEUE_MAX 1000
+
 typedef struct private_attr_sql_provider_t private_attr_sql_provider_t;
 
 /**
@@ -41,8 +47,121 @@ struct private_attr_sql_provider_t {
 	 * whether to record lease history in lease table
 	 */
 	bool history;
+
+	/**
+	 * milliseconds to batch history records before flushing, 0 to disable
+	 */
+	u_int flush_interval;
+
+	/**
+	 * queued history records, as history_t
+	 */
+	linked_list_t *queue;
+
+	/**
+	 * lock for queue
+	 */
+	mutex_t *mutex;
+
+	/**
+	 * TRUE if a flush job is scheduled
+	 */
+	bool job_scheduled;
 };
 
+/**
+ * Queued lease history record
+ */
+typedef struct {
+	/** pool the lease was allocated from */
+	u_int pool;
+	/** leased address */
+	chunk_t address;
+	/** timestamp the lease was released */
+	u_int released;
+} history_t;
+
+/**
+ * Write a batch of queued history records in one transaction, owns the queue
+ */
+static void flush_history(private_attr_sql_provider_t *this,
+						  linked_list_t *queue)
+{
+	history_t *record;
+
+	this->db->transaction(this->db, FALSE);
+	while (queue->remove_first(queue, (void**)&record) == SUCCESS)
+	{
+		/* the released timestamp guards against recording a lease that got
+		 * re-acquired since the record was queued */
+		this->db->execute(this->db, NULL,
+			"INSERT INTO leases (address, identity, acquired, released)"
+			" SELECT id, identity, acquired, ? FROM addresses "
+			" WHERE pool = ? AND address = ? AND released = ?",
+			DB_UINT, record->released, DB_UINT, record->pool,
+			DB_BLOB, record->address, DB_UINT, record->released);
+		chunk_free(&record->address);
+		free(record);
+	}
+	this->db->commit(this->db);
+	queue->destroy(queue);
+}
+
+/**
+ * Job flushing the history queue after the flush interval expired
+ */
+static job_requeue_t flush_history_job(private_attr_sql_provider_t *this)
+{
+	linked_list_t *queue;
+
+	this->mutex->lock(this->mutex);
+	queue = this->queue;
+	this->queue = linked_list_create();
+	this->job_scheduled = FALSE;
+	this->mutex->unlock(this->mutex);
+
+	flush_history(this, queue);
+	return JOB_REQUEUE_NONE;
+}
+
+/**
+ * Queue a history record, scheduling a flush job or flushing inline if full
+ */
+static void queue_history(private_attr_sql_provider_t *this, u_int pool,
+						  chunk_t address, u_int released)
+{
+	linked_list_t *queue = NULL;
+	history_t *record;
+
+	INIT(record,
+		.pool = pool,
+		.address = chunk_clone(address),
+		.released = released,
+	);
+
+	this->mutex->lock(this->mutex);
+	this->queue->insert_last(this->queue, record);
+	if (this->queue->get_count(this->queue) >= QUEUE_MAX)
+	{
+		queue = this->queue;
+		this->queue = linked_list_create();
+	}
+	else if (!this->job_scheduled)
+	{
+		this->job_scheduled = TRUE;
+		lib->scheduler->schedule_job_ms(lib->scheduler, (job_t*)
+				callback_job_create((callback_job_cb_t)flush_history_job, this,
+									NULL, (callback_job_cancel_t)return_false),
+				this->flush_interval);
+	}
+	this->mutex->unlock(this->mutex);
+
+	if (queue)
+	{
+		flush_history(this, queue);
+	}
+}
+
 /**
  * lookup/insert an identity
  */
@@ -319,17 +438,25 @@ METHOD(attribute_provider_t, release_address, bool,
 		}
 		if (this->db->execute(this->db, NULL,
 				"UPDATE addresses SET released = ? WHERE "
-				"pool = ? AND address = ?", DB_UINT, time(NULL),
+				"pool = ? AND address = ?", DB_UINT, now,
 				DB_UINT, pool, DB_BLOB, address->get_address(address)) > 0)
 		{
 			if (this->history)
 			{
-				this->db->execute(this->db, NULL,
-					"INSERT INTO leases (address, identity, acquired, released)"
-					" SELECT id, identity, acquired, ? FROM addresses "
-					" WHERE pool = ? AND address = ?",
-					DB_UINT, now, DB_UINT, pool,
-					DB_BLOB, address->get_address(address));
+				if (this->flush_interval)
+				{
+					queue_history(this, pool, address->get_address(address),
+								  now);
+				}
+				else
+				{
+					this->db->execute(this->db, NULL,
+						"INSERT INTO leases (address, identity, acquired, "
+						"released) SELECT id, identity, acquired, ? "
+						"FROM addresses WHERE pool = ? AND address = ?",
+						DB_UINT, now, DB_UINT, pool,
+						DB_BLOB, address->get_address(address));
+				}
 			}
 			found = TRUE;
 			break;
@@ -438,6 +565,16 @@ METHOD(attribute_provider_t, create_attribute_enumerator, enumerator_t*,
 METHOD(attr_sql_provider_t, destroy, void,
 	private_attr_sql_provider_t *this)
 {
+	linked_list_t *queue;
+
+	this->mutex->lock(this->mutex);
+	queue = this->queue;
+	this->queue = linked_list_create();
+	this->mutex->unlock(this->mutex);
+	flush_history(this, queue);
+
+	this->queue->destroy(this->queue);
+	this->mutex->destroy(this->mutex);
 	free(this);
 }
 
@@ -461,6 +598,10 @@ attr_sql_provider_t *attr_sql_provider_create(database_t *db)
 		.db = db,
 		.history = lib->settings->get_bool(lib->settings,
 							"%s.plugins.attr-sql.lease_history", TRUE, lib->ns),
+		.flush_interval = lib->settings->get_int(lib->settings,
+							"%s.plugins.attr-sql.flush_interval", 0, lib->ns),
+		.queue = linked_list_create(),
+		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
 	);
 
 	/* close any "online" leases in the case we crashed */
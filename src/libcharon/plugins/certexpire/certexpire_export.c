@@ -25,6 +25,7 @@
 #include <daemon.h>
 #include <collections/hashtable.h>
 #include <threading/mutex.h>
+#include <processing/jobs/callback_job.h>
 #include <credentials/certificates/x509.h>
 
 typedef struct private_certexpire_export_t private_certexpire_export_t;
@@ -93,6 +94,16 @@ struct private_certexpire_export_t {
 	 * Force export of all trustchains we have a private key for
 	 */
 	bool force;
+
+	/**
+	 * Seconds to defer exports triggered by add(), coalescing bursts
+	 */
+	u_int delay;
+
+	/**
+	 * TRUE while a deferred export job is scheduled
+	 */
+	bool pending;
 };
 
 /**
@@ -189,6 +200,46 @@ static void export_csv(private_certexpire_export_t *this, char *path,
 	}
 }
 
+/**
+ * Deferred export job, writing out all entries cached in the meantime
+ */
+static job_requeue_t delayed_export(private_certexpire_export_t *this)
+{
+	int local, remote;
+
+	this->mutex->lock(this->mutex);
+	this->pending = FALSE;
+	local = this->local->get_count(this->local);
+	remote = this->remote->get_count(this->remote);
+	this->mutex->unlock(this->mutex);
+
+	if (local && this->local_path)
+	{
+		export_csv(this, this->local_path, this->local);
+	}
+	if (remote && this->remote_path)
+	{
+		export_csv(this, this->remote_path, this->remote);
+	}
+	return JOB_REQUEUE_NONE;
+}
+
+/**
+ * Schedule a deferred export, if none is pending yet
+ */
+static void schedule_export(private_certexpire_export_t *this)
+{
+	this->mutex->lock(this->mutex);
+	if (!this->pending)
+	{
+		this->pending = TRUE;
+		lib->scheduler->schedule_job(lib->scheduler,
+			(job_t*)callback_job_create((callback_job_cb_t)delayed_export,
+										this, NULL, NULL), this->delay);
+	}
+	this->mutex->unlock(this->mutex);
+}
+
 METHOD(certexpire_export_t, add, void,
 	private_certexpire_export_t *this, linked_list_t *trustchain, bool local)
 {
@@ -296,9 +347,13 @@ METHOD(certexpire_export_t, add, void,
 			free(entry);
 		}
 		if (!this->cron)
-		{	/* export directly if no cron job defined */
-			if (local)
-			{
+		{
+			if (this->delay)
+			{	/* coalesce bursts of updates into a single export */
+				schedule_export(this);
+			}
+			else if (local)
+			{	/* export directly if no cron job or delay defined */
 				export_csv(this, this->local_path, this->local);
 			}
 			else
@@ -450,6 +505,9 @@ certexpire_export_t *certexpire_export_create()
 		.force = lib->settings->get_bool(lib->settings,
 									"%s.plugins.certexpire.csv.force",
 									TRUE, lib->ns),
+		.delay = lib->settings->get_int(lib->settings,
+									"%s.plugins.certexpire.csv.delay",
+									5, lib->ns),
 	);
 
 	cron = lib->settings->get_str(lib->settings,
@@ -25,6 +25,7 @@
 #include <linux/if_ether.h>
 #include <linux/filter.h>
 
+#include <collections/hashtable.h>
 #include <collections/linked_list.h>
 #include <utils/identification.h>
 #include <threading/mutex.h>
@@ -38,6 +39,8 @@
 #define DHCP_SERVER_PORT 67
 #define DHCP_CLIENT_PORT 68
 #define DHCP_TRIES 5
+/** maximum number of cached leases for reconnecting clients */
+#define LEASE_CACHE_SIZE 500
 
 typedef struct private_dhcp_socket_t private_dhcp_socket_t;
 
@@ -57,22 +60,17 @@ struct private_dhcp_socket_t {
 	rng_t *rng;
 
 	/**
-	 * List of transactions in DISCOVER
+	 * Pending transactions, as entry_t keyed by transaction ID
 	 */
-	linked_list_t *discover;
+	hashtable_t *transactions;
 
 	/**
-	 * List of transactions in REQUEST
+	 * Completed leases of reconnecting clients, keyed by identity
 	 */
-	linked_list_t *request;
+	hashtable_t *leases;
 
 	/**
-	 * List of successfully completed transactions
-	 */
-	linked_list_t *completed;
-
-	/**
-	 * Lock for transactions
+	 * Lock for transactions and leases
 	 */
 	mutex_t *mutex;
 
@@ -112,6 +110,85 @@ struct private_dhcp_socket_t {
 	bool force_dst;
 };
 
+/**
+ * States of a pending transaction
+ */
+typedef enum {
+	/** DISCOVER sent, waiting for OFFER */
+	DHCP_DISCOVERING,
+	/** REQUEST sent, waiting for ACK */
+	DHCP_REQUESTING,
+	/** ACK received */
+	DHCP_COMPLETED,
+} entry_state_t;
+
+/**
+ * Entry for a pending transaction
+ */
+typedef struct {
+	/** DHCP transaction ID, hashtable key */
+	u_int32_t id;
+	/** current state */
+	entry_state_t state;
+	/** transaction being negotiated, owned by the enrolling thread */
+	dhcp_transaction_t *transaction;
+} entry_t;
+
+/**
+ * Hashtable hash function for transaction entries
+ */
+static u_int entry_hash(entry_t *entry)
+{
+	return chunk_hash(chunk_from_thing(entry->id));
+}
+
+/**
+ * Hashtable equals function for transaction entries
+ */
+static bool entry_equals(entry_t *a, entry_t *b)
+{
+	return a->id == b->id;
+}
+
+/**
+ * Cached lease of a previously enrolled client
+ */
+typedef struct {
+	/** client identity, hashtable key */
+	identification_t *id;
+	/** last assigned address */
+	host_t *address;
+	/** server the lease was assigned from */
+	host_t *server;
+} lease_t;
+
+/**
+ * Clean up a cached lease
+ */
+static void lease_destroy(lease_t *lease)
+{
+	lease->id->destroy(lease->id);
+	DESTROY_IF(lease->address);
+	DESTROY_IF(lease->server);
+	free(lease);
+}
+
+/**
+ * Hashtable hash function for leases
+ */
+static u_int id_hash(identification_t *id)
+{
+	return chunk_hash(id->get_encoding(id));
+}
+
+/**
+ * Hashtable equals function for leases
+ */
+static bool id_equals(identification_t *a, identification_t *b)
+{
+	return a->equals(a, b);
+}
+
 /**
  * DHCP opcode (or BOOTP actually)
  */
@@ -288,12 +365,25 @@ static bool discover(private_dhcp_socket_t *this,
 {
 	dhcp_option_t *option;
 	dhcp_t dhcp;
+	host_t *offer;
+	chunk_t chunk;
 	int optlen;
 
 	optlen = prepare_dhcp(this, transaction, DHCP_DISCOVER, &dhcp);
 
 	DBG1(DBG_CFG, "sending DHCP DISCOVER to %H", this->dst);
 
+	offer = transaction->get_address(transaction);
+	if (offer)
+	{	/* ask for the address of the cached lease */
+		option = (dhcp_option_t*)&dhcp.options[optlen];
+		option->type = DHCP_REQUESTED_IP;
+		option->len = 4;
+		chunk = offer->get_address(offer);
+		memcpy(option->data, chunk.ptr, min(chunk.len, option->len));
+		optlen += sizeof(dhcp_option_t) + option->len;
+	}
+
 	option = (dhcp_option_t*)&dhcp.options[optlen];
 	option->type = DHCP_PARAM_REQ_LIST;
 	option->len = 2;
@@ -364,10 +454,55 @@ static bool request(private_dhcp_socket_t *this,
 	return TRUE;
 }
 
+/**
+ * Update the cached lease of a completed transaction, with the mutex held
+ */
+static void update_lease(private_dhcp_socket_t *this,
+						 dhcp_transaction_t *transaction)
+{
+	identification_t *identity;
+	enumerator_t *enumerator;
+	host_t *address, *server;
+	lease_t *lease;
+
+	address = transaction->get_address(transaction);
+	server = transaction->get_server(transaction);
+	if (!address || !server)
+	{
+		return;
+	}
+	identity = transaction->get_identity(transaction);
+	lease = this->leases->get(this->leases, identity);
+	if (!lease)
+	{
+		if (this->leases->get_count(this->leases) >= LEASE_CACHE_SIZE)
+		{	/* cache full, evict an arbitrary lease */
+			enumerator = this->leases->create_enumerator(this->leases);
+			if (enumerator->enumerate(enumerator, NULL, (void**)&lease))
+			{
+				this->leases->remove_at(this->leases, enumerator);
+				lease_destroy(lease);
+			}
+			enumerator->destroy(enumerator);
+		}
+		INIT(lease,
+			.id = identity->clone(identity),
+		);
+		this->leases->put(this->leases, lease->id, lease);
+	}
+	DESTROY_IF(lease->address);
+	DESTROY_IF(lease->server);
+	lease->address = address->clone(address);
+	lease->server = server->clone(server);
+}
+
 METHOD(dhcp_socket_t, enroll, dhcp_transaction_t*,
 	private_dhcp_socket_t *this, identification_t *identity)
 {
 	dhcp_transaction_t *transaction;
+	entry_t *entry;
+	lease_t *lease;
+	timeval_t tv;
 	u_int32_t id;
 	int try;
 
@@ -378,23 +513,48 @@ METHOD(dhcp_socket_t, enroll, dhcp_transaction_t*,
 	}
 	transaction = dhcp_transaction_create(id, identity);
 
+	INIT(entry,
+		.id = id,
+		.state = DHCP_DISCOVERING,
+		.transaction = transaction,
+	);
+
 	this->mutex->lock(this->mutex);
-	this->discover->insert_last(this->discover, transaction);
+	lease = this->leases->get(this->leases, identity);
+	if (lease)
+	{	/* ask for the last lease of the reconnecting client, directly at the
+		 * server it was assigned from */
+		transaction->set_address(transaction,
+								 lease->address->clone(lease->address));
+		transaction->set_server(transaction,
+								lease->server->clone(lease->server));
+	}
+	this->transactions->put(this->transactions, entry, entry);
+
 	try = 1;
 	while (try <= DHCP_TRIES && discover(this, transaction))
 	{
-		if (!this->condvar->timed_wait(this->condvar, this->mutex, 1000 * try) &&
-			this->request->find_first(this->request, NULL,
-									  (void**)&transaction) == SUCCESS)
+		time_monotonic(&tv);
+		tv.tv_sec += try;
+		while (entry->state == DHCP_DISCOVERING &&
+			   !this->condvar->timed_wait_abs(this->condvar, this->mutex, tv))
+		{
+			/* woken for another transaction, keep waiting */
+		}
+		if (entry->state != DHCP_DISCOVERING)
 		{
 			break;
 		}
+		/* fall back to broadcast if a cached server does not respond */
+		transaction->set_server(transaction, NULL);
 		try++;
 	}
-	if (this->discover->remove(this->discover, transaction, NULL))
+	if (entry->state == DHCP_DISCOVERING)
 	{	/* no OFFER received */
+		this->transactions->remove(this->transactions, entry);
 		this->mutex->unlock(this->mutex);
 		transaction->destroy(transaction);
+		free(entry);
 		DBG1(DBG_CFG, "DHCP DISCOVER timed out");
 		return NULL;
 	}
@@ -402,21 +562,31 @@ METHOD(dhcp_socket_t, enroll, dhcp_transaction_t*,
 	try = 1;
 	while (try <= DHCP_TRIES && request(this, transaction))
 	{
-		if (!this->condvar->timed_wait(this->condvar, this->mutex, 1000 * try) &&
-			this->completed->remove(this->completed, transaction, NULL))
+		time_monotonic(&tv);
+		tv.tv_sec += try;
+		while (entry->state == DHCP_REQUESTING &&
+			   !this->condvar->timed_wait_abs(this->condvar, this->mutex, tv))
+		{
+			/* woken for another transaction, keep waiting */
+		}
+		if (entry->state != DHCP_REQUESTING)
 		{
 			break;
 		}
 		try++;
 	}
-	if (this->request->remove(this->request, transaction, NULL))
+	this->transactions->remove(this->transactions, entry);
+	if (entry->state != DHCP_COMPLETED)
 	{	/* no ACK received */
 		this->mutex->unlock(this->mutex);
 		transaction->destroy(transaction);
+		free(entry);
 		DBG1(DBG_CFG, "DHCP REQUEST timed out");
 		return NULL;
 	}
+	update_lease(this, transaction);
 	this->mutex->unlock(this->mutex);
+	free(entry);
 
 	return transaction;
 }
@@ -464,31 +634,24 @@ METHOD(dhcp_socket_t, release, void,
  */
 static void handle_offer(private_dhcp_socket_t *this, dhcp_t *dhcp, int optlen)
 {
-	dhcp_transaction_t *transaction = NULL;
-	enumerator_t *enumerator;
+	dhcp_transaction_t *transaction;
+	entry_t *entry, lookup = {
+		.id = dhcp->transaction_id,
+	};
 	host_t *offer, *server = NULL;
 
 	offer = host_create_from_chunk(AF_INET,
 					chunk_from_thing(dhcp->your_address), 0);
 
 	this->mutex->lock(this->mutex);
-	enumerator = this->discover->create_enumerator(this->discover);
-	while (enumerator->enumerate(enumerator, &transaction))
-	{
-		if (transaction->get_id(transaction) == dhcp->transaction_id)
-		{
-			this->discover->remove_at(this->discover, enumerator);
-			this->request->insert_last(this->request, transaction);
-			break;
-		}
-	}
-	enumerator->destroy(enumerator);
-
-	if (transaction)
+	entry = this->transactions->get(this->transactions, &lookup);
+	if (entry && entry->state == DHCP_DISCOVERING)
 	{
 		int optsize, optpos = 0, pos;
 		dhcp_option_t *option;
 
+		transaction = entry->transaction;
+
 		while (optlen > sizeof(dhcp_option_t))
 		{
 			option = (dhcp_option_t*)&dhcp->options[optpos];
@@ -523,6 +686,7 @@ static void handle_offer(private_dhcp_socket_t *this, dhcp_t *dhcp, int optlen)
 		DBG1(DBG_CFG, "received DHCP OFFER %H from %H", offer, server);
 		transaction->set_address(transaction, offer->clone(offer));
 		transaction->set_server(transaction, server);
+		entry->state = DHCP_REQUESTING;
 	}
 	this->mutex->unlock(this->mutex);
 	this->condvar->broadcast(this->condvar);
@@ -534,26 +698,21 @@ static void handle_offer(private_dhcp_socket_t *this, dhcp_t *dhcp, int optlen)
  */
 static void handle_ack(private_dhcp_socket_t *this, dhcp_t *dhcp, int optlen)
 {
-	dhcp_transaction_t *transaction;
-	enumerator_t *enumerator;
+	entry_t *entry, lookup = {
+		.id = dhcp->transaction_id,
+	};
 	host_t *offer;
 
 	offer = host_create_from_chunk(AF_INET,
-						chunk_from_thing(dhcp->your_address), 0);
+					chunk_from_thing(dhcp->your_address), 0);
 
 	this->mutex->lock(this->mutex);
-	enumerator = this->request->create_enumerator(this->request);
-	while (enumerator->enumerate(enumerator, &transaction))
+	entry = this->transactions->get(this->transactions, &lookup);
+	if (entry && entry->state == DHCP_REQUESTING)
 	{
-		if (transaction->get_id(transaction) == dhcp->transaction_id)
-		{
-			DBG1(DBG_CFG, "received DHCP ACK for %H", offer);
-			this->request->remove_at(this->request, enumerator);
-			this->completed->insert_last(this->completed, transaction);
-			break;
-		}
+		DBG1(DBG_CFG, "received DHCP ACK for %H", offer);
+		entry->state = DHCP_COMPLETED;
 	}
-	enumerator->destroy(enumerator);
 	this->mutex->unlock(this->mutex);
 	this->condvar->broadcast(this->condvar);
 	offer->destroy(offer);
@@ -616,6 +775,10 @@ static bool receive_dhcp(private_dhcp_socket_t *this, int fd,
 METHOD(dhcp_socket_t, destroy, void,
 	private_dhcp_socket_t *this)
 {
+	enumerator_t *enumerator;
+	entry_t *entry;
+	lease_t *lease;
+
 	while (this->waiting)
 	{
 		this->condvar->signal(this->condvar);
@@ -631,12 +794,21 @@ METHOD(dhcp_socket_t, destroy, void,
 	}
 	this->mutex->destroy(this->mutex);
 	this->condvar->destroy(this->condvar);
-	this->discover->destroy_offset(this->discover,
-								offsetof(dhcp_transaction_t, destroy));
-	this->request->destroy_offset(this->request,
-								offsetof(dhcp_transaction_t, destroy));
-	this->completed->destroy_offset(this->completed,
-								offsetof(dhcp_transaction_t, destroy));
+	enumerator = this->transactions->create_enumerator(this->transactions);
+	while (enumerator->enumerate(enumerator, NULL, (void**)&entry))
+	{
+		entry->transaction->destroy(entry->transaction);
+		free(entry);
+	}
+	enumerator->destroy(enumerator);
+	this->transactions->destroy(this->transactions);
+	enumerator = this->leases->create_enumerator(this->leases);
+	while (enumerator->enumerate(enumerator, NULL, (void**)&lease))
+	{
+		lease_destroy(lease);
+	}
+	enumerator->destroy(enumerator);
+	this->leases->destroy(this->leases);
 	DESTROY_IF(this->rng);
 	DESTROY_IF(this->dst);
 	free(this);
@@ -721,9 +893,10 @@ dhcp_socket_t *dhcp_socket_create()
 		.rng = lib->crypto->create_rng(lib->crypto, RNG_WEAK),
 		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
 		.condvar = condvar_create(CONDVAR_TYPE_DEFAULT),
-		.discover = linked_list_create(),
-		.request = linked_list_create(),
-		.completed = linked_list_create(),
+		.transactions = hashtable_create((hashtable_hash_t)entry_hash,
+										 (hashtable_equals_t)entry_equals, 8),
+		.leases = hashtable_create((hashtable_hash_t)id_hash,
+								   (hashtable_equals_t)id_equals, 8),
 	);
 
 	if (!this->rng)
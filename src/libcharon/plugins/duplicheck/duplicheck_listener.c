@@ -21,37 +21,53 @@
 #include <encoding/payloads/delete_payload.h>
 #include <processing/jobs/delete_ike_sa_job.h>
 
+/**
+ * Number of table shards, should be a power of two
+ */
+#define SHARD_COUNT 8
+
 typedef struct private_duplicheck_listener_t private_duplicheck_listener_t;
 
 /**
- * Private data of an duplicheck_listener_t object.
+ * Shard of the identity tables, with its own lock
  */
-struct private_duplicheck_listener_t {
+typedef struct {
 
 	/**
-	 * Public duplicheck_listener_t interface.
+	 * Mutex to lock the shards hashtables
 	 */
-	duplicheck_listener_t public;
+	mutex_t *mutex;
 
 	/**
-	 * Socket to send notifications to
+	 * Hashtable of active IKE_SAs, identification_t => entry_t
 	 */
-	duplicheck_notify_t *notify;
+	hashtable_t *active;
 
 	/**
-	 * Mutex to lock hashtables
+	 * Hashtable with active liveness checks, identification_t => entry_t
 	 */
-	mutex_t *mutex;
+	hashtable_t *checking;
+} shard_t;
+
+/**
+ * Private data of an duplicheck_listener_t object.
+ */
+struct private_duplicheck_listener_t {
 
 	/**
-	 * Hashtable of active IKE_SAs, identification_t => entry_t
+	 * Public duplicheck_listener_t interface.
 	 */
-	hashtable_t *active;
+	duplicheck_listener_t public;
 
 	/**
-	 * Hashtable with active liveness checks, identification_t => entry_t
+	 * Socket to send notifications to
 	 */
-	hashtable_t *checking;
+	duplicheck_notify_t *notify;
+
+	/**
+	 * Table shards, addressed by identity hash
+	 */
+	shard_t shards[SHARD_COUNT];
 };
 
 /**
@@ -90,6 +106,15 @@ static bool equals(identification_t *a, identification_t *b)
 	return a->equals(a, b);
 }
 
+/**
+ * Get the shard responsible for an identity
+ */
+static shard_t *shard_for(private_duplicheck_listener_t *this,
+						  identification_t *id)
+{
+	return &this->shards[hash(id) % SHARD_COUNT];
+}
+
 /**
  * Put an IKE_SA identifier to hashtable
  */
@@ -178,12 +203,27 @@ static bool remove_specific(hashtable_t *table, identification_t *id,
 METHOD(listener_t, ike_rekey, bool,
 	private_duplicheck_listener_t *this, ike_sa_t *old, ike_sa_t *new)
 {
-	this->mutex->lock(this->mutex);
+	shard_t *sold, *snew;
+
+	sold = shard_for(this, old->get_other_id(old));
+	snew = shard_for(this, new->get_other_id(new));
 
-	remove_specific(this->active, old->get_other_id(old), old->get_id(old));
-	put(this->active, new->get_other_id(new), new->get_id(new));
+	/* the identity does not change on rekeying, but lock in a defined
+	 * order should the shards ever differ */
+	sold->mutex->lock(sold->mutex);
+	if (snew != sold)
+	{
+		snew->mutex->lock(snew->mutex);
+	}
 
-	this->mutex->unlock(this->mutex);
+	remove_specific(sold->active, old->get_other_id(old), old->get_id(old));
+	put(snew->active, new->get_other_id(new), new->get_id(new));
+
+	if (snew != sold)
+	{
+		snew->mutex->unlock(snew->mutex);
+	}
+	sold->mutex->unlock(sold->mutex);
 
 	return TRUE;
 }
@@ -193,40 +233,42 @@ METHOD(listener_t, ike_updown, bool,
 {
 	identification_t *id;
 	ike_sa_id_t *sa;
+	shard_t *shard;
 
 	id = ike_sa->get_other_id(ike_sa);
+	shard = shard_for(this, id);
 
-	this->mutex->lock(this->mutex);
+	shard->mutex->lock(shard->mutex);
 	if (up)
 	{
 		/* another IKE_SA for this identity active? */
-		sa = remove_first(this->active, id);
+		sa = remove_first(shard->active, id);
 		if (sa)
 		{
 			DBG1(DBG_CFG, "detected duplicate IKE_SA for '%Y', "
 				 "triggering delete for old IKE_SA", id);
-			put(this->checking, id, sa);
+			put(shard->checking, id, sa);
 			lib->processor->queue_job(lib->processor,
 								(job_t*)delete_ike_sa_job_create(sa, TRUE));
 			sa->destroy(sa);
 		}
 		/* register IKE_SA as the new active */
 		sa = ike_sa->get_id(ike_sa);
-		put(this->active, id, sa);
+		put(shard->active, id, sa);
 	}
 	else
 	{
 		sa = ike_sa->get_id(ike_sa);
 		/* check if closing an IKE_SA currently in checking state */
-		if (remove_specific(this->checking, id, sa))
+		if (remove_specific(shard->checking, id, sa))
 		{
 			DBG1(DBG_CFG, "delete for duplicate IKE_SA '%Y' timed out, "
 				 "keeping new IKE_SA", id);
 		}
 		/* check normal close of IKE_SA */
-		remove_specific(this->active, id, sa);
+		remove_specific(shard->active, id, sa);
 	}
-	this->mutex->unlock(this->mutex);
+	shard->mutex->unlock(shard->mutex);
 
 	return TRUE;
 }
@@ -239,30 +281,32 @@ METHOD(listener_t, message_hook, bool,
 	{
 		identification_t *id;
 		ike_sa_id_t *sa;
+		shard_t *shard;
 
 		id = ike_sa->get_other_id(ike_sa);
 		sa = ike_sa->get_id(ike_sa);
+		shard = shard_for(this, id);
 
-		this->mutex->lock(this->mutex);
-		if (remove_specific(this->checking, id, sa))
+		shard->mutex->lock(shard->mutex);
+		if (remove_specific(shard->checking, id, sa))
 		{
 			DBG1(DBG_CFG, "got a response on a duplicate IKE_SA for '%Y', "
 				 "deleting new IKE_SA", id);
 			charon->bus->alert(charon->bus, ALERT_UNIQUE_KEEP);
-			sa = remove_first(this->active, id);
+			sa = remove_first(shard->active, id);
 			if (sa)
 			{
 				lib->processor->queue_job(lib->processor,
 								(job_t*)delete_ike_sa_job_create(sa, TRUE));
 				sa->destroy(sa);
 			}
-			this->mutex->unlock(this->mutex);
+			shard->mutex->unlock(shard->mutex);
 
 			this->notify->send(this->notify, id);
 		}
 		else
 		{
-			this->mutex->unlock(this->mutex);
+			shard->mutex->unlock(shard->mutex);
 		}
 	}
 	return TRUE;
@@ -273,25 +317,32 @@ METHOD(duplicheck_listener_t, destroy, void,
 {
 	enumerator_t *enumerator;
 	identification_t *key;
+	shard_t *shard;
 	entry_t *value;
+	int i;
 
-	enumerator = this->active->create_enumerator(this->active);
-	while (enumerator->enumerate(enumerator, &key, &value))
+	for (i = 0; i < SHARD_COUNT; i++)
 	{
-		entry_destroy(value);
-	}
-	enumerator->destroy(enumerator);
+		shard = &this->shards[i];
 
-	enumerator = this->checking->create_enumerator(this->checking);
-	while (enumerator->enumerate(enumerator, &key, &value))
-	{
-		entry_destroy(value);
-	}
-	enumerator->destroy(enumerator);
+		enumerator = shard->active->create_enumerator(shard->active);
+		while (enumerator->enumerate(enumerator, &key, &value))
+		{
+			entry_destroy(value);
+		}
+		enumerator->destroy(enumerator);
+
+		enumerator = shard->checking->create_enumerator(shard->checking);
+		while (enumerator->enumerate(enumerator, &key, &value))
+		{
+			entry_destroy(value);
+		}
+		enumerator->destroy(enumerator);
 
-	this->active->destroy(this->active);
-	this->checking->destroy(this->checking);
-	this->mutex->destroy(this->mutex);
+		shard->active->destroy(shard->active);
+		shard->checking->destroy(shard->checking);
+		shard->mutex->destroy(shard->mutex);
+	}
 	free(this);
 }
 
@@ -301,6 +352,8 @@ METHOD(duplicheck_listener_t, destroy, void,
 duplicheck_listener_t *duplicheck_listener_create(duplicheck_notify_t *notify)
 {
 	private_duplicheck_listener_t *this;
+	shard_t *shard;
+	int i;
 
 	INIT(this,
 		.public = {
@@ -312,12 +365,17 @@ duplicheck_listener_t *duplicheck_listener_create(duplicheck_notify_t *notify)
 			.destroy = _destroy,
 		},
 		.notify = notify,
-		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
-		.active = hashtable_create((hashtable_hash_t)hash,
-								   (hashtable_equals_t)equals, 32),
-		.checking = hashtable_create((hashtable_hash_t)hash,
-									 (hashtable_equals_t)equals, 2),
 	);
 
+	for (i = 0; i < SHARD_COUNT; i++)
+	{
+		shard = &this->shards[i];
+		shard->mutex = mutex_create(MUTEX_TYPE_DEFAULT);
+		shard->active = hashtable_create((hashtable_hash_t)hash,
+										 (hashtable_equals_t)equals, 8);
+		shard->checking = hashtable_create((hashtable_hash_t)hash,
+										   (hashtable_equals_t)equals, 2);
+	}
+
 	return &this->public;
 }
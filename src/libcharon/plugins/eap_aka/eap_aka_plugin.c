@@ -74,6 +74,7 @@ METHOD(plugin_t, destroy, void,
 {
 	lib->set(lib, "aka-manager", NULL);
 	this->mgr->destroy(this->mgr);
+	libsimaka_deinit();
 	free(this);
 }
 
@@ -94,6 +95,7 @@ plugin_t *eap_aka_plugin_create()
 		},
 		.mgr = simaka_manager_create(),
 	);
+	libsimaka_init();
 	lib->set(lib, "aka-manager", this->mgr);
 
 	return &this->public.plugin;
@@ -43,7 +43,7 @@ struct private_eap_peap_t {
 /** Maximum number of EAP-PEAP messages/fragments allowed */
 #define MAX_MESSAGE_COUNT 32
 /** Default size of a EAP-PEAP fragment */
-#define MAX_FRAGMENT_LEN 1024
+#define MAX_FRAGMENT_LEN 4096
 
 METHOD(eap_method_t, initiate, status_t,
 	private_eap_peap_t *this, eap_payload_t **out)
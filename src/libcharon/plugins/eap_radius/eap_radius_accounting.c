@@ -22,9 +22,20 @@
 #include <radius_client.h>
 #include <daemon.h>
 #include <collections/hashtable.h>
+#include <collections/linked_list.h>
 #include <threading/mutex.h>
 #include <processing/jobs/callback_job.h>
 
+/**
+ * Attempts to deliver a spooled accounting record before dropping it
+ */
+#define SPOOL_RETRIES 5
+
+/**
+ * Seconds a spool sender backs off after a failed delivery
+ */
+#define SPOOL_RETRY_INTERVAL 30
+
 typedef struct private_eap_radius_accounting_t private_eap_radius_accounting_t;
 
 /**
@@ -61,8 +72,43 @@ struct private_eap_radius_accounting_t {
 	 * Disable accounting unless IKE_SA has at least one virtual IP
 	 */
 	bool acct_req_vip;
+
+	/**
+	 * Queued accounting records, as record_t, if spooling is enabled
+	 */
+	linked_list_t *spool;
+
+	/**
+	 * Mutex to lock the spool
+	 */
+	mutex_t *spool_mutex;
+
+	/**
+	 * Maximum number of spooled records, 0 to send synchronously
+	 */
+	u_int spool_size;
+
+	/**
+	 * Maximum number of concurrent spool sender jobs
+	 */
+	u_int spool_window;
+
+	/**
+	 * Number of currently active spool sender jobs
+	 */
+	u_int spool_senders;
 };
 
+/**
+ * A spooled accounting record
+ */
+typedef struct {
+	/** accounting request to deliver */
+	radius_message_t *message;
+	/** delivery attempts so far */
+	int tries;
+} record_t;
+
 /**
  * Singleton instance of accounting
  */
@@ -202,6 +248,74 @@ static bool send_message(private_eap_radius_accounting_t *this,
 	return ack;
 }
 
+/**
+ * Spool sender job, deliver queued records until the spool drains
+ */
+static job_requeue_t drain_spool(private_eap_radius_accounting_t *this)
+{
+	record_t *record;
+
+	this->spool_mutex->lock(this->spool_mutex);
+	if (this->spool->remove_first(this->spool, (void**)&record) != SUCCESS)
+	{
+		this->spool_senders--;
+		this->spool_mutex->unlock(this->spool_mutex);
+		return JOB_REQUEUE_NONE;
+	}
+	this->spool_mutex->unlock(this->spool_mutex);
+
+	if (!send_message(this, record->message))
+	{
+		if (++record->tries < SPOOL_RETRIES)
+		{	/* retry later, preserving order by requeueing at the front */
+			this->spool_mutex->lock(this->spool_mutex);
+			this->spool->insert_first(this->spool, record);
+			this->spool_mutex->unlock(this->spool_mutex);
+			return JOB_RESCHEDULE(SPOOL_RETRY_INTERVAL);
+		}
+		DBG1(DBG_CFG, "dropping spooled RADIUS accounting record after "
+			 "%d attempts", record->tries);
+	}
+	record->message->destroy(record->message);
+	free(record);
+	return JOB_REQUEUE_DIRECT;
+}
+
+/**
+ * Queue an accounting record to the spool, taking ownership of the message
+ */
+static void queue_message(private_eap_radius_accounting_t *this,
+						  radius_message_t *message)
+{
+	record_t *record, *dropped;
+
+	INIT(record,
+		.message = message,
+	);
+	this->spool_mutex->lock(this->spool_mutex);
+	while (this->spool->get_count(this->spool) >= this->spool_size)
+	{
+		if (this->spool->remove_first(this->spool,
+									  (void**)&dropped) != SUCCESS)
+		{
+			break;
+		}
+		DBG1(DBG_CFG, "RADIUS accounting spool full, dropping oldest record");
+		dropped->message->destroy(dropped->message);
+		free(dropped);
+	}
+	this->spool->insert_last(this->spool, record);
+	if (this->spool_senders < this->spool_window)
+	{
+		this->spool_senders++;
+		lib->processor->queue_job(lib->processor,
+			(job_t*)callback_job_create((callback_job_cb_t)drain_spool,
+										this, NULL,
+										(callback_job_cancel_t)return_false));
+	}
+	this->spool_mutex->unlock(this->spool_mutex);
+}
+
 /**
  * Add common IKE_SA parameters to RADIUS account message
  */
@@ -408,16 +522,23 @@ static job_requeue_t send_interim(interim_data_t *data)
 
 	if (message)
 	{
-		if (!send_message(this, message))
+		if (this->spool_size)
+		{
+			queue_message(this, message);
+		}
+		else
 		{
-			if (lib->settings->get_bool(lib->settings,
+			if (!send_message(this, message))
+			{
+				if (lib->settings->get_bool(lib->settings,
 							"%s.plugins.eap-radius.accounting_close_on_timeout",
 							TRUE, lib->ns))
-			{
-				eap_radius_handle_timeout(data->id);
+				{
+					eap_radius_handle_timeout(data->id);
+				}
 			}
+			message->destroy(message);
 		}
-		message->destroy(message);
 	}
 	return JOB_REQUEUE_NONE;
 }
@@ -502,11 +623,18 @@ static void send_start(private_eap_radius_accounting_t *this, ike_sa_t *ike_sa)
 	this->mutex->unlock(this->mutex);
 
 	add_ike_sa_parameters(this, message, ike_sa);
-	if (!send_message(this, message))
+	if (this->spool_size)
+	{
+		queue_message(this, message);
+	}
+	else
 	{
-		eap_radius_handle_timeout(ike_sa->get_id(ike_sa));
+		if (!send_message(this, message))
+		{
+			eap_radius_handle_timeout(ike_sa->get_id(ike_sa));
+		}
+		message->destroy(message);
 	}
-	message->destroy(message);
 }
 
 /**
@@ -564,11 +692,18 @@ static void send_stop(private_eap_radius_accounting_t *this, ike_sa_t *ike_sa)
 		value = htonl(entry->cause);
 		message->add(message, RAT_ACCT_TERMINATE_CAUSE, chunk_from_thing(value));
 
-		if (!send_message(this, message))
+		if (this->spool_size)
 		{
-			eap_radius_handle_timeout(NULL);
+			queue_message(this, message);
+		}
+		else
+		{
+			if (!send_message(this, message))
+			{
+				eap_radius_handle_timeout(NULL);
+			}
+			message->destroy(message);
 		}
-		message->destroy(message);
 		destroy_entry(entry);
 	}
 }
@@ -694,8 +829,17 @@ METHOD(listener_t, child_updown, bool,
 METHOD(eap_radius_accounting_t, destroy, void,
 	private_eap_radius_accounting_t *this)
 {
+	record_t *record;
+
 	charon->bus->remove_listener(charon->bus, &this->public.listener);
 	singleton = NULL;
+	while (this->spool->remove_first(this->spool, (void**)&record) == SUCCESS)
+	{
+		record->message->destroy(record->message);
+		free(record);
+	}
+	this->spool->destroy(this->spool);
+	this->spool_mutex->destroy(this->spool_mutex);
 	this->mutex->destroy(this->mutex);
 	this->sessions->destroy(this->sessions);
 	free(this);
@@ -725,6 +869,13 @@ eap_radius_accounting_t *eap_radius_accounting_create()
 		.sessions = hashtable_create((hashtable_hash_t)hash,
 									 (hashtable_equals_t)equals, 32),
 		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+		.spool = linked_list_create(),
+		.spool_mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+		.spool_size = lib->settings->get_int(lib->settings,
+						"%s.plugins.eap-radius.accounting_spool", 0, lib->ns),
+		.spool_window = lib->settings->get_int(lib->settings,
+						"%s.plugins.eap-radius.accounting_spool_window", 4,
+						lib->ns),
 	);
 	if (lib->settings->get_bool(lib->settings,
 				"%s.plugins.eap-radius.station_id_with_port", TRUE, lib->ns))
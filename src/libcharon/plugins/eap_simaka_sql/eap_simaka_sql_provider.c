@@ -18,6 +18,10 @@
 #include <time.h>
 
 #include <daemon.h>
+#include <collections/hashtable.h>
+#include <collections/linked_list.h>
+#include <threading/mutex.h>
+#include <processing/jobs/callback_job.h>
 
 typedef struct private_eap_simaka_sql_provider_t private_eap_simaka_sql_provider_t;
 
@@ -40,21 +44,141 @@ struct private_eap_simaka_sql_provider_t {
 	 * Remove used triplets/quintuplets from database
 	 */
 	bool remove_used;
+
+	/**
+	 * Number of tuples to keep prefetched per identity, 0 to disable
+	 */
+	int prefetch;
+
+	/**
+	 * Seconds prefetched tuples stay usable
+	 */
+	int prefetch_lifetime;
+
+	/**
+	 * Mutex protecting the prefetch cache
+	 */
+	mutex_t *mutex;
+
+	/**
+	 * Prefetched tuples, imsi_entry_t keyed by identity string
+	 */
+	hashtable_t *cache;
 };
 
-METHOD(simaka_provider_t, get_triplet, bool,
-	private_eap_simaka_sql_provider_t *this, identification_t *id,
-	char rand[SIM_RAND_LEN], char sres[SIM_SRES_LEN], char kc[SIM_KC_LEN])
+/**
+ * A prefetched GSM triplet
+ */
+typedef struct {
+	char rand[SIM_RAND_LEN];
+	char sres[SIM_SRES_LEN];
+	char kc[SIM_KC_LEN];
+} sim_triplet_t;
+
+/**
+ * A prefetched UMTS quintuplet
+ */
+typedef struct {
+	char rand[AKA_RAND_LEN];
+	char xres[AKA_RES_MAX];
+	int xres_len;
+	char ck[AKA_CK_LEN];
+	char ik[AKA_IK_LEN];
+	char autn[AKA_AUTN_LEN];
+} aka_quintuplet_t;
+
+/**
+ * Prefetched tuples of a single identity
+ */
+typedef struct {
+	/** identity string, used as lookup key */
+	char imsi[128];
+	/** FIFO of prefetched sim_triplet_t */
+	linked_list_t *triplets;
+	/** FIFO of prefetched aka_quintuplet_t */
+	linked_list_t *quintuplets;
+	/** time the triplet FIFO was last filled */
+	time_t triplet_time;
+	/** time the quintuplet FIFO was last filled */
+	time_t quintuplet_time;
+	/** is a triplet refill job queued? */
+	bool triplet_refilling;
+	/** is a quintuplet refill job queued? */
+	bool quintuplet_refilling;
+} imsi_entry_t;
+
+/**
+ * Context of a queued refill job
+ */
+typedef struct {
+	/** provider to refill the cache of */
+	private_eap_simaka_sql_provider_t *this;
+	/** identity string to fetch tuples for */
+	char imsi[128];
+	/** TRUE to fetch quintuplets, FALSE for triplets */
+	bool aka;
+} refill_job_t;
+
+/**
+ * Hashtable hash function for identity strings
+ */
+static u_int imsi_hash(char *key)
+{
+	return chunk_hash(chunk_from_str(key));
+}
+
+/**
+ * Hashtable equals function for identity strings
+ */
+static bool imsi_equals(char *a, char *b)
+{
+	return streq(a, b);
+}
+
+/**
+ * Free an imsi_entry_t with all prefetched tuples
+ */
+static void free_imsi_entry(imsi_entry_t *entry)
+{
+	entry->triplets->destroy_function(entry->triplets, free);
+	entry->quintuplets->destroy_function(entry->quintuplets, free);
+	free(entry);
+}
+
+/**
+ * Find or create the cache entry for an identity, this->mutex must be held
+ */
+static imsi_entry_t *get_entry(private_eap_simaka_sql_provider_t *this,
+							   char *imsi)
+{
+	imsi_entry_t *entry;
+
+	entry = this->cache->get(this->cache, imsi);
+	if (!entry)
+	{
+		INIT(entry,
+			.triplets = linked_list_create(),
+			.quintuplets = linked_list_create(),
+		);
+		snprintf(entry->imsi, sizeof(entry->imsi), "%s", imsi);
+		this->cache->put(this->cache, entry->imsi, entry);
+	}
+	return entry;
+}
+
+/**
+ * Fetch a triplet from the database, marking it as used
+ */
+static bool fetch_triplet(private_eap_simaka_sql_provider_t *this, char *imsi,
+		char rand[SIM_RAND_LEN], char sres[SIM_SRES_LEN], char kc[SIM_KC_LEN])
 {
 	chunk_t rand_chunk, sres_chunk, kc_chunk;
 	enumerator_t *query;
 	bool found = FALSE;
-	char buf[128];
 
-	snprintf(buf, sizeof(buf), "%Y", id);
 	query = this->db->query(this->db,
 				"select rand, sres, kc from triplets where id = ? order by used",
-				DB_TEXT, buf, DB_BLOB, DB_BLOB, DB_BLOB);
+				DB_TEXT, imsi, DB_BLOB, DB_BLOB, DB_BLOB);
 	if (query)
 	{
 		if (query->enumerate(query, &rand_chunk, &sres_chunk, &kc_chunk))
@@ -77,32 +201,33 @@ METHOD(simaka_provider_t, get_triplet, bool,
 		{
 			this->db->execute(this->db, NULL,
 					"delete from triplets where id = ? and rand = ?",
-					DB_TEXT, buf, DB_BLOB, chunk_create(rand, SIM_RAND_LEN));
+					DB_TEXT, imsi, DB_BLOB, chunk_create(rand, SIM_RAND_LEN));
 		}
 		else
 		{
 			this->db->execute(this->db, NULL,
 					"update triplets set used = ? where id = ? and rand = ?",
-					DB_UINT, time(NULL), DB_TEXT, buf,
+					DB_UINT, time(NULL), DB_TEXT, imsi,
 					DB_BLOB, chunk_create(rand, SIM_RAND_LEN));
 		}
 	}
 	return found;
 }
 
-METHOD(simaka_provider_t, get_quintuplet, bool,
-	private_eap_simaka_sql_provider_t *this, identification_t *id,
-	char rand[AKA_RAND_LEN], char xres[AKA_RES_MAX], int *xres_len,
-	char ck[AKA_CK_LEN], char ik[AKA_IK_LEN], char autn[AKA_AUTN_LEN])
+/**
+ * Fetch a quintuplet from the database, marking it as used
+ */
+static bool fetch_quintuplet(private_eap_simaka_sql_provider_t *this,
+		char *imsi, char rand[AKA_RAND_LEN], char xres[AKA_RES_MAX],
+		int *xres_len, char ck[AKA_CK_LEN], char ik[AKA_IK_LEN],
+		char autn[AKA_AUTN_LEN])
 {
 	chunk_t rand_chunk, xres_chunk, ck_chunk, ik_chunk, autn_chunk;
 	enumerator_t *query;
 	bool found = FALSE;
-	char buf[128];
 
-	snprintf(buf, sizeof(buf), "%Y", id);
 	query = this->db->query(this->db, "select rand, res, ck, ik, autn "
-				"from quintuplets where id = ? order by used", DB_TEXT, buf,
+				"from quintuplets where id = ? order by used", DB_TEXT, imsi,
 				DB_BLOB, DB_BLOB, DB_BLOB, DB_BLOB, DB_BLOB);
 	if (query)
 	{
@@ -132,22 +257,229 @@ METHOD(simaka_provider_t, get_quintuplet, bool,
 		{
 			this->db->execute(this->db, NULL,
 					"delete from quintuplets where id = ? and rand = ?",
-					DB_TEXT, buf, DB_BLOB, chunk_create(rand, SIM_RAND_LEN));
+					DB_TEXT, imsi, DB_BLOB, chunk_create(rand, AKA_RAND_LEN));
 		}
 		else
 		{
 			this->db->execute(this->db, NULL,
 					"update quintuplets set used = ? where id = ? and rand = ?",
-					DB_UINT, time(NULL), DB_TEXT, buf,
+					DB_UINT, time(NULL), DB_TEXT, imsi,
 					DB_BLOB, chunk_create(rand, AKA_RAND_LEN));
 		}
 	}
 	return found;
 }
 
+/**
+ * Refill the tuple FIFO of an identity on a worker thread
+ */
+static job_requeue_t refill_run(refill_job_t *job)
+{
+	private_eap_simaka_sql_provider_t *this = job->this;
+	imsi_entry_t *entry;
+	bool full;
+
+	while (TRUE)
+	{
+		this->mutex->lock(this->mutex);
+		entry = get_entry(this, job->imsi);
+		if (job->aka)
+		{
+			full = entry->quintuplets->get_count(entry->quintuplets) >=
+																this->prefetch;
+		}
+		else
+		{
+			full = entry->triplets->get_count(entry->triplets) >=
+																this->prefetch;
+		}
+		this->mutex->unlock(this->mutex);
+		if (full)
+		{
+			break;
+		}
+		if (job->aka)
+		{
+			aka_quintuplet_t *q;
+
+			q = malloc_thing(aka_quintuplet_t);
+			if (!fetch_quintuplet(this, job->imsi, q->rand, q->xres,
+								  &q->xres_len, q->ck, q->ik, q->autn))
+			{
+				free(q);
+				break;
+			}
+			this->mutex->lock(this->mutex);
+			entry = get_entry(this, job->imsi);
+			entry->quintuplets->insert_last(entry->quintuplets, q);
+			entry->quintuplet_time = time(NULL);
+			this->mutex->unlock(this->mutex);
+		}
+		else
+		{
+			sim_triplet_t *t;
+
+			t = malloc_thing(sim_triplet_t);
+			if (!fetch_triplet(this, job->imsi, t->rand, t->sres, t->kc))
+			{
+				free(t);
+				break;
+			}
+			this->mutex->lock(this->mutex);
+			entry = get_entry(this, job->imsi);
+			entry->triplets->insert_last(entry->triplets, t);
+			entry->triplet_time = time(NULL);
+			this->mutex->unlock(this->mutex);
+		}
+	}
+
+	this->mutex->lock(this->mutex);
+	entry = get_entry(this, job->imsi);
+	if (job->aka)
+	{
+		entry->quintuplet_refilling = FALSE;
+	}
+	else
+	{
+		entry->triplet_refilling = FALSE;
+	}
+	this->mutex->unlock(this->mutex);
+
+	return JOB_REQUEUE_NONE;
+}
+
+/**
+ * Queue a job refilling the tuple FIFO of an identity
+ */
+static void queue_refill(private_eap_simaka_sql_provider_t *this,
+						 char *imsi, bool aka)
+{
+	refill_job_t *job;
+
+	INIT(job,
+		.this = this,
+		.aka = aka,
+	);
+	snprintf(job->imsi, sizeof(job->imsi), "%s", imsi);
+	lib->processor->queue_job(lib->processor,
+		(job_t*)callback_job_create((callback_job_cb_t)refill_run, job,
+									(void*)free, NULL));
+}
+
+METHOD(simaka_provider_t, get_triplet, bool,
+	private_eap_simaka_sql_provider_t *this, identification_t *id,
+	char rand[SIM_RAND_LEN], char sres[SIM_SRES_LEN], char kc[SIM_KC_LEN])
+{
+	char buf[128];
+
+	snprintf(buf, sizeof(buf), "%Y", id);
+
+	if (this->prefetch)
+	{
+		sim_triplet_t *t = NULL;
+		imsi_entry_t *entry;
+		bool refill = FALSE;
+		time_t now = time(NULL);
+
+		this->mutex->lock(this->mutex);
+		entry = get_entry(this, buf);
+		if (entry->triplets->get_count(entry->triplets) &&
+			entry->triplet_time < now - this->prefetch_lifetime)
+		{	/* drop tuples exceeding the freshness bound */
+			entry->triplets->destroy_function(entry->triplets, free);
+			entry->triplets = linked_list_create();
+		}
+		entry->triplets->remove_first(entry->triplets, (void**)&t);
+		if (entry->triplets->get_count(entry->triplets) < this->prefetch &&
+			!entry->triplet_refilling)
+		{
+			entry->triplet_refilling = TRUE;
+			refill = TRUE;
+		}
+		this->mutex->unlock(this->mutex);
+
+		if (refill)
+		{
+			queue_refill(this, buf, FALSE);
+		}
+		if (t)
+		{
+			memcpy(rand, t->rand, SIM_RAND_LEN);
+			memcpy(sres, t->sres, SIM_SRES_LEN);
+			memcpy(kc, t->kc, SIM_KC_LEN);
+			free(t);
+			return TRUE;
+		}
+	}
+	return fetch_triplet(this, buf, rand, sres, kc);
+}
+
+METHOD(simaka_provider_t, get_quintuplet, bool,
+	private_eap_simaka_sql_provider_t *this, identification_t *id,
+	char rand[AKA_RAND_LEN], char xres[AKA_RES_MAX], int *xres_len,
+	char ck[AKA_CK_LEN], char ik[AKA_IK_LEN], char autn[AKA_AUTN_LEN])
+{
+	char buf[128];
+
+	snprintf(buf, sizeof(buf), "%Y", id);
+
+	if (this->prefetch)
+	{
+		aka_quintuplet_t *q = NULL;
+		imsi_entry_t *entry;
+		bool refill = FALSE;
+		time_t now = time(NULL);
+
+		this->mutex->lock(this->mutex);
+		entry = get_entry(this, buf);
+		if (entry->quintuplets->get_count(entry->quintuplets) &&
+			entry->quintuplet_time < now - this->prefetch_lifetime)
+		{	/* drop tuples exceeding the freshness bound */
+			entry->quintuplets->destroy_function(entry->quintuplets, free);
+			entry->quintuplets = linked_list_create();
+		}
+		entry->quintuplets->remove_first(entry->quintuplets, (void**)&q);
+		if (entry->quintuplets->get_count(entry->quintuplets) < this->prefetch &&
+			!entry->quintuplet_refilling)
+		{
+			entry->quintuplet_refilling = TRUE;
+			refill = TRUE;
+		}
+		this->mutex->unlock(this->mutex);
+
+		if (refill)
+		{
+			queue_refill(this, buf, TRUE);
+		}
+		if (q)
+		{
+			memcpy(rand, q->rand, AKA_RAND_LEN);
+			memcpy(xres, q->xres, q->xres_len);
+			*xres_len = q->xres_len;
+			memcpy(ck, q->ck, AKA_CK_LEN);
+			memcpy(ik, q->ik, AKA_IK_LEN);
+			memcpy(autn, q->autn, AKA_AUTN_LEN);
+			free(q);
+			return TRUE;
+		}
+	}
+	return fetch_quintuplet(this, buf, rand, xres, xres_len, ck, ik, autn);
+}
+
 METHOD(eap_simaka_sql_provider_t, destroy, void,
 	private_eap_simaka_sql_provider_t *this)
 {
+	enumerator_t *enumerator;
+	imsi_entry_t *entry;
+
+	enumerator = this->cache->create_enumerator(this->cache);
+	while (enumerator->enumerate(enumerator, NULL, &entry))
+	{
+		free_imsi_entry(entry);
+	}
+	enumerator->destroy(enumerator);
+	this->cache->destroy(this->cache);
+	this->mutex->destroy(this->mutex);
 	free(this);
 }
 
@@ -174,6 +506,14 @@ eap_simaka_sql_provider_t *eap_simaka_sql_provider_create(database_t *db,
 		},
 		.db = db,
 		.remove_used = remove_used,
+		.prefetch = lib->settings->get_int(lib->settings,
+						"%s.plugins.eap-simaka-sql.prefetch", 0, lib->ns),
+		.prefetch_lifetime = lib->settings->get_int(lib->settings,
+						"%s.plugins.eap-simaka-sql.prefetch_lifetime", 600,
+						lib->ns),
+		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+		.cache = hashtable_create((hashtable_hash_t)imsi_hash,
+								  (hashtable_equals_t)imsi_equals, 8),
 	);
 
 	return &this->public;
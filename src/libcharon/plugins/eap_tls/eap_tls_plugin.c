@@ -18,6 +18,7 @@
 #include "eap_tls.h"
 
 #include <daemon.h>
+#include <tls.h>
 
 METHOD(plugin_t, get_name, char*,
 	eap_tls_plugin_t *this)
@@ -48,6 +49,7 @@ METHOD(plugin_t, get_features, int,
 METHOD(plugin_t, destroy, void,
 	eap_tls_plugin_t *this)
 {
+	libtls_deinit();
 	free(this);
 }
 
@@ -66,5 +68,7 @@ plugin_t *eap_tls_plugin_create()
 		},
 	);
 
+	libtls_init();
+
 	return &this->plugin;
 }
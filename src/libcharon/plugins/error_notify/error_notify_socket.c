@@ -48,7 +48,7 @@ struct private_error_notify_socket_t {
 	stream_service_t *service;
 
 	/**
-	 * List of connected clients, as stream_t
+	 * List of connected clients, as client_t
 	 */
 	linked_list_t *connected;
 
@@ -58,6 +58,37 @@ struct private_error_notify_socket_t {
 	mutex_t *mutex;
 };
 
+/**
+ * Maximum number of messages buffered for a slow client before evicting it
+ */
+#define MAX_BACKLOG 128
+
+/**
+ * A connected listener
+ */
+typedef struct {
+	/** socket this client belongs to */
+	private_error_notify_socket_t *this;
+	/** stream to the client */
+	stream_t *stream;
+	/** messages the client was too slow to receive */
+	chunk_t backlog;
+	/** TRUE while an on_write() callback drains the backlog */
+	bool flushing;
+	/** TRUE once writing failed, client gets evicted on the next fan-out */
+	bool failed;
+} client_t;
+
+/**
+ * Destroy a client and its stream
+ */
+static void client_destroy(client_t *this)
+{
+	this->stream->destroy(this->stream);
+	chunk_free(&this->backlog);
+	free(this);
+}
+
 METHOD(error_notify_socket_t, has_listeners, bool,
 	private_error_notify_socket_t *this)
 {
@@ -70,35 +101,108 @@ METHOD(error_notify_socket_t, has_listeners, bool,
 	return count != 0;
 }
 
+/**
+ * Write out buffered messages to a client as far as it accepts them without
+ * blocking. Must be called with this->mutex held. Returns FALSE on error.
+ */
+static bool write_client(client_t *client)
+{
+	ssize_t len;
+
+	while (client->backlog.len)
+	{
+		len = client->stream->write(client->stream, client->backlog.ptr,
+									client->backlog.len, FALSE);
+		if (len <= 0)
+		{
+			if (len == -1 && errno == EWOULDBLOCK)
+			{	/* client too slow, retry from the on_write() callback */
+				return TRUE;
+			}
+			if (len == -1 && errno != ECONNRESET && errno != EPIPE)
+			{
+				DBG1(DBG_CFG, "sending notify failed: %s", strerror(errno));
+			}
+			return FALSE;
+		}
+		memmove(client->backlog.ptr, client->backlog.ptr + len,
+				client->backlog.len - len);
+		client->backlog.len -= len;
+	}
+	chunk_free(&client->backlog);
+	return TRUE;
+}
+
+/**
+ * Watcher callback draining the backlog once the stream accepts data again
+ */
+static bool on_flush(client_t *client, stream_t *stream)
+{
+	private_error_notify_socket_t *this = client->this;
+	bool keep = FALSE;
+
+	this->mutex->lock(this->mutex);
+	if (write_client(client))
+	{
+		keep = client->backlog.len > 0;
+	}
+	else
+	{	/* we may not destroy the stream from its own callback, the next
+		 * fan-out cleans up */
+		client->failed = TRUE;
+	}
+	client->flushing = keep;
+	this->mutex->unlock(this->mutex);
+
+	return keep;
+}
+
 METHOD(error_notify_socket_t, notify, void,
 	private_error_notify_socket_t *this, error_notify_msg_t *msg)
 {
 	enumerator_t *enumerator;
-	stream_t *stream;
+	linked_list_t *evicted;
+	client_t *client;
 
+	evicted = linked_list_create();
 	this->mutex->lock(this->mutex);
 	enumerator = this->connected->create_enumerator(this->connected);
-	while (enumerator->enumerate(enumerator, &stream))
+	while (enumerator->enumerate(enumerator, &client))
 	{
-		if (!stream->write_all(stream, msg, sizeof(*msg)))
+		if (!client->failed)
 		{
-			switch (errno)
+			if (client->backlog.len >= MAX_BACKLOG * sizeof(*msg))
+			{
+				DBG1(DBG_CFG, "client does not read notifies, evicting it");
+				client->failed = TRUE;
+			}
+			else
 			{
-				case ECONNRESET:
-				case EPIPE:
-					/* disconnect, remove this listener */
-					this->connected->remove_at(this->connected, enumerator);
-					stream->destroy(stream);
-					break;
-				default:
-					DBG1(DBG_CFG, "sending notify failed: %s", strerror(errno));
-					break;
+				client->backlog = chunk_cat("mc", client->backlog,
+									chunk_create((char*)msg, sizeof(*msg)));
+				if (!write_client(client))
+				{
+					client->failed = TRUE;
+				}
+				else if (client->backlog.len && !client->flushing)
+				{
+					client->flushing = TRUE;
+					client->stream->on_write(client->stream,
+											 (stream_cb_t)on_flush, client);
+				}
 			}
-			break;
+		}
+		if (client->failed)
+		{
+			this->connected->remove_at(this->connected, enumerator);
+			evicted->insert_last(evicted, client);
 		}
 	}
 	enumerator->destroy(enumerator);
 	this->mutex->unlock(this->mutex);
+
+	/* destroying a stream waits for its active callback, do so unlocked */
+	evicted->destroy_function(evicted, (void*)client_destroy);
 }
 
 /**
@@ -106,8 +210,14 @@ METHOD(error_notify_socket_t, notify, void,
  */
 static bool on_accept(private_error_notify_socket_t *this, stream_t *stream)
 {
+	client_t *client;
+
+	INIT(client,
+		.this = this,
+		.stream = stream,
+	);
 	this->mutex->lock(this->mutex);
-	this->connected->insert_last(this->connected, stream);
+	this->connected->insert_last(this->connected, client);
 	this->mutex->unlock(this->mutex);
 
 	return TRUE;
@@ -117,7 +227,7 @@ METHOD(error_notify_socket_t, destroy, void,
 	private_error_notify_socket_t *this)
 {
 	DESTROY_IF(this->service);
-	this->connected->destroy_offset(this->connected, offsetof(stream_t, destroy));
+	this->connected->destroy_function(this->connected, (void*)client_destroy);
 	this->mutex->destroy(this->mutex);
 	free(this);
 }
@@ -16,6 +16,7 @@
 #include "farp_listener.h"
 
 #include <collections/linked_list.h>
+#include <collections/hashtable.h>
 #include <threading/rwlock.h>
 
 typedef struct private_farp_listener_t private_farp_listener_t;
@@ -35,6 +36,11 @@ struct private_farp_listener_t {
 	 */
 	linked_list_t *entries;
 
+	/**
+	 * Hashtable mapping single remote hosts to vip_index_t
+	 */
+	hashtable_t *vips;
+
 	/**
 	 * RWlock for IP list
 	 */
@@ -47,12 +53,107 @@ struct private_farp_listener_t {
 typedef struct {
 	/** list of local selectors */
 	linked_list_t *local;
-	/** list of remote selectors */
+	/** list of remote selectors not covered by the virtual IP index */
 	linked_list_t *remote;
+	/** single host remote addresses, indexed in vips, as host_t */
+	linked_list_t *hosts;
 	/** reqid of CHILD_SA */
 	u_int32_t reqid;
 } entry_t;
 
+/**
+ * Index of entries sharing a single remote host address
+ */
+typedef struct {
+	/** indexed address, serves as its own hashtable key */
+	host_t *vip;
+	/** entries with a tunnel to this address, as entry_t */
+	linked_list_t *entries;
+} vip_index_t;
+
+/**
+ * Hashtable hash function for single remote hosts
+ */
+static u_int hash(host_t *key)
+{
+	return chunk_hash(key->get_address(key));
+}
+
+/**
+ * Hashtable equals function for single remote hosts
+ */
+static bool equals(host_t *a, host_t *b)
+{
+	return a->ip_equals(a, b);
+}
+
+/**
+ * Add an entry to the virtual IP index, with the write lock held
+ */
+static void index_entry(private_farp_listener_t *this, entry_t *entry)
+{
+	enumerator_t *enumerator;
+	vip_index_t *index;
+	host_t *host;
+
+	enumerator = entry->hosts->create_enumerator(entry->hosts);
+	while (enumerator->enumerate(enumerator, &host))
+	{
+		index = this->vips->get(this->vips, host);
+		if (!index)
+		{
+			INIT(index,
+				.vip = host->clone(host),
+				.entries = linked_list_create(),
+			);
+			this->vips->put(this->vips, index->vip, index);
+		}
+		index->entries->insert_last(index->entries, entry);
+	}
+	enumerator->destroy(enumerator);
+}
+
+/**
+ * Remove an entry from the virtual IP index, with the write lock held
+ */
+static void unindex_entry(private_farp_listener_t *this, entry_t *entry)
+{
+	enumerator_t *enumerator;
+	vip_index_t *index;
+	host_t *host;
+
+	enumerator = entry->hosts->create_enumerator(entry->hosts);
+	while (enumerator->enumerate(enumerator, &host))
+	{
+		index = this->vips->get(this->vips, host);
+		if (index)
+		{
+			index->entries->remove(index->entries, entry, NULL);
+			if (index->entries->get_count(index->entries) == 0)
+			{
+				this->vips->remove(this->vips, host);
+				index->entries->destroy(index->entries);
+				index->vip->destroy(index->vip);
+				free(index);
+			}
+		}
+	}
+	enumerator->destroy(enumerator);
+}
+
+/**
+ * Destroy an entry
+ */
+static void destroy_entry(entry_t *entry)
+{
+	entry->local->destroy_offset(entry->local,
+								 offsetof(traffic_selector_t, destroy));
+	entry->remote->destroy_offset(entry->remote,
+								  offsetof(traffic_selector_t, destroy));
+	entry->hosts->destroy_offset(entry->hosts, offsetof(host_t, destroy));
+	free(entry);
+}
+
 METHOD(listener_t, child_updown, bool,
 	private_farp_listener_t *this, ike_sa_t *ike_sa, child_sa_t *child_sa,
 	bool up)
@@ -66,6 +167,7 @@ METHOD(listener_t, child_updown, bool,
 		INIT(entry,
 			.local = linked_list_create(),
 			.remote = linked_list_create(),
+			.hosts = linked_list_create(),
 			.reqid = child_sa->get_reqid(child_sa),
 		);
 
@@ -79,12 +181,22 @@ METHOD(listener_t, child_updown, bool,
 		enumerator = child_sa->create_ts_enumerator(child_sa, FALSE);
 		while (enumerator->enumerate(enumerator, &ts))
 		{
-			entry->remote->insert_last(entry->remote, ts->clone(ts));
+			if (ts->is_host(ts, NULL))
+			{	/* single host selectors are served from the index */
+				entry->hosts->insert_last(entry->hosts,
+						host_create_from_chunk(AF_UNSPEC,
+											   ts->get_from_address(ts), 0));
+			}
+			else
+			{
+				entry->remote->insert_last(entry->remote, ts->clone(ts));
+			}
 		}
 		enumerator->destroy(enumerator);
 
 		this->lock->write_lock(this->lock);
 		this->entries->insert_last(this->entries, entry);
+		index_entry(this, entry);
 		this->lock->unlock(this->lock);
 	}
 	else
@@ -96,11 +208,8 @@ METHOD(listener_t, child_updown, bool,
 			if (entry->reqid == child_sa->get_reqid(child_sa))
 			{
 				this->entries->remove_at(this->entries, enumerator);
-				entry->local->destroy_offset(entry->local,
-										offsetof(traffic_selector_t, destroy));
-				entry->remote->destroy_offset(entry->remote,
-										offsetof(traffic_selector_t, destroy));
-				free(entry);
+				unindex_entry(this, entry);
+				destroy_entry(entry);
 			}
 		}
 		enumerator->destroy(enumerator);
@@ -115,28 +224,47 @@ METHOD(farp_listener_t, has_tunnel, bool,
 	enumerator_t *entries, *locals, *remotes;
 	traffic_selector_t *ts;
 	bool found = FALSE;
+	vip_index_t *index;
 	entry_t *entry;
 
 	this->lock->read_lock(this->lock);
-	entries = this->entries->create_enumerator(this->entries);
-	while (!found && entries->enumerate(entries, &entry))
-	{
-		remotes = entry->remote->create_enumerator(entry->remote);
-		while (!found && remotes->enumerate(remotes, &ts))
+	index = this->vips->get(this->vips, remote);
+	if (index)
+	{	/* remote is an indexed single host, check local selectors only */
+		entries = index->entries->create_enumerator(index->entries);
+		while (!found && entries->enumerate(entries, &entry))
+		{
+			locals = entry->local->create_enumerator(entry->local);
+			while (!found && locals->enumerate(locals, &ts))
+			{
+				found = ts->includes(ts, local);
+			}
+			locals->destroy(locals);
+		}
+		entries->destroy(entries);
+	}
+	if (!found)
+	{	/* fall back to scanning the remaining ranged selectors */
+		entries = this->entries->create_enumerator(this->entries);
+		while (!found && entries->enumerate(entries, &entry))
 		{
-			if (ts->includes(ts, remote))
+			remotes = entry->remote->create_enumerator(entry->remote);
+			while (!found && remotes->enumerate(remotes, &ts))
 			{
-				locals = entry->local->create_enumerator(entry->local);
-				while (!found && locals->enumerate(locals, &ts))
+				if (ts->includes(ts, remote))
 				{
-					found = ts->includes(ts, local);
+					locals = entry->local->create_enumerator(entry->local);
+					while (!found && locals->enumerate(locals, &ts))
+					{
+						found = ts->includes(ts, local);
+					}
+					locals->destroy(locals);
 				}
-				locals->destroy(locals);
 			}
+			remotes->destroy(remotes);
 		}
-		remotes->destroy(remotes);
+		entries->destroy(entries);
 	}
-	entries->destroy(entries);
 	this->lock->unlock(this->lock);
 
 	return found;
@@ -145,6 +273,23 @@ METHOD(farp_listener_t, has_tunnel, bool,
 METHOD(farp_listener_t, destroy, void,
 	private_farp_listener_t *this)
 {
+	enumerator_t *enumerator;
+	vip_index_t *index;
+	entry_t *entry;
+
+	enumerator = this->vips->create_enumerator(this->vips);
+	while (enumerator->enumerate(enumerator, NULL, &index))
+	{
+		index->entries->destroy(index->entries);
+		index->vip->destroy(index->vip);
+		free(index);
+	}
+	enumerator->destroy(enumerator);
+	this->vips->destroy(this->vips);
+	while (this->entries->remove_last(this->entries, (void**)&entry) == SUCCESS)
+	{
+		destroy_entry(entry);
+	}
 	this->entries->destroy(this->entries);
 	this->lock->destroy(this->lock);
 	free(this);
@@ -166,6 +311,8 @@ farp_listener_t *farp_listener_create()
 			.destroy = _destroy,
 		},
 		.entries = linked_list_create(),
+		.vips = hashtable_create((hashtable_hash_t)hash,
+								 (hashtable_equals_t)equals, 32),
 		.lock = rwlock_create(RWLOCK_TYPE_DEFAULT),
 	);
 
@@ -209,16 +209,7 @@ static bool receive_casts(private_forecast_forwarder_t *this)
 	DBG2(DBG_NET, "forecast intercepted packet: %H to %H", src, dst);
 
 	/* find mark of originating tunnel */
-	enumerator = this->kernel.fc->create_enumerator(this->kernel.fc, FALSE);
-	while (enumerator->enumerate(enumerator, &ts, &mark, &reinject))
-	{
-		if (ts->includes(ts, src))
-		{
-			origin = mark;
-			break;
-		}
-	}
-	enumerator->destroy(enumerator);
+	origin = this->kernel.fc->get_mark(this->kernel.fc, src);
 
 	/* send packet over all tunnels, but not the packets origin */
 	enumerator = this->kernel.fc->create_enumerator(this->kernel.fc, FALSE);
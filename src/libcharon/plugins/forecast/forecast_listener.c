@@ -42,6 +42,11 @@ struct private_forecast_listener_t {
 	 */
 	linked_list_t *entries;
 
+	/**
+	 * Hashtable mapping single remote hosts to vip_index_t
+	 */
+	hashtable_t *vips;
+
 	/**
 	 * RWlock for IP list
 	 */
@@ -80,8 +85,38 @@ typedef struct {
 	bool reinject;
 	/** broadcast address used for that entry */
 	u_int32_t broadcast;
+	/** single host remote addresses, indexed in vips, as host_t */
+	linked_list_t *rhosts;
+	/** TRUE if all remote selectors are single hosts covered by the index */
+	bool host_only;
 } entry_t;
 
+/**
+ * Index of entries sharing a single remote host address
+ */
+typedef struct {
+	/** indexed address, serves as its own hashtable key */
+	host_t *vip;
+	/** entries with a tunnel to this address, as entry_t */
+	linked_list_t *entries;
+} vip_index_t;
+
+/**
+ * Hashtable hash function for single remote hosts
+ */
+static u_int vip_hash(host_t *key)
+{
+	return chunk_hash(key->get_address(key));
+}
+
+/**
+ * Hashtable equals function for single remote hosts
+ */
+static bool vip_equals(host_t *a, host_t *b)
+{
+	return a->ip_equals(a, b);
+}
+
 /**
  * Destroy an entry
  */
@@ -93,10 +128,65 @@ static void entry_destroy(entry_t *entry)
 		entry->rhost->destroy(entry->rhost);
 		array_destroy_offset(entry->lts, offsetof(traffic_selector_t, destroy));
 		array_destroy_offset(entry->rts, offsetof(traffic_selector_t, destroy));
+		entry->rhosts->destroy_offset(entry->rhosts, offsetof(host_t, destroy));
 		free(entry);
 	}
 }
 
+/**
+ * Add an entry to the virtual IP index, with the write lock held
+ */
+static void index_entry(private_forecast_listener_t *this, entry_t *entry)
+{
+	enumerator_t *enumerator;
+	vip_index_t *index;
+	host_t *host;
+
+	enumerator = entry->rhosts->create_enumerator(entry->rhosts);
+	while (enumerator->enumerate(enumerator, &host))
+	{
+		index = this->vips->get(this->vips, host);
+		if (!index)
+		{
+			INIT(index,
+				.vip = host->clone(host),
+				.entries = linked_list_create(),
+			);
+			this->vips->put(this->vips, index->vip, index);
+		}
+		index->entries->insert_last(index->entries, entry);
+	}
+	enumerator->destroy(enumerator);
+}
+
+/**
+ * Remove an entry from the virtual IP index, with the write lock held
+ */
+static void unindex_entry(private_forecast_listener_t *this, entry_t *entry)
+{
+	enumerator_t *enumerator;
+	vip_index_t *index;
+	host_t *host;
+
+	enumerator = entry->rhosts->create_enumerator(entry->rhosts);
+	while (enumerator->enumerate(enumerator, &host))
+	{
+		index = this->vips->get(this->vips, host);
+		if (index)
+		{
+			index->entries->remove(index->entries, entry, NULL);
+			if (index->entries->get_count(index->entries) == 0)
+			{
+				this->vips->remove(this->vips, host);
+				index->entries->destroy(index->entries);
+				index->vip->destroy(index->vip);
+				free(index);
+			}
+		}
+	}
+	enumerator->destroy(enumerator);
+}
+
 /**
  * Convert an (IPv4) traffic selector to an address and mask
  */
@@ -379,11 +469,13 @@ static bool add_entry(private_forecast_listener_t *this,
 		.rts = array_create(0, 0),
 		.lhost = lhost->clone(lhost),
 		.rhost = rhost->clone(rhost),
+		.rhosts = linked_list_create(),
 		.spi = child_sa->get_spi(child_sa, TRUE),
 		.encap = encap,
 		.mark = child_sa->get_mark(child_sa, TRUE).value,
 		.reinject = is_reinject_config(this, child_sa->get_name(child_sa)),
 		.broadcast = this->broadcast,
+		.host_only = TRUE,
 	);
 
 	enumerator = child_sa->create_ts_enumerator(child_sa, TRUE);
@@ -397,6 +489,16 @@ static bool add_entry(private_forecast_listener_t *this,
 	while (enumerator->enumerate(enumerator, &ts))
 	{
 		array_insert(entry->rts, ARRAY_TAIL, ts->clone(ts));
+		if (ts->is_host(ts, NULL))
+		{
+			entry->rhosts->insert_last(entry->rhosts,
+					host_create_from_chunk(AF_UNSPEC,
+										   ts->get_from_address(ts), 0));
+		}
+		else
+		{
+			entry->host_only = FALSE;
+		}
 	}
 	enumerator->destroy(enumerator);
 
@@ -405,6 +507,7 @@ static bool add_entry(private_forecast_listener_t *this,
 	{
 		this->lock->write_lock(this->lock);
 		this->entries->insert_last(this->entries, entry);
+		index_entry(this, entry);
 		this->lock->unlock(this->lock);
 		return TRUE;
 	}
@@ -429,6 +532,7 @@ static bool remove_entry(private_forecast_listener_t *this,
 		if (entry->mark == child_sa->get_mark(child_sa, TRUE).value)
 		{
 			this->entries->remove_at(this->entries, enumerator);
+			unindex_entry(this, entry);
 			if (manage_pre(ipth, entry, FALSE) &&
 				manage_out(ipth, entry, FALSE))
 			{
@@ -632,6 +736,48 @@ METHOD(forecast_listener_t, create_enumerator, enumerator_t*,
 					this->lock, (void*)this->lock->unlock);
 }
 
+METHOD(forecast_listener_t, get_mark, u_int,
+	private_forecast_listener_t *this, host_t *ip)
+{
+	enumerator_t *entries, *tss;
+	traffic_selector_t *ts;
+	vip_index_t *index;
+	entry_t *entry;
+	u_int mark = 0;
+
+	this->lock->read_lock(this->lock);
+	index = this->vips->get(this->vips, ip);
+	if (index &&
+		index->entries->get_first(index->entries, (void**)&entry) == SUCCESS)
+	{
+		mark = entry->mark;
+	}
+	if (!mark)
+	{	/* fall back to scanning entries with ranged selectors */
+		entries = this->entries->create_enumerator(this->entries);
+		while (!mark && entries->enumerate(entries, &entry))
+		{
+			if (entry->host_only)
+			{
+				continue;
+			}
+			tss = array_create_enumerator(entry->rts);
+			while (!mark && tss->enumerate(tss, &ts))
+			{
+				if (ts->includes(ts, ip))
+				{
+					mark = entry->mark;
+				}
+			}
+			tss->destroy(tss);
+		}
+		entries->destroy(entries);
+	}
+	this->lock->unlock(this->lock);
+
+	return mark;
+}
+
 METHOD(forecast_listener_t, set_broadcast, void,
 	private_forecast_listener_t *this, host_t *bcast)
 {
@@ -647,7 +793,19 @@ METHOD(forecast_listener_t, set_broadcast, void,
 METHOD(forecast_listener_t, destroy, void,
 	private_forecast_listener_t *this)
 {
-	this->entries->destroy(this->entries);
+	enumerator_t *enumerator;
+	vip_index_t *index;
+
+	enumerator = this->vips->create_enumerator(this->vips);
+	while (enumerator->enumerate(enumerator, NULL, &index))
+	{
+		index->entries->destroy(index->entries);
+		index->vip->destroy(index->vip);
+		free(index);
+	}
+	enumerator->destroy(enumerator);
+	this->vips->destroy(this->vips);
+	this->entries->destroy_function(this->entries, (void*)entry_destroy);
 	this->lock->destroy(this->lock);
 	free(this);
 }
@@ -667,10 +825,13 @@ forecast_listener_t *forecast_listener_create()
 				.child_rekey = _child_rekey,
 			},
 			.create_enumerator = _create_enumerator,
+			.get_mark = _get_mark,
 			.set_broadcast = _set_broadcast,
 			.destroy = _destroy,
 		},
 		.entries = linked_list_create(),
+		.vips = hashtable_create((hashtable_hash_t)vip_hash,
+								 (hashtable_equals_t)vip_equals, 32),
 		.lock = rwlock_create(RWLOCK_TYPE_DEFAULT),
 		.reinject_configs = lib->settings->get_str(lib->settings,
 								"%s.plugins.forecast.reinject", "", lib->ns),
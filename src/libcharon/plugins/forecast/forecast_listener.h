@@ -47,6 +47,17 @@ struct forecast_listener_t {
 	 */
 	enumerator_t* (*create_enumerator)(forecast_listener_t *this, bool local);
 
+	/**
+	 * Get the mark of the tunnel whose remote selectors cover an address.
+	 *
+	 * Single host selectors, such as assigned virtual IPs, are resolved with
+	 * a hash lookup; ranged selectors fall back to a scan.
+	 *
+	 * @param ip		address to look up
+	 * @return			mark of the matching tunnel, 0 if none found
+	 */
+	u_int (*get_mark)(forecast_listener_t *this, host_t *ip);
+
 	/**
 	 * Set the broadcast address of the LAN interface.
 	 *
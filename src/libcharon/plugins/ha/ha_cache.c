@@ -56,6 +56,21 @@ struct private_ha_cache_t {
 	 * Mutex to lock cache
 	 */
 	mutex_t *mutex;
+
+	/**
+	 * Snapshot the cache is periodically saved to, NULL if disabled
+	 */
+	ha_snapshot_t *snapshot;
+
+	/**
+	 * Interval to save snapshots at, in seconds
+	 */
+	u_int snapshot_interval;
+
+	/**
+	 * Rate to pace bulk resync transfers at, in messages per second
+	 */
+	u_int resync_rate;
 };
 
 /**
@@ -290,47 +305,181 @@ static void rekey_segment(private_ha_cache_t *this, u_int segment)
 	list->destroy(list);
 }
 
+/**
+ * Data of a paced bulk resync transfer job
+ */
+typedef struct {
+	/** cache to stream from */
+	private_ha_cache_t *this;
+	/** copies of cached messages pending transmission */
+	linked_list_t *messages;
+	/** segment getting resynced */
+	u_int segment;
+} resync_data_t;
+
+/**
+ * Clean up bulk resync data
+ */
+static void resync_data_destroy(resync_data_t *data)
+{
+	data->messages->destroy_offset(data->messages,
+								   offsetof(ha_message_t, destroy));
+	free(data);
+}
+
+/**
+ * Stream the next batch of resync messages, paced as simple flow control
+ */
+static job_requeue_t stream_resync(resync_data_t *data)
+{
+	private_ha_cache_t *this = data->this;
+	ha_message_t *message;
+	u_int batch;
+
+	/* transfer in 10ms ticks at the configured per-second rate, so a cold
+	 * standby does not overrun the sockets receive buffer */
+	batch = max(this->resync_rate / 100, 1);
+	while (!this->resync_rate || batch--)
+	{
+		if (data->messages->remove_first(data->messages,
+										 (void**)&message) != SUCCESS)
+		{
+			/* transfer complete, reestablish CHILD_SA keys via rekeying */
+			rekey_segment(this, data->segment);
+			return JOB_REQUEUE_NONE;
+		}
+		this->socket->push(this->socket, message);
+		message->destroy(message);
+	}
+	return JOB_RESCHEDULE_MS(10);
+}
+
+/**
+ * Create a copy of a cached message for transmission
+ */
+static ha_message_t *copy_message(ha_message_t *message)
+{
+	return ha_message_parse(message->get_encoding(message));
+}
+
 METHOD(ha_cache_t, resync, void,
 	private_ha_cache_t *this, u_int segment)
 {
 	enumerator_t *enumerator, *updates;
+	linked_list_t *messages;
+	resync_data_t *data;
 	ike_sa_t *ike_sa;
 	entry_t *entry;
 	ha_message_t *message;
 
 	DBG1(DBG_CFG, "resyncing HA segment %d", segment);
 
+	/* copy out the segments state and stream it from a paced job, instead
+	 * of bursting all datagrams out while holding the cache mutex */
+	messages = linked_list_create();
 	this->mutex->lock(this->mutex);
 	enumerator = this->cache->create_enumerator(this->cache);
 	while (enumerator->enumerate(enumerator, &ike_sa, &entry))
 	{
 		if (entry->segment == segment)
 		{
-			this->socket->push(this->socket, entry->add);
+			messages->insert_last(messages, copy_message(entry->add));
 			updates = entry->updates->create_enumerator(entry->updates);
 			while (updates->enumerate(updates, &message))
 			{
-				this->socket->push(this->socket, message);
+				messages->insert_last(messages, copy_message(message));
 			}
 			updates->destroy(updates);
 			if (entry->midi)
 			{
-				this->socket->push(this->socket, entry->midi);
+				messages->insert_last(messages, copy_message(entry->midi));
 			}
 			if (entry->midr)
 			{
-				this->socket->push(this->socket, entry->midr);
+				messages->insert_last(messages, copy_message(entry->midr));
 			}
 			if (entry->iv)
 			{
-				this->socket->push(this->socket, entry->iv);
+				messages->insert_last(messages, copy_message(entry->iv));
 			}
 		}
 	}
 	enumerator->destroy(enumerator);
 	this->mutex->unlock(this->mutex);
 
-	rekey_segment(this, segment);
+	INIT(data,
+		.this = this,
+		.messages = messages,
+		.segment = segment,
+	);
+	lib->processor->queue_job(lib->processor, (job_t*)
+		callback_job_create_with_prio((callback_job_cb_t)stream_resync, data,
+							(callback_job_cleanup_t)resync_data_destroy, NULL,
+							JOB_PRIO_HIGH));
+}
+
+METHOD(ha_cache_t, save, void,
+	private_ha_cache_t *this)
+{
+	enumerator_t *enumerator, *updates;
+	ike_sa_t *ike_sa;
+	entry_t *entry;
+	ha_message_t *message;
+	bool ok;
+
+	if (!this->snapshot)
+	{
+		return;
+	}
+	this->mutex->lock(this->mutex);
+	ok = this->snapshot->begin(this->snapshot);
+	enumerator = this->cache->create_enumerator(this->cache);
+	while (ok && enumerator->enumerate(enumerator, &ike_sa, &entry))
+	{
+		ok = this->snapshot->write(this->snapshot, entry->add);
+		updates = entry->updates->create_enumerator(entry->updates);
+		while (ok && updates->enumerate(updates, &message))
+		{
+			ok = this->snapshot->write(this->snapshot, message);
+		}
+		updates->destroy(updates);
+		if (ok && entry->midi)
+		{
+			ok = this->snapshot->write(this->snapshot, entry->midi);
+		}
+		if (ok && entry->midr)
+		{
+			ok = this->snapshot->write(this->snapshot, entry->midr);
+		}
+		if (ok && entry->iv)
+		{
+			ok = this->snapshot->write(this->snapshot, entry->iv);
+		}
+	}
+	enumerator->destroy(enumerator);
+	if (ok)
+	{
+		ok = this->snapshot->commit(this->snapshot);
+	}
+	this->mutex->unlock(this->mutex);
+
+	if (ok)
+	{
+		DBG2(DBG_CFG, "saved HA snapshot");
+	}
+	else
+	{
+		DBG1(DBG_CFG, "saving HA snapshot failed");
+	}
+}
+
+/**
+ * Periodically save the cache to the snapshot
+ */
+static job_requeue_t save_job(private_ha_cache_t *this)
+{
+	save(this);
+	return JOB_RESCHEDULE(this->snapshot_interval);
 }
 
 /**
@@ -356,6 +505,7 @@ static job_requeue_t request_resync(private_ha_cache_t *this)
 METHOD(ha_cache_t, destroy, void,
 	private_ha_cache_t *this)
 {
+	save(this);
 	this->cache->destroy(this->cache);
 	this->mutex->destroy(this->mutex);
 	free(this);
@@ -365,7 +515,7 @@ METHOD(ha_cache_t, destroy, void,
  * See header
  */
 ha_cache_t *ha_cache_create(ha_kernel_t *kernel, ha_socket_t *socket,
-							bool sync, u_int count)
+							ha_snapshot_t *snapshot, bool sync, u_int count)
 {
 	private_ha_cache_t *this;
 
@@ -374,11 +524,17 @@ ha_cache_t *ha_cache_create(ha_kernel_t *kernel, ha_socket_t *socket,
 			.cache = _cache,
 			.delete = _delete_,
 			.resync = _resync,
+			.save = _save,
 			.destroy = _destroy,
 		},
 		.count = count,
 		.kernel = kernel,
 		.socket = socket,
+		.snapshot = snapshot,
+		.snapshot_interval = lib->settings->get_int(lib->settings,
+						"%s.plugins.ha.snapshot_interval", 60, lib->ns),
+		.resync_rate = lib->settings->get_int(lib->settings,
+						"%s.plugins.ha.resync_rate", 5000, lib->ns),
 		.cache = hashtable_create(hashtable_hash_ptr, hashtable_equals_ptr, 8),
 		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
 	);
@@ -390,5 +546,11 @@ ha_cache_t *ha_cache_create(ha_kernel_t *kernel, ha_socket_t *socket,
 			callback_job_create_with_prio((callback_job_cb_t)request_resync,
 									this, NULL, NULL, JOB_PRIO_CRITICAL), 1);
 	}
+	if (this->snapshot && this->snapshot_interval)
+	{
+		lib->scheduler->schedule_job(lib->scheduler, (job_t*)
+			callback_job_create((callback_job_cb_t)save_job, this, NULL, NULL),
+			this->snapshot_interval);
+	}
 	return &this->public;
 }
@@ -25,6 +25,7 @@ typedef struct ha_cache_t ha_cache_t;
 
 #include "ha_message.h"
 #include "ha_kernel.h"
+#include "ha_snapshot.h"
 #include "ha_socket.h"
 
 #include <collections/enumerator.h>
@@ -58,6 +59,11 @@ struct ha_cache_t {
 	 */
 	void (*resync)(ha_cache_t *this, u_int segment);
 
+	/**
+	 * Save the cached messages to the configured snapshot, if any.
+	 */
+	void (*save)(ha_cache_t *this);
+
 	/**
 	 * Destroy a ha_cache_t.
 	 */
@@ -69,10 +75,11 @@ struct ha_cache_t {
  *
  * @param kernel		kernel helper
  * @param socket		socket to send resync messages
+ * @param snapshot		snapshot to periodically save the cache to, or NULL
  * @param resync 		request a resync during startup?
  * @param count			total number of segments
  */
 ha_cache_t *ha_cache_create(ha_kernel_t *kernel, ha_socket_t *socket,
-							bool resync, u_int count);
+							ha_snapshot_t *snapshot, bool resync, u_int count);
 
 #endif /** HA_CACHE_H_ @}*/
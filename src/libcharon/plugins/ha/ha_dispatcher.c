@@ -58,6 +58,11 @@ struct private_ha_dispatcher_t {
 	 * HA enabled pool
 	 */
 	ha_attribute_t *attr;
+
+	/**
+	 * Snapshot to restore on startup, NULL if disabled
+	 */
+	ha_snapshot_t *snapshot;
 };
 
 /**
@@ -986,21 +991,13 @@ static void process_resync(private_ha_dispatcher_t *this,
 }
 
 /**
- * Dispatcher job function
+ * Process a single message, either pulled from the socket or restored from
+ * a snapshot, takes ownership of the message
  */
-static job_requeue_t dispatch(private_ha_dispatcher_t *this)
+static void dispatch_message(private_ha_dispatcher_t *this,
+							 ha_message_t *message)
 {
-	ha_message_t *message;
-	ha_message_type_t type;
-
-	message = this->socket->pull(this->socket);
-	type = message->get_type(message);
-	if (type != HA_STATUS)
-	{
-		DBG2(DBG_CFG, "received HA %N message", ha_message_type_names,
-			 message->get_type(message));
-	}
-	switch (type)
+	switch (message->get_type(message))
 	{
 		case HA_IKE_ADD:
 			process_ike_add(this, message);
@@ -1039,13 +1036,56 @@ static job_requeue_t dispatch(private_ha_dispatcher_t *this)
 			process_resync(this, message);
 			break;
 		default:
-			DBG1(DBG_CFG, "received unknown HA message type %d", type);
+			DBG1(DBG_CFG, "received unknown HA message type %d",
+				 message->get_type(message));
 			message->destroy(message);
 			break;
 	}
+}
+
+/**
+ * Dispatcher job function
+ */
+static job_requeue_t dispatch(private_ha_dispatcher_t *this)
+{
+	ha_message_t *message;
+
+	message = this->socket->pull(this->socket);
+	if (message->get_type(message) != HA_STATUS)
+	{
+		DBG2(DBG_CFG, "received HA %N message", ha_message_type_names,
+			 message->get_type(message));
+	}
+	dispatch_message(this, message);
 	return JOB_REQUEUE_DIRECT;
 }
 
+/**
+ * Restore IKE and CHILD_SAs from a snapshot saved before a restart, runs
+ * before the pull job is queued
+ */
+static job_requeue_t restore(private_ha_dispatcher_t *this)
+{
+	enumerator_t *enumerator;
+	ha_message_t *message;
+	u_int count = 0;
+
+	enumerator = this->snapshot->create_enumerator(this->snapshot);
+	while (enumerator->enumerate(enumerator, &message))
+	{
+		dispatch_message(this, message);
+		count++;
+	}
+	enumerator->destroy(enumerator);
+	/* don't replay stale state on the next startup */
+	this->snapshot->remove(this->snapshot);
+	if (count)
+	{
+		DBG1(DBG_CFG, "restored %u HA messages from snapshot", count);
+	}
+	return JOB_REQUEUE_NONE;
+}
+
 METHOD(ha_dispatcher_t, destroy, void,
 	private_ha_dispatcher_t *this)
 {
@@ -1057,7 +1097,8 @@ METHOD(ha_dispatcher_t, destroy, void,
  */
 ha_dispatcher_t *ha_dispatcher_create(ha_socket_t *socket,
 									ha_segments_t *segments, ha_cache_t *cache,
-									ha_kernel_t *kernel, ha_attribute_t *attr)
+									ha_kernel_t *kernel, ha_attribute_t *attr,
+									ha_snapshot_t *snapshot)
 {
 	private_ha_dispatcher_t *this;
 
@@ -1071,7 +1112,14 @@ ha_dispatcher_t *ha_dispatcher_create(ha_socket_t *socket,
 		.cache = cache,
 		.kernel = kernel,
 		.attr = attr,
+		.snapshot = snapshot,
 	);
+	if (this->snapshot)
+	{
+		lib->processor->queue_job(lib->processor,
+			(job_t*)callback_job_create_with_prio((callback_job_cb_t)restore,
+					this, NULL, NULL, JOB_PRIO_CRITICAL));
+	}
 	lib->processor->queue_job(lib->processor,
 		(job_t*)callback_job_create_with_prio((callback_job_cb_t)dispatch, this,
 				NULL, (callback_job_cancel_t)return_false, JOB_PRIO_CRITICAL));
@@ -26,6 +26,7 @@
 #include "ha_cache.h"
 #include "ha_kernel.h"
 #include "ha_attribute.h"
+#include "ha_snapshot.h"
 
 typedef struct ha_dispatcher_t ha_dispatcher_t;
 
@@ -48,10 +49,12 @@ struct ha_dispatcher_t {
  * @param cache			message cache to use for resynchronization
  * @param kernel		kernel helper
  * @param attr			HA enabled pool
+ * @param snapshot		snapshot to restore on startup, or NULL
  * @return				dispatcher object
  */
 ha_dispatcher_t *ha_dispatcher_create(ha_socket_t *socket,
 									ha_segments_t *segments, ha_cache_t *cache,
-									ha_kernel_t *kernel, ha_attribute_t *attr);
+									ha_kernel_t *kernel, ha_attribute_t *attr,
+									ha_snapshot_t *snapshot);
 
 #endif /** HA_DISPATCHER_ @}*/
@@ -65,6 +65,8 @@ enum ha_message_type_t {
 	HA_RESYNC,
 	/** IV synchronization for IKEv1 Main/Aggressive mode */
 	HA_IKE_IV,
+	/** multiple delta-encoded messages batched into one datagram */
+	HA_BATCH,
 };
 
 /**
@@ -22,6 +22,7 @@
 #include "ha_segments.h"
 #include "ha_ctl.h"
 #include "ha_cache.h"
+#include "ha_snapshot.h"
 #include "ha_attribute.h"
 
 #include <daemon.h>
@@ -88,6 +89,11 @@ struct private_ha_plugin_t {
 	 * Attribute provider
 	 */
 	ha_attribute_t *attr;
+
+	/**
+	 * On-disk snapshot of the message cache, NULL if disabled
+	 */
+	ha_snapshot_t *snapshot;
 };
 
 METHOD(plugin_t, get_name, char*,
@@ -144,6 +150,7 @@ METHOD(plugin_t, destroy, void,
 	this->segments->destroy(this->segments);
 	this->kernel->destroy(this->kernel);
 	this->socket->destroy(this->socket);
+	DESTROY_IF(this->snapshot);
 	DESTROY_IF(this->tunnel);
 	free(this);
 }
@@ -154,7 +161,7 @@ METHOD(plugin_t, destroy, void,
 plugin_t *ha_plugin_create()
 {
 	private_ha_plugin_t *this;
-	char *local, *remote, *secret;
+	char *local, *remote, *secret, *snapshot;
 	u_int count;
 	bool fifo, monitor, resync;
 
@@ -170,6 +177,8 @@ plugin_t *ha_plugin_create()
 								"%s.plugins.ha.monitor", TRUE, lib->ns);
 	resync = lib->settings->get_bool(lib->settings,
 								"%s.plugins.ha.resync", TRUE, lib->ns);
+	snapshot = lib->settings->get_str(lib->settings,
+								"%s.plugins.ha.snapshot", NULL, lib->ns);
 	count = min(SEGMENTS_MAX, lib->settings->get_int(lib->settings,
 								"%s.plugins.ha.segment_count", 1, lib->ns));
 	if (!local || !remote)
@@ -209,14 +218,20 @@ plugin_t *ha_plugin_create()
 	this->kernel = ha_kernel_create(count);
 	this->segments = ha_segments_create(this->socket, this->kernel, this->tunnel,
 							count, strcmp(local, remote) > 0, monitor);
-	this->cache = ha_cache_create(this->kernel, this->socket, resync, count);
+	if (snapshot)
+	{
+		this->snapshot = ha_snapshot_create(snapshot);
+	}
+	this->cache = ha_cache_create(this->kernel, this->socket, this->snapshot,
+								  resync, count);
 	if (fifo)
 	{
 		this->ctl = ha_ctl_create(this->segments, this->cache);
 	}
 	this->attr = ha_attribute_create(this->kernel, this->segments);
 	this->dispatcher = ha_dispatcher_create(this->socket, this->segments,
-										this->cache, this->kernel, this->attr);
+										this->cache, this->kernel, this->attr,
+										this->snapshot);
 	this->ike = ha_ike_create(this->socket, this->tunnel, this->cache);
 	this->child = ha_child_create(this->socket, this->tunnel, this->segments,
 								  this->kernel);
@@ -95,8 +95,43 @@ struct private_ha_segments_t {
 	 * Interval to check for autobalance, 0 to disable
 	 */
 	int autobalance;
+
+	/**
+	 * Number of nodes for consistent segment mapping, 0 for legacy mapping
+	 */
+	u_int node_count;
 };
 
+/**
+ * Get the node a segment is preferably handled by
+ *
+ * With node_count set, rendezvous hashing is used: all nodes rank each
+ * (node, segment) pair with the same keyless hash and agree on the highest
+ * ranking node. Changing node_count then only moves the segments the
+ * added/removed node wins/loses, all other segments stay where they are.
+ */
+static u_int preferred_node(private_ha_segments_t *this, u_int segment)
+{
+	u_int32_t score, high = 0;
+	u_int node, best = 0;
+
+	if (!this->node_count)
+	{	/* legacy fixed mapping, segments alternate between two nodes */
+		return segment % 2;
+	}
+	for (node = 0; node < this->node_count; node++)
+	{
+		score = chunk_hash_static_inc(chunk_from_thing(segment),
+								chunk_hash_static(chunk_from_thing(node)));
+		if (node == 0 || score > high)
+		{
+			high = score;
+			best = node;
+		}
+	}
+	return best;
+}
+
 /**
  * Log currently active segments
  */
@@ -306,7 +341,7 @@ METHOD(ha_segments_t, handle_status, void,
 	{
 		if (missing & SEGMENTS_BIT(i))
 		{
-			if (this->node == i % 2)
+			if (this->node == preferred_node(this, i))
 			{
 				DBG1(DBG_CFG, "HA segment %d was not handled, taking", i);
 				enable_disable(this, i, TRUE, TRUE);
@@ -319,7 +354,7 @@ METHOD(ha_segments_t, handle_status, void,
 		}
 		if (twice & SEGMENTS_BIT(i))
 		{
-			if (this->node == i % 2)
+			if (this->node == preferred_node(this, i))
 			{
 				DBG1(DBG_CFG, "HA segment %d was handled twice, taking", i);
 				enable_disable(this, i, TRUE, TRUE);
@@ -397,17 +432,35 @@ static job_requeue_t autobalance(private_ha_segments_t *this)
 	}
 	if (active < this->count / 2)
 	{
+		/* prefer taking over segments mapped to us before any others, so
+		 * segments migrate towards their preferred node over time */
 		for (i = 1; i <= this->count; i++)
 		{
-			if (!(this->active & SEGMENTS_BIT(i)))
+			if (!(this->active & SEGMENTS_BIT(i)) &&
+				this->node == preferred_node(this, i))
 			{
-				DBG1(DBG_CFG, "autobalancing HA (%d/%d active), taking %d",
-					 active, this->count, i);
-				enable_disable(this, i, TRUE, TRUE);
-				/* we claim only one in each interval */
 				break;
 			}
 		}
+		if (i > this->count)
+		{
+			for (i = 1; i <= this->count; i++)
+			{
+				if (!(this->active & SEGMENTS_BIT(i)))
+				{
+					break;
+				}
+			}
+		}
+		if (i <= this->count)
+		{
+			DBG1(DBG_CFG, "autobalancing HA (%d/%d active), taking %d",
+				 active, this->count, i);
+			/* taking over notifies the current owner, which deactivates the
+			 * segment without tearing down its established tunnels */
+			enable_disable(this, i, TRUE, TRUE);
+			/* we claim only one in each interval */
+		}
 	}
 
 	this->mutex->unlock(this->mutex);
@@ -476,6 +529,8 @@ ha_segments_t *ha_segments_create(ha_socket_t *socket, ha_kernel_t *kernel,
 				lib->ns),
 		.autobalance = lib->settings->get_int(lib->settings,
 				"%s.plugins.ha.autobalance", 0, lib->ns),
+		.node_count = lib->settings->get_int(lib->settings,
+				"%s.plugins.ha.node_count", 0, lib->ns),
 	);
 
 	if (monitor)
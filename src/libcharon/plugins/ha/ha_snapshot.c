@@ -0,0 +1,258 @@
+/*
+ * Copyright (C) 2015 Tobias Brunner
+ * Hochschule fuer Technik Rapperswil
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include "ha_snapshot.h"
+
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include <daemon.h>
+
+/**
+ * Magic at the start of a snapshot file
+ */
+#define HA_SNAPSHOT_MAGIC 0x48415331
+
+typedef struct private_ha_snapshot_t private_ha_snapshot_t;
+
+/**
+ * Private data of an ha_snapshot_t object.
+ */
+struct private_ha_snapshot_t {
+
+	/**
+	 * Public ha_snapshot_t interface.
+	 */
+	ha_snapshot_t public;
+
+	/**
+	 * Path to the snapshot file
+	 */
+	char *path;
+
+	/**
+	 * Path to the temporary file while writing
+	 */
+	char *tmp;
+
+	/**
+	 * Currently written temporary file, NULL if none
+	 */
+	FILE *file;
+};
+
+METHOD(ha_snapshot_t, begin, bool,
+	private_ha_snapshot_t *this)
+{
+	char magic[4];
+
+	if (this->file)
+	{
+		fclose(this->file);
+	}
+	this->file = fopen(this->tmp, "w");
+	if (!this->file)
+	{
+		DBG1(DBG_CFG, "opening HA snapshot '%s' failed: %s",
+			 this->tmp, strerror(errno));
+		return FALSE;
+	}
+	htoun32(magic, HA_SNAPSHOT_MAGIC);
+	if (fwrite(magic, sizeof(magic), 1, this->file) != 1)
+	{
+		fclose(this->file);
+		this->file = NULL;
+		return FALSE;
+	}
+	return TRUE;
+}
+
+METHOD(ha_snapshot_t, write_, bool,
+	private_ha_snapshot_t *this, ha_message_t *message)
+{
+	char len[4];
+	chunk_t data;
+
+	if (!this->file)
+	{
+		return FALSE;
+	}
+	data = message->get_encoding(message);
+	htoun32(len, data.len);
+	if (fwrite(len, sizeof(len), 1, this->file) != 1 ||
+		fwrite(data.ptr, data.len, 1, this->file) != 1)
+	{
+		DBG1(DBG_CFG, "writing HA snapshot failed: %s", strerror(errno));
+		fclose(this->file);
+		this->file = NULL;
+		return FALSE;
+	}
+	return TRUE;
+}
+
+METHOD(ha_snapshot_t, commit, bool,
+	private_ha_snapshot_t *this)
+{
+	if (!this->file)
+	{
+		return FALSE;
+	}
+	if (fflush(this->file) != 0 ||
+		fsync(fileno(this->file)) != 0)
+	{
+		DBG1(DBG_CFG, "flushing HA snapshot failed: %s", strerror(errno));
+		fclose(this->file);
+		this->file = NULL;
+		return FALSE;
+	}
+	fclose(this->file);
+	this->file = NULL;
+	if (rename(this->tmp, this->path) != 0)
+	{
+		DBG1(DBG_CFG, "committing HA snapshot '%s' failed: %s",
+			 this->path, strerror(errno));
+		return FALSE;
+	}
+	return TRUE;
+}
+
+typedef struct {
+	/** implements enumerator_t */
+	enumerator_t public;
+	/** mmap()ed snapshot, NULL if none */
+	chunk_t *map;
+	/** remaining data to parse */
+	chunk_t rest;
+} snapshot_enumerator_t;
+
+METHOD(enumerator_t, enumerate, bool,
+	snapshot_enumerator_t *this, ha_message_t **message)
+{
+	ha_message_t *parsed;
+	u_int32_t len;
+
+	while (this->rest.len >= 4)
+	{
+		len = untoh32(this->rest.ptr);
+		this->rest = chunk_skip(this->rest, 4);
+		if (len > this->rest.len)
+		{
+			DBG1(DBG_CFG, "HA snapshot truncated, ignoring %d remaining bytes",
+				 this->rest.len);
+			return FALSE;
+		}
+		parsed = ha_message_parse(chunk_create(this->rest.ptr, len));
+		this->rest = chunk_skip(this->rest, len);
+		if (parsed)
+		{
+			*message = parsed;
+			return TRUE;
+		}
+		/* skip unparseable records, but try the remaining ones */
+	}
+	return FALSE;
+}
+
+METHOD(enumerator_t, enumerator_destroy, void,
+	snapshot_enumerator_t *this)
+{
+	if (this->map)
+	{
+		chunk_unmap(this->map);
+	}
+	free(this);
+}
+
+METHOD(ha_snapshot_t, create_enumerator, enumerator_t*,
+	private_ha_snapshot_t *this)
+{
+	snapshot_enumerator_t *enumerator;
+	chunk_t *map;
+
+	INIT(enumerator,
+		.public = {
+			.enumerate = (void*)_enumerate,
+			.destroy = _enumerator_destroy,
+		},
+	);
+	map = chunk_map(this->path, FALSE);
+	if (map)
+	{
+		if (map->len >= 4 && untoh32(map->ptr) == HA_SNAPSHOT_MAGIC)
+		{
+			enumerator->map = map;
+			enumerator->rest = chunk_skip(*map, 4);
+		}
+		else
+		{
+			DBG1(DBG_CFG, "HA snapshot '%s' has invalid magic, ignored",
+				 this->path);
+			chunk_unmap(map);
+		}
+	}
+	return &enumerator->public;
+}
+
+METHOD(ha_snapshot_t, remove_, void,
+	private_ha_snapshot_t *this)
+{
+	if (unlink(this->path) != 0 && errno != ENOENT)
+	{
+		DBG1(DBG_CFG, "removing HA snapshot '%s' failed: %s",
+			 this->path, strerror(errno));
+	}
+}
+
+METHOD(ha_snapshot_t, destroy, void,
+	private_ha_snapshot_t *this)
+{
+	if (this->file)
+	{
+		fclose(this->file);
+		unlink(this->tmp);
+	}
+	free(this->path);
+	free(this->tmp);
+	free(this);
+}
+
+/**
+ * See header
+ */
+ha_snapshot_t *ha_snapshot_create(char *path)
+{
+	private_ha_snapshot_t *this;
+
+	INIT(this,
+		.public = {
+			.begin = _begin,
+			.write = _write_,
+			.commit = _commit,
+			.create_enumerator = _create_enumerator,
+			.remove = _remove_,
+			.destroy = _destroy,
+		},
+		.path = strdup(path),
+	);
+
+	if (asprintf(&this->tmp, "%s.tmp", path) < 0)
+	{
+		free(this->path);
+		free(this);
+		return NULL;
+	}
+	return &this->public;
+}
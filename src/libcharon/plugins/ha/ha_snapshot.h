@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2015 Tobias Brunner
+ * Hochschule fuer Technik Rapperswil
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/**
+ * @defgroup ha_snapshot ha_snapshot
+ * @{ @ingroup ha
+ */
+
+#ifndef HA_SNAPSHOT_H_
+#define HA_SNAPSHOT_H_
+
+typedef struct ha_snapshot_t ha_snapshot_t;
+
+#include "ha_message.h"
+
+/**
+ * On-disk snapshot of the HA message cache.
+ *
+ * The snapshot is a flat file of length-prefixed encoded ha_message_t
+ * records.  It is written to a temporary file and atomically renamed into
+ * place, and read back through mmap(), so a planned restart can replay the
+ * synchronization state without a cluster peer.
+ */
+struct ha_snapshot_t {
+
+	/**
+	 * Start writing a new snapshot to a temporary file.
+	 *
+	 * @return			TRUE if the temporary file could be opened
+	 */
+	bool (*begin)(ha_snapshot_t *this);
+
+	/**
+	 * Append a message to the snapshot started with begin().
+	 *
+	 * @param message	message to append
+	 * @return			TRUE if written successfully
+	 */
+	bool (*write)(ha_snapshot_t *this, ha_message_t *message);
+
+	/**
+	 * Atomically replace the snapshot file with the written data.
+	 *
+	 * @return			TRUE if the snapshot was committed
+	 */
+	bool (*commit)(ha_snapshot_t *this);
+
+	/**
+	 * Create an enumerator over the messages of the stored snapshot.
+	 *
+	 * Yielded messages are parsed copies, ownership is transferred to the
+	 * caller.  Returns an empty enumerator if no snapshot file exists.
+	 *
+	 * @return			enumerator over ha_message_t*
+	 */
+	enumerator_t* (*create_enumerator)(ha_snapshot_t *this);
+
+	/**
+	 * Remove the snapshot file, e.g. after it has been restored.
+	 */
+	void (*remove)(ha_snapshot_t *this);
+
+	/**
+	 * Destroy a ha_snapshot_t.
+	 */
+	void (*destroy)(ha_snapshot_t *this);
+};
+
+/**
+ * Create a ha_snapshot instance.
+ *
+ * @param path		path to the snapshot file
+ * @return			snapshot object
+ */
+ha_snapshot_t *ha_snapshot_create(char *path);
+
+#endif /** HA_SNAPSHOT_H_ @}*/
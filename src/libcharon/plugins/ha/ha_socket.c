@@ -15,6 +15,7 @@
 
 #include "ha_socket.h"
 #include "ha_plugin.h"
+#include "ha_message.h"
 
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -23,9 +24,14 @@
 
 #include <daemon.h>
 #include <networking/host.h>
+#include <collections/linked_list.h>
 #include <threading/thread.h>
+#include <threading/mutex.h>
 #include <processing/jobs/callback_job.h>
 
+/** header size of a batch entry: shared prefix length and suffix length */
+#define BATCH_ENTRY_HEADER 4
+
 typedef struct private_ha_socket_t private_ha_socket_t;
 
 /**
@@ -52,6 +58,41 @@ struct private_ha_socket_t {
 	 * remote host to receive/send to
 	 */
 	host_t *remote;
+
+	/**
+	 * mutex protecting the batch buffer and the receive queue
+	 */
+	mutex_t *mutex;
+
+	/**
+	 * batched but not yet transmitted message encodings
+	 */
+	u_char buf[1024];
+
+	/**
+	 * bytes used in the batch buffer
+	 */
+	size_t buflen;
+
+	/**
+	 * encoding of the last message added to the batch, for delta encoding
+	 */
+	chunk_t prev;
+
+	/**
+	 * TRUE while a delayed flush job is scheduled
+	 */
+	bool flush_scheduled;
+
+	/**
+	 * milliseconds to collect messages before flushing, 0 to disable batching
+	 */
+	u_int flush_interval;
+
+	/**
+	 * received messages of a batch, pending delivery by pull()
+	 */
+	linked_list_t *queued;
 };
 
 /**
@@ -83,13 +124,12 @@ static job_requeue_t send_message(job_data_t *data)
 	return JOB_REQUEUE_NONE;
 }
 
-METHOD(ha_socket_t, push, void,
-	private_ha_socket_t *this, ha_message_t *message)
+/**
+ * Transmit an encoded message or batch, non-blocking with async fallback
+ */
+static void send_chunk(private_ha_socket_t *this, chunk_t chunk)
 {
-	chunk_t chunk;
-
 	/* Try to send synchronously, but non-blocking. */
-	chunk = message->get_encoding(message);
 	if (send(this->fd, chunk.ptr, chunk.len, MSG_DONTWAIT) < chunk.len)
 	{
 		if (errno == EAGAIN)
@@ -114,13 +154,148 @@ METHOD(ha_socket_t, push, void,
 	}
 }
 
+/**
+ * Transmit and reset the batch buffer, mutex is held by caller
+ */
+static void flush_batch(private_ha_socket_t *this)
+{
+	if (this->buflen)
+	{
+		send_chunk(this, chunk_create(this->buf, this->buflen));
+		this->buflen = 0;
+		chunk_free(&this->prev);
+	}
+}
+
+/**
+ * Scheduled job flushing a partially filled batch after the flush interval
+ */
+static job_requeue_t flush_job(private_ha_socket_t *this)
+{
+	this->mutex->lock(this->mutex);
+	this->flush_scheduled = FALSE;
+	flush_batch(this);
+	this->mutex->unlock(this->mutex);
+	return JOB_REQUEUE_NONE;
+}
+
+METHOD(ha_socket_t, push, void,
+	private_ha_socket_t *this, ha_message_t *message)
+{
+	chunk_t chunk;
+	size_t same = 0;
+
+	chunk = message->get_encoding(message);
+	if (!this->flush_interval)
+	{	/* batching disabled, transmit each message directly */
+		send_chunk(this, chunk);
+		return;
+	}
+	this->mutex->lock(this->mutex);
+	if (this->buflen &&
+		sizeof(this->buf) - this->buflen < BATCH_ENTRY_HEADER + chunk.len)
+	{
+		flush_batch(this);
+	}
+	if (sizeof(this->buf) - 2 < BATCH_ENTRY_HEADER + chunk.len)
+	{	/* message too large to batch at all */
+		this->mutex->unlock(this->mutex);
+		send_chunk(this, chunk);
+		return;
+	}
+	if (!this->buflen)
+	{
+		this->buf[0] = HA_MESSAGE_VERSION;
+		this->buf[1] = HA_BATCH;
+		this->buflen = 2;
+	}
+	/* delta encode against the previous message, consecutive messages for
+	 * the same SA and config share their leading attributes */
+	while (same < chunk.len && same < this->prev.len &&
+		   chunk.ptr[same] == this->prev.ptr[same])
+	{
+		same++;
+	}
+	htoun16(this->buf + this->buflen, same);
+	htoun16(this->buf + this->buflen + 2, chunk.len - same);
+	memcpy(this->buf + this->buflen + BATCH_ENTRY_HEADER,
+		   chunk.ptr + same, chunk.len - same);
+	this->buflen += BATCH_ENTRY_HEADER + chunk.len - same;
+	chunk_free(&this->prev);
+	this->prev = chunk_clone(chunk);
+
+	if (!this->flush_scheduled)
+	{
+		this->flush_scheduled = TRUE;
+		lib->scheduler->schedule_job_ms(lib->scheduler,
+				(job_t*)callback_job_create((callback_job_cb_t)flush_job,
+											this, NULL, NULL),
+				this->flush_interval);
+	}
+	this->mutex->unlock(this->mutex);
+}
+
+/**
+ * Parse a batch datagram, reassembling the delta encoded messages.
+ *
+ * Returns the first message, any others get queued for later pull()s.
+ */
+static ha_message_t *parse_batch(private_ha_socket_t *this, chunk_t data)
+{
+	ha_message_t *message, *first = NULL;
+	u_char assembled[sizeof(this->buf)];
+	size_t assembled_len = 0, same, len;
+
+	data = chunk_skip(data, 2);
+	while (data.len >= BATCH_ENTRY_HEADER)
+	{
+		same = untoh16(data.ptr);
+		len = untoh16(data.ptr + 2);
+		if (same > assembled_len || len > data.len - BATCH_ENTRY_HEADER ||
+			same + len > sizeof(assembled))
+		{
+			DBG1(DBG_CFG, "received malformed HA message batch");
+			break;
+		}
+		memcpy(assembled + same, data.ptr + BATCH_ENTRY_HEADER, len);
+		assembled_len = same + len;
+		data = chunk_skip(data, BATCH_ENTRY_HEADER + len);
+
+		message = ha_message_parse(chunk_create(assembled, assembled_len));
+		if (!message)
+		{
+			continue;
+		}
+		if (!first)
+		{
+			first = message;
+		}
+		else
+		{
+			this->mutex->lock(this->mutex);
+			this->queued->insert_last(this->queued, message);
+			this->mutex->unlock(this->mutex);
+		}
+	}
+	return first;
+}
+
 METHOD(ha_socket_t, pull, ha_message_t*,
 	private_ha_socket_t *this)
 {
+	ha_message_t *message;
+
+	this->mutex->lock(this->mutex);
+	if (this->queued->remove_first(this->queued, (void**)&message) == SUCCESS)
+	{
+		this->mutex->unlock(this->mutex);
+		return message;
+	}
+	this->mutex->unlock(this->mutex);
+
 	while (TRUE)
 	{
-		ha_message_t *message;
-		char buf[1024];
+		u_char buf[1024];
 		bool oldstate;
 		ssize_t len;
 
@@ -141,7 +316,14 @@ METHOD(ha_socket_t, pull, ha_message_t*,
 					continue;
 			}
 		}
-		message = ha_message_parse(chunk_create(buf, len));
+		if (len >= 2 && buf[0] == HA_MESSAGE_VERSION && buf[1] == HA_BATCH)
+		{
+			message = parse_batch(this, chunk_create(buf, len));
+		}
+		else
+		{
+			message = ha_message_parse(chunk_create(buf, len));
+		}
 		if (message)
 		{
 			return message;
@@ -184,10 +366,16 @@ static bool open_socket(private_ha_socket_t *this)
 METHOD(ha_socket_t, destroy, void,
 	private_ha_socket_t *this)
 {
+	this->mutex->lock(this->mutex);
+	flush_batch(this);
+	this->mutex->unlock(this->mutex);
 	if (this->fd != -1)
 	{
 		close(this->fd);
 	}
+	this->queued->destroy_offset(this->queued,
+								 offsetof(ha_message_t, destroy));
+	this->mutex->destroy(this->mutex);
 	DESTROY_IF(this->local);
 	DESTROY_IF(this->remote);
 	free(this);
@@ -209,6 +397,10 @@ ha_socket_t *ha_socket_create(char *local, char *remote)
 		.local = host_create_from_dns(local, 0, HA_PORT),
 		.remote = host_create_from_dns(remote, 0, HA_PORT),
 		.fd = -1,
+		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+		.queued = linked_list_create(),
+		.flush_interval = lib->settings->get_int(lib->settings,
+								"%s.plugins.ha.flush_interval", 0, lib->ns),
 	);
 
 	if (!this->local || !this->remote)
@@ -126,7 +126,9 @@ plugin_t *kernel_libipsec_plugin_create()
 		return NULL;
 	}
 
-	this->tun = tun_device_create("ipsec%d");
+	this->tun = tun_device_create_queues("ipsec%d",
+					lib->settings->get_int(lib->settings,
+						"%s.plugins.kernel-libipsec.tun_queues", 1, lib->ns));
 	if (!this->tun)
 	{
 		DBG1(DBG_KNL, "failed to create TUN device");
@@ -29,6 +29,12 @@
 
 typedef struct private_kernel_libipsec_router_t private_kernel_libipsec_router_t;
 
+/**
+ * Maximum number of packets to drain from a TUN device per poll() wakeup,
+ * so a busy device can't starve the others
+ */
+#define TUN_READ_BATCH 32
+
 /**
  * Entry in the TUN device map
  */
@@ -131,13 +137,18 @@ static void deliver_plain(private_kernel_libipsec_router_t *this,
 }
 
 /**
- * Read and process outbound plaintext packet for the given TUN device
+ * Read and process outbound plaintext packets for a TUN device queue
+ *
+ * The TUN FDs are non-blocking, so after poll() signaled data the queue is
+ * drained in a batch instead of returning to poll() for every packet.
  */
-static void process_plain(tun_device_t *tun)
+static void process_plain(tun_device_t *tun, u_int queue)
 {
 	chunk_t raw;
+	u_int i;
 
-	if (tun->read_packet(tun, &raw))
+	for (i = 0; i < TUN_READ_BATCH &&
+		 tun->read_packet_queue(tun, queue, &raw); i++)
 	{
 		ip_packet_t *packet;
 
@@ -153,6 +164,39 @@ static void process_plain(tun_device_t *tun)
 	}
 }
 
+/**
+ * Reader state for an additional queue of a multi-queue TUN device
+ */
+typedef struct {
+	/** TUN device */
+	tun_device_t *tun;
+	/** queue served by this job */
+	u_int queue;
+} tun_queue_t;
+
+/**
+ * Job draining one additional queue of a multi-queue TUN device
+ */
+static job_requeue_t handle_queue(tun_queue_t *q)
+{
+	struct pollfd pfd = {
+		.fd = q->tun->get_queue_fd(q->tun, q->queue),
+		.events = POLLIN,
+	};
+	bool oldstate;
+
+	oldstate = thread_cancelability(TRUE);
+	if (poll(&pfd, 1, -1) <= 0)
+	{
+		thread_cancelability(oldstate);
+		return JOB_REQUEUE_FAIR;
+	}
+	thread_cancelability(oldstate);
+
+	process_plain(q->tun, q->queue);
+	return JOB_REQUEUE_DIRECT;
+}
+
 /**
  * Find flagged revents in a pollfd set by fd
  */
@@ -222,7 +266,7 @@ static job_requeue_t handle_plain(private_kernel_libipsec_router_t *this)
 
 	if (pfd[1].revents & POLLIN)
 	{
-		process_plain(this->tun.tun);
+		process_plain(this->tun.tun, 0);
 	}
 
 	this->lock->read_lock(this->lock);
@@ -231,7 +275,7 @@ static job_requeue_t handle_plain(private_kernel_libipsec_router_t *this)
 	{
 		if (find_revents(pfd, count, entry->fd) & POLLIN)
 		{
-			process_plain(entry->tun);
+			process_plain(entry->tun, 0);
 		}
 	}
 	enumerator->destroy(enumerator);
@@ -240,6 +284,15 @@ static job_requeue_t handle_plain(private_kernel_libipsec_router_t *this)
 	return JOB_REQUEUE_DIRECT;
 }
 
+/**
+ * Set O_NONBLOCK on the given socket.
+ */
+static bool set_nonblock(int socket)
+{
+	int flags = fcntl(socket, F_GETFL);
+	return flags != -1 && fcntl(socket, F_SETFL, flags | O_NONBLOCK) != -1;
+}
+
 METHOD(kernel_listener_t, tun, bool,
 	private_kernel_libipsec_router_t *this, tun_device_t *tun, bool created)
 {
@@ -254,6 +307,8 @@ METHOD(kernel_listener_t, tun, bool,
 			.fd = tun->get_fd(tun),
 			.tun = tun,
 		);
+		/* drained in batches after poll() signaled data */
+		set_nonblock(entry->fd);
 		this->tuns->put(this->tuns, entry, entry);
 	}
 	else
@@ -308,21 +363,13 @@ METHOD(kernel_libipsec_router_t, destroy, void,
 	free(this);
 }
 
-/**
- * Set O_NONBLOCK on the given socket.
- */
-static bool set_nonblock(int socket)
-{
-	int flags = fcntl(socket, F_GETFL);
-	return flags != -1 && fcntl(socket, F_SETFL, flags | O_NONBLOCK) != -1;
-}
-
 /*
  * See header file
  */
 kernel_libipsec_router_t *kernel_libipsec_router_create()
 {
 	private_kernel_libipsec_router_t *this;
+	u_int i;
 
 	INIT(this,
 		.public = {
@@ -346,6 +393,8 @@ kernel_libipsec_router_t *kernel_libipsec_router_create()
 	}
 
 	this->tun.fd = this->tun.tun->get_fd(this->tun.tun);
+	/* drained in batches after poll() signaled data */
+	set_nonblock(this->tun.fd);
 
 	this->tuns = hashtable_create((hashtable_hash_t)tun_entry_hash,
 								  (hashtable_equals_t)tun_entry_equals, 4);
@@ -362,6 +411,21 @@ kernel_libipsec_router_t *kernel_libipsec_router_create()
 			(job_t*)callback_job_create((callback_job_cb_t)handle_plain, this,
 									NULL, (callback_job_cancel_t)return_false));
 
+	/* one reader job per additional queue of a multi-queue TUN device */
+	for (i = 1; i < this->tun.tun->get_queues(this->tun.tun); i++)
+	{
+		tun_queue_t *q;
+
+		INIT(q,
+			.tun = this->tun.tun,
+			.queue = i,
+		);
+		set_nonblock(this->tun.tun->get_queue_fd(this->tun.tun, i));
+		lib->processor->queue_job(lib->processor,
+			(job_t*)callback_job_create((callback_job_cb_t)handle_queue, q,
+									free, (callback_job_cancel_t)return_false));
+	}
+
 	router = &this->public;
 	return &this->public;
 }
@@ -250,6 +250,43 @@ static u_int hash_route(route_t *route)
 static bool manage_routes(private_kernel_wfp_ipsec_t *this, entry_t *entry,
 						  bool add);
 
+/**
+ * Begin a transaction on the WFP engine, batching object operations
+ */
+static bool begin_transaction(private_kernel_wfp_ipsec_t *this)
+{
+	DWORD res;
+
+	res = FwpmTransactionBegin0(this->handle, 0);
+	if (res != ERROR_SUCCESS)
+	{
+		DBG1(DBG_KNL, "starting WFP transaction failed: 0x%08x", res);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * Commit the current WFP transaction if ok, abort it otherwise
+ */
+static bool end_transaction(private_kernel_wfp_ipsec_t *this, bool ok)
+{
+	DWORD res;
+
+	if (ok)
+	{
+		res = FwpmTransactionCommit0(this->handle);
+		if (res != ERROR_SUCCESS)
+		{
+			DBG1(DBG_KNL, "committing WFP transaction failed: 0x%08x", res);
+			return FALSE;
+		}
+		return TRUE;
+	}
+	FwpmTransactionAbort0(this->handle);
+	return FALSE;
+}
+
 /**
  * Remove policies associated to an entry from kernel
  */
@@ -295,6 +332,14 @@ static void cleanup_policies(private_kernel_wfp_ipsec_t *this, entry_t *entry)
  */
 static void entry_destroy(private_kernel_wfp_ipsec_t *this, entry_t *entry)
 {
+	bool transaction;
+
+	if (entry->sa_id)
+	{	/* SA contexts are not transactional objects */
+		IPsecSaContextDeleteById0(this->handle, entry->sa_id);
+	}
+	/* batch all filter/provider context deletions into a single transaction */
+	transaction = begin_transaction(this);
 	if (entry->ip_ipv4_in)
 	{
 		FwpmFilterDeleteById0(this->handle, entry->ip_ipv4_in);
@@ -311,15 +356,15 @@ static void entry_destroy(private_kernel_wfp_ipsec_t *this, entry_t *entry)
 	{
 		FwpmFilterDeleteById0(this->handle, entry->ip_ipv6_out);
 	}
-	if (entry->sa_id)
-	{
-		IPsecSaContextDeleteById0(this->handle, entry->sa_id);
-	}
 	if (entry->provider)
 	{
 		FwpmProviderContextDeleteById0(this->handle, entry->provider);
 	}
 	cleanup_policies(this, entry);
+	if (transaction)
+	{
+		end_transaction(this, TRUE);
+	}
 	array_destroy_function(entry->sps, (void*)sp_entry_destroy, NULL);
 	entry->local->destroy(entry->local);
 	entry->remote->destroy(entry->remote);
@@ -1252,7 +1297,8 @@ static bool install_sas(private_kernel_wfp_ipsec_t *this, entry_t *entry,
  */
 static bool install_transport(private_kernel_wfp_ipsec_t *this, entry_t *entry)
 {
-	if (install_sps(this, entry, NULL) &&
+	if (begin_transaction(this) &&
+		end_transaction(this, install_sps(this, entry, NULL)) &&
 		install_sas(this, entry, IPSEC_TRAFFIC_TYPE_TRANSPORT))
 	{
 		return TRUE;
@@ -1550,7 +1596,8 @@ static bool manage_routes(private_kernel_wfp_ipsec_t *this, entry_t *entry,
  */
 static bool install_tunnel(private_kernel_wfp_ipsec_t *this, entry_t *entry)
 {
-	if (install_tunnel_sps(this, entry) &&
+	if (begin_transaction(this) &&
+		end_transaction(this, install_tunnel_sps(this, entry)) &&
 		manage_routes(this, entry, TRUE) &&
 		install_sas(this, entry, IPSEC_TRAFFIC_TYPE_TUNNEL))
 	{
@@ -2103,7 +2150,8 @@ METHOD(kernel_ipsec_t, add_sa, status_t,
 	u_int32_t tfc, lifetime_cfg_t *lifetime, u_int16_t enc_alg, chunk_t enc_key,
 	u_int16_t int_alg, chunk_t int_key, ipsec_mode_t mode,
 	u_int16_t ipcomp, u_int16_t cpi, u_int32_t replay_window,
-	bool initiator, bool encap, bool esn, bool inbound, bool update,
+	bool initiator, bool encap, bool esn, bool hw_offload, bool inbound,
+	bool update,
 	linked_list_t *src_ts, linked_list_t *dst_ts)
 {
 	host_t *local, *remote;
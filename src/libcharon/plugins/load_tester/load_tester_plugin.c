@@ -18,6 +18,7 @@
 #include "load_tester_creds.h"
 #include "load_tester_ipsec.h"
 #include "load_tester_listener.h"
+#include "load_tester_stats.h"
 #include "load_tester_control.h"
 #include "load_tester_diffie_hellman.h"
 
@@ -25,10 +26,28 @@
 
 #include <hydra.h>
 #include <daemon.h>
+#include <collections/linked_list.h>
 #include <processing/jobs/callback_job.h>
+#include <processing/jobs/rekey_child_sa_job.h>
 #include <threading/condvar.h>
 #include <threading/mutex.h>
 
+typedef enum load_profile_t load_profile_t;
+
+/**
+ * Supported load profiles
+ */
+enum load_profile_t {
+	/** constant rate, as configured by delay */
+	PROFILE_NONE,
+	/** delay interpolated from delay to profile_delay over profile_time */
+	PROFILE_RAMP,
+	/** constant rate, stop initiating after profile_time */
+	PROFILE_SOAK,
+	/** alternate between delay and profile_delay every profile_time */
+	PROFILE_SPIKE,
+};
+
 typedef struct private_load_tester_plugin_t private_load_tester_plugin_t;
 
 /**
@@ -61,6 +80,11 @@ struct private_load_tester_plugin_t {
 	 */
 	load_tester_listener_t *listener;
 
+	/**
+	 * latency statistics collector, NULL if not configured
+	 */
+	load_tester_stats_t *stats;
+
 	/**
 	 * number of iterations per thread
 	 */
@@ -86,6 +110,36 @@ struct private_load_tester_plugin_t {
 	 */
 	int init_limit;
 
+	/**
+	 * load profile applied to the initiation rate
+	 */
+	load_profile_t profile;
+
+	/**
+	 * load profile period, in s
+	 */
+	int profile_time;
+
+	/**
+	 * second delay value used by ramp/spike profiles, in ms
+	 */
+	int profile_delay;
+
+	/**
+	 * interval to trigger rekey/DPD churn on established SAs, 0 to disable
+	 */
+	int churn_interval;
+
+	/**
+	 * trigger CHILD_SA rekeying during churn
+	 */
+	bool churn_rekey;
+
+	/**
+	 * trigger DPD exchanges during churn
+	 */
+	bool churn_dpd;
+
 	/**
 	 * mutex to lock running field
 	 */
@@ -97,12 +151,37 @@ struct private_load_tester_plugin_t {
 	condvar_t *condvar;
 };
 
+/**
+ * Get the current inter-initiation delay of the configured profile, in ms
+ */
+static int current_delay(private_load_tester_plugin_t *this, int elapsed)
+{
+	switch (this->profile)
+	{
+		case PROFILE_RAMP:
+			if (elapsed >= this->profile_time)
+			{
+				return this->profile_delay;
+			}
+			return this->delay + (this->profile_delay - this->delay) *
+				   elapsed / this->profile_time;
+		case PROFILE_SPIKE:
+			return ((elapsed / this->profile_time) % 2) ? this->profile_delay
+														: this->delay;
+		case PROFILE_NONE:
+		case PROFILE_SOAK:
+		default:
+			return this->delay;
+	}
+}
+
 /**
  * Begin the load test
  */
 static job_requeue_t do_load_test(private_load_tester_plugin_t *this)
 {
-	int i, s = 0, ms = 0;
+	timeval_t start;
+	int i, delay, s = 0, ms = 0;
 
 	this->mutex->lock(this->mutex);
 	this->running++;
@@ -112,9 +191,26 @@ static job_requeue_t do_load_test(private_load_tester_plugin_t *this)
 		s = this->delay / 1000;
 		ms = this->delay % 1000;
 	}
+	time_monotonic(&start);
 
 	for (i = 0; this->iterations == 0 || i < this->iterations; i++)
 	{
+		if (this->profile != PROFILE_NONE)
+		{
+			timeval_t now;
+			int elapsed;
+
+			time_monotonic(&now);
+			elapsed = now.tv_sec - start.tv_sec;
+			if (this->profile == PROFILE_SOAK &&
+				elapsed >= this->profile_time)
+			{
+				break;
+			}
+			delay = current_delay(this, elapsed);
+			s = delay / 1000;
+			ms = delay % 1000;
+		}
 		peer_cfg_t *peer_cfg;
 		child_cfg_t *child_cfg = NULL;
 		enumerator_t *enumerator;
@@ -169,6 +265,71 @@ static job_requeue_t do_load_test(private_load_tester_plugin_t *this)
 	return JOB_REQUEUE_NONE;
 }
 
+/**
+ * Trigger rekey and DPD churn on all established IKE_SAs
+ */
+static job_requeue_t do_churn(private_load_tester_plugin_t *this)
+{
+	enumerator_t *enumerator, *children;
+	linked_list_t *ids;
+	ike_sa_t *ike_sa;
+	ike_sa_id_t *id;
+	child_sa_t *child_sa;
+
+	ids = linked_list_create();
+
+	enumerator = charon->controller->create_ike_sa_enumerator(
+												charon->controller, TRUE);
+	while (enumerator->enumerate(enumerator, &ike_sa))
+	{
+		if (ike_sa->get_state(ike_sa) != IKE_ESTABLISHED)
+		{
+			continue;
+		}
+		if (this->churn_rekey)
+		{
+			children = ike_sa->create_child_sa_enumerator(ike_sa);
+			while (children->enumerate(children, (void**)&child_sa))
+			{
+				lib->processor->queue_job(lib->processor,
+					(job_t*)rekey_child_sa_job_create(
+							child_sa->get_protocol(child_sa),
+							child_sa->get_spi(child_sa, TRUE),
+							ike_sa->get_my_host(ike_sa)));
+			}
+			children->destroy(children);
+		}
+		if (this->churn_dpd)
+		{
+			id = ike_sa->get_id(ike_sa);
+			ids->insert_last(ids, id->clone(id));
+		}
+	}
+	enumerator->destroy(enumerator);
+
+	/* send DPDs outside of the enumerator, checking out each SA */
+	while (ids->remove_first(ids, (void**)&id) == SUCCESS)
+	{
+		ike_sa = charon->ike_sa_manager->checkout(charon->ike_sa_manager, id);
+		if (ike_sa)
+		{
+			if (ike_sa->send_dpd(ike_sa) == DESTROY_ME)
+			{
+				charon->ike_sa_manager->checkin_and_destroy(
+												charon->ike_sa_manager, ike_sa);
+			}
+			else
+			{
+				charon->ike_sa_manager->checkin(charon->ike_sa_manager, ike_sa);
+			}
+		}
+		id->destroy(id);
+	}
+	ids->destroy(ids);
+
+	return JOB_RESCHEDULE(this->churn_interval);
+}
+
 METHOD(plugin_t, get_name, char*,
 	private_load_tester_plugin_t *this)
 {
@@ -200,12 +361,28 @@ static bool register_load_tester(private_load_tester_plugin_t *this,
 		this->listener = load_tester_listener_create(shutdown_on, this->config);
 		charon->bus->add_listener(charon->bus, &this->listener->listener);
 
+		if (lib->settings->get_int(lib->settings,
+				"%s.plugins.load-tester.stats_interval", 0, lib->ns) ||
+			lib->settings->get_str(lib->settings,
+				"%s.plugins.load-tester.stats_file", NULL, lib->ns))
+		{
+			this->stats = load_tester_stats_create();
+			charon->bus->add_listener(charon->bus, &this->stats->listener);
+		}
+
 		for (i = 0; i < this->initiators; i++)
 		{
 			lib->processor->queue_job(lib->processor, (job_t*)
 				callback_job_create_with_prio((callback_job_cb_t)do_load_test,
 										this, NULL, NULL, JOB_PRIO_CRITICAL));
 		}
+		if (this->churn_interval && (this->churn_rekey || this->churn_dpd))
+		{
+			lib->scheduler->schedule_job(lib->scheduler, (job_t*)
+				callback_job_create_with_prio((callback_job_cb_t)do_churn,
+										this, NULL, NULL, JOB_PRIO_CRITICAL),
+				this->churn_interval);
+		}
 	}
 	else
 	{
@@ -219,6 +396,11 @@ static bool register_load_tester(private_load_tester_plugin_t *this,
 		charon->backends->remove_backend(charon->backends, &this->config->backend);
 		lib->credmgr->remove_set(lib->credmgr, &this->creds->credential_set);
 		charon->bus->remove_listener(charon->bus, &this->listener->listener);
+		if (this->stats)
+		{
+			charon->bus->remove_listener(charon->bus, &this->stats->listener);
+			this->stats->destroy(this->stats);
+		}
 		this->config->destroy(this->config);
 		this->creds->destroy(this->creds);
 		this->listener->destroy(this->listener);
@@ -261,6 +443,7 @@ METHOD(plugin_t, destroy, void,
 plugin_t *load_tester_plugin_create()
 {
 	private_load_tester_plugin_t *this;
+	char *profile;
 
 	if (!lib->settings->get_bool(lib->settings, "%s.plugins.load-tester.enable",
 								 FALSE, lib->ns))
@@ -286,10 +469,43 @@ plugin_t *load_tester_plugin_create()
 							"%s.plugins.load-tester.initiators", 0, lib->ns),
 		.init_limit = lib->settings->get_int(lib->settings,
 							"%s.plugins.load-tester.init_limit", 0, lib->ns),
+		.profile_time = lib->settings->get_int(lib->settings,
+							"%s.plugins.load-tester.profile_time", 60, lib->ns),
+		.profile_delay = lib->settings->get_int(lib->settings,
+							"%s.plugins.load-tester.profile_delay", 0, lib->ns),
+		.churn_interval = lib->settings->get_int(lib->settings,
+							"%s.plugins.load-tester.churn_interval", 0, lib->ns),
+		.churn_rekey = lib->settings->get_bool(lib->settings,
+							"%s.plugins.load-tester.churn_rekey", TRUE, lib->ns),
+		.churn_dpd = lib->settings->get_bool(lib->settings,
+							"%s.plugins.load-tester.churn_dpd", TRUE, lib->ns),
 		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
 		.condvar = condvar_create(CONDVAR_TYPE_DEFAULT),
 	);
 
+	profile = lib->settings->get_str(lib->settings,
+							"%s.plugins.load-tester.profile", NULL, lib->ns);
+	if (profile)
+	{
+		if (streq(profile, "ramp"))
+		{
+			this->profile = PROFILE_RAMP;
+		}
+		else if (streq(profile, "soak"))
+		{
+			this->profile = PROFILE_SOAK;
+		}
+		else if (streq(profile, "spike"))
+		{
+			this->profile = PROFILE_SPIKE;
+		}
+		else
+		{
+			DBG1(DBG_CFG, "ignoring unknown load-tester profile '%s'", profile);
+		}
+	}
+	this->profile_time = max(this->profile_time, 1);
+
 	if (lib->settings->get_bool(lib->settings,
 			"%s.plugins.load-tester.fake_kernel", FALSE, lib->ns))
 	{
@@ -0,0 +1,396 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Copyright (C) 2015 revosec AG
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include "load_tester_stats.h"
+
+#include <stdio.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include <daemon.h>
+#include <collections/hashtable.h>
+#include <threading/mutex.h>
+#include <processing/jobs/callback_job.h>
+
+/**
+ * Number of logarithmic histogram buckets, samples are in microseconds
+ */
+#define HISTOGRAM_BUCKETS 32
+
+typedef struct private_load_tester_stats_t private_load_tester_stats_t;
+typedef struct histogram_t histogram_t;
+
+/**
+ * A latency histogram with logarithmically scaled buckets
+ */
+struct histogram_t {
+
+	/**
+	 * Number of samples per log2(microseconds) bucket
+	 */
+	u_int64_t buckets[HISTOGRAM_BUCKETS];
+
+	/**
+	 * Total number of samples
+	 */
+	u_int64_t count;
+
+	/**
+	 * Sum of all samples, in microseconds
+	 */
+	u_int64_t sum;
+
+	/**
+	 * Largest sample seen, in microseconds
+	 */
+	u_int32_t max;
+};
+
+/**
+ * Measured exchange phases
+ */
+enum {
+	PHASE_INIT = 0,
+	PHASE_AUTH = 1,
+	PHASE_REKEY = 2,
+	PHASE_MAX = 3,
+};
+
+/**
+ * Private data of an load_tester_stats_t object
+ */
+struct private_load_tester_stats_t {
+
+	/**
+	 * Public part
+	 */
+	load_tester_stats_t public;
+
+	/**
+	 * Latency histograms, one per exchange phase
+	 */
+	histogram_t histograms[PHASE_MAX];
+
+	/**
+	 * Pending exchange timestamps, keyed by IKE_SA unique ID
+	 */
+	hashtable_t *pending;
+
+	/**
+	 * Mutex protecting histograms and pending table
+	 */
+	mutex_t *mutex;
+
+	/**
+	 * Number of currently established IKE_SAs
+	 */
+	u_int established;
+
+	/**
+	 * Interval to dump statistics, in seconds, 0 to disable
+	 */
+	u_int interval;
+
+	/**
+	 * File to append statistics lines to, NULL to use the debug log
+	 */
+	FILE *file;
+};
+
+/**
+ * Timestamps of outstanding requests of an IKE_SA
+ */
+typedef struct {
+	/** time the IKE_SA_INIT request went out */
+	timeval_t init;
+	/** time the IKE_AUTH request went out */
+	timeval_t auth;
+	/** time the CREATE_CHILD_SA request went out */
+	timeval_t rekey;
+} pending_t;
+
+/**
+ * Add a sample, in microseconds, to a histogram
+ */
+static void histogram_record(histogram_t *h, u_int32_t us)
+{
+	u_int32_t value = us;
+	int bucket = 0;
+
+	while (value >>= 1)
+	{
+		bucket++;
+	}
+	h->buckets[bucket]++;
+	h->count++;
+	h->sum += us;
+	h->max = max(h->max, us);
+}
+
+/**
+ * Get the upper bound, in microseconds, of the bucket holding a percentile
+ */
+static u_int32_t histogram_percentile(histogram_t *h, int percentile)
+{
+	u_int64_t limit, seen = 0;
+	int i;
+
+	if (!h->count)
+	{
+		return 0;
+	}
+	limit = (h->count * percentile + 99) / 100;
+	for (i = 0; i < HISTOGRAM_BUCKETS; i++)
+	{
+		seen += h->buckets[i];
+		if (seen >= limit)
+		{
+			break;
+		}
+	}
+	return min((u_int64_t)1 << (i + 1), (u_int64_t)h->max);
+}
+
+/**
+ * Print a histogram in JSON object notation, all values in microseconds
+ */
+static int histogram_snprint(char *buf, size_t len, char *name, histogram_t *h)
+{
+	return snprintf(buf, len, "\"%s\":{\"count\":%llu,\"avg\":%llu,"
+					"\"p50\":%u,\"p90\":%u,\"p99\":%u,\"max\":%u}", name,
+					(unsigned long long)h->count,
+					h->count ? (unsigned long long)(h->sum / h->count) : 0ULL,
+					histogram_percentile(h, 50), histogram_percentile(h, 90),
+					histogram_percentile(h, 99), h->max);
+}
+
+/**
+ * Dump the current statistics as a single machine-readable line
+ */
+static void dump_line(private_load_tester_stats_t *this)
+{
+	char buf[512], *names[PHASE_MAX] = { "init", "auth", "rekey" };
+	int written, i;
+
+	this->mutex->lock(this->mutex);
+	written = snprintf(buf, sizeof(buf), "{\"time\":%lld,\"established\":%u",
+					   (long long)time(NULL), this->established);
+	for (i = 0; i < PHASE_MAX; i++)
+	{
+		written += snprintf(buf + written, sizeof(buf) - written, ",");
+		written += histogram_snprint(buf + written, sizeof(buf) - written,
+									 names[i], &this->histograms[i]);
+	}
+	snprintf(buf + written, sizeof(buf) - written, "}");
+	this->mutex->unlock(this->mutex);
+
+	if (this->file)
+	{
+		fprintf(this->file, "%s\n", buf);
+		fflush(this->file);
+	}
+	else
+	{
+		DBG1(DBG_CFG, "load-test stats: %s", buf);
+	}
+}
+
+/**
+ * Periodically dump statistics
+ */
+static job_requeue_t dump_stats(private_load_tester_stats_t *this)
+{
+	dump_line(this);
+
+	return JOB_RESCHEDULE(this->interval);
+}
+
+METHOD(listener_t, ike_updown, bool,
+	private_load_tester_stats_t *this, ike_sa_t *ike_sa, bool up)
+{
+	this->mutex->lock(this->mutex);
+	if (up)
+	{
+		this->established++;
+	}
+	else
+	{
+		this->established--;
+	}
+	this->mutex->unlock(this->mutex);
+	return TRUE;
+}
+
+METHOD(listener_t, ike_state_change, bool,
+	private_load_tester_stats_t *this, ike_sa_t *ike_sa, ike_sa_state_t state)
+{
+	pending_t *pending;
+	void *key;
+
+	if (state == IKE_DESTROYING)
+	{
+		key = (void*)(uintptr_t)ike_sa->get_unique_id(ike_sa);
+		this->mutex->lock(this->mutex);
+		pending = this->pending->remove(this->pending, key);
+		this->mutex->unlock(this->mutex);
+		free(pending);
+	}
+	return TRUE;
+}
+
+METHOD(listener_t, message_hook, bool,
+	private_load_tester_stats_t *this, ike_sa_t *ike_sa, message_t *message,
+	bool incoming, bool plain)
+{
+	ike_sa_id_t *id = ike_sa->get_id(ike_sa);
+	exchange_type_t exchange;
+	pending_t *pending;
+	timeval_t now, *sent = NULL;
+	histogram_t *histogram = NULL;
+	void *key;
+
+	if (!plain || !id->is_initiator(id))
+	{
+		return TRUE;
+	}
+	exchange = message->get_exchange_type(message);
+	if (exchange != IKE_SA_INIT && exchange != IKE_AUTH &&
+		exchange != CREATE_CHILD_SA)
+	{
+		return TRUE;
+	}
+	time_monotonic(&now);
+	key = (void*)(uintptr_t)ike_sa->get_unique_id(ike_sa);
+
+	this->mutex->lock(this->mutex);
+	pending = this->pending->get(this->pending, key);
+	if (!incoming && message->get_request(message))
+	{
+		if (!pending)
+		{
+			pending = malloc_thing(pending_t);
+			memset(pending, 0, sizeof(pending_t));
+			this->pending->put(this->pending, key, pending);
+		}
+		switch (exchange)
+		{
+			case IKE_SA_INIT:
+				sent = &pending->init;
+				break;
+			case IKE_AUTH:
+				sent = &pending->auth;
+				break;
+			default:
+				sent = &pending->rekey;
+				break;
+		}
+		if (!timerisset(sent))
+		{	/* measure from the first transmission of a request */
+			*sent = now;
+		}
+	}
+	else if (incoming && !message->get_request(message) && pending)
+	{
+		switch (exchange)
+		{
+			case IKE_SA_INIT:
+				sent = &pending->init;
+				histogram = &this->histograms[PHASE_INIT];
+				break;
+			case IKE_AUTH:
+				sent = &pending->auth;
+				histogram = &this->histograms[PHASE_AUTH];
+				break;
+			default:
+				sent = &pending->rekey;
+				histogram = &this->histograms[PHASE_REKEY];
+				break;
+		}
+		if (timerisset(sent))
+		{
+			timersub(&now, sent, &now);
+			histogram_record(histogram, now.tv_sec * 1000000 + now.tv_usec);
+			timerclear(sent);
+		}
+	}
+	this->mutex->unlock(this->mutex);
+	return TRUE;
+}
+
+METHOD(load_tester_stats_t, destroy, void,
+	private_load_tester_stats_t *this)
+{
+	enumerator_t *enumerator;
+	pending_t *pending;
+
+	dump_line(this);
+
+	enumerator = this->pending->create_enumerator(this->pending);
+	while (enumerator->enumerate(enumerator, NULL, &pending))
+	{
+		free(pending);
+	}
+	enumerator->destroy(enumerator);
+	this->pending->destroy(this->pending);
+	this->mutex->destroy(this->mutex);
+	if (this->file)
+	{
+		fclose(this->file);
+	}
+	free(this);
+}
+
+/*
+ * See header
+ */
+load_tester_stats_t *load_tester_stats_create()
+{
+	private_load_tester_stats_t *this;
+	char *path;
+
+	INIT(this,
+		.public = {
+			.listener = {
+				.ike_updown = _ike_updown,
+				.ike_state_change = _ike_state_change,
+				.message = _message_hook,
+			},
+			.destroy = _destroy,
+		},
+		.pending = hashtable_create(hashtable_hash_ptr, hashtable_equals_ptr, 32),
+		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+		.interval = lib->settings->get_int(lib->settings,
+						"%s.plugins.load-tester.stats_interval", 0, lib->ns),
+	);
+
+	path = lib->settings->get_str(lib->settings,
+						"%s.plugins.load-tester.stats_file", NULL, lib->ns);
+	if (path)
+	{
+		this->file = fopen(path, "a");
+		if (!this->file)
+		{
+			DBG1(DBG_CFG, "opening load-test stats file '%s' failed", path);
+		}
+	}
+	if (this->interval)
+	{
+		lib->scheduler->schedule_job(lib->scheduler, (job_t*)
+			callback_job_create_with_prio((callback_job_cb_t)dump_stats, this,
+										  NULL, NULL, JOB_PRIO_CRITICAL),
+			this->interval);
+	}
+	return &this->public;
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Copyright (C) 2015 revosec AG
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/**
+ * @defgroup load_tester_stats load_tester_stats
+ * @{ @ingroup load_tester
+ */
+
+#ifndef LOAD_TESTER_STATS_H_
+#define LOAD_TESTER_STATS_H_
+
+#include <bus/listeners/listener.h>
+
+typedef struct load_tester_stats_t load_tester_stats_t;
+
+/**
+ * Latency statistics collector for load tests.
+ *
+ * Records latency histograms for the IKE_SA_INIT, IKE_AUTH and
+ * CREATE_CHILD_SA exchanges initiated by the load tester and periodically
+ * dumps them in a machine-readable form, either to a file or the log.
+ */
+struct load_tester_stats_t {
+
+	/**
+	 * Implemented listener interface, to register at the bus.
+	 */
+	listener_t listener;
+
+	/**
+	 * Destroy the statistics collector, dumping final statistics.
+	 */
+	void (*destroy)(load_tester_stats_t *this);
+};
+
+/**
+ * Create a load_tester_stats instance.
+ *
+ * @return			statistics collector
+ */
+load_tester_stats_t *load_tester_stats_create();
+
+#endif /** LOAD_TESTER_STATS_H_ @}*/
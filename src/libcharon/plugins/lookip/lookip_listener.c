@@ -22,6 +22,11 @@
 
 typedef struct private_lookip_listener_t private_lookip_listener_t;
 
+/**
+ * Number of lock-striped entry table shards
+ */
+#define ENTRY_SHARDS 8
+
 /**
  * Private data of an lookip_listener_t object.
  */
@@ -33,14 +38,25 @@ struct private_lookip_listener_t {
 	lookip_listener_t public;
 
 	/**
-	 * Lock for hashtable
+	 * Lock-striped entry table shards
 	 */
-	rwlock_t *lock;
+	struct {
+
+		/**
+		 * Lock for the shards hashtable
+		 */
+		rwlock_t *lock;
+
+		/**
+		 * Hashtable with entries: host_t => entry_t
+		 */
+		hashtable_t *entries;
+	} shards[ENTRY_SHARDS];
 
 	/**
-	 * Hashtable with entries: host_t => entry_t
+	 * Lock for registered listeners
 	 */
-	hashtable_t *entries;
+	rwlock_t *lock;
 
 	/**
 	 * List of registered listeners
@@ -103,12 +119,40 @@ static bool equals(host_t *a, host_t *b)
 }
 
 /**
- * Compare callback that invokes up callback of all registered listeners
+ * Get the shard an entry with the given virtual IP belongs to
+ */
+static u_int vip_shard(host_t *vip)
+{
+	return hash(vip) % ENTRY_SHARDS;
+}
+
+/**
+ * A batch of entries affected by a single SA event
  */
-static bool notify_up(listener_entry_t *listener, entry_t *entry)
+typedef struct {
+	/** affected entries */
+	linked_list_t *entries;
+	/** TRUE for up, FALSE for down events */
+	bool up;
+} notify_batch_t;
+
+/**
+ * Compare callback that delivers a batch of events to a registered listener
+ */
+static bool notify_listener(listener_entry_t *listener, notify_batch_t *batch)
 {
-	if (!listener->cb(listener->user, TRUE, entry->vip, entry->other,
-					  entry->id, entry->name, entry->unique_id))
+	enumerator_t *enumerator;
+	entry_t *entry;
+	bool keep = TRUE;
+
+	enumerator = batch->entries->create_enumerator(batch->entries);
+	while (keep && enumerator->enumerate(enumerator, &entry))
+	{
+		keep = listener->cb(listener->user, batch->up, entry->vip, entry->other,
+							entry->id, entry->name, entry->unique_id);
+	}
+	enumerator->destroy(enumerator);
+	if (!keep)
 	{
 		free(listener);
 		return TRUE;
@@ -117,17 +161,23 @@ static bool notify_up(listener_entry_t *listener, entry_t *entry)
 }
 
 /**
- * Compare callback that invokes down callback of all registered listeners
+ * Notify all registered listeners in a single pass over the batch
  */
-static bool notify_down(listener_entry_t *listener, entry_t *entry)
+static void notify(private_lookip_listener_t *this, linked_list_t *entries,
+				   bool up)
 {
-	if (!listener->cb(listener->user, FALSE, entry->vip, entry->other,
-					  entry->id, entry->name, entry->unique_id))
+	notify_batch_t batch = {
+		.entries = entries,
+		.up = up,
+	};
+
+	if (entries->get_count(entries))
 	{
-		free(listener);
-		return TRUE;
+		this->lock->read_lock(this->lock);
+		this->listeners->remove(this->listeners, &batch,
+								(void*)notify_listener);
+		this->lock->unlock(this->lock);
 	}
-	return FALSE;
 }
 
 /**
@@ -136,10 +186,13 @@ static bool notify_down(listener_entry_t *listener, entry_t *entry)
 static void add_entry(private_lookip_listener_t *this, ike_sa_t *ike_sa)
 {
 	enumerator_t *enumerator;
+	linked_list_t *added;
 	host_t *vip, *other;
 	identification_t *id;
 	entry_t *entry;
+	u_int shard;
 
+	added = linked_list_create();
 	enumerator = ike_sa->create_virtual_ip_enumerator(ike_sa, FALSE);
 	while (enumerator->enumerate(enumerator, &vip))
 	{
@@ -153,20 +206,26 @@ static void add_entry(private_lookip_listener_t *this, ike_sa_t *ike_sa)
 			.name = strdup(ike_sa->get_name(ike_sa)),
 			.unique_id = ike_sa->get_unique_id(ike_sa),
 		);
+		added->insert_last(added, entry);
+	}
+	enumerator->destroy(enumerator);
 
-		this->lock->read_lock(this->lock);
-		this->listeners->remove(this->listeners, entry, (void*)notify_up);
-		this->lock->unlock(this->lock);
+	/* notify before insertion, while we still own the entries exclusively */
+	notify(this, added, TRUE);
 
-		this->lock->write_lock(this->lock);
-		entry = this->entries->put(this->entries, entry->vip, entry);
-		this->lock->unlock(this->lock);
+	while (added->remove_first(added, (void**)&entry) == SUCCESS)
+	{
+		shard = vip_shard(entry->vip);
+		this->shards[shard].lock->write_lock(this->shards[shard].lock);
+		entry = this->shards[shard].entries->put(this->shards[shard].entries,
+												 entry->vip, entry);
+		this->shards[shard].lock->unlock(this->shards[shard].lock);
 		if (entry)
 		{
 			entry_destroy(entry);
 		}
 	}
-	enumerator->destroy(enumerator);
+	added->destroy(added);
 }
 
 /**
@@ -175,25 +234,29 @@ static void add_entry(private_lookip_listener_t *this, ike_sa_t *ike_sa)
 static void remove_entry(private_lookip_listener_t *this, ike_sa_t *ike_sa)
 {
 	enumerator_t *enumerator;
+	linked_list_t *removed;
 	host_t *vip;
 	entry_t *entry;
+	u_int shard;
 
+	removed = linked_list_create();
 	enumerator = ike_sa->create_virtual_ip_enumerator(ike_sa, FALSE);
 	while (enumerator->enumerate(enumerator, &vip))
 	{
-		this->lock->write_lock(this->lock);
-		entry = this->entries->remove(this->entries, vip);
-		this->lock->unlock(this->lock);
+		shard = vip_shard(vip);
+		this->shards[shard].lock->write_lock(this->shards[shard].lock);
+		entry = this->shards[shard].entries->remove(
+										this->shards[shard].entries, vip);
+		this->shards[shard].lock->unlock(this->shards[shard].lock);
 		if (entry)
 		{
-			this->lock->read_lock(this->lock);
-			this->listeners->remove(this->listeners, entry, (void*)notify_down);
-			this->lock->unlock(this->lock);
-
-			entry_destroy(entry);
+			removed->insert_last(removed, entry);
 		}
 	}
 	enumerator->destroy(enumerator);
+
+	notify(this, removed, FALSE);
+	removed->destroy_function(removed, (void*)entry_destroy);
 }
 
 METHOD(listener_t, message_hook, bool,
@@ -245,32 +308,41 @@ METHOD(lookip_listener_t, lookup, int,
 {
 	entry_t *entry;
 	int matches = 0;
+	u_int shard;
 
-	this->lock->read_lock(this->lock);
 	if (vip)
 	{
-		entry = this->entries->get(this->entries, vip);
+		shard = vip_shard(vip);
+		this->shards[shard].lock->read_lock(this->shards[shard].lock);
+		entry = this->shards[shard].entries->get(this->shards[shard].entries,
+												 vip);
 		if (entry)
 		{
 			cb(user, TRUE, entry->vip, entry->other, entry->id,
 			   entry->name, entry->unique_id);
 			matches ++;
 		}
+		this->shards[shard].lock->unlock(this->shards[shard].lock);
 	}
 	else
 	{
 		enumerator_t *enumerator;
 
-		enumerator = this->entries->create_enumerator(this->entries);
-		while (enumerator->enumerate(enumerator, &vip, &entry))
+		for (shard = 0; shard < ENTRY_SHARDS; shard++)
 		{
-			cb(user, TRUE, entry->vip, entry->other, entry->id,
-			   entry->name, entry->unique_id);
-			matches++;
+			this->shards[shard].lock->read_lock(this->shards[shard].lock);
+			enumerator = this->shards[shard].entries->create_enumerator(
+											this->shards[shard].entries);
+			while (enumerator->enumerate(enumerator, &vip, &entry))
+			{
+				cb(user, TRUE, entry->vip, entry->other, entry->id,
+				   entry->name, entry->unique_id);
+				matches++;
+			}
+			enumerator->destroy(enumerator);
+			this->shards[shard].lock->unlock(this->shards[shard].lock);
 		}
-		enumerator->destroy(enumerator);
 	}
-	this->lock->unlock(this->lock);
 
 	return matches;
 }
@@ -313,8 +385,14 @@ METHOD(lookip_listener_t, remove_listener, void,
 METHOD(lookip_listener_t, destroy, void,
 	private_lookip_listener_t *this)
 {
+	u_int shard;
+
 	this->listeners->destroy_function(this->listeners, free);
-	this->entries->destroy(this->entries);
+	for (shard = 0; shard < ENTRY_SHARDS; shard++)
+	{
+		this->shards[shard].entries->destroy(this->shards[shard].entries);
+		this->shards[shard].lock->destroy(this->shards[shard].lock);
+	}
 	this->lock->destroy(this->lock);
 	free(this);
 }
@@ -325,6 +403,7 @@ METHOD(lookip_listener_t, destroy, void,
 lookip_listener_t *lookip_listener_create()
 {
 	private_lookip_listener_t *this;
+	u_int shard;
 
 	INIT(this,
 		.public = {
@@ -339,10 +418,14 @@ lookip_listener_t *lookip_listener_create()
 			.destroy = _destroy,
 		},
 		.lock = rwlock_create(RWLOCK_TYPE_DEFAULT),
-		.entries = hashtable_create((hashtable_hash_t)hash,
-									(hashtable_equals_t)equals, 32),
 		.listeners = linked_list_create(),
 	);
+	for (shard = 0; shard < ENTRY_SHARDS; shard++)
+	{
+		this->shards[shard].lock = rwlock_create(RWLOCK_TYPE_DEFAULT);
+		this->shards[shard].entries = hashtable_create((hashtable_hash_t)hash,
+												(hashtable_equals_t)equals, 8);
+	}
 
 	return &this->public;
 }
@@ -195,36 +195,41 @@ static bool event_cb(entry_t *entry, bool up, host_t *vip, host_t *other,
 }
 
 /**
- * Callback function for queries
+ * Context collecting batched query responses
  */
-static bool query_cb(stream_t *stream, bool up, host_t *vip, host_t *other,
+typedef struct {
+	/** batched responses */
+	lookip_response_t *buf;
+	/** number of responses collected */
+	int count;
+	/** allocated response slots */
+	int size;
+} query_ctx_t;
+
+/**
+ * Callback function for queries, collects responses for a single write
+ */
+static bool query_cb(query_ctx_t *ctx, bool up, host_t *vip, host_t *other,
 					 identification_t *id, char *name, u_int unique_id)
 {
-	lookip_response_t resp = {
+	lookip_response_t *resp;
+
+	if (ctx->count == ctx->size)
+	{
+		ctx->size = max(ctx->size * 2, 8);
+		ctx->buf = realloc(ctx->buf, ctx->size * sizeof(*ctx->buf));
+	}
+	resp = &ctx->buf[ctx->count++];
+	*resp = (lookip_response_t){
 		.type = htonl(LOOKIP_ENTRY),
 		.unique_id = htonl(unique_id),
 	};
+	snprintf(resp->vip, sizeof(resp->vip), "%H", vip);
+	snprintf(resp->ip, sizeof(resp->ip), "%H", other);
+	snprintf(resp->id, sizeof(resp->id), "%Y", id);
+	snprintf(resp->name, sizeof(resp->name), "%s", name);
 
-	snprintf(resp.vip, sizeof(resp.vip), "%H", vip);
-	snprintf(resp.ip, sizeof(resp.ip), "%H", other);
-	snprintf(resp.id, sizeof(resp.id), "%Y", id);
-	snprintf(resp.name, sizeof(resp.name), "%s", name);
-
-	if (stream->write_all(stream, &resp, sizeof(resp)))
-	{
-		return TRUE;
-	}
-	switch (errno)
-	{
-		case ECONNRESET:
-		case EPIPE:
-			/* client disconnected, adios */
-			break;
-		default:
-			DBG1(DBG_CFG, "sending lookip response failed: %s", strerror(errno));
-			break;
-	}
-	return FALSE;
+	return TRUE;
 }
 
 /**
@@ -233,7 +238,7 @@ static bool query_cb(stream_t *stream, bool up, host_t *vip, host_t *other,
 static void query(private_lookip_socket_t *this, stream_t *stream,
 				  lookip_request_t *req)
 {
-
+	query_ctx_t ctx = {};
 	host_t *vip = NULL;
 	int matches = 0;
 
@@ -244,7 +249,7 @@ static void query(private_lookip_socket_t *this, stream_t *stream,
 		if (vip)
 		{
 			matches = this->listener->lookup(this->listener, vip,
-											 (void*)query_cb, stream);
+											 (void*)query_cb, &ctx);
 			vip->destroy(vip);
 		}
 		if (matches == 0)
@@ -264,8 +269,27 @@ static void query(private_lookip_socket_t *this, stream_t *stream,
 	else
 	{	/* dump */
 		this->listener->lookup(this->listener, NULL,
-							   (void*)query_cb, stream);
+							   (void*)query_cb, &ctx);
+	}
+	if (ctx.count)
+	{	/* write all collected responses with a single syscall */
+		if (!stream->write_all(stream, ctx.buf,
+							   ctx.count * sizeof(*ctx.buf)))
+		{
+			switch (errno)
+			{
+				case ECONNRESET:
+				case EPIPE:
+					/* client disconnected, adios */
+					break;
+				default:
+					DBG1(DBG_CFG, "sending lookip response failed: %s",
+						 strerror(errno));
+					break;
+			}
+		}
 	}
+	free(ctx.buf);
 }
 
 /**
@@ -18,6 +18,8 @@
 #include "medsrv_config.h"
 
 #include <daemon.h>
+#include <threading/mutex.h>
+#include <collections/hashtable.h>
 
 typedef struct private_medsrv_config_t private_medsrv_config_t;
 
@@ -50,8 +52,61 @@ struct private_medsrv_config_t {
 	 * default ike config
 	 */
 	ike_cfg_t *ike;
+
+	/**
+	 * cache of resolved peer names, keyed by peer keyid
+	 */
+	hashtable_t *cache;
+
+	/**
+	 * mutex protecting the cache
+	 */
+	mutex_t *mutex;
+
+	/**
+	 * lifetime of cached entries, 0 to disable caching
+	 */
+	time_t ttl;
 };
 
+/**
+ * A cached peer lookup result
+ */
+typedef struct {
+	/** keyid of the peer */
+	chunk_t keyid;
+	/** resolved configuration name */
+	char *name;
+	/** monotonic time this entry expires at */
+	time_t expires;
+} cache_entry_t;
+
+/**
+ * Destroy a cache entry
+ */
+static void cache_entry_destroy(cache_entry_t *entry)
+{
+	chunk_free(&entry->keyid);
+	free(entry->name);
+	free(entry);
+}
+
+/**
+ * Cache hashtable hash function
+ */
+static u_int cache_hash(chunk_t *key)
+{
+	return chunk_hash(*key);
+}
+
+/**
+ * Cache hashtable equals function
+ */
+static bool cache_equals(chunk_t *a, chunk_t *b)
+{
+	return chunk_equals(*a, *b);
+}
+
 METHOD(backend_t, get_peer_cfg_by_name, peer_cfg_t*,
 	private_medsrv_config_t *this, char *name)
 {
@@ -64,48 +119,129 @@ METHOD(backend_t, create_ike_cfg_enumerator, enumerator_t*,
 	return enumerator_create_single(this->ike, NULL);
 }
 
+/**
+ * Build a mediation peer config for a resolved name
+ */
+static peer_cfg_t *build_peer_cfg(private_medsrv_config_t *this, char *name,
+								  identification_t *me, identification_t *other)
+{
+	peer_cfg_t *peer_cfg;
+	auth_cfg_t *auth;
+
+	peer_cfg = peer_cfg_create(
+		name, this->ike->get_ref(this->ike),
+		CERT_NEVER_SEND, UNIQUE_REPLACE,
+		1, this->rekey*60, 0,			/* keytries, rekey, reauth */
+		this->rekey*5, this->rekey*3,	/* jitter, overtime */
+		TRUE, FALSE, TRUE,				/* mobike, aggressive, pull */
+		this->dpd, 0,					/* DPD delay, timeout */
+		TRUE, NULL, NULL);				/* mediation, med by, peer id */
+
+	auth = auth_cfg_create();
+	auth->add(auth, AUTH_RULE_AUTH_CLASS, AUTH_CLASS_PUBKEY);
+	auth->add(auth, AUTH_RULE_IDENTITY, me->clone(me));
+	peer_cfg->add_auth_cfg(peer_cfg, auth, TRUE);
+	auth = auth_cfg_create();
+	auth->add(auth, AUTH_RULE_AUTH_CLASS, AUTH_CLASS_PUBKEY);
+	auth->add(auth, AUTH_RULE_IDENTITY, other->clone(other));
+	peer_cfg->add_auth_cfg(peer_cfg, auth, FALSE);
+
+	return peer_cfg;
+}
+
+/**
+ * Look up a cached peer name, returns an allocated copy
+ */
+static char *cache_get(private_medsrv_config_t *this, chunk_t keyid)
+{
+	cache_entry_t *entry;
+	char *name = NULL;
+
+	this->mutex->lock(this->mutex);
+	entry = this->cache->get(this->cache, &keyid);
+	if (entry)
+	{
+		if (entry->expires > time_monotonic(NULL))
+		{
+			name = strdup(entry->name);
+		}
+		else
+		{	/* expired, force a fresh database lookup */
+			entry = this->cache->remove(this->cache, &keyid);
+			if (entry)
+			{
+				cache_entry_destroy(entry);
+			}
+		}
+	}
+	this->mutex->unlock(this->mutex);
+	return name;
+}
+
+/**
+ * Cache a successfully resolved peer name
+ */
+static void cache_put(private_medsrv_config_t *this, chunk_t keyid, char *name)
+{
+	cache_entry_t *entry;
+
+	INIT(entry,
+		.keyid = chunk_clone(keyid),
+		.name = strdup(name),
+		.expires = time_monotonic(NULL) + this->ttl,
+	);
+	this->mutex->lock(this->mutex);
+	entry = this->cache->put(this->cache, &entry->keyid, entry);
+	this->mutex->unlock(this->mutex);
+	if (entry)
+	{
+		cache_entry_destroy(entry);
+	}
+}
+
 METHOD(backend_t, create_peer_cfg_enumerator, enumerator_t*,
 	private_medsrv_config_t *this, identification_t *me,
 	identification_t *other)
 {
+	peer_cfg_t *peer_cfg;
 	enumerator_t *e;
+	chunk_t keyid;
 
 	if (!me || !other || other->get_type(other) != ID_KEY_ID)
 	{
 		return NULL;
 	}
+	keyid = other->get_encoding(other);
+	if (this->ttl)
+	{
+		char *name;
+
+		name = cache_get(this, keyid);
+		if (name)
+		{
+			peer_cfg = build_peer_cfg(this, name, me, other);
+			free(name);
+			return enumerator_create_single(peer_cfg, (void*)peer_cfg->destroy);
+		}
+	}
 	e = this->db->query(this->db,
 			"SELECT CONCAT(peer.alias, CONCAT('@', user.login)) FROM "
 			"peer JOIN user ON peer.user = user.id "
-			"WHERE peer.keyid = ?", DB_BLOB, other->get_encoding(other),
+			"WHERE peer.keyid = ?", DB_BLOB, keyid,
 			DB_TEXT);
 	if (e)
 	{
-		peer_cfg_t *peer_cfg;
-		auth_cfg_t *auth;
 		char *name;
 
 		if (e->enumerate(e, &name))
 		{
-			peer_cfg = peer_cfg_create(
-				name, this->ike->get_ref(this->ike),
-				CERT_NEVER_SEND, UNIQUE_REPLACE,
-				1, this->rekey*60, 0,			/* keytries, rekey, reauth */
-				this->rekey*5, this->rekey*3,	/* jitter, overtime */
-				TRUE, FALSE, TRUE,				/* mobike, aggressive, pull */
-				this->dpd, 0,					/* DPD delay, timeout */
-				TRUE, NULL, NULL);				/* mediation, med by, peer id */
+			peer_cfg = build_peer_cfg(this, name, me, other);
+			if (this->ttl)
+			{
+				cache_put(this, keyid, name);
+			}
 			e->destroy(e);
 
-			auth = auth_cfg_create();
-			auth->add(auth, AUTH_RULE_AUTH_CLASS, AUTH_CLASS_PUBKEY);
-			auth->add(auth, AUTH_RULE_IDENTITY, me->clone(me));
-			peer_cfg->add_auth_cfg(peer_cfg, auth, TRUE);
-			auth = auth_cfg_create();
-			auth->add(auth, AUTH_RULE_AUTH_CLASS, AUTH_CLASS_PUBKEY);
-			auth->add(auth, AUTH_RULE_IDENTITY, other->clone(other));
-			peer_cfg->add_auth_cfg(peer_cfg, auth, FALSE);
-
 			return enumerator_create_single(peer_cfg, (void*)peer_cfg->destroy);
 		}
 		e->destroy(e);
@@ -116,6 +252,18 @@ METHOD(backend_t, create_peer_cfg_enumerator, enumerator_t*,
 METHOD(medsrv_config_t, destroy, void,
 	private_medsrv_config_t *this)
 {
+	enumerator_t *enumerator;
+	cache_entry_t *entry;
+	chunk_t *keyid;
+
+	enumerator = this->cache->create_enumerator(this->cache);
+	while (enumerator->enumerate(enumerator, &keyid, &entry))
+	{
+		cache_entry_destroy(entry);
+	}
+	enumerator->destroy(enumerator);
+	this->cache->destroy(this->cache);
+	this->mutex->destroy(this->mutex);
 	this->ike->destroy(this->ike);
 	free(this);
 }
@@ -139,6 +287,9 @@ medsrv_config_t *medsrv_config_create(database_t *db)
 		.db = db,
 		.rekey = lib->settings->get_time(lib->settings, "medsrv.rekey", 1200),
 		.dpd = lib->settings->get_time(lib->settings, "medsrv.dpd", 300),
+		.cache = hashtable_create((void*)cache_hash, (void*)cache_equals, 32),
+		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+		.ttl = lib->settings->get_time(lib->settings, "medsrv.cache_ttl", 300),
 		.ike = ike_cfg_create(IKEV2, FALSE, FALSE, "0.0.0.0",
 							  charon->socket->get_port(charon->socket, FALSE),
 							  "0.0.0.0", IKEV2_UDP_PORT,
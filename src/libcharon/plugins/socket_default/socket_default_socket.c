@@ -25,6 +25,7 @@
 /* make sure to use the proper defs on Mac OS X */
 #define __APPLE_USE_RFC_3542
 
+#define _GNU_SOURCE
 #include "socket_default_socket.h"
 
 #include <sys/types.h>
@@ -44,6 +45,7 @@
 #include <hydra.h>
 #include <daemon.h>
 #include <threading/thread.h>
+#include <threading/thread_value.h>
 
 /* these are not defined on some platforms */
 #ifndef SOL_IP
@@ -70,6 +72,18 @@
 static const struct in6_addr in6addr_any = IN6ADDR_ANY_INIT;
 #endif
 
+/* maximum number of datagrams to read per recvmmsg() call */
+#define RECV_BATCH_MAX 32
+
+/* maximum number of SO_REUSEPORT socket groups */
+#define REUSEPORT_GROUPS_MAX 32
+
+/* maximum number of datagrams to write per sendmmsg() call */
+#define SEND_BATCH_MAX 32
+
+/* enough space for IPv4 and IPv6 source address ancillary data */
+#define SEND_ANCILLARY_SPACE 64
+
 typedef struct private_socket_default_socket_t private_socket_default_socket_t;
 
 /**
@@ -146,8 +160,247 @@ struct private_socket_default_socket_t {
 	 * A counter to implement round-robin selection of read sockets
 	 */
 	u_int rr_counter;
+
+#ifdef HAVE_RECVMMSG
+	/**
+	 * Number of datagrams to read per recvmmsg() call, 1 to disable batching
+	 */
+	int batch_size;
+
+	/**
+	 * Per-thread batch state, as receiver() may run in multiple threads
+	 */
+	thread_value_t *batch;
+#endif /* HAVE_RECVMMSG */
+
+#ifdef SO_REUSEPORT
+	/**
+	 * Number of SO_REUSEPORT socket groups, 1 to disable
+	 */
+	int groups;
+
+	/**
+	 * Additional receive socket groups, groups - 1 sets of four sockets
+	 */
+	struct {
+		int ipv4;
+		int ipv4_natt;
+		int ipv6;
+		int ipv6_natt;
+	} *group;
+
+	/**
+	 * Socket group assigned to the calling receiver thread
+	 */
+	thread_value_t *group_sel;
+
+	/**
+	 * Counter to assign socket groups to receiver threads round-robin
+	 */
+	refcount_t group_counter;
+#endif /* SO_REUSEPORT */
 };
 
+#ifdef HAVE_RECVMMSG
+/**
+ * Batch of packets read with a single syscall, drained over several
+ * receiver() calls
+ */
+typedef struct {
+
+	/**
+	 * Packets read in the last batch, but not yet handed out
+	 */
+	packet_t *pkts[RECV_BATCH_MAX];
+
+	/**
+	 * Receive buffers, batch_size * max_packet bytes
+	 */
+	char *bufs;
+
+	/**
+	 * Number of packets in the batch and the next one to hand out
+	 */
+	int count, pos;
+
+} receive_batch_t;
+
+/**
+ * Clean up a thread's batch state when it terminates
+ */
+static void receive_batch_destroy(receive_batch_t *batch)
+{
+	while (batch->pos < batch->count)
+	{
+		batch->pkts[batch->pos]->destroy(batch->pkts[batch->pos]);
+		batch->pos++;
+	}
+	free(batch->bufs);
+	free(batch);
+}
+
+/**
+ * Get the batch state of the calling thread, creating it on first use
+ */
+static receive_batch_t *get_batch(private_socket_default_socket_t *this)
+{
+	receive_batch_t *batch;
+
+	batch = this->batch->get(this->batch);
+	if (!batch)
+	{
+		INIT(batch,
+			.bufs = malloc(this->batch_size * this->max_packet),
+		);
+		this->batch->set(this->batch, batch);
+	}
+	return batch;
+}
+#endif /* HAVE_RECVMMSG */
+
+/**
+ * Read the destination address of a received datagram from ancillary data
+ */
+static host_t *read_destination(struct msghdr *msg, u_int16_t port)
+{
+	struct cmsghdr *cmsgptr;
+	host_t *dest = NULL;
+
+	for (cmsgptr = CMSG_FIRSTHDR(msg); cmsgptr != NULL;
+		 cmsgptr = CMSG_NXTHDR(msg, cmsgptr))
+	{
+		if (cmsgptr->cmsg_len == 0)
+		{
+			DBG1(DBG_NET, "error reading ancillary data");
+			return NULL;
+		}
+
+#ifdef HAVE_IN6_PKTINFO
+		if (cmsgptr->cmsg_level == SOL_IPV6 &&
+			cmsgptr->cmsg_type == IPV6_PKTINFO)
+		{
+			struct in6_pktinfo *pktinfo;
+			pktinfo = (struct in6_pktinfo*)CMSG_DATA(cmsgptr);
+			struct sockaddr_in6 dst;
+
+			memset(&dst, 0, sizeof(dst));
+			memcpy(&dst.sin6_addr, &pktinfo->ipi6_addr, sizeof(dst.sin6_addr));
+			dst.sin6_family = AF_INET6;
+			dst.sin6_port = htons(port);
+			dest = host_create_from_sockaddr((sockaddr_t*)&dst);
+		}
+#endif /* HAVE_IN6_PKTINFO */
+		if (cmsgptr->cmsg_level == SOL_IP &&
+#ifdef IP_PKTINFO
+			cmsgptr->cmsg_type == IP_PKTINFO
+#elif defined(IP_RECVDSTADDR)
+			cmsgptr->cmsg_type == IP_RECVDSTADDR
+#else
+			FALSE
+#endif
+			)
+		{
+			struct in_addr *addr;
+			struct sockaddr_in dst;
+
+#ifdef IP_PKTINFO
+			struct in_pktinfo *pktinfo;
+			pktinfo = (struct in_pktinfo*)CMSG_DATA(cmsgptr);
+			addr = &pktinfo->ipi_addr;
+#elif defined(IP_RECVDSTADDR)
+			addr = (struct in_addr*)CMSG_DATA(cmsgptr);
+#endif
+			memset(&dst, 0, sizeof(dst));
+			memcpy(&dst.sin_addr, addr, sizeof(dst.sin_addr));
+
+			dst.sin_family = AF_INET;
+			dst.sin_port = htons(port);
+			dest = host_create_from_sockaddr((sockaddr_t*)&dst);
+		}
+		if (dest)
+		{
+			break;
+		}
+	}
+	return dest;
+}
+
+#ifdef HAVE_RECVMMSG
+
+/**
+ * Read a batch of datagrams with a single syscall, hand out the first and
+ * queue the others for subsequent receiver() calls
+ */
+static status_t receive_batch(private_socket_default_socket_t *this,
+							  int fd, u_int16_t port, packet_t **packet)
+{
+	struct mmsghdr msgs[this->batch_size];
+	struct iovec iovs[this->batch_size];
+	char ancillary[this->batch_size][64];
+	union {
+		struct sockaddr_in in4;
+		struct sockaddr_in6 in6;
+	} src[this->batch_size];
+	receive_batch_t *batch = get_batch(this);
+	host_t *source, *dest;
+	packet_t *pkt;
+	char *buffer;
+	int i, count;
+
+	memset(msgs, 0, sizeof(msgs));
+	for (i = 0; i < this->batch_size; i++)
+	{
+		iovs[i].iov_base = batch->bufs + i * this->max_packet;
+		iovs[i].iov_len = this->max_packet;
+		msgs[i].msg_hdr.msg_name = &src[i];
+		msgs[i].msg_hdr.msg_namelen = sizeof(src[i]);
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+		msgs[i].msg_hdr.msg_control = ancillary[i];
+		msgs[i].msg_hdr.msg_controllen = sizeof(ancillary[i]);
+	}
+	/* the socket is non-blocking here only in the sense that we don't want
+	 * to wait for a full batch, poll() already reported data */
+	count = recvmmsg(fd, msgs, this->batch_size, MSG_DONTWAIT, NULL);
+	if (count <= 0)
+	{
+		DBG1(DBG_NET, "error reading socket: %s", strerror(errno));
+		return FAILED;
+	}
+	batch->count = batch->pos = 0;
+	for (i = 0; i < count; i++)
+	{
+		buffer = iovs[i].iov_base;
+		if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC)
+		{
+			DBG1(DBG_NET, "receive buffer too small, packet discarded");
+			continue;
+		}
+		DBG3(DBG_NET, "received packet %b", buffer, (int)msgs[i].msg_len);
+		dest = read_destination(&msgs[i].msg_hdr, port);
+		if (dest == NULL)
+		{
+			DBG1(DBG_NET, "error reading IP header");
+			continue;
+		}
+		source = host_create_from_sockaddr((sockaddr_t*)&src[i]);
+		pkt = packet_create();
+		pkt->set_source(pkt, source);
+		pkt->set_destination(pkt, dest);
+		DBG2(DBG_NET, "received packet: from %#H to %#H", source, dest);
+		pkt->set_data(pkt, chunk_clone(chunk_create(buffer, msgs[i].msg_len)));
+		batch->pkts[batch->count++] = pkt;
+	}
+	if (!batch->count)
+	{
+		return FAILED;
+	}
+	*packet = batch->pkts[batch->pos++];
+	return SUCCESS;
+}
+
+#endif /* HAVE_RECVMMSG */
+
 METHOD(socket_t, receiver, status_t,
 	private_socket_default_socket_t *this, packet_t **packet)
 {
@@ -169,6 +422,42 @@ METHOD(socket_t, receiver, status_t,
 		this->port, this->natt, this->port, this->natt,
 	};
 
+#ifdef HAVE_RECVMMSG
+	if (this->batch_size > 1)
+	{
+		receive_batch_t *batch = get_batch(this);
+
+		if (batch->pos < batch->count)
+		{	/* hand out packets read in a previous batch */
+			*packet = batch->pkts[batch->pos++];
+			return SUCCESS;
+		}
+	}
+#endif
+
+#ifdef SO_REUSEPORT
+	if (this->groups > 1)
+	{
+		uintptr_t sel;
+		int group;
+
+		sel = (uintptr_t)this->group_sel->get(this->group_sel);
+		if (!sel)
+		{	/* assign receiver threads to socket groups round-robin */
+			sel = ref_get(&this->group_counter);
+			this->group_sel->set(this->group_sel, (void*)sel);
+		}
+		group = (sel - 1) % this->groups;
+		if (group > 0)
+		{
+			pfd[0].fd = this->group[group - 1].ipv4;
+			pfd[1].fd = this->group[group - 1].ipv4_natt;
+			pfd[2].fd = this->group[group - 1].ipv6;
+			pfd[3].fd = this->group[group - 1].ipv6_natt;
+		}
+	}
+#endif
+
 	DBG2(DBG_NET, "waiting for data on sockets");
 	oldstate = thread_cancelability(TRUE);
 	if (poll(pfd, countof(pfd), -1) <= 0)
@@ -194,7 +483,6 @@ METHOD(socket_t, receiver, status_t,
 	if (selected != -1)
 	{
 		struct msghdr msg;
-		struct cmsghdr *cmsgptr;
 		struct iovec iov;
 		char ancillary[64];
 		union {
@@ -202,6 +490,13 @@ METHOD(socket_t, receiver, status_t,
 			struct sockaddr_in6 in6;
 		} src;
 
+#ifdef HAVE_RECVMMSG
+		if (this->batch_size > 1)
+		{
+			return receive_batch(this, selected, port, packet);
+		}
+#endif
+
 		msg.msg_name = &src;
 		msg.msg_namelen = sizeof(src);
 		iov.iov_base = buffer;
@@ -225,62 +520,7 @@ METHOD(socket_t, receiver, status_t,
 		DBG3(DBG_NET, "received packet %b", buffer, bytes_read);
 
 		/* read ancillary data to get destination address */
-		for (cmsgptr = CMSG_FIRSTHDR(&msg); cmsgptr != NULL;
-			 cmsgptr = CMSG_NXTHDR(&msg, cmsgptr))
-		{
-			if (cmsgptr->cmsg_len == 0)
-			{
-				DBG1(DBG_NET, "error reading ancillary data");
-				return FAILED;
-			}
-
-#ifdef HAVE_IN6_PKTINFO
-			if (cmsgptr->cmsg_level == SOL_IPV6 &&
-				cmsgptr->cmsg_type == IPV6_PKTINFO)
-			{
-				struct in6_pktinfo *pktinfo;
-				pktinfo = (struct in6_pktinfo*)CMSG_DATA(cmsgptr);
-				struct sockaddr_in6 dst;
-
-				memset(&dst, 0, sizeof(dst));
-				memcpy(&dst.sin6_addr, &pktinfo->ipi6_addr, sizeof(dst.sin6_addr));
-				dst.sin6_family = AF_INET6;
-				dst.sin6_port = htons(port);
-				dest = host_create_from_sockaddr((sockaddr_t*)&dst);
-			}
-#endif /* HAVE_IN6_PKTINFO */
-			if (cmsgptr->cmsg_level == SOL_IP &&
-#ifdef IP_PKTINFO
-				cmsgptr->cmsg_type == IP_PKTINFO
-#elif defined(IP_RECVDSTADDR)
-				cmsgptr->cmsg_type == IP_RECVDSTADDR
-#else
-				FALSE
-#endif
-				)
-			{
-				struct in_addr *addr;
-				struct sockaddr_in dst;
-
-#ifdef IP_PKTINFO
-				struct in_pktinfo *pktinfo;
-				pktinfo = (struct in_pktinfo*)CMSG_DATA(cmsgptr);
-				addr = &pktinfo->ipi_addr;
-#elif defined(IP_RECVDSTADDR)
-				addr = (struct in_addr*)CMSG_DATA(cmsgptr);
-#endif
-				memset(&dst, 0, sizeof(dst));
-				memcpy(&dst.sin_addr, addr, sizeof(dst.sin_addr));
-
-				dst.sin_family = AF_INET;
-				dst.sin_port = htons(port);
-				dest = host_create_from_sockaddr((sockaddr_t*)&dst);
-			}
-			if (dest)
-			{
-				break;
-			}
-		}
+		dest = read_destination(&msg, port);
 		if (dest == NULL)
 		{
 			DBG1(DBG_NET, "error reading IP header");
@@ -305,25 +545,17 @@ METHOD(socket_t, receiver, status_t,
 	return SUCCESS;
 }
 
-METHOD(socket_t, sender, status_t,
-	private_socket_default_socket_t *this, packet_t *packet)
+/**
+ * Select the socket to send a packet over, returns -1 if none matches
+ */
+static int select_socket(private_socket_default_socket_t *this,
+						 packet_t *packet, u_int8_t **dscp)
 {
-	int sport, skt = -1, family;
-	ssize_t bytes_sent;
-	chunk_t data;
+	int sport, family, skt = -1;
 	host_t *src, *dst;
-	struct msghdr msg;
-	struct cmsghdr *cmsg;
-	struct iovec iov;
-	u_int8_t *dscp;
 
 	src = packet->get_source(packet);
 	dst = packet->get_destination(packet);
-	data = packet->get_data(packet);
-
-	DBG2(DBG_NET, "sending packet: from %#H to %#H", src, dst);
-
-	/* send data */
 	sport = src->get_port(src);
 	family = dst->get_family(dst);
 	if (sport == 0 || sport == this->port)
@@ -332,14 +564,14 @@ METHOD(socket_t, sender, status_t,
 		{
 			case AF_INET:
 				skt = this->ipv4;
-				dscp = &this->dscp4;
+				*dscp = &this->dscp4;
 				break;
 			case AF_INET6:
 				skt = this->ipv6;
-				dscp = &this->dscp6;
+				*dscp = &this->dscp6;
 				break;
 			default:
-				return FAILED;
+				return -1;
 		}
 	}
 	else if (sport == this->natt)
@@ -348,93 +580,118 @@ METHOD(socket_t, sender, status_t,
 		{
 			case AF_INET:
 				skt = this->ipv4_natt;
-				dscp = &this->dscp4_natt;
+				*dscp = &this->dscp4_natt;
 				break;
 			case AF_INET6:
 				skt = this->ipv6_natt;
-				dscp = &this->dscp6_natt;
+				*dscp = &this->dscp6_natt;
 				break;
 			default:
-				return FAILED;
+				return -1;
 		}
 	}
 	if (skt == -1)
 	{
 		DBG1(DBG_NET, "no socket found to send IPv%d packet from port %d",
 			 family == AF_INET ? 4 : 6, sport);
-		return FAILED;
 	}
+	return skt;
+}
+
+/**
+ * Update the DSCP value on a socket, if it changed.
+ *
+ * Setting DSCP values per-packet in a cmsg seems not to be supported
+ * on Linux. We instead setsockopt() before sending it, this should be
+ * safe as only a single thread calls send().
+ */
+static void apply_dscp(packet_t *packet, int skt, u_int8_t *dscp)
+{
+	host_t *dst;
 
-	/* setting DSCP values per-packet in a cmsg seems not to be supported
-	 * on Linux. We instead setsockopt() before sending it, this should be
-	 * safe as only a single thread calls send(). */
-	if (*dscp != packet->get_dscp(packet))
+	if (*dscp == packet->get_dscp(packet))
 	{
-		if (family == AF_INET)
-		{
-			u_int8_t ds4;
+		return;
+	}
+	dst = packet->get_destination(packet);
+	if (dst->get_family(dst) == AF_INET)
+	{
+		u_int8_t ds4;
 
-			ds4 = packet->get_dscp(packet) << 2;
-			if (setsockopt(skt, SOL_IP, IP_TOS, &ds4, sizeof(ds4)) == 0)
-			{
-				*dscp = packet->get_dscp(packet);
-			}
-			else
-			{
-				DBG1(DBG_NET, "unable to set IP_TOS on socket: %s",
-					 strerror(errno));
-			}
+		ds4 = packet->get_dscp(packet) << 2;
+		if (setsockopt(skt, SOL_IP, IP_TOS, &ds4, sizeof(ds4)) == 0)
+		{
+			*dscp = packet->get_dscp(packet);
 		}
 		else
 		{
-			u_int ds6;
+			DBG1(DBG_NET, "unable to set IP_TOS on socket: %s",
+				 strerror(errno));
+		}
+	}
+	else
+	{
+		u_int ds6;
 
-			ds6 = packet->get_dscp(packet) << 2;
-			if (setsockopt(skt, SOL_IPV6, IPV6_TCLASS, &ds6, sizeof(ds6)) == 0)
-			{
-				*dscp = packet->get_dscp(packet);
-			}
-			else
-			{
-				DBG1(DBG_NET, "unable to set IPV6_TCLASS on socket: %s",
-					 strerror(errno));
-			}
+		ds6 = packet->get_dscp(packet) << 2;
+		if (setsockopt(skt, SOL_IPV6, IPV6_TCLASS, &ds6, sizeof(ds6)) == 0)
+		{
+			*dscp = packet->get_dscp(packet);
+		}
+		else
+		{
+			DBG1(DBG_NET, "unable to set IPV6_TCLASS on socket: %s",
+				 strerror(errno));
 		}
 	}
+}
 
-	memset(&msg, 0, sizeof(struct msghdr));
-	msg.msg_name = dst->get_sockaddr(dst);;
-	msg.msg_namelen = *dst->get_sockaddr_len(dst);
-	iov.iov_base = data.ptr;
-	iov.iov_len = data.len;
-	msg.msg_iov = &iov;
-	msg.msg_iovlen = 1;
-	msg.msg_flags = 0;
+/**
+ * Prepare the message header for a packet, using the given iovec and
+ * ancillary data buffer of SEND_ANCILLARY_SPACE bytes
+ */
+static void prepare_msg(private_socket_default_socket_t *this,
+						packet_t *packet, struct msghdr *msg,
+						struct iovec *iov, char *cbuf)
+{
+	struct cmsghdr *cmsg;
+	host_t *src, *dst;
+	chunk_t data;
+
+	src = packet->get_source(packet);
+	dst = packet->get_destination(packet);
+	data = packet->get_data(packet);
+
+	memset(msg, 0, sizeof(struct msghdr));
+	msg->msg_name = dst->get_sockaddr(dst);
+	msg->msg_namelen = *dst->get_sockaddr_len(dst);
+	iov->iov_base = data.ptr;
+	iov->iov_len = data.len;
+	msg->msg_iov = iov;
+	msg->msg_iovlen = 1;
 
 	if (this->set_source && !src->is_anyaddr(src))
 	{
-		if (family == AF_INET)
+		if (dst->get_family(dst) == AF_INET)
 		{
 #if defined(IP_PKTINFO) || defined(IP_SENDSRCADDR)
 			struct in_addr *addr;
 			struct sockaddr_in *sin;
 #ifdef IP_PKTINFO
-			char buf[CMSG_SPACE(sizeof(struct in_pktinfo))];
 			struct in_pktinfo *pktinfo;
-#elif defined(IP_SENDSRCADDR)
-			char buf[CMSG_SPACE(sizeof(struct in_addr))];
 #endif
-			memset(buf, 0, sizeof(buf));
-			msg.msg_control = buf;
-			msg.msg_controllen = sizeof(buf);
-			cmsg = CMSG_FIRSTHDR(&msg);
+			memset(cbuf, 0, SEND_ANCILLARY_SPACE);
+			msg->msg_control = cbuf;
+			cmsg = (struct cmsghdr*)cbuf;
 			cmsg->cmsg_level = SOL_IP;
 #ifdef IP_PKTINFO
+			msg->msg_controllen = CMSG_SPACE(sizeof(struct in_pktinfo));
 			cmsg->cmsg_type = IP_PKTINFO;
 			cmsg->cmsg_len = CMSG_LEN(sizeof(struct in_pktinfo));
 			pktinfo = (struct in_pktinfo*)CMSG_DATA(cmsg);
 			addr = &pktinfo->ipi_spec_dst;
 #elif defined(IP_SENDSRCADDR)
+			msg->msg_controllen = CMSG_SPACE(sizeof(struct in_addr));
 			cmsg->cmsg_type = IP_SENDSRCADDR;
 			cmsg->cmsg_len = CMSG_LEN(sizeof(struct in_addr));
 			addr = (struct in_addr*)CMSG_DATA(cmsg);
@@ -446,14 +703,13 @@ METHOD(socket_t, sender, status_t,
 #ifdef HAVE_IN6_PKTINFO
 		else
 		{
-			char buf[CMSG_SPACE(sizeof(struct in6_pktinfo))];
 			struct in6_pktinfo *pktinfo;
 			struct sockaddr_in6 *sin;
 
-			memset(buf, 0, sizeof(buf));
-			msg.msg_control = buf;
-			msg.msg_controllen = sizeof(buf);
-			cmsg = CMSG_FIRSTHDR(&msg);
+			memset(cbuf, 0, SEND_ANCILLARY_SPACE);
+			msg->msg_control = cbuf;
+			msg->msg_controllen = CMSG_SPACE(sizeof(struct in6_pktinfo));
+			cmsg = (struct cmsghdr*)cbuf;
 			cmsg->cmsg_level = SOL_IPV6;
 			cmsg->cmsg_type = IPV6_PKTINFO;
 			cmsg->cmsg_len = CMSG_LEN(sizeof(struct in6_pktinfo));
@@ -463,6 +719,33 @@ METHOD(socket_t, sender, status_t,
 		}
 #endif /* HAVE_IN6_PKTINFO */
 	}
+}
+
+METHOD(socket_t, sender, status_t,
+	private_socket_default_socket_t *this, packet_t *packet)
+{
+	char cbuf[SEND_ANCILLARY_SPACE];
+	struct msghdr msg;
+	struct iovec iov;
+	u_int8_t *dscp;
+	ssize_t bytes_sent;
+	chunk_t data;
+	host_t *src, *dst;
+	int skt;
+
+	src = packet->get_source(packet);
+	dst = packet->get_destination(packet);
+	data = packet->get_data(packet);
+
+	DBG2(DBG_NET, "sending packet: from %#H to %#H", src, dst);
+
+	skt = select_socket(this, packet, &dscp);
+	if (skt == -1)
+	{
+		return FAILED;
+	}
+	apply_dscp(packet, skt, dscp);
+	prepare_msg(this, packet, &msg, &iov, cbuf);
 
 	bytes_sent = sendmsg(skt, &msg, 0);
 
@@ -474,6 +757,80 @@ METHOD(socket_t, sender, status_t,
 	return SUCCESS;
 }
 
+#ifdef HAVE_SENDMMSG
+
+/**
+ * Send a group of prepared messages over the same socket
+ */
+static status_t send_msgs(int skt, struct mmsghdr *msgs, int n)
+{
+	int sent = 0, res;
+
+	while (sent < n)
+	{
+		res = sendmmsg(skt, msgs + sent, n - sent, 0);
+		if (res < 0)
+		{
+			DBG1(DBG_NET, "error writing to socket: %s", strerror(errno));
+			return FAILED;
+		}
+		sent += res;
+	}
+	return SUCCESS;
+}
+
+METHOD(socket_t, sender_batch, status_t,
+	private_socket_default_socket_t *this, packet_t **packets, int count)
+{
+	struct mmsghdr msgs[SEND_BATCH_MAX];
+	struct iovec iovs[SEND_BATCH_MAX];
+	char cbufs[SEND_BATCH_MAX][SEND_ANCILLARY_SPACE];
+	status_t status = SUCCESS;
+	packet_t *packet;
+	host_t *src, *dst;
+	u_int8_t *dscp;
+	int i, n = 0, skt, current = -1;
+
+	for (i = 0; i < count; i++)
+	{
+		packet = packets[i];
+		src = packet->get_source(packet);
+		dst = packet->get_destination(packet);
+		DBG2(DBG_NET, "sending packet: from %#H to %#H", src, dst);
+
+		skt = select_socket(this, packet, &dscp);
+		if (skt == -1)
+		{
+			status = FAILED;
+			continue;
+		}
+		/* coalesce consecutive packets over the same socket, but flush
+		 * queued messages before switching sockets, changing the DSCP
+		 * value or overflowing the message headers */
+		if (n && (skt != current || *dscp != packet->get_dscp(packet) ||
+				  n == SEND_BATCH_MAX))
+		{
+			if (send_msgs(current, msgs, n) != SUCCESS)
+			{
+				status = FAILED;
+			}
+			n = 0;
+		}
+		apply_dscp(packet, skt, dscp);
+		current = skt;
+		memset(&msgs[n], 0, sizeof(msgs[n]));
+		prepare_msg(this, packet, &msgs[n].msg_hdr, &iovs[n], cbufs[n]);
+		n++;
+	}
+	if (n && send_msgs(current, msgs, n) != SUCCESS)
+	{
+		status = FAILED;
+	}
+	return status;
+}
+
+#endif /* HAVE_SENDMMSG */
+
 METHOD(socket_t, get_port, u_int16_t,
 	private_socket_default_socket_t *this, bool nat_t)
 {
@@ -551,6 +908,16 @@ static int open_socket(private_socket_default_socket_t *this,
 		close(skt);
 		return -1;
 	}
+#ifdef SO_REUSEPORT
+	if (this->groups > 1 &&
+		setsockopt(skt, SOL_SOCKET, SO_REUSEPORT, (void*)&on, sizeof(on)) < 0)
+	{
+		DBG1(DBG_NET, "unable to set SO_REUSEPORT on socket: %s",
+			 strerror(errno));
+		close(skt);
+		return -1;
+	}
+#endif
 
 	/* bind the socket */
 	if (bind(skt, &addr.sockaddr, addrlen) < 0)
@@ -693,6 +1060,29 @@ METHOD(socket_t, destroy, void,
 	{
 		close(this->ipv6_natt);
 	}
+#ifdef HAVE_RECVMMSG
+	DESTROY_IF(this->batch);
+#endif
+#ifdef SO_REUSEPORT
+	if (this->groups > 1)
+	{
+		int i, *skts;
+
+		for (i = 0; i < this->groups - 1; i++)
+		{
+			for (skts = &this->group[i].ipv4;
+				 skts <= &this->group[i].ipv6_natt; skts++)
+			{
+				if (*skts != -1)
+				{
+					close(*skts);
+				}
+			}
+		}
+		free(this->group);
+		this->group_sel->destroy(this->group_sel);
+	}
+#endif
 	free(this);
 }
 
@@ -724,6 +1114,27 @@ socket_default_socket_t *socket_default_socket_create()
 							lib->ns),
 	);
 
+#ifdef HAVE_SENDMMSG
+	this->public.socket.send_batch = _sender_batch;
+#endif
+
+#ifdef HAVE_RECVMMSG
+	this->batch_size = max(1, min(lib->settings->get_int(lib->settings,
+							"%s.plugins.socket-default.batch_size", 1,
+							lib->ns), RECV_BATCH_MAX));
+	if (this->batch_size > 1)
+	{
+		this->batch = thread_value_create(
+								(thread_cleanup_t)receive_batch_destroy);
+	}
+#endif
+
+#ifdef SO_REUSEPORT
+	this->groups = max(1, min(lib->settings->get_int(lib->settings,
+							"%s.plugins.socket-default.reuseport_groups", 1,
+							lib->ns), REUSEPORT_GROUPS_MAX));
+#endif
+
 	if (this->port && this->port == this->natt)
 	{
 		DBG1(DBG_NET, "IKE ports can't be equal, will allocate NAT-T "
@@ -754,6 +1165,25 @@ socket_default_socket_t *socket_default_socket_create()
 	open_socketpair(this, AF_INET, &this->ipv4, &this->ipv4_natt, "IPv4");
 #endif /* __APPLE__ */
 
+#ifdef SO_REUSEPORT
+	if (this->groups > 1)
+	{
+		int i;
+
+		/* open additional socket groups on the same ports, the kernel
+		 * distributes inbound datagrams among them */
+		this->group = calloc(this->groups - 1, sizeof(*this->group));
+		for (i = 0; i < this->groups - 1; i++)
+		{
+			open_socketpair(this, AF_INET6, &this->group[i].ipv6,
+							&this->group[i].ipv6_natt, "IPv6");
+			open_socketpair(this, AF_INET, &this->group[i].ipv4,
+							&this->group[i].ipv4_natt, "IPv4");
+		}
+		this->group_sel = thread_value_create(NULL);
+	}
+#endif
+
 	if (this->ipv4 == -1 && this->ipv6 == -1)
 	{
 		DBG1(DBG_NET, "could not create any sockets");
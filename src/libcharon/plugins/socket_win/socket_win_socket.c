@@ -28,6 +28,9 @@
 /* number of sockets in use */
 #define SOCKET_COUNT 2
 
+/* number of overlapped receives kept posted per socket */
+#define RECV_POOL 8
+
 /* missing on MinGW */
 #ifndef IPV6_V6ONLY
 # define IPV6_V6ONLY 27
@@ -38,6 +41,48 @@ static GUID WSARecvMsgGUID = WSAID_WSARECVMSG;
 static GUID WSASendMsgGUID = WSAID_WSASENDMSG;
 
 typedef struct private_socket_win_socket_t private_socket_win_socket_t;
+typedef struct recv_ctx_t recv_ctx_t;
+
+/**
+ * State of a single pre-posted overlapped receive
+ */
+struct recv_ctx_t {
+
+	/**
+	 * Overlapped control block, must be first
+	 */
+	WSAOVERLAPPED ov;
+
+	/**
+	 * Index of the socket the receive is posted on
+	 */
+	int index;
+
+	/**
+	 * Message header of the pending receive
+	 */
+	WSAMSG msg;
+
+	/**
+	 * Data buffer descriptor, pointing to buf
+	 */
+	WSABUF data;
+
+	/**
+	 * Source address of the received packet
+	 */
+	SOCKADDR_IN6 addr;
+
+	/**
+	 * Control message buffer
+	 */
+	char cbuf[128];
+
+	/**
+	 * Receive buffer, max_packet bytes
+	 */
+	char *buf;
+};
 
 /**
  * Private data of an socket_t object
@@ -60,9 +105,34 @@ struct private_socket_win_socket_t {
 	SOCKET socks[SOCKET_COUNT];
 
 	/**
-	 * Events to wait for socket data
+	 * I/O completion port both sockets are associated to
 	 */
-	HANDLE events[SOCKET_COUNT];
+	HANDLE iocp;
+
+	/**
+	 * Pool of pre-posted overlapped receives
+	 */
+	recv_ctx_t *recvs[SOCKET_COUNT * RECV_POOL];
+
+	/**
+	 * Completions dequeued in a batch, not yet processed
+	 */
+	OVERLAPPED_ENTRY entries[SOCKET_COUNT * RECV_POOL];
+
+	/**
+	 * Number of valid completions in entries
+	 */
+	ULONG count;
+
+	/**
+	 * Index of the next completion to process
+	 */
+	ULONG next;
+
+	/**
+	 * Number of currently outstanding overlapped receives
+	 */
+	u_int posted;
 
 	/**
 	 * Maximum packet size to receive
@@ -82,47 +152,85 @@ struct private_socket_win_socket_t {
 					LPWSAOVERLAPPED, LPWSAOVERLAPPED_COMPLETION_ROUTINE);
 };
 
+/**
+ * (Re-)post an overlapped receive for a pool entry
+ */
+static bool post_recv(private_socket_win_socket_t *this, recv_ctx_t *ctx)
+{
+	memset(&ctx->ov, 0, sizeof(ctx->ov));
+	ctx->data.buf = ctx->buf;
+	ctx->data.len = this->max_packet;
+	memset(&ctx->msg, 0, sizeof(ctx->msg));
+	ctx->msg.name = (struct sockaddr*)&ctx->addr;
+	ctx->msg.namelen = sizeof(ctx->addr);
+	ctx->msg.lpBuffers = &ctx->data;
+	ctx->msg.dwBufferCount = 1;
+	ctx->msg.Control.buf = ctx->cbuf;
+	ctx->msg.Control.len = sizeof(ctx->cbuf);
+
+	while (this->WSARecvMsg(this->socks[ctx->index], &ctx->msg, NULL,
+							&ctx->ov, NULL) == SOCKET_ERROR)
+	{
+		switch (WSAGetLastError())
+		{
+			case WSA_IO_PENDING:
+				this->posted++;
+				return TRUE;
+			case WSAECONNRESET:
+				/* ignore WSAECONNRESET; this is returned for any ICMP port
+				 * unreachable, for a packet we sent, but is most likely not
+				 * related to the packet we try to receive. */
+				continue;
+			default:
+				DBG1(DBG_NET, "posting receive on socket failed: %d",
+					 WSAGetLastError());
+				return FALSE;
+		}
+	}
+	/* completed synchronously, the completion gets queued to the port */
+	this->posted++;
+	return TRUE;
+}
+
 METHOD(socket_t, receiver, status_t,
 	private_socket_win_socket_t *this, packet_t **out)
 {
-	char buf[this->max_packet], cbuf[128];
-	bool old;
-	DWORD i, len, err;
-	WSAMSG msg;
-	WSABUF data;
+	recv_ctx_t *ctx;
+	bool old, ok;
+	DWORD len, flags, err;
 	WSACMSGHDR *cmsg;
-	SOCKADDR_IN6 addr;
 	host_t *src = NULL, *dst = NULL;
 	packet_t *pkt;
 
-	data.buf = buf;
-	data.len = sizeof(buf);
-
-	memset(&msg, 0, sizeof(msg));
-	msg.name = (struct sockaddr*)&addr;
-	msg.namelen = sizeof(addr);
-	msg.lpBuffers = &data;
-	msg.dwBufferCount = 1;
-	msg.Control.buf = cbuf;
-	msg.Control.len = sizeof(cbuf);
-
-	/* wait for socket events */
-	old = thread_cancelability(TRUE);
-	i = WSAWaitForMultipleEvents(SOCKET_COUNT, this->events,
-								 FALSE, INFINITE, TRUE);
-	thread_cancelability(old);
-	if (i < WSA_WAIT_EVENT_0 || i >= WSA_WAIT_EVENT_0 + SOCKET_COUNT)
+	/* dequeue completions in batches, processing one per invocation */
+	while (this->next == this->count)
 	{
-		DBG1(DBG_NET, "waiting on sockets failed: %d", WSAGetLastError());
-		return FAILED;
+		ULONG count;
+
+		this->next = this->count = 0;
+		old = thread_cancelability(TRUE);
+		ok = GetQueuedCompletionStatusEx(this->iocp, this->entries,
+									countof(this->entries), &count,
+									INFINITE, TRUE);
+		thread_cancelability(old);
+		if (!ok)
+		{
+			if (GetLastError() == WAIT_IO_COMPLETION)
+			{	/* interrupted by an APC, recheck */
+				continue;
+			}
+			DBG1(DBG_NET, "waiting on completion port failed: %d",
+				 GetLastError());
+			return FAILED;
+		}
+		this->count = count;
 	}
-	i -= WSA_WAIT_EVENT_0;
-
-	/* WSAEvents must be reset manually */
-	WSAResetEvent(this->events[i]);
+	ctx = (recv_ctx_t*)this->entries[this->next++].lpOverlapped;
+	this->posted--;
 
-	if (this->WSARecvMsg(this->socks[i], &msg, &len,
-						 NULL, NULL) == SOCKET_ERROR)
+	flags = 0;
+	if (!WSAGetOverlappedResult(this->socks[ctx->index], &ctx->ov, &len,
+								FALSE, &flags))
 	{
 		err = WSAGetLastError();
 		/* ignore WSAECONNRESET; this is returned for any ICMP port unreachable,
@@ -130,15 +238,16 @@ METHOD(socket_t, receiver, status_t,
 		 * we try to receive. */
 		if (err != WSAECONNRESET)
 		{
-			DBG1(DBG_NET, "reading from socket failed: %d", WSAGetLastError());
+			DBG1(DBG_NET, "reading from socket failed: %d", err);
 		}
+		post_recv(this, ctx);
 		return FAILED;
 	}
 
-	DBG3(DBG_NET, "received packet %b", buf, (int)len);
+	DBG3(DBG_NET, "received packet %b", ctx->buf, (int)len);
 
-	for (cmsg = WSA_CMSG_FIRSTHDR(&msg); dst == NULL && cmsg != NULL;
-		 cmsg = WSA_CMSG_NXTHDR(&msg, cmsg))
+	for (cmsg = WSA_CMSG_FIRSTHDR(&ctx->msg); dst == NULL && cmsg != NULL;
+		 cmsg = WSA_CMSG_NXTHDR(&ctx->msg, cmsg))
 	{
 		if (cmsg->cmsg_level == IPPROTO_IP &&
 			cmsg->cmsg_type == IP_PKTINFO)
@@ -150,7 +259,7 @@ METHOD(socket_t, receiver, status_t,
 
 			pktinfo = (struct in_pktinfo*)WSA_CMSG_DATA(cmsg);
 			sin.sin_addr = pktinfo->ipi_addr;
-			sin.sin_port = htons(this->ports[i]);
+			sin.sin_port = htons(this->ports[ctx->index]);
 			dst = host_create_from_sockaddr((struct sockaddr*)&sin);
 		}
 		if (cmsg->cmsg_level == IPPROTO_IPV6 &&
@@ -163,7 +272,7 @@ METHOD(socket_t, receiver, status_t,
 
 			pktinfo = (struct in6_pktinfo*)WSA_CMSG_DATA(cmsg);
 			sin.sin6_addr = pktinfo->ipi6_addr;
-			sin.sin6_port = htons(this->ports[i]);
+			sin.sin6_port = htons(this->ports[ctx->index]);
 			dst = host_create_from_sockaddr((struct sockaddr*)&sin);
 		}
 	}
@@ -171,25 +280,27 @@ METHOD(socket_t, receiver, status_t,
 	if (!dst)
 	{
 		DBG1(DBG_NET, "receiving IP destination address failed");
+		post_recv(this, ctx);
 		return FAILED;
 	}
 
 	switch (dst->get_family(dst))
 	{
 		case AF_INET6:
-			src = host_create_from_sockaddr((struct sockaddr*)&addr);
+			src = host_create_from_sockaddr((struct sockaddr*)&ctx->addr);
 			break;
 		case AF_INET:
 			/* extract v4 address from mapped v6 */
 			src = host_create_from_chunk(AF_INET,
-								chunk_create(addr.sin6_addr.u.Byte + 12, 4),
-								ntohs(addr.sin6_port));
+							chunk_create(ctx->addr.sin6_addr.u.Byte + 12, 4),
+							ntohs(ctx->addr.sin6_port));
 			break;
 	}
 	if (!src)
 	{
 		DBG1(DBG_NET, "receiving IP source address failed");
 		dst->destroy(dst);
+		post_recv(this, ctx);
 		return FAILED;
 	}
 
@@ -197,7 +308,9 @@ METHOD(socket_t, receiver, status_t,
 	pkt->set_source(pkt, src);
 	pkt->set_destination(pkt, dst);
 	DBG2(DBG_NET, "received packet: from %#H to %#H", src, dst);
-	pkt->set_data(pkt, chunk_clone(chunk_create(buf, len)));
+	pkt->set_data(pkt, chunk_clone(chunk_create(ctx->buf, len)));
+
+	post_recv(this, ctx);
 
 	*out = pkt;
 	return SUCCESS;
@@ -421,9 +534,28 @@ METHOD(socket_t, destroy, void,
 		{
 			closesocket(this->socks[i]);
 		}
-		if (this->events[i] != WSA_INVALID_EVENT)
+	}
+	if (this->iocp)
+	{
+		ULONG count;
+
+		/* reap completions of aborted receives before freeing their buffers */
+		this->posted -= min(this->posted, this->count - this->next);
+		while (this->posted &&
+			   GetQueuedCompletionStatusEx(this->iocp, this->entries,
+										   countof(this->entries), &count,
+										   100, FALSE))
+		{
+			this->posted -= min(this->posted, count);
+		}
+		CloseHandle(this->iocp);
+	}
+	for (i = 0; i < countof(this->recvs); i++)
+	{
+		if (this->recvs[i])
 		{
-			WSACloseEvent(this->events[i]);
+			free(this->recvs[i]->buf);
+			free(this->recvs[i]);
 		}
 	}
 	free(this);
@@ -461,25 +593,12 @@ socket_win_socket_t *socket_win_socket_create()
 	for (i = 0; i < SOCKET_COUNT; i++)
 	{
 		this->socks[i] = open_socket(this, i);
-		this->events[i] = WSACreateEvent();
-	}
-
-	for (i = 0; i < SOCKET_COUNT; i++)
-	{
-		if (this->events[i] == WSA_INVALID_EVENT ||
-			this->socks[i] == INVALID_SOCKET)
+		if (this->socks[i] == INVALID_SOCKET)
 		{
 			DBG1(DBG_NET, "creating socket failed: %d", WSAGetLastError());
 			destroy(this);
 			return NULL;
 		}
-		if (WSAEventSelect(this->socks[i], this->events[i],
-						   FD_READ) == SOCKET_ERROR)
-		{
-			DBG1(DBG_NET, "WSAEventSelect() failed: %d", WSAGetLastError());
-			destroy(this);
-			return NULL;
-		}
 	}
 
 	if (WSAIoctl(this->socks[0], SIO_GET_EXTENSION_FUNCTION_POINTER,
@@ -494,5 +613,38 @@ socket_win_socket_t *socket_win_socket_create()
 		return NULL;
 	}
 
+	this->iocp = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+	if (!this->iocp)
+	{
+		DBG1(DBG_NET, "creating completion port failed: %d", GetLastError());
+		destroy(this);
+		return NULL;
+	}
+	for (i = 0; i < SOCKET_COUNT; i++)
+	{
+		if (!CreateIoCompletionPort((HANDLE)this->socks[i], this->iocp, 0, 0))
+		{
+			DBG1(DBG_NET, "associating socket to completion port failed: %d",
+				 GetLastError());
+			destroy(this);
+			return NULL;
+		}
+	}
+	for (i = 0; i < countof(this->recvs); i++)
+	{
+		recv_ctx_t *ctx;
+
+		INIT(ctx,
+			.index = i % SOCKET_COUNT,
+			.buf = malloc(this->max_packet),
+		);
+		this->recvs[i] = ctx;
+		if (!post_recv(this, ctx))
+		{
+			destroy(this);
+			return NULL;
+		}
+	}
+
 	return &this->public;
 }
@@ -18,7 +18,13 @@
 #include "sql_logger.h"
 
 #include <daemon.h>
+#include <collections/linked_list.h>
+#include <threading/mutex.h>
 #include <threading/thread_value.h>
+#include <processing/jobs/callback_job.h>
+
+/** maximum number of queued entries before flushing inline */
+#define QUEUE_MAX 1000
 
 typedef struct private_sql_logger_t private_sql_logger_t;
 
@@ -46,8 +52,168 @@ struct private_sql_logger_t {
 	 * avoid recursive calls by the same thread
 	 */
 	thread_value_t *recursive;
+
+	/**
+	 * milliseconds to batch entries before flushing, 0 to write directly
+	 */
+	u_int flush_interval;
+
+	/**
+	 * queued entries, as record_t
+	 */
+	linked_list_t *queue;
+
+	/**
+	 * lock for queue
+	 */
+	mutex_t *mutex;
+
+	/**
+	 * TRUE if a flush job is scheduled
+	 */
+	bool job_scheduled;
 };
 
+/**
+ * Queued log entry, with copies of all referenced IKE_SA data
+ */
+typedef struct {
+	/** SPI of the local IKE_SA end */
+	chunk_t local_spi;
+	/** SPI of the remote IKE_SA end */
+	chunk_t remote_spi;
+	/** unique IKE_SA identifier */
+	u_int32_t id;
+	/** TRUE if we are the original initiator */
+	bool initiator;
+	/** local identity type and encoding */
+	int local_id_type;
+	chunk_t local_id;
+	/** remote identity type and encoding */
+	int remote_id_type;
+	chunk_t remote_id;
+	/** address family of the IKE endpoints */
+	int family;
+	/** local and remote endpoint addresses */
+	chunk_t local_host;
+	chunk_t remote_host;
+	/** debug group the message was logged under */
+	debug_t group;
+	/** log level of the message */
+	level_t level;
+	/** logged message */
+	char *message;
+} record_t;
+
+/**
+ * Clean up a queued entry
+ */
+static void record_destroy(record_t *record)
+{
+	chunk_free(&record->local_spi);
+	chunk_free(&record->remote_spi);
+	chunk_free(&record->local_id);
+	chunk_free(&record->remote_id);
+	chunk_free(&record->local_host);
+	chunk_free(&record->remote_host);
+	free(record->message);
+	free(record);
+}
+
+/**
+ * Write a single entry to the database
+ */
+static void write_record(private_sql_logger_t *this, record_t *record)
+{
+	this->db->execute(this->db, NULL, "REPLACE INTO ike_sas ("
+					  "local_spi, remote_spi, id, initiator, "
+					  "local_id_type, local_id_data, "
+					  "remote_id_type, remote_id_data, "
+					  "host_family, local_host_data, remote_host_data) "
+					  "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)",
+					  DB_BLOB, record->local_spi, DB_BLOB, record->remote_spi,
+					  DB_INT, record->id,
+					  DB_INT, record->initiator,
+					  DB_INT, record->local_id_type,
+					  DB_BLOB, record->local_id,
+					  DB_INT, record->remote_id_type,
+					  DB_BLOB, record->remote_id,
+					  DB_INT, record->family,
+					  DB_BLOB, record->local_host,
+					  DB_BLOB, record->remote_host);
+	this->db->execute(this->db, NULL, "INSERT INTO logs ("
+					  "local_spi, `signal`, level, msg) "
+					  "VALUES (?, ?, ?, ?)",
+					  DB_BLOB, record->local_spi, DB_INT, record->group,
+					  DB_INT, record->level, DB_TEXT, record->message);
+}
+
+/**
+ * Write a batch of queued entries in a single transaction, owns the queue
+ */
+static void flush_queue(private_sql_logger_t *this, linked_list_t *queue)
+{
+	record_t *record;
+
+	this->recursive->set(this->recursive, this->recursive);
+	this->db->transaction(this->db, FALSE);
+	while (queue->remove_first(queue, (void**)&record) == SUCCESS)
+	{
+		write_record(this, record);
+		record_destroy(record);
+	}
+	this->db->commit(this->db);
+	this->recursive->set(this->recursive, NULL);
+	queue->destroy(queue);
+}
+
+/**
+ * Job flushing the queue after the flush interval expired
+ */
+static job_requeue_t flush_job(private_sql_logger_t *this)
+{
+	linked_list_t *queue;
+
+	this->mutex->lock(this->mutex);
+	queue = this->queue;
+	this->queue = linked_list_create();
+	this->job_scheduled = FALSE;
+	this->mutex->unlock(this->mutex);
+
+	flush_queue(this, queue);
+	return JOB_REQUEUE_NONE;
+}
+
+/**
+ * Queue an entry, scheduling a flush job or flushing inline if full
+ */
+static void queue_record(private_sql_logger_t *this, record_t *record)
+{
+	linked_list_t *queue = NULL;
+
+	this->mutex->lock(this->mutex);
+	this->queue->insert_last(this->queue, record);
+	if (this->queue->get_count(this->queue) >= QUEUE_MAX)
+	{
+		queue = this->queue;
+		this->queue = linked_list_create();
+	}
+	else if (!this->job_scheduled)
+	{
+		this->job_scheduled = TRUE;
+		lib->scheduler->schedule_job_ms(lib->scheduler, (job_t*)
+				callback_job_create((callback_job_cb_t)flush_job, this,
+									NULL, (callback_job_cancel_t)return_false),
+				this->flush_interval);
+	}
+	this->mutex->unlock(this->mutex);
+
+	if (queue)
+	{
+		flush_queue(this, queue);
+	}
+}
+
 METHOD(logger_t, log_, void,
 	private_sql_logger_t *this, debug_t group, level_t level, int thread,
 	ike_sa_t* ike_sa, const char *message)
@@ -65,6 +231,7 @@ METHOD(logger_t, log_, void,
 		identification_t *local_id, *remote_id;
 		u_int64_t ispi, rspi;
 		ike_sa_id_t *id;
+		record_t *record;
 
 		id = ike_sa->get_id(ike_sa);
 		ispi = id->get_initiator_spi(id);
@@ -85,27 +252,31 @@ METHOD(logger_t, log_, void,
 		local_host = ike_sa->get_my_host(ike_sa);
 		remote_host = ike_sa->get_other_host(ike_sa);
 
-		this->db->execute(this->db, NULL, "REPLACE INTO ike_sas ("
-						  "local_spi, remote_spi, id, initiator, "
-						  "local_id_type, local_id_data, "
-						  "remote_id_type, remote_id_data, "
-						  "host_family, local_host_data, remote_host_data) "
-						  "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)",
-						  DB_BLOB, local_spi, DB_BLOB, remote_spi,
-						  DB_INT, ike_sa->get_unique_id(ike_sa),
-						  DB_INT, id->is_initiator(id),
-						  DB_INT, local_id->get_type(local_id),
-						  DB_BLOB, local_id->get_encoding(local_id),
-						  DB_INT, remote_id->get_type(remote_id),
-						  DB_BLOB, remote_id->get_encoding(remote_id),
-						  DB_INT, local_host->get_family(local_host),
-						  DB_BLOB, local_host->get_address(local_host),
-						  DB_BLOB, remote_host->get_address(remote_host));
-		this->db->execute(this->db, NULL, "INSERT INTO logs ("
-						  "local_spi, `signal`, level, msg) "
-						  "VALUES (?, ?, ?, ?)",
-						  DB_BLOB, local_spi, DB_INT, group, DB_INT, level,
-						  DB_TEXT, message);
+		INIT(record,
+			.local_spi = chunk_clone(local_spi),
+			.remote_spi = chunk_clone(remote_spi),
+			.id = ike_sa->get_unique_id(ike_sa),
+			.initiator = id->is_initiator(id),
+			.local_id_type = local_id->get_type(local_id),
+			.local_id = chunk_clone(local_id->get_encoding(local_id)),
+			.remote_id_type = remote_id->get_type(remote_id),
+			.remote_id = chunk_clone(remote_id->get_encoding(remote_id)),
+			.family = local_host->get_family(local_host),
+			.local_host = chunk_clone(local_host->get_address(local_host)),
+			.remote_host = chunk_clone(remote_host->get_address(remote_host)),
+			.group = group,
+			.level = level,
+			.message = strdup(message),
+		);
+		if (this->flush_interval)
+		{
+			queue_record(this, record);
+		}
+		else
+		{
+			write_record(this, record);
+			record_destroy(record);
+		}
 	}
 
 	this->recursive->set(this->recursive, NULL);
@@ -120,6 +291,16 @@ METHOD(logger_t, get_level, level_t,
 METHOD(sql_logger_t, destroy, void,
 	private_sql_logger_t *this)
 {
+	linked_list_t *queue;
+
+	this->mutex->lock(this->mutex);
+	queue = this->queue;
+	this->queue = linked_list_create();
+	this->mutex->unlock(this->mutex);
+	flush_queue(this, queue);
+
+	this->queue->destroy(this->queue);
+	this->mutex->destroy(this->mutex);
 	free(this);
 }
 
@@ -142,8 +323,12 @@ sql_logger_t *sql_logger_create(database_t *db)
 		.recursive = thread_value_create(NULL),
 		.level = lib->settings->get_int(lib->settings,
 										"%s.plugins.sql.loglevel", -1, lib->ns),
+		.flush_interval = lib->settings->get_int(lib->settings,
+										"%s.plugins.sql.flush_interval", 0,
+										lib->ns),
+		.queue = linked_list_create(),
+		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
 	);
 
 	return &this->public;
 }
-
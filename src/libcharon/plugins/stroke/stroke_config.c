@@ -1279,6 +1279,7 @@ METHOD(stroke_config_t, add, void,
 		this->mutex->lock(this->mutex);
 		this->list->insert_last(this->list, peer_cfg);
 		this->mutex->unlock(this->mutex);
+		charon->backends->flush_cache(charon->backends);
 	}
 }
 
@@ -1325,6 +1326,7 @@ METHOD(stroke_config_t, del, void,
 
 	if (deleted)
 	{
+		charon->backends->flush_cache(charon->backends);
 		DBG1(DBG_CFG, "deleted connection '%s'", msg->del_conn.name);
 	}
 	else
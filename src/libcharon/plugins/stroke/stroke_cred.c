@@ -36,6 +36,8 @@
 #include <collections/linked_list.h>
 #include <utils/lexparser.h>
 #include <threading/rwlock.h>
+#include <threading/semaphore.h>
+#include <processing/jobs/callback_job.h>
 #include <daemon.h>
 
 /* configuration directories and files */
@@ -509,6 +511,74 @@ static void load_x509_ac(private_stroke_cred_t *this, char *file)
 	}
 }
 
+/**
+ * Load a single certificate file, according to its type and flags
+ */
+static void load_certfile(private_stroke_cred_t *this, char *file,
+						  certificate_type_t type, x509_flag_t flag)
+{
+	switch (type)
+	{
+		case CERT_X509:
+			if (flag & X509_CA)
+			{
+				load_x509_ca(this, file);
+			}
+			else if (flag & X509_AA)
+			{
+				load_x509_aa(this, file);
+			}
+			else
+			{
+				load_x509(this, file, flag);
+			}
+			break;
+		case CERT_X509_CRL:
+			load_x509_crl(this, file);
+			break;
+		case CERT_X509_AC:
+			load_x509_ac(this, file);
+			break;
+		default:
+			break;
+	}
+}
+
+/**
+ * Job data to load a certificate file on a worker thread
+ */
+typedef struct {
+	/** credential set to load the certificate into */
+	private_stroke_cred_t *this;
+	/** path of the certificate file, cloned */
+	char *file;
+	/** type of the certificate */
+	certificate_type_t type;
+	/** X.509 flags to apply */
+	x509_flag_t flag;
+	/** semaphore posted once the job got processed */
+	semaphore_t *done;
+} certfile_job_t;
+
+/**
+ * Clean up a certificate load job, signaling completion
+ */
+static void certfile_job_destroy(certfile_job_t *job)
+{
+	job->done->post(job->done);
+	free(job->file);
+	free(job);
+}
+
+/**
+ * Load a certificate file on a worker thread
+ */
+static job_requeue_t certfile_job_execute(certfile_job_t *job)
+{
+	load_certfile(job->this, job->file, job->type, job->flag);
+	return JOB_REQUEUE_NONE;
+}
+
 /**
  * load trusted certificates from a directory
  */
@@ -516,12 +586,22 @@ static void load_certdir(private_stroke_cred_t *this, char *path,
 						 certificate_type_t type, x509_flag_t flag)
 {
 	enumerator_t *enumerator;
+	certfile_job_t *job;
+	semaphore_t *done;
 	struct stat st;
 	char *file;
+	int jobs = 0;
+	bool parallel;
+
+	/* decoding dominates the load time of large directories; fan the files
+	 * out to the workers, if we have any. The backing mem_cred sets are
+	 * thread-safe. */
+	parallel = lib->processor->get_total_threads(lib->processor) > 1;
 
 	enumerator = enumerator_create_directory(path);
 	if (enumerator)
 	{
+		done = semaphore_create(0);
 		while (enumerator->enumerate(enumerator, NULL, &file, &st))
 		{
 			if (!S_ISREG(st.st_mode))
@@ -529,33 +609,32 @@ static void load_certdir(private_stroke_cred_t *this, char *path,
 				/* skip special file */
 				continue;
 			}
-			switch (type)
+			if (parallel)
 			{
-				case CERT_X509:
-					if (flag & X509_CA)
-					{
-						load_x509_ca(this, file);
-					}
-					else if (flag & X509_AA)
-					{
-						load_x509_aa(this, file);
-					}
-					else
-					{
-						load_x509(this, file, flag);
-					}
-					break;
-				case CERT_X509_CRL:
-					load_x509_crl(this, file);
-					break;
-				case CERT_X509_AC:
-					load_x509_ac(this, file);
-					break;
-				default:
-					break;
+				INIT(job,
+					.this = this,
+					.file = strdup(file),
+					.type = type,
+					.flag = flag,
+					.done = done,
+				);
+				lib->processor->queue_job(lib->processor,
+					(job_t*)callback_job_create_with_prio(
+						(callback_job_cb_t)certfile_job_execute, job,
+						(void*)certfile_job_destroy, NULL, JOB_PRIO_CRITICAL));
+				jobs++;
+			}
+			else
+			{
+				load_certfile(this, file, type, flag);
 			}
 		}
 		enumerator->destroy(enumerator);
+		while (jobs--)
+		{
+			done->wait(done);
+		}
+		done->destroy(done);
 	}
 	else
 	{
@@ -13,6 +13,7 @@
  * for more details.
  */
 
+#define _GNU_SOURCE /* for fmemopen() */
 #include "stroke_list.h"
 
 #include <inttypes.h>
@@ -340,6 +341,32 @@ static void log_child_sa(FILE *out, child_sa_t *child_sa, bool all)
 	other_ts->destroy(other_ts);
 }
 
+/**
+ * Size of the buffer a single IKE_SA/CHILD_SA status block is rendered into
+ */
+#define STATUS_BLOCK_LEN 4096
+
+/**
+ * Render a status log block into an allocated string using the given log
+ * function, invoked while the SA is still checked out
+ */
+static char* render_status(void (*log)(FILE*, void*, bool), void *item,
+						   bool all)
+{
+	char buf[STATUS_BLOCK_LEN];
+	FILE *mem;
+
+	mem = fmemopen(buf, sizeof(buf), "w");
+	if (!mem)
+	{
+		return strdup("");
+	}
+	log(mem, item, all);
+	fclose(mem);
+	buf[sizeof(buf) - 1] = '\0';
+	return strdup(buf);
+}
+
 /**
  * Log a configs local or remote authentication config to out
  */
@@ -466,9 +493,10 @@ METHOD(stroke_list_t, status, void,
 	child_cfg_t *child_cfg;
 	child_sa_t *child_sa;
 	ike_sa_t *ike_sa;
-	linked_list_t *my_ts, *other_ts;
+	linked_list_t *my_ts, *other_ts, *blocks;
 	bool first, found = FALSE;
 	char *name = msg->status.name;
+	char *block;
 	u_int half_open;
 
 	if (all)
@@ -650,16 +678,21 @@ METHOD(stroke_list_t, status, void,
 	fprintf(out, "Security Associations (%u up, %u connecting):\n",
 		charon->ike_sa_manager->get_count(charon->ike_sa_manager) - half_open,
 		half_open);
+	/* render each SA into a memory block while it is checked out, and stream
+	 * the blocks to the client afterwards. A slow client reading the status
+	 * does not keep SAs unavailable to other threads this way. */
+	blocks = linked_list_create();
 	enumerator = charon->controller->create_ike_sa_enumerator(
 													charon->controller, wait);
-	while (enumerator->enumerate(enumerator, &ike_sa) && ferror(out) == 0)
+	while (enumerator->enumerate(enumerator, &ike_sa))
 	{
 		bool ike_printed = FALSE;
 		enumerator_t *children = ike_sa->create_child_sa_enumerator(ike_sa);
 
 		if (name == NULL || streq(name, ike_sa->get_name(ike_sa)))
 		{
-			log_ike_sa(out, ike_sa, all);
+			blocks->insert_last(blocks,
+						render_status((void*)log_ike_sa, ike_sa, all));
 			found = TRUE;
 			ike_printed = TRUE;
 		}
@@ -670,17 +703,30 @@ METHOD(stroke_list_t, status, void,
 			{
 				if (!ike_printed)
 				{
-					log_ike_sa(out, ike_sa, all);
+					blocks->insert_last(blocks,
+								render_status((void*)log_ike_sa, ike_sa, all));
 					found = TRUE;
 					ike_printed = TRUE;
 				}
-				log_child_sa(out, child_sa, all);
+				blocks->insert_last(blocks,
+								render_status((void*)log_child_sa, child_sa, all));
 			}
 		}
 		children->destroy(children);
 	}
 	enumerator->destroy(enumerator);
 
+	while (blocks->remove_first(blocks, (void**)&block) == SUCCESS)
+	{
+		if (ferror(out) == 0)
+		{
+			fputs(block, out);
+			fflush(out);
+		}
+		free(block);
+	}
+	blocks->destroy(blocks);
+
 	if (!found)
 	{
 		if (name)
@@ -25,6 +25,9 @@
 #include <errno.h>
 
 #include <daemon.h>
+#include <threading/mutex.h>
+#include <collections/linked_list.h>
+#include <processing/jobs/callback_job.h>
 
 #include "stroke_config.h"
 #include "stroke_control.h"
@@ -44,6 +47,20 @@
 typedef struct stroke_job_context_t stroke_job_context_t;
 typedef struct private_stroke_socket_t private_stroke_socket_t;
 
+/**
+ * Classes of stroke commands, each gated by its own concurrency limit so
+ * blocking control commands can't starve quick status queries
+ */
+typedef enum {
+	/** connection control commands that may block on IKE exchanges */
+	CMD_CLASS_CONTROL,
+	/** status and listing queries */
+	CMD_CLASS_QUERY,
+	/** configuration and credential commands */
+	CMD_CLASS_CONFIG,
+	CMD_CLASS_MAX,
+} cmd_class_t;
+
 /**
  * private data of stroke_socket
  */
@@ -103,8 +120,56 @@ struct private_stroke_socket_t {
 	 * TRUE if log level changes are not allowed
 	 */
 	bool prevent_loglevel_changes;
+
+	/**
+	 * Currently processing commands, by class
+	 */
+	u_int active[CMD_CLASS_MAX];
+
+	/**
+	 * Concurrency limit per command class
+	 */
+	u_int limit[CMD_CLASS_MAX];
+
+	/**
+	 * Commands waiting for a slot of their class, as stroke_job_context_t
+	 */
+	linked_list_t *pending[CMD_CLASS_MAX];
+
+	/**
+	 * Mutex to lock command dispatching state
+	 */
+	mutex_t *mutex;
 };
 
+/**
+ * A received stroke command, dispatched to a processor job
+ */
+struct stroke_job_context_t {
+
+	/** socket the command arrived on */
+	private_stroke_socket_t *this;
+
+	/** received message */
+	stroke_msg_t *msg;
+
+	/** response output stream */
+	FILE *out;
+
+	/** class the command is gated in */
+	cmd_class_t class;
+};
+
+/**
+ * Clean up a command context
+ */
+static void context_destroy(stroke_job_context_t *ctx)
+{
+	fclose(ctx->out);
+	free(ctx->msg);
+	free(ctx);
+}
+
 /**
  * Helper macro to log configuration options, but only if they are defined.
  */
@@ -615,50 +680,11 @@ static void stroke_config(private_stroke_socket_t *this,
 }
 
 /**
- * process a stroke request
+ * Handle a received stroke command
  */
-static bool on_accept(private_stroke_socket_t *this, stream_t *stream)
+static void handle_message(private_stroke_socket_t *this, stroke_msg_t *msg,
+						   FILE *out)
 {
-	stroke_msg_t *msg;
-	u_int16_t len;
-	FILE *out;
-
-	/* read length */
-	if (!stream->read_all(stream, &len, sizeof(len)))
-	{
-		if (errno != EWOULDBLOCK)
-		{
-			DBG1(DBG_CFG, "reading length of stroke message failed: %s",
-				 strerror(errno));
-		}
-		return FALSE;
-	}
-
-	/* read message (we need an additional byte to terminate the buffer) */
-	msg = malloc(len + 1);
-	msg->length = len;
-	if (!stream->read_all(stream, (char*)msg + sizeof(len), len - sizeof(len)))
-	{
-		if (errno != EWOULDBLOCK)
-		{
-			DBG1(DBG_CFG, "reading stroke message failed: %s", strerror(errno));
-		}
-		free(msg);
-		return FALSE;
-	}
-	/* make sure even incorrectly unterminated strings don't extend over the
-	 * message boundaries */
-	((char*)msg)[len] = '\0';
-
-	DBG3(DBG_CFG, "stroke message %b", (void*)msg, len);
-
-	out = stream->get_file(stream);
-	if (!out)
-	{
-		DBG1(DBG_CFG, "creating stroke output stream failed");
-		free(msg);
-		return FALSE;
-	}
 	switch (msg->type)
 	{
 		case STR_INITIATE:
@@ -734,15 +760,158 @@ static bool on_accept(private_stroke_socket_t *this, stream_t *stream)
 			DBG1(DBG_CFG, "received unknown stroke");
 			break;
 	}
-	free(msg);
-	fclose(out);
+}
+
+/**
+ * Classify a stroke message into a command class
+ */
+static cmd_class_t classify(stroke_msg_t *msg)
+{
+	switch (msg->type)
+	{
+		case STR_INITIATE:
+		case STR_ROUTE:
+		case STR_UNROUTE:
+		case STR_TERMINATE:
+		case STR_TERMINATE_SRCIP:
+		case STR_REKEY:
+		case STR_PURGE:
+			return CMD_CLASS_CONTROL;
+		case STR_STATUS:
+		case STR_STATUS_ALL:
+		case STR_STATUS_ALL_NOBLK:
+		case STR_LIST:
+		case STR_LEASES:
+		case STR_MEMUSAGE:
+		case STR_COUNTERS:
+		case STR_EXPORT:
+			return CMD_CLASS_QUERY;
+		default:
+			return CMD_CLASS_CONFIG;
+	}
+}
+
+/**
+ * Queue a job processing the given command. Must be called with
+ * this->mutex held and this->active[class] already accounted for.
+ */
+static void dispatch_command(stroke_job_context_t *ctx);
+
+/**
+ * Job processing a dispatched command
+ */
+static job_requeue_t process_command(stroke_job_context_t *ctx)
+{
+	private_stroke_socket_t *this = ctx->this;
+	stroke_job_context_t *next;
+	cmd_class_t class = ctx->class;
+
+	handle_message(this, ctx->msg, ctx->out);
+
+	this->mutex->lock(this->mutex);
+	this->active[class]--;
+	if (this->pending[class]->remove_first(this->pending[class],
+										   (void**)&next) == SUCCESS)
+	{
+		this->active[class]++;
+		dispatch_command(next);
+	}
+	this->mutex->unlock(this->mutex);
+
+	return JOB_REQUEUE_NONE;
+}
+
+static void dispatch_command(stroke_job_context_t *ctx)
+{
+	lib->processor->queue_job(lib->processor,
+		(job_t*)callback_job_create_with_prio(
+			(callback_job_cb_t)process_command, ctx, (void*)context_destroy,
+			(callback_job_cancel_t)return_false, JOB_PRIO_CRITICAL));
+}
+
+/**
+ * process a stroke request
+ */
+static bool on_accept(private_stroke_socket_t *this, stream_t *stream)
+{
+	stroke_job_context_t *ctx;
+	stroke_msg_t *msg;
+	u_int16_t len;
+	FILE *out;
+
+	/* read length */
+	if (!stream->read_all(stream, &len, sizeof(len)))
+	{
+		if (errno != EWOULDBLOCK)
+		{
+			DBG1(DBG_CFG, "reading length of stroke message failed: %s",
+				 strerror(errno));
+		}
+		return FALSE;
+	}
+
+	/* read message (we need an additional byte to terminate the buffer) */
+	msg = malloc(len + 1);
+	msg->length = len;
+	if (!stream->read_all(stream, (char*)msg + sizeof(len), len - sizeof(len)))
+	{
+		if (errno != EWOULDBLOCK)
+		{
+			DBG1(DBG_CFG, "reading stroke message failed: %s", strerror(errno));
+		}
+		free(msg);
+		return FALSE;
+	}
+	/* make sure even incorrectly unterminated strings don't extend over the
+	 * message boundaries */
+	((char*)msg)[len] = '\0';
+
+	DBG3(DBG_CFG, "stroke message %b", (void*)msg, len);
+
+	out = stream->get_file(stream);
+	if (!out)
+	{
+		DBG1(DBG_CFG, "creating stroke output stream failed");
+		free(msg);
+		return FALSE;
+	}
+
+	/* dispatch the command to a job, so commands of different classes
+	 * overlap and a long-running control command does not block queries */
+	INIT(ctx,
+		.this = this,
+		.msg = msg,
+		.out = out,
+		.class = classify(msg),
+	);
+	this->mutex->lock(this->mutex);
+	if (this->active[ctx->class] < this->limit[ctx->class])
+	{
+		this->active[ctx->class]++;
+		dispatch_command(ctx);
+	}
+	else
+	{
+		this->pending[ctx->class]->insert_last(this->pending[ctx->class], ctx);
+	}
+	this->mutex->unlock(this->mutex);
 	return FALSE;
 }
 
 METHOD(stroke_socket_t, destroy, void,
 	private_stroke_socket_t *this)
 {
+	int i;
+
 	DESTROY_IF(this->service);
+	/* jobs were flushed when the processor got cancelled, clean up commands
+	 * that never got a slot */
+	for (i = 0; i < CMD_CLASS_MAX; i++)
+	{
+		this->pending[i]->destroy_function(this->pending[i],
+										   (void*)context_destroy);
+	}
+	this->mutex->destroy(this->mutex);
 	lib->credmgr->remove_set(lib->credmgr, &this->ca->set);
 	lib->credmgr->remove_set(lib->credmgr, &this->cred->set);
 	charon->backends->remove_backend(charon->backends, &this->config->backend);
@@ -768,7 +937,7 @@ METHOD(stroke_socket_t, destroy, void,
 stroke_socket_t *stroke_socket_create()
 {
 	private_stroke_socket_t *this;
-	int max_concurrent;
+	int max_concurrent, i;
 	char *uri;
 
 	INIT(this,
@@ -777,6 +946,7 @@ stroke_socket_t *stroke_socket_create()
 		},
 		.prevent_loglevel_changes = lib->settings->get_bool(lib->settings,
 				"%s.plugins.stroke.prevent_loglevel_changes", FALSE, lib->ns),
+		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
 	);
 
 	this->cred = stroke_cred_create();
@@ -800,6 +970,19 @@ stroke_socket_t *stroke_socket_create()
 	max_concurrent = lib->settings->get_int(lib->settings,
 				"%s.plugins.stroke.max_concurrent", MAX_CONCURRENT_DEFAULT,
 				lib->ns);
+	this->limit[CMD_CLASS_CONTROL] = max(1, lib->settings->get_int(
+				lib->settings, "%s.plugins.stroke.max_concurrent_control",
+				max_concurrent, lib->ns));
+	this->limit[CMD_CLASS_QUERY] = max(1, lib->settings->get_int(
+				lib->settings, "%s.plugins.stroke.max_concurrent_query",
+				max_concurrent, lib->ns));
+	this->limit[CMD_CLASS_CONFIG] = max(1, lib->settings->get_int(
+				lib->settings, "%s.plugins.stroke.max_concurrent_config",
+				max_concurrent, lib->ns));
+	for (i = 0; i < CMD_CLASS_MAX; i++)
+	{
+		this->pending[i] = linked_list_create();
+	}
 	uri = lib->settings->get_str(lib->settings,
 				"%s.plugins.stroke.socket", "unix://" STROKE_SOCKET, lib->ns);
 	this->service = lib->streams->create_service(lib->streams, uri, 10);
@@ -34,6 +34,7 @@
 #include <utils/debug.h>
 #include <pen/pen.h>
 #include <threading/thread.h>
+#include <threading/mutex.h>
 #include <processing/jobs/callback_job.h>
 #include <sa/eap/eap_method.h>
 
@@ -126,6 +127,12 @@ struct private_tnc_pdp_t {
 	 */
 	tnc_pdp_connections_t *connections;
 
+	/**
+	 * Lock protecting the clients list and the non thread-safe MD5/HMAC
+	 * primitives shared by concurrent request processing jobs
+	 */
+	mutex_t *mutex;
+
 };
 
 /**
@@ -444,6 +451,7 @@ static void send_response(private_tnc_pdp_t *this, radius_message_t *request,
 		response->add(response, RAT_TUNNEL_TYPE, data);
 		response->add(response, RAT_FILTER_ID, group->get_encoding(group));
 	}
+	this->mutex->lock(this->mutex);
 	if (msk.len)
 	{
 		recv = chunk_create(msk.ptr, msk.len / 2);
@@ -460,10 +468,15 @@ static void send_response(private_tnc_pdp_t *this, radius_message_t *request,
 	if (response->sign(response, request->get_authenticator(request),
 					   this->secret, this->hasher, this->signer, NULL, TRUE))
 	{
+		this->mutex->unlock(this->mutex);
 		DBG1(DBG_CFG, "sending RADIUS %N to client '%H'",
 			 radius_message_code_names, code, client);
 		send_message(this, response, client);
 	}
+	else
+	{
+		this->mutex->unlock(this->mutex);
+	}
 	response->destroy(response);
 }
 
@@ -696,6 +709,35 @@ static bool pt_tls_receive(private_tnc_pdp_t *this, int fd, watcher_event_t even
 	return TRUE;
 }
 
+typedef struct {
+	/** plugin instance the request was received by */
+	private_tnc_pdp_t *this;
+	/** verified RADIUS request to process */
+	radius_message_t *request;
+	/** client the request was received from */
+	host_t *source;
+} radius_request_job_t;
+
+/**
+ * Clean up context of a deferred RADIUS request
+ */
+static void radius_request_job_destroy(radius_request_job_t *job)
+{
+	job->request->destroy(job->request);
+	job->source->destroy(job->source);
+	free(job);
+}
+
+/**
+ * Process a verified RADIUS request on a worker thread
+ */
+static job_requeue_t radius_request_process(radius_request_job_t *job)
+{
+	process_eap(job->this, job->request, job->source);
+
+	return JOB_REQUEUE_NONE;
+}
+
 /**
  * Process packets received on the RADIUS socket
  */
@@ -704,103 +746,132 @@ static bool radius_receive(private_tnc_pdp_t *this, int fd, watcher_event_t even
 	radius_message_t *request;
 	char buffer[MAX_PACKET];
 	client_entry_t *client;
-	bool retransmission = FALSE, found = FALSE, stale;
+	bool retransmission, found, stale, verified;
 	enumerator_t *enumerator;
-	int bytes_read = 0;
+	radius_request_job_t *job;
+	int bytes_read;
 	host_t *source;
 	uint8_t id;
 	time_t now;
 
-	union {
-		struct sockaddr_in in4;
-		struct sockaddr_in6 in6;
-	} src;
-
-	struct iovec iov = {
-		.iov_base = buffer,
-		.iov_len = MAX_PACKET,
-	};
-
-	struct msghdr msg = {
-		.msg_name = &src,
-		.msg_namelen = sizeof(src),
-		.msg_iov = &iov,
-		.msg_iovlen = 1,
-	};
-
-	/* read received packet */
-	bytes_read = recvmsg(fd, &msg, 0);
-	if (bytes_read < 0)
-	{
-		DBG1(DBG_CFG, "error reading RADIUS socket: %s", strerror(errno));
-		return FALSE;
-	}
-	if (msg.msg_flags & MSG_TRUNC)
-	{
-		DBG1(DBG_CFG, "receive buffer too small, RADIUS packet discarded");
-		return FALSE;
-	}
-	source = host_create_from_sockaddr((sockaddr_t*)&src);
-	DBG2(DBG_CFG, "received RADIUS packet from %#H", source);
-	DBG3(DBG_CFG, "%b", buffer, bytes_read);
-	request = radius_message_parse(chunk_create(buffer, bytes_read));
-	if (request)
+	/* drain all packets queued on the socket before waiting again */
+	while (TRUE)
 	{
-		DBG1(DBG_CFG, "received RADIUS %N from client '%H'",
-		radius_message_code_names, request->get_code(request), source);
-
-		if (request->verify(request, NULL, this->secret, this->hasher,
-										   this->signer))
+		union {
+			struct sockaddr_in in4;
+			struct sockaddr_in6 in6;
+		} src;
+
+		struct iovec iov = {
+			.iov_base = buffer,
+			.iov_len = MAX_PACKET,
+		};
+
+		struct msghdr msg = {
+			.msg_name = &src,
+			.msg_namelen = sizeof(src),
+			.msg_iov = &iov,
+			.msg_iovlen = 1,
+		};
+
+		/* read received packet */
+		bytes_read = recvmsg(fd, &msg, MSG_DONTWAIT);
+		if (bytes_read < 0)
+		{
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+			{	/* socket drained */
+				return TRUE;
+			}
+			DBG1(DBG_CFG, "error reading RADIUS socket: %s", strerror(errno));
+			return FALSE;
+		}
+		if (msg.msg_flags & MSG_TRUNC)
+		{
+			DBG1(DBG_CFG, "receive buffer too small, RADIUS packet discarded");
+			continue;
+		}
+		source = host_create_from_sockaddr((sockaddr_t*)&src);
+		DBG2(DBG_CFG, "received RADIUS packet from %#H", source);
+		DBG3(DBG_CFG, "%b", buffer, bytes_read);
+		request = radius_message_parse(chunk_create(buffer, bytes_read));
+		if (request)
 		{
-			id = request->get_identifier(request);
-			now = time(NULL);
+			DBG1(DBG_CFG, "received RADIUS %N from client '%H'",
+			radius_message_code_names, request->get_code(request), source);
 
-			enumerator = this->clients->create_enumerator(this->clients);
-			while (enumerator->enumerate(enumerator, &client))
+			this->mutex->lock(this->mutex);
+			verified = request->verify(request, NULL, this->secret,
+									   this->hasher, this->signer);
+			if (verified)
 			{
-				stale = client->last_time < now - RADIUS_RETRANSMIT_TIMEOUT;
+				retransmission = FALSE;
+				found = FALSE;
+				id = request->get_identifier(request);
+				now = time(NULL);
+
+				enumerator = this->clients->create_enumerator(this->clients);
+				while (enumerator->enumerate(enumerator, &client))
+				{
+					stale = client->last_time < now - RADIUS_RETRANSMIT_TIMEOUT;
+
+					if (source->equals(source, client->host))
+					{
+						retransmission = !stale && client->last_id == id;
+						client->last_id = id;
+						client->last_time = now;
+						found = TRUE;
+					}
+					else if (stale)
+					{
+						this->clients->remove_at(this->clients, enumerator);
+						free_client_entry(client);
+					}
+				}
+				enumerator->destroy(enumerator);
 
-				if (source->equals(source, client->host))
+				if (!found)
 				{
-					retransmission = !stale && client->last_id == id;
+					client = malloc_thing(client_entry_t);
+					client->host = source->clone(source);
 					client->last_id = id;
 					client->last_time = now;
-					found = TRUE;
+					this->clients->insert_last(this->clients, client);
 				}
-				else if (stale)
+				this->mutex->unlock(this->mutex);
+
+				if (retransmission)
 				{
-					this->clients->remove_at(this->clients, enumerator);
-					free_client_entry(client);
+					DBG1(DBG_CFG, "ignoring RADIUS Access-Request 0x%02x, "
+								  "already processing", id);
+				}
+				else
+				{
+					/* process the conversation on a worker thread, so
+					 * concurrent assessments don't block the socket */
+					INIT(job,
+						.this = this,
+						.request = request,
+						.source = source,
+					);
+					lib->processor->queue_job(lib->processor,
+						(job_t*)callback_job_create(
+								(callback_job_cb_t)radius_request_process, job,
+								(void*)radius_request_job_destroy, NULL));
+					continue;
 				}
-			}
-			enumerator->destroy(enumerator);
-
-			if (!found)
-			{
-				client = malloc_thing(client_entry_t);
-				client->host = source->clone(source);
-				client->last_id = id;
-				client->last_time = now;
-				this->clients->insert_last(this->clients, client);
-			}
-			if (retransmission)
-			{
-				DBG1(DBG_CFG, "ignoring RADIUS Access-Request 0x%02x, "
-							  "already processing", id);
 			}
 			else
 			{
-				process_eap(this, request, source);
+				this->mutex->unlock(this->mutex);
 			}
+			request->destroy(request);
 		}
-		request->destroy(request);
-	}
-	else
-	{
-		DBG1(DBG_CFG, "received invalid RADIUS message, ignored");
+		else
+		{
+			DBG1(DBG_CFG, "received invalid RADIUS message, ignored");
+		}
+		source->destroy(source);
 	}
-	source->destroy(source);
-	return TRUE;
 }
 
 METHOD(tnc_pdp_t, destroy, void,
@@ -830,6 +901,7 @@ METHOD(tnc_pdp_t, destroy, void,
 	{
 		this->clients->destroy_function(this->clients, (void*)free_client_entry);
 	}
+	this->mutex->destroy(this->mutex);
 	DESTROY_IF(this->server);
 	DESTROY_IF(this->signer);
 	DESTROY_IF(this->hasher);
@@ -880,6 +952,7 @@ tnc_pdp_t *tnc_pdp_create(void)
 		},
 		.server = identification_create_from_string(server),
 		.connections = tnc_pdp_connections_create(),
+		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
 	);
 
 	/* Create IPv4 and IPv6 PT-TLS listening sockets */
@@ -0,0 +1,335 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Hochschule fuer Technik Rapperswil
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <unistd.h>
+
+#include "updown_executor.h"
+
+#include <daemon.h>
+#include <utils/process.h>
+#include <threading/mutex.h>
+#include <threading/condvar.h>
+#include <collections/linked_list.h>
+#include <processing/jobs/callback_job.h>
+
+typedef struct private_updown_executor_t private_updown_executor_t;
+
+/**
+ * Private data of an updown_executor_t object.
+ */
+struct private_updown_executor_t {
+
+	/**
+	 * Public updown_executor_t interface.
+	 */
+	updown_executor_t public;
+
+	/**
+	 * Queued invocations, as invocation_t
+	 */
+	linked_list_t *queue;
+
+	/**
+	 * Maximum number of concurrent worker jobs, 0 for synchronous execution
+	 */
+	u_int workers;
+
+	/**
+	 * Currently running worker jobs
+	 */
+	u_int active;
+
+	/**
+	 * Maximum number of invocations merged into one script run
+	 */
+	u_int batch;
+
+	/**
+	 * Mutex to lock queue and counters
+	 */
+	mutex_t *mutex;
+
+	/**
+	 * Condvar to wait for worker termination
+	 */
+	condvar_t *condvar;
+};
+
+/**
+ * A queued script invocation
+ */
+typedef struct {
+	/** shell command line to run */
+	char *cmd;
+	/** NULL-terminated environment vector */
+	char **envp;
+} invocation_t;
+
+/**
+ * Destroy a task
+ */
+static void invocation_destroy(invocation_t *this)
+{
+	int i;
+
+	for (i = 0; this->envp[i]; i++)
+	{
+		free(this->envp[i]);
+	}
+	free(this->envp);
+	free(this->cmd);
+	free(this);
+}
+
+/**
+ * Run a script with the given environment, logging its output
+ */
+static void run_script(char *cmd, char **envp)
+{
+	process_t *process;
+	FILE *shell;
+	int out;
+
+	process = process_start_shell(envp, NULL, &out, NULL, "2>&1 %s", cmd);
+	if (process)
+	{
+		shell = fdopen(out, "r");
+		if (shell)
+		{
+			while (TRUE)
+			{
+				char resp[128];
+
+				if (fgets(resp, sizeof(resp), shell) == NULL)
+				{
+					if (ferror(shell))
+					{
+						DBG1(DBG_CHD, "error reading from updown script");
+					}
+					break;
+				}
+				else
+				{
+					char *e = resp + strlen(resp);
+					if (e > resp && e[-1] == '\n')
+					{
+						e[-1] = '\0';
+					}
+					DBG1(DBG_CHD, "updown: %s", resp);
+				}
+			}
+			fclose(shell);
+		}
+		else
+		{
+			close(out);
+		}
+		process->wait(process, NULL);
+	}
+}
+
+/**
+ * Run a batch of invocations of the same script with a single script run.
+ *
+ * The environments get merged: PLUTO_ variables of the i-th invocation are
+ * passed as PLUTO_<i>_ variables, other variables are taken from the first
+ * invocation, and PLUTO_BATCH holds the number of merged invocations.
+ */
+static void run_batch(linked_list_t *tasks)
+{
+	enumerator_t *enumerator;
+	invocation_t *task, *first = NULL;
+	char **envp, *var;
+	int count, total = 0, n = 0, i, idx = 0;
+
+	count = tasks->get_count(tasks);
+	enumerator = tasks->create_enumerator(tasks);
+	while (enumerator->enumerate(enumerator, &task))
+	{
+		for (i = 0; task->envp[i]; i++)
+		{
+			total++;
+		}
+	}
+	enumerator->destroy(enumerator);
+
+	envp = calloc(total + 2, sizeof(char*));
+	if (asprintf(&var, "PLUTO_BATCH=%d", count) != -1)
+	{
+		envp[n++] = var;
+	}
+	enumerator = tasks->create_enumerator(tasks);
+	while (enumerator->enumerate(enumerator, &task))
+	{
+		first = first ?: task;
+		idx++;
+		for (i = 0; task->envp[i]; i++)
+		{
+			if (strpfx(task->envp[i], "PLUTO_"))
+			{
+				if (asprintf(&var, "PLUTO_%d_%s", idx,
+							 task->envp[i] + strlen("PLUTO_")) != -1)
+				{
+					envp[n++] = var;
+				}
+			}
+			else if (task == first)
+			{	/* PATH and other generic variables, pass once */
+				envp[n++] = strdup(task->envp[i]);
+			}
+		}
+	}
+	enumerator->destroy(enumerator);
+
+	run_script(first->cmd, envp);
+
+	for (i = 0; envp[i]; i++)
+	{
+		free(envp[i]);
+	}
+	free(envp);
+}
+
+/**
+ * Worker job draining the queue
+ */
+static job_requeue_t process_tasks(private_updown_executor_t *this)
+{
+	linked_list_t *batch;
+	invocation_t *task, *next;
+
+	while (TRUE)
+	{
+		this->mutex->lock(this->mutex);
+		if (this->queue->remove_first(this->queue, (void**)&task) != SUCCESS)
+		{
+			this->active--;
+			this->condvar->signal(this->condvar);
+			this->mutex->unlock(this->mutex);
+			return JOB_REQUEUE_NONE;
+		}
+		batch = NULL;
+		if (this->batch > 1)
+		{	/* merge consecutive invocations of the same script, preserving
+			 * the invocation order */
+			batch = linked_list_create();
+			batch->insert_last(batch, task);
+			while (batch->get_count(batch) < this->batch &&
+				   this->queue->get_first(this->queue,
+										  (void**)&next) == SUCCESS &&
+				   streq(next->cmd, task->cmd))
+			{
+				this->queue->remove_first(this->queue, (void**)&next);
+				batch->insert_last(batch, next);
+			}
+		}
+		this->mutex->unlock(this->mutex);
+
+		if (batch)
+		{
+			if (batch->get_count(batch) > 1)
+			{
+				run_batch(batch);
+			}
+			else
+			{
+				run_script(task->cmd, task->envp);
+			}
+			batch->destroy_function(batch, (void*)invocation_destroy);
+		}
+		else
+		{
+			run_script(task->cmd, task->envp);
+			invocation_destroy(task);
+		}
+	}
+}
+
+METHOD(updown_executor_t, invoke, void,
+	private_updown_executor_t *this, char *cmd, char **envp)
+{
+	invocation_t *task;
+
+	INIT(task,
+		.cmd = cmd,
+		.envp = envp,
+	);
+	if (!this->workers)
+	{
+		run_script(task->cmd, task->envp);
+		invocation_destroy(task);
+		return;
+	}
+	this->mutex->lock(this->mutex);
+	this->queue->insert_last(this->queue, task);
+	if (this->active < this->workers)
+	{
+		this->active++;
+		lib->processor->queue_job(lib->processor,
+			(job_t*)callback_job_create_with_prio(
+				(callback_job_cb_t)process_tasks, this, NULL,
+				(callback_job_cancel_t)return_false, JOB_PRIO_MEDIUM));
+	}
+	this->mutex->unlock(this->mutex);
+}
+
+METHOD(updown_executor_t, destroy, void,
+	private_updown_executor_t *this)
+{
+	invocation_t *task;
+
+	this->mutex->lock(this->mutex);
+	while (this->active)
+	{	/* wait for the workers to drain the queue */
+		this->condvar->wait(this->condvar, this->mutex);
+	}
+	this->mutex->unlock(this->mutex);
+	/* no new invocations at this point, run leftovers synchronously */
+	while (this->queue->remove_first(this->queue, (void**)&task) == SUCCESS)
+	{
+		run_script(task->cmd, task->envp);
+		invocation_destroy(task);
+	}
+	this->queue->destroy(this->queue);
+	this->condvar->destroy(this->condvar);
+	this->mutex->destroy(this->mutex);
+	free(this);
+}
+
+/*
+ * See header
+ */
+updown_executor_t *updown_executor_create()
+{
+	private_updown_executor_t *this;
+
+	INIT(this,
+		.public = {
+			.invoke = _invoke,
+			.destroy = _destroy,
+		},
+		.queue = linked_list_create(),
+		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+		.condvar = condvar_create(CONDVAR_TYPE_DEFAULT),
+		.workers = lib->settings->get_int(lib->settings,
+								"%s.plugins.updown.workers", 0, lib->ns),
+		.batch = max(1, lib->settings->get_int(lib->settings,
+								"%s.plugins.updown.batch", 1, lib->ns)),
+	);
+
+	return &this->public;
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Hochschule fuer Technik Rapperswil
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/**
+ * @defgroup updown_executor updown_executor
+ * @{ @ingroup updown
+ */
+
+#ifndef UPDOWN_EXECUTOR_H_
+#define UPDOWN_EXECUTOR_H_
+
+typedef struct updown_executor_t updown_executor_t;
+
+/**
+ * Executes updown scripts, optionally asynchronously from a bounded pool
+ * of worker jobs fed from a queue.
+ *
+ * With charon.plugins.updown.workers set to 0, scripts run synchronously
+ * in the invoking thread, as they traditionally did.
+ */
+struct updown_executor_t {
+
+	/**
+	 * Invoke an updown script with the given environment.
+	 *
+	 * Depending on the configuration, the script runs in the calling thread
+	 * or is queued for asynchronous execution.
+	 *
+	 * @param cmd		shell command line to run (gets owned)
+	 * @param envp		NULL-terminated environment vector (gets owned)
+	 */
+	void (*invoke)(updown_executor_t *this, char *cmd, char **envp);
+
+	/**
+	 * Destroy an updown_executor_t, waiting for pending invocations.
+	 */
+	void (*destroy)(updown_executor_t *this);
+};
+
+/**
+ * Create an updown_executor instance.
+ */
+updown_executor_t *updown_executor_create();
+
+#endif /** UPDOWN_EXECUTOR_H_ @}*/
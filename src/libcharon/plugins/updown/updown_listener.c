@@ -19,6 +19,7 @@
 #include <unistd.h>
 
 #include "updown_listener.h"
+#include "updown_executor.h"
 
 #include <utils/process.h>
 #include <hydra.h>
@@ -46,6 +47,11 @@ struct private_updown_listener_t {
 	 * DNS attribute handler
 	 */
 	updown_handler_t *handler;
+
+	/**
+	 * Executor running the scripts
+	 */
+	updown_executor_t *executor;
 };
 
 typedef struct cache_entry_t cache_entry_t;
@@ -124,16 +130,20 @@ static bool push_env(char *envp[], u_int count, char *fmt, ...)
 }
 
 /**
- * Free all allocated environment strings
+ * Move the environment strings into an allocated NULL-terminated vector
  */
-static void free_env(char *envp[])
+static char **steal_env(char *envp[])
 {
-	int i;
+	char **vec;
+	int i = 0;
 
-	for (i = 0; envp[i]; i++)
+	while (envp[i])
 	{
-		free(envp[i]);
+		i++;
 	}
+	vec = malloc((i + 1) * sizeof(char*));
+	memcpy(vec, envp, (i + 1) * sizeof(char*));
+	return vec;
 }
 
 /**
@@ -235,9 +245,6 @@ static void invoke_once(private_updown_listener_t *this, ike_sa_t *ike_sa,
 	u_int8_t mask;
 	mark_t mark;
 	bool is_host, is_ipv6;
-	int out;
-	FILE *shell;
-	process_t *process;
 	char *envp[128] = {};
 
 	me = ike_sa->get_my_host(ike_sa);
@@ -341,45 +348,10 @@ static void invoke_once(private_updown_listener_t *this, ike_sa_t *ike_sa,
 		push_env(envp, countof(envp), "PLUTO_HOST_ACCESS=1");
 	}
 
-	process = process_start_shell(envp, NULL, &out, NULL, "2>&1 %s",
-								  config->get_updown(config));
-	if (process)
-	{
-		shell = fdopen(out, "r");
-		if (shell)
-		{
-			while (TRUE)
-			{
-				char resp[128];
-
-				if (fgets(resp, sizeof(resp), shell) == NULL)
-				{
-					if (ferror(shell))
-					{
-						DBG1(DBG_CHD, "error reading from updown script");
-					}
-					break;
-				}
-				else
-				{
-					char *e = resp + strlen(resp);
-					if (e > resp && e[-1] == '\n')
-					{
-						e[-1] = '\0';
-					}
-					DBG1(DBG_CHD, "updown: %s", resp);
-				}
-			}
-			fclose(shell);
-		}
-		else
-		{
-			close(out);
-		}
-		process->wait(process, NULL);
-	}
+	this->executor->invoke(this->executor,
+						   strdup(config->get_updown(config)),
+						   steal_env(envp));
 	free(iface);
-	free_env(envp);
 }
 
 METHOD(listener_t, child_updown, bool,
@@ -413,7 +385,8 @@ METHOD(updown_listener_t, destroy, void,
 /**
  * See header
  */
-updown_listener_t *updown_listener_create(updown_handler_t *handler)
+updown_listener_t *updown_listener_create(updown_handler_t *handler,
+										  updown_executor_t *executor)
 {
 	private_updown_listener_t *this;
 
@@ -426,6 +399,7 @@ updown_listener_t *updown_listener_create(updown_handler_t *handler)
 		},
 		.iface_cache = linked_list_create(),
 		.handler = handler,
+		.executor = executor,
 	);
 
 	return &this->public;
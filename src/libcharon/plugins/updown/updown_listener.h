@@ -24,6 +24,7 @@
 #include <bus/bus.h>
 
 #include "updown_handler.h"
+#include "updown_executor.h"
 
 typedef struct updown_listener_t updown_listener_t;
 
@@ -45,7 +46,11 @@ struct updown_listener_t {
 
 /**
  * Create a updown_listener instance.
+ *
+ * @param handler		DNS attribute handler, or NULL
+ * @param executor		executor running the scripts
  */
-updown_listener_t *updown_listener_create(updown_handler_t *handler);
+updown_listener_t *updown_listener_create(updown_handler_t *handler,
+										  updown_executor_t *executor);
 
 #endif /** UPDOWN_LISTENER_H_ @}*/
@@ -16,6 +16,7 @@
 #include "updown_plugin.h"
 #include "updown_listener.h"
 #include "updown_handler.h"
+#include "updown_executor.h"
 
 #include <daemon.h>
 
@@ -40,6 +41,11 @@ struct private_updown_plugin_t {
 	 * Attribute handler, to pass DNS servers to updown
 	 */
 	updown_handler_t *handler;
+
+	/**
+	 * Executor running the updown scripts
+	 */
+	updown_executor_t *executor;
 };
 
 METHOD(plugin_t, get_name, char*,
@@ -63,13 +69,15 @@ static bool plugin_cb(private_updown_plugin_t *this,
 			charon->attributes->add_handler(charon->attributes,
 											&this->handler->handler);
 		}
-		this->listener = updown_listener_create(this->handler);
+		this->executor = updown_executor_create();
+		this->listener = updown_listener_create(this->handler, this->executor);
 		charon->bus->add_listener(charon->bus, &this->listener->listener);
 	}
 	else
 	{
 		charon->bus->remove_listener(charon->bus, &this->listener->listener);
 		this->listener->destroy(this->listener);
+		this->executor->destroy(this->executor);
 		if (this->handler)
 		{
 			this->handler->destroy(this->handler);
@@ -353,10 +353,12 @@ void vici_end_list(vici_req_t *req)
 	req->b->add(req->b, VICI_LIST_END);
 }
 
-vici_res_t* vici_submit(vici_req_t *req, vici_conn_t *conn)
+/**
+ * Encode and write a request message to the daemon, cleaning up the request
+ */
+static int send_request(vici_req_t *req, vici_conn_t *conn)
 {
 	vici_message_t *message;
-	vici_res_t *res;
 	chunk_t data;
 	u_int32_t len;
 	u_int8_t namelen, op;
@@ -365,7 +367,7 @@ vici_res_t* vici_submit(vici_req_t *req, vici_conn_t *conn)
 	if (!message)
 	{
 		errno = EINVAL;
-		return NULL;
+		return 1;
 	}
 
 	op = VICI_CMD_REQUEST;
@@ -382,13 +384,22 @@ vici_res_t* vici_submit(vici_req_t *req, vici_conn_t *conn)
 		free(req->name);
 		free(req);
 		message->destroy(message);
-		return NULL;
+		return 1;
 	}
 	free(req->name);
 	free(req);
 	message->destroy(message);
+	return 0;
+}
+
+/**
+ * Wait for and return the next command response
+ */
+static vici_res_t* collect_response(vici_conn_t *conn)
+{
+	vici_message_t *message = NULL;
+	vici_res_t *res;
 
-	message = NULL;
 	conn->mutex->lock(conn->mutex);
 	while (conn->wait == WAIT_IDLE)
 	{
@@ -425,6 +436,25 @@ vici_res_t* vici_submit(vici_req_t *req, vici_conn_t *conn)
 	return NULL;
 }
 
+vici_res_t* vici_submit(vici_req_t *req, vici_conn_t *conn)
+{
+	if (send_request(req, conn))
+	{
+		return NULL;
+	}
+	return collect_response(conn);
+}
+
+int vici_queue(vici_req_t *req, vici_conn_t *conn)
+{
+	return send_request(req, conn);
+}
+
+vici_res_t* vici_collect(vici_conn_t *conn)
+{
+	return collect_response(conn);
+}
+
 void vici_free_req(vici_req_t *req)
 {
 	free(req->name);
@@ -52,6 +52,11 @@
  * - vici_submit()
  * - vici_free_req()
  *
+ * To pipeline multiple requests without waiting for each response before
+ * sending the next request, vici_queue() sends a request asynchronously.
+ * Responses get returned in request order by vici_collect(), which must get
+ * called exactly once for each successfully queued request.
+ *
  * If submitting a message is successful, a response message is returned. It
  * can be processed using the following functions:
  *
@@ -260,6 +265,40 @@ void vici_end_list(vici_req_t *req);
  */
 vici_res_t* vici_submit(vici_req_t *req, vici_conn_t *conn);
 
+/**
+ * Queue a request message without waiting for the response.
+ *
+ * This sends a request over the connection, but unlike vici_submit() does
+ * not wait for the response. The response must get collected later using
+ * vici_collect(); responses are delivered in the order the requests have
+ * been queued. Queueing a large number of requests without collecting
+ * responses may deadlock, as both the local and the daemon send buffers can
+ * fill up; collect responses periodically while queueing.
+ *
+ * The request message gets cleaned up by this call and gets invalid.
+ * On error, non-zero is returned and errno is set to:
+ * - EINVAL if the request is invalid/incomplete
+ * - Any other IO related errno
+ *
+ * @param req		request message to send
+ * @param conn		connection context to send message over
+ * @return			0 if request queued successfully
+ */
+int vici_queue(vici_req_t *req, vici_conn_t *conn);
+
+/**
+ * Collect the response for a request queued with vici_queue().
+ *
+ * On error, NULL is returned and errno is set to:
+ * - ENOENT if the command is unknown
+ * - EBADMSG if the response is invalid
+ * - Any other IO related errno
+ *
+ * @param conn		connection context the request was sent over
+ * @return			response message, NULL on error
+ */
+vici_res_t* vici_collect(vici_conn_t *conn);
+
 /**
  * Cancel a request message started.
  *
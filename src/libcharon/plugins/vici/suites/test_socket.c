@@ -34,7 +34,7 @@ static void echo_inbound(void *user, u_int id, chunk_t buf)
 	/* count number of bytes, including the header */
 	data->bytes += buf.len + sizeof(u_int32_t);
 	/* echo back data chunk */
-	data->s->send(data->s, id, chunk_clone(buf));
+	data->s->send(data->s, id, chunk_clone(buf), FALSE);
 }
 
 static void echo_connect(void *user, u_int id)
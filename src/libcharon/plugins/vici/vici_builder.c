@@ -141,23 +141,15 @@ static void vadd_kv_or_li(private_vici_builder_t *this, char *key,
 	va_copy(copy, args);
 	len = vsnprintf(buf, sizeof(buf), fmt, copy);
 	va_end(copy);
-	if (len >= sizeof(buf))
-	{
-		value = chunk_alloc(len + 1);
-		len = vsnprintf(value.ptr, value.len, fmt, args);
-	}
-	else
-	{
-		value = chunk_create(buf, len);
-	}
-
 	if (len < 0)
 	{
 		DBG1(DBG_ENC, "vici builder format print failed");
 		this->error++;
+		return;
 	}
-	else
+	if (len < sizeof(buf))
 	{
+		value = chunk_create(buf, len);
 		if (key)
 		{
 			add(this, VICI_KEY_VALUE, key, value);
@@ -167,9 +159,39 @@ static void vadd_kv_or_li(private_vici_builder_t *this, char *key,
 			add(this, VICI_LIST_ITEM, value);
 		}
 	}
-	if (value.ptr != buf)
-	{
-		free(value.ptr);
+	else
+	{	/* format large values directly into the message buffer, avoiding an
+		 * intermediate allocation and copy */
+		vici_type_t type = key ? VICI_KEY_VALUE : VICI_LIST_ITEM;
+		u_char *out;
+
+		if (len > 0xffff)
+		{
+			DBG1(DBG_ENC, "vici value exceeds size limit (%zd > %u)",
+				 len, 0xffff);
+			this->error++;
+			return;
+		}
+		if (!vici_verify_type(type, this->section, this->list))
+		{
+			this->error++;
+			return;
+		}
+		this->writer->write_uint8(this->writer, type);
+		if (key)
+		{
+			this->writer->write_data8(this->writer, chunk_from_str(key));
+		}
+		out = this->writer->reserve(this->writer, 2 + len + 1);
+		len = vsnprintf((char*)out + 2, len + 1, fmt, args);
+		if (len < 0)
+		{
+			DBG1(DBG_ENC, "vici builder format print failed");
+			this->error++;
+			return;
+		}
+		htoun16(out, len);
+		this->writer->commit(this->writer, 2 + len);
 	}
 }
 
@@ -275,7 +297,7 @@ vici_builder_t *vici_builder_create()
 			.finalize = _finalize,
 			.destroy = _destroy,
 		},
-		.writer = bio_writer_create(0),
+		.writer = bio_writer_create(256),
 	);
 
 	return &this->public;
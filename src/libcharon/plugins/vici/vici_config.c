@@ -184,6 +184,8 @@ static bool parse_rules(parse_rule_t *rules, int count, char *name,
 typedef struct {
 	private_vici_config_t *this;
 	vici_message_t *reply;
+	/** TRUE while loading a batch of connections with the lock held */
+	bool batch;
 } request_data_t;
 
 /**
@@ -1680,17 +1682,16 @@ static void replace_children(private_vici_config_t *this,
 }
 
 /**
- * Merge/replace a peer config with existing configs
+ * Merge/replace a peer config with existing configs, lock is held
  */
-static void merge_config(private_vici_config_t *this, peer_cfg_t *peer_cfg)
+static void merge_config_locked(private_vici_config_t *this,
+								peer_cfg_t *peer_cfg)
 {
 	enumerator_t *enumerator;
 	peer_cfg_t *current;
 	ike_cfg_t *ike_cfg;
 	bool merged = FALSE;
 
-	this->lock->write_lock(this->lock);
-
 	enumerator = this->conns->create_enumerator(this->conns);
 	while (enumerator->enumerate(enumerator, &current))
 	{
@@ -1727,8 +1728,17 @@ static void merge_config(private_vici_config_t *this, peer_cfg_t *peer_cfg)
 		this->conns->insert_last(this->conns, peer_cfg);
 		run_start_actions(this, peer_cfg);
 	}
+}
 
+/**
+ * Merge/replace a peer config with existing configs
+ */
+static void merge_config(private_vici_config_t *this, peer_cfg_t *peer_cfg)
+{
+	this->lock->write_lock(this->lock);
+	merge_config_locked(this, peer_cfg);
 	this->lock->unlock(this->lock);
+	charon->backends->flush_cache(charon->backends);
 }
 
 CALLBACK(config_sn, bool,
@@ -1893,7 +1903,14 @@ CALLBACK(config_sn, bool,
 
 	free_peer_data(&peer);
 
-	merge_config(request->this, peer_cfg);
+	if (request->batch)
+	{	/* load-conns holds the write lock over the whole batch */
+		merge_config_locked(request->this, peer_cfg);
+	}
+	else
+	{
+		merge_config(request->this, peer_cfg);
+	}
 
 	return TRUE;
 }
@@ -1916,6 +1933,87 @@ CALLBACK(load_conn, vici_message_t*,
 	return create_reply(NULL);
 }
 
+CALLBACK(load_conns, vici_message_t*,
+	private_vici_config_t *this, char *name, u_int id, vici_message_t *message)
+{
+	request_data_t request = {
+		.this = this,
+		.batch = TRUE,
+	};
+	bool ok;
+
+	/* apply all connections of the batch under a single lock acquisition,
+	 * avoiding one write lock round trip per connection */
+	this->lock->write_lock(this->lock);
+	ok = message->parse(message, NULL, config_sn, NULL, NULL, &request);
+	this->lock->unlock(this->lock);
+	charon->backends->flush_cache(charon->backends);
+
+	if (!ok)
+	{
+		if (request.reply)
+		{
+			return request.reply;
+		}
+		return create_reply("parsing request failed");
+	}
+	return create_reply(NULL);
+}
+
+CALLBACK(keep_li, bool,
+	linked_list_t *keep, vici_message_t *message, char *name, chunk_t value)
+{
+	char buf[BUF_LEN];
+
+	if (streq(name, "keep"))
+	{
+		if (!vici_stringify(value, buf, sizeof(buf)))
+		{
+			return FALSE;
+		}
+		keep->insert_last(keep, strdup(buf));
+		return TRUE;
+	}
+	return FALSE;
+}
+
+CALLBACK(unload_all_except, vici_message_t*,
+	private_vici_config_t *this, char *name, u_int id, vici_message_t *message)
+{
+	linked_list_t *keep;
+	enumerator_t *enumerator;
+	peer_cfg_t *cfg;
+	u_int removed = 0;
+
+	keep = linked_list_create();
+	if (!message->parse(message, NULL, NULL, NULL, keep_li, keep))
+	{
+		keep->destroy_function(keep, free);
+		return create_reply("parsing request failed");
+	}
+
+	this->lock->write_lock(this->lock);
+	enumerator = this->conns->create_enumerator(this->conns);
+	while (enumerator->enumerate(enumerator, &cfg))
+	{
+		if (keep->find_first(keep, (linked_list_match_t)streq, NULL,
+							 cfg->get_name(cfg)) != SUCCESS)
+		{
+			this->conns->remove_at(this->conns, enumerator);
+			cfg->destroy(cfg);
+			removed++;
+		}
+	}
+	enumerator->destroy(enumerator);
+	this->lock->unlock(this->lock);
+	charon->backends->flush_cache(charon->backends);
+
+	keep->destroy_function(keep, free);
+
+	DBG1(DBG_CFG, "unloaded %u vici connections", removed);
+	return create_reply(NULL);
+}
+
 CALLBACK(unload_conn, vici_message_t*,
 	private_vici_config_t *this, char *name, u_int id, vici_message_t *message)
 {
@@ -1949,6 +2047,7 @@ CALLBACK(unload_conn, vici_message_t*,
 	{
 		return create_reply("connection '%s' not found for unloading", conn);
 	}
+	charon->backends->flush_cache(charon->backends);
 	return create_reply(NULL);
 }
 
@@ -1989,7 +2088,9 @@ static void manage_command(private_vici_config_t *this,
 static void manage_commands(private_vici_config_t *this, bool reg)
 {
 	manage_command(this, "load-conn", load_conn, reg);
+	manage_command(this, "load-conns", load_conns, reg);
 	manage_command(this, "unload-conn", unload_conn, reg);
+	manage_command(this, "unload-all-except", unload_all_except, reg);
 	manage_command(this, "get-conns", get_conns, reg);
 }
 
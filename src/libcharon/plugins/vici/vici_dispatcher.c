@@ -16,6 +16,8 @@
 #include "vici_dispatcher.h"
 #include "vici_socket.h"
 
+#include <fnmatch.h>
+
 #include <bio/bio_reader.h>
 #include <bio/bio_writer.h>
 #include <threading/mutex.h>
@@ -82,14 +84,25 @@ typedef struct {
 typedef struct {
 	/** event name */
 	char *name;
-	/** registered clients, as u_int */
+	/** registered clients, as subscriber_t */
 	array_t *clients;
 	/** event currently in use? */
 	u_int uses;
 } event_t;
 
 /**
- * Send a operation code, optionally with name and message
+ * Client subscribed to an event
+ */
+typedef struct {
+	/** client connection identifier */
+	u_int id;
+	/** filter predicate evaluated at raise time, NULL to get all events */
+	vici_message_t *filter;
+} subscriber_t;
+
+/**
+ * Send a operation code, optionally with name and message.  Events may get
+ * dropped if the client does not keep up with the send queue limit.
  */
 static void send_op(private_vici_dispatcher_t *this, u_int id,
 					vici_operation_t op, char *name, vici_message_t *message)
@@ -116,7 +129,8 @@ static void send_op(private_vici_dispatcher_t *this, u_int id,
 	{
 		writer->write_data(writer, message->get_encoding(message));
 	}
-	this->socket->send(this->socket, id, writer->extract_buf(writer));
+	this->socket->send(this->socket, id, writer->extract_buf(writer),
+					   op == VICI_EVENT);
 	writer->destroy(writer);
 }
 
@@ -124,8 +138,12 @@ static void send_op(private_vici_dispatcher_t *this, u_int id,
  * Register client for event
  */
 static void register_event(private_vici_dispatcher_t *this, char *name,
-						   u_int id)
+						   u_int id, vici_message_t *filter)
 {
+	subscriber_t subscriber = {
+		.id = id,
+		.filter = filter,
+	};
 	event_t *event;
 
 	this->mutex->lock(this->mutex);
@@ -138,7 +156,7 @@ static void register_event(private_vici_dispatcher_t *this, char *name,
 		}
 		if (!event->uses)
 		{
-			array_insert(event->clients, ARRAY_TAIL, &id);
+			array_insert(event->clients, ARRAY_TAIL, &subscriber);
 			break;
 		}
 		this->cond->wait(this->cond, this->mutex);
@@ -147,12 +165,14 @@ static void register_event(private_vici_dispatcher_t *this, char *name,
 
 	if (event)
 	{
-		DBG2(DBG_CFG, "vici client %u registered for: %s", id, name);
+		DBG2(DBG_CFG, "vici client %u registered for: %s%s", id, name,
+			 filter ? " (filtered)" : "");
 		send_op(this, id, VICI_EVENT_CONFIRM, NULL, NULL);
 	}
 	else
 	{
 		DBG1(DBG_CFG, "vici client %u invalid registration: %s", id, name);
+		DESTROY_IF(filter);
 		send_op(this, id, VICI_EVENT_UNKNOWN, NULL, NULL);
 	}
 }
@@ -165,7 +185,7 @@ static void unregister_event(private_vici_dispatcher_t *this, char *name,
 {
 	enumerator_t *enumerator;
 	event_t *event;
-	u_int *current;
+	subscriber_t *current;
 	bool found = FALSE;
 
 	this->mutex->lock(this->mutex);
@@ -181,8 +201,9 @@ static void unregister_event(private_vici_dispatcher_t *this, char *name,
 			enumerator = array_create_enumerator(event->clients);
 			while (enumerator->enumerate(enumerator, &current))
 			{
-				if (*current == id)
+				if (current->id == id)
 				{
+					DESTROY_IF(current->filter);
 					array_remove_at(event->clients, enumerator);
 					found = TRUE;
 					break;
@@ -207,6 +228,101 @@ static void unregister_event(private_vici_dispatcher_t *this, char *name,
 	}
 }
 
+/**
+ * Check if a root level value or section name of an event message matches
+ * a filter pattern. Up/down events carry the connection name as section
+ * name, log events as "ikesa-name" value; both are checked for "name"
+ * filters. Filters on fields an event does not have do not suppress it.
+ */
+static bool matches_pattern(vici_message_t *message, char *key, char *pattern)
+{
+	enumerator_t *enumerator;
+	vici_type_t type;
+	chunk_t value;
+	char *name, buf[512];
+	int depth = 0;
+	bool found = FALSE, matched = FALSE;
+
+	enumerator = message->create_enumerator(message);
+	while (!matched && enumerator->enumerate(enumerator, &type, &name, &value))
+	{
+		switch (type)
+		{
+			case VICI_SECTION_START:
+				if (depth++ == 0 && streq(key, "name"))
+				{
+					found = TRUE;
+					matched = fnmatch(pattern, name, 0) == 0;
+				}
+				break;
+			case VICI_SECTION_END:
+				depth--;
+				break;
+			case VICI_KEY_VALUE:
+				if (depth == 0 &&
+					(streq(name, key) ||
+					 (streq(key, "name") && streq(name, "ikesa-name"))) &&
+					vici_stringify(value, buf, sizeof(buf)))
+				{
+					found = TRUE;
+					matched = fnmatch(pattern, buf, 0) == 0;
+				}
+				break;
+			case VICI_END:
+			default:
+				break;
+		}
+		if (type == VICI_END)
+		{
+			break;
+		}
+	}
+	enumerator->destroy(enumerator);
+
+	return matched || !found;
+}
+
+/**
+ * Check if an event message passes the filter a subscriber installed
+ */
+static bool filter_matches(vici_message_t *filter, vici_message_t *message)
+{
+	enumerator_t *enumerator;
+	vici_type_t type;
+	chunk_t value;
+	char *key, pattern[512];
+	bool pass = TRUE;
+
+	if (!filter)
+	{
+		return TRUE;
+	}
+	enumerator = filter->create_enumerator(filter);
+	while (pass && enumerator->enumerate(enumerator, &type, &key, &value))
+	{
+		if (type == VICI_END)
+		{
+			break;
+		}
+		if (type != VICI_KEY_VALUE ||
+			!vici_stringify(value, pattern, sizeof(pattern)))
+		{
+			continue;
+		}
+		if (streq(key, "level"))
+		{	/* maximum log level to forward, for log events */
+			pass = message->get_int(message, 0, "level") <= atoi(pattern);
+		}
+		else
+		{
+			pass = matches_pattern(message, key, pattern);
+		}
+	}
+	enumerator->destroy(enumerator);
+
+	return pass;
+}
+
 /**
  * Data to release on thread cancellation
  */
@@ -298,7 +414,17 @@ CALLBACK(inbound, void,
 				if (reader->read_data8(reader, &chunk) &&
 					vici_stringify(chunk, name, sizeof(name)))
 				{
-					register_event(this, name, id);
+					vici_message_t *filter = NULL;
+
+					/* optional trailing message with filter predicates */
+					if (reader->remaining(reader) &&
+						reader->read_data(reader, reader->remaining(reader),
+										  &chunk))
+					{
+						filter = vici_message_create_from_data(
+												chunk_clone(chunk), TRUE);
+					}
+					register_event(this, name, id, filter);
 				}
 				else
 				{
@@ -356,7 +482,7 @@ CALLBACK(disconnect, void,
 {
 	enumerator_t *events, *ids;
 	event_t *event;
-	u_int *current;
+	subscriber_t *current;
 
 	/* deregister client from all events */
 	this->mutex->lock(this->mutex);
@@ -370,8 +496,9 @@ CALLBACK(disconnect, void,
 		ids = array_create_enumerator(event->clients);
 		while (ids->enumerate(ids, &current))
 		{
-			if (id == *current)
+			if (id == current->id)
 			{
+				DESTROY_IF(current->filter);
 				array_remove_at(event->clients, ids);
 			}
 		}
@@ -425,7 +552,7 @@ METHOD(vici_dispatcher_t, manage_event, void,
 	{
 		INIT(event,
 			.name = strdup(name),
-			.clients = array_create(sizeof(u_int), 0),
+			.clients = array_create(sizeof(subscriber_t), 0),
 		);
 		event = this->events->put(this->events, event->name, event);
 	}
@@ -435,10 +562,16 @@ METHOD(vici_dispatcher_t, manage_event, void,
 	}
 	if (event)
 	{
+		subscriber_t subscriber;
+
 		while (event->uses)
 		{
 			this->cond->wait(this->cond, this->mutex);
 		}
+		while (array_remove(event->clients, ARRAY_TAIL, &subscriber))
+		{
+			DESTROY_IF(subscriber.filter);
+		}
 		array_destroy(event->clients);
 		free(event->name);
 		free(event);
@@ -452,7 +585,7 @@ METHOD(vici_dispatcher_t, raise_event, void,
 {
 	enumerator_t *enumerator;
 	event_t *event;
-	u_int *current;
+	subscriber_t *current;
 
 	this->mutex->lock(this->mutex);
 	event = this->events->get(this->events, name);
@@ -464,9 +597,10 @@ METHOD(vici_dispatcher_t, raise_event, void,
 		enumerator = array_create_enumerator(event->clients);
 		while (enumerator->enumerate(enumerator, &current))
 		{
-			if (id == 0 || id == *current)
+			if ((id == 0 || id == current->id) &&
+				filter_matches(current->filter, message))
 			{
-				send_op(this, *current, VICI_EVENT, name, message);
+				send_op(this, current->id, VICI_EVENT, name, message);
 			}
 		}
 		enumerator->destroy(enumerator);
@@ -482,6 +616,12 @@ METHOD(vici_dispatcher_t, raise_event, void,
 	message->destroy(message);
 }
 
+METHOD(vici_dispatcher_t, create_stats_enumerator, enumerator_t*,
+	private_vici_dispatcher_t *this)
+{
+	return this->socket->create_stats_enumerator(this->socket);
+}
+
 METHOD(vici_dispatcher_t, destroy, void,
 	private_vici_dispatcher_t *this)
 {
@@ -505,6 +645,7 @@ vici_dispatcher_t *vici_dispatcher_create(char *uri)
 			.manage_command = _manage_command,
 			.manage_event = _manage_event,
 			.raise_event = _raise_event,
+			.create_stats_enumerator = _create_stats_enumerator,
 			.destroy = _destroy,
 		},
 		.cmds = hashtable_create(hashtable_hash_str, hashtable_equals_str, 1),
@@ -22,6 +22,7 @@
 #define VICI_DISPATCHER_H_
 
 #include "vici_message.h"
+#include "vici_socket.h"
 
 typedef struct vici_dispatcher_t vici_dispatcher_t;
 typedef enum vici_operation_t vici_operation_t;
@@ -105,6 +106,13 @@ struct vici_dispatcher_t {
 	void (*raise_event)(vici_dispatcher_t *this, char *name, u_int id,
 						vici_message_t *message);
 
+	/**
+	 * Enumerate send queue statistics of connected clients.
+	 *
+	 * @return				enumerator over vici_queue_stats_t*
+	 */
+	enumerator_t* (*create_stats_enumerator)(vici_dispatcher_t *this);
+
 	/**
 	 * Destroy a vici_dispatcher_t.
 	 */
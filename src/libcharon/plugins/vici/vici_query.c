@@ -26,6 +26,8 @@
 #endif
 
 #include <daemon.h>
+#include <threading/lock_stats.h>
+#include <collections/linked_list.h>
 
 typedef struct private_vici_query_t private_vici_query_t;
 
@@ -292,6 +294,116 @@ static void list_ike(private_vici_query_t *this, vici_builder_t *b,
 	list_task_queue(this, b, ike_sa, TASK_QUEUE_PASSIVE, "tasks-passive");
 }
 
+/**
+ * Minimal IKE_SA state copied out while the SA is held, formatted later
+ */
+typedef struct {
+	/** cloned IKE_SA name */
+	char *name;
+	/** IKE_SA unique identifier */
+	u_int unique_id;
+	/** IKE version */
+	ike_version_t version;
+	/** IKE_SA state */
+	ike_sa_state_t state;
+	/** printed local IKE endpoint */
+	char local_host[64];
+	/** printed remote IKE endpoint */
+	char remote_host[64];
+	/** printed local identity */
+	char local_id[256];
+	/** printed remote identity */
+	char remote_id[256];
+	/** TRUE if we are the initiator */
+	bool initiator;
+	/** initiator SPI */
+	u_int64_t init_spi;
+	/** responder SPI */
+	u_int64_t resp_spi;
+	/** seconds the IKE_SA is established, 0 if not established */
+	int64_t established;
+	/** number of CHILD_SAs */
+	u_int children;
+} sa_snapshot_t;
+
+/**
+ * Copy the minimal state of an IKE_SA into a snapshot
+ */
+static sa_snapshot_t *take_snapshot(ike_sa_t *ike_sa, time_t now)
+{
+	sa_snapshot_t *snap;
+	enumerator_t *enumerator;
+	child_sa_t *child_sa;
+	ike_sa_id_t *id;
+
+	INIT(snap,
+		.name = strdup(ike_sa->get_name(ike_sa)),
+		.unique_id = ike_sa->get_unique_id(ike_sa),
+		.version = ike_sa->get_version(ike_sa),
+		.state = ike_sa->get_state(ike_sa),
+	);
+	snprintf(snap->local_host, sizeof(snap->local_host), "%H",
+			 ike_sa->get_my_host(ike_sa));
+	snprintf(snap->remote_host, sizeof(snap->remote_host), "%H",
+			 ike_sa->get_other_host(ike_sa));
+	snprintf(snap->local_id, sizeof(snap->local_id), "%Y",
+			 ike_sa->get_my_id(ike_sa));
+	snprintf(snap->remote_id, sizeof(snap->remote_id), "%Y",
+			 ike_sa->get_other_id(ike_sa));
+	id = ike_sa->get_id(ike_sa);
+	snap->initiator = id->is_initiator(id);
+	snap->init_spi = id->get_initiator_spi(id);
+	snap->resp_spi = id->get_responder_spi(id);
+	if (ike_sa->get_state(ike_sa) == IKE_ESTABLISHED)
+	{
+		snap->established = (int64_t)(now -
+							ike_sa->get_statistic(ike_sa, STAT_ESTABLISHED));
+	}
+	enumerator = ike_sa->create_child_sa_enumerator(ike_sa);
+	while (enumerator->enumerate(enumerator, &child_sa))
+	{
+		snap->children++;
+	}
+	enumerator->destroy(enumerator);
+	return snap;
+}
+
+/**
+ * Raise a list-sa event from a snapshot, then destroy it
+ */
+static void raise_snapshot(private_vici_query_t *this, u_int id,
+						   sa_snapshot_t *snap)
+{
+	vici_builder_t *b;
+
+	b = vici_builder_create();
+	b->begin_section(b, snap->name);
+	b->add_kv(b, "uniqueid", "%u", snap->unique_id);
+	b->add_kv(b, "version", "%u", snap->version);
+	b->add_kv(b, "state", "%N", ike_sa_state_names, snap->state);
+	b->add_kv(b, "local-host", "%s", snap->local_host);
+	b->add_kv(b, "local-id", "%s", snap->local_id);
+	b->add_kv(b, "remote-host", "%s", snap->remote_host);
+	b->add_kv(b, "remote-id", "%s", snap->remote_id);
+	if (snap->initiator)
+	{
+		b->add_kv(b, "initiator", "yes");
+	}
+	b->add_kv(b, "initiator-spi", "%.16"PRIx64, snap->init_spi);
+	b->add_kv(b, "responder-spi", "%.16"PRIx64, snap->resp_spi);
+	if (snap->established)
+	{
+		b->add_kv(b, "established", "%"PRId64, snap->established);
+	}
+	b->add_kv(b, "children", "%u", snap->children);
+	b->end_section(b);
+
+	this->dispatcher->raise_event(this->dispatcher, "list-sa", id,
+								  b->finalize(b));
+	free(snap->name);
+	free(snap);
+}
+
 CALLBACK(list_sas, vici_message_t*,
 	private_vici_query_t *this, char *name, u_int id, vici_message_t *request)
 {
@@ -299,15 +411,24 @@ CALLBACK(list_sas, vici_message_t*,
 	enumerator_t *isas, *csas;
 	ike_sa_t *ike_sa;
 	child_sa_t *child_sa;
+	linked_list_t *snapshots = NULL;
+	sa_snapshot_t *snap;
 	time_t now;
 	char *ike;
-	u_int ike_id;
-	bool bl;
+	u_int ike_id, from, to;
+	bool bl, brief;
 
 	bl = request->get_str(request, NULL, "noblock") == NULL;
+	brief = request->get_str(request, NULL, "brief") != NULL;
 	ike = request->get_str(request, NULL, "ike");
 	ike_id = request->get_int(request, 0, "ike-id");
+	from = request->get_int(request, 0, "ike-id-from");
+	to = request->get_int(request, 0, "ike-id-to");
 
+	if (brief)
+	{
+		snapshots = linked_list_create();
+	}
 	isas = charon->controller->create_ike_sa_enumerator(charon->controller, bl);
 	while (isas->enumerate(isas, &ike_sa))
 	{
@@ -319,9 +440,24 @@ CALLBACK(list_sas, vici_message_t*,
 		{
 			continue;
 		}
+		if (from && ike_sa->get_unique_id(ike_sa) < from)
+		{
+			continue;
+		}
+		if (to && ike_sa->get_unique_id(ike_sa) > to)
+		{
+			continue;
+		}
 
 		now = time_monotonic(NULL);
 
+		if (brief)
+		{	/* copy out the minimal state and release the IKE_SA right away,
+			 * events get formatted and sent without any SA held */
+			snapshots->insert_last(snapshots, take_snapshot(ike_sa, now));
+			continue;
+		}
+
 		b = vici_builder_create();
 		b->begin_section(b, ike_sa->get_name(ike_sa));
 
@@ -345,6 +481,15 @@ CALLBACK(list_sas, vici_message_t*,
 	}
 	isas->destroy(isas);
 
+	if (snapshots)
+	{
+		while (snapshots->remove_first(snapshots, (void**)&snap) == SUCCESS)
+		{
+			raise_snapshot(this, id, snap);
+		}
+		snapshots->destroy(snapshots);
+	}
+
 	b = vici_builder_create();
 	return b->finalize(b);
 }
@@ -857,13 +1002,114 @@ CALLBACK(sum_usage, void,
 	b->end_section(b);
 }
 
+/**
+ * Callback function writing a sampled allocation trace
+ */
+CALLBACK(dump_leak, void,
+	vici_builder_t *b, int count, size_t bytes, backtrace_t *bt, bool detailed)
+{
+	enumerator_t *enumerator;
+	char buf[512], frame[32];
+	void *addr;
+	size_t len = 0;
+
+	buf[0] = '\0';
+	enumerator = bt->create_frame_enumerator(bt);
+	while (enumerator->enumerate(enumerator, &addr))
+	{
+		snprintf(frame, sizeof(frame), "%s%p", len ? " " : "", addr);
+		len += snprintf(buf + len, sizeof(buf) - len, "%s", frame);
+		if (len >= sizeof(buf))
+		{
+			break;
+		}
+	}
+	enumerator->destroy(enumerator);
+
+	b->add_li(b, "%d allocs, %zu bytes: %s", count, bytes, buf);
+}
+
+CALLBACK(leak_sampling, vici_message_t*,
+	private_vici_query_t *this, char *name, u_int id, vici_message_t *request)
+{
+	vici_builder_t *b;
+	int rate;
+
+	b = vici_builder_create();
+	if (!lib->leak_detective)
+	{
+		b->add_kv(b, "errmsg", "leak detective not available");
+		return b->finalize(b);
+	}
+	rate = request->get_int(request, -1, "rate");
+	if (rate >= 0)
+	{
+		lib->leak_detective->set_sampling(lib->leak_detective, rate);
+	}
+	b->add_kv(b, "sampling", "%u",
+			  lib->leak_detective->get_sampling(lib->leak_detective));
+	if (streq(request->get_str(request, "no", "dump"), "yes"))
+	{
+		b->begin_list(b, "traces");
+		lib->leak_detective->usage(lib->leak_detective, dump_leak, NULL, b);
+		b->end_list(b);
+	}
+	return b->finalize(b);
+}
+
+CALLBACK(get_metrics, vici_message_t*,
+	private_vici_query_t *this, char *name, u_int id, vici_message_t *request)
+{
+	vici_builder_t *b;
+	u_int load = 0;
+	int i;
+
+	b = vici_builder_create();
+
+	b->begin_section(b, "counters");
+	for (i = 0; i < METRIC_MAX; i++)
+	{
+		b->add_kv(b, enum_to_name(metric_names, i), "%" PRIu64,
+				  lib->metrics->get(lib->metrics, i));
+	}
+	b->end_section(b);
+
+	for (i = 0; i < JOB_PRIO_MAX; i++)
+	{
+		load += lib->processor->get_job_load(lib->processor, i);
+	}
+	b->begin_section(b, "gauges");
+	b->add_kv(b, "job-load", "%u", load);
+	b->add_kv(b, "jobs-scheduled", "%u",
+		lib->scheduler->get_job_load(lib->scheduler));
+	b->add_kv(b, "ike-sas", "%u",
+		charon->ike_sa_manager->get_count(charon->ike_sa_manager));
+	b->add_kv(b, "ike-sas-half-open", "%u",
+		charon->ike_sa_manager->get_half_open_count(charon->ike_sa_manager,
+													NULL));
+#ifdef HAVE_MALLINFO
+	{
+		struct mallinfo mi = mallinfo();
+
+		b->add_kv(b, "mem-used", "%u", mi.uordblks);
+		b->add_kv(b, "mem-free", "%u", mi.fordblks);
+	}
+#endif /* HAVE_MALLINFO */
+	b->end_section(b);
+
+	return b->finalize(b);
+}
+
 CALLBACK(stats, vici_message_t*,
 	private_vici_query_t *this, char *name, u_int id, vici_message_t *request)
 {
 	vici_builder_t *b;
 	enumerator_t *enumerator;
 	plugin_t *plugin;
+	ike_sa_checkout_stats_t checkouts;
+	vici_queue_stats_t *qstats;
 	time_t since, now;
+	char buf[16];
 	int i;
 
 	b = vici_builder_create();
@@ -901,6 +1147,38 @@ CALLBACK(stats, vici_message_t*,
 	b->add_kv(b, "scheduled", "%d",
 		lib->scheduler->get_job_load(lib->scheduler));
 
+	b->begin_section(b, "clients");
+	enumerator = this->dispatcher->create_stats_enumerator(this->dispatcher);
+	while (enumerator->enumerate(enumerator, &qstats))
+	{
+		snprintf(buf, sizeof(buf), "%u", qstats->id);
+		b->begin_section(b, buf);
+		b->add_kv(b, "queued", "%u", qstats->queued);
+		b->add_kv(b, "dropped", "%u", qstats->dropped);
+		b->end_section(b);
+	}
+	enumerator->destroy(enumerator);
+	b->end_section(b);
+
+	if (lock_stats_enabled())
+	{
+		u_int contended, waited;
+		char site[32];
+		void *addr;
+		int idx = 0;
+
+		b->begin_section(b, "locks");
+		while (lock_stats_get(&idx, &addr, &contended, &waited))
+		{
+			snprintf(site, sizeof(site), "%p", addr);
+			b->begin_section(b, site);
+			b->add_kv(b, "contended", "%u", contended);
+			b->add_kv(b, "wait-us", "%u", waited);
+			b->end_section(b);
+		}
+		b->end_section(b);
+	}
+
 	b->begin_section(b, "ikesas");
 	b->add_kv(b, "total", "%u",
 		charon->ike_sa_manager->get_count(charon->ike_sa_manager));
@@ -909,6 +1187,16 @@ CALLBACK(stats, vici_message_t*,
 													NULL));
 	b->end_section(b);
 
+	charon->ike_sa_manager->get_checkout_stats(charon->ike_sa_manager,
+											   &checkouts);
+	b->begin_section(b, "checkouts");
+	b->add_kv(b, "total", "%u", checkouts.checkouts);
+	b->add_kv(b, "waited", "%u", checkouts.waits);
+	b->add_kv(b, "wait-ms", "%u", checkouts.wait_time_ms);
+	b->add_kv(b, "max-wait-ms", "%u", checkouts.max_wait_ms);
+	b->add_kv(b, "waiting", "%u", checkouts.waiting);
+	b->end_section(b);
+
 	b->begin_list(b, "plugins");
 	enumerator = lib->plugins->create_plugin_enumerator(lib->plugins);
 	while (enumerator->enumerate(enumerator, &plugin, NULL))
@@ -1013,6 +1301,8 @@ static void manage_commands(private_vici_query_t *this, bool reg)
 	manage_command(this, "list-certs", list_certs, reg);
 	manage_command(this, "version", version, reg);
 	manage_command(this, "stats", stats, reg);
+	manage_command(this, "get-metrics", get_metrics, reg);
+	manage_command(this, "leak-sampling", leak_sampling, reg);
 }
 
 METHOD(vici_query_t, destroy, void,
@@ -76,8 +76,18 @@ struct private_vici_socket_t {
 	 * mutex for client connections
 	 */
 	mutex_t *mutex;
+
+	/**
+	 * Maximum number of messages queued per connection, 0 for no limit
+	 */
+	u_int queue_limit;
 };
 
+/**
+ * Maximum number of queued messages collected into a single writev() call
+ */
+#define MAX_BATCH_MSGS 16
+
 /**
  * Data to securely reference an entry
  */
@@ -126,6 +136,10 @@ typedef struct {
 	int writers;
 	/** condvar to wait for usage  */
 	condvar_t *cond;
+	/** messages dropped due to the send queue limit */
+	u_int dropped;
+	/** currently dropping droppable messages? */
+	bool congested;
 } entry_t;
 
 /**
@@ -301,61 +315,73 @@ static void disconnect(private_vici_socket_t *this, u_int id)
 }
 
 /**
- * Write queued output data
+ * Write queued output data, batching messages into vectored writes
  */
 static bool do_write(private_vici_socket_t *this, entry_t *entry,
 					 stream_t *stream)
 {
+	struct iovec iov[2 * MAX_BATCH_MSGS];
 	msg_buf_t *out;
-	ssize_t len;
+	ssize_t len, part;
+	int iovcnt, i;
 
-	while (array_get(entry->out, ARRAY_HEAD, &out))
+	while (array_count(entry->out))
 	{
-		/* write header */
-		while (out->hdrlen < sizeof(out->hdr))
+		/* gather pending headers and buffers of multiple messages */
+		iovcnt = 0;
+		for (i = 0; i < array_count(entry->out) && i < MAX_BATCH_MSGS; i++)
 		{
-			len = stream->write(stream, out->hdr + out->hdrlen,
-								sizeof(out->hdr) - out->hdrlen, FALSE);
-			if (len == 0)
+			array_get(entry->out, i, &out);
+			if (out->hdrlen < sizeof(out->hdr))
 			{
-				return FALSE;
+				iov[iovcnt].iov_base = out->hdr + out->hdrlen;
+				iov[iovcnt].iov_len = sizeof(out->hdr) - out->hdrlen;
+				iovcnt++;
 			}
-			if (len < 0)
+			if (out->buf.len > out->done)
 			{
-				if (errno == EWOULDBLOCK)
-				{
-					return TRUE;
-				}
-				DBG1(DBG_CFG, "vici header write error: %s", strerror(errno));
-				return FALSE;
+				iov[iovcnt].iov_base = out->buf.ptr + out->done;
+				iov[iovcnt].iov_len = out->buf.len - out->done;
+				iovcnt++;
 			}
-			out->hdrlen += len;
 		}
 
-		/* write buffer buffer */
-		while (out->buf.len > out->done)
+		len = stream->writev(stream, iov, iovcnt, FALSE);
+		if (len == 0)
 		{
-			len = stream->write(stream, out->buf.ptr + out->done,
-								out->buf.len - out->done, FALSE);
-			if (len == 0)
-			{
-				DBG1(DBG_CFG, "premature vici disconnect");
-				return FALSE;
-			}
-			if (len < 0)
+			DBG1(DBG_CFG, "premature vici disconnect");
+			return FALSE;
+		}
+		if (len < 0)
+		{
+			if (errno == EWOULDBLOCK)
 			{
-				if (errno == EWOULDBLOCK)
-				{
-					return TRUE;
-				}
-				DBG1(DBG_CFG, "vici write error: %s", strerror(errno));
-				return FALSE;
+				return TRUE;
 			}
-			out->done += len;
+			DBG1(DBG_CFG, "vici write error: %s", strerror(errno));
+			return FALSE;
 		}
 
-		if (array_remove(entry->out, ARRAY_HEAD, &out))
+		/* distribute written bytes over the queued messages */
+		while (array_get(entry->out, ARRAY_HEAD, &out))
 		{
+			if (out->hdrlen < sizeof(out->hdr))
+			{
+				part = min(len, sizeof(out->hdr) - out->hdrlen);
+				out->hdrlen += part;
+				len -= part;
+			}
+			if (out->buf.len > out->done)
+			{
+				part = min(len, out->buf.len - out->done);
+				out->done += part;
+				len -= part;
+			}
+			if (out->hdrlen < sizeof(out->hdr) || out->buf.len > out->done)
+			{	/* partially written message, try again later */
+				break;
+			}
+			array_remove(entry->out, ARRAY_HEAD, &out);
 			chunk_clear(&out->buf);
 			free(out);
 		}
@@ -591,7 +617,7 @@ CALLBACK(enable_writer, job_requeue_t,
 }
 
 METHOD(vici_socket_t, send_, void,
-	private_vici_socket_t *this, u_int id, chunk_t msg)
+	private_vici_socket_t *this, u_int id, chunk_t msg, bool droppable)
 {
 	if (msg.len <= VICI_MESSAGE_SIZE_MAX)
 	{
@@ -602,6 +628,23 @@ METHOD(vici_socket_t, send_, void,
 		entry = find_entry(this, NULL, id, FALSE, TRUE);
 		if (entry)
 		{
+			if (droppable && this->queue_limit &&
+				array_count(entry->out) >= this->queue_limit)
+			{	/* client does not keep up, drop the message instead of
+				 * buffering it unboundedly */
+				if (!entry->congested)
+				{
+					DBG1(DBG_CFG, "vici send queue of client %u full, "
+						 "dropping messages", entry->id);
+					entry->congested = TRUE;
+				}
+				entry->dropped++;
+				put_entry(this, entry, FALSE, TRUE);
+				chunk_clear(&msg);
+				return;
+			}
+			entry->congested = FALSE;
+
 			INIT(out,
 				.buf = msg,
 			);
@@ -634,6 +677,53 @@ METHOD(vici_socket_t, send_, void,
 	}
 }
 
+/**
+ * Destroy a snapshot of queue statistics
+ */
+static void destroy_stats_list(linked_list_t *list)
+{
+	list->destroy_function(list, free);
+}
+
+/**
+ * Pass through enumerated statistic entries
+ */
+static bool stats_filter(void *unused, vici_queue_stats_t **in,
+						 vici_queue_stats_t **out)
+{
+	*out = *in;
+	return TRUE;
+}
+
+METHOD(vici_socket_t, create_stats_enumerator, enumerator_t*,
+	private_vici_socket_t *this)
+{
+	enumerator_t *enumerator;
+	linked_list_t *list;
+	vici_queue_stats_t *stats;
+	entry_t *entry;
+
+	list = linked_list_create();
+
+	this->mutex->lock(this->mutex);
+	enumerator = this->connections->create_enumerator(this->connections);
+	while (enumerator->enumerate(enumerator, &entry))
+	{
+		INIT(stats,
+			.id = entry->id,
+			.queued = array_count(entry->out),
+			.dropped = entry->dropped,
+		);
+		list->insert_last(list, stats);
+	}
+	enumerator->destroy(enumerator);
+	this->mutex->unlock(this->mutex);
+
+	return enumerator_create_filter(list->create_enumerator(list),
+									(void*)stats_filter, list,
+									(void*)destroy_stats_list);
+}
+
 METHOD(vici_socket_t, destroy, void,
 	private_vici_socket_t *this)
 {
@@ -655,6 +745,7 @@ vici_socket_t *vici_socket_create(char *uri, vici_inbound_cb_t inbound,
 	INIT(this,
 		.public = {
 			.send = _send_,
+			.create_stats_enumerator = _create_stats_enumerator,
 			.destroy = _destroy,
 		},
 		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
@@ -663,6 +754,8 @@ vici_socket_t *vici_socket_create(char *uri, vici_inbound_cb_t inbound,
 		.connect = connect,
 		.disconnect = disconnect,
 		.user = user,
+		.queue_limit = lib->settings->get_int(lib->settings,
+								"%s.plugins.vici.send_queue_max", 0, lib->ns),
 	);
 
 	this->service = lib->streams->create_service(lib->streams, uri, 3);
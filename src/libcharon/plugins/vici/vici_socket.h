@@ -29,6 +29,19 @@
 #define VICI_MESSAGE_SIZE_MAX (512 * 1024)
 
 typedef struct vici_socket_t vici_socket_t;
+typedef struct vici_queue_stats_t vici_queue_stats_t;
+
+/**
+ * Send queue statistics of a client connection.
+ */
+struct vici_queue_stats_t {
+	/** unique client connection identifier */
+	u_int id;
+	/** messages currently queued for the client */
+	u_int queued;
+	/** messages dropped due to the send queue limit */
+	u_int dropped;
+};
 
 /**
  * Callback function for dispatching inbound client messages.
@@ -68,10 +81,24 @@ struct vici_socket_t {
 	/**
 	 * Send a message to a client identified by connection identifier.
 	 *
+	 * Droppable messages get discarded (and accounted) instead of queued
+	 * if the client does not keep up with the configured send queue limit.
+	 * Non-droppable messages are queued unconditionally.
+	 *
 	 * @param id		unique client connection identifier
 	 * @param data		data to send to client, gets owned
+	 * @param droppable	TRUE if the message may be dropped on congestion
+	 */
+	void (*send)(vici_socket_t *this, u_int id, chunk_t data, bool droppable);
+
+	/**
+	 * Enumerate send queue statistics of client connections.
+	 *
+	 * The enumerator operates on a snapshot taken during this call.
+	 *
+	 * @return			enumerator over vici_queue_stats_t*
 	 */
-	void (*send)(vici_socket_t *this, u_int id, chunk_t data);
+	enumerator_t* (*create_stats_enumerator)(vici_socket_t *this);
 
 	/**
 	 * Destroy socket.
@@ -17,9 +17,44 @@
 
 #include <daemon.h>
 #include <collections/hashtable.h>
-#include <threading/rwlock.h>
+#include <collections/linked_list.h>
+#include <threading/mutex.h>
+#include <threading/spinlock.h>
 
 typedef struct private_whitelist_listener_t private_whitelist_listener_t;
+typedef struct snapshot_t snapshot_t;
+
+/**
+ * Immutable snapshot of the whitelist, shared by readers without locking.
+ *
+ * Updates never modify a published snapshot, but build a copy and swap it
+ * in. Identities removed by an update are attached to the replaced snapshot,
+ * which holds a reference to its successor; as a snapshot hence can not get
+ * destroyed before all older snapshots are gone, retired identities are
+ * released only once no reader can see them anymore.
+ */
+struct snapshot_t {
+
+	/**
+	 * References by readers, the listener and a replaced predecessor
+	 */
+	refcount_t refs;
+
+	/**
+	 * Whitelisted identities, not owned by the snapshot
+	 */
+	hashtable_t *ids;
+
+	/**
+	 * Identities retired when this snapshot was replaced, owned
+	 */
+	linked_list_t *retired;
+
+	/**
+	 * Snapshot that replaced this one, destroyed only afterwards
+	 */
+	snapshot_t *successor;
+};
 
 /**
  * Private data of an whitelist_listener_t object.
@@ -32,14 +67,19 @@ struct private_whitelist_listener_t {
 	whitelist_listener_t public;
 
 	/**
-	 * Lock for hashtable
+	 * Currently published snapshot
 	 */
-	rwlock_t *lock;
+	snapshot_t *current;
 
 	/**
-	 * Hashtable with whitelisted identities
+	 * Short term lock readers use to grab the current snapshot
 	 */
-	hashtable_t *ids;
+	spinlock_t *spinlock;
+
+	/**
+	 * Lock serializing updates
+	 */
+	mutex_t *mutex;
 
 	/**
 	 * Whitelist checking enabled
@@ -63,6 +103,88 @@ static bool equals(identification_t *a, identification_t *b)
 	return a->equals(a, b);
 }
 
+/**
+ * Create a snapshot, copying the identity pointers of a source table
+ */
+static snapshot_t *snapshot_create(hashtable_t *source)
+{
+	identification_t *key, *value;
+	enumerator_t *enumerator;
+	snapshot_t *snap;
+
+	INIT(snap,
+		.refs = 1,
+		.ids = hashtable_create((hashtable_hash_t)hash,
+								(hashtable_equals_t)equals,
+								source ? max(source->get_count(source), 8) : 32),
+		.retired = linked_list_create(),
+	);
+	if (source)
+	{
+		enumerator = source->create_enumerator(source);
+		while (enumerator->enumerate(enumerator, &key, &value))
+		{
+			snap->ids->put(snap->ids, value, value);
+		}
+		enumerator->destroy(enumerator);
+	}
+	return snap;
+}
+
+/**
+ * Release a snapshot reference, destroying the chain if it was the last
+ */
+static void snapshot_release(snapshot_t *snap)
+{
+	snapshot_t *successor;
+
+	while (snap && ref_put(&snap->refs))
+	{
+		successor = snap->successor;
+		snap->retired->destroy_offset(snap->retired,
+									  offsetof(identification_t, destroy));
+		snap->ids->destroy(snap->ids);
+		free(snap);
+		/* drop the reference held on the successor */
+		snap = successor;
+	}
+}
+
+/**
+ * Get a reference to the currently published snapshot
+ */
+static snapshot_t *snapshot_get(private_whitelist_listener_t *this)
+{
+	snapshot_t *snap;
+
+	this->spinlock->lock(this->spinlock);
+	snap = this->current;
+	ref_get(&snap->refs);
+	this->spinlock->unlock(this->spinlock);
+	return snap;
+}
+
+/**
+ * Publish an updated snapshot, with the update mutex held
+ */
+static void publish(private_whitelist_listener_t *this, snapshot_t *snap)
+{
+	snapshot_t *old;
+
+	old = this->current;
+	/* chain the replaced snapshot to its successor before readers can
+	 * release the last reference to it */
+	old->successor = snap;
+	ref_get(&snap->refs);
+
+	this->spinlock->lock(this->spinlock);
+	this->current = snap;
+	this->spinlock->unlock(this->spinlock);
+
+	/* drop the listeners reference to the replaced snapshot */
+	snapshot_release(old);
+}
+
 METHOD(listener_t, authorize, bool,
 	private_whitelist_listener_t *this, ike_sa_t *ike_sa,
 	bool final, bool *success)
@@ -72,6 +194,7 @@ METHOD(listener_t, authorize, bool,
 	{
 		bool whitelisted = FALSE;
 		identification_t *id;
+		snapshot_t *snap;
 		auth_cfg_t *auth;
 
 		auth = ike_sa->get_auth_cfg(ike_sa, FALSE);
@@ -83,9 +206,9 @@ METHOD(listener_t, authorize, bool,
 		}
 		if (id)
 		{
-			this->lock->read_lock(this->lock);
-			whitelisted = this->ids->get(this->ids, id) != NULL;
-			this->lock->unlock(this->lock);
+			snap = snapshot_get(this);
+			whitelisted = snap->ids->get(snap->ids, id) != NULL;
+			snapshot_release(snap);
 		}
 		if (whitelisted)
 		{
@@ -103,26 +226,46 @@ METHOD(listener_t, authorize, bool,
 METHOD(whitelist_listener_t, add, void,
 	private_whitelist_listener_t *this, identification_t *id)
 {
+	identification_t *existing;
+	snapshot_t *snap;
+
 	id = id->clone(id);
-	this->lock->write_lock(this->lock);
-	id = this->ids->put(this->ids, id, id);
-	this->lock->unlock(this->lock);
-	DESTROY_IF(id);
+	this->mutex->lock(this->mutex);
+	snap = snapshot_create(this->current->ids);
+	existing = snap->ids->put(snap->ids, id, id);
+	if (existing)
+	{
+		this->current->retired->insert_last(this->current->retired, existing);
+	}
+	publish(this, snap);
+	this->mutex->unlock(this->mutex);
 }
 
 METHOD(whitelist_listener_t, remove_, void,
 	private_whitelist_listener_t *this, identification_t *id)
 {
-	this->lock->write_lock(this->lock);
-	id = this->ids->remove(this->ids, id);
-	this->lock->unlock(this->lock);
-	DESTROY_IF(id);
+	identification_t *found;
+	snapshot_t *snap;
+
+	this->mutex->lock(this->mutex);
+	snap = snapshot_create(this->current->ids);
+	found = snap->ids->remove(snap->ids, id);
+	if (found)
+	{
+		this->current->retired->insert_last(this->current->retired, found);
+		publish(this, snap);
+	}
+	else
+	{	/* nothing changed, discard the copy */
+		snapshot_release(snap);
+	}
+	this->mutex->unlock(this->mutex);
 }
 
 /**
  * Enumerator filter, from hashtable (key, value) to single identity
  */
-static bool whitelist_filter(rwlock_t *lock, identification_t **key,
+static bool whitelist_filter(snapshot_t *snap, identification_t **key,
 							 identification_t **id, identification_t **value)
 {
 	*id = *value;
@@ -132,30 +275,44 @@ static bool whitelist_filter(rwlock_t *lock, identification_t **key,
 METHOD(whitelist_listener_t, create_enumerator, enumerator_t*,
 	private_whitelist_listener_t *this)
 {
-	this->lock->read_lock(this->lock);
-	return enumerator_create_filter(this->ids->create_enumerator(this->ids),
-									(void*)whitelist_filter, this->lock,
-									(void*)this->lock->unlock);
+	snapshot_t *snap;
+
+	snap = snapshot_get(this);
+	return enumerator_create_filter(snap->ids->create_enumerator(snap->ids),
+									(void*)whitelist_filter, snap,
+									(void*)snapshot_release);
 }
 
 METHOD(whitelist_listener_t, flush, void,
 	private_whitelist_listener_t *this, identification_t *id)
 {
-	enumerator_t *enumerator;
 	identification_t *key, *value;
+	enumerator_t *enumerator;
+	snapshot_t *snap;
+	bool changed = FALSE;
 
-	this->lock->write_lock(this->lock);
-	enumerator = this->ids->create_enumerator(this->ids);
+	this->mutex->lock(this->mutex);
+	snap = snapshot_create(this->current->ids);
+	enumerator = snap->ids->create_enumerator(snap->ids);
 	while (enumerator->enumerate(enumerator, &key, &value))
 	{
 		if (value->matches(value, id))
 		{
-			this->ids->remove_at(this->ids, enumerator);
-			value->destroy(value);
+			snap->ids->remove_at(snap->ids, enumerator);
+			this->current->retired->insert_last(this->current->retired, value);
+			changed = TRUE;
 		}
 	}
 	enumerator->destroy(enumerator);
-	this->lock->unlock(this->lock);
+	if (changed)
+	{
+		publish(this, snap);
+	}
+	else
+	{
+		snapshot_release(snap);
+	}
+	this->mutex->unlock(this->mutex);
 }
 
 METHOD(whitelist_listener_t, set_active, void,
@@ -172,14 +329,16 @@ METHOD(whitelist_listener_t, destroy, void,
 	identification_t *key, *value;
 	enumerator_t *enumerator;
 
-	enumerator = this->ids->create_enumerator(this->ids);
+	/* the snapshot does not own the identities it still contains */
+	enumerator = this->current->ids->create_enumerator(this->current->ids);
 	while (enumerator->enumerate(enumerator, &key, &value))
 	{
 		value->destroy(value);
 	}
 	enumerator->destroy(enumerator);
-	this->ids->destroy(this->ids);
-	this->lock->destroy(this->lock);
+	snapshot_release(this->current);
+	this->spinlock->destroy(this->spinlock);
+	this->mutex->destroy(this->mutex);
 	free(this);
 }
 
@@ -202,9 +361,9 @@ whitelist_listener_t *whitelist_listener_create()
 			.set_active = _set_active,
 			.destroy = _destroy,
 		},
-		.lock = rwlock_create(RWLOCK_TYPE_DEFAULT),
-		.ids = hashtable_create((hashtable_hash_t)hash,
-								(hashtable_equals_t)equals, 32),
+		.current = snapshot_create(NULL),
+		.spinlock = spinlock_create(),
+		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
 		.enabled = lib->settings->get_bool(lib->settings,
 								"%s.plugins.whitelist.enable", FALSE, lib->ns),
 	);
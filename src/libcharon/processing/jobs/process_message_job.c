@@ -63,6 +63,13 @@ METHOD(job_t, execute, job_requeue_t,
 	}
 #endif /* ME */
 
+	/* answer retransmitted requests directly from the response cache, without
+	 * taking any IKE_SA locks */
+	if (charon->response_cache->reply(charon->response_cache, this->message))
+	{
+		return JOB_REQUEUE_NONE;
+	}
+
 	ike_sa = charon->ike_sa_manager->checkout_by_message(charon->ike_sa_manager,
 														 this->message);
 	if (ike_sa)
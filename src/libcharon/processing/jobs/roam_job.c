@@ -20,6 +20,11 @@
 #include <sa/ike_sa.h>
 #include <daemon.h>
 
+/**
+ * Number of IKE_SAs checked per job dispatch before requeueing
+ */
+#define ROAM_BATCH_SIZE 50
+
 
 typedef struct private_roam_job_t private_roam_job_t;
 
@@ -36,11 +41,20 @@ struct private_roam_job_t {
 	 * has the address list changed, or the routing only?
 	 */
 	bool address;
+
+	/**
+	 * remaining IKE_SAs to check, as ike_sa_id_t*, NULL before the first run
+	 */
+	linked_list_t *ids;
 };
 
 METHOD(job_t, destroy, void,
 	private_roam_job_t *this)
 {
+	if (this->ids)
+	{
+		this->ids->destroy_offset(this->ids, offsetof(ike_sa_id_t, destroy));
+	}
 	free(this);
 }
 
@@ -48,23 +62,39 @@ METHOD(job_t, execute, job_requeue_t,
 	private_roam_job_t *this)
 {
 	ike_sa_t *ike_sa;
-	linked_list_t *list;
 	ike_sa_id_t *id;
 	enumerator_t *enumerator;
+	int checked = 0;
 
-	/* enumerator over all IKE_SAs gives us no way to checkin_and_destroy
-	 * after a DESTROY_ME, so we check out each available IKE_SA by hand. */
-	list = linked_list_create();
-	enumerator = charon->ike_sa_manager->create_enumerator(
-												charon->ike_sa_manager, TRUE);
-	while (enumerator->enumerate(enumerator, &ike_sa))
+	if (!this->ids)
 	{
-		id = ike_sa->get_id(ike_sa);
-		list->insert_last(list, id->clone(id));
+		/* enumerator over all IKE_SAs gives us no way to checkin_and_destroy
+		 * after a DESTROY_ME, so we check out each available IKE_SA by hand. */
+		this->ids = linked_list_create();
+		enumerator = charon->ike_sa_manager->create_enumerator(
+												charon->ike_sa_manager, TRUE);
+		while (enumerator->enumerate(enumerator, &ike_sa))
+		{
+			switch (ike_sa->get_state(ike_sa))
+			{
+				case IKE_CREATED:
+				case IKE_DELETING:
+				case IKE_DESTROYING:
+				case IKE_PASSIVE:
+					/* roam() is a no-op for these, skip the checkout */
+					break;
+				default:
+					id = ike_sa->get_id(ike_sa);
+					this->ids->insert_last(this->ids, id->clone(id));
+					break;
+			}
+		}
+		enumerator->destroy(enumerator);
 	}
-	enumerator->destroy(enumerator);
 
-	while (list->remove_last(list, (void**)&id) == SUCCESS)
+	/* process the sweep in batches, so a change on a loaded gateway does not
+	 * monopolize a worker and new events can abort an outdated sweep */
+	while (this->ids->remove_last(this->ids, (void**)&id) == SUCCESS)
 	{
 		ike_sa = charon->ike_sa_manager->checkout(charon->ike_sa_manager, id);
 		if (ike_sa)
@@ -80,15 +110,22 @@ METHOD(job_t, execute, job_requeue_t,
 			}
 		}
 		id->destroy(id);
+		if (++checked == ROAM_BATCH_SIZE)
+		{
+			break;
+		}
+	}
+	if (this->ids->get_count(this->ids))
+	{
+		return JOB_REQUEUE_FAIR;
 	}
-	list->destroy(list);
 	return JOB_REQUEUE_NONE;
 }
 
 METHOD(job_t, get_priority, job_priority_t,
 	private_roam_job_t *this)
 {
-	return JOB_PRIO_MEDIUM;
+	return JOB_PRIO_LOW;
 }
 
 /*
@@ -19,6 +19,21 @@
 #include <threading/mutex.h>
 #include <collections/hashtable.h>
 
+/* the default number of segments per table (MUST be a power of 2) */
+#define DEFAULT_SEGMENT_COUNT 1
+
+typedef struct segment_t segment_t;
+
+/**
+ * Segment of one of the hashtables, with its own lock
+ */
+struct segment_t {
+	/** mutex to access the hashtable of this segment exclusively */
+	mutex_t *mutex;
+	/** part of the table, keyed by this segment's share of the hash space */
+	hashtable_t *table;
+};
+
 typedef struct private_child_sa_manager_t private_child_sa_manager_t;
 
 /**
@@ -34,22 +49,27 @@ struct private_child_sa_manager_t {
 	/**
 	 * CHILD_SAs by inbound SPI/dst, child_entry_t => child_entry_t
 	 */
-	hashtable_t *in;
+	segment_t *in;
 
 	/**
 	 * CHILD_SAs by outbound SPI/dst, child_entry_t => child_entry_t
 	 */
-	hashtable_t *out;
+	segment_t *out;
 
 	/**
 	 * CHILD_SAs by unique ID, child_entry_t => child_entry_t
 	 */
-	hashtable_t *ids;
+	segment_t *ids;
 
 	/**
-	 * Mutex to access any hashtable
+	 * The number of segments in each table
 	 */
-	mutex_t *mutex;
+	u_int segment_count;
+
+	/**
+	 * Mask to map a hash to a segment
+	 */
+	u_int segment_mask;
 };
 
 /**
@@ -139,12 +159,23 @@ static bool equals_id(child_entry_t *a, child_entry_t *b)
 	return a->unique_id == b->unique_id;
 }
 
+/**
+ * Get the segment of the given table an entry maps to
+ */
+static inline segment_t *get_segment(private_child_sa_manager_t *this,
+									 segment_t *segments, u_int hash)
+{
+	return &segments[hash & this->segment_mask];
+}
+
 METHOD(child_sa_manager_t, add, void,
 	private_child_sa_manager_t *this, child_sa_t *child_sa, ike_sa_t *ike_sa)
 {
-	child_entry_t *entry;
+	child_entry_t *entry, *old = NULL;
+	segment_t *seg_in, *seg_out, *seg_ids;
 	host_t *in, *out;
 	ike_sa_id_t *id;
+	bool exists = FALSE;
 
 	id = ike_sa->get_id(ike_sa);
 	in = ike_sa->get_my_host(ike_sa);
@@ -160,40 +191,81 @@ METHOD(child_sa_manager_t, add, void,
 		.host_out = out->clone(out),
 	);
 
-	this->mutex->lock(this->mutex);
-	if (!this->in->get(this->in, entry) &&
-		!this->out->get(this->out, entry))
+	/* the segments are locked one at a time, never nested, so concurrent
+	 * add/remove on different SAs only collide if they map to the same
+	 * segment */
+	seg_in = get_segment(this, this->in, hash_in(entry));
+	seg_in->mutex->lock(seg_in->mutex);
+	if (seg_in->table->get(seg_in->table, entry))
+	{
+		exists = TRUE;
+	}
+	else
 	{
-		this->in->put(this->in, entry, entry);
-		this->out->put(this->out, entry, entry);
-		entry = this->ids->put(this->ids, entry, entry);
+		seg_in->table->put(seg_in->table, entry, entry);
+	}
+	seg_in->mutex->unlock(seg_in->mutex);
+	if (exists)
+	{
+		child_entry_destroy(entry);
+		return;
 	}
-	this->mutex->unlock(this->mutex);
 
-	if (entry)
+	seg_out = get_segment(this, this->out, hash_out(entry));
+	seg_out->mutex->lock(seg_out->mutex);
+	if (seg_out->table->get(seg_out->table, entry))
+	{
+		exists = TRUE;
+	}
+	else
+	{
+		seg_out->table->put(seg_out->table, entry, entry);
+	}
+	seg_out->mutex->unlock(seg_out->mutex);
+	if (exists)
 	{
+		seg_in->mutex->lock(seg_in->mutex);
+		seg_in->table->remove(seg_in->table, entry);
+		seg_in->mutex->unlock(seg_in->mutex);
 		child_entry_destroy(entry);
+		return;
+	}
+
+	seg_ids = get_segment(this, this->ids, hash_id(entry));
+	seg_ids->mutex->lock(seg_ids->mutex);
+	old = seg_ids->table->put(seg_ids->table, entry, entry);
+	seg_ids->mutex->unlock(seg_ids->mutex);
+
+	if (old)
+	{
+		child_entry_destroy(old);
 	}
 }
 
 METHOD(child_sa_manager_t, remove_, void,
 	private_child_sa_manager_t *this, child_sa_t *child_sa)
 {
+	segment_t *segment;
 	child_entry_t *entry, key = {
 		.unique_id = child_sa->get_unique_id(child_sa),
 	};
 
-	this->mutex->lock(this->mutex);
-	entry = this->ids->remove(this->ids, &key);
+	segment = get_segment(this, this->ids, hash_id(&key));
+	segment->mutex->lock(segment->mutex);
+	entry = segment->table->remove(segment->table, &key);
+	segment->mutex->unlock(segment->mutex);
 	if (entry)
 	{
-		this->in->remove(this->in, entry);
-		this->out->remove(this->out, entry);
-	}
-	this->mutex->unlock(this->mutex);
+		segment = get_segment(this, this->in, hash_in(entry));
+		segment->mutex->lock(segment->mutex);
+		segment->table->remove(segment->table, entry);
+		segment->mutex->unlock(segment->mutex);
+
+		segment = get_segment(this, this->out, hash_out(entry));
+		segment->mutex->lock(segment->mutex);
+		segment->table->remove(segment->table, entry);
+		segment->mutex->unlock(segment->mutex);
 
-	if (entry)
-	{
 		child_entry_destroy(entry);
 	}
 }
@@ -242,17 +314,19 @@ METHOD(child_sa_manager_t, checkout_by_id, ike_sa_t*,
 	child_sa_t **child_sa)
 {
 	ike_sa_id_t *id;
+	segment_t *segment;
 	child_entry_t *entry, key = {
 		.unique_id = unique_id,
 	};
 
-	this->mutex->lock(this->mutex);
-	entry = this->ids->get(this->ids, &key);
+	segment = get_segment(this, this->ids, hash_id(&key));
+	segment->mutex->lock(segment->mutex);
+	entry = segment->table->get(segment->table, &key);
 	if (entry)
 	{
 		id = entry->ike_id->clone(entry->ike_id);
 	}
-	this->mutex->unlock(this->mutex);
+	segment->mutex->unlock(segment->mutex);
 
 	if (entry)
 	{
@@ -267,6 +341,7 @@ METHOD(child_sa_manager_t, checkout, ike_sa_t*,
 {
 	ike_sa_id_t *id;
 	u_int32_t unique_id;
+	segment_t *segment;
 	child_entry_t *entry, key = {
 		.spi_in = spi,
 		.spi_out = spi,
@@ -275,18 +350,27 @@ METHOD(child_sa_manager_t, checkout, ike_sa_t*,
 		.proto = protocol,
 	};
 
-	this->mutex->lock(this->mutex);
-	entry = this->in->get(this->in, &key);
-	if (!entry)
-	{
-		entry = this->out->get(this->out, &key);
-	}
+	segment = get_segment(this, this->in, hash_in(&key));
+	segment->mutex->lock(segment->mutex);
+	entry = segment->table->get(segment->table, &key);
 	if (entry)
 	{
 		unique_id = entry->unique_id;
 		id = entry->ike_id->clone(entry->ike_id);
 	}
-	this->mutex->unlock(this->mutex);
+	segment->mutex->unlock(segment->mutex);
+	if (!entry)
+	{
+		segment = get_segment(this, this->out, hash_out(&key));
+		segment->mutex->lock(segment->mutex);
+		entry = segment->table->get(segment->table, &key);
+		if (entry)
+		{
+			unique_id = entry->unique_id;
+			id = entry->ike_id->clone(entry->ike_id);
+		}
+		segment->mutex->unlock(segment->mutex);
+	}
 
 	if (entry)
 	{
@@ -295,16 +379,66 @@ METHOD(child_sa_manager_t, checkout, ike_sa_t*,
 	return NULL;
 }
 
+/**
+ * Destroy a segment array and the contained hashtables
+ */
+static void destroy_segments(private_child_sa_manager_t *this,
+							 segment_t *segments)
+{
+	u_int i;
+
+	for (i = 0; i < this->segment_count; i++)
+	{
+		segments[i].table->destroy(segments[i].table);
+		segments[i].mutex->destroy(segments[i].mutex);
+	}
+	free(segments);
+}
+
 METHOD(child_sa_manager_t, destroy, void,
 	private_child_sa_manager_t *this)
 {
-	this->in->destroy(this->in);
-	this->out->destroy(this->out);
-	this->ids->destroy(this->ids);
-	this->mutex->destroy(this->mutex);
+	destroy_segments(this, this->in);
+	destroy_segments(this, this->out);
+	destroy_segments(this, this->ids);
 	free(this);
 }
 
+/**
+ * Create a segment array with hashtables using the given functions
+ */
+static segment_t *create_segments(private_child_sa_manager_t *this,
+								  hashtable_hash_t hash,
+								  hashtable_equals_t equals)
+{
+	segment_t *segments;
+	u_int i;
+
+	segments = calloc(this->segment_count, sizeof(segment_t));
+	for (i = 0; i < this->segment_count; i++)
+	{
+		segments[i].mutex = mutex_create(MUTEX_TYPE_DEFAULT);
+		segments[i].table = hashtable_create(hash, equals, 8);
+	}
+	return segments;
+}
+
+/**
+ * This function returns the next-highest power of two for the given number,
+ * returns 0 for n == 0
+ */
+static u_int get_nearest_powerof2(u_int n)
+{
+	u_int i;
+
+	--n;
+	for (i = 1; i < sizeof(u_int) * 8; i <<= 1)
+	{
+		n |= n >> i;
+	}
+	return ++n;
+}
+
 /**
  * See header
  */
@@ -320,14 +454,20 @@ child_sa_manager_t *child_sa_manager_create()
 			.checkout_by_id = _checkout_by_id,
 			.destroy = _destroy,
 		},
-		.in = hashtable_create((hashtable_hash_t)hash_in,
-							   (hashtable_equals_t)equals_in, 8),
-		.out = hashtable_create((hashtable_hash_t)hash_out,
-							   (hashtable_equals_t)equals_out, 8),
-		.ids = hashtable_create((hashtable_hash_t)hash_id,
-							   (hashtable_equals_t)equals_id, 8),
-		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
 	);
 
+	this->segment_count = get_nearest_powerof2(lib->settings->get_int(
+								lib->settings, "%s.child_sa_table_segments",
+								DEFAULT_SEGMENT_COUNT, lib->ns));
+	this->segment_count = max(1, this->segment_count);
+	this->segment_mask = this->segment_count - 1;
+
+	this->in = create_segments(this, (hashtable_hash_t)hash_in,
+							   (hashtable_equals_t)equals_in);
+	this->out = create_segments(this, (hashtable_hash_t)hash_out,
+								(hashtable_equals_t)equals_out);
+	this->ids = create_segments(this, (hashtable_hash_t)hash_id,
+								(hashtable_equals_t)equals_id);
+
 	return &this->public;
 }
@@ -0,0 +1,356 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Hochschule fuer Technik Rapperswil
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include "dpd_coordinator.h"
+
+#include <daemon.h>
+#include <threading/mutex.h>
+#include <collections/hashtable.h>
+#include <collections/linked_list.h>
+#include <processing/jobs/callback_job.h>
+
+/**
+ * Number of one second buckets in the DPD wheel. Entries with a deadline
+ * beyond the wheel size wrap around and are skipped until due.
+ */
+#define DPD_WHEEL_SIZE 64
+
+typedef struct private_dpd_coordinator_t private_dpd_coordinator_t;
+
+/**
+ * Private data of dpd_coordinator_t
+ */
+struct private_dpd_coordinator_t {
+
+	/**
+	 * Public interface
+	 */
+	dpd_coordinator_t public;
+
+	/**
+	 * Scheduled entries, ike_sa_id_t => entry_t
+	 */
+	hashtable_t *entries;
+
+	/**
+	 * Wheel of one second buckets, as linked_list_t* of entry_t*
+	 */
+	linked_list_t *wheel[DPD_WHEEL_SIZE];
+
+	/**
+	 * Monotonic time the wheel was last advanced to
+	 */
+	time_t last;
+
+	/**
+	 * TRUE while the periodic job is scheduled
+	 */
+	bool scheduled;
+
+	/**
+	 * Mutex to lock wheel and entries
+	 */
+	mutex_t *mutex;
+};
+
+/**
+ * A scheduled DPD check
+ */
+typedef struct {
+	/** identifier of the IKE_SA to check */
+	ike_sa_id_t *id;
+	/** remote address, used to batch checks per peer */
+	host_t *peer;
+	/** monotonic time the check is due */
+	time_t next;
+	/** wheel bucket the entry currently lives in */
+	u_int slot;
+} entry_t;
+
+/**
+ * Destroy an entry
+ */
+static void entry_destroy(entry_t *this)
+{
+	DESTROY_IF(this->id);
+	this->peer->destroy(this->peer);
+	free(this);
+}
+
+/**
+ * Hashtable hash function for IKE_SA identifiers
+ */
+static u_int id_hash(ike_sa_id_t *id)
+{
+	u_int64_t spi_i, spi_r;
+
+	spi_i = id->get_initiator_spi(id);
+	spi_r = id->get_responder_spi(id);
+	return chunk_hash_inc(chunk_from_thing(spi_i),
+						  chunk_hash(chunk_from_thing(spi_r)));
+}
+
+/**
+ * Hashtable equals function for IKE_SA identifiers
+ */
+static bool id_equals(ike_sa_id_t *a, ike_sa_id_t *b)
+{
+	return a->equals(a, b);
+}
+
+/**
+ * A batch of due checks towards the same peer
+ */
+typedef struct {
+	/** peer address the batch probes */
+	host_t *peer;
+	/** IKE_SA identifiers to probe, ike_sa_id_t* */
+	linked_list_t *ids;
+} batch_t;
+
+/**
+ * Clean up a batch
+ */
+static void batch_destroy(batch_t *this)
+{
+	this->ids->destroy_offset(this->ids, offsetof(ike_sa_id_t, destroy));
+	this->peer->destroy(this->peer);
+	free(this);
+}
+
+/**
+ * Process a batch of due checks with a single job, checking out each
+ * IKE_SA of the peer in sequence
+ */
+static job_requeue_t probe_batch(batch_t *batch)
+{
+	ike_sa_id_t *id;
+	ike_sa_t *ike_sa;
+
+	while (batch->ids->remove_first(batch->ids, (void**)&id) == SUCCESS)
+	{
+		ike_sa = charon->ike_sa_manager->checkout(charon->ike_sa_manager, id);
+		if (ike_sa)
+		{
+			if (ike_sa->send_dpd(ike_sa) == DESTROY_ME)
+			{
+				charon->ike_sa_manager->checkin_and_destroy(
+											charon->ike_sa_manager, ike_sa);
+			}
+			else
+			{
+				charon->ike_sa_manager->checkin(charon->ike_sa_manager,
+												ike_sa);
+			}
+		}
+		id->destroy(id);
+	}
+	return JOB_REQUEUE_NONE;
+}
+
+/**
+ * Move a due entry into the batch of its peer, creating it if required
+ */
+static void batch_entry(linked_list_t *batches, entry_t *entry)
+{
+	enumerator_t *enumerator;
+	batch_t *batch, *found = NULL;
+
+	enumerator = batches->create_enumerator(batches);
+	while (enumerator->enumerate(enumerator, &batch))
+	{
+		if (batch->peer->ip_equals(batch->peer, entry->peer))
+		{
+			found = batch;
+			break;
+		}
+	}
+	enumerator->destroy(enumerator);
+	if (!found)
+	{
+		INIT(found,
+			.peer = entry->peer->clone(entry->peer),
+			.ids = linked_list_create(),
+		);
+		batches->insert_last(batches, found);
+	}
+	found->ids->insert_last(found->ids, entry->id);
+	entry->id = NULL;
+	entry_destroy(entry);
+}
+
+/**
+ * Insert an entry into the bucket its deadline maps to. Must be called
+ * with this->mutex held.
+ */
+static void wheel_insert(private_dpd_coordinator_t *this, entry_t *entry)
+{
+	entry->slot = entry->next % DPD_WHEEL_SIZE;
+	this->wheel[entry->slot]->insert_last(this->wheel[entry->slot], entry);
+}
+
+/**
+ * Periodic job advancing the wheel, one tick per second
+ */
+static job_requeue_t tick(private_dpd_coordinator_t *this)
+{
+	enumerator_t *enumerator;
+	linked_list_t *slot, *batches;
+	batch_t *batch;
+	entry_t *entry;
+	time_t now, t;
+	bool again;
+
+	batches = linked_list_create();
+	this->mutex->lock(this->mutex);
+	now = time_monotonic(NULL);
+	for (t = this->last + 1; t <= now; t++)
+	{
+		slot = this->wheel[t % DPD_WHEEL_SIZE];
+		enumerator = slot->create_enumerator(slot);
+		while (enumerator->enumerate(enumerator, &entry))
+		{
+			if (entry->next <= now)
+			{
+				slot->remove_at(slot, enumerator);
+				this->entries->remove(this->entries, entry->id);
+				batch_entry(batches, entry);
+			}
+		}
+		enumerator->destroy(enumerator);
+	}
+	this->last = now;
+	if (!this->entries->get_count(this->entries))
+	{	/* nothing scheduled, next schedule() requeues us */
+		this->scheduled = FALSE;
+	}
+	again = this->scheduled;
+	this->mutex->unlock(this->mutex);
+
+	while (batches->remove_first(batches, (void**)&batch) == SUCCESS)
+	{
+		lib->processor->queue_job(lib->processor,
+			(job_t*)callback_job_create_with_prio((callback_job_cb_t)probe_batch,
+				batch, (void*)batch_destroy, (callback_job_cancel_t)return_false,
+				JOB_PRIO_HIGH));
+	}
+	batches->destroy(batches);
+
+	if (!again)
+	{
+		return JOB_REQUEUE_NONE;
+	}
+	return JOB_RESCHEDULE(1);
+}
+
+METHOD(dpd_coordinator_t, schedule, void,
+	private_dpd_coordinator_t *this, ike_sa_id_t *id, host_t *peer,
+	u_int32_t delay)
+{
+	entry_t *entry;
+
+	this->mutex->lock(this->mutex);
+	entry = this->entries->get(this->entries, id);
+	if (entry)
+	{
+		this->wheel[entry->slot]->remove(this->wheel[entry->slot],
+										 entry, NULL);
+		entry->peer->destroy(entry->peer);
+	}
+	else
+	{
+		INIT(entry,
+			.id = id->clone(id),
+		);
+		this->entries->put(this->entries, entry->id, entry);
+	}
+	entry->peer = peer->clone(peer);
+	entry->next = time_monotonic(NULL) + delay;
+	wheel_insert(this, entry);
+	if (!this->scheduled)
+	{
+		this->scheduled = TRUE;
+		this->last = time_monotonic(NULL);
+		lib->scheduler->schedule_job(lib->scheduler,
+			(job_t*)callback_job_create_with_prio((callback_job_cb_t)tick,
+				this, NULL, (callback_job_cancel_t)return_false,
+				JOB_PRIO_HIGH), 1);
+	}
+	this->mutex->unlock(this->mutex);
+}
+
+METHOD(dpd_coordinator_t, cancel, void,
+	private_dpd_coordinator_t *this, ike_sa_id_t *id)
+{
+	entry_t *entry;
+
+	this->mutex->lock(this->mutex);
+	entry = this->entries->remove(this->entries, id);
+	if (entry)
+	{
+		this->wheel[entry->slot]->remove(this->wheel[entry->slot],
+										 entry, NULL);
+		entry_destroy(entry);
+	}
+	this->mutex->unlock(this->mutex);
+}
+
+METHOD(dpd_coordinator_t, destroy, void,
+	private_dpd_coordinator_t *this)
+{
+	enumerator_t *enumerator;
+	entry_t *entry;
+	int i;
+
+	enumerator = this->entries->create_enumerator(this->entries);
+	while (enumerator->enumerate(enumerator, NULL, &entry))
+	{
+		entry_destroy(entry);
+	}
+	enumerator->destroy(enumerator);
+	this->entries->destroy(this->entries);
+	for (i = 0; i < DPD_WHEEL_SIZE; i++)
+	{
+		this->wheel[i]->destroy(this->wheel[i]);
+	}
+	this->mutex->destroy(this->mutex);
+	free(this);
+}
+
+/*
+ * Described in header
+ */
+dpd_coordinator_t *dpd_coordinator_create()
+{
+	private_dpd_coordinator_t *this;
+	int i;
+
+	INIT(this,
+		.public = {
+			.schedule = _schedule,
+			.cancel = _cancel,
+			.destroy = _destroy,
+		},
+		.entries = hashtable_create((hashtable_hash_t)id_hash,
+									(hashtable_equals_t)id_equals, 32),
+		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+	);
+
+	for (i = 0; i < DPD_WHEEL_SIZE; i++)
+	{
+		this->wheel[i] = linked_list_create();
+	}
+	return &this->public;
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Hochschule fuer Technik Rapperswil
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/**
+ * @defgroup dpd_coordinator dpd_coordinator
+ * @{ @ingroup sa
+ */
+
+#ifndef DPD_COORDINATOR_H_
+#define DPD_COORDINATOR_H_
+
+typedef struct dpd_coordinator_t dpd_coordinator_t;
+
+#include <networking/host.h>
+#include <sa/ike_sa_id.h>
+
+/**
+ * Coordinates dead peer detection checks over all IKE_SAs.
+ *
+ * Instead of scheduling a job per IKE_SA and interval, due checks are
+ * tracked in a time-bucketed wheel advanced by a single periodic job.
+ * Checks becoming due in the same second are batched per peer address, so
+ * one dispatched job probes all SAs of a peer in sequence. The actual
+ * liveness evaluation and probing stays in ike_sa_t.send_dpd(), which
+ * skips the probe if inbound traffic was seen recently.
+ */
+struct dpd_coordinator_t {
+
+	/**
+	 * Schedule the next DPD check for an IKE_SA.
+	 *
+	 * Scheduling is one-shot; once the check was dispatched, the IKE_SA
+	 * re-registers itself during send_dpd(). An already scheduled check
+	 * for the same IKE_SA gets replaced.
+	 *
+	 * @param id			IKE_SA identifier to check
+	 * @param peer			remote address, used to batch checks (cloned)
+	 * @param delay			seconds until the check is due
+	 */
+	void (*schedule)(dpd_coordinator_t *this, ike_sa_id_t *id,
+					 host_t *peer, u_int32_t delay);
+
+	/**
+	 * Cancel a scheduled DPD check for an IKE_SA.
+	 *
+	 * @param id			IKE_SA identifier to cancel the check for
+	 */
+	void (*cancel)(dpd_coordinator_t *this, ike_sa_id_t *id);
+
+	/**
+	 * Destroy a dpd_coordinator_t.
+	 */
+	void (*destroy)(dpd_coordinator_t *this);
+};
+
+/**
+ * Create a dpd_coordinator instance.
+ */
+dpd_coordinator_t *dpd_coordinator_create();
+
+#endif /** DPD_COORDINATOR_H_ @}*/
@@ -52,8 +52,6 @@
 #include <utils/lexparser.h>
 #include <processing/jobs/retransmit_job.h>
 #include <processing/jobs/delete_ike_sa_job.h>
-#include <processing/jobs/send_dpd_job.h>
-#include <processing/jobs/send_keepalive_job.h>
 #include <processing/jobs/rekey_ike_sa_job.h>
 #include <processing/jobs/retry_initiate_job.h>
 #include <sa/ikev2/tasks/ike_auth_lifetime.h>
@@ -247,7 +245,12 @@ struct private_ike_sa_t {
 	/**
 	 * TRUE if a retry_initiate_job has been queued
 	 */
-	bool retry_initiate_queued;
+	bool retry_initiate_queued : 1;
+
+	/**
+	 * Flush auth configs once established?
+	 */
+	bool flush_auth_cfg : 1;
 
 	/**
 	 * Timestamps for this IKE_SA
@@ -269,11 +272,6 @@ struct private_ike_sa_t {
 	 */
 	host_t *remote_host;
 
-	/**
-	 * Flush auth configs once established?
-	 */
-	bool flush_auth_cfg;
-
 	/**
 	 * Maximum length of a single fragment, 0 for address-specific defaults
 	 */
@@ -417,11 +415,11 @@ METHOD(ike_sa_t, add_auth_cfg, void,
 {
 	if (local)
 	{
-		array_insert(this->my_auths, ARRAY_TAIL, cfg);
+		array_insert_create(&this->my_auths, ARRAY_TAIL, cfg);
 	}
 	else
 	{
-		array_insert(this->other_auths, ARRAY_TAIL, cfg);
+		array_insert_create(&this->other_auths, ARRAY_TAIL, cfg);
 	}
 }
 
@@ -484,38 +482,14 @@ METHOD(ike_sa_t, set_message_id, void,
 METHOD(ike_sa_t, send_keepalive, void,
 	private_ike_sa_t *this)
 {
-	send_keepalive_job_t *job;
-	time_t last_out, now, diff;
-
 	if (!(this->conditions & COND_NAT_HERE) || this->keepalive_interval == 0)
 	{	/* disable keep alives if we are not NATed anymore */
+		charon->keepalives->deactivate(charon->keepalives, this->ike_sa_id);
 		return;
 	}
-
-	last_out = get_use_time(this, FALSE);
-	now = time_monotonic(NULL);
-
-	diff = now - last_out;
-
-	if (diff >= this->keepalive_interval)
-	{
-		packet_t *packet;
-		chunk_t data;
-
-		packet = packet_create();
-		packet->set_source(packet, this->my_host->clone(this->my_host));
-		packet->set_destination(packet, this->other_host->clone(this->other_host));
-		data.ptr = malloc(1);
-		data.ptr[0] = 0xFF;
-		data.len = 1;
-		packet->set_data(packet, data);
-		DBG1(DBG_IKE, "sending keep alive to %#H", this->other_host);
-		charon->sender->send_no_marker(charon->sender, packet);
-		diff = 0;
-	}
-	job = send_keepalive_job_create(this->ike_sa_id);
-	lib->scheduler->schedule_job(lib->scheduler, (job_t*)job,
-								 this->keepalive_interval - diff);
+	charon->keepalives->activate(charon->keepalives, this->ike_sa_id,
+								 this->my_host, this->other_host,
+								 this->keepalive_interval);
 }
 
 METHOD(ike_sa_t, get_ike_cfg, ike_cfg_t*,
@@ -588,6 +562,10 @@ METHOD(ike_sa_t, set_condition, void,
 								  has_condition(this, COND_NAT_HERE) ||
 								  has_condition(this, COND_NAT_THERE) ||
 								  has_condition(this, COND_NAT_FAKE));
+					if (condition == COND_NAT_HERE)
+					{	/* unregisters from the keepalive manager */
+						send_keepalive(this);
+					}
 					break;
 				default:
 					break;
@@ -599,7 +577,6 @@ METHOD(ike_sa_t, set_condition, void,
 METHOD(ike_sa_t, send_dpd, status_t,
 	private_ike_sa_t *this)
 {
-	job_t *job;
 	time_t diff, delay;
 	bool task_queued = FALSE;
 
@@ -632,8 +609,8 @@ METHOD(ike_sa_t, send_dpd, status_t,
 	/* recheck in "interval" seconds */
 	if (delay)
 	{
-		job = (job_t*)send_dpd_job_create(this->ike_sa_id);
-		lib->scheduler->schedule_job(lib->scheduler, job, delay - diff);
+		charon->dpd->schedule(charon->dpd, this->ike_sa_id,
+							  this->other_host, delay - diff);
 	}
 	if (task_queued)
 	{
@@ -903,6 +880,8 @@ METHOD(ike_sa_t, float_ports, void,
 	{
 		this->other_host->set_port(this->other_host, IKEV2_NATT_PORT);
 	}
+	/* refresh registered keepalive endpoints with the floated ports */
+	send_keepalive(this);
 }
 
 METHOD(ike_sa_t, update_hosts, void,
@@ -982,6 +961,9 @@ METHOD(ike_sa_t, update_hosts, void,
 		enumerator->destroy(enumerator);
 
 		vips->destroy(vips);
+
+		/* refresh registered keepalive endpoints */
+		send_keepalive(this);
 	}
 }
 
@@ -2172,7 +2154,8 @@ METHOD(ike_sa_t, add_configuration_attribute, void,
 		.type = type,
 		.data = chunk_clone(data),
 	};
-	array_insert(this->attributes, ARRAY_TAIL, &entry);
+	array_insert_create_value(&this->attributes, sizeof(attribute_entry_t),
+							  ARRAY_TAIL, &entry);
 }
 
 /**
@@ -2270,20 +2253,21 @@ METHOD(ike_sa_t, inherit_post, void,
 	enumerator = array_create_enumerator(other->my_auths);
 	while (enumerator->enumerate(enumerator, &cfg))
 	{
-		array_insert(this->my_auths, ARRAY_TAIL, cfg->clone(cfg));
+		array_insert_create(&this->my_auths, ARRAY_TAIL, cfg->clone(cfg));
 	}
 	enumerator->destroy(enumerator);
 	enumerator = array_create_enumerator(other->other_auths);
 	while (enumerator->enumerate(enumerator, &cfg))
 	{
-		array_insert(this->other_auths, ARRAY_TAIL, cfg->clone(cfg));
+		array_insert_create(&this->other_auths, ARRAY_TAIL, cfg->clone(cfg));
 	}
 	enumerator->destroy(enumerator);
 
 	/* ... and configuration attributes */
 	while (array_remove(other->attributes, ARRAY_HEAD, &entry))
 	{
-		array_insert(this->attributes, ARRAY_TAIL, &entry);
+		array_insert_create_value(&this->attributes, sizeof(attribute_entry_t),
+								  ARRAY_TAIL, &entry);
 	}
 
 	/* inherit all conditions */
@@ -2347,6 +2331,8 @@ METHOD(ike_sa_t, destroy, void,
 	{
 		this->task_manager->flush(this->task_manager);
 	}
+	charon->keepalives->deactivate(charon->keepalives, this->ike_sa_id);
+	charon->dpd->cancel(charon->dpd, this->ike_sa_id);
 
 	/* remove attributes first, as we pass the IKE_SA to the handler */
 	charon->bus->handle_vips(charon->bus, &this->public, FALSE);
@@ -2549,9 +2535,6 @@ ike_sa_t * ike_sa_create(ike_sa_id_t *ike_sa_id, bool initiator,
 		.stats[STAT_OUTBOUND] = time_monotonic(NULL),
 		.my_auth = auth_cfg_create(),
 		.other_auth = auth_cfg_create(),
-		.my_auths = array_create(0, 0),
-		.other_auths = array_create(0, 0),
-		.attributes = array_create(sizeof(attribute_entry_t), 0),
 		.unique_id = ref_get(&unique_id),
 		.keepalive_interval = lib->settings->get_time(lib->settings,
 								"%s.keep_alive", KEEPALIVE_INTERVAL, lib->ns),
@@ -833,10 +833,12 @@ struct ike_sa_t {
 	status_t (*send_dpd) (ike_sa_t *this);
 
 	/**
-	 * Sends a keep alive packet.
+	 * Register this IKE_SA with the keepalive manager.
 	 *
 	 * To refresh NAT tables in a NAT router between the peers, periodic empty
-	 * UDP packets are sent if no other traffic was sent.
+	 * UDP packets are emitted by the keepalive manager. This method registers
+	 * the current endpoints, or unregisters them if the SA is not NATed
+	 * (anymore).
 	 */
 	void (*send_keepalive) (ike_sa_t *this);
 
@@ -29,6 +29,7 @@
 #include <collections/linked_list.h>
 #include <crypto/hashers/hasher.h>
 #include <processing/jobs/delete_ike_sa_job.h>
+#include <utils/probes.h>
 
 /* the default size of the hash table (MUST be a power of 2) */
 #define DEFAULT_HASHTABLE_SIZE 1
@@ -202,8 +203,9 @@ struct half_open_t {
 	/** chunk of remote host address */
 	chunk_t other;
 
-	/** the number of half-open IKE_SAs with that host */
-	u_int count;
+	/** the number of half-open IKE_SAs with that host, updated atomically
+	 * so concurrent initiations only share the segment lock */
+	refcount_t count;
 };
 
 /**
@@ -261,6 +263,24 @@ struct init_hash_t {
 	u_int64_t our_spi;
 };
 
+typedef struct table_item_t table_item_t;
+
+/**
+ * Instead of using linked_list_t for each bucket we store the data in our own
+ * list to save memory.
+ */
+struct table_item_t {
+	/** data of this item */
+	void *value;
+
+	/** hash the item was stored under, allows lock-free readers to skip
+	 * mismatching items without dereferencing their value */
+	u_int hash;
+
+	/** next item in the overflow list */
+	table_item_t *next;
+};
+
 typedef struct segment_t segment_t;
 
 /**
@@ -272,6 +292,14 @@ struct segment_t {
 
 	/** the number of entries in this segment */
 	u_int count;
+
+	/** sequence number, odd while a writer modifies chains in this segment,
+	 * allows lock-free readers to validate their traversal */
+	refcount_t seq;
+
+	/** recycled table items, kept around so lock-free readers never see
+	 * freed memory while walking a chain (type-stable memory) */
+	table_item_t *spare;
 };
 
 typedef struct shareable_segment_t shareable_segment_t;
@@ -283,25 +311,11 @@ struct shareable_segment_t {
 	/** rwlock to access a segment non-/exclusively */
 	rwlock_t *lock;
 
-	/** the number of entries in this segment - in case of the "half-open table"
-	 * it's the sum of all half_open_t.count in a segment. */
+	/** the number of entries in this segment - unused for the "half-open"
+	 * table, the totals are tracked in the atomic half_open_count there */
 	u_int count;
 };
 
-typedef struct table_item_t table_item_t;
-
-/**
- * Instead of using linked_list_t for each bucket we store the data in our own
- * list to save memory.
- */
-struct table_item_t {
-	/** data of this item */
-	void *value;
-
-	/** next item in the overflow list */
-	table_item_t *next;
-};
-
 typedef struct private_ike_sa_manager_t private_ike_sa_manager_t;
 
 /**
@@ -373,6 +387,17 @@ struct private_ike_sa_manager_t {
 	 */
 	table_item_t **init_hashes_table;
 
+	/**
+	 * Counting Bloom filter in front of the table of init hashes, so floods
+	 * of unique IKE_SA_INITs are answered without walking the hash chains
+	 */
+	refcount_t *init_hashes_filter;
+
+	/**
+	 * Mask applied to slot indexes into the filter
+	 */
+	u_int init_hashes_filter_mask;
+
 	/**
 	  * Segments of the "hashes" hash table.
 	 */
@@ -392,6 +417,17 @@ struct private_ike_sa_manager_t {
 	 * Configured IKE_SA limit, if any
 	 */
 	u_int ikesa_limit;
+
+	/**
+	 * Checkout contention counters, updated atomically
+	 */
+	struct {
+		refcount_t checkouts;
+		refcount_t waits;
+		refcount_t wait_time_ms;
+		refcount_t max_wait_ms;
+		refcount_t waiting;
+	} stats;
 };
 
 /**
@@ -416,6 +452,40 @@ static inline void unlock_single_segment(private_ike_sa_manager_t *this,
 	lock->unlock(lock);
 }
 
+/**
+ * Mark the segment of the given table row as being modified.  Must be called
+ * with the segment lock held before chains in the segment are changed, makes
+ * the sequence number odd so lock-free readers fall back to the locked path.
+ */
+static inline void begin_segment_update(private_ike_sa_manager_t *this,
+										u_int index)
+{
+#ifdef HAVE_GCC_ATOMIC_OPERATIONS
+	/* the acquire part prevents the chain updates that follow from becoming
+	 * visible before the sequence number turns odd */
+	__atomic_add_fetch(&this->segments[index & this->segment_mask].seq, 1,
+					   __ATOMIC_ACQ_REL);
+#else
+	ref_get(&this->segments[index & this->segment_mask].seq);
+#endif
+}
+
+/**
+ * Mark the modification of the segment of the given table row as complete,
+ * making the sequence number even again.
+ */
+static inline void end_segment_update(private_ike_sa_manager_t *this,
+									  u_int index)
+{
+#ifdef HAVE_GCC_ATOMIC_OPERATIONS
+	/* release all chain updates before the sequence number turns even again */
+	__atomic_add_fetch(&this->segments[index & this->segment_mask].seq, 1,
+					   __ATOMIC_RELEASE);
+#else
+	ref_get(&this->segments[index & this->segment_mask].seq);
+#endif
+}
+
 /**
  * Lock all segments
  */
@@ -560,22 +630,34 @@ static enumerator_t* create_table_enumerator(private_ike_sa_manager_t *this)
 static u_int put_entry(private_ike_sa_manager_t *this, entry_t *entry)
 {
 	table_item_t *current, *item;
-	u_int row, segment;
-
-	INIT(item,
-		.value = entry,
-	);
+	u_int hash, row, segment;
 
-	row = ike_sa_id_hash(entry->ike_sa_id) & this->table_mask;
+	hash = ike_sa_id_hash(entry->ike_sa_id);
+	row = hash & this->table_mask;
 	segment = row & this->segment_mask;
 
 	lock_single_segment(this, segment);
+	item = this->segments[segment].spare;
+	if (item)
+	{	/* reuse a recycled item, the memory stays valid for lock-free
+		 * readers still traversing it */
+		this->segments[segment].spare = item->next;
+	}
+	else
+	{
+		INIT(item);
+	}
+	item->value = entry;
+	item->hash = hash;
+	item->next = NULL;
+	begin_segment_update(this, segment);
 	current = this->ike_sa_table[row];
 	if (current)
 	{	/* insert at the front of current bucket */
 		item->next = current;
 	}
 	this->ike_sa_table[row] = item;
+	end_segment_update(this, segment);
 	this->segments[segment].count++;
 	return segment;
 }
@@ -596,6 +678,7 @@ static void remove_entry(private_ike_sa_manager_t *this, entry_t *entry)
 	{
 		if (item->value == entry)
 		{
+			begin_segment_update(this, segment);
 			if (prev)
 			{
 				prev->next = item->next;
@@ -604,8 +687,12 @@ static void remove_entry(private_ike_sa_manager_t *this, entry_t *entry)
 			{
 				this->ike_sa_table[row] = item->next;
 			}
+			end_segment_update(this, segment);
 			this->segments[segment].count--;
-			free(item);
+			/* recycle the item instead of freeing it, lock-free readers
+			 * might still look at it */
+			item->next = this->segments[segment].spare;
+			this->segments[segment].spare = item;
 			break;
 		}
 		prev = item;
@@ -626,6 +713,7 @@ static void remove_entry_at(private_enumerator_t *this)
 		this->manager->segments[this->segment].count--;
 		this->current = this->prev;
 
+		begin_segment_update(this->manager, this->segment);
 		if (this->prev)
 		{
 			this->prev->next = current->next;
@@ -633,12 +721,60 @@ static void remove_entry_at(private_enumerator_t *this)
 		else
 		{
 			this->manager->ike_sa_table[this->row] = current->next;
+		}
+		end_segment_update(this->manager, this->segment);
+		current->next = this->manager->segments[this->segment].spare;
+		this->manager->segments[this->segment].spare = current;
+		if (!this->prev)
+		{
 			unlock_single_segment(this->manager, this->segment);
 		}
-		free(current);
 	}
 }
 
+/**
+ * Check whether the table row of the given hash may contain a matching entry,
+ * without taking the segment lock.  Chains are walked optimistically and the
+ * traversal is validated against the segment's sequence number; as items are
+ * recycled per segment and never freed, a stale item is safe to look at (its
+ * hash may mismatch, which only sends us to the locked path).  Returns FALSE
+ * only if the row provably contained no item with this hash.
+ */
+static bool probe_entry_lockfree(private_ike_sa_manager_t *this, u_int hash)
+{
+#ifdef HAVE_GCC_ATOMIC_OPERATIONS
+	table_item_t *item;
+	segment_t *segment;
+	refcount_t seq;
+	u_int row;
+
+	row = hash & this->table_mask;
+	segment = &this->segments[row & this->segment_mask];
+
+	/* acquire, so the chain reads below can't be done before this load */
+	seq = __atomic_load_n(&segment->seq, __ATOMIC_ACQUIRE);
+	if (seq & 1)
+	{	/* a writer is modifying the segment right now */
+		return TRUE;
+	}
+	for (item = this->ike_sa_table[row]; item; item = item->next)
+	{
+		if (item->hash == hash)
+		{
+			return TRUE;
+		}
+	}
+	/* complete the chain reads above before re-checking the sequence number,
+	 * then only trust the miss if no writer interfered while we walked */
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return __atomic_load_n(&segment->seq, __ATOMIC_RELAXED) != seq;
+#else
+	/* without ordering guarantees for the optimistic walk, use the locked
+	 * path unconditionally */
+	return TRUE;
+#endif
+}
+
 /**
  * Find an entry using the provided match function to compare the entries for
  * equality.
@@ -648,16 +784,22 @@ static status_t get_entry_by_match_function(private_ike_sa_manager_t *this,
 					linked_list_match_t match, void *param)
 {
 	table_item_t *item;
-	u_int row, seg;
+	u_int hash, row, seg;
 
-	row = ike_sa_id_hash(ike_sa_id) & this->table_mask;
+	hash = ike_sa_id_hash(ike_sa_id);
+	row = hash & this->table_mask;
 	seg = row & this->segment_mask;
 
+	if (!probe_entry_lockfree(this, hash))
+	{	/* negative lookups, e.g. for spoofed SPIs during floods, complete
+		 * without contending on the segment lock at all */
+		return NOT_FOUND;
+	}
 	lock_single_segment(this, seg);
 	item = this->ike_sa_table[row];
 	while (item)
 	{
-		if (match(item->value, param))
+		if (item->hash == hash && match(item->value, param))
 		{
 			*entry = item->value;
 			*segment = seg;
@@ -696,9 +838,27 @@ static status_t get_entry_by_sa(private_ike_sa_manager_t *this,
  * Wait until no other thread is using an IKE_SA, return FALSE if entry not
  * acquirable.
  */
+/**
+ * Add a value to a statistics counter, atomically
+ */
+static inline void stats_add(refcount_t *counter, u_int32_t count)
+{
+	refcount_t current;
+
+	do
+	{
+		current = ref_cur(counter);
+	}
+	while (!cas_bool(counter, current, current + count));
+}
+
 static bool wait_for_entry(private_ike_sa_manager_t *this, entry_t *entry,
 						   u_int segment)
 {
+	bool waited = FALSE;
+	timeval_t start, end;
+
+	ref_get(&this->stats.checkouts);
 	if (entry->driveout_new_threads)
 	{
 		/* we are not allowed to get this */
@@ -706,12 +866,33 @@ static bool wait_for_entry(private_ike_sa_manager_t *this, entry_t *entry,
 	}
 	while (entry->checked_out && !entry->driveout_waiting_threads)
 	{
+		if (!waited)
+		{
+			waited = TRUE;
+			ref_get(&this->stats.waits);
+			ref_get(&this->stats.waiting);
+			time_monotonic(&start);
+		}
 		/* so wait until we can get it for us.
 		 * we register us as waiting. */
 		entry->waiting_threads++;
 		entry->condvar->wait(entry->condvar, this->segments[segment].mutex);
 		entry->waiting_threads--;
 	}
+	if (waited)
+	{
+		u_int32_t ms;
+
+		time_monotonic(&end);
+		timersub(&end, &start, &end);
+		ms = end.tv_sec * 1000 + end.tv_usec / 1000;
+		stats_add(&this->stats.wait_time_ms, ms);
+		if (ms > ref_cur(&this->stats.max_wait_ms))
+		{	/* updated without synchronization, purely statistical */
+			this->stats.max_wait_ms = ms;
+		}
+		ignore_result(ref_put(&this->stats.waiting));
+	}
 	/* hm, a deletion request forbids us to get this SA, get next one */
 	if (entry->driveout_waiting_threads)
 	{
@@ -734,10 +915,31 @@ static void put_half_open(private_ike_sa_manager_t *this, entry_t *entry)
 	chunk_t addr;
 
 	addr = entry->other->get_address(entry->other);
-	row = chunk_hash(addr) & this->table_mask;
+	row = entry->other->hash(entry->other, FALSE) & this->table_mask;
 	segment = row & this->segment_mask;
 	lock = this->half_open_segments[segment].lock;
+	/* during floods the same peers are hit over and over, so try to bump the
+	 * existing counter while holding the lock shared with other initiations
+	 * and with get_half_open_count() */
+	lock->read_lock(lock);
+	item = this->half_open_table[row];
+	while (item)
+	{
+		half_open = item->value;
+
+		if (chunk_equals(addr, half_open->other))
+		{
+			ref_get(&half_open->count);
+			ref_get(&this->half_open_count);
+			lock->unlock(lock);
+			return;
+		}
+		item = item->next;
+	}
+	lock->unlock(lock);
+
 	lock->write_lock(lock);
+	/* recheck, someone might have inserted the peer in the meantime */
 	item = this->half_open_table[row];
 	while (item)
 	{
@@ -745,7 +947,7 @@ static void put_half_open(private_ike_sa_manager_t *this, entry_t *entry)
 
 		if (chunk_equals(addr, half_open->other))
 		{
-			half_open->count++;
+			ref_get(&half_open->count);
 			break;
 		}
 		item = item->next;
@@ -763,7 +965,6 @@ static void put_half_open(private_ike_sa_manager_t *this, entry_t *entry)
 		);
 		this->half_open_table[row] = item;
 	}
-	this->half_open_segments[segment].count++;
 	ref_get(&this->half_open_count);
 	lock->unlock(lock);
 }
@@ -779,9 +980,38 @@ static void remove_half_open(private_ike_sa_manager_t *this, entry_t *entry)
 	chunk_t addr;
 
 	addr = entry->other->get_address(entry->other);
-	row = chunk_hash(addr) & this->table_mask;
+	row = entry->other->hash(entry->other, FALSE) & this->table_mask;
 	segment = row & this->segment_mask;
 	lock = this->half_open_segments[segment].lock;
+	/* the counter is atomic, take the lock shared unless we dropped the
+	 * last half-open SA with this peer */
+	lock->read_lock(lock);
+	item = this->half_open_table[row];
+	while (item)
+	{
+		half_open_t *half_open = item->value;
+
+		if (chunk_equals(addr, half_open->other))
+		{
+			/* drop the global counter here in any case; the write phase below
+			 * might not find the peer again if it got re-created and removed
+			 * concurrently, which would leak the count permanently */
+			ignore_result(ref_put(&this->half_open_count));
+			if (!ref_put(&half_open->count))
+			{
+				lock->unlock(lock);
+				return;
+			}
+			break;
+		}
+		item = item->next;
+	}
+	lock->unlock(lock);
+	if (!item)
+	{
+		return;
+	}
+
 	lock->write_lock(lock);
 	item = this->half_open_table[row];
 	while (item)
@@ -790,7 +1020,9 @@ static void remove_half_open(private_ike_sa_manager_t *this, entry_t *entry)
 
 		if (chunk_equals(addr, half_open->other))
 		{
-			if (--half_open->count == 0)
+			/* only unlink the peer if its counter is still zero, it might
+			 * have been raised again since we dropped the shared lock */
+			if (ref_cur(&half_open->count) == 0)
 			{
 				if (prev)
 				{
@@ -803,8 +1035,6 @@ static void remove_half_open(private_ike_sa_manager_t *this, entry_t *entry)
 				half_open_destroy(half_open);
 				free(item);
 			}
-			this->half_open_segments[segment].count--;
-			ignore_result(ref_put(&this->half_open_count));
 			break;
 		}
 		prev = item;
@@ -822,13 +1052,11 @@ static void put_connected_peers(private_ike_sa_manager_t *this, entry_t *entry)
 	u_int row, segment;
 	rwlock_t *lock;
 	connected_peers_t *connected_peers;
-	chunk_t my_id, other_id;
 	int family;
 
-	my_id = entry->my_id->get_encoding(entry->my_id);
-	other_id = entry->other_id->get_encoding(entry->other_id);
 	family = entry->other->get_family(entry->other);
-	row = chunk_hash_inc(other_id, chunk_hash(my_id)) & this->table_mask;
+	row = entry->other_id->hash(entry->other_id,
+						entry->my_id->hash(entry->my_id, 0)) & this->table_mask;
 	segment = row & this->segment_mask;
 	lock = this->connected_peers_segments[segment].lock;
 	lock->write_lock(lock);
@@ -880,14 +1108,12 @@ static void remove_connected_peers(private_ike_sa_manager_t *this, entry_t *entr
 	table_item_t *item, *prev = NULL;
 	u_int row, segment;
 	rwlock_t *lock;
-	chunk_t my_id, other_id;
 	int family;
 
-	my_id = entry->my_id->get_encoding(entry->my_id);
-	other_id = entry->other_id->get_encoding(entry->other_id);
 	family = entry->other->get_family(entry->other);
 
-	row = chunk_hash_inc(other_id, chunk_hash(my_id)) & this->table_mask;
+	row = entry->other_id->hash(entry->other_id,
+						entry->my_id->hash(entry->my_id, 0)) & this->table_mask;
 	segment = row & this->segment_mask;
 
 	lock = this->connected_peers_segments[segment].lock;
@@ -992,6 +1218,81 @@ static bool get_init_hash(hasher_t *hasher, message_t *message, chunk_t *hash)
 	return hasher->allocate_hash(hasher, message->get_packet_data(message), hash);
 }
 
+/**
+ * Ratio between the size of the init hash filter and the init hash table
+ */
+#define INIT_HASH_FILTER_RATIO 8
+
+/**
+ * Number of slots in the init hash filter a hash is mapped to
+ */
+#define INIT_HASH_FILTER_SLOTS 2
+
+/**
+ * Compute the filter slots an init hash maps to.
+ */
+static void init_hash_filter_slots(private_ike_sa_manager_t *this,
+								   chunk_t init_hash,
+								   u_int slots[INIT_HASH_FILTER_SLOTS])
+{
+	u_int32_t hash;
+	int i;
+
+	hash = chunk_hash(init_hash);
+	for (i = 0; i < INIT_HASH_FILTER_SLOTS; i++)
+	{
+		slots[i] = hash & this->init_hashes_filter_mask;
+		hash = chunk_hash_inc(init_hash, hash);
+	}
+}
+
+/**
+ * Check if an init hash might be stored in the table. FALSE is authoritative,
+ * TRUE may be a false positive and requires a check of the exact table.
+ */
+static bool init_hash_filter_probe(private_ike_sa_manager_t *this,
+								   u_int slots[INIT_HASH_FILTER_SLOTS])
+{
+	int i;
+
+	for (i = 0; i < INIT_HASH_FILTER_SLOTS; i++)
+	{
+		if (!ref_cur(&this->init_hashes_filter[slots[i]]))
+		{
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/**
+ * Count an init hash into the filter.
+ */
+static void init_hash_filter_add(private_ike_sa_manager_t *this,
+								 u_int slots[INIT_HASH_FILTER_SLOTS])
+{
+	int i;
+
+	for (i = 0; i < INIT_HASH_FILTER_SLOTS; i++)
+	{
+		ref_get(&this->init_hashes_filter[slots[i]]);
+	}
+}
+
+/**
+ * Remove an init hash from the filter.
+ */
+static void init_hash_filter_del(private_ike_sa_manager_t *this,
+								 u_int slots[INIT_HASH_FILTER_SLOTS])
+{
+	int i;
+
+	for (i = 0; i < INIT_HASH_FILTER_SLOTS; i++)
+	{
+		ignore_result(ref_put(&this->init_hashes_filter[slots[i]]));
+	}
+}
+
 /**
  * Check if we already have created an IKE_SA based on the initial IKE message
  * with the given hash.
@@ -1010,26 +1311,32 @@ static status_t check_and_put_init_hash(private_ike_sa_manager_t *this,
 {
 	table_item_t *item;
 	u_int row, segment;
+	u_int slots[INIT_HASH_FILTER_SLOTS];
 	mutex_t *mutex;
 	init_hash_t *init;
 	u_int64_t spi;
 
 	row = chunk_hash(init_hash) & this->table_mask;
 	segment = row & this->segment_mask;
+	init_hash_filter_slots(this, init_hash, slots);
 	mutex = this->init_hashes_segments[segment].mutex;
 	mutex->lock(mutex);
-	item = this->init_hashes_table[row];
-	while (item)
-	{
-		init_hash_t *current = item->value;
-
-		if (chunk_equals(init_hash, current->hash))
+	if (init_hash_filter_probe(this, slots))
+	{	/* walk the chain only if the filter indicates the hash might be
+		 * stored, floods of unique IKE_SA_INITs skip it with two loads */
+		item = this->init_hashes_table[row];
+		while (item)
 		{
-			*our_spi = current->our_spi;
-			mutex->unlock(mutex);
-			return ALREADY_DONE;
+			init_hash_t *current = item->value;
+
+			if (chunk_equals(init_hash, current->hash))
+			{
+				*our_spi = current->our_spi;
+				mutex->unlock(mutex);
+				return ALREADY_DONE;
+			}
+			item = item->next;
 		}
-		item = item->next;
 	}
 
 	spi = get_spi(this);
@@ -1050,6 +1357,7 @@ static status_t check_and_put_init_hash(private_ike_sa_manager_t *this,
 		.next = this->init_hashes_table[row],
 	);
 	this->init_hashes_table[row] = item;
+	init_hash_filter_add(this, slots);
 	*our_spi = init->our_spi;
 	mutex->unlock(mutex);
 	return NOT_FOUND;
@@ -1062,10 +1370,12 @@ static void remove_init_hash(private_ike_sa_manager_t *this, chunk_t init_hash)
 {
 	table_item_t *item, *prev = NULL;
 	u_int row, segment;
+	u_int slots[INIT_HASH_FILTER_SLOTS];
 	mutex_t *mutex;
 
 	row = chunk_hash(init_hash) & this->table_mask;
 	segment = row & this->segment_mask;
+	init_hash_filter_slots(this, init_hash, slots);
 	mutex = this->init_hashes_segments[segment].mutex;
 	mutex->lock(mutex);
 	item = this->init_hashes_table[row];
@@ -1083,6 +1393,7 @@ static void remove_init_hash(private_ike_sa_manager_t *this, chunk_t init_hash)
 			{
 				this->init_hashes_table[row] = item->next;
 			}
+			init_hash_filter_del(this, slots);
 			free(current);
 			free(item);
 			break;
@@ -1101,6 +1412,7 @@ METHOD(ike_sa_manager_t, checkout, ike_sa_t*,
 	u_int segment;
 
 	DBG2(DBG_MGR, "checkout IKE_SA");
+	PROBE(ike_sa_checkout);
 
 	if (get_entry_by_id(this, ike_sa_id, &entry, &segment) == SUCCESS)
 	{
@@ -1113,6 +1425,7 @@ METHOD(ike_sa_manager_t, checkout, ike_sa_t*,
 		}
 		unlock_single_segment(this, segment);
 	}
+	PROBE1(ike_sa_checkout_done, ike_sa != NULL);
 	charon->bus->set_sa(charon->bus, ike_sa);
 	return ike_sa;
 }
@@ -1147,6 +1460,7 @@ METHOD(ike_sa_manager_t, checkout_new, ike_sa_t*,
 
 	if (ike_sa)
 	{
+		lib->metrics->increment(lib->metrics, METRIC_IKE_SAS_CREATED);
 		DBG2(DBG_MGR, "created IKE_SA %s[%u]", ike_sa->get_name(ike_sa),
 			 ike_sa->get_unique_id(ike_sa));
 	}
@@ -1538,6 +1852,7 @@ METHOD(ike_sa_manager_t, checkin, void,
 
 	DBG2(DBG_MGR, "checkin IKE_SA %s[%u]", ike_sa->get_name(ike_sa),
 			ike_sa->get_unique_id(ike_sa));
+	PROBE1(ike_sa_checkin, ike_sa->get_unique_id(ike_sa));
 
 	/* look for the entry */
 	if (get_entry_by_sa(this, ike_sa_id, ike_sa, &entry, &segment) == SUCCESS)
@@ -1628,6 +1943,8 @@ METHOD(ike_sa_manager_t, checkin_and_destroy, void,
 
 	DBG2(DBG_MGR, "checkin and destroy IKE_SA %s[%u]", ike_sa->get_name(ike_sa),
 			ike_sa->get_unique_id(ike_sa));
+	PROBE1(ike_sa_checkin_destroy, ike_sa->get_unique_id(ike_sa));
+	lib->metrics->increment(lib->metrics, METRIC_IKE_SAS_DESTROYED);
 
 	if (get_entry_by_sa(this, ike_sa_id, ike_sa, &entry, &segment) == SUCCESS)
 	{
@@ -1698,8 +2015,7 @@ METHOD(ike_sa_manager_t, create_id_enumerator, enumerator_t*,
 	rwlock_t *lock;
 	linked_list_t *ids = NULL;
 
-	row = chunk_hash_inc(other->get_encoding(other),
-						 chunk_hash(me->get_encoding(me))) & this->table_mask;
+	row = other->hash(other, me->hash(me, 0)) & this->table_mask;
 	segment = row & this->segment_mask;
 
 	lock = this->connected_peers_segments[segment].lock;
@@ -1898,8 +2214,7 @@ METHOD(ike_sa_manager_t, has_contact, bool,
 	rwlock_t *lock;
 	bool found = FALSE;
 
-	row = chunk_hash_inc(other->get_encoding(other),
-						 chunk_hash(me->get_encoding(me))) & this->table_mask;
+	row = other->hash(other, me->hash(me, 0)) & this->table_mask;
 	segment = row & this->segment_mask;
 	lock = this->connected_peers_segments[segment].lock;
 	lock->read_lock(lock);
@@ -1918,6 +2233,18 @@ METHOD(ike_sa_manager_t, has_contact, bool,
 	return found;
 }
 
+METHOD(ike_sa_manager_t, get_checkout_stats, void,
+	private_ike_sa_manager_t *this, ike_sa_checkout_stats_t *stats)
+{
+	*stats = (ike_sa_checkout_stats_t){
+		.checkouts = ref_cur(&this->stats.checkouts),
+		.waits = ref_cur(&this->stats.waits),
+		.wait_time_ms = ref_cur(&this->stats.wait_time_ms),
+		.max_wait_ms = ref_cur(&this->stats.max_wait_ms),
+		.waiting = ref_cur(&this->stats.waiting),
+	};
+}
+
 METHOD(ike_sa_manager_t, get_count, u_int,
 	private_ike_sa_manager_t *this)
 {
@@ -1946,7 +2273,7 @@ METHOD(ike_sa_manager_t, get_half_open_count, u_int,
 	if (ip)
 	{
 		addr = ip->get_address(ip);
-		row = chunk_hash(addr) & this->table_mask;
+		row = ip->hash(ip, FALSE) & this->table_mask;
 		segment = row & this->segment_mask;
 		lock = this->half_open_segments[segment].lock;
 		lock->read_lock(lock);
@@ -1957,7 +2284,7 @@ METHOD(ike_sa_manager_t, get_half_open_count, u_int,
 
 			if (chunk_equals(addr, half_open->other))
 			{
-				count = half_open->count;
+				count = (u_int)ref_cur(&half_open->count);
 				break;
 			}
 			item = item->next;
@@ -2067,8 +2394,16 @@ METHOD(ike_sa_manager_t, destroy, void,
 	free(this->half_open_table);
 	free(this->connected_peers_table);
 	free(this->init_hashes_table);
+	free(this->init_hashes_filter);
 	for (i = 0; i < this->segment_count; i++)
 	{
+		table_item_t *spare;
+
+		while ((spare = this->segments[i].spare))
+		{
+			this->segments[i].spare = spare->next;
+			free(spare);
+		}
 		this->segments[i].mutex->destroy(this->segments[i].mutex);
 		this->half_open_segments[i].lock->destroy(this->half_open_segments[i].lock);
 		this->connected_peers_segments[i].lock->destroy(this->connected_peers_segments[i].lock);
@@ -2123,6 +2458,7 @@ ike_sa_manager_t *ike_sa_manager_create()
 			.checkin = _checkin,
 			.checkin_and_destroy = _checkin_and_destroy,
 			.get_count = _get_count,
+			.get_checkout_stats = _get_checkout_stats,
 			.get_half_open_count = _get_half_open_count,
 			.flush = _flush,
 			.destroy = _destroy,
@@ -2180,6 +2516,10 @@ ike_sa_manager_t *ike_sa_manager_create()
 
 	/* and again for the table of hashes of seen initial IKE messages */
 	this->init_hashes_table = calloc(this->table_size, sizeof(table_item_t*));
+	this->init_hashes_filter_mask = this->table_size *
+												INIT_HASH_FILTER_RATIO - 1;
+	this->init_hashes_filter = calloc(this->init_hashes_filter_mask + 1,
+									  sizeof(refcount_t));
 	this->init_hashes_segments = calloc(this->segment_count, sizeof(segment_t));
 	for (i = 0; i < this->segment_count; i++)
 	{
@@ -24,12 +24,47 @@
 #define IKE_SA_MANAGER_H_
 
 typedef struct ike_sa_manager_t ike_sa_manager_t;
+typedef struct ike_sa_checkout_stats_t ike_sa_checkout_stats_t;
 
 #include <library.h>
 #include <sa/ike_sa.h>
 #include <encoding/message.h>
 #include <config/peer_cfg.h>
 
+/**
+ * Counters describing contention on IKE_SA checkouts.
+ *
+ * All values are cumulative since startup, except waiting, which is the
+ * current number of threads blocked in a checkout.
+ */
+struct ike_sa_checkout_stats_t {
+
+	/**
+	 * Number of checkout attempts for existing entries.
+	 */
+	u_int32_t checkouts;
+
+	/**
+	 * Checkouts that had to wait for another thread.
+	 */
+	u_int32_t waits;
+
+	/**
+	 * Accumulated time checkouts spent waiting, in ms.
+	 */
+	u_int32_t wait_time_ms;
+
+	/**
+	 * Maximum time a single checkout waited, in ms.
+	 */
+	u_int32_t max_wait_ms;
+
+	/**
+	 * Number of threads currently waiting for an entry.
+	 */
+	u_int32_t waiting;
+};
+
 /**
  * Manages and synchronizes access to all IKE_SAs.
  *
@@ -210,6 +245,17 @@ struct ike_sa_manager_t {
 	 */
 	u_int (*get_count)(ike_sa_manager_t *this);
 
+	/**
+	 * Get counters describing checkout contention.
+	 *
+	 * The counters are updated with atomic operations only, querying them
+	 * does not interfere with the checkout paths.
+	 *
+	 * @param stats				filled with the current counter values
+	 */
+	void (*get_checkout_stats)(ike_sa_manager_t *this,
+							   ike_sa_checkout_stats_t *stats);
+
 	/**
 	 * Get the number of IKE_SAs which are in the connecting state.
 	 *
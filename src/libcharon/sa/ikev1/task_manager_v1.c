@@ -361,6 +361,7 @@ static status_t retransmit_packet(private_task_manager_t *this, u_int32_t seqnr,
 		DBG1(DBG_IKE, "sending retransmit %u of %s message ID %u, seq %u",
 			 retransmitted, seqnr < RESPONDING_SEQ ? "request" : "response",
 			 mid, seqnr < RESPONDING_SEQ ? seqnr : seqnr - RESPONDING_SEQ);
+		lib->metrics->increment(lib->metrics, METRIC_RETRANSMITS);
 		charon->bus->alert(charon->bus, ALERT_RETRANSMIT_SEND, packet);
 	}
 	send_packets(this, packets);
@@ -1131,8 +1132,14 @@ static status_t handle_fragment(private_task_manager_t *this, message_t *msg)
 	status = this->defrag->add_fragment(this->defrag, msg);
 	if (status == SUCCESS)
 	{
-		lib->processor->queue_job(lib->processor,
-							(job_t*)process_message_job_create(this->defrag));
+		ike_sa_id_t *id;
+		u_int64_t spi;
+
+		id = this->defrag->get_ike_sa_id(this->defrag);
+		spi = id->get_initiator_spi(id);
+		lib->processor->queue_job_group(lib->processor,
+							(job_t*)process_message_job_create(this->defrag),
+							(u_int)(spi ^ (spi >> 32)));
 		this->defrag = NULL;
 		/* do not process the last fragment */
 		status = NEED_MORE;
@@ -1202,6 +1209,8 @@ METHOD(task_manager_t, process_message, status_t,
 	host_t *me, *other;
 	status_t status;
 
+	lib->metrics->increment(lib->metrics, METRIC_EXCHANGES_PROCESSED);
+
 	/* TODO-IKEv1: update hosts more selectively */
 	me = msg->get_destination(msg);
 	other = msg->get_source(msg);
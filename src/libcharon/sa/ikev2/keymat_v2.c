@@ -103,7 +103,7 @@ static bool derive_ike_aead(private_keymat_v2_t *this, u_int16_t alg,
 							u_int16_t key_size, prf_plus_t *prf_plus)
 {
 	aead_t *aead_i, *aead_r;
-	chunk_t key = chunk_empty;
+	chunk_t key, keymat = chunk_empty;
 	u_int salt_size;
 
 	switch (alg)
@@ -145,21 +145,18 @@ static bool derive_ike_aead(private_keymat_v2_t *this, u_int16_t alg,
 	{
 		goto failure;
 	}
-	if (!prf_plus->allocate_bytes(prf_plus, key_size, &key))
+	/* derive SK_ei | SK_er in a single pass */
+	if (!prf_plus->allocate_all(prf_plus, 2 * key_size, &keymat))
 	{
 		goto failure;
 	}
+	key = chunk_create(keymat.ptr, key_size);
 	DBG4(DBG_IKE, "Sk_ei secret %B", &key);
 	if (!aead_i->set_key(aead_i, key))
 	{
 		goto failure;
 	}
-	chunk_clear(&key);
-
-	if (!prf_plus->allocate_bytes(prf_plus, key_size, &key))
-	{
-		goto failure;
-	}
+	key = chunk_create(keymat.ptr + key_size, key_size);
 	DBG4(DBG_IKE, "Sk_er secret %B", &key);
 	if (!aead_r->set_key(aead_r, key))
 	{
@@ -181,7 +178,7 @@ static bool derive_ike_aead(private_keymat_v2_t *this, u_int16_t alg,
 failure:
 	DESTROY_IF(aead_i);
 	DESTROY_IF(aead_r);
-	chunk_clear(&key);
+	chunk_clear(&keymat);
 	return this->aead_in && this->aead_out;
 }
 
@@ -193,8 +190,9 @@ static bool derive_ike_traditional(private_keymat_v2_t *this, u_int16_t enc_alg,
 {
 	crypter_t *crypter_i = NULL, *crypter_r = NULL;
 	signer_t *signer_i, *signer_r;
-	size_t key_size;
-	chunk_t key = chunk_empty;
+	size_t int_size, key_size;
+	chunk_t key, keymat = chunk_empty;
+	u_int8_t *pos;
 
 	signer_i = lib->crypto->create_signer(lib->crypto, int_alg);
 	signer_r = lib->crypto->create_signer(lib->crypto, int_alg);
@@ -215,49 +213,41 @@ static bool derive_ike_traditional(private_keymat_v2_t *this, u_int16_t enc_alg,
 		goto failure;
 	}
 
-	/* SK_ai/SK_ar used for integrity protection */
-	key_size = signer_i->get_key_size(signer_i);
+	int_size = signer_i->get_key_size(signer_i);
+	key_size = crypter_i->get_key_size(crypter_i);
 
-	if (!prf_plus->allocate_bytes(prf_plus, key_size, &key))
+	/* derive SK_ai | SK_ar | SK_ei | SK_er in a single pass */
+	if (!prf_plus->allocate_all(prf_plus, 2 * (int_size + key_size), &keymat))
 	{
 		goto failure;
 	}
+	pos = keymat.ptr;
+
+	/* SK_ai/SK_ar used for integrity protection */
+	key = chunk_create(pos, int_size);
+	pos += int_size;
 	DBG4(DBG_IKE, "Sk_ai secret %B", &key);
 	if (!signer_i->set_key(signer_i, key))
 	{
 		goto failure;
 	}
-	chunk_clear(&key);
-
-	if (!prf_plus->allocate_bytes(prf_plus, key_size, &key))
-	{
-		goto failure;
-	}
+	key = chunk_create(pos, int_size);
+	pos += int_size;
 	DBG4(DBG_IKE, "Sk_ar secret %B", &key);
 	if (!signer_r->set_key(signer_r, key))
 	{
 		goto failure;
 	}
-	chunk_clear(&key);
 
 	/* SK_ei/SK_er used for encryption */
-	key_size = crypter_i->get_key_size(crypter_i);
-
-	if (!prf_plus->allocate_bytes(prf_plus, key_size, &key))
-	{
-		goto failure;
-	}
+	key = chunk_create(pos, key_size);
+	pos += key_size;
 	DBG4(DBG_IKE, "Sk_ei secret %B", &key);
 	if (!crypter_i->set_key(crypter_i, key))
 	{
 		goto failure;
 	}
-	chunk_clear(&key);
-
-	if (!prf_plus->allocate_bytes(prf_plus, key_size, &key))
-	{
-		goto failure;
-	}
+	key = chunk_create(pos, key_size);
 	DBG4(DBG_IKE, "Sk_er secret %B", &key);
 	if (!crypter_r->set_key(crypter_r, key))
 	{
@@ -278,7 +268,7 @@ static bool derive_ike_traditional(private_keymat_v2_t *this, u_int16_t enc_alg,
 	crypter_i = crypter_r = NULL;
 
 failure:
-	chunk_clear(&key);
+	chunk_clear(&keymat);
 	DESTROY_IF(signer_i);
 	DESTROY_IF(signer_r);
 	DESTROY_IF(crypter_i);
@@ -292,7 +282,7 @@ METHOD(keymat_v2_t, derive_ike_keys, bool,
 	pseudo_random_function_t rekey_function, chunk_t rekey_skd)
 {
 	chunk_t skeyseed, key, secret, full_nonce, fixed_nonce, prf_plus_seed;
-	chunk_t spi_i, spi_r;
+	chunk_t spi_i, spi_r, skp_i, skp_r;
 	prf_plus_t *prf_plus = NULL;
 	u_int16_t alg, key_size, int_alg;
 	prf_t *rekey_prf = NULL;
@@ -404,7 +394,7 @@ METHOD(keymat_v2_t, derive_ike_keys, bool,
 
 	/* SK_d is used for generating CHILD_SA key mat => store for later use */
 	key_size = this->prf->get_key_size(this->prf);
-	if (!prf_plus->allocate_bytes(prf_plus, key_size, &this->skd))
+	if (!prf_plus->allocate_all(prf_plus, key_size, &this->skd))
 	{
 		goto failure;
 	}
@@ -439,33 +429,27 @@ METHOD(keymat_v2_t, derive_ike_keys, bool,
 		}
 	}
 
-	/* SK_pi/SK_pr used for authentication => stored for later */
+	/* SK_pi/SK_pr used for authentication => stored for later, derived
+	 * in a single pass and split afterwards */
 	key_size = this->prf->get_key_size(this->prf);
-	if (!prf_plus->allocate_bytes(prf_plus, key_size, &key))
+	if (!prf_plus->allocate_all(prf_plus, 2 * key_size, &key))
 	{
 		goto failure;
 	}
-	DBG4(DBG_IKE, "Sk_pi secret %B", &key);
-	if (this->initiator)
-	{
-		this->skp_build = key;
-	}
-	else
-	{
-		this->skp_verify = key;
-	}
-	if (!prf_plus->allocate_bytes(prf_plus, key_size, &key))
-	{
-		goto failure;
-	}
-	DBG4(DBG_IKE, "Sk_pr secret %B", &key);
+	skp_i = chunk_clone(chunk_create(key.ptr, key_size));
+	DBG4(DBG_IKE, "Sk_pi secret %B", &skp_i);
+	skp_r = chunk_clone(chunk_create(key.ptr + key_size, key_size));
+	DBG4(DBG_IKE, "Sk_pr secret %B", &skp_r);
+	chunk_clear(&key);
 	if (this->initiator)
 	{
-		this->skp_verify = key;
+		this->skp_build = skp_i;
+		this->skp_verify = skp_r;
 	}
 	else
 	{
-		this->skp_build = key;
+		this->skp_build = skp_r;
+		this->skp_verify = skp_i;
 	}
 
 	/* all done, prf_plus not needed anymore */
@@ -482,8 +466,9 @@ METHOD(keymat_v2_t, derive_child_keys, bool,
 	chunk_t *encr_r, chunk_t *integ_r)
 {
 	u_int16_t enc_alg, int_alg, enc_size = 0, int_size = 0;
-	chunk_t seed, secret = chunk_empty;
+	chunk_t seed, keymat, secret = chunk_empty;
 	prf_plus_t *prf_plus;
+	u_int8_t *pos;
 
 	if (proposal->get_algorithm(proposal, ENCRYPTION_ALGORITHM,
 								&enc_alg, &enc_size))
@@ -572,21 +557,25 @@ METHOD(keymat_v2_t, derive_child_keys, bool,
 	}
 
 	*encr_i = *integ_i = *encr_r = *integ_r = chunk_empty;
-	if (!prf_plus->allocate_bytes(prf_plus, enc_size, encr_i) ||
-		!prf_plus->allocate_bytes(prf_plus, int_size, integ_i) ||
-		!prf_plus->allocate_bytes(prf_plus, enc_size, encr_r) ||
-		!prf_plus->allocate_bytes(prf_plus, int_size, integ_r))
-	{
-		chunk_free(encr_i);
-		chunk_free(integ_i);
-		chunk_free(encr_r);
-		chunk_free(integ_r);
+	/* derive the whole keymat in a single pass, then split it up */
+	if (!prf_plus->allocate_all(prf_plus, (enc_size + int_size) * 2, &keymat))
+	{
 		prf_plus->destroy(prf_plus);
 		return FALSE;
 	}
 
 	prf_plus->destroy(prf_plus);
 
+	pos = keymat.ptr;
+	*encr_i = chunk_clone(chunk_create(pos, enc_size));
+	pos += enc_size;
+	*integ_i = chunk_clone(chunk_create(pos, int_size));
+	pos += int_size;
+	*encr_r = chunk_clone(chunk_create(pos, enc_size));
+	pos += enc_size;
+	*integ_r = chunk_clone(chunk_create(pos, int_size));
+	chunk_clear(&keymat);
+
 	if (enc_size)
 	{
 		DBG4(DBG_CHD, "encryption initiator key %B", encr_i);
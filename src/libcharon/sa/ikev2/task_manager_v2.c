@@ -16,8 +16,6 @@
 
 #include "task_manager_v2.h"
 
-#include <math.h>
-
 #include <collections/array.h>
 #include <daemon.h>
 #include <sa/ikev2/tasks/ike_init.h>
@@ -41,11 +39,18 @@
 #include <encoding/payloads/unknown_payload.h>
 #include <processing/jobs/retransmit_job.h>
 #include <processing/jobs/delete_ike_sa_job.h>
+#include <utils/probes.h>
 
 #ifdef ME
 #include <sa/ikev2/tasks/ike_me.h>
 #endif
 
+/**
+ * Number of precomputed retransmission timeouts, timeouts of later
+ * retransmits stay at the last table entry
+ */
+#define RETRANSMIT_BACKOFF_STEPS 16
+
 typedef struct exchange_t exchange_t;
 
 /**
@@ -81,6 +86,11 @@ struct private_task_manager_t {
 	 */
 	ike_sa_t *ike_sa;
 
+	/**
+	 * Arena for message generation scratch, reset after each exchange
+	 */
+	arena_t *arena;
+
 	/**
 	 * Exchange we are currently handling as responder
 	 */
@@ -164,14 +174,10 @@ struct private_task_manager_t {
 	u_int retransmit_tries;
 
 	/**
-	 * Retransmission timeout
-	 */
-	double retransmit_timeout;
-
-	/**
-	 * Base to calculate retransmission timeout
+	 * Precomputed retransmission timeouts in ms, indexed by the number of
+	 * retransmits already done for the message
 	 */
-	double retransmit_base;
+	u_int32_t retransmit_timeouts[RETRANSMIT_BACKOFF_STEPS];
 
 	/**
 	 * Use make-before-break instead of break-before-make reauth?
@@ -261,6 +267,7 @@ static void send_packets(private_task_manager_t *this, array_t *packets,
 	packet_t *packet, *clone;
 	int i;
 
+	PROBE1(message_send, array_count(packets));
 	for (i = 0; i < array_count(packets); i++)
 	{
 		array_get(packets, i, &packet);
@@ -285,19 +292,27 @@ static bool generate_message(private_task_manager_t *this, message_t *message,
 {
 	enumerator_t *fragments;
 	packet_t *fragment;
+	bool good = TRUE;
 
+	message->set_arena(message, this->arena);
 	if (this->ike_sa->generate_message_fragmented(this->ike_sa, message,
 												  &fragments) != SUCCESS)
 	{
-		return FALSE;
+		good = FALSE;
 	}
-	while (fragments->enumerate(fragments, &fragment))
+	else
 	{
-		array_insert_create(packets, ARRAY_TAIL, fragment);
+		while (fragments->enumerate(fragments, &fragment))
+		{
+			array_insert_create(packets, ARRAY_TAIL, fragment);
+		}
+		fragments->destroy(fragments);
+		array_compress(*packets);
 	}
-	fragments->destroy(fragments);
-	array_compress(*packets);
-	return TRUE;
+	/* generated packets hold copies of the wire data, recycle the scratch
+	 * memory for the next exchange */
+	this->arena->reset(this->arena);
+	return good;
 }
 
 METHOD(task_manager_t, retransmit, status_t,
@@ -334,8 +349,9 @@ METHOD(task_manager_t, retransmit, status_t,
 		{
 			if (this->initiating.retransmitted <= this->retransmit_tries)
 			{
-				timeout = (u_int32_t)(this->retransmit_timeout * 1000.0 *
-					pow(this->retransmit_base, this->initiating.retransmitted));
+				timeout = this->retransmit_timeouts[
+							min(this->initiating.retransmitted,
+								RETRANSMIT_BACKOFF_STEPS - 1)];
 			}
 			else
 			{
@@ -350,6 +366,7 @@ METHOD(task_manager_t, retransmit, status_t,
 			{
 				DBG1(DBG_IKE, "retransmit %d of request with message ID %d",
 					 this->initiating.retransmitted, message_id);
+				lib->metrics->increment(lib->metrics, METRIC_RETRANSMITS);
 				charon->bus->alert(charon->bus, ALERT_RETRANSMIT_SEND, packet);
 			}
 			if (!mobike)
@@ -847,6 +864,15 @@ static status_t build_response(private_task_manager_t *this, message_t *request)
 		return DESTROY_ME;
 	}
 
+	/* allow answering retransmits of this request from the cache, without
+	 * checking out the IKE_SA. The raw request allows the cache to verify
+	 * that a retransmit matches the request we authenticated. */
+	charon->response_cache->set(charon->response_cache,
+								this->ike_sa->get_id(this->ike_sa),
+								this->responding.mid,
+								request->get_packet_data(request),
+								this->responding.packets);
+
 	array_compress(this->passive_tasks);
 
 	return SUCCESS;
@@ -1265,12 +1291,15 @@ METHOD(task_manager_t, process_message, status_t,
 	u_int32_t mid;
 	bool schedule_delete_job = FALSE;
 
+	PROBE2(message_process, msg->get_exchange_type(msg),
+		   msg->get_message_id(msg));
 	charon->bus->message(charon->bus, msg, TRUE, FALSE);
 	status = parse_message(this, msg);
 	if (status != SUCCESS)
 	{
 		return status;
 	}
+	lib->metrics->increment(lib->metrics, METRIC_EXCHANGES_PROCESSED);
 
 	me = msg->get_destination(msg);
 	other = msg->get_source(msg);
@@ -1741,6 +1770,8 @@ METHOD(task_manager_t, reset, void,
 	task_t *task;
 
 	/* reset message counters and retransmit packets */
+	charon->response_cache->uncache(charon->response_cache,
+									this->ike_sa->get_id(this->ike_sa));
 	clear_packets(this->responding.packets);
 	clear_packets(this->initiating.packets);
 	DESTROY_IF(this->responding.defrag);
@@ -1796,6 +1827,9 @@ METHOD(task_manager_t, destroy, void,
 {
 	flush(this);
 
+	charon->response_cache->uncache(charon->response_cache,
+									this->ike_sa->get_id(this->ike_sa));
+
 	array_destroy(this->active_tasks);
 	array_destroy(this->queued_tasks);
 	array_destroy(this->passive_tasks);
@@ -1806,6 +1840,7 @@ METHOD(task_manager_t, destroy, void,
 	array_destroy(this->initiating.packets);
 	DESTROY_IF(this->responding.defrag);
 	DESTROY_IF(this->initiating.defrag);
+	this->arena->destroy(this->arena);
 	free(this);
 }
 
@@ -1815,6 +1850,8 @@ METHOD(task_manager_t, destroy, void,
 task_manager_v2_t *task_manager_v2_create(ike_sa_t *ike_sa)
 {
 	private_task_manager_t *this;
+	double timeout, base;
+	int i;
 
 	INIT(this,
 		.public = {
@@ -1844,19 +1881,28 @@ task_manager_v2_t *task_manager_v2_create(ike_sa_t *ike_sa)
 			},
 		},
 		.ike_sa = ike_sa,
+		.arena = arena_create(1024),
 		.initiating.type = EXCHANGE_TYPE_UNDEFINED,
 		.queued_tasks = array_create(0, 0),
 		.active_tasks = array_create(0, 0),
 		.passive_tasks = array_create(0, 0),
 		.retransmit_tries = lib->settings->get_int(lib->settings,
 					"%s.retransmit_tries", RETRANSMIT_TRIES, lib->ns),
-		.retransmit_timeout = lib->settings->get_double(lib->settings,
-					"%s.retransmit_timeout", RETRANSMIT_TIMEOUT, lib->ns),
-		.retransmit_base = lib->settings->get_double(lib->settings,
-					"%s.retransmit_base", RETRANSMIT_BASE, lib->ns),
 		.make_before_break = lib->settings->get_bool(lib->settings,
 					"%s.make_before_break", FALSE, lib->ns),
 	);
 
+	/* precompute the backoff table, so the hot retransmit path neither
+	 * calls pow() nor touches floating point at all */
+	timeout = lib->settings->get_double(lib->settings,
+					"%s.retransmit_timeout", RETRANSMIT_TIMEOUT, lib->ns) * 1000.0;
+	base = lib->settings->get_double(lib->settings,
+					"%s.retransmit_base", RETRANSMIT_BASE, lib->ns);
+	for (i = 0; i < RETRANSMIT_BACKOFF_STEPS; i++)
+	{
+		this->retransmit_timeouts[i] = (u_int32_t)min(timeout, (double)UINT32_MAX);
+		timeout *= base;
+	}
+
 	return &this->public;
 }
@@ -0,0 +1,288 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Hochschule fuer Technik Rapperswil
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include "keepalive_manager.h"
+
+#include <daemon.h>
+#include <threading/mutex.h>
+#include <collections/hashtable.h>
+#include <collections/linked_list.h>
+#include <processing/jobs/callback_job.h>
+
+/**
+ * Number of one second buckets in the keepalive wheel. Entries with an
+ * interval beyond the wheel size simply wrap around; they are skipped
+ * until due when their bucket comes up again.
+ */
+#define KEEPALIVE_WHEEL_SIZE 32
+
+typedef struct private_keepalive_manager_t private_keepalive_manager_t;
+
+/**
+ * Private data of keepalive_manager_t
+ */
+struct private_keepalive_manager_t {
+
+	/**
+	 * Public interface
+	 */
+	keepalive_manager_t public;
+
+	/**
+	 * Registered entries, ike_sa_id_t => entry_t
+	 */
+	hashtable_t *entries;
+
+	/**
+	 * Wheel of one second buckets, as linked_list_t* of entry_t*
+	 */
+	linked_list_t *wheel[KEEPALIVE_WHEEL_SIZE];
+
+	/**
+	 * Monotonic time the wheel was last advanced to
+	 */
+	time_t last;
+
+	/**
+	 * TRUE while the periodic job is scheduled
+	 */
+	bool scheduled;
+
+	/**
+	 * Mutex to lock wheel and entries
+	 */
+	mutex_t *mutex;
+};
+
+/**
+ * A registered keepalive target
+ */
+typedef struct {
+	/** identifier of the IKE_SA keepalives are sent for */
+	ike_sa_id_t *id;
+	/** local endpoint to send from */
+	host_t *src;
+	/** remote endpoint to send to */
+	host_t *dst;
+	/** interval between keepalives, in seconds */
+	u_int32_t interval;
+	/** monotonic time the next keepalive is due */
+	time_t next;
+	/** wheel bucket the entry currently lives in */
+	u_int slot;
+} entry_t;
+
+/**
+ * Destroy an entry
+ */
+static void entry_destroy(entry_t *this)
+{
+	this->id->destroy(this->id);
+	this->src->destroy(this->src);
+	this->dst->destroy(this->dst);
+	free(this);
+}
+
+/**
+ * Hashtable hash function for IKE_SA identifiers
+ */
+static u_int id_hash(ike_sa_id_t *id)
+{
+	u_int64_t spi_i, spi_r;
+
+	spi_i = id->get_initiator_spi(id);
+	spi_r = id->get_responder_spi(id);
+	return chunk_hash_inc(chunk_from_thing(spi_i),
+						  chunk_hash(chunk_from_thing(spi_r)));
+}
+
+/**
+ * Hashtable equals function for IKE_SA identifiers
+ */
+static bool id_equals(ike_sa_id_t *a, ike_sa_id_t *b)
+{
+	return a->equals(a, b);
+}
+
+/**
+ * Send a keepalive for the given entry, directly via the sender
+ */
+static void send_keepalive(entry_t *entry)
+{
+	packet_t *packet;
+	chunk_t data;
+
+	packet = packet_create();
+	packet->set_source(packet, entry->src->clone(entry->src));
+	packet->set_destination(packet, entry->dst->clone(entry->dst));
+	data.ptr = malloc(1);
+	data.ptr[0] = 0xFF;
+	data.len = 1;
+	packet->set_data(packet, data);
+	DBG1(DBG_IKE, "sending keep alive to %#H", entry->dst);
+	charon->sender->send_no_marker(charon->sender, packet);
+}
+
+/**
+ * Insert an entry into the bucket its next deadline maps to. Must be
+ * called with this->mutex held.
+ */
+static void wheel_insert(private_keepalive_manager_t *this, entry_t *entry)
+{
+	entry->slot = entry->next % KEEPALIVE_WHEEL_SIZE;
+	this->wheel[entry->slot]->insert_last(this->wheel[entry->slot], entry);
+}
+
+/**
+ * Periodic job advancing the wheel, one tick per second
+ */
+static job_requeue_t tick(private_keepalive_manager_t *this)
+{
+	enumerator_t *enumerator;
+	linked_list_t *slot;
+	entry_t *entry;
+	time_t now, t;
+
+	this->mutex->lock(this->mutex);
+	now = time_monotonic(NULL);
+	for (t = this->last + 1; t <= now; t++)
+	{
+		slot = this->wheel[t % KEEPALIVE_WHEEL_SIZE];
+		enumerator = slot->create_enumerator(slot);
+		while (enumerator->enumerate(enumerator, &entry))
+		{
+			if (entry->next <= now)
+			{
+				send_keepalive(entry);
+				slot->remove_at(slot, enumerator);
+				entry->next = now + entry->interval;
+				wheel_insert(this, entry);
+			}
+		}
+		enumerator->destroy(enumerator);
+	}
+	this->last = now;
+	if (!this->entries->get_count(this->entries))
+	{	/* nothing registered, next activate() reschedules us */
+		this->scheduled = FALSE;
+		this->mutex->unlock(this->mutex);
+		return JOB_REQUEUE_NONE;
+	}
+	this->mutex->unlock(this->mutex);
+	return JOB_RESCHEDULE(1);
+}
+
+METHOD(keepalive_manager_t, activate, void,
+	private_keepalive_manager_t *this, ike_sa_id_t *id, host_t *src,
+	host_t *dst, u_int32_t interval)
+{
+	entry_t *entry;
+
+	this->mutex->lock(this->mutex);
+	entry = this->entries->get(this->entries, id);
+	if (entry)
+	{
+		this->wheel[entry->slot]->remove(this->wheel[entry->slot],
+										 entry, NULL);
+		entry->src->destroy(entry->src);
+		entry->dst->destroy(entry->dst);
+	}
+	else
+	{
+		INIT(entry,
+			.id = id->clone(id),
+		);
+		this->entries->put(this->entries, entry->id, entry);
+	}
+	entry->src = src->clone(src);
+	entry->dst = dst->clone(dst);
+	entry->interval = interval;
+	entry->next = time_monotonic(NULL) + interval;
+	wheel_insert(this, entry);
+	if (!this->scheduled)
+	{
+		this->scheduled = TRUE;
+		this->last = time_monotonic(NULL);
+		lib->scheduler->schedule_job(lib->scheduler,
+			(job_t*)callback_job_create_with_prio((callback_job_cb_t)tick,
+				this, NULL, (callback_job_cancel_t)return_false,
+				JOB_PRIO_HIGH), 1);
+	}
+	this->mutex->unlock(this->mutex);
+}
+
+METHOD(keepalive_manager_t, deactivate, void,
+	private_keepalive_manager_t *this, ike_sa_id_t *id)
+{
+	entry_t *entry;
+
+	this->mutex->lock(this->mutex);
+	entry = this->entries->remove(this->entries, id);
+	if (entry)
+	{
+		this->wheel[entry->slot]->remove(this->wheel[entry->slot],
+										 entry, NULL);
+		entry_destroy(entry);
+	}
+	this->mutex->unlock(this->mutex);
+}
+
+METHOD(keepalive_manager_t, destroy, void,
+	private_keepalive_manager_t *this)
+{
+	enumerator_t *enumerator;
+	entry_t *entry;
+	int i;
+
+	enumerator = this->entries->create_enumerator(this->entries);
+	while (enumerator->enumerate(enumerator, NULL, &entry))
+	{
+		entry_destroy(entry);
+	}
+	enumerator->destroy(enumerator);
+	this->entries->destroy(this->entries);
+	for (i = 0; i < KEEPALIVE_WHEEL_SIZE; i++)
+	{
+		this->wheel[i]->destroy(this->wheel[i]);
+	}
+	this->mutex->destroy(this->mutex);
+	free(this);
+}
+
+/*
+ * Described in header
+ */
+keepalive_manager_t *keepalive_manager_create()
+{
+	private_keepalive_manager_t *this;
+	int i;
+
+	INIT(this,
+		.public = {
+			.activate = _activate,
+			.deactivate = _deactivate,
+			.destroy = _destroy,
+		},
+		.entries = hashtable_create((hashtable_hash_t)id_hash,
+									(hashtable_equals_t)id_equals, 32),
+		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+	);
+
+	for (i = 0; i < KEEPALIVE_WHEEL_SIZE; i++)
+	{
+		this->wheel[i] = linked_list_create();
+	}
+	return &this->public;
+}
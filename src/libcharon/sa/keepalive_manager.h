@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Hochschule fuer Technik Rapperswil
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/**
+ * @defgroup keepalive_manager keepalive_manager
+ * @{ @ingroup sa
+ */
+
+#ifndef KEEPALIVE_MANAGER_H_
+#define KEEPALIVE_MANAGER_H_
+
+typedef struct keepalive_manager_t keepalive_manager_t;
+
+#include <networking/host.h>
+#include <sa/ike_sa_id.h>
+
+/**
+ * Emits NAT-T keepalives for all registered IKE_SAs from a single periodic
+ * job, using a time-bucketed wheel of endpoint pairs.
+ *
+ * Keepalives are sent via the sender directly, without checking out the
+ * IKE_SA. IKE_SAs (de)register their current endpoints when the NAT
+ * condition or their addresses change.
+ */
+struct keepalive_manager_t {
+
+	/**
+	 * Register or refresh keepalives for an IKE_SA.
+	 *
+	 * If the IKE_SA is registered already, its endpoints and interval get
+	 * updated and the next keepalive is scheduled anew.
+	 *
+	 * @param id			IKE_SA identifier to register keepalives for
+	 * @param src			local endpoint to send keepalives from (cloned)
+	 * @param dst			remote endpoint to send keepalives to (cloned)
+	 * @param interval		seconds between keepalives
+	 */
+	void (*activate)(keepalive_manager_t *this, ike_sa_id_t *id,
+					 host_t *src, host_t *dst, u_int32_t interval);
+
+	/**
+	 * Stop sending keepalives for an IKE_SA.
+	 *
+	 * @param id			IKE_SA identifier to unregister
+	 */
+	void (*deactivate)(keepalive_manager_t *this, ike_sa_id_t *id);
+
+	/**
+	 * Destroy a keepalive_manager_t.
+	 */
+	void (*destroy)(keepalive_manager_t *this);
+};
+
+/**
+ * Create a keepalive_manager instance.
+ */
+keepalive_manager_t *keepalive_manager_create();
+
+#endif /** KEEPALIVE_MANAGER_H_ @}*/
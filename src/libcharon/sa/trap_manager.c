@@ -19,6 +19,7 @@
 #include <hydra.h>
 #include <daemon.h>
 #include <threading/rwlock.h>
+#include <collections/hashtable.h>
 #include <collections/linked_list.h>
 
 
@@ -56,6 +57,12 @@ struct private_trap_manager_t {
 	 */
 	linked_list_t *traps;
 
+	/**
+	 * Installed traps with a CHILD_SA, indexed by reqid, so the kernel
+	 * acquire path does not walk the trap list
+	 */
+	hashtable_t *traps_by_reqid;
+
 	/**
 	 * read write lock for traps list
 	 */
@@ -199,6 +206,11 @@ METHOD(trap_manager_t, install, u_int32_t,
 		DBG1(DBG_CFG, "installing trap failed");
 		this->lock->write_lock(this->lock);
 		this->traps->remove(this->traps, entry, NULL);
+		if (found)
+		{	/* the replaced trap is destroyed below, drop its index entry */
+			this->traps_by_reqid->remove(this->traps_by_reqid,
+										 (void*)(uintptr_t)reqid);
+		}
 		this->lock->unlock(this->lock);
 		entry->child_sa = child_sa;
 		destroy_entry(entry);
@@ -209,6 +221,8 @@ METHOD(trap_manager_t, install, u_int32_t,
 		reqid = child_sa->get_reqid(child_sa);
 		this->lock->write_lock(this->lock);
 		entry->child_sa = child_sa;
+		this->traps_by_reqid->put(this->traps_by_reqid,
+								  (void*)(uintptr_t)reqid, entry);
 		this->lock->unlock(this->lock);
 	}
 	if (found)
@@ -221,22 +235,15 @@ METHOD(trap_manager_t, install, u_int32_t,
 METHOD(trap_manager_t, uninstall, bool,
 	private_trap_manager_t *this, u_int32_t reqid)
 {
-	enumerator_t *enumerator;
-	entry_t *entry, *found = NULL;
+	entry_t *found;
 
 	this->lock->write_lock(this->lock);
-	enumerator = this->traps->create_enumerator(this->traps);
-	while (enumerator->enumerate(enumerator, &entry))
+	found = this->traps_by_reqid->remove(this->traps_by_reqid,
+										 (void*)(uintptr_t)reqid);
+	if (found)
 	{
-		if (entry->child_sa &&
-			entry->child_sa->get_reqid(entry->child_sa) == reqid)
-		{
-			this->traps->remove_at(this->traps, enumerator);
-			found = entry;
-			break;
-		}
+		this->traps->remove(this->traps, found, NULL);
 	}
-	enumerator->destroy(enumerator);
 	this->lock->unlock(this->lock);
 
 	if (!found)
@@ -307,25 +314,14 @@ METHOD(trap_manager_t, acquire, void,
 	private_trap_manager_t *this, u_int32_t reqid,
 	traffic_selector_t *src, traffic_selector_t *dst)
 {
-	enumerator_t *enumerator;
-	entry_t *entry, *found = NULL;
+	entry_t *found;
 	peer_cfg_t *peer;
 	child_cfg_t *child;
 	ike_sa_t *ike_sa;
 
 	this->lock->read_lock(this->lock);
-	enumerator = this->traps->create_enumerator(this->traps);
-	while (enumerator->enumerate(enumerator, &entry))
-	{
-		if (entry->child_sa &&
-			entry->child_sa->get_reqid(entry->child_sa) == reqid)
-		{
-			found = entry;
-			break;
-		}
-	}
-	enumerator->destroy(enumerator);
-
+	found = this->traps_by_reqid->get(this->traps_by_reqid,
+									  (void*)(uintptr_t)reqid);
 	if (!found)
 	{
 		DBG1(DBG_CFG, "trap not found, unable to acquire reqid %d",reqid);
@@ -440,12 +436,17 @@ METHOD(trap_manager_t, flush, void,
 	private_trap_manager_t *this)
 {
 	linked_list_t *traps;
+	hashtable_t *by_reqid;
 	/* since destroying the CHILD_SA results in events which require a read
 	 * lock we cannot destroy the list while holding the write lock */
 	this->lock->write_lock(this->lock);
 	traps = this->traps;
+	by_reqid = this->traps_by_reqid;
 	this->traps = linked_list_create();
+	this->traps_by_reqid = hashtable_create(hashtable_hash_ptr,
+											hashtable_equals_ptr, 8);
 	this->lock->unlock(this->lock);
+	by_reqid->destroy(by_reqid);
 	traps->destroy_function(traps, (void*)destroy_entry);
 }
 
@@ -454,6 +455,7 @@ METHOD(trap_manager_t, destroy, void,
 {
 	charon->bus->remove_listener(charon->bus, &this->listener.listener);
 	this->traps->destroy_function(this->traps, (void*)destroy_entry);
+	this->traps_by_reqid->destroy(this->traps_by_reqid);
 	this->lock->destroy(this->lock);
 	free(this);
 }
@@ -483,6 +485,8 @@ trap_manager_t *trap_manager_create(void)
 			},
 		},
 		.traps = linked_list_create(),
+		.traps_by_reqid = hashtable_create(hashtable_hash_ptr,
+										   hashtable_equals_ptr, 8),
 		.lock = rwlock_create(RWLOCK_TYPE_DEFAULT),
 	);
 	charon->bus->add_listener(charon->bus, &this->listener.listener);
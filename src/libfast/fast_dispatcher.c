@@ -32,8 +32,32 @@
 /** Intervall to check for expired sessions, in seconds */
 #define CLEANUP_INTERVAL 30
 
+/** Number of session stripes, each with its own lock and hashtable */
+#define SESSION_STRIPES 32
+
 typedef struct private_fast_dispatcher_t private_fast_dispatcher_t;
 
+/**
+ * A stripe of the session storage, lockable independently
+ */
+typedef struct {
+
+	/**
+	 * mutex protecting the sessions of this stripe
+	 */
+	mutex_t *mutex;
+
+	/**
+	 * sessions of this stripe, indexed by session ID
+	 */
+	hashtable_t *sessions;
+
+	/**
+	 * timestamp of last session cleanup round in this stripe
+	 */
+	time_t last_cleanup;
+} session_stripe_t;
+
 /**
  * private data of the task manager
  */
@@ -60,25 +84,15 @@ struct private_fast_dispatcher_t {
 	int thread_count;
 
 	/**
-	 * session locking mutex
+	 * striped storage for active sessions
 	 */
-	mutex_t *mutex;
-
-	/**
-	 * Hahstable with active sessions
-	 */
-	hashtable_t *sessions;
+	session_stripe_t stripes[SESSION_STRIPES];
 
 	/**
 	 * session timeout
 	 */
 	time_t timeout;
 
-	/**
-	 * timestamp of last session cleanup round
-	 */
-	time_t last_cleanup;
-
 	/**
 	 * running in debug mode?
 	 */
@@ -253,20 +267,29 @@ static bool session_equals(char *sid1, char *sid2)
 }
 
 /**
- * Cleanup unused sessions
+ * Get the stripe a session ID maps to
  */
-static void cleanup_sessions(private_fast_dispatcher_t *this, time_t now)
+static session_stripe_t *get_stripe(private_fast_dispatcher_t *this, char *sid)
 {
-	if (this->last_cleanup < now - CLEANUP_INTERVAL)
+	return &this->stripes[session_hash(sid) % SESSION_STRIPES];
+}
+
+/**
+ * Cleanup unused sessions in a stripe, stripe mutex held
+ */
+static void cleanup_sessions(private_fast_dispatcher_t *this,
+							 session_stripe_t *stripe, time_t now)
+{
+	if (stripe->last_cleanup < now - CLEANUP_INTERVAL)
 	{
 		char *sid;
 		session_entry_t *entry;
 		enumerator_t *enumerator;
 		linked_list_t *remove;
 
-		this->last_cleanup = now;
+		stripe->last_cleanup = now;
 		remove = linked_list_create();
-		enumerator = this->sessions->create_enumerator(this->sessions);
+		enumerator = stripe->sessions->create_enumerator(stripe->sessions);
 		while (enumerator->enumerate(enumerator, &sid, &entry))
 		{
 			/* check all sessions for timeout or close flag */
@@ -280,7 +303,7 @@ static void cleanup_sessions(private_fast_dispatcher_t *this, time_t now)
 
 		while (remove->remove_last(remove, (void**)&sid) == SUCCESS)
 		{
-			entry = this->sessions->remove(this->sessions, sid);
+			entry = stripe->sessions->remove(stripe->sessions, sid);
 			if (entry)
 			{
 				session_entry_destroy(entry);
@@ -301,6 +324,7 @@ static void dispatch(private_fast_dispatcher_t *this)
 	{
 		fast_request_t *request;
 		session_entry_t *found = NULL;
+		session_stripe_t *stripe;
 		time_t now;
 		char *sid;
 
@@ -315,49 +339,53 @@ static void dispatch(private_fast_dispatcher_t *this)
 		now = time_monotonic(NULL);
 		sid = request->get_cookie(request, "SID");
 
-		this->mutex->lock(this->mutex);
 		if (sid)
 		{
-			found = this->sessions->get(this->sessions, sid);
-		}
-		if (found && !streq(found->host, request->get_host(request)))
-		{
-			found = NULL;
-		}
-		if (found)
-		{
-			/* wait until session is unused */
-			while (found->in_use)
+			stripe = get_stripe(this, sid);
+			stripe->mutex->lock(stripe->mutex);
+			found = stripe->sessions->get(stripe->sessions, sid);
+			if (found && !streq(found->host, request->get_host(request)))
+			{
+				found = NULL;
+			}
+			if (found)
 			{
-				found->cond->wait(found->cond, this->mutex);
+				/* wait until session is unused */
+				while (found->in_use)
+				{
+					found->cond->wait(found->cond, stripe->mutex);
+				}
+				found->in_use = TRUE;
 			}
+			stripe->mutex->unlock(stripe->mutex);
 		}
-		else
-		{	/* create a new session if not found */
+		if (!found)
+		{	/* create a new session if not found, outside of any stripe lock */
 			found = session_entry_create(this, request->get_host(request));
 			if (!found)
 			{
 				request->destroy(request);
-				this->mutex->unlock(this->mutex);
 				continue;
 			}
+			found->in_use = TRUE;
 			sid = found->session->get_sid(found->session);
-			this->sessions->put(this->sessions, sid, found);
+			stripe = get_stripe(this, sid);
+			stripe->mutex->lock(stripe->mutex);
+			stripe->sessions->put(stripe->sessions, sid, found);
+			stripe->mutex->unlock(stripe->mutex);
 		}
-		found->in_use = TRUE;
-		this->mutex->unlock(this->mutex);
 
 		/* start processing */
 		found->session->process(found->session, request);
 		found->used = time_monotonic(NULL);
 
 		/* release session */
-		this->mutex->lock(this->mutex);
+		stripe->mutex->lock(stripe->mutex);
 		found->in_use = FALSE;
 		found->closed = request->session_closed(request);
 		found->cond->signal(found->cond);
-		cleanup_sessions(this, now);
-		this->mutex->unlock(this->mutex);
+		cleanup_sessions(this, stripe, now);
+		stripe->mutex->unlock(stripe->mutex);
 
 		request->destroy(request);
 	}
@@ -399,6 +427,7 @@ METHOD(fast_dispatcher_t, destroy, void,
 	char *sid;
 	session_entry_t *entry;
 	enumerator_t *enumerator;
+	int i;
 
 	FCGX_ShutdownPending();
 	while (this->thread_count--)
@@ -407,16 +436,20 @@ METHOD(fast_dispatcher_t, destroy, void,
 		thread->cancel(thread);
 		thread->join(thread);
 	}
-	enumerator = this->sessions->create_enumerator(this->sessions);
-	while (enumerator->enumerate(enumerator, &sid, &entry))
+	for (i = 0; i < SESSION_STRIPES; i++)
 	{
-		session_entry_destroy(entry);
+		enumerator = this->stripes[i].sessions->create_enumerator(
+													this->stripes[i].sessions);
+		while (enumerator->enumerate(enumerator, &sid, &entry))
+		{
+			session_entry_destroy(entry);
+		}
+		enumerator->destroy(enumerator);
+		this->stripes[i].sessions->destroy(this->stripes[i].sessions);
+		this->stripes[i].mutex->destroy(this->stripes[i].mutex);
 	}
-	enumerator->destroy(enumerator);
-	this->sessions->destroy(this->sessions);
 	this->controllers->destroy_function(this->controllers, free);
 	this->filters->destroy_function(this->filters, free);
-	this->mutex->destroy(this->mutex);
 	free(this->threads);
 	free(this);
 }
@@ -428,6 +461,8 @@ fast_dispatcher_t *fast_dispatcher_create(char *socket, bool debug, int timeout,
 							fast_context_constructor_t constructor, void *param)
 {
 	private_fast_dispatcher_t *this;
+	time_t now;
+	int i;
 
 	INIT(this,
 		.public = {
@@ -437,18 +472,24 @@ fast_dispatcher_t *fast_dispatcher_create(char *socket, bool debug, int timeout,
 			.waitsignal = _waitsignal,
 			.destroy = _destroy,
 		},
-		.sessions = hashtable_create((void*)session_hash,
-									 (void*)session_equals, 4096),
 		.controllers = linked_list_create(),
 		.filters = linked_list_create(),
 		.context_constructor = constructor,
-		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
 		.param = param,
 		.timeout = timeout,
-		.last_cleanup = time_monotonic(NULL),
 		.debug = debug,
 	);
 
+	now = time_monotonic(NULL);
+	for (i = 0; i < SESSION_STRIPES; i++)
+	{
+		this->stripes[i].mutex = mutex_create(MUTEX_TYPE_DEFAULT);
+		this->stripes[i].sessions = hashtable_create((void*)session_hash,
+										(void*)session_equals,
+										4096 / SESSION_STRIPES);
+		this->stripes[i].last_cleanup = now;
+	}
+
 	FCGX_Init();
 
 	if (socket)
@@ -100,6 +100,7 @@ struct kernel_ipsec_t {
 	 * @param initiator		TRUE if initiator of the exchange creating this SA
 	 * @param encap			enable UDP encapsulation for NAT traversal
 	 * @param esn			TRUE to use Extended Sequence Numbers
+	 * @param hw_offload	TRUE to offload this SA to hardware, if supported
 	 * @param inbound		TRUE if this is an inbound SA
 	 * @param update		TRUE if an SPI has already been allocated for SA
 	 * @param src_ts		list of source traffic selectors
@@ -114,7 +115,7 @@ struct kernel_ipsec_t {
 						u_int16_t int_alg, chunk_t int_key,
 						ipsec_mode_t mode, u_int16_t ipcomp, u_int16_t cpi,
 						u_int32_t replay_window, bool initiator, bool encap,
-						bool esn, bool inbound, bool update,
+						bool esn, bool hw_offload, bool inbound, bool update,
 						linked_list_t *src_ts, linked_list_t *dst_ts);
 
 	/**
@@ -31,6 +31,7 @@
 #include <errno.h>
 #include <string.h>
 #include <fcntl.h>
+#include <net/if.h>
 
 #include "kernel_netlink_ipsec.h"
 #include "kernel_netlink_shared.h"
@@ -38,9 +39,11 @@
 #include <hydra.h>
 #include <utils/debug.h>
 #include <threading/mutex.h>
+#include <threading/thread_value.h>
 #include <collections/array.h>
 #include <collections/hashtable.h>
 #include <collections/linked_list.h>
+#include <utils/probes.h>
 
 /** Required for Linux 2.6.26 kernel and later */
 #ifndef XFRM_STATE_AF_UNSPEC
@@ -330,6 +333,11 @@ struct private_kernel_netlink_ipsec_t {
 	 * Installed port based IKE bypass policies, as bypass_t
 	 */
 	array_t *bypass;
+
+	/**
+	 * Thread specific batch collecting XFRM messages, as netlink_batch_t
+	 */
+	thread_value_t *batch;
 };
 
 typedef struct route_entry_t route_entry_t;
@@ -594,7 +602,8 @@ static void policy_entry_destroy(private_kernel_netlink_ipsec_t *this,
 static u_int policy_hash(policy_entry_t *key)
 {
 	chunk_t chunk = chunk_from_thing(key->sel);
-	return chunk_hash_inc(chunk, chunk_hash(chunk_from_thing(key->mark)));
+	return chunk_hash_inc(chunk, chunk_hash_inc(chunk_from_thing(key->mark),
+						  chunk_hash(chunk_from_thing(key->direction))));
 }
 
 /**
@@ -1191,14 +1200,71 @@ static bool add_mark(struct nlmsghdr *hdr, int buflen, mark_t mark)
 	return TRUE;
 }
 
+/**
+ * Add a hardware offload request for the device carrying the given local
+ * address to the message.  Returns FALSE if no device could be determined.
+ */
+static bool add_hw_offload(struct nlmsghdr *hdr, int buflen, host_t *local,
+						   bool inbound)
+{
+	struct xfrm_user_offload *offload;
+	char *iface;
+	u_int ifindex;
+
+	if (!hydra->kernel_interface->get_interface(hydra->kernel_interface,
+												local, &iface))
+	{
+		return FALSE;
+	}
+	ifindex = if_nametoindex(iface);
+	free(iface);
+	if (!ifindex)
+	{
+		return FALSE;
+	}
+	offload = netlink_reserve(hdr, buflen, XFRMA_OFFLOAD_DEV, sizeof(*offload));
+	if (!offload)
+	{
+		return FALSE;
+	}
+	offload->ifindex = ifindex;
+	if (inbound)
+	{
+		offload->flags |= XFRM_OFFLOAD_INBOUND;
+	}
+	if (local->get_family(local) == AF_INET6)
+	{
+		offload->flags |= XFRM_OFFLOAD_IPV6;
+	}
+	return TRUE;
+}
+
+/**
+ * Send an XFRM message and wait for the ack, or queue it to the batch, if
+ * the calling thread has one active
+ */
+static status_t send_or_queue(private_kernel_netlink_ipsec_t *this,
+							  struct nlmsghdr *hdr)
+{
+	netlink_batch_t *batch;
+
+	batch = this->batch->get(this->batch);
+	if (batch)
+	{
+		batch->add(batch, hdr);
+		return SUCCESS;
+	}
+	return this->socket_xfrm->send_ack(this->socket_xfrm, hdr);
+}
+
 METHOD(kernel_ipsec_t, add_sa, status_t,
 	private_kernel_netlink_ipsec_t *this, host_t *src, host_t *dst,
 	u_int32_t spi, u_int8_t protocol, u_int32_t reqid, mark_t mark,
 	u_int32_t tfc, lifetime_cfg_t *lifetime, u_int16_t enc_alg, chunk_t enc_key,
 	u_int16_t int_alg, chunk_t int_key, ipsec_mode_t mode,
 	u_int16_t ipcomp, u_int16_t cpi, u_int32_t replay_window,
-	bool initiator, bool encap, bool esn, bool inbound, bool update,
-	linked_list_t* src_ts, linked_list_t* dst_ts)
+	bool initiator, bool encap, bool esn, bool hw_offload, bool inbound,
+	bool update, linked_list_t* src_ts, linked_list_t* dst_ts)
 {
 	netlink_buf_t request;
 	char *alg_name;
@@ -1207,8 +1273,10 @@ METHOD(kernel_ipsec_t, add_sa, status_t,
 	u_int16_t icv_size = 64;
 	ipsec_mode_t original_mode = mode;
 	traffic_selector_t *first_src_ts, *first_dst_ts;
+	u_int32_t len_without_offload = 0;
 	status_t status = FAILED;
 
+	PROBE2(kernel_add_sa, ntohl(spi), protocol);
 	/* if IPComp is used, we install an additional IPComp SA. if the cpi is 0
 	 * we are in the recursive call below */
 	if (ipcomp != IPCOMP_NONE && cpi != 0)
@@ -1217,7 +1285,7 @@ METHOD(kernel_ipsec_t, add_sa, status_t,
 		add_sa(this, src, dst, htonl(ntohs(cpi)), IPPROTO_COMP, reqid, mark,
 			   tfc, &lft, ENCR_UNDEFINED, chunk_empty, AUTH_UNDEFINED,
 			   chunk_empty, mode, ipcomp, 0, 0, initiator, FALSE, FALSE,
-			   inbound, update, src_ts, dst_ts);
+			   FALSE, inbound, update, src_ts, dst_ts);
 		ipcomp = IPCOMP_NONE;
 		/* use transport mode ESP SA, IPComp uses tunnel mode */
 		mode = MODE_TRANSPORT;
@@ -1519,7 +1587,28 @@ METHOD(kernel_ipsec_t, add_sa, status_t,
 		}
 	}
 
-	if (this->socket_xfrm->send_ack(this->socket_xfrm, hdr) != SUCCESS)
+	if (hw_offload && protocol != IPPROTO_COMP)
+	{	/* remember the message length without the offload request, so we can
+		 * strip it again if the kernel or the device rejects it */
+		len_without_offload = hdr->nlmsg_len;
+		if (!add_hw_offload(hdr, sizeof(request), inbound ? dst : src, inbound))
+		{
+			DBG1(DBG_KNL, "no usable device for SAD entry with SPI %.8x, not "
+				 "requesting hardware offload", ntohl(spi));
+			len_without_offload = 0;
+		}
+	}
+
+	status = send_or_queue(this, hdr);
+	if (status != SUCCESS && len_without_offload &&
+		hdr->nlmsg_len > len_without_offload)
+	{
+		DBG1(DBG_KNL, "hardware offload of SAD entry with SPI %.8x rejected "
+			 "by kernel, installing without offload", ntohl(spi));
+		hdr->nlmsg_len = len_without_offload;
+		status = send_or_queue(this, hdr);
+	}
+	if (status != SUCCESS)
 	{
 		if (mark.value)
 		{
@@ -1530,12 +1619,14 @@ METHOD(kernel_ipsec_t, add_sa, status_t,
 		{
 			DBG1(DBG_KNL, "unable to add SAD entry with SPI %.8x", ntohl(spi));
 		}
+		status = FAILED;
 		goto failed;
 	}
 
 	status = SUCCESS;
 
 failed:
+	PROBE2(kernel_add_sa_done, ntohl(spi), status);
 	memwipe(&request, sizeof(request));
 	return status;
 }
@@ -2123,7 +2214,7 @@ static status_t add_policy_internal(private_kernel_netlink_ipsec_t *this,
 	}
 	this->mutex->unlock(this->mutex);
 
-	if (this->socket_xfrm->send_ack(this->socket_xfrm, hdr) != SUCCESS)
+	if (send_or_queue(this, hdr) != SUCCESS)
 	{
 		return FAILED;
 	}
@@ -2801,6 +2892,30 @@ METHOD(kernel_ipsec_t, enable_udp_decap, bool,
 	return TRUE;
 }
 
+METHOD(kernel_netlink_ipsec_t, begin_batch, void,
+	private_kernel_netlink_ipsec_t *this)
+{
+	if (!this->batch->get(this->batch))
+	{
+		this->batch->set(this->batch,
+						 netlink_batch_create(this->socket_xfrm));
+	}
+}
+
+METHOD(kernel_netlink_ipsec_t, commit_batch, status_t,
+	private_kernel_netlink_ipsec_t *this)
+{
+	netlink_batch_t *batch;
+
+	batch = this->batch->get(this->batch);
+	if (!batch)
+	{
+		return SUCCESS;
+	}
+	this->batch->set(this->batch, NULL);
+	return batch->commit(batch);
+}
+
 METHOD(kernel_ipsec_t, destroy, void,
 	private_kernel_netlink_ipsec_t *this)
 {
@@ -2823,6 +2938,7 @@ METHOD(kernel_ipsec_t, destroy, void,
 	enumerator->destroy(enumerator);
 	this->policies->destroy(this->policies);
 	this->sas->destroy(this->sas);
+	this->batch->destroy(this->batch);
 	this->mutex->destroy(this->mutex);
 	free(this);
 }
@@ -2855,12 +2971,15 @@ kernel_netlink_ipsec_t *kernel_netlink_ipsec_create()
 				.enable_udp_decap = _enable_udp_decap,
 				.destroy = _destroy,
 			},
+			.begin_batch = _begin_batch,
+			.commit_batch = _commit_batch,
 		},
 		.policies = hashtable_create((hashtable_hash_t)policy_hash,
 									 (hashtable_equals_t)policy_equals, 32),
 		.sas = hashtable_create((hashtable_hash_t)ipsec_sa_hash,
 								(hashtable_equals_t)ipsec_sa_equals, 32),
 		.bypass = array_create(sizeof(bypass_t), 0),
+		.batch = thread_value_create(NULL),
 		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
 		.policy_history = TRUE,
 		.policy_update = lib->settings->get_bool(lib->settings,
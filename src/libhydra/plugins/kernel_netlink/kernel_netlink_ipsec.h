@@ -34,6 +34,24 @@ struct kernel_netlink_ipsec_t {
 	 * Implements kernel_ipsec_t interface
 	 */
 	kernel_ipsec_t interface;
+
+	/**
+	 * Start batching XFRM installations on the calling thread.
+	 *
+	 * Until commit_batch() is called by the same thread, add_sa() and
+	 * add_policy() queue their XFRM messages instead of sending them,
+	 * returning optimistic success. This coalesces the SA and policies of a
+	 * CHILD_SA install, or a bulk install of many SAs during failover, into
+	 * a single netlink submission with one acknowledge wait.
+	 */
+	void (*begin_batch)(kernel_netlink_ipsec_t *this);
+
+	/**
+	 * Send all XFRM messages batched by the calling thread.
+	 *
+	 * @return		SUCCESS if all queued installations were acknowledged
+	 */
+	status_t (*commit_batch)(kernel_netlink_ipsec_t *this);
 };
 
 /**
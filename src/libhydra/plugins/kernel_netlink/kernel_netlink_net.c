@@ -334,6 +334,69 @@ static bool route_entry_equals(route_entry_t *a, route_entry_t *b)
 	return FALSE;
 }
 
+typedef struct route_cache_entry_t route_cache_entry_t;
+
+/**
+ * Cached result of a route lookup
+ */
+struct route_cache_entry_t {
+	/** Destination that was looked up */
+	host_t *dest;
+
+	/** Destination prefix */
+	int prefix;
+
+	/** Whether the nexthop was looked up, the source address otherwise */
+	bool nexthop;
+
+	/** Preferred source address, if any */
+	host_t *candidate;
+
+	/** Result of the lookup, NULL if none found */
+	host_t *addr;
+};
+
+/**
+ * Destroy a route_cache_entry_t object
+ */
+static void route_cache_entry_destroy(route_cache_entry_t *this)
+{
+	this->dest->destroy(this->dest);
+	DESTROY_IF(this->candidate);
+	DESTROY_IF(this->addr);
+	free(this);
+}
+
+/**
+ * Hash a route_cache_entry_t object
+ */
+static u_int route_cache_entry_hash(route_cache_entry_t *this)
+{
+	u_int hash;
+
+	hash = chunk_hash_inc(this->dest->get_address(this->dest),
+						  chunk_hash(chunk_from_thing(this->prefix)));
+	if (this->candidate)
+	{
+		hash = chunk_hash_inc(this->candidate->get_address(this->candidate),
+							  hash);
+	}
+	return this->nexthop ? ~hash : hash;
+}
+
+/**
+ * Compare two route_cache_entry_t objects
+ */
+static bool route_cache_entry_equals(route_cache_entry_t *a,
+									 route_cache_entry_t *b)
+{
+	return a->nexthop == b->nexthop && a->prefix == b->prefix &&
+		   a->dest->ip_equals(a->dest, b->dest) &&
+		   (a->candidate == b->candidate ||
+			(a->candidate && b->candidate &&
+			 a->candidate->ip_equals(a->candidate, b->candidate)));
+}
+
 typedef struct net_change_t net_change_t;
 
 /**
@@ -450,6 +513,17 @@ struct private_kernel_netlink_net_t {
 	 */
 	mutex_t *routes_lock;
 
+	/**
+	 * cache of completed route lookups (route_cache_entry_t), NULL if
+	 * change events are not available to invalidate it
+	 */
+	hashtable_t *route_cache;
+
+	/**
+	 * mutex for route lookup cache
+	 */
+	mutex_t *route_cache_lock;
+
 	/**
 	 * interface changes which may trigger route reinstallation
 	 */
@@ -519,6 +593,29 @@ static status_t manage_srcroute(private_kernel_netlink_net_t *this,
 								u_int8_t prefixlen, host_t *gateway,
 								host_t *src_ip, char *if_name);
 
+/**
+ * Invalidate all cached route lookups, e.g. after a network change
+ */
+static void flush_route_cache(private_kernel_netlink_net_t *this)
+{
+	enumerator_t *enumerator;
+	route_cache_entry_t *entry;
+
+	if (!this->route_cache)
+	{
+		return;
+	}
+	this->route_cache_lock->lock(this->route_cache_lock);
+	enumerator = this->route_cache->create_enumerator(this->route_cache);
+	while (enumerator->enumerate(enumerator, NULL, (void**)&entry))
+	{
+		this->route_cache->remove_at(this->route_cache, enumerator);
+		route_cache_entry_destroy(entry);
+	}
+	enumerator->destroy(enumerator);
+	this->route_cache_lock->unlock(this->route_cache_lock);
+}
+
 /**
  * Clear the queued network changes.
  */
@@ -1305,14 +1402,17 @@ static bool receive_events(private_kernel_netlink_net_t *this, int fd,
 		{
 			case RTM_NEWADDR:
 			case RTM_DELADDR:
+				flush_route_cache(this);
 				process_addr(this, hdr, TRUE);
 				break;
 			case RTM_NEWLINK:
 			case RTM_DELLINK:
+				flush_route_cache(this);
 				process_link(this, hdr, TRUE);
 				break;
 			case RTM_NEWROUTE:
 			case RTM_DELROUTE:
+				flush_route_cache(this);
 				if (this->process_route)
 				{
 					process_route(this, hdr);
@@ -1651,6 +1751,26 @@ static host_t *get_route(private_kernel_netlink_net_t *this, host_t *dest,
 	prefix = prefix < 0 ? len : min(prefix, len);
 	match_net = prefix != len;
 
+	if (this->route_cache)
+	{
+		route_cache_entry_t *entry, lookup = {
+			.dest = dest,
+			.prefix = prefix,
+			.nexthop = nexthop,
+			.candidate = candidate,
+		};
+
+		this->route_cache_lock->lock(this->route_cache_lock);
+		entry = this->route_cache->get(this->route_cache, &lookup);
+		if (entry)
+		{
+			addr = entry->addr ? entry->addr->clone(entry->addr) : NULL;
+			this->route_cache_lock->unlock(this->route_cache_lock);
+			return addr;
+		}
+		this->route_cache_lock->unlock(this->route_cache_lock);
+	}
+
 	memset(&request, 0, sizeof(request));
 
 	family = dest->get_family(dest);
@@ -1867,6 +1987,27 @@ static host_t *get_route(private_kernel_netlink_net_t *this, host_t *dest,
 		DBG2(DBG_KNL, "no %s found to reach %H/%d",
 			 nexthop ? "nexthop" : "address", dest, prefix);
 	}
+
+	if (this->route_cache)
+	{	/* cache the result, even a negative one, until a change event
+		 * invalidates it */
+		route_cache_entry_t *entry, *old;
+
+		INIT(entry,
+			.dest = dest->clone(dest),
+			.prefix = prefix,
+			.nexthop = nexthop,
+			.candidate = candidate ? candidate->clone(candidate) : NULL,
+			.addr = addr ? addr->clone(addr) : NULL,
+		);
+		this->route_cache_lock->lock(this->route_cache_lock);
+		old = this->route_cache->put(this->route_cache, entry, entry);
+		this->route_cache_lock->unlock(this->route_cache_lock);
+		if (old)
+		{
+			route_cache_entry_destroy(old);
+		}
+	}
 	return addr;
 }
 
@@ -1923,6 +2064,9 @@ static status_t manage_ipaddr(private_kernel_netlink_net_t *this, int nlmsg_type
 		netlink_add_attribute(hdr, IFA_CACHEINFO, chunk_from_thing(cache),
 							  sizeof(request));
 	}
+	/* invalidate our lookup cache right away, the kernel event to do so might
+	 * arrive only later */
+	flush_route_cache(this);
 	return this->socket->send_ack(this->socket, hdr);
 }
 
@@ -2185,6 +2329,7 @@ static status_t manage_srcroute(private_kernel_netlink_net_t *this,
 		netlink_add_attribute(hdr, RTA_METRICS, chunk, sizeof(request));
 	}
 
+	flush_route_cache(this);
 	return this->socket->send_ack(this->socket, hdr);
 }
 
@@ -2477,6 +2622,10 @@ METHOD(kernel_net_t, destroy, void,
 	this->net_changes->destroy(this->net_changes);
 	this->net_changes_lock->destroy(this->net_changes_lock);
 
+	flush_route_cache(this);
+	DESTROY_IF(this->route_cache);
+	this->route_cache_lock->destroy(this->route_cache_lock);
+
 	addr_map_destroy(this->addrs);
 	addr_map_destroy(this->vips);
 
@@ -2528,6 +2677,7 @@ kernel_netlink_net_t *kernel_netlink_net_create()
 								 (hashtable_equals_t)addr_map_entry_equals, 16),
 		.routes_lock = mutex_create(MUTEX_TYPE_DEFAULT),
 		.net_changes_lock = mutex_create(MUTEX_TYPE_DEFAULT),
+		.route_cache_lock = mutex_create(MUTEX_TYPE_DEFAULT),
 		.ifaces = linked_list_create(),
 		.lock = rwlock_create(RWLOCK_TYPE_DEFAULT),
 		.condvar = rwlock_condvar_create(),
@@ -2608,6 +2758,11 @@ kernel_netlink_net_t *kernel_netlink_net_create()
 
 		lib->watcher->add(lib->watcher, this->socket_events, WATCHER_READ,
 						  (watcher_cb_t)receive_events, this);
+
+		/* only cache route lookups if change events can invalidate them */
+		this->route_cache = hashtable_create(
+								(hashtable_hash_t)route_cache_entry_hash,
+								(hashtable_equals_t)route_cache_entry_equals, 16);
 	}
 
 	if (init_address_list(this) != SUCCESS)
@@ -113,6 +113,10 @@ typedef struct {
 	array_t *hdrs;
 	/** All response messages received? */
 	bool complete;
+	/** Callback for asynchronous requests, NULL if a thread is waiting */
+	netlink_ack_cb_t cb;
+	/** Data to pass to the callback */
+	void *data;
 } entry_t;
 
 /**
@@ -126,9 +130,10 @@ static void destroy_entry(entry_t *entry)
 }
 
 /**
- * Write a Netlink message to socket
+ * Write one or multiple concatenated Netlink messages to socket
  */
-static bool write_msg(private_netlink_socket_t *this, struct nlmsghdr *msg)
+static bool write_msg(private_netlink_socket_t *this, struct nlmsghdr *msg,
+					  size_t msg_len)
 {
 	struct sockaddr_nl addr = {
 		.nl_family = AF_NETLINK,
@@ -142,9 +147,9 @@ static bool write_msg(private_netlink_socket_t *this, struct nlmsghdr *msg)
 
 	while (TRUE)
 	{
-		len = sendto(this->socket, msg, msg->nlmsg_len, 0,
+		len = sendto(this->socket, msg, msg_len, 0,
 					 (struct sockaddr*)&addr, sizeof(addr));
-		if (len != msg->nlmsg_len)
+		if (len != msg_len)
 		{
 			if (errno == EINTR)
 			{
@@ -197,6 +202,43 @@ static ssize_t read_msg(private_netlink_socket_t *this,
 	return len;
 }
 
+/**
+ * Determine the overall result of a completed request entry, using the same
+ * semantics as send_ack()
+ */
+static status_t entry_ack_status(entry_t *entry)
+{
+	struct nlmsghdr *hdr;
+	int i;
+
+	for (i = 0; i < array_count(entry->hdrs); i++)
+	{
+		array_get(entry->hdrs, i, &hdr);
+		if (hdr->nlmsg_type == NLMSG_ERROR)
+		{
+			struct nlmsgerr *err = NLMSG_DATA(hdr);
+
+			if (!err->error)
+			{
+				return SUCCESS;
+			}
+			if (-err->error == EEXIST)
+			{
+				return ALREADY_DONE;
+			}
+			if (-err->error == ESRCH)
+			{
+				return NOT_FOUND;
+			}
+			DBG1(DBG_KNL, "received netlink error: %s (%d)",
+				 strerror(-err->error), -err->error);
+			return FAILED;
+		}
+	}
+	DBG1(DBG_KNL, "netlink request not acknowledged");
+	return FAILED;
+}
+
 /**
  * Queue received response message
  */
@@ -218,7 +260,15 @@ static bool queue(private_netlink_socket_t *this, struct nlmsghdr *buf)
 		if (hdr->nlmsg_type == NLMSG_DONE || !(hdr->nlmsg_flags & NLM_F_MULTI))
 		{
 			entry->complete = TRUE;
-			entry->condvar->signal(entry->condvar);
+			if (entry->cb)
+			{	/* nobody is waiting for asynchronous requests, dispatch the
+				 * callback below, outside of the mutex */
+				this->entries->remove(this->entries, (void*)seq);
+			}
+			else
+			{
+				entry->condvar->signal(entry->condvar);
+			}
 		}
 	}
 	else
@@ -227,6 +277,12 @@ static bool queue(private_netlink_socket_t *this, struct nlmsghdr *buf)
 	}
 	this->mutex->unlock(this->mutex);
 
+	if (entry && entry->complete && entry->cb)
+	{
+		entry->cb(entry->data, entry_ack_status(entry));
+		destroy_entry(entry);
+	}
+
 	return entry != NULL;
 }
 
@@ -272,6 +328,42 @@ CALLBACK(watch, bool,
 	return TRUE;
 }
 
+/**
+ * Wait for a request entry to complete, with mutex held. Returns FALSE on
+ * timeout.
+ */
+static bool wait_complete(private_netlink_socket_t *this, entry_t *entry)
+{
+	while (!entry->complete)
+	{
+		if (this->parallel &&
+			lib->watcher->get_state(lib->watcher) == WATCHER_RUNNING)
+		{
+			if (this->timeout)
+			{
+				if (entry->condvar->timed_wait(entry->condvar, this->mutex,
+											   this->timeout))
+				{
+					break;
+				}
+			}
+			else
+			{
+				entry->condvar->wait(entry->condvar, this->mutex);
+			}
+		}
+		else
+		{	/* During (de-)initialization, no watcher thread is active.
+			 * collect responses ourselves. */
+			if (read_and_queue(this, TRUE))
+			{
+				break;
+			}
+		}
+	}
+	return entry->complete;
+}
+
 /**
  * Send a netlink request, try once
  */
@@ -292,7 +384,7 @@ static status_t send_once(private_netlink_socket_t *this, struct nlmsghdr *in,
 	}
 
 	this->mutex->lock(this->mutex);
-	if (!write_msg(this, in))
+	if (!write_msg(this, in, in->nlmsg_len))
 	{
 		this->mutex->unlock(this->mutex);
 		return FAILED;
@@ -304,33 +396,7 @@ static status_t send_once(private_netlink_socket_t *this, struct nlmsghdr *in,
 	);
 	this->entries->put(this->entries, (void*)seq, entry);
 
-	while (!entry->complete)
-	{
-		if (this->parallel &&
-			lib->watcher->get_state(lib->watcher) == WATCHER_RUNNING)
-		{
-			if (this->timeout)
-			{
-				if (entry->condvar->timed_wait(entry->condvar, this->mutex,
-											   this->timeout))
-				{
-					break;
-				}
-			}
-			else
-			{
-				entry->condvar->wait(entry->condvar, this->mutex);
-			}
-		}
-		else
-		{	/* During (de-)initialization, no watcher thread is active.
-			 * collect responses ourselves. */
-			if (read_and_queue(this, TRUE))
-			{
-				break;
-			}
-		}
-	}
+	wait_complete(this, entry);
 	this->entries->remove(this->entries, (void*)seq);
 
 	this->mutex->unlock(this->mutex);
@@ -529,9 +595,162 @@ METHOD(netlink_socket_t, netlink_send_ack, status_t,
 	return FAILED;
 }
 
+METHOD(netlink_socket_t, netlink_send_ack_async, status_t,
+	private_netlink_socket_t *this, struct nlmsghdr *in, netlink_ack_cb_t cb,
+	void *data)
+{
+	entry_t *entry;
+	uintptr_t seq;
+
+	if (!this->parallel ||
+		lib->watcher->get_state(lib->watcher) != WATCHER_RUNNING)
+	{	/* nobody dispatches responses asynchronously, complete inline */
+		cb(data, netlink_send_ack(this, in));
+		return SUCCESS;
+	}
+
+	seq = ref_get(&this->seq);
+	in->nlmsg_seq = seq;
+	in->nlmsg_pid = getpid();
+
+	if (this->names)
+	{
+		DBG3(DBG_KNL, "sending %N %u: %b", this->names, in->nlmsg_type,
+			 (u_int)seq, in, in->nlmsg_len);
+	}
+
+	INIT(entry,
+		.condvar = condvar_create(CONDVAR_TYPE_DEFAULT),
+		.hdrs = array_create(0, 0),
+		.cb = cb,
+		.data = data,
+	);
+
+	this->mutex->lock(this->mutex);
+	if (!write_msg(this, in, in->nlmsg_len))
+	{
+		this->mutex->unlock(this->mutex);
+		destroy_entry(entry);
+		cb(data, FAILED);
+		return FAILED;
+	}
+	this->entries->put(this->entries, (void*)seq, entry);
+	this->mutex->unlock(this->mutex);
+
+	return SUCCESS;
+}
+
+/**
+ * Check if all responses to a batched request signal success, counting
+ * EEXIST/ESRCH as success like send_ack() does
+ */
+static bool batch_entry_acked(private_netlink_socket_t *this, entry_t *entry)
+{
+	struct nlmsghdr *hdr;
+	bool acked = FALSE;
+
+	while (array_remove(entry->hdrs, ARRAY_HEAD, &hdr))
+	{
+		if (hdr->nlmsg_type == NLMSG_ERROR)
+		{
+			struct nlmsgerr *err = NLMSG_DATA(hdr);
+
+			if (err->error && -err->error != EEXIST && -err->error != ESRCH)
+			{
+				DBG1(DBG_KNL, "received netlink error: %s (%d)",
+					 strerror(-err->error), -err->error);
+				free(hdr);
+				return FALSE;
+			}
+			acked = TRUE;
+		}
+		free(hdr);
+	}
+	return acked;
+}
+
+METHOD(netlink_socket_t, netlink_send_batch, status_t,
+	private_netlink_socket_t *this, struct nlmsghdr **in, u_int count)
+{
+	entry_t **entries;
+	uintptr_t seq;
+	char *buf, *pos;
+	size_t total = 0;
+	status_t status = SUCCESS;
+	u_int i;
+
+	if (!count)
+	{
+		return SUCCESS;
+	}
+	for (i = 0; i < count; i++)
+	{
+		total += NLMSG_ALIGN(in[i]->nlmsg_len);
+	}
+	pos = buf = malloc(total);
+	entries = malloc(sizeof(entry_t*) * count);
+
+	this->mutex->lock(this->mutex);
+	for (i = 0; i < count; i++)
+	{
+		seq = ref_get(&this->seq);
+		in[i]->nlmsg_seq = seq;
+		in[i]->nlmsg_pid = getpid();
+
+		if (this->names)
+		{
+			DBG3(DBG_KNL, "sending %N %u: %b", this->names, in[i]->nlmsg_type,
+				 (u_int)seq, in[i], in[i]->nlmsg_len);
+		}
+		memset(pos, 0, NLMSG_ALIGN(in[i]->nlmsg_len));
+		memcpy(pos, in[i], in[i]->nlmsg_len);
+		pos += NLMSG_ALIGN(in[i]->nlmsg_len);
+
+		INIT(entries[i],
+			.condvar = condvar_create(CONDVAR_TYPE_DEFAULT),
+			.hdrs = array_create(0, 0),
+		);
+		this->entries->put(this->entries, (void*)seq, entries[i]);
+	}
+
+	if (!write_msg(this, (struct nlmsghdr*)buf, total))
+	{
+		status = FAILED;
+	}
+	for (i = 0; i < count; i++)
+	{
+		if (status == SUCCESS && !wait_complete(this, entries[i]))
+		{
+			DBG1(DBG_KNL, "batched netlink request timed out");
+			status = OUT_OF_RES;
+		}
+		this->entries->remove(this->entries,
+							  (void*)(uintptr_t)in[i]->nlmsg_seq);
+	}
+	this->mutex->unlock(this->mutex);
+
+	memwipe(buf, total);
+	free(buf);
+
+	for (i = 0; i < count; i++)
+	{
+		if (status == SUCCESS && !batch_entry_acked(this, entries[i]))
+		{
+			status = FAILED;
+		}
+		destroy_entry(entries[i]);
+	}
+	free(entries);
+	return status;
+}
+
 METHOD(netlink_socket_t, destroy, void,
 	private_netlink_socket_t *this)
 {
+	enumerator_t *enumerator;
+	entry_t *entry;
+	void *seq;
+
 	if (this->socket != -1)
 	{
 		if (this->parallel)
@@ -540,16 +759,28 @@ METHOD(netlink_socket_t, destroy, void,
 		}
 		close(this->socket);
 	}
+	/* fail asynchronous requests still pending */
+	enumerator = this->entries->create_enumerator(this->entries);
+	while (enumerator->enumerate(enumerator, &seq, &entry))
+	{
+		if (entry->cb)
+		{
+			this->entries->remove_at(this->entries, enumerator);
+			entry->cb(entry->data, FAILED);
+			destroy_entry(entry);
+		}
+	}
+	enumerator->destroy(enumerator);
 	this->entries->destroy(this->entries);
 	this->mutex->destroy(this->mutex);
 	free(this);
 }
 
 /**
- * Described in header.
+ * Create a single netlink socket
  */
-netlink_socket_t *netlink_socket_create(int protocol, enum_name_t *names,
-										bool parallel)
+static netlink_socket_t *netlink_socket_create_single(int protocol,
+											enum_name_t *names, bool parallel)
 {
 	private_netlink_socket_t *this;
 	struct sockaddr_nl addr = {
@@ -560,6 +791,8 @@ netlink_socket_t *netlink_socket_create(int protocol, enum_name_t *names,
 		.public = {
 			.send = _netlink_send,
 			.send_ack = _netlink_send_ack,
+			.send_ack_async = _netlink_send_ack_async,
+			.send_batch = _netlink_send_batch,
 			.destroy = _destroy,
 		},
 		.seq = 200,
@@ -598,6 +831,221 @@ netlink_socket_t *netlink_socket_create(int protocol, enum_name_t *names,
 	return &this->public;
 }
 
+typedef struct private_netlink_pool_t private_netlink_pool_t;
+
+/**
+ * Pool of netlink sockets, assigned to requests round-robin
+ */
+struct private_netlink_pool_t {
+
+	/**
+	 * Public interface, delegating to pooled sockets
+	 */
+	netlink_socket_t public;
+
+	/**
+	 * Pooled sockets
+	 */
+	netlink_socket_t **socks;
+
+	/**
+	 * Number of pooled sockets
+	 */
+	int count;
+
+	/**
+	 * Round-robin counter to assign requests to sockets
+	 */
+	refcount_t next;
+};
+
+/**
+ * Pick the next socket from the pool
+ */
+static netlink_socket_t *pool_pick(private_netlink_pool_t *this)
+{
+	return this->socks[ref_get(&this->next) % this->count];
+}
+
+METHOD(netlink_socket_t, pool_send, status_t,
+	private_netlink_pool_t *this, struct nlmsghdr *in, struct nlmsghdr **out,
+	size_t *out_len)
+{
+	netlink_socket_t *sock = pool_pick(this);
+
+	return sock->send(sock, in, out, out_len);
+}
+
+METHOD(netlink_socket_t, pool_send_ack, status_t,
+	private_netlink_pool_t *this, struct nlmsghdr *in)
+{
+	netlink_socket_t *sock = pool_pick(this);
+
+	return sock->send_ack(sock, in);
+}
+
+METHOD(netlink_socket_t, pool_send_ack_async, status_t,
+	private_netlink_pool_t *this, struct nlmsghdr *in, netlink_ack_cb_t cb,
+	void *data)
+{
+	netlink_socket_t *sock = pool_pick(this);
+
+	return sock->send_ack_async(sock, in, cb, data);
+}
+
+METHOD(netlink_socket_t, pool_send_batch, status_t,
+	private_netlink_pool_t *this, struct nlmsghdr **in, u_int count)
+{
+	netlink_socket_t *sock = pool_pick(this);
+
+	return sock->send_batch(sock, in, count);
+}
+
+METHOD(netlink_socket_t, pool_destroy, void,
+	private_netlink_pool_t *this)
+{
+	int i;
+
+	for (i = 0; i < this->count; i++)
+	{
+		this->socks[i]->destroy(this->socks[i]);
+	}
+	free(this->socks);
+	free(this);
+}
+
+/**
+ * Create a pool of netlink sockets, keeping requests of concurrent workers
+ * from serializing on a single socket
+ */
+static netlink_socket_t *netlink_socket_create_pool(int protocol,
+								enum_name_t *names, bool parallel, int count)
+{
+	private_netlink_pool_t *this;
+	int i;
+
+	INIT(this,
+		.public = {
+			.send = _pool_send,
+			.send_ack = _pool_send_ack,
+			.send_ack_async = _pool_send_ack_async,
+			.send_batch = _pool_send_batch,
+			.destroy = _pool_destroy,
+		},
+		.socks = calloc(count, sizeof(netlink_socket_t*)),
+	);
+
+	for (i = 0; i < count; i++)
+	{
+		this->socks[i] = netlink_socket_create_single(protocol, names,
+													  parallel);
+		if (!this->socks[i])
+		{
+			pool_destroy(this);
+			return NULL;
+		}
+		this->count++;
+	}
+	return &this->public;
+}
+
+/**
+ * Described in header.
+ */
+netlink_socket_t *netlink_socket_create(int protocol, enum_name_t *names,
+										bool parallel)
+{
+	int count;
+
+	count = lib->settings->get_int(lib->settings,
+						"%s.plugins.kernel-netlink.sockets", 1, lib->ns);
+	if (count > 1)
+	{
+		return netlink_socket_create_pool(protocol, names, parallel, count);
+	}
+	return netlink_socket_create_single(protocol, names, parallel);
+}
+
+typedef struct private_netlink_batch_t private_netlink_batch_t;
+
+/**
+ * Private data of netlink_batch_t
+ */
+struct private_netlink_batch_t {
+
+	/**
+	 * Public interface
+	 */
+	netlink_batch_t public;
+
+	/**
+	 * Socket the batch is sent on
+	 */
+	netlink_socket_t *socket;
+
+	/**
+	 * Queued messages, as struct nlmsghdr*
+	 */
+	array_t *msgs;
+};
+
+METHOD(netlink_batch_t, batch_add, void,
+	private_netlink_batch_t *this, struct nlmsghdr *hdr)
+{
+	struct nlmsghdr *copy;
+
+	copy = malloc(hdr->nlmsg_len);
+	memcpy(copy, hdr, hdr->nlmsg_len);
+	array_insert(this->msgs, ARRAY_TAIL, copy);
+}
+
+METHOD(netlink_batch_t, batch_commit, status_t,
+	private_netlink_batch_t *this)
+{
+	struct nlmsghdr **ptrs;
+	status_t status = SUCCESS;
+	u_int count, i = 0;
+
+	count = array_count(this->msgs);
+	if (count)
+	{
+		ptrs = malloc(sizeof(struct nlmsghdr*) * count);
+		while (array_remove(this->msgs, ARRAY_HEAD, &ptrs[i]))
+		{
+			i++;
+		}
+		status = this->socket->send_batch(this->socket, ptrs, count);
+		for (i = 0; i < count; i++)
+		{	/* messages may carry keying material */
+			memwipe(ptrs[i], ptrs[i]->nlmsg_len);
+			free(ptrs[i]);
+		}
+		free(ptrs);
+	}
+	array_destroy(this->msgs);
+	free(this);
+	return status;
+}
+
+/**
+ * Described in header.
+ */
+netlink_batch_t *netlink_batch_create(netlink_socket_t *socket)
+{
+	private_netlink_batch_t *this;
+
+	INIT(this,
+		.public = {
+			.add = _batch_add,
+			.commit = _batch_commit,
+		},
+		.socket = socket,
+		.msgs = array_create(0, 0),
+	);
+
+	return &this->public;
+}
+
 /**
  * Described in header.
  */
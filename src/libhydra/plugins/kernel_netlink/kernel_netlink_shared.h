@@ -32,6 +32,15 @@ typedef union {
 } netlink_buf_t __attribute__((aligned(RTA_ALIGNTO)));
 
 typedef struct netlink_socket_t netlink_socket_t;
+typedef struct netlink_batch_t netlink_batch_t;
+
+/**
+ * Callback invoked when an asynchronously sent netlink message completes.
+ *
+ * @param data		data supplied to send_ack_async()
+ * @param status	result of the request, as returned by send_ack()
+ */
+typedef void (*netlink_ack_cb_t)(void *data, status_t status);
 
 /**
  * Wrapper around a netlink socket.
@@ -55,12 +64,73 @@ struct netlink_socket_t {
 	 */
 	status_t (*send_ack)(netlink_socket_t *this, struct nlmsghdr *in);
 
+	/**
+	 * Send a netlink message without waiting for the acknowledge.
+	 *
+	 * The callback is invoked exactly once with the result of the request,
+	 * from the thread dispatching responses. If the socket does not use
+	 * parallel queries, or no watcher thread is active, the request
+	 * completes synchronously and the callback is invoked before this call
+	 * returns. Asynchronous requests are not retransmitted on timeout.
+	 *
+	 * @param	in		netlink message to send
+	 * @param	cb		callback to invoke on completion
+	 * @param	data	data to pass to the callback
+	 * @return			SUCCESS if the request was submitted
+	 */
+	status_t (*send_ack_async)(netlink_socket_t *this, struct nlmsghdr *in,
+							   netlink_ack_cb_t cb, void *data);
+
+	/**
+	 * Send multiple netlink messages as one submission, then wait for all
+	 * acknowledges.
+	 *
+	 * All messages are written with a single syscall and acknowledged
+	 * collectively, reducing the per-message round trip to the kernel.
+	 * Existing entries (EEXIST) and missing entries (ESRCH) are not
+	 * considered errors, same as with send_ack(). Requests are not
+	 * retransmitted on timeout.
+	 *
+	 * @param	in		array of netlink messages to send
+	 * @param	count	number of messages in in
+	 * @return			SUCCESS if all messages were acknowledged
+	 */
+	status_t (*send_batch)(netlink_socket_t *this, struct nlmsghdr **in,
+						   u_int count);
+
 	/**
 	 * Destroy the socket.
 	 */
 	void (*destroy)(netlink_socket_t *this);
 };
 
+/**
+ * Collector coalescing multiple netlink requests into a single submission.
+ */
+struct netlink_batch_t {
+
+	/**
+	 * Append a copy of a netlink message to the batch.
+	 *
+	 * @param	hdr		netlink message to queue
+	 */
+	void (*add)(netlink_batch_t *this, struct nlmsghdr *hdr);
+
+	/**
+	 * Send all queued messages using send_batch() and destroy the batch.
+	 *
+	 * @return			SUCCESS if all messages were acknowledged
+	 */
+	status_t (*commit)(netlink_batch_t *this);
+};
+
+/**
+ * Create a netlink_batch_t collecting messages for the given socket.
+ *
+ * @param socket	netlink socket to send the batch on
+ */
+netlink_batch_t *netlink_batch_create(netlink_socket_t *socket);
+
 /**
  * Create a netlink_socket_t object.
  *
@@ -15,6 +15,8 @@
 
 #include <test_suite.h>
 
+#include <unistd.h>
+
 #include <threading/thread.h>
 
 #include "../kernel_netlink_shared.h"
@@ -211,6 +213,96 @@ START_TEST(test_stress_dump)
 }
 END_TEST
 
+/**
+ * Build a route delete request for a (hopefully) non-existing host route
+ */
+static void build_delroute(netlink_buf_t *request, u_char host)
+{
+	struct rtmsg *msg;
+	char dst[] = {
+		127,0,0,host
+	};
+
+	memset(request, 0, sizeof(*request));
+	request->hdr.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtmsg));
+	request->hdr.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK;
+	request->hdr.nlmsg_type = RTM_DELROUTE;
+	msg = NLMSG_DATA(&request->hdr);
+	msg->rtm_family = AF_INET;
+	msg->rtm_dst_len = 32;
+	msg->rtm_table = RT_TABLE_MAIN;
+	netlink_add_attribute(&request->hdr, RTA_DST,
+						  chunk_from_thing(dst), sizeof(*request));
+}
+
+START_TEST(test_batch)
+{
+	netlink_socket_t *s;
+	netlink_batch_t *batch;
+	netlink_buf_t r1, r2;
+	struct nlmsghdr *msgs[2];
+
+	s = netlink_socket_create(NETLINK_ROUTE, NULL, _i != 0);
+
+	/* missing entries are not errors, as with send_ack() */
+	build_delroute(&r1, 8);
+	build_delroute(&r2, 9);
+	msgs[0] = &r1.hdr;
+	msgs[1] = &r2.hdr;
+	ck_assert(s->send_batch(s, msgs, 2) == SUCCESS);
+
+	batch = netlink_batch_create(s);
+	build_delroute(&r1, 10);
+	batch->add(batch, &r1.hdr);
+	build_delroute(&r2, 11);
+	batch->add(batch, &r2.hdr);
+	ck_assert(batch->commit(batch) == SUCCESS);
+
+	batch = netlink_batch_create(s);
+	ck_assert(batch->commit(batch) == SUCCESS);
+
+	s->destroy(s);
+}
+END_TEST
+
+/**
+ * Result delivered to the async completion callback
+ */
+static refcount_t async_calls;
+static status_t async_status;
+
+/**
+ * Async completion callback
+ */
+static void async_cb(void *data, status_t status)
+{
+	async_status = status;
+	ref_get(&async_calls);
+}
+
+START_TEST(test_async)
+{
+	netlink_socket_t *s;
+	netlink_buf_t request;
+	int i;
+
+	s = netlink_socket_create(NETLINK_ROUTE, NULL, _i != 0);
+
+	async_calls = 0;
+	build_delroute(&request, 12);
+	ck_assert(s->send_ack_async(s, &request.hdr, async_cb, NULL) == SUCCESS);
+	for (i = 0; i < 100 && !async_calls; i++)
+	{	/* without a watcher thread the request completes inline, otherwise
+		 * wait for the callback to be dispatched */
+		usleep(10000);
+	}
+	ck_assert_int_eq(async_calls, 1);
+	ck_assert(async_status == NOT_FOUND);
+
+	s->destroy(s);
+}
+END_TEST
+
 START_TEST(test_retransmit_success)
 {
 	netlink_socket_t *s;
@@ -293,6 +385,14 @@ Suite *socket_suite_create()
 	tcase_add_loop_test(tc, test_stress_dump, 0, 2);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("batch");
+	tcase_add_loop_test(tc, test_batch, 0, 2);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("async");
+	tcase_add_loop_test(tc, test_async, 0, 2);
+	suite_add_tcase(s, tc);
+
 	tc = tcase_create("retransmit");
 	tcase_add_loop_test(tc, test_retransmit_success, 0, 2);
 	tcase_add_loop_test(tc, test_retransmit_fail, 0, 2);
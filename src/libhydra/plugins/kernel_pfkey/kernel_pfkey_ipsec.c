@@ -81,9 +81,11 @@
 #include <hydra.h>
 #include <utils/debug.h>
 #include <networking/host.h>
+#include <collections/array.h>
 #include <collections/linked_list.h>
 #include <collections/hashtable.h>
 #include <threading/mutex.h>
+#include <threading/thread_value.h>
 
 /** non linux specific */
 #ifndef IPPROTO_COMP
@@ -194,9 +196,9 @@ struct private_kernel_pfkey_ipsec_t
 	mutex_t *mutex;
 
 	/**
-	 * List of installed policies (policy_entry_t)
+	 * Hash table of installed policies (policy_entry_t)
 	 */
-	linked_list_t *policies;
+	hashtable_t *policies;
 
 	/**
 	 * List of exclude routes (exclude_route_t)
@@ -232,6 +234,17 @@ struct private_kernel_pfkey_ipsec_t
 	 * sequence number for messages sent to the kernel
 	 */
 	int seq;
+
+	/**
+	 * Thread specific batch collecting PF_KEY messages, as array_t of
+	 * struct sadb_msg*
+	 */
+	thread_value_t *batch;
+
+	/**
+	 * Number of requests to keep in flight when pipelining
+	 */
+	u_int pipeline_window;
 };
 
 typedef struct exclude_route_t exclude_route_t;
@@ -559,12 +572,43 @@ static inline bool policy_entry_equals(policy_entry_t *current,
 }
 
 /**
- * compare the given kernel index with that of a policy
+ * hash function for policy_entry_t objects
  */
-static inline bool policy_entry_match_byindex(policy_entry_t *current,
-											  u_int32_t *index)
+static u_int policy_hash(policy_entry_t *key)
 {
-	return current->index == *index;
+	chunk_t chunk;
+	u_int hash;
+
+	hash = chunk_hash(chunk_from_thing(key->direction));
+	chunk = key->src.net->get_address(key->src.net);
+	hash = chunk_hash_inc(chunk, hash);
+	chunk = key->dst.net->get_address(key->dst.net);
+	hash = chunk_hash_inc(chunk, hash);
+	hash = chunk_hash_inc(chunk_from_thing(key->src.mask), hash);
+	hash = chunk_hash_inc(chunk_from_thing(key->dst.mask), hash);
+	return chunk_hash_inc(chunk_from_thing(key->src.proto), hash);
+}
+
+/**
+ * Find the policy with the given kernel index
+ */
+static policy_entry_t *find_policy_byindex(private_kernel_pfkey_ipsec_t *this,
+										   u_int32_t index)
+{
+	enumerator_t *enumerator;
+	policy_entry_t *current, *found = NULL;
+
+	enumerator = this->policies->create_enumerator(this->policies);
+	while (enumerator->enumerate(enumerator, NULL, (void**)&current))
+	{
+		if (current->index == index)
+		{
+			found = current;
+			break;
+		}
+	}
+	enumerator->destroy(enumerator);
+	return found;
 }
 
 /**
@@ -1235,6 +1279,147 @@ static status_t pfkey_send(private_kernel_pfkey_ipsec_t *this,
 	return pfkey_send_socket(this, this->socket, in, out, out_len);
 }
 
+/**
+ * Send a series of PF_KEY messages pipelined, keeping a window of requests
+ * in flight instead of doing a full synchronous round trip for each.
+ *
+ * EEXIST and ESRCH/ENOENT responses are logged but tolerated, like multiple
+ * sends of the same message would be.
+ */
+static status_t pfkey_send_pipeline(private_kernel_pfkey_ipsec_t *this,
+									struct sadb_msg **msgs, int count)
+{
+	unsigned char buf[PFKEY_BUFFER_SIZE];
+	struct sadb_msg *msg;
+	u_int32_t base_seq;
+	int sent = 0, acked = 0, in_len, len;
+	status_t status = SUCCESS;
+
+	if (!count)
+	{
+		return SUCCESS;
+	}
+	this->mutex_pfkey->lock(this->mutex_pfkey);
+	base_seq = this->seq;
+
+	while (acked < count)
+	{
+		while (sent < count && sent - acked < this->pipeline_window)
+		{
+			msgs[sent]->sadb_msg_seq = ++this->seq;
+			msgs[sent]->sadb_msg_pid = getpid();
+			in_len = PFKEY_USER_LEN(msgs[sent]->sadb_msg_len);
+			while (TRUE)
+			{
+				len = send(this->socket, msgs[sent], in_len, 0);
+				if (len != in_len)
+				{
+					if (errno == EINTR)
+					{	/* interrupted, try again */
+						continue;
+					}
+					this->mutex_pfkey->unlock(this->mutex_pfkey);
+					DBG1(DBG_KNL, "error sending to PF_KEY socket: %s",
+								   strerror(errno));
+					return FAILED;
+				}
+				break;
+			}
+			sent++;
+		}
+
+		msg = (struct sadb_msg*)buf;
+		len = recv(this->socket, buf, sizeof(buf), 0);
+		if (len < 0)
+		{
+			if (errno == EINTR)
+			{	/* interrupted, try again */
+				continue;
+			}
+			this->mutex_pfkey->unlock(this->mutex_pfkey);
+			DBG1(DBG_KNL, "error reading from PF_KEY socket: %s",
+						   strerror(errno));
+			return FAILED;
+		}
+		if (len < sizeof(struct sadb_msg) ||
+			msg->sadb_msg_len < PFKEY_LEN(sizeof(struct sadb_msg)))
+		{
+			this->mutex_pfkey->unlock(this->mutex_pfkey);
+			DBG1(DBG_KNL, "received corrupted PF_KEY message");
+			return FAILED;
+		}
+		if (msg->sadb_msg_pid != getpid())
+		{	/* not intended for us */
+			continue;
+		}
+		if (msg->sadb_msg_seq <= base_seq + acked ||
+			msg->sadb_msg_seq > base_seq + sent)
+		{	/* not a response to one of our outstanding requests */
+			continue;
+		}
+		/* the kernel processes the requests of a socket in order, so this
+		 * implicitly acknowledges any earlier outstanding request, too */
+		acked = msg->sadb_msg_seq - base_seq;
+		switch (msg->sadb_msg_errno)
+		{
+			case 0:
+				break;
+			case EEXIST:
+				DBG1(DBG_KNL, "pipelined PF_KEY request found an existing "
+					 "entry");
+				break;
+			case ESRCH:
+			case ENOENT:
+				DBG1(DBG_KNL, "pipelined PF_KEY request did not find its "
+					 "entry");
+				break;
+			default:
+				DBG1(DBG_KNL, "pipelined PF_KEY request failed: %s (%d)",
+					 strerror(msg->sadb_msg_errno), msg->sadb_msg_errno);
+				status = FAILED;
+				break;
+		}
+	}
+	this->mutex_pfkey->unlock(this->mutex_pfkey);
+	return status;
+}
+
+/**
+ * Send a message and wait for the response, or queue it to the batch, if the
+ * calling thread has one active.  Only usable for operations that do not
+ * evaluate the response beyond its error code.
+ */
+static status_t send_or_queue(private_kernel_pfkey_ipsec_t *this,
+							  struct sadb_msg *in)
+{
+	struct sadb_msg *out, *copy;
+	array_t *batch;
+	size_t len;
+
+	batch = this->batch->get(this->batch);
+	if (batch)
+	{
+		len = PFKEY_USER_LEN(in->sadb_msg_len);
+		copy = malloc(len);
+		memcpy(copy, in, len);
+		array_insert(batch, ARRAY_TAIL, copy);
+		return SUCCESS;
+	}
+	if (pfkey_send(this, in, &out, &len) != SUCCESS)
+	{
+		return FAILED;
+	}
+	if (out->sadb_msg_errno)
+	{
+		DBG1(DBG_KNL, "PF_KEY operation failed: %s (%d)",
+					   strerror(out->sadb_msg_errno), out->sadb_msg_errno);
+		free(out);
+		return FAILED;
+	}
+	free(out);
+	return SUCCESS;
+}
+
 /**
  * Process a SADB_ACQUIRE message from the kernel
  */
@@ -1267,9 +1452,8 @@ static void process_acquire(private_kernel_pfkey_ipsec_t *this,
 
 	index = response.x_policy->sadb_x_policy_id;
 	this->mutex->lock(this->mutex);
-	if (this->policies->find_first(this->policies,
-								(linked_list_match_t)policy_entry_match_byindex,
-								(void**)&policy, &index) == SUCCESS &&
+	policy = find_policy_byindex(this, index);
+	if (policy &&
 		policy->used_by->get_first(policy->used_by, (void**)&sa) == SUCCESS)
 	{
 		reqid = sa->sa->cfg.reqid;
@@ -1615,11 +1799,12 @@ METHOD(kernel_ipsec_t, add_sa, status_t,
 	lifetime_cfg_t *lifetime, u_int16_t enc_alg, chunk_t enc_key,
 	u_int16_t int_alg, chunk_t int_key, ipsec_mode_t mode,
 	u_int16_t ipcomp, u_int16_t cpi, u_int32_t replay_window,
-	bool initiator, bool encap, bool esn, bool inbound, bool update,
+	bool initiator, bool encap, bool esn, bool hw_offload, bool inbound,
+	bool update,
 	linked_list_t *src_ts, linked_list_t *dst_ts)
 {
 	unsigned char request[PFKEY_BUFFER_SIZE];
-	struct sadb_msg *msg, *out;
+	struct sadb_msg *msg;
 	struct sadb_sa *sa;
 	struct sadb_x_sa2 *sa2;
 	struct sadb_lifetime *lft;
@@ -1633,8 +1818,8 @@ METHOD(kernel_ipsec_t, add_sa, status_t,
 		lifetime_cfg_t lft = {{0,0,0},{0,0,0},{0,0,0}};
 		add_sa(this, src, dst, htonl(ntohs(cpi)), IPPROTO_COMP, reqid, mark,
 			   tfc, &lft, ENCR_UNDEFINED, chunk_empty, AUTH_UNDEFINED,
-			   chunk_empty, mode, ipcomp, 0, 0, FALSE, FALSE, FALSE, inbound,
-			   update, NULL, NULL);
+			   chunk_empty, mode, ipcomp, 0, 0, FALSE, FALSE, FALSE, FALSE,
+			   inbound, update, NULL, NULL);
 		ipcomp = IPCOMP_NONE;
 		/* use transport mode ESP SA, IPComp uses tunnel mode */
 		mode = MODE_TRANSPORT;
@@ -1780,20 +1965,11 @@ METHOD(kernel_ipsec_t, add_sa, status_t,
 	}
 #endif /*HAVE_NATT*/
 
-	if (pfkey_send(this, msg, &out, &len) != SUCCESS)
+	if (send_or_queue(this, msg) != SUCCESS)
 	{
 		DBG1(DBG_KNL, "unable to add SAD entry with SPI %.8x", ntohl(spi));
 		return FAILED;
 	}
-	else if (out->sadb_msg_errno)
-	{
-		DBG1(DBG_KNL, "unable to add SAD entry with SPI %.8x: %s (%d)",
-				ntohl(spi), strerror(out->sadb_msg_errno), out->sadb_msg_errno);
-		free(out);
-		return FAILED;
-	}
-
-	free(out);
 	return SUCCESS;
 }
 
@@ -2354,6 +2530,8 @@ static status_t add_policy_internal(private_kernel_pfkey_ipsec_t *this,
 	struct sadb_x_policy *pol;
 	struct sadb_x_ipsecrequest *req;
 	ipsec_sa_t *ipsec = mapping->sa;
+	policy_entry_t *current, *found = NULL;
+	enumerator_t *enumerator;
 	pfkey_msg_t response;
 	size_t len;
 	ipsec_mode_t proto_mode;
@@ -2464,10 +2642,21 @@ static status_t add_policy_internal(private_kernel_pfkey_ipsec_t *this,
 		return FAILED;
 	}
 
-	/* we try to find the policy again and update the kernel index */
+	/* we try to find the policy again and update the kernel index.  don't
+	 * dereference the policy pointer before making sure it is still
+	 * installed, it might have been removed while the mutex was released. */
 	this->mutex->lock(this->mutex);
-	if (this->policies->find_first(this->policies, NULL,
-								  (void**)&policy) != SUCCESS)
+	enumerator = this->policies->create_enumerator(this->policies);
+	while (enumerator->enumerate(enumerator, NULL, (void**)&current))
+	{
+		if (current == policy)
+		{
+			found = current;
+			break;
+		}
+	}
+	enumerator->destroy(enumerator);
+	if (!found)
 	{
 		DBG2(DBG_KNL, "unable to update index, the policy is already gone, "
 					  "ignoring");
@@ -2513,9 +2702,8 @@ METHOD(kernel_ipsec_t, add_policy, status_t,
 
 	/* find a matching policy */
 	this->mutex->lock(this->mutex);
-	if (this->policies->find_first(this->policies,
-								  (linked_list_match_t)policy_entry_equals,
-								  (void**)&found, policy) == SUCCESS)
+	found = this->policies->get(this->policies, policy);
+	if (found)
 	{	/* use existing policy */
 		DBG2(DBG_KNL, "policy %R === %R %N already exists, increasing "
 					  "refcount", src_ts, dst_ts, policy_dir_names, direction);
@@ -2524,7 +2712,7 @@ METHOD(kernel_ipsec_t, add_policy, status_t,
 	}
 	else
 	{	/* use the new one, if we have no such policy */
-		this->policies->insert_first(this->policies, policy);
+		this->policies->put(this->policies, policy, policy);
 		policy->used_by = linked_list_create();
 	}
 
@@ -2592,9 +2780,8 @@ METHOD(kernel_ipsec_t, query_policy, status_t,
 
 	/* find a matching policy */
 	this->mutex->lock(this->mutex);
-	if (this->policies->find_first(this->policies,
-								  (linked_list_match_t)policy_entry_equals,
-								  (void**)&found, policy) != SUCCESS)
+	found = this->policies->get(this->policies, policy);
+	if (!found)
 	{
 		DBG1(DBG_KNL, "querying policy %R === %R %N failed, not found", src_ts,
 					   dst_ts, policy_dir_names, direction);
@@ -2700,9 +2887,8 @@ METHOD(kernel_ipsec_t, del_policy, status_t,
 
 	/* find a matching policy */
 	this->mutex->lock(this->mutex);
-	if (this->policies->find_first(this->policies,
-								  (linked_list_match_t)policy_entry_equals,
-								  (void**)&found, policy) != SUCCESS)
+	found = this->policies->get(this->policies, policy);
+	if (!found)
 	{
 		DBG1(DBG_KNL, "deleting policy %R === %R %N failed, not found", src_ts,
 					   dst_ts, policy_dir_names, direction);
@@ -2796,7 +2982,7 @@ METHOD(kernel_ipsec_t, del_policy, status_t,
 		remove_exclude_route(this, route);
 	}
 
-	this->policies->remove(this->policies, found, NULL);
+	this->policies->remove(this->policies, found);
 	policy_sa_destroy(mapping, &direction, this);
 	policy_entry_destroy(policy, this);
 	this->mutex->unlock(this->mutex);
@@ -2958,9 +3144,54 @@ METHOD(kernel_ipsec_t, enable_udp_decap, bool,
 	return TRUE;
 }
 
+METHOD(kernel_pfkey_ipsec_t, begin_batch, void,
+	private_kernel_pfkey_ipsec_t *this)
+{
+	if (!this->batch->get(this->batch))
+	{
+		this->batch->set(this->batch, array_create(0, 0));
+	}
+}
+
+METHOD(kernel_pfkey_ipsec_t, commit_batch, status_t,
+	private_kernel_pfkey_ipsec_t *this)
+{
+	struct sadb_msg **msgs, *msg;
+	array_t *batch;
+	int i, count;
+	status_t status = SUCCESS;
+
+	batch = this->batch->get(this->batch);
+	if (!batch)
+	{
+		return SUCCESS;
+	}
+	this->batch->set(this->batch, NULL);
+	count = array_count(batch);
+	if (count)
+	{
+		msgs = alloca(count * sizeof(struct sadb_msg*));
+		for (i = 0; i < count; i++)
+		{
+			array_get(batch, i, &msgs[i]);
+		}
+		status = pfkey_send_pipeline(this, msgs, count);
+	}
+	while (array_remove(batch, ARRAY_HEAD, &msg))
+	{	/* messages may contain keying material */
+		memwipe(msg, PFKEY_USER_LEN(msg->sadb_msg_len));
+		free(msg);
+	}
+	array_destroy(batch);
+	return status;
+}
+
 METHOD(kernel_ipsec_t, destroy, void,
 	private_kernel_pfkey_ipsec_t *this)
 {
+	enumerator_t *enumerator;
+	policy_entry_t *policy;
+
 	if (this->socket > 0)
 	{
 		close(this->socket);
@@ -2970,10 +3201,14 @@ METHOD(kernel_ipsec_t, destroy, void,
 		lib->watcher->remove(lib->watcher, this->socket_events);
 		close(this->socket_events);
 	}
-	this->policies->invoke_function(this->policies,
-								   (linked_list_invoke_t)policy_entry_destroy,
-									this);
+	enumerator = this->policies->create_enumerator(this->policies);
+	while (enumerator->enumerate(enumerator, NULL, (void**)&policy))
+	{
+		policy_entry_destroy(policy, this);
+	}
+	enumerator->destroy(enumerator);
 	this->policies->destroy(this->policies);
+	this->batch->destroy(this->batch);
 	this->excludes->destroy(this->excludes);
 	this->sas->destroy(this->sas);
 	this->mutex->destroy(this->mutex);
@@ -3008,8 +3243,11 @@ kernel_pfkey_ipsec_t *kernel_pfkey_ipsec_create()
 				.enable_udp_decap = _enable_udp_decap,
 				.destroy = _destroy,
 			},
+			.begin_batch = _begin_batch,
+			.commit_batch = _commit_batch,
 		},
-		.policies = linked_list_create(),
+		.policies = hashtable_create((hashtable_hash_t)policy_hash,
+									 (hashtable_equals_t)policy_entry_equals, 32),
 		.excludes = linked_list_create(),
 		.sas = hashtable_create((hashtable_hash_t)ipsec_sa_hash,
 								(hashtable_equals_t)ipsec_sa_equals, 32),
@@ -3018,6 +3256,10 @@ kernel_pfkey_ipsec_t *kernel_pfkey_ipsec_create()
 		.install_routes = lib->settings->get_bool(lib->settings,
 												  "%s.install_routes", TRUE,
 												  lib->ns),
+		.batch = thread_value_create(NULL),
+		.pipeline_window = lib->settings->get_int(lib->settings,
+							"%s.plugins.kernel-pfkey.pipeline_window", 8,
+							lib->ns),
 	);
 
 	if (streq(lib->ns, "starter"))
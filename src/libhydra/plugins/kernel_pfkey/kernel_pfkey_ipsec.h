@@ -34,6 +34,23 @@ struct kernel_pfkey_ipsec_t {
 	 * Implements kernel_ipsec_t interface
 	 */
 	kernel_ipsec_t interface;
+
+	/**
+	 * Start batching SA installations on the calling thread.
+	 *
+	 * Until commit_batch() is called by the same thread, add_sa() queues
+	 * its PF_KEY messages instead of sending them, returning optimistic
+	 * success.  Bulk installs, as during a failover, are then submitted
+	 * pipelined instead of one synchronous round trip each.
+	 */
+	void (*begin_batch)(kernel_pfkey_ipsec_t *this);
+
+	/**
+	 * Send all PF_KEY messages batched by the calling thread.
+	 *
+	 * @return		SUCCESS if all queued operations were acknowledged
+	 */
+	status_t (*commit_batch)(kernel_pfkey_ipsec_t *this);
 };
 
 /**
@@ -17,12 +17,24 @@
 #include "pts_file_meas.h"
 
 #include <collections/linked_list.h>
+#include <threading/thread.h>
+#include <threading/mutex.h>
 #include <utils/debug.h>
 
 #include <sys/stat.h>
 #include <libgen.h>
 #include <errno.h>
 
+/**
+ * Maximum number of concurrent file measurement threads
+ */
+#define MAX_MEAS_THREADS 16
+
+/**
+ * Hash files of at least this size via mmap() instead of buffered reads
+ */
+#define MEAS_MMAP_THRESHOLD 65536
+
 typedef struct private_pts_file_meas_t private_pts_file_meas_t;
 
 /**
@@ -295,8 +307,24 @@ static bool hash_file(hasher_t *hasher, char *pathname, u_char *hash)
 	u_char buffer[4096];
 	size_t bytes_read;
 	bool success = TRUE;
+	struct stat st;
+	chunk_t *map;
 	FILE *file;
 
+	if (stat(pathname, &st) == 0 && st.st_size >= MEAS_MMAP_THRESHOLD)
+	{	/* hash large files from a mapping, saving read() copies */
+		map = chunk_map(pathname, FALSE);
+		if (map)
+		{
+			success = hasher->get_hash(hasher, *map, hash);
+			chunk_unmap(map);
+			if (!success)
+			{
+				DBG1(DBG_PTS, "  hasher increment error");
+			}
+			return success;
+		}
+	}
 	file = fopen(pathname, "rb");
 	if (!file)
 	{
@@ -331,6 +359,101 @@ static bool hash_file(hasher_t *hasher, char *pathname, u_char *hash)
 	return success;
 }
 
+typedef struct meas_job_t meas_job_t;
+
+/**
+ * A single file to measure, and its result
+ */
+struct meas_job_t {
+	char	 *rel_name;
+	char	 *abs_name;
+	chunk_t  measurement;
+};
+
+typedef struct meas_pool_t meas_pool_t;
+
+/**
+ * State shared by all measurement threads
+ */
+struct meas_pool_t {
+	/** dispatch lock */
+	mutex_t *mutex;
+	/** files to measure, in enumeration order */
+	meas_job_t **jobs;
+	/** number of jobs */
+	int count;
+	/** next job to dispatch */
+	int next;
+	/** hash algorithm to apply */
+	hash_algorithm_t hash_alg;
+	/** size of the resulting hash */
+	size_t hash_size;
+};
+
+/**
+ * Measurement thread, hashing files until the pool runs dry
+ */
+static void* measure_worker(meas_pool_t *pool)
+{
+	u_char hash[HASH_SIZE_SHA384];
+	hasher_t *hasher;
+	meas_job_t *job;
+	int i;
+
+	hasher = lib->crypto->create_hasher(lib->crypto, pool->hash_alg);
+	if (!hasher)
+	{
+		return NULL;
+	}
+	while (TRUE)
+	{
+		pool->mutex->lock(pool->mutex);
+		i = pool->next++;
+		pool->mutex->unlock(pool->mutex);
+		if (i >= pool->count)
+		{
+			break;
+		}
+		job = pool->jobs[i];
+		if (hash_file(hasher, job->abs_name, hash))
+		{
+			job->measurement = chunk_clone(chunk_create(hash, pool->hash_size));
+		}
+	}
+	hasher->destroy(hasher);
+	return NULL;
+}
+
+/**
+ * Measure the jobs in the pool, distributing them over several threads
+ */
+static void measure_pool(meas_pool_t *pool)
+{
+	thread_t *threads[MAX_MEAS_THREADS];
+	int i, count;
+
+	count = lib->settings->get_int(lib->settings,
+					"%s.imcv.pts.measurement_threads", 4, lib->ns);
+	count = min(max(count, 1), MAX_MEAS_THREADS);
+	count = min(count, pool->count);
+
+	pool->mutex = mutex_create(MUTEX_TYPE_DEFAULT);
+	/* this thread participates in the measurement as well */
+	for (i = 1; i < count; i++)
+	{
+		threads[i] = thread_create((thread_main_t)measure_worker, pool);
+	}
+	measure_worker(pool);
+	for (i = 1; i < count; i++)
+	{
+		if (threads[i])
+		{
+			threads[i]->join(threads[i]);
+		}
+	}
+	pool->mutex->destroy(pool->mutex);
+}
+
 /**
  * See header
  */
@@ -361,7 +484,14 @@ pts_file_meas_t *pts_file_meas_create_from_path(u_int16_t request_id,
 	{
 		enumerator_t *enumerator;
 		char *rel_name, *abs_name;
+		linked_list_t *files;
+		meas_pool_t pool = {
+			.hash_alg = hash_alg,
+			.hash_size = measurement.len,
+		};
+		meas_job_t *job;
 		struct stat st;
+		int i = 0;
 
 		enumerator = enumerator_create_directory(pathname);
 		if (!enumerator)
@@ -371,21 +501,51 @@ pts_file_meas_t *pts_file_meas_create_from_path(u_int16_t request_id,
 			success = FALSE;
 			goto end;
 		}
+		/* collect the files to measure first, then hash them in parallel */
+		files = linked_list_create();
 		while (enumerator->enumerate(enumerator, &rel_name, &abs_name, &st))
 		{
 			/* measure regular files only */
 			if (S_ISREG(st.st_mode) && *rel_name != '.')
 			{
-				if (!hash_file(hasher, abs_name, hash))
-				{
-					continue;
-				}
-				filename = use_rel_name ? rel_name : abs_name;
-				DBG2(DBG_PTS, "  %#B for '%s'", &measurement, filename);
-				add(this, filename, measurement);
+				INIT(job,
+					.rel_name = strdup(rel_name),
+					.abs_name = strdup(abs_name),
+				);
+				files->insert_last(files, job);
 			}
 		}
 		enumerator->destroy(enumerator);
+
+		pool.count = files->get_count(files);
+		pool.jobs = malloc(pool.count * sizeof(meas_job_t*));
+		enumerator = files->create_enumerator(files);
+		while (enumerator->enumerate(enumerator, &job))
+		{
+			pool.jobs[i++] = job;
+		}
+		enumerator->destroy(enumerator);
+
+		if (pool.count)
+		{
+			measure_pool(&pool);
+		}
+		free(pool.jobs);
+
+		while (files->remove_first(files, (void**)&job) == SUCCESS)
+		{
+			if (job->measurement.ptr)
+			{
+				filename = use_rel_name ? job->rel_name : job->abs_name;
+				DBG2(DBG_PTS, "  %#B for '%s'", &job->measurement, filename);
+				add(this, filename, job->measurement);
+			}
+			free(job->rel_name);
+			free(job->abs_name);
+			free(job->measurement.ptr);
+			free(job);
+		}
+		files->destroy(files);
 	}
 	else
 	{
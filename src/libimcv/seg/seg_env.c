@@ -106,8 +106,12 @@ METHOD(seg_env_t, first_segment, pa_tnc_attr_t*,
 	segment_data = this->data;
 	segment_data.len = this->max_seg_size - PA_TNC_ATTR_HEADER_SIZE;
 
-	/* build encoding of the base attribute header and first segment data */
-	writer = bio_writer_create(this->max_seg_size);
+	/* build the complete segment envelope value in a single buffer, handing
+	 * it over to the segment envelope attribute without a further copy */
+	seg_env_flags = SEG_ENV_FLAG_START | SEG_ENV_FLAG_MORE;
+	writer = bio_writer_create(TCG_SEG_ATTR_SEG_ENV_HEADER + this->max_seg_size);
+	writer->write_uint8 (writer, seg_env_flags);
+	writer->write_uint24(writer, this->base_attr_id);
 	writer->write_uint8 (writer, flags);
 	writer->write_uint24(writer, type.vendor_id);
 	writer->write_uint32(writer, type.type);
@@ -120,10 +124,8 @@ METHOD(seg_env_t, first_segment, pa_tnc_attr_t*,
 	DBG2(DBG_TNC, "creating first segment for base attribute ID %d (%d bytes)",
 		 this->base_attr_id, this->max_seg_size);
 
-	seg_env_flags = SEG_ENV_FLAG_START | SEG_ENV_FLAG_MORE;
-	seg_env_attr = tcg_seg_attr_seg_env_create(value, seg_env_flags,
-											   this->base_attr_id);
-	chunk_free(&value);
+	seg_env_attr = tcg_seg_attr_seg_env_create_own(value, seg_env_flags,
+												   this->base_attr_id);
 
 	return seg_env_attr;
 }
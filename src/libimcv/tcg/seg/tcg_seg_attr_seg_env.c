@@ -219,7 +219,41 @@ pa_tnc_attr_t* tcg_seg_attr_seg_env_create(chunk_t segment, uint8_t flags,
 	*this->value.ptr = flags;
 	memcpy(this->value.ptr + TCG_SEG_ATTR_SEG_ENV_HEADER,
 		   segment.ptr, segment.len);
-	
+
+	return &this->public.pa_tnc_attribute;
+}
+
+/**
+ * Described in header.
+ */
+pa_tnc_attr_t* tcg_seg_attr_seg_env_create_own(chunk_t value, uint8_t flags,
+											   uint32_t base_attr_id)
+{
+	private_tcg_seg_attr_seg_env_t *this;
+
+	INIT(this,
+		.public = {
+			.pa_tnc_attribute = {
+				.get_type = _get_type,
+				.get_value = _get_value,
+				.get_noskip_flag = _get_noskip_flag,
+				.set_noskip_flag = _set_noskip_flag,
+				.build = _build,
+				.process = _process,
+				.add_segment = _add_segment,
+				.get_ref = _get_ref,
+				.destroy = _destroy,
+			},
+			.get_base_attr_id = _get_base_attr_id,
+			.get_segment = _get_segment,
+		},
+		.type = { PEN_TCG, TCG_SEG_ATTR_SEG_ENV },
+		.flags = flags,
+		.base_attr_id = base_attr_id,
+		.value = value,
+		.ref = 1,
+	);
+
 	return &this->public.pa_tnc_attribute;
 }
 
@@ -64,6 +64,19 @@ struct tcg_seg_attr_seg_env_t {
 pa_tnc_attr_t* tcg_seg_attr_seg_env_create(chunk_t segment, uint8_t flags,
 										   uint32_t base_attr_id);
 
+/**
+ * Creates an tcg_seg_attr_seg_env_t object from a pre-built value
+ *
+ * The value must already contain the Segmentation Envelope header and
+ * is adopted without copying it.
+ *
+ * @param value				Complete attribute value, gets owned
+ * @param flags				Segmentation flags
+ * @param base_attr_id		Base Attribute ID
+ */
+pa_tnc_attr_t* tcg_seg_attr_seg_env_create_own(chunk_t value, uint8_t flags,
+											   uint32_t base_attr_id);
+
 /**
  * Creates an tcg_seg_attr_seg_env_t object from received data
  *
@@ -24,10 +24,15 @@
 #include <utils/debug.h>
 
 /**
- * Should be a multiple of 8
+ * Default size of the anti-replay window, in bits
  */
 #define ESP_DEFAULT_WINDOW_SIZE 128
 
+/**
+ * Number of bits in a window word
+ */
+#define WINDOW_WORD_BITS (sizeof(u_int32_t) * CHAR_BIT)
+
 typedef struct private_esp_context_t private_esp_context_t;
 
 /**
@@ -52,19 +57,15 @@ struct private_esp_context_t {
 	u_int32_t last_seqno;
 
 	/**
-	 * The bit in the window of the highest authenticated sequence number
-	 */
-	u_int seqno_index;
-
-	/**
-	 * The size of the anti-replay window (in bits)
+	 * The size of the anti-replay window (in bits, a multiple of the
+	 * word size)
 	 */
 	u_int window_size;
 
 	/**
-	 * The anti-replay window buffer
+	 * The anti-replay window, as ring bitmap indexed by sequence number
 	 */
-	chunk_t window;
+	u_int32_t *window;
 
 	/**
 	 * TRUE in case of an inbound ESP context
@@ -73,31 +74,60 @@ struct private_esp_context_t {
 };
 
 /**
- * Set or unset a bit in the window.
+ * Mark the bit of the given sequence number in the window.
+ *
+ * The window is a ring bitmap indexed directly by the sequence number, so
+ * no shifting is required when the window advances.
  */
-static inline void set_window_bit(private_esp_context_t *this,
-								  u_int index, bool set)
+static inline void set_window_bit(private_esp_context_t *this, u_int32_t seqno)
 {
-	u_int i = index / CHAR_BIT;
+	u_int index = seqno % this->window_size;
 
-	if (set)
-	{
-		this->window.ptr[i] |= 1 << (index % CHAR_BIT);
-	}
-	else
-	{
-		this->window.ptr[i] &= ~(1 << (index % CHAR_BIT));
-	}
+	this->window[index / WINDOW_WORD_BITS] |=
+										(1U << (index % WINDOW_WORD_BITS));
 }
 
 /**
- * Get a bit from the window.
+ * Get the bit of the given sequence number from the window.
  */
-static inline bool get_window_bit(private_esp_context_t *this, u_int index)
+static inline bool get_window_bit(private_esp_context_t *this, u_int32_t seqno)
 {
-	u_int i = index / CHAR_BIT;
+	u_int index = seqno % this->window_size;
 
-	return this->window.ptr[i] & (1 << index % CHAR_BIT);
+	return (this->window[index / WINDOW_WORD_BITS] &
+										(1U << (index % WINDOW_WORD_BITS))) != 0;
+}
+
+/**
+ * Clear the bits of count consecutive sequence numbers, starting with from.
+ *
+ * Works on whole window words where possible, so advancing the window is
+ * not O(n) in the number of bits, as bitwise shifting would be.
+ */
+static void clear_window_bits(private_esp_context_t *this, u_int32_t from,
+							  u_int32_t count)
+{
+	u_int index, word, offset, bits;
+	u_int32_t mask;
+
+	while (count)
+	{
+		index = from % this->window_size;
+		word = index / WINDOW_WORD_BITS;
+		offset = index % WINDOW_WORD_BITS;
+		bits = min(count, WINDOW_WORD_BITS - offset);
+		if (bits == WINDOW_WORD_BITS)
+		{
+			this->window[word] = 0;
+		}
+		else
+		{
+			mask = ((1U << bits) - 1) << offset;
+			this->window[word] &= ~mask;
+		}
+		from += bits;
+		count -= bits;
+	}
 }
 
 /**
@@ -105,11 +135,7 @@ static inline bool get_window_bit(private_esp_context_t *this, u_int index)
  */
 static bool check_window(private_esp_context_t *this, u_int32_t seqno)
 {
-	u_int offset;
-
-	offset = this->last_seqno - seqno;
-	offset = (this->seqno_index - offset) % this->window_size;
-	return !get_window_bit(this, offset);
+	return !get_window_bit(this, seqno);
 }
 
 METHOD(esp_context_t, verify_seqno, bool,
@@ -147,7 +173,7 @@ METHOD(esp_context_t, verify_seqno, bool,
 METHOD(esp_context_t, set_authenticated_seqno, void,
 	private_esp_context_t *this, u_int32_t seqno)
 {
-	u_int i, shift;
+	u_int32_t diff;
 
 	if (!this->inbound)
 	{
@@ -155,21 +181,24 @@ METHOD(esp_context_t, set_authenticated_seqno, void,
 	}
 
 	if (seqno > this->last_seqno)
-	{	/* shift the window to the new highest authenticated seqno */
-		shift = seqno - this->last_seqno;
-		shift = shift < this->window_size ? shift : this->window_size;
-		for (i = 0; i < shift; ++i)
+	{	/* advance the window to the new highest authenticated seqno by
+		 * clearing the bits of the sequence numbers that fall out of it */
+		diff = seqno - this->last_seqno;
+		if (diff < this->window_size)
 		{
-			this->seqno_index = (this->seqno_index + 1) % this->window_size;
-			set_window_bit(this, this->seqno_index, FALSE);
+			clear_window_bits(this, this->last_seqno + 1, diff);
 		}
-		set_window_bit(this, this->seqno_index, TRUE);
+		else
+		{
+			memset(this->window, 0,
+				   this->window_size / CHAR_BIT);
+		}
+		set_window_bit(this, seqno);
 		this->last_seqno = seqno;
 	}
 	else
 	{	/* seqno is inside the window, set the corresponding window bit */
-		i = this->last_seqno - seqno;
-		set_window_bit(this, (this->seqno_index - i) % this->window_size, TRUE);
+		set_window_bit(this, seqno);
 	}
 }
 
@@ -199,7 +228,7 @@ METHOD(esp_context_t, get_aead, aead_t*,
 METHOD(esp_context_t, destroy, void,
 	private_esp_context_t *this)
 {
-	chunk_free(&this->window);
+	free(this->window);
 	DESTROY_IF(this->aead);
 	free(this);
 }
@@ -299,9 +328,15 @@ esp_context_t *esp_context_create(int enc_alg, chunk_t enc_key,
 			.destroy = _destroy,
 		},
 		.inbound = inbound,
-		.window_size = ESP_DEFAULT_WINDOW_SIZE,
+		.window_size = lib->settings->get_int(lib->settings,
+								"%s.plugins.kernel-libipsec.replay_window",
+								ESP_DEFAULT_WINDOW_SIZE, lib->ns),
 	);
 
+	/* the ring bitmap is indexed by whole words */
+	this->window_size = max(this->window_size, WINDOW_WORD_BITS);
+	this->window_size = round_up(this->window_size, WINDOW_WORD_BITS);
+
 	if (encryption_algorithm_is_aead(enc_alg))
 	{
 		if (!create_aead(this, enc_alg, enc_key))
@@ -321,8 +356,8 @@ esp_context_t *esp_context_create(int enc_alg, chunk_t enc_key,
 
 	if (inbound)
 	{
-		this->window = chunk_alloc(this->window_size / CHAR_BIT + 1);
-		memset(this->window.ptr, 0, this->window.len);
+		this->window = calloc(this->window_size / WINDOW_WORD_BITS,
+							  sizeof(u_int32_t));
 	}
 	return &this->public;
 }
@@ -28,6 +28,40 @@
 #include <netinet/in.h>
 
 typedef struct private_esp_packet_t private_esp_packet_t;
+typedef struct esp_crypt_data_t esp_crypt_data_t;
+
+/**
+ * Per-packet state between the prepare and complete phase of an
+ * encryption/decryption, so the AEAD operations of multiple packets can be
+ * batched into a single call.
+ */
+struct esp_crypt_data_t {
+
+	/**
+	 * Ciphertext (including the trailing ICV), within the packet buffer
+	 */
+	chunk_t ciphertext;
+
+	/**
+	 * Associated data (SPI and sequence number)
+	 */
+	chunk_t aad;
+
+	/**
+	 * Initialization vector
+	 */
+	chunk_t iv;
+
+	/**
+	 * ICV length
+	 */
+	size_t icv_len;
+
+	/**
+	 * Host order sequence number
+	 */
+	u_int32_t seq;
+};
 
 /**
  * Private additions to esp_packet_t.
@@ -186,7 +220,9 @@ static bool remove_padding(private_esp_packet_t *this, chunk_t plaintext)
 		DBG1(DBG_ESP, "parsing ESP payload failed: invalid padding");
 		goto failed;
 	}
-	this->payload = ip_packet_create(reader->peek(reader));
+	/* create a view into the decrypted packet buffer instead of copying the
+	 * payload, the buffer is shared with the ip_packet_t */
+	this->payload = ip_packet_create_shared(this->packet, reader->peek(reader));
 	reader->destroy(reader);
 	if (!this->payload)
 	{
@@ -203,16 +239,21 @@ static bool remove_padding(private_esp_packet_t *this, chunk_t plaintext)
 
 failed:
 	reader->destroy(reader);
-	chunk_free(&plaintext);
 	return FALSE;
 }
 
-METHOD(esp_packet_t, decrypt, status_t,
-	private_esp_packet_t *this, esp_context_t *esp_context)
+/**
+ * Parse the packet and verify the sequence number, filling in the data for
+ * the inline AEAD call.  The plaintext will replace the ciphertext in the
+ * packet buffer, so no separate buffer has to be allocated per packet.
+ */
+static status_t prepare_decrypt(private_esp_packet_t *this,
+								esp_context_t *esp_context,
+								esp_crypt_data_t *crypt)
 {
 	bio_reader_t *reader;
 	u_int32_t spi, seq;
-	chunk_t data, iv, icv, aad, ciphertext, plaintext;
+	chunk_t data, iv, icv, ciphertext;
 	aead_t *aead;
 
 	DESTROY_IF(this->payload);
@@ -246,21 +287,109 @@ METHOD(esp_packet_t, decrypt, status_t,
 
 	/* include ICV in ciphertext for decryption/verification */
 	ciphertext.len += icv.len;
+
+	crypt->ciphertext = ciphertext;
 	/* aad = spi + seq */
-	aad = chunk_create(data.ptr, 8);
+	crypt->aad = chunk_create(data.ptr, 8);
+	crypt->iv = iv;
+	crypt->icv_len = icv.len;
+	crypt->seq = seq;
+	return SUCCESS;
+}
+
+/**
+ * Update the anti-replay window and parse the decrypted payload after a
+ * successful AEAD call.
+ */
+static status_t complete_decrypt(private_esp_packet_t *this,
+								 esp_context_t *esp_context,
+								 esp_crypt_data_t *crypt)
+{
+	chunk_t plaintext;
 
-	if (!aead->decrypt(aead, ciphertext, aad, iv, &plaintext))
+	esp_context->set_authenticated_seqno(esp_context, crypt->seq);
+
+	plaintext = chunk_create(crypt->ciphertext.ptr,
+							 crypt->ciphertext.len - crypt->icv_len);
+	if (!remove_padding(this, plaintext))
+	{
+		return PARSE_ERROR;
+	}
+	return SUCCESS;
+}
+
+METHOD(esp_packet_t, decrypt, status_t,
+	private_esp_packet_t *this, esp_context_t *esp_context)
+{
+	esp_crypt_data_t crypt;
+	status_t status;
+	aead_t *aead;
+
+	status = prepare_decrypt(this, esp_context, &crypt);
+	if (status != SUCCESS)
+	{
+		return status;
+	}
+	aead = esp_context->get_aead(esp_context);
+	if (!aead->decrypt(aead, crypt.ciphertext, crypt.aad, crypt.iv, NULL))
 	{
 		DBG1(DBG_ESP, "ESP decryption or ICV verification failed");
 		return FAILED;
 	}
-	esp_context->set_authenticated_seqno(esp_context, seq);
+	return complete_decrypt(this, esp_context, &crypt);
+}
 
-	if (!remove_padding(this, plaintext))
+/**
+ * Described in header.
+ */
+void esp_packet_decrypt_batch(esp_packet_t **packets, status_t *results,
+							  u_int count, esp_context_t *esp_context)
+{
+	chunk_t ciphertext[ESP_PACKET_BATCH_MAX], aad[ESP_PACKET_BATCH_MAX],
+			iv[ESP_PACKET_BATCH_MAX];
+	esp_crypt_data_t crypt[ESP_PACKET_BATCH_MAX];
+	u_int idx[ESP_PACKET_BATCH_MAX];
+	bool ok[ESP_PACKET_BATCH_MAX];
+	u_int i, prepared = 0;
+	aead_t *aead;
+
+	if (count == 1)
+	{	/* avoid the batching overhead at low rates */
+		results[0] = packets[0]->decrypt(packets[0], esp_context);
+		return;
+	}
+	count = min(count, ESP_PACKET_BATCH_MAX);
+
+	for (i = 0; i < count; i++)
 	{
-		return PARSE_ERROR;
+		results[i] = prepare_decrypt((private_esp_packet_t*)packets[i],
+									 esp_context, &crypt[prepared]);
+		if (results[i] == SUCCESS)
+		{
+			ciphertext[prepared] = crypt[prepared].ciphertext;
+			aad[prepared] = crypt[prepared].aad;
+			iv[prepared] = crypt[prepared].iv;
+			idx[prepared++] = i;
+		}
+	}
+	if (!prepared)
+	{
+		return;
+	}
+	aead = esp_context->get_aead(esp_context);
+	aead->decrypt_batch(aead, ciphertext, aad, iv, ok, prepared);
+
+	for (i = 0; i < prepared; i++)
+	{
+		if (!ok[i])
+		{
+			DBG1(DBG_ESP, "ESP decryption or ICV verification failed");
+			results[idx[i]] = FAILED;
+			continue;
+		}
+		results[idx[i]] = complete_decrypt((private_esp_packet_t*)packets[idx[i]],
+										   esp_context, &crypt[i]);
 	}
-	return SUCCESS;
 }
 
 /**
@@ -276,8 +405,14 @@ static void generate_padding(chunk_t padding)
 	}
 }
 
-METHOD(esp_packet_t, encrypt, status_t,
-	private_esp_packet_t *this, esp_context_t *esp_context, u_int32_t spi)
+/**
+ * Encapsulate the payload and generate IV and padding, filling in the data
+ * for the inline AEAD call.  The assembled packet buffer is installed as
+ * packet data, the content is encrypted in place.
+ */
+static status_t prepare_encrypt(private_esp_packet_t *this,
+								esp_context_t *esp_context, u_int32_t spi,
+								esp_crypt_data_t *crypt)
 {
 	chunk_t iv, icv, aad, padding, payload, ciphertext;
 	bio_writer_t *writer;
@@ -345,27 +480,120 @@ METHOD(esp_packet_t, encrypt, status_t,
 	/* aad = spi + seq */
 	aad = writer->get_buf(writer);
 	aad.len = 8;
-	icv = writer->skip(writer, icv.len);
+	writer->skip(writer, icv.len);
 
 	DBG3(DBG_ESP, "ESP before encryption:\n  payload = %B\n  padding = %B\n  "
 		 "padding length = %hhu, next header = %hhu", &payload, &padding,
 		 (u_int8_t)padding.len, this->next_header);
 
-	/* encrypt/authenticate the content inline */
-	if (!aead->encrypt(aead, ciphertext, aad, iv, NULL))
+	/* the buffer was allocated with its final size, so the chunks above stay
+	 * valid and the content can be encrypted in place */
+	this->packet->set_data(this->packet, writer->extract_buf(writer));
+	writer->destroy(writer);
+
+	crypt->ciphertext = ciphertext;
+	crypt->aad = aad;
+	crypt->iv = iv;
+	crypt->icv_len = icv.len;
+	crypt->seq = next_seqno;
+	return SUCCESS;
+}
+
+/**
+ * Log the encrypted packet after a successful AEAD call
+ */
+static void complete_encrypt(private_esp_packet_t *this, u_int32_t spi,
+							 esp_crypt_data_t *crypt)
+{
+	chunk_t icv;
+
+	icv = chunk_create(crypt->ciphertext.ptr + crypt->ciphertext.len,
+					   crypt->icv_len);
+	DBG3(DBG_ESP, "ESP packet:\n  SPI %.8x [seq %u]\n  IV %B\n  "
+		 "encrypted %B\n  ICV %B", ntohl(spi), crypt->seq, &crypt->iv,
+		 &crypt->ciphertext, &icv);
+}
+
+METHOD(esp_packet_t, encrypt, status_t,
+	private_esp_packet_t *this, esp_context_t *esp_context, u_int32_t spi)
+{
+	esp_crypt_data_t crypt;
+	status_t status;
+	aead_t *aead;
+
+	status = prepare_encrypt(this, esp_context, spi, &crypt);
+	if (status != SUCCESS)
+	{
+		return status;
+	}
+	aead = esp_context->get_aead(esp_context);
+	if (!aead->encrypt(aead, crypt.ciphertext, crypt.aad, crypt.iv, NULL))
 	{
 		DBG1(DBG_ESP, "ESP encryption or ICV generation failed");
-		writer->destroy(writer);
+		this->packet->set_data(this->packet, chunk_empty);
 		return FAILED;
 	}
+	complete_encrypt(this, spi, &crypt);
+	return SUCCESS;
+}
 
-	DBG3(DBG_ESP, "ESP packet:\n  SPI %.8x [seq %u]\n  IV %B\n  "
-		 "encrypted %B\n  ICV %B", ntohl(spi), next_seqno, &iv,
-		 &ciphertext, &icv);
+/**
+ * Described in header.
+ */
+void esp_packet_encrypt_batch(esp_packet_t **packets, status_t *results,
+							  u_int count, esp_context_t *esp_context,
+							  u_int32_t spi)
+{
+	chunk_t plain[ESP_PACKET_BATCH_MAX], aad[ESP_PACKET_BATCH_MAX],
+			iv[ESP_PACKET_BATCH_MAX];
+	esp_crypt_data_t crypt[ESP_PACKET_BATCH_MAX];
+	u_int idx[ESP_PACKET_BATCH_MAX];
+	u_int i, prepared = 0;
+	private_esp_packet_t *pkt;
+	aead_t *aead;
 
-	this->packet->set_data(this->packet, writer->extract_buf(writer));
-	writer->destroy(writer);
-	return SUCCESS;
+	if (count == 1)
+	{	/* avoid the batching overhead at low rates */
+		results[0] = packets[0]->encrypt(packets[0], esp_context, spi);
+		return;
+	}
+	count = min(count, ESP_PACKET_BATCH_MAX);
+
+	for (i = 0; i < count; i++)
+	{
+		results[i] = prepare_encrypt((private_esp_packet_t*)packets[i],
+									 esp_context, spi, &crypt[prepared]);
+		if (results[i] == SUCCESS)
+		{
+			plain[prepared] = crypt[prepared].ciphertext;
+			aad[prepared] = crypt[prepared].aad;
+			iv[prepared] = crypt[prepared].iv;
+			idx[prepared++] = i;
+		}
+	}
+	if (!prepared)
+	{
+		return;
+	}
+	aead = esp_context->get_aead(esp_context);
+	if (!aead->encrypt_batch(aead, plain, aad, iv, prepared))
+	{	/* unlike an ICV verification failure on decryption, a failing
+		 * encryption indicates a problem with the backend, so the packets
+		 * of the batch are discarded collectively */
+		DBG1(DBG_ESP, "ESP encryption or ICV generation failed");
+		for (i = 0; i < prepared; i++)
+		{
+			pkt = (private_esp_packet_t*)packets[idx[i]];
+			pkt->packet->set_data(pkt->packet, chunk_empty);
+			results[idx[i]] = FAILED;
+		}
+		return;
+	}
+	for (i = 0; i < prepared; i++)
+	{
+		complete_encrypt((private_esp_packet_t*)packets[idx[i]], spi,
+						 &crypt[i]);
+	}
 }
 
 METHOD(esp_packet_t, get_next_header, u_int8_t,
@@ -32,6 +32,11 @@
 
 typedef struct esp_packet_t esp_packet_t;
 
+/**
+ * Maximum number of packets processed by a single batched AEAD call
+ */
+#define ESP_PACKET_BATCH_MAX 8
+
 /**
  *  ESP packet
  */
@@ -147,5 +152,37 @@ esp_packet_t *esp_packet_create_from_packet(packet_t *packet);
 esp_packet_t *esp_packet_create_from_payload(host_t *src, host_t *dst,
 											 ip_packet_t *payload);
 
+/**
+ * Decrypt a batch of packets belonging to the same inbound SA.
+ *
+ * The AEAD operations of all packets that pass the sequence number check are
+ * issued as a single batched call, which implementations may pipeline. For a
+ * single packet this falls back to decrypt(). The per-packet status uses the
+ * same codes as decrypt().
+ *
+ * @param packets		packets to decrypt, at most ESP_PACKET_BATCH_MAX
+ * @param results		array receiving the per-packet status
+ * @param count			number of packets
+ * @param esp_context	ESP context of corresponding inbound IPsec SA
+ */
+void esp_packet_decrypt_batch(esp_packet_t **packets, status_t *results,
+							  u_int count, esp_context_t *esp_context);
+
+/**
+ * Encapsulate and encrypt a batch of packets using the same outbound SA.
+ *
+ * Like esp_packet_decrypt_batch(), but using encrypt(). If the batched AEAD
+ * call fails, all packets of the batch are marked FAILED.
+ *
+ * @param packets		packets to encrypt, at most ESP_PACKET_BATCH_MAX
+ * @param results		array receiving the per-packet status
+ * @param count			number of packets
+ * @param esp_context	ESP context of corresponding outbound IPsec SA
+ * @param spi			SPI value to use, in network byte order
+ */
+void esp_packet_encrypt_batch(esp_packet_t **packets, status_t *results,
+							  u_int count, esp_context_t *esp_context,
+							  u_int32_t spi);
+
 #endif /** ESP_PACKET_H_ @}*/
 
@@ -80,6 +80,11 @@ struct private_ip_packet_t {
 	 */
 	chunk_t packet;
 
+	/**
+	 * Packet object the data is shared with, NULL if the data is owned
+	 */
+	packet_t *shared;
+
 	/**
 	 * IP payload (points into packet)
 	 */
@@ -136,6 +141,10 @@ METHOD(ip_packet_t, get_next_header, u_int8_t,
 METHOD(ip_packet_t, clone_, ip_packet_t*,
 	private_ip_packet_t *this)
 {
+	if (this->shared)
+	{	/* creates another view into the shared buffer */
+		return ip_packet_create_shared(this->shared, this->packet);
+	}
 	return ip_packet_create(chunk_clone(this->packet));
 }
 
@@ -144,7 +153,14 @@ METHOD(ip_packet_t, destroy, void,
 {
 	this->src->destroy(this->src);
 	this->dst->destroy(this->dst);
-	chunk_free(&this->packet);
+	if (this->shared)
+	{	/* our reference keeps the shared buffer alive, not the chunk */
+		this->shared->destroy(this->shared);
+	}
+	else
+	{
+		chunk_free(&this->packet);
+	}
 	free(this);
 }
 
@@ -191,9 +207,11 @@ static bool parse_transport_header(chunk_t packet, u_int8_t proto,
 }
 
 /**
- * Described in header.
+ * Parse the given data and create an ip_packet_t instance.  If shared is
+ * given, it already holds a reference on the buffer backing the data, which
+ * is released again if the data is invalid.
  */
-ip_packet_t *ip_packet_create(chunk_t packet)
+static ip_packet_t *ip_packet_create_internal(chunk_t packet, packet_t *shared)
 {
 	private_ip_packet_t *this;
 	u_int8_t version, next_header;
@@ -282,6 +300,7 @@ ip_packet_t *ip_packet_create(chunk_t packet)
 		.src = src,
 		.dst = dst,
 		.packet = packet,
+		.shared = shared,
 		.payload = payload,
 		.version = version,
 		.next_header = next_header,
@@ -289,10 +308,33 @@ ip_packet_t *ip_packet_create(chunk_t packet)
 	return &this->public;
 
 failed:
-	chunk_free(&packet);
+	if (shared)
+	{
+		shared->destroy(shared);
+	}
+	else
+	{
+		chunk_free(&packet);
+	}
 	return NULL;
 }
 
+/**
+ * Described in header.
+ */
+ip_packet_t *ip_packet_create(chunk_t packet)
+{
+	return ip_packet_create_internal(packet, NULL);
+}
+
+/**
+ * Described in header.
+ */
+ip_packet_t *ip_packet_create_shared(packet_t *packet, chunk_t data)
+{
+	return ip_packet_create_internal(data, packet->clone(packet));
+}
+
 /**
  * Calculate the checksum for the pseudo IP header
  */
@@ -100,6 +100,22 @@ struct ip_packet_t {
  */
 ip_packet_t *ip_packet_create(chunk_t packet);
 
+/**
+ * Create an IP packet as a view into the buffer of an existing packet object.
+ *
+ * Instead of copying the data, the underlying buffer is shared with a clone
+ * of the given packet object, so the original object may be modified or
+ * destroyed independently of the created view.  This avoids copying each
+ * payload on the decryption path, the buffer is freed with the last
+ * reference.
+ *
+ * @param packet		packet object whose buffer holds the IP packet
+ * @param data			the IP packet (including header), pointing into the
+ *						buffer of the given packet object
+ * @return				ip_packet_t instance, or NULL if invalid
+ */
+ip_packet_t *ip_packet_create_shared(packet_t *packet, chunk_t data);
+
 /**
  * Encode an IP packet from the given data.
  *
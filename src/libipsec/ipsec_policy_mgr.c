@@ -25,6 +25,29 @@
 #define PRIO_BASE 384
 
 typedef struct private_ipsec_policy_mgr_t private_ipsec_policy_mgr_t;
+typedef struct spd_node_t spd_node_t;
+
+/**
+ * Node of the SPD trie.
+ *
+ * The trie is a binary prefix tree over the destination address.  Each
+ * policy is stored at the node of the subnet covering its destination
+ * selector, so looking up a packet only has to check the policies on the
+ * trie path of its destination address, instead of all installed policies.
+ */
+struct spd_node_t {
+
+	/**
+	 * Child nodes, indexed by the next address bit
+	 */
+	spd_node_t *child[2];
+
+	/**
+	 * Policies stored at this prefix, sorted by priority
+	 * (ipsec_policy_entry_t*), NULL if there are none
+	 */
+	linked_list_t *entries;
+};
 
 /**
  * Private additions to ipsec_policy_mgr_t.
@@ -37,12 +60,17 @@ struct private_ipsec_policy_mgr_t {
 	ipsec_policy_mgr_t public;
 
 	/**
-	 * Installed policies (ipsec_policy_entry_t*)
+	 * SPD trie for policies with IPv4 destination selectors
+	 */
+	spd_node_t *spd4;
+
+	/**
+	 * SPD trie for policies with IPv6 destination selectors
 	 */
-	linked_list_t *policies;
+	spd_node_t *spd6;
 
 	/**
-	 * Lock to safely access the list of policies
+	 * Lock to safely access the policy tries
 	 */
 	rwlock_t *lock;
 
@@ -137,6 +165,80 @@ static void policy_entry_destroy(ipsec_policy_entry_t *this)
 	free(this);
 }
 
+/**
+ * Create a trie node
+ */
+static spd_node_t *spd_node_create()
+{
+	spd_node_t *this;
+
+	INIT(this);
+	return this;
+}
+
+/**
+ * Recursively destroy a trie node, its policies and its children
+ */
+static void spd_node_destroy(spd_node_t *this)
+{
+	if (this->child[0])
+	{
+		spd_node_destroy(this->child[0]);
+	}
+	if (this->child[1])
+	{
+		spd_node_destroy(this->child[1]);
+	}
+	if (this->entries)
+	{
+		this->entries->destroy_function(this->entries,
+										(void*)policy_entry_destroy);
+	}
+	free(this);
+}
+
+/**
+ * Get the bit at the given position of an address, starting from the front
+ */
+static inline u_int address_bit(chunk_t addr, u_int bit)
+{
+	return (addr.ptr[bit / 8] >> (7 - bit % 8)) & 1;
+}
+
+/**
+ * Find the trie node for the subnet covering the destination selector,
+ * optionally creating intermediate nodes.
+ *
+ * to_subnet() returns the smallest subnet covering the selector, so any
+ * address included in the selector shares this prefix and lookups along
+ * the trie path of an address can't miss the policy.
+ */
+static spd_node_t *find_node(private_ipsec_policy_mgr_t *this,
+							 traffic_selector_t *dst_ts, bool create)
+{
+	spd_node_t *node, *next;
+	host_t *net;
+	chunk_t addr;
+	u_int8_t mask;
+	u_int bit;
+
+	dst_ts->to_subnet(dst_ts, &net, &mask);
+	addr = net->get_address(net);
+	node = (net->get_family(net) == AF_INET) ? this->spd4 : this->spd6;
+	for (bit = 0; node && bit < mask; bit++)
+	{
+		next = node->child[address_bit(addr, bit)];
+		if (!next && create)
+		{
+			next = spd_node_create();
+			node->child[address_bit(addr, bit)] = next;
+		}
+		node = next;
+	}
+	net->destroy(net);
+	return node;
+}
+
 METHOD(ipsec_policy_mgr_t, add_policy, status_t,
 	private_ipsec_policy_mgr_t *this, host_t *src, host_t *dst,
 	traffic_selector_t *src_ts, traffic_selector_t *dst_ts,
@@ -146,6 +248,7 @@ METHOD(ipsec_policy_mgr_t, add_policy, status_t,
 	enumerator_t *enumerator;
 	ipsec_policy_entry_t *entry, *current;
 	ipsec_policy_t *policy;
+	spd_node_t *node;
 
 	if (type != POLICY_IPSEC || direction == POLICY_FWD)
 	{	/* we ignore these policies as we currently have no use for them */
@@ -160,7 +263,12 @@ METHOD(ipsec_policy_mgr_t, add_policy, status_t,
 	entry = policy_entry_create(policy);
 
 	this->lock->write_lock(this->lock);
-	enumerator = this->policies->create_enumerator(this->policies);
+	node = find_node(this, policy->get_destination_ts(policy), TRUE);
+	if (!node->entries)
+	{
+		node->entries = linked_list_create();
+	}
+	enumerator = node->entries->create_enumerator(node->entries);
 	while (enumerator->enumerate(enumerator, (void**)&current))
 	{
 		if (current->priority >= entry->priority)
@@ -168,7 +276,7 @@ METHOD(ipsec_policy_mgr_t, add_policy, status_t,
 			break;
 		}
 	}
-	this->policies->insert_before(this->policies, enumerator, entry);
+	node->entries->insert_before(node->entries, enumerator, entry);
 	enumerator->destroy(enumerator);
 	this->lock->unlock(this->lock);
 	return SUCCESS;
@@ -182,6 +290,7 @@ METHOD(ipsec_policy_mgr_t, del_policy, status_t,
 	enumerator_t *enumerator;
 	ipsec_policy_entry_t *current, *found = NULL;
 	u_int32_t priority;
+	spd_node_t *node;
 
 	if (direction == POLICY_FWD)
 	{	/* we ignore these policies as we currently have no use for them */
@@ -193,19 +302,23 @@ METHOD(ipsec_policy_mgr_t, del_policy, status_t,
 	priority = calculate_priority(policy_priority, src_ts, dst_ts);
 
 	this->lock->write_lock(this->lock);
-	enumerator = this->policies->create_enumerator(this->policies);
-	while (enumerator->enumerate(enumerator, (void**)&current))
+	node = find_node(this, dst_ts, FALSE);
+	if (node && node->entries)
 	{
-		if (current->priority == priority &&
-			current->policy->match(current->policy, src_ts, dst_ts, direction,
-								   reqid, mark, policy_priority))
+		enumerator = node->entries->create_enumerator(node->entries);
+		while (enumerator->enumerate(enumerator, (void**)&current))
 		{
-			this->policies->remove_at(this->policies, enumerator);
-			found = current;
-			break;
+			if (current->priority == priority &&
+				current->policy->match(current->policy, src_ts, dst_ts,
+									   direction, reqid, mark, policy_priority))
+			{
+				node->entries->remove_at(node->entries, enumerator);
+				found = current;
+				break;
+			}
 		}
+		enumerator->destroy(enumerator);
 	}
-	enumerator->destroy(enumerator);
 	this->lock->unlock(this->lock);
 	if (found)
 	{
@@ -218,16 +331,13 @@ METHOD(ipsec_policy_mgr_t, del_policy, status_t,
 METHOD(ipsec_policy_mgr_t, flush_policies, status_t,
 	private_ipsec_policy_mgr_t *this)
 {
-	ipsec_policy_entry_t *entry;
-
 	DBG2(DBG_ESP, "flushing policies");
 
 	this->lock->write_lock(this->lock);
-	while (this->policies->remove_last(this->policies,
-									  (void**)&entry) == SUCCESS)
-	{
-		policy_entry_destroy(entry);
-	}
+	spd_node_destroy(this->spd4);
+	spd_node_destroy(this->spd6);
+	this->spd4 = spd_node_create();
+	this->spd6 = spd_node_create();
 	this->lock->unlock(this->lock);
 	return SUCCESS;
 }
@@ -239,24 +349,53 @@ METHOD(ipsec_policy_mgr_t, find_by_packet, ipsec_policy_t*,
 	enumerator_t *enumerator;
 	ipsec_policy_entry_t *current;
 	ipsec_policy_t *found = NULL;
+	u_int32_t best = UINT32_MAX;
+	spd_node_t *node;
+	host_t *dst;
+	chunk_t addr;
+	u_int bit = 0;
+
+	dst = packet->get_destination(packet);
+	addr = dst->get_address(dst);
 
 	this->lock->read_lock(this->lock);
-	enumerator = this->policies->create_enumerator(this->policies);
-	while (enumerator->enumerate(enumerator, (void**)&current))
+	/* walk the trie along the destination address, checking the policies
+	 * of each prefix on the path and keeping the best priority match */
+	node = (dst->get_family(dst) == AF_INET) ? this->spd4 : this->spd6;
+	while (node)
 	{
-		ipsec_policy_t *policy = current->policy;
-
-		if ((inbound == (policy->get_direction(policy) == POLICY_IN)) &&
-			 policy->match_packet(policy, packet))
+		if (node->entries)
 		{
-			if (reqid == 0 || reqid == policy->get_reqid(policy))
+			enumerator = node->entries->create_enumerator(node->entries);
+			while (enumerator->enumerate(enumerator, (void**)&current))
 			{
-				found = policy->get_ref(policy);
-				break;
+				ipsec_policy_t *policy = current->policy;
+
+				if (current->priority < best &&
+					(inbound == (policy->get_direction(policy) == POLICY_IN)) &&
+					 policy->match_packet(policy, packet))
+				{
+					if (reqid == 0 || reqid == policy->get_reqid(policy))
+					{	/* entries are sorted by priority, the first match
+						 * is the best of this node */
+						found = policy;
+						best = current->priority;
+						break;
+					}
+				}
 			}
+			enumerator->destroy(enumerator);
+		}
+		if (bit >= addr.len * 8)
+		{
+			break;
 		}
+		node = node->child[address_bit(addr, bit++)];
+	}
+	if (found)
+	{
+		found = found->get_ref(found);
 	}
-	enumerator->destroy(enumerator);
 	this->lock->unlock(this->lock);
 	return found;
 }
@@ -264,8 +403,8 @@ METHOD(ipsec_policy_mgr_t, find_by_packet, ipsec_policy_t*,
 METHOD(ipsec_policy_mgr_t, destroy, void,
 	private_ipsec_policy_mgr_t *this)
 {
-	flush_policies(this);
-	this->policies->destroy(this->policies);
+	spd_node_destroy(this->spd4);
+	spd_node_destroy(this->spd6);
 	this->lock->destroy(this->lock);
 	free(this);
 }
@@ -285,7 +424,8 @@ ipsec_policy_mgr_t *ipsec_policy_mgr_create()
 			.find_by_packet = _find_by_packet,
 			.destroy = _destroy,
 		},
-		.policies = linked_list_create(),
+		.spd4 = spd_node_create(),
+		.spd6 = spd_node_create(),
 		.lock = rwlock_create(RWLOCK_TYPE_DEFAULT),
 	);
 
@@ -23,6 +23,25 @@
 #include <processing/jobs/callback_job.h>
 
 typedef struct private_ipsec_processor_t private_ipsec_processor_t;
+typedef struct queue_shard_t queue_shard_t;
+
+/**
+ * A single queue shard, processed by its own job.  Packets are distributed
+ * over the shards by a flow hash, so packets of the same SA are always
+ * processed in order, while independent tunnels scale across cores.
+ */
+struct queue_shard_t {
+
+	/**
+	 * Back reference to the processor
+	 */
+	private_ipsec_processor_t *processor;
+
+	/**
+	 * Queue served by this shard (esp_packet_t* or ip_packet_t*)
+	 */
+	blocking_queue_t *queue;
+};
 
 /**
  * Private additions to ipsec_processor_t.
@@ -35,14 +54,19 @@ struct private_ipsec_processor_t {
 	ipsec_processor_t public;
 
 	/**
-	 * Queue for inbound packets (esp_packet_t*)
+	 * Queue shards for inbound packets (esp_packet_t*)
+	 */
+	queue_shard_t *inbound_queues;
+
+	/**
+	 * Queue shards for outbound packets (ip_packet_t*)
 	 */
-	blocking_queue_t *inbound_queue;
+	queue_shard_t *outbound_queues;
 
 	/**
-	 * Queue for outbound packets (ip_packet_t*)
+	 * Number of queue shards (and processing jobs) per direction
 	 */
-	blocking_queue_t *outbound_queue;
+	u_int shards;
 
 	/**
 	 * Registered inbound callback
@@ -66,6 +90,35 @@ struct private_ipsec_processor_t {
 	rwlock_t *lock;
 };
 
+/**
+ * Select a queue shard based on a hash over the flow identifying data
+ */
+static u_int flow_hash(private_ipsec_processor_t *this, host_t *src,
+					   host_t *dst, u_int32_t spi)
+{
+	return chunk_hash_inc(src->get_address(src),
+				chunk_hash_inc(dst->get_address(dst),
+					chunk_hash(chunk_from_thing(spi)))) % this->shards;
+}
+
+/**
+ * Drain up to ESP_PACKET_BATCH_MAX packets from a shard queue.  Only the
+ * first dequeue blocks, further packets are taken only if already queued, so
+ * low rate traffic is still processed with per-packet latency.
+ */
+static u_int drain_queue(blocking_queue_t *queue, void **batch)
+{
+	u_int count = 1;
+
+	batch[0] = queue->dequeue(queue);
+	while (count < ESP_PACKET_BATCH_MAX &&
+		   queue->try_dequeue(queue, &batch[count]))
+	{
+		count++;
+	}
+	return count;
+}
+
 /**
  * Deliver an inbound IP packet to the registered listener
  */
@@ -86,51 +139,14 @@ static void deliver_inbound(private_ipsec_processor_t *this,
 }
 
 /**
- * Processes inbound packets
+ * Route a decrypted packet to the registered listener, if the inbound
+ * policies allow it
  */
-static job_requeue_t process_inbound(private_ipsec_processor_t *this)
+static void route_inbound(private_ipsec_processor_t *this,
+						  esp_packet_t *packet, u_int32_t reqid)
 {
-	esp_packet_t *packet;
 	ip_packet_t *ip_packet;
-	ipsec_sa_t *sa;
 	u_int8_t next_header;
-	u_int32_t spi, reqid;
-
-	packet = (esp_packet_t*)this->inbound_queue->dequeue(this->inbound_queue);
-
-	if (!packet->parse_header(packet, &spi))
-	{
-		packet->destroy(packet);
-		return JOB_REQUEUE_DIRECT;
-	}
-
-	sa = ipsec->sas->checkout_by_spi(ipsec->sas, spi,
-									 packet->get_destination(packet));
-	if (!sa)
-	{
-		DBG2(DBG_ESP, "inbound ESP packet does not belong to an installed SA");
-		packet->destroy(packet);
-		return JOB_REQUEUE_DIRECT;
-	}
-
-	if (!sa->is_inbound(sa))
-	{
-		DBG1(DBG_ESP, "error: IPsec SA is not inbound");
-		packet->destroy(packet);
-		ipsec->sas->checkin(ipsec->sas, sa);
-		return JOB_REQUEUE_DIRECT;
-	}
-
-	if (packet->decrypt(packet, sa->get_esp_context(sa)) != SUCCESS)
-	{
-		ipsec->sas->checkin(ipsec->sas, sa);
-		packet->destroy(packet);
-		return JOB_REQUEUE_DIRECT;
-	}
-	ip_packet = packet->get_payload(packet);
-	sa->update_usestats(sa, ip_packet->get_encoding(ip_packet).len);
-	reqid = sa->get_reqid(sa);
-	ipsec->sas->checkin(ipsec->sas, sa);
 
 	next_header = packet->get_next_header(packet);
 	switch (next_header)
@@ -140,6 +156,7 @@ static job_requeue_t process_inbound(private_ipsec_processor_t *this)
 		{
 			ipsec_policy_t *policy;
 
+			ip_packet = packet->get_payload(packet);
 			policy = ipsec->policies->find_by_packet(ipsec->policies,
 													 ip_packet, TRUE, reqid);
 			if (policy)
@@ -160,6 +177,99 @@ static job_requeue_t process_inbound(private_ipsec_processor_t *this)
 			packet->destroy(packet);
 			break;
 	}
+}
+
+/**
+ * Processes inbound packets
+ */
+static job_requeue_t process_inbound(queue_shard_t *shard)
+{
+	private_ipsec_processor_t *this = shard->processor;
+	esp_packet_t *batch[ESP_PACKET_BATCH_MAX];
+	status_t results[ESP_PACKET_BATCH_MAX];
+	u_int32_t spis[ESP_PACKET_BATCH_MAX];
+	ip_packet_t *ip_packet;
+	ipsec_sa_t *sa;
+	host_t *dst;
+	u_int32_t reqid;
+	u_int count, group, i, j;
+
+	count = drain_queue(shard->queue, (void**)batch);
+
+	for (i = 0; i < count; i++)
+	{
+		if (!batch[i]->parse_header(batch[i], &spis[i]))
+		{
+			batch[i]->destroy(batch[i]);
+			batch[i] = NULL;
+		}
+	}
+
+	for (i = 0; i < count; i += group)
+	{
+		group = 1;
+		if (!batch[i])
+		{
+			continue;
+		}
+		/* batch consecutive packets of the same SA, so their AEAD operations
+		 * can be pipelined in a single call */
+		dst = batch[i]->get_destination(batch[i]);
+		while (i + group < count && batch[i + group] &&
+			   spis[i + group] == spis[i] &&
+			   dst->ip_equals(dst,
+					batch[i + group]->get_destination(batch[i + group])))
+		{
+			group++;
+		}
+
+		sa = ipsec->sas->checkout_by_spi(ipsec->sas, spis[i], dst);
+		if (!sa)
+		{
+			DBG2(DBG_ESP, "inbound ESP packet does not belong to an "
+				 "installed SA");
+			for (j = i; j < i + group; j++)
+			{
+				batch[j]->destroy(batch[j]);
+			}
+			continue;
+		}
+
+		if (!sa->is_inbound(sa))
+		{
+			DBG1(DBG_ESP, "error: IPsec SA is not inbound");
+			ipsec->sas->checkin(ipsec->sas, sa);
+			for (j = i; j < i + group; j++)
+			{
+				batch[j]->destroy(batch[j]);
+			}
+			continue;
+		}
+
+		esp_packet_decrypt_batch(&batch[i], &results[i], group,
+								 sa->get_esp_context(sa));
+		for (j = i; j < i + group; j++)
+		{
+			if (results[j] == SUCCESS)
+			{
+				ip_packet = batch[j]->get_payload(batch[j]);
+				sa->update_usestats(sa,
+									ip_packet->get_encoding(ip_packet).len);
+			}
+		}
+		reqid = sa->get_reqid(sa);
+		ipsec->sas->checkin(ipsec->sas, sa);
+
+		for (j = i; j < i + group; j++)
+		{
+			if (results[j] != SUCCESS)
+			{
+				batch[j]->destroy(batch[j]);
+				continue;
+			}
+			route_inbound(this, batch[j], reqid);
+		}
+	}
 	return JOB_REQUEUE_DIRECT;
 }
 
@@ -185,64 +295,121 @@ static void send_outbound(private_ipsec_processor_t *this,
 /**
  * Processes outbound packets
  */
-static job_requeue_t process_outbound(private_ipsec_processor_t *this)
+static job_requeue_t process_outbound(queue_shard_t *shard)
 {
-	ipsec_policy_t *policy;
-	esp_packet_t *esp_packet;
-	ip_packet_t *packet;
+	private_ipsec_processor_t *this = shard->processor;
+	ip_packet_t *batch[ESP_PACKET_BATCH_MAX];
+	esp_packet_t *esp_batch[ESP_PACKET_BATCH_MAX];
+	ipsec_policy_t *policies[ESP_PACKET_BATCH_MAX];
+	status_t results[ESP_PACKET_BATCH_MAX];
 	ipsec_sa_t *sa;
 	host_t *src, *dst;
+	u_int count, group, i, j;
 
-	packet = (ip_packet_t*)this->outbound_queue->dequeue(this->outbound_queue);
+	count = drain_queue(shard->queue, (void**)batch);
 
-	policy = ipsec->policies->find_by_packet(ipsec->policies, packet, FALSE, 0);
-	if (!policy)
+	for (i = 0; i < count; i++)
 	{
-		DBG2(DBG_ESP, "no matching outbound IPsec policy for %H == %H",
-			 packet->get_source(packet), packet->get_destination(packet));
-		packet->destroy(packet);
-		return JOB_REQUEUE_DIRECT;
+		policies[i] = ipsec->policies->find_by_packet(ipsec->policies,
+													  batch[i], FALSE, 0);
+		if (!policies[i])
+		{
+			DBG2(DBG_ESP, "no matching outbound IPsec policy for %H == %H",
+				 batch[i]->get_source(batch[i]),
+				 batch[i]->get_destination(batch[i]));
+			batch[i]->destroy(batch[i]);
+			batch[i] = NULL;
+		}
 	}
 
-	sa = ipsec->sas->checkout_by_reqid(ipsec->sas, policy->get_reqid(policy),
-									   FALSE);
-	if (!sa)
-	{	/* TODO-IPSEC: send an acquire to uppper layer */
-		DBG1(DBG_ESP, "could not find an outbound IPsec SA for reqid {%u}, "
-			 "dropping packet", policy->get_reqid(policy));
-		packet->destroy(packet);
-		policy->destroy(policy);
-		return JOB_REQUEUE_DIRECT;
-	}
-	src = sa->get_source(sa);
-	dst = sa->get_destination(sa);
-	esp_packet = esp_packet_create_from_payload(src->clone(src),
-												dst->clone(dst), packet);
-	if (esp_packet->encrypt(esp_packet, sa->get_esp_context(sa),
-							sa->get_spi(sa)) != SUCCESS)
+	for (i = 0; i < count; i += group)
 	{
+		group = 1;
+		if (!batch[i])
+		{
+			continue;
+		}
+		/* batch consecutive packets of the same SA, so their AEAD operations
+		 * can be pipelined in a single call */
+		while (i + group < count && batch[i + group] &&
+			   policies[i + group]->get_reqid(policies[i + group]) ==
+										policies[i]->get_reqid(policies[i]))
+		{
+			group++;
+		}
+
+		sa = ipsec->sas->checkout_by_reqid(ipsec->sas,
+									policies[i]->get_reqid(policies[i]), FALSE);
+		if (!sa)
+		{	/* TODO-IPSEC: send an acquire to uppper layer */
+			DBG1(DBG_ESP, "could not find an outbound IPsec SA for reqid "
+				 "{%u}, dropping packet", policies[i]->get_reqid(policies[i]));
+			for (j = i; j < i + group; j++)
+			{
+				batch[j]->destroy(batch[j]);
+				policies[j]->destroy(policies[j]);
+			}
+			continue;
+		}
+		src = sa->get_source(sa);
+		dst = sa->get_destination(sa);
+		for (j = i; j < i + group; j++)
+		{
+			esp_batch[j] = esp_packet_create_from_payload(src->clone(src),
+													dst->clone(dst), batch[j]);
+		}
+		esp_packet_encrypt_batch(&esp_batch[i], &results[i], group,
+								 sa->get_esp_context(sa), sa->get_spi(sa));
+		for (j = i; j < i + group; j++)
+		{
+			if (results[j] == SUCCESS)
+			{
+				sa->update_usestats(sa,
+									batch[j]->get_encoding(batch[j]).len);
+			}
+		}
 		ipsec->sas->checkin(ipsec->sas, sa);
-		esp_packet->destroy(esp_packet);
-		policy->destroy(policy);
-		return JOB_REQUEUE_DIRECT;
+
+		for (j = i; j < i + group; j++)
+		{
+			policies[j]->destroy(policies[j]);
+			if (results[j] != SUCCESS)
+			{
+				esp_batch[j]->destroy(esp_batch[j]);
+				continue;
+			}
+			send_outbound(this, esp_batch[j]);
+		}
 	}
-	sa->update_usestats(sa, packet->get_encoding(packet).len);
-	ipsec->sas->checkin(ipsec->sas, sa);
-	policy->destroy(policy);
-	send_outbound(this, esp_packet);
 	return JOB_REQUEUE_DIRECT;
 }
 
 METHOD(ipsec_processor_t, queue_inbound, void,
 	private_ipsec_processor_t *this, esp_packet_t *packet)
 {
-	this->inbound_queue->enqueue(this->inbound_queue, packet);
+	blocking_queue_t *queue;
+	u_int32_t spi = 0;
+	chunk_t data;
+
+	data = packet->packet.get_data(&packet->packet);
+	if (data.len >= sizeof(spi))
+	{	/* shard by SPI, so each SA is processed by a single job and the
+		 * packet order within an SA is preserved */
+		spi = untoh32(data.ptr);
+	}
+	queue = this->inbound_queues[flow_hash(this, packet->get_source(packet),
+								packet->get_destination(packet), spi)].queue;
+	queue->enqueue(queue, packet);
 }
 
 METHOD(ipsec_processor_t, queue_outbound, void,
 	private_ipsec_processor_t *this, ip_packet_t *packet)
 {
-	this->outbound_queue->enqueue(this->outbound_queue, packet);
+	blocking_queue_t *queue;
+
+	queue = this->outbound_queues[flow_hash(this, packet->get_source(packet),
+									packet->get_destination(packet), 0)].queue;
+	queue->enqueue(queue, packet);
 }
 
 METHOD(ipsec_processor_t, register_inbound, void,
@@ -288,10 +455,19 @@ METHOD(ipsec_processor_t, unregister_outbound, void,
 METHOD(ipsec_processor_t, destroy, void,
 	private_ipsec_processor_t *this)
 {
-	this->inbound_queue->destroy_offset(this->inbound_queue,
+	u_int i;
+
+	for (i = 0; i < this->shards; i++)
+	{
+		this->inbound_queues[i].queue->destroy_offset(
+										this->inbound_queues[i].queue,
 										offsetof(esp_packet_t, destroy));
-	this->outbound_queue->destroy_offset(this->outbound_queue,
-										 offsetof(ip_packet_t, destroy));
+		this->outbound_queues[i].queue->destroy_offset(
+										this->outbound_queues[i].queue,
+										offsetof(ip_packet_t, destroy));
+	}
+	free(this->inbound_queues);
+	free(this->outbound_queues);
 	this->lock->destroy(this->lock);
 	free(this);
 }
@@ -302,6 +478,7 @@ METHOD(ipsec_processor_t, destroy, void,
 ipsec_processor_t *ipsec_processor_create()
 {
 	private_ipsec_processor_t *this;
+	u_int i;
 
 	INIT(this,
 		.public = {
@@ -313,16 +490,30 @@ ipsec_processor_t *ipsec_processor_create()
 			.unregister_outbound = _unregister_outbound,
 			.destroy = _destroy,
 		},
-		.inbound_queue = blocking_queue_create(),
-		.outbound_queue = blocking_queue_create(),
+		.shards = max(1, lib->settings->get_int(lib->settings,
+									"%s.plugins.kernel-libipsec.processors",
+									1, lib->ns)),
 		.lock = rwlock_create(RWLOCK_TYPE_DEFAULT),
 	);
 
-	lib->processor->queue_job(lib->processor,
-		(job_t*)callback_job_create((callback_job_cb_t)process_inbound, this,
-									NULL, (callback_job_cancel_t)return_false));
-	lib->processor->queue_job(lib->processor,
-		(job_t*)callback_job_create((callback_job_cb_t)process_outbound, this,
-									NULL, (callback_job_cancel_t)return_false));
+	this->inbound_queues = calloc(this->shards, sizeof(queue_shard_t));
+	this->outbound_queues = calloc(this->shards, sizeof(queue_shard_t));
+
+	for (i = 0; i < this->shards; i++)
+	{
+		this->inbound_queues[i].processor = this;
+		this->inbound_queues[i].queue = blocking_queue_create();
+		this->outbound_queues[i].processor = this;
+		this->outbound_queues[i].queue = blocking_queue_create();
+
+		lib->processor->queue_job(lib->processor,
+			(job_t*)callback_job_create((callback_job_cb_t)process_inbound,
+									&this->inbound_queues[i], NULL,
+									(callback_job_cancel_t)return_false));
+		lib->processor->queue_job(lib->processor,
+			(job_t*)callback_job_create((callback_job_cb_t)process_outbound,
+									&this->outbound_queues[i], NULL,
+									(callback_job_cancel_t)return_false));
+	}
 	return &this->public;
 }
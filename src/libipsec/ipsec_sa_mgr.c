@@ -28,6 +28,46 @@
 
 typedef struct private_ipsec_sa_mgr_t private_ipsec_sa_mgr_t;
 
+/**
+ * Key of an installed SA in the SAD hashtables
+ */
+typedef struct {
+
+	/**
+	 * SPI of the SA
+	 */
+	u_int32_t spi;
+
+	/**
+	 * Destination address of the SA (not cloned)
+	 */
+	host_t *dst;
+
+} sa_key_t;
+
+/**
+ * A segment of the SAD with its own lock, so inbound SPI lookups of
+ * independent SAs don't serialize on a single mutex
+ */
+typedef struct {
+
+	/**
+	 * Mutex protecting this segment and the condvars of its entries
+	 */
+	mutex_t *mutex;
+
+	/**
+	 * Installed SAs of this segment (ipsec_sa_entry_t*)
+	 */
+	linked_list_t *list;
+
+	/**
+	 * SAs of this segment indexed by (SPI, destination)
+	 */
+	hashtable_t *by_key;
+
+} sa_segment_t;
+
 /**
  * Private additions to ipsec_sa_mgr_t.
  */
@@ -39,9 +79,14 @@ struct private_ipsec_sa_mgr_t {
 	ipsec_sa_mgr_t public;
 
 	/**
-	 * Installed SAs
+	 * SAD segments, keyed by (SPI, destination)
+	 */
+	sa_segment_t *segments;
+
+	/**
+	 * Number of SAD segments
 	 */
-	linked_list_t *sas;
+	u_int segment_count;
 
 	/**
 	 * SPIs allocated using get_spi()
@@ -49,7 +94,7 @@ struct private_ipsec_sa_mgr_t {
 	hashtable_t *allocated_spis;
 
 	/**
-	 * Mutex used to synchronize access to the SA manager
+	 * Mutex used to synchronize SPI allocation
 	 */
 	mutex_t *mutex;
 
@@ -69,6 +114,11 @@ typedef struct {
 	 */
 	ipsec_sa_t *sa;
 
+	/**
+	 * Key of this entry in the SAD hashtable, derived from the SA
+	 */
+	sa_key_t key;
+
 	/**
 	 * Set if this SA is currently in use by a thread
 	 */
@@ -126,6 +176,35 @@ static u_int spi_hash(u_int32_t *spi)
 	return chunk_hash(chunk_from_thing(*spi));
 }
 
+/*
+ * Hash table functions for the SAD, keyed by (SPI, destination)
+ */
+static u_int sa_key_hash(sa_key_t *key)
+{
+	return chunk_hash_inc(key->dst->get_address(key->dst),
+						  chunk_hash(chunk_from_thing(key->spi)));
+}
+
+static bool sa_key_equals(sa_key_t *key, sa_key_t *other_key)
+{
+	return key->spi == other_key->spi &&
+		   key->dst->ip_equals(key->dst, other_key->dst);
+}
+
+/**
+ * Get the SAD segment responsible for the given SPI and destination
+ */
+static sa_segment_t *get_segment(private_ipsec_sa_mgr_t *this, u_int32_t spi,
+								 host_t *dst)
+{
+	sa_key_t key = {
+		.spi = spi,
+		.dst = dst,
+	};
+
+	return &this->segments[sa_key_hash(&key) % this->segment_count];
+}
+
 /**
  * Create an SA entry
  */
@@ -136,6 +215,10 @@ static ipsec_sa_entry_t *create_entry(ipsec_sa_t *sa)
 	INIT(this,
 		.condvar = condvar_create(CONDVAR_TYPE_DEFAULT),
 		.sa = sa,
+		.key = {
+			.spi = sa->get_spi(sa),
+			.dst = sa->get_destination(sa),
+		},
 	);
 	return this;
 }
@@ -152,13 +235,12 @@ static void destroy_entry(ipsec_sa_entry_t *entry)
 
 /**
  * Makes sure an entry is safe to remove
- * Must be called with this->mutex held.
+ * Must be called with the segment's mutex held.
  *
  * @return			TRUE if entry can be removed, FALSE if entry is already
 *					being removed by another thread
  */
-static bool wait_remove_entry(private_ipsec_sa_mgr_t *this,
-							  ipsec_sa_entry_t *entry)
+static bool wait_remove_entry(sa_segment_t *segment, ipsec_sa_entry_t *entry)
 {
 	if (entry->awaits_deletion)
 	{
@@ -168,27 +250,26 @@ static bool wait_remove_entry(private_ipsec_sa_mgr_t *this,
 	entry->awaits_deletion = TRUE;
 	while (entry->locked)
 	{
-		entry->condvar->wait(entry->condvar, this->mutex);
+		entry->condvar->wait(entry->condvar, segment->mutex);
 	}
 	while (entry->waiting_threads > 0)
 	{
 		entry->condvar->broadcast(entry->condvar);
-		entry->condvar->wait(entry->condvar, this->mutex);
+		entry->condvar->wait(entry->condvar, segment->mutex);
 	}
 	return TRUE;
 }
 
 /**
  * Waits until an is available and then locks it.
- * Must only be called with this->mutex held
+ * Must only be called with the segment's mutex held
  */
-static bool wait_for_entry(private_ipsec_sa_mgr_t *this,
-						   ipsec_sa_entry_t *entry)
+static bool wait_for_entry(sa_segment_t *segment, ipsec_sa_entry_t *entry)
 {
 	while (entry->locked && !entry->awaits_deletion)
 	{
 		entry->waiting_threads++;
-		entry->condvar->wait(entry->condvar, this->mutex);
+		entry->condvar->wait(entry->condvar, segment->mutex);
 		entry->waiting_threads--;
 	}
 	if (entry->awaits_deletion)
@@ -203,25 +284,34 @@ static bool wait_for_entry(private_ipsec_sa_mgr_t *this,
 
 /**
  * Flushes all entries
- * Must be called with this->mutex held.
+ * Must be called with no segment mutex held.
  */
 static void flush_entries(private_ipsec_sa_mgr_t *this)
 {
 	ipsec_sa_entry_t *current;
 	enumerator_t *enumerator;
+	sa_segment_t *segment;
+	u_int i;
 
 	DBG2(DBG_ESP, "flushing SAD");
 
-	enumerator = this->sas->create_enumerator(this->sas);
-	while (enumerator->enumerate(enumerator, (void**)&current))
+	for (i = 0; i < this->segment_count; i++)
 	{
-		if (wait_remove_entry(this, current))
+		segment = &this->segments[i];
+		segment->mutex->lock(segment->mutex);
+		enumerator = segment->list->create_enumerator(segment->list);
+		while (enumerator->enumerate(enumerator, (void**)&current))
 		{
-			this->sas->remove_at(this->sas, enumerator);
-			destroy_entry(current);
+			if (wait_remove_entry(segment, current))
+			{
+				segment->list->remove_at(segment->list, enumerator);
+				segment->by_key->remove(segment->by_key, &current->key);
+				destroy_entry(current);
+			}
 		}
+		enumerator->destroy(enumerator);
+		segment->mutex->unlock(segment->mutex);
 	}
-	enumerator->destroy(enumerator);
 }
 
 /*
@@ -256,64 +346,52 @@ static bool match_entry_by_reqid_inbound(ipsec_sa_entry_t *item,
 	return item->sa->match_by_reqid(item->sa, *reqid, *inbound);
 }
 
-static bool match_entry_by_spi_dst(ipsec_sa_entry_t *item, u_int32_t *spi,
-								   host_t *dst)
-{
-	return item->sa->match_by_spi_dst(item->sa, *spi, dst);
-}
-
-/**
- * Remove an entry
- */
-static bool remove_entry(private_ipsec_sa_mgr_t *this, ipsec_sa_entry_t *entry)
-{
-	ipsec_sa_entry_t *current;
-	enumerator_t *enumerator;
-	bool removed = FALSE;
-
-	enumerator = this->sas->create_enumerator(this->sas);
-	while (enumerator->enumerate(enumerator, (void**)&current))
-	{
-		if (current == entry)
-		{
-			if (wait_remove_entry(this, current))
-			{
-				this->sas->remove_at(this->sas, enumerator);
-				removed = TRUE;
-			}
-			break;
-		}
-	}
-	enumerator->destroy(enumerator);
-	return removed;
-}
-
 /**
  * Callback for expiration events
+ *
+ * The entry may have been removed and destroyed since the job was scheduled,
+ * so it is located by pointer before it is dereferenced.  this->mutex
+ * prevents concurrent segment changes of entries (update_sa), so scanning
+ * the segments one by one can't miss a moving entry.
  */
 static job_requeue_t sa_expired(ipsec_sa_expired_t *expired)
 {
 	private_ipsec_sa_mgr_t *this = expired->manager;
+	sa_segment_t *segment;
+	bool found = FALSE;
+	u_int i;
 
 	this->mutex->lock(this->mutex);
-	if (this->sas->find_first(this->sas, (void*)match_entry_by_ptr,
-							  NULL, expired->entry) == SUCCESS)
+	for (i = 0; i < this->segment_count && !found; i++)
 	{
-		u_int32_t hard_offset;
-
-		hard_offset = expired->hard_offset;
-		expired->entry->sa->expire(expired->entry->sa, hard_offset == 0);
-		if (hard_offset)
-		{	/* soft limit reached, schedule hard expire */
-			expired->hard_offset = 0;
-			this->mutex->unlock(this->mutex);
-			return JOB_RESCHEDULE(hard_offset);
-		}
-		/* hard limit reached */
-		if (remove_entry(this, expired->entry))
+		segment = &this->segments[i];
+		segment->mutex->lock(segment->mutex);
+		found = segment->list->find_first(segment->list,
+							(void*)match_entry_by_ptr,
+							NULL, expired->entry) == SUCCESS;
+		if (found)
 		{
-			destroy_entry(expired->entry);
+			u_int32_t hard_offset;
+
+			hard_offset = expired->hard_offset;
+			expired->entry->sa->expire(expired->entry->sa, hard_offset == 0);
+			if (hard_offset)
+			{	/* soft limit reached, schedule hard expire */
+				expired->hard_offset = 0;
+				segment->mutex->unlock(segment->mutex);
+				this->mutex->unlock(this->mutex);
+				return JOB_RESCHEDULE(hard_offset);
+			}
+			/* hard limit reached */
+			if (wait_remove_entry(segment, expired->entry))
+			{
+				segment->list->remove(segment->list, expired->entry, NULL);
+				segment->by_key->remove(segment->by_key,
+										&expired->entry->key);
+				destroy_entry(expired->entry);
+			}
 		}
+		segment->mutex->unlock(segment->mutex);
 	}
 	this->mutex->unlock(this->mutex);
 	return JOB_REQUEUE_NONE;
@@ -377,14 +455,29 @@ static void flush_allocated_spis(private_ipsec_sa_mgr_t *this)
 
 /**
  * Pre-allocate an SPI for an inbound SA
+ * Must be called with this->mutex held.
  */
 static bool allocate_spi(private_ipsec_sa_mgr_t *this, u_int32_t spi)
 {
 	u_int32_t *spi_alloc;
+	sa_segment_t *segment;
+	bool in_use = FALSE;
+	u_int i;
 
-	if (this->allocated_spis->get(this->allocated_spis, &spi) ||
-		this->sas->find_first(this->sas, (void*)match_entry_by_spi_inbound,
-							  NULL, &spi, TRUE) == SUCCESS)
+	if (this->allocated_spis->get(this->allocated_spis, &spi))
+	{
+		return FALSE;
+	}
+	for (i = 0; i < this->segment_count && !in_use; i++)
+	{
+		segment = &this->segments[i];
+		segment->mutex->lock(segment->mutex);
+		in_use = segment->list->find_first(segment->list,
+							(void*)match_entry_by_spi_inbound,
+							NULL, &spi, TRUE) == SUCCESS;
+		segment->mutex->unlock(segment->mutex);
+	}
+	if (in_use)
 	{
 		return FALSE;
 	}
@@ -444,6 +537,7 @@ METHOD(ipsec_sa_mgr_t, add_sa, status_t,
 {
 	ipsec_sa_entry_t *entry;
 	ipsec_sa_t *sa_new;
+	sa_segment_t *segment;
 
 	DBG2(DBG_ESP, "adding SAD entry with SPI %.8x and reqid {%u}",
 		 ntohl(spi), reqid);
@@ -461,20 +555,24 @@ METHOD(ipsec_sa_mgr_t, add_sa, status_t,
 		return FAILED;
 	}
 
-	this->mutex->lock(this->mutex);
-
 	if (update)
 	{	/* remove any pre-allocated SPIs */
 		u_int32_t *spi_alloc;
 
+		this->mutex->lock(this->mutex);
 		spi_alloc = this->allocated_spis->remove(this->allocated_spis, &spi);
+		this->mutex->unlock(this->mutex);
 		free(spi_alloc);
 	}
 
-	if (this->sas->find_first(this->sas, (void*)match_entry_by_spi_src_dst,
-							  NULL, &spi, src, dst) == SUCCESS)
+	segment = get_segment(this, spi, sa_new->get_destination(sa_new));
+	segment->mutex->lock(segment->mutex);
+
+	if (segment->list->find_first(segment->list,
+								  (void*)match_entry_by_spi_src_dst,
+								  NULL, &spi, src, dst) == SUCCESS)
 	{
-		this->mutex->unlock(this->mutex);
+		segment->mutex->unlock(segment->mutex);
 		DBG1(DBG_ESP, "failed to install SAD entry: already installed");
 		sa_new->destroy(sa_new);
 		return FAILED;
@@ -482,9 +580,10 @@ METHOD(ipsec_sa_mgr_t, add_sa, status_t,
 
 	entry = create_entry(sa_new);
 	schedule_expiration(this, entry);
-	this->sas->insert_last(this->sas, entry);
+	segment->list->insert_last(segment->list, entry);
+	segment->by_key->put(segment->by_key, &entry->key, entry);
 
-	this->mutex->unlock(this->mutex);
+	segment->mutex->unlock(segment->mutex);
 	return SUCCESS;
 }
 
@@ -494,6 +593,11 @@ METHOD(ipsec_sa_mgr_t, update_sa, status_t,
 	bool encap, bool new_encap, mark_t mark)
 {
 	ipsec_sa_entry_t *entry = NULL;
+	sa_segment_t *segment, *new_segment;
+	sa_key_t key = {
+		.spi = spi,
+		.dst = dst,
+	};
 
 	DBG2(DBG_ESP, "updating SAD entry with SPI %.8x from %#H..%#H to %#H..%#H",
 		 ntohl(spi), src, dst, new_src, new_dst);
@@ -505,16 +609,35 @@ METHOD(ipsec_sa_mgr_t, update_sa, status_t,
 		return NOT_SUPPORTED;
 	}
 
+	/* this->mutex serializes segment changes with the expiration jobs */
 	this->mutex->lock(this->mutex);
-	if (this->sas->find_first(this->sas, (void*)match_entry_by_spi_src_dst,
-							 (void**)&entry, &spi, src, dst) == SUCCESS &&
-		wait_for_entry(this, entry))
-	{
+	segment = get_segment(this, spi, dst);
+	segment->mutex->lock(segment->mutex);
+	entry = segment->by_key->get(segment->by_key, &key);
+	if (entry &&
+		entry->sa->match_by_spi_src_dst(entry->sa, spi, src, dst) &&
+		wait_remove_entry(segment, entry))
+	{	/* the destination defines the segment of the entry, so it is
+		 * drained like on removal and then re-inserted with the new key */
+		segment->list->remove(segment->list, entry, NULL);
+		segment->by_key->remove(segment->by_key, &entry->key);
+		segment->mutex->unlock(segment->mutex);
+
 		entry->sa->set_source(entry->sa, new_src);
 		entry->sa->set_destination(entry->sa, new_dst);
-		/* checkin the entry */
-		entry->locked = FALSE;
-		entry->condvar->signal(entry->condvar);
+		entry->key.dst = entry->sa->get_destination(entry->sa);
+		entry->awaits_deletion = FALSE;
+
+		new_segment = get_segment(this, entry->key.spi, entry->key.dst);
+		new_segment->mutex->lock(new_segment->mutex);
+		new_segment->list->insert_last(new_segment->list, entry);
+		new_segment->by_key->put(new_segment->by_key, &entry->key, entry);
+		new_segment->mutex->unlock(new_segment->mutex);
+	}
+	else
+	{
+		segment->mutex->unlock(segment->mutex);
+		entry = NULL;
 	}
 	this->mutex->unlock(this->mutex);
 
@@ -532,18 +655,29 @@ METHOD(ipsec_sa_mgr_t, query_sa, status_t,
 	u_int64_t *bytes, u_int64_t *packets, time_t *time)
 {
 	ipsec_sa_entry_t *entry = NULL;
-
-	this->mutex->lock(this->mutex);
-	if (this->sas->find_first(this->sas, (void*)match_entry_by_spi_src_dst,
-							 (void**)&entry, &spi, src, dst) == SUCCESS &&
-		wait_for_entry(this, entry))
+	sa_segment_t *segment;
+	sa_key_t key = {
+		.spi = spi,
+		.dst = dst,
+	};
+
+	segment = get_segment(this, spi, dst);
+	segment->mutex->lock(segment->mutex);
+	entry = segment->by_key->get(segment->by_key, &key);
+	if (entry &&
+		entry->sa->match_by_spi_src_dst(entry->sa, spi, src, dst) &&
+		wait_for_entry(segment, entry))
 	{
 		entry->sa->get_usestats(entry->sa, bytes, packets, time);
 		/* checkin the entry */
 		entry->locked = FALSE;
 		entry->condvar->signal(entry->condvar);
 	}
-	this->mutex->unlock(this->mutex);
+	else
+	{
+		entry = NULL;
+	}
+	segment->mutex->unlock(segment->mutex);
 
 	return entry ? SUCCESS : NOT_FOUND;
 }
@@ -552,25 +686,25 @@ METHOD(ipsec_sa_mgr_t, del_sa, status_t,
 	private_ipsec_sa_mgr_t *this, host_t *src, host_t *dst, u_int32_t spi,
 	u_int8_t protocol, u_int16_t cpi, mark_t mark)
 {
-	ipsec_sa_entry_t *current, *found = NULL;
-	enumerator_t *enumerator;
-
-	this->mutex->lock(this->mutex);
-	enumerator = this->sas->create_enumerator(this->sas);
-	while (enumerator->enumerate(enumerator, (void**)&current))
+	ipsec_sa_entry_t *entry, *found = NULL;
+	sa_segment_t *segment;
+	sa_key_t key = {
+		.spi = spi,
+		.dst = dst,
+	};
+
+	segment = get_segment(this, spi, dst);
+	segment->mutex->lock(segment->mutex);
+	entry = segment->by_key->get(segment->by_key, &key);
+	if (entry &&
+		entry->sa->match_by_spi_src_dst(entry->sa, spi, src, dst) &&
+		wait_remove_entry(segment, entry))
 	{
-		if (match_entry_by_spi_src_dst(current, &spi, src, dst))
-		{
-			if (wait_remove_entry(this, current))
-			{
-				this->sas->remove_at(this->sas, enumerator);
-				found = current;
-			}
-			break;
-		}
+		segment->list->remove(segment->list, entry, NULL);
+		segment->by_key->remove(segment->by_key, &entry->key);
+		found = entry;
 	}
-	enumerator->destroy(enumerator);
-	this->mutex->unlock(this->mutex);
+	segment->mutex->unlock(segment->mutex);
 
 	if (found)
 	{
@@ -586,16 +720,23 @@ METHOD(ipsec_sa_mgr_t, checkout_by_reqid, ipsec_sa_t*,
 	private_ipsec_sa_mgr_t *this, u_int32_t reqid, bool inbound)
 {
 	ipsec_sa_entry_t *entry;
+	sa_segment_t *segment;
 	ipsec_sa_t *sa = NULL;
+	u_int i;
 
-	this->mutex->lock(this->mutex);
-	if (this->sas->find_first(this->sas, (void*)match_entry_by_reqid_inbound,
-							 (void**)&entry, &reqid, &inbound) == SUCCESS &&
-		wait_for_entry(this, entry))
+	for (i = 0; i < this->segment_count && !sa; i++)
 	{
-		sa = entry->sa;
+		segment = &this->segments[i];
+		segment->mutex->lock(segment->mutex);
+		if (segment->list->find_first(segment->list,
+								(void*)match_entry_by_reqid_inbound,
+								(void**)&entry, &reqid, &inbound) == SUCCESS &&
+			wait_for_entry(segment, entry))
+		{
+			sa = entry->sa;
+		}
+		segment->mutex->unlock(segment->mutex);
 	}
-	this->mutex->unlock(this->mutex);
 	return sa;
 }
 
@@ -603,16 +744,22 @@ METHOD(ipsec_sa_mgr_t, checkout_by_spi, ipsec_sa_t*,
 	private_ipsec_sa_mgr_t *this, u_int32_t spi, host_t *dst)
 {
 	ipsec_sa_entry_t *entry;
+	sa_segment_t *segment;
 	ipsec_sa_t *sa = NULL;
-
-	this->mutex->lock(this->mutex);
-	if (this->sas->find_first(this->sas, (void*)match_entry_by_spi_dst,
-							 (void**)&entry, &spi, dst) == SUCCESS &&
-		wait_for_entry(this, entry))
+	sa_key_t key = {
+		.spi = spi,
+		.dst = dst,
+	};
+
+	segment = get_segment(this, spi, dst);
+	segment->mutex->lock(segment->mutex);
+	entry = segment->by_key->get(segment->by_key, &key);
+	if (entry &&
+		wait_for_entry(segment, entry))
 	{
 		sa = entry->sa;
 	}
-	this->mutex->unlock(this->mutex);
+	segment->mutex->unlock(segment->mutex);
 	return sa;
 }
 
@@ -620,10 +767,13 @@ METHOD(ipsec_sa_mgr_t, checkin, void,
 	private_ipsec_sa_mgr_t *this, ipsec_sa_t *sa)
 {
 	ipsec_sa_entry_t *entry;
+	sa_segment_t *segment;
 
-	this->mutex->lock(this->mutex);
-	if (this->sas->find_first(this->sas, (void*)match_entry_by_sa_ptr,
-							 (void**)&entry, sa) == SUCCESS)
+	/* the segment can't change while the SA is checked out by this thread */
+	segment = get_segment(this, sa->get_spi(sa), sa->get_destination(sa));
+	segment->mutex->lock(segment->mutex);
+	if (segment->list->find_first(segment->list, (void*)match_entry_by_sa_ptr,
+								 (void**)&entry, sa) == SUCCESS)
 	{
 		if (entry->locked)
 		{
@@ -631,28 +781,37 @@ METHOD(ipsec_sa_mgr_t, checkin, void,
 			entry->condvar->signal(entry->condvar);
 		}
 	}
-	this->mutex->unlock(this->mutex);
+	segment->mutex->unlock(segment->mutex);
 }
 
 METHOD(ipsec_sa_mgr_t, flush_sas, status_t,
 	private_ipsec_sa_mgr_t *this)
 {
-	this->mutex->lock(this->mutex);
 	flush_entries(this);
-	this->mutex->unlock(this->mutex);
 	return SUCCESS;
 }
 
 METHOD(ipsec_sa_mgr_t, destroy, void,
 	private_ipsec_sa_mgr_t *this)
 {
-	this->mutex->lock(this->mutex);
+	sa_segment_t *segment;
+	u_int i;
+
 	flush_entries(this);
+
+	this->mutex->lock(this->mutex);
 	flush_allocated_spis(this);
 	this->mutex->unlock(this->mutex);
 
 	this->allocated_spis->destroy(this->allocated_spis);
-	this->sas->destroy(this->sas);
+	for (i = 0; i < this->segment_count; i++)
+	{
+		segment = &this->segments[i];
+		segment->by_key->destroy(segment->by_key);
+		segment->list->destroy(segment->list);
+		segment->mutex->destroy(segment->mutex);
+	}
+	free(this->segments);
 
 	this->mutex->destroy(this->mutex);
 	DESTROY_IF(this->rng);
@@ -665,6 +824,8 @@ METHOD(ipsec_sa_mgr_t, destroy, void,
 ipsec_sa_mgr_t *ipsec_sa_mgr_create()
 {
 	private_ipsec_sa_mgr_t *this;
+	sa_segment_t *segment;
+	u_int i;
 
 	INIT(this,
 		.public = {
@@ -679,11 +840,22 @@ ipsec_sa_mgr_t *ipsec_sa_mgr_create()
 			.flush_sas = _flush_sas,
 			.destroy = _destroy,
 		},
-		.sas = linked_list_create(),
+		.segment_count = max(1, lib->settings->get_int(lib->settings,
+									"%s.plugins.kernel-libipsec.sad_segments",
+									8, lib->ns)),
 		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
 		.allocated_spis = hashtable_create((hashtable_hash_t)spi_hash,
 										   (hashtable_equals_t)spi_equals, 16),
 	);
 
+	this->segments = calloc(this->segment_count, sizeof(sa_segment_t));
+	for (i = 0; i < this->segment_count; i++)
+	{
+		segment = &this->segments[i];
+		segment->mutex = mutex_create(MUTEX_TYPE_DEFAULT);
+		segment->list = linked_list_create();
+		segment->by_key = hashtable_create((hashtable_hash_t)sa_key_hash,
+										   (hashtable_equals_t)sa_key_equals, 8);
+	}
 	return &this->public;
 }
@@ -90,15 +90,23 @@ static bio_reader_t* read_tls(tls_socket_t *tls, size_t len)
 bio_reader_t* pt_tls_read(tls_socket_t *tls, u_int32_t *vendor,
 						  u_int32_t *type, u_int32_t *identifier)
 {
+	char buf[PT_TLS_HEADER_LEN];
+	ssize_t got, total = 0;
 	bio_reader_t *reader;
 	u_int32_t len;
 	u_int8_t reserved;
 
-	reader = read_tls(tls, PT_TLS_HEADER_LEN);
-	if (!reader)
+	/* read the fixed size header to the stack, no allocation required */
+	while (total < sizeof(buf))
 	{
-		return NULL;
+		got = tls->read(tls, buf + total, sizeof(buf) - total, TRUE);
+		if (got <= 0)
+		{
+			return NULL;
+		}
+		total += got;
 	}
+	reader = bio_reader_create(chunk_from_thing(buf));
 	if (!reader->read_uint8(reader, &reserved) ||
 		!reader->read_uint24(reader, vendor) ||
 		!reader->read_uint32(reader, type) ||
@@ -132,17 +140,14 @@ bio_reader_t* pt_tls_read(tls_socket_t *tls, u_int32_t *vendor,
 }
 
 /**
- * Prepend a PT-TLS header to a writer, send data, destroy writer
+ * Append a PT-TLS message to a writer, see header
  */
-bool pt_tls_write(tls_socket_t *tls, pt_tls_message_type_t type,
+void pt_tls_build(bio_writer_t *writer, pt_tls_message_type_t type,
 				  u_int32_t identifier, chunk_t data)
 {
-	bio_writer_t *writer;
-	chunk_t out;
-	ssize_t len;
+	size_t len;
 
 	len = PT_TLS_HEADER_LEN + data.len;
-	writer = bio_writer_create(len);
 
 	/* write PT-TLS header */
 	writer->write_uint8 (writer, 0);
@@ -156,6 +161,15 @@ bool pt_tls_write(tls_socket_t *tls, pt_tls_message_type_t type,
 
 	DBG2(DBG_TNC, "sending PT-TLS message #%d of type '%N' (%d bytes)",
 				   identifier, pt_tls_message_type_names, type, len);
+}
+
+/**
+ * Write out a batch of PT-TLS messages, see header
+ */
+bool pt_tls_write_batch(tls_socket_t *tls, bio_writer_t *writer)
+{
+	chunk_t out;
+	ssize_t len;
 
 	out = writer->get_buf(writer);
 	len = tls->write(tls, out.ptr, out.len);
@@ -163,3 +177,16 @@ bool pt_tls_write(tls_socket_t *tls, pt_tls_message_type_t type,
 
 	return len == out.len;
 }
+
+/**
+ * Prepend a PT-TLS header to a writer, send data, destroy writer
+ */
+bool pt_tls_write(tls_socket_t *tls, pt_tls_message_type_t type,
+				  u_int32_t identifier, chunk_t data)
+{
+	bio_writer_t *writer;
+
+	writer = bio_writer_create(PT_TLS_HEADER_LEN + data.len);
+	pt_tls_build(writer, type, identifier, data);
+	return pt_tls_write_batch(tls, writer);
+}
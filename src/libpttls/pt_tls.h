@@ -120,6 +120,29 @@ bio_reader_t* pt_tls_read(tls_socket_t *tls, u_int32_t *vendor,
 bool pt_tls_write(tls_socket_t *tls, pt_tls_message_type_t type,
 				  u_int32_t identifier, chunk_t data);
 
+/**
+ * Append a PT-TLS message to a writer, for batched transmission.
+ *
+ * @param writer		writer to append header and value to
+ * @param type			Message Type to write
+ * @param identifier	Message Identifier to write
+ * @param data			Message value to write
+ */
+void pt_tls_build(bio_writer_t *writer, pt_tls_message_type_t type,
+				  u_int32_t identifier, chunk_t data);
+
+/**
+ * Send messages appended with pt_tls_build() at once, destroy writer.
+ *
+ * Coalescing consecutive messages into a single write keeps them in as few
+ * TLS records and TCP segments as possible.
+ *
+ * @param tls			TLS socket to write to
+ * @param writer		writer holding batched messages
+ * @return				TRUE if batch written successfully
+ */
+bool pt_tls_write_batch(tls_socket_t *tls, bio_writer_t *writer);
+
 /**
  * Dummy libpttls initialization function needed for integrity test
  */
@@ -62,8 +62,40 @@ struct private_pt_tls_server_t {
 	 */
 	tls_t *tnccs;
 
+	/**
+	 * Batch of messages not yet written out, if any
+	 */
+	bio_writer_t *batch;
 };
 
+/**
+ * Append a message to the pending write batch
+ */
+static void queue_batch(private_pt_tls_server_t *this,
+						pt_tls_message_type_t type, chunk_t data)
+{
+	if (!this->batch)
+	{
+		this->batch = bio_writer_create(PT_TLS_HEADER_LEN + data.len);
+	}
+	pt_tls_build(this->batch, type, this->identifier++, data);
+}
+
+/**
+ * Write out the pending batch in a single TLS write, if any
+ */
+static bool flush_batch(private_pt_tls_server_t *this)
+{
+	bool res = TRUE;
+
+	if (this->batch)
+	{
+		res = pt_tls_write_batch(this->tls, this->batch);
+		this->batch = NULL;
+	}
+	return res;
+}
+
 /**
  * Negotiate PT-TLS version
  */
@@ -73,7 +105,6 @@ static bool negotiate_version(private_pt_tls_server_t *this)
 	bio_writer_t *writer;
 	u_int32_t vendor, type, identifier;
 	u_int8_t reserved, vmin, vmax, vpref;
-	bool res;
 
 	reader = pt_tls_read(this->tls, &vendor, &type, &identifier);
 	if (!reader)
@@ -98,13 +129,13 @@ static bool negotiate_version(private_pt_tls_server_t *this)
 		return FALSE;
 	}
 
+	/* batched with the following message, usually the mechanism list */
 	writer = bio_writer_create(4);
 	writer->write_uint24(writer, 0);
 	writer->write_uint8(writer, PT_TLS_VERSION);
-	res = pt_tls_write(this->tls, PT_TLS_VERSION_RESPONSE,
-					   this->identifier++, writer->get_buf(writer));
+	queue_batch(this, PT_TLS_VERSION_RESPONSE, writer->get_buf(writer));
 	writer->destroy(writer);
-	return res;
+	return TRUE;
 }
 
 /**
@@ -116,7 +147,6 @@ static status_t process_sasl(private_pt_tls_server_t *this,
 	bio_writer_t *writer;
 	identification_t *client;
 	tnccs_t *tnccs;
-	bool res;
 
 	switch (sasl->process(sasl, data))
 	{
@@ -138,10 +168,9 @@ static status_t process_sasl(private_pt_tls_server_t *this,
 			}
 			writer = bio_writer_create(1);
 			writer->write_uint8(writer, PT_TLS_SASL_RESULT_SUCCESS);
-			res = pt_tls_write(this->tls, PT_TLS_SASL_RESULT,
-							   this->identifier++, writer->get_buf(writer));
+			queue_batch(this, PT_TLS_SASL_RESULT, writer->get_buf(writer));
 			writer->destroy(writer);
-			return res ? SUCCESS : FAILED;
+			return SUCCESS;
 		case FAILED:
 		default:
 			DBG1(DBG_TNC, "SASL %s authentication failed",
@@ -149,8 +178,8 @@ static status_t process_sasl(private_pt_tls_server_t *this,
 			writer = bio_writer_create(1);
 			/* sending abort does not allow the client to retry */
 			writer->write_uint8(writer, PT_TLS_SASL_RESULT_ABORT);
-			pt_tls_write(this->tls, PT_TLS_SASL_RESULT,
-						 this->identifier++, writer->get_buf(writer));
+			queue_batch(this, PT_TLS_SASL_RESULT, writer->get_buf(writer));
+			flush_batch(this);
 			return FAILED;
 	}
 }
@@ -166,6 +195,10 @@ static status_t read_sasl(private_pt_tls_server_t *this,
 	status_t status;
 	chunk_t data;
 
+	if (!flush_batch(this))
+	{
+		return FAILED;
+	}
 	reader = pt_tls_read(this->tls, &vendor, &type, &identifier);
 	if (!reader)
 	{
@@ -190,15 +223,13 @@ static status_t write_sasl(private_pt_tls_server_t *this,
 {
 	bio_writer_t *writer;
 	chunk_t chunk;
-	bool res;
 
 	switch (sasl->build(sasl, &chunk))
 	{
 		case NEED_MORE:
-			res = pt_tls_write(this->tls, PT_TLS_SASL_AUTH_DATA,
-							   this->identifier++, chunk);
+			queue_batch(this, PT_TLS_SASL_AUTH_DATA, chunk);
 			free(chunk.ptr);
-			return res ? NEED_MORE : FAILED;
+			return NEED_MORE;
 		case SUCCESS:
 			DBG1(DBG_TNC, "SASL %s authentication successful",
 				 sasl->get_name(sasl));
@@ -206,18 +237,17 @@ static status_t write_sasl(private_pt_tls_server_t *this,
 			writer->write_uint8(writer, PT_TLS_SASL_RESULT_SUCCESS);
 			writer->write_data(writer, chunk);
 			free(chunk.ptr);
-			res = pt_tls_write(this->tls, PT_TLS_SASL_RESULT,
-							   this->identifier++, writer->get_buf(writer));
+			queue_batch(this, PT_TLS_SASL_RESULT, writer->get_buf(writer));
 			writer->destroy(writer);
-			return res ? SUCCESS : FAILED;
+			return SUCCESS;
 		case FAILED:
 		default:
 			DBG1(DBG_TNC, "SASL %s authentication failed",
 				 sasl->get_name(sasl));
 			/* sending abort does not allow the client to retry */
 			chunk = chunk_from_chars(PT_TLS_SASL_RESULT_ABORT);
-			pt_tls_write(this->tls, PT_TLS_SASL_RESULT,
-						 this->identifier++, chunk);
+			queue_batch(this, PT_TLS_SASL_RESULT, chunk);
+			flush_batch(this);
 			return FAILED;
 	}
 }
@@ -230,7 +260,6 @@ static bool send_sasl_mechs(private_pt_tls_server_t *this)
 	enumerator_t *enumerator;
 	bio_writer_t *writer = NULL;
 	char *name;
-	bool res;
 
 	enumerator = sasl_mechanism_create_enumerator(TRUE);
 	while (enumerator->enumerate(enumerator, &name))
@@ -248,10 +277,9 @@ static bool send_sasl_mechs(private_pt_tls_server_t *this)
 	{	/* no mechanisms available? */
 		return FALSE;
 	}
-	res = pt_tls_write(this->tls, PT_TLS_SASL_MECHS,
-					   this->identifier++, writer->get_buf(writer));
+	queue_batch(this, PT_TLS_SASL_MECHS, writer->get_buf(writer));
 	writer->destroy(writer);
-	return res;
+	return TRUE;
 }
 
 /**
@@ -267,6 +295,11 @@ static status_t read_sasl_mech_selection(private_pt_tls_server_t *this,
 	u_int8_t len;
 	char buf[21];
 
+	/* flush version response and mechanism list in a single batch */
+	if (!flush_batch(this))
+	{
+		return FAILED;
+	}
 	reader = pt_tls_read(this->tls, &vendor, &type, &identifier);
 	if (!reader)
 	{
@@ -390,9 +423,10 @@ static bool authenticate(private_pt_tls_server_t *this)
 {
 	if (do_sasl(this))
 	{
-		/* complete SASL with emtpy mechanism list */
-		return pt_tls_write(this->tls, PT_TLS_SASL_MECHS, this->identifier++,
-							chunk_empty);
+		/* complete SASL with emtpy mechanism list, batched with a pending
+		 * SASL result or version response */
+		queue_batch(this, PT_TLS_SASL_MECHS, chunk_empty);
+		return flush_batch(this);
 	}
 	return FALSE;
 }
@@ -410,6 +444,10 @@ static status_t assess(private_pt_tls_server_t *this, tls_t *tnccs)
 	chunk_t data;
 	status_t status;
 
+	if (!flush_batch(this))
+	{
+		return FAILED;
+	}
 	reader = pt_tls_read(this->tls, &vendor, &type, &identifier);
 	if (!reader)
 	{
@@ -512,6 +550,7 @@ METHOD(pt_tls_server_t, get_fd, int,
 METHOD(pt_tls_server_t, destroy, void,
 	private_pt_tls_server_t *this)
 {
+	flush_batch(this);
 	this->tnccs->destroy(this->tnccs);
 	this->tls->destroy(this->tls);
 	free(this);
@@ -83,6 +83,8 @@ METHOD(radius_client_t, request, radius_message_t*,
 {
 	radius_socket_t *socket;
 	radius_message_t *res;
+	timeval_t start, end;
+	u_int ms;
 	chunk_t data;
 
 	/* add our NAS-Identifier */
@@ -97,9 +99,13 @@ METHOD(radius_client_t, request, radius_message_t*,
 	DBG1(DBG_CFG, "sending RADIUS %N to server '%s'", radius_message_code_names,
 		 req->get_code(req), this->config->get_name(this->config));
 
+	time_monotonic(&start);
 	res = socket->request(socket, req);
 	if (res)
 	{
+		time_monotonic(&end);
+		ms = (end.tv_sec - start.tv_sec) * 1000 +
+			 (end.tv_usec - start.tv_usec) / 1000;
 		DBG1(DBG_CFG, "received RADIUS %N from server '%s'",
 			 radius_message_code_names, res->get_code(res),
 			 this->config->get_name(this->config));
@@ -112,10 +118,10 @@ METHOD(radius_client_t, request, radius_message_t*,
 			chunk_clear(&this->msk);
 			this->msk = socket->decrypt_msk(socket, req, res);
 		}
-		this->config->put_socket(this->config, socket, TRUE);
+		this->config->put_socket(this->config, socket, TRUE, ms);
 		return res;
 	}
-	this->config->put_socket(this->config, socket, FALSE);
+	this->config->put_socket(this->config, socket, FALSE, 0);
 	return NULL;
 }
 
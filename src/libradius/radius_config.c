@@ -19,6 +19,16 @@
 #include <threading/condvar.h>
 #include <collections/linked_list.h>
 
+/**
+ * Initial quarantine after a failed exchange, in seconds
+ */
+#define QUARANTINE_MIN 15
+
+/**
+ * Upper limit for the quarantine backoff, in seconds
+ */
+#define QUARANTINE_MAX 300
+
 typedef struct private_radius_config_t private_radius_config_t;
 
 /**
@@ -76,6 +86,21 @@ struct private_radius_config_t {
 	 */
 	int retry;
 
+	/**
+	 * EWMA of the round trip time to this server, in milliseconds
+	 */
+	u_int ewma;
+
+	/**
+	 * Current quarantine backoff for this server, in seconds
+	 */
+	int quarantine;
+
+	/**
+	 * Monotonic time the quarantine expires, 0 if not quarantined
+	 */
+	time_t quarantine_until;
+
 	/**
 	 * reference count
 	 */
@@ -97,10 +122,25 @@ METHOD(radius_config_t, get_socket, radius_socket_t*,
 }
 
 METHOD(radius_config_t, put_socket, void,
-	private_radius_config_t *this, radius_socket_t *skt, bool result)
+	private_radius_config_t *this, radius_socket_t *skt, bool result, u_int ms)
 {
 	this->mutex->lock(this->mutex);
 	this->sockets->insert_last(this->sockets, skt);
+	if (result)
+	{
+		if (ms)
+		{	/* smooth round trip samples, weighting history 3:1 */
+			this->ewma = this->ewma ? (this->ewma * 3 + ms) / 4 : ms;
+		}
+		this->quarantine = 0;
+		this->quarantine_until = 0;
+	}
+	else
+	{	/* quarantine the server with growing backoff */
+		this->quarantine = this->quarantine ?
+					min(this->quarantine * 2, QUARANTINE_MAX) : QUARANTINE_MIN;
+		this->quarantine_until = time_monotonic(NULL) + this->quarantine;
+	}
 	this->mutex->unlock(this->mutex);
 	this->condvar->signal(this->condvar);
 	this->reachable = result;
@@ -125,10 +165,17 @@ METHOD(radius_config_t, get_preference, int,
 	pref = this->preference;
 	pref += this->sockets->get_count(this->sockets) * 100 / this->socket_count;
 	if (this->reachable)
-	{	/* reachable server get a boost: pref = 110-210 + boost */
+	{	/* reachable server get a boost: pref = 110-210 + boost, reduced by
+		 * up to 50 for servers responding slowly */
+		return pref + 110 - min(this->ewma / 20, 50);
+	}
+	if (this->quarantine_until &&
+		time_monotonic(NULL) >= this->quarantine_until)
+	{	/* quarantine expired, let a single request probe the server */
+		this->quarantine_until = time_monotonic(NULL) + this->quarantine;
 		return pref + 110;
 	}
-	/* Not reachable. Increase preference randomly to let it retry from
+	/* Quarantined. Increase preference randomly to let it retry from
 	 * time to time, especially if other servers have high load. */
 	this->retry++;
 	if (this->retry % 128 == 0)
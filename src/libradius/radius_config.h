@@ -40,10 +40,16 @@ struct radius_config_t {
 	/**
 	 * Release a socket to the pool after use.
 	 *
+	 * The round trip time of successful exchanges feeds an EWMA latency
+	 * estimate, failures quarantine the server with growing backoff; both
+	 * influence get_preference().
+	 *
 	 * @param skt		RADIUS socket to release
 	 * @param result	result of the socket use, TRUE for success
+	 * @param ms		round trip time in milliseconds, 0 if unknown
 	 */
-	void (*put_socket)(radius_config_t *this, radius_socket_t *skt, bool result);
+	void (*put_socket)(radius_config_t *this, radius_socket_t *skt, bool result,
+					   u_int ms);
 
 	/**
 	 * Get the NAS-Identifier to use with this server.
@@ -21,8 +21,52 @@
 
 #include <pen/pen.h>
 #include <utils/debug.h>
+#include <threading/mutex.h>
+#include <processing/jobs/callback_job.h>
 
 typedef struct private_radius_socket_t private_radius_socket_t;
+typedef struct entry_t entry_t;
+
+/**
+ * An outstanding asynchronous request
+ */
+struct entry_t {
+
+	/**
+	 * RADIUS Message identifier the request was sent with
+	 */
+	u_int8_t id;
+
+	/**
+	 * serial to detect identifier reuse in timeout jobs
+	 */
+	u_int32_t serial;
+
+	/**
+	 * associated request message, not owned
+	 */
+	radius_message_t *request;
+
+	/**
+	 * file descriptor the request was sent on
+	 */
+	int fd;
+
+	/**
+	 * completion callback
+	 */
+	radius_socket_cb_t cb;
+
+	/**
+	 * user data to pass to callback
+	 */
+	void *data;
+
+	/**
+	 * retransmission attempts so far
+	 */
+	int tries;
+};
 
 /**
  * Private data of an radius_socket_t object.
@@ -83,6 +127,31 @@ struct private_radius_socket_t {
 	 * RADIUS secret
 	 */
 	chunk_t secret;
+
+	/**
+	 * mutex protecting identifier and crypto state for async requests
+	 */
+	mutex_t *mutex;
+
+	/**
+	 * outstanding asynchronous requests, indexed by Message identifier
+	 */
+	entry_t *outstanding[256];
+
+	/**
+	 * serial counter for outstanding entries
+	 */
+	u_int32_t serial;
+
+	/**
+	 * TRUE while the authentication fd is registered with the watcher
+	 */
+	bool auth_watching;
+
+	/**
+	 * TRUE while the accounting fd is registered with the watcher
+	 */
+	bool acct_watching;
 };
 
 /**
@@ -222,6 +291,208 @@ METHOD(radius_socket_t, request, radius_message_t*,
 	return NULL;
 }
 
+/**
+ * Data passed to asynchronous timeout jobs
+ */
+typedef struct {
+	/** socket owning the outstanding request */
+	private_radius_socket_t *this;
+	/** Message identifier of the tracked request */
+	u_int8_t id;
+	/** serial of the tracked entry */
+	u_int32_t serial;
+} timeout_data_t;
+
+/**
+ * Watcher callback, dispatch a received response to its outstanding request
+ */
+CALLBACK(receive, bool,
+	private_radius_socket_t *this, int fd, watcher_event_t event)
+{
+	radius_message_t *response;
+	entry_t *entry;
+	char buf[4096];
+	int res;
+
+	res = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+	if (res <= 0)
+	{
+		if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+		{
+			DBG1(DBG_CFG, "receiving RADIUS message failed: %s",
+				 strerror(errno));
+		}
+		return TRUE;
+	}
+	response = radius_message_parse(chunk_create(buf, res));
+	if (!response)
+	{
+		DBG1(DBG_CFG, "received invalid RADIUS message, ignored");
+		return TRUE;
+	}
+	this->mutex->lock(this->mutex);
+	entry = this->outstanding[response->get_identifier(response)];
+	if (entry && entry->fd == fd &&
+		response->verify(response,
+						 entry->request->get_authenticator(entry->request),
+						 this->secret, this->hasher, this->signer))
+	{
+		this->outstanding[entry->id] = NULL;
+	}
+	else
+	{
+		entry = NULL;
+	}
+	this->mutex->unlock(this->mutex);
+
+	if (entry)
+	{
+		entry->cb(entry->data, response);
+		free(entry);
+	}
+	else
+	{
+		DBG1(DBG_CFG, "received invalid RADIUS message, ignored");
+		response->destroy(response);
+	}
+	return TRUE;
+}
+
+/**
+ * Retransmit an outstanding request, or time it out
+ */
+static job_requeue_t timeout_entry(timeout_data_t *data)
+{
+	private_radius_socket_t *this = data->this;
+	entry_t *entry;
+	chunk_t enc;
+
+	this->mutex->lock(this->mutex);
+	entry = this->outstanding[data->id];
+	if (!entry || entry->serial != data->serial)
+	{	/* request completed, identifier may be in use again */
+		this->mutex->unlock(this->mutex);
+		return JOB_REQUEUE_NONE;
+	}
+	/* timeout after 2, 3, 4, 5 seconds, as in the blocking mode */
+	if (++entry->tries <= 3)
+	{
+		DBG1(DBG_CFG, "retransmitting RADIUS %N (attempt %d)",
+			 radius_message_code_names,
+			 entry->request->get_code(entry->request), entry->tries);
+		enc = entry->request->get_encoding(entry->request);
+		if (send(entry->fd, enc.ptr, enc.len, 0) == enc.len)
+		{
+			int delay = 2 + entry->tries;
+
+			this->mutex->unlock(this->mutex);
+			return JOB_RESCHEDULE(delay);
+		}
+		DBG1(DBG_CFG, "sending RADIUS message failed: %s", strerror(errno));
+	}
+	else
+	{
+		DBG1(DBG_CFG, "RADIUS %N timed out after %d retransmits",
+			 radius_message_code_names,
+			 entry->request->get_code(entry->request), entry->tries - 1);
+	}
+	this->outstanding[data->id] = NULL;
+	this->mutex->unlock(this->mutex);
+
+	entry->cb(entry->data, NULL);
+	free(entry);
+	return JOB_REQUEUE_NONE;
+}
+
+METHOD(radius_socket_t, request_async, bool,
+	private_radius_socket_t *this, radius_message_t *request,
+	radius_socket_cb_t cb, void *data)
+{
+	timeout_data_t *timeout;
+	entry_t *entry;
+	chunk_t enc;
+	int i, *fd;
+	u_int16_t port;
+	bool *watching;
+	rng_t *rng = NULL;
+
+	if (request->get_code(request) == RMC_ACCOUNTING_REQUEST)
+	{
+		fd = &this->acct_fd;
+		port = this->acct_port;
+		watching = &this->acct_watching;
+	}
+	else
+	{
+		fd = &this->auth_fd;
+		port = this->auth_port;
+		watching = &this->auth_watching;
+		rng = this->rng;
+	}
+	if (!check_connection(this, fd, port))
+	{
+		return FALSE;
+	}
+
+	this->mutex->lock(this->mutex);
+	for (i = 0; i < countof(this->outstanding); i++)
+	{
+		if (!this->outstanding[this->identifier])
+		{
+			break;
+		}
+		this->identifier++;
+	}
+	if (i == countof(this->outstanding))
+	{
+		this->mutex->unlock(this->mutex);
+		DBG1(DBG_CFG, "all 256 RADIUS identifiers outstanding, dropping "
+			 "request");
+		return FALSE;
+	}
+	request->set_identifier(request, this->identifier++);
+	if (!request->sign(request, NULL, this->secret, this->hasher, this->signer,
+					   rng, rng != NULL))
+	{
+		this->mutex->unlock(this->mutex);
+		return FALSE;
+	}
+	INIT(entry,
+		.id = request->get_identifier(request),
+		.serial = ++this->serial,
+		.request = request,
+		.fd = *fd,
+		.cb = cb,
+		.data = data,
+	);
+	this->outstanding[entry->id] = entry;
+	if (!*watching)
+	{
+		lib->watcher->add(lib->watcher, *fd, WATCHER_READ, receive, this);
+		*watching = TRUE;
+	}
+	enc = request->get_encoding(request);
+	DBG3(DBG_CFG, "%B", &enc);
+	if (send(*fd, enc.ptr, enc.len, 0) != enc.len)
+	{
+		DBG1(DBG_CFG, "sending RADIUS message failed: %s", strerror(errno));
+		this->outstanding[entry->id] = NULL;
+		this->mutex->unlock(this->mutex);
+		free(entry);
+		return FALSE;
+	}
+	INIT(timeout,
+		.this = this,
+		.id = entry->id,
+		.serial = entry->serial,
+	);
+	lib->scheduler->schedule_job(lib->scheduler,
+			(job_t*)callback_job_create((callback_job_cb_t)timeout_entry,
+										timeout, free, NULL), 2);
+	this->mutex->unlock(this->mutex);
+	return TRUE;
+}
+
 /**
  * Decrypt a MS-MPPE-Send/Recv-Key
  */
@@ -284,6 +555,27 @@ METHOD(radius_socket_t, decrypt_msk, chunk_t,
 METHOD(radius_socket_t, destroy, void,
 	private_radius_socket_t *this)
 {
+	entry_t *entry;
+	int i;
+
+	if (this->auth_watching)
+	{
+		lib->watcher->remove(lib->watcher, this->auth_fd);
+	}
+	if (this->acct_watching)
+	{
+		lib->watcher->remove(lib->watcher, this->acct_fd);
+	}
+	for (i = 0; i < countof(this->outstanding); i++)
+	{
+		entry = this->outstanding[i];
+		if (entry)
+		{
+			this->outstanding[i] = NULL;
+			entry->cb(entry->data, NULL);
+			free(entry);
+		}
+	}
 	DESTROY_IF(this->hasher);
 	DESTROY_IF(this->signer);
 	DESTROY_IF(this->rng);
@@ -295,6 +587,7 @@ METHOD(radius_socket_t, destroy, void,
 	{
 		close(this->acct_fd);
 	}
+	this->mutex->destroy(this->mutex);
 	free(this);
 }
 
@@ -309,6 +602,7 @@ radius_socket_t *radius_socket_create(char *address, u_int16_t auth_port,
 	INIT(this,
 		.public = {
 			.request = _request,
+			.request_async = _request_async,
 			.decrypt_msk = _decrypt_msk,
 			.destroy = _destroy,
 		},
@@ -317,6 +611,7 @@ radius_socket_t *radius_socket_create(char *address, u_int16_t auth_port,
 		.auth_fd = -1,
 		.acct_port = acct_port,
 		.acct_fd = -1,
+		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
 		.hasher = lib->crypto->create_hasher(lib->crypto, HASH_MD5),
 		.signer = lib->crypto->create_signer(lib->crypto, AUTH_HMAC_MD5_128),
 		.rng = lib->crypto->create_rng(lib->crypto, RNG_WEAK),
@@ -27,6 +27,14 @@ typedef struct radius_socket_t radius_socket_t;
 
 #include <networking/host.h>
 
+/**
+ * Callback invoked when an asynchronous RADIUS exchange completes.
+ *
+ * @param data			user data passed to request_async()
+ * @param response		received response, gets owned, NULL if timed out
+ */
+typedef void (*radius_socket_cb_t)(void *data, radius_message_t *response);
+
 /**
  * RADIUS socket to a server.
  */
@@ -47,6 +55,24 @@ struct radius_socket_t {
 	radius_message_t* (*request)(radius_socket_t *this,
 								 radius_message_t *request);
 
+	/**
+	 * Send a RADIUS request, invoking a callback on completion.
+	 *
+	 * The request is signed and tracked by its Message identifier, so many
+	 * exchanges can be outstanding on the same socket concurrently without
+	 * blocking a thread; responses are picked up by the watcher. The request
+	 * message must stay alive until the callback has been invoked. A socket
+	 * used asynchronously must not be used with the blocking request()
+	 * method at the same time.
+	 *
+	 * @param request		request message
+	 * @param cb			callback to invoke with the response
+	 * @param data			user data to pass to the callback
+	 * @return				TRUE if request sent and callback scheduled
+	 */
+	bool (*request_async)(radius_socket_t *this, radius_message_t *request,
+						  radius_socket_cb_t cb, void *data);
+
 	/**
 	 * Decrypt the MSK encoded in a messages MS-MPPE-Send/Recv-Key.
 	 *
@@ -18,6 +18,9 @@
 #include "simaka_manager.h"
 
 #include <utils/debug.h>
+#include <collections/hashtable.h>
+#include <collections/linked_list.h>
+#include <threading/mutex.h>
 
 /** length of the k_encr key */
 #define KENCR_LEN 16
@@ -28,6 +31,131 @@
 /** length of the EMSK */
 #define EMSK_LEN 64
 
+/** maximum number of cached fast re-authentication key sets */
+#define REAUTH_CACHE_SIZE 64
+/** maximum number of pooled transform sets */
+#define TRANSFORM_POOL_SIZE 64
+
+/**
+ * K_encr/K_auth derived from a fast re-authentication master key
+ */
+typedef struct {
+	/** lookup key, pointing to mk */
+	chunk_t key;
+	/** master key the keys were derived from */
+	char mk[HASH_SIZE_SHA1];
+	/** derived encryption key */
+	char k_encr[KENCR_LEN];
+	/** derived authentication key */
+	char k_auth[KAUTH_LEN];
+} reauth_keys_t;
+
+/**
+ * Set of transforms ready for reuse by another exchange
+ */
+typedef struct {
+	/** random number generator */
+	rng_t *rng;
+	/** hasher used in key derivation */
+	hasher_t *hasher;
+	/** PRF used in key derivation */
+	prf_t *prf;
+	/** signer to create/verify AT_MAC */
+	signer_t *signer;
+	/** crypter to encrypt/decrypt AT_ENCR_DATA */
+	crypter_t *crypter;
+} transform_set_t;
+
+/**
+ * Lock for the shared state below, NULL if not initialized
+ */
+static mutex_t *mutex;
+
+/**
+ * Derived re-authentication keys, reauth_keys_t keyed by master key
+ */
+static hashtable_t *reauth_keys;
+
+/**
+ * Pool of unused transform sets
+ */
+static linked_list_t *transform_pool;
+
+/**
+ * Hashtable hash function for master keys
+ */
+static u_int mk_hash(chunk_t *key)
+{
+	return chunk_hash(*key);
+}
+
+/**
+ * Hashtable equals function for master keys
+ */
+static bool mk_equals(chunk_t *a, chunk_t *b)
+{
+	return chunk_equals(*a, *b);
+}
+
+/**
+ * Destroy the transforms of a pooled set
+ */
+static void transform_set_destroy(transform_set_t *set)
+{
+	DESTROY_IF(set->rng);
+	DESTROY_IF(set->hasher);
+	DESTROY_IF(set->prf);
+	DESTROY_IF(set->signer);
+	DESTROY_IF(set->crypter);
+	free(set);
+}
+
+/**
+ * Described in header.
+ */
+void simaka_crypto_init(void)
+{
+	mutex = mutex_create(MUTEX_TYPE_DEFAULT);
+	reauth_keys = hashtable_create((hashtable_hash_t)mk_hash,
+								   (hashtable_equals_t)mk_equals, 8);
+	transform_pool = linked_list_create();
+}
+
+/**
+ * Described in header.
+ */
+void simaka_crypto_deinit(void)
+{
+	enumerator_t *enumerator;
+	transform_set_t *set;
+	reauth_keys_t *keys;
+
+	if (!mutex)
+	{
+		return;
+	}
+	enumerator = reauth_keys->create_enumerator(reauth_keys);
+	while (enumerator->enumerate(enumerator, NULL, &keys))
+	{
+		memwipe(keys, sizeof(*keys));
+		free(keys);
+	}
+	enumerator->destroy(enumerator);
+	reauth_keys->destroy(reauth_keys);
+	reauth_keys = NULL;
+
+	while (transform_pool->remove_first(transform_pool,
+										(void**)&set) == SUCCESS)
+	{
+		transform_set_destroy(set);
+	}
+	transform_pool->destroy(transform_pool);
+	transform_pool = NULL;
+
+	mutex->destroy(mutex);
+	mutex = NULL;
+}
+
 typedef struct private_simaka_crypto_t private_simaka_crypto_t;
 
 /**
@@ -170,25 +298,50 @@ METHOD(simaka_crypto_t, derive_keys_full, bool,
 METHOD(simaka_crypto_t, derive_keys_reauth, bool,
 	private_simaka_crypto_t *this, chunk_t mk)
 {
+	char buf[KENCR_LEN + KAUTH_LEN];
 	chunk_t str, k_encr, k_auth;
+	reauth_keys_t *keys, *old;
+	enumerator_t *enumerator;
+	bool cached = FALSE;
 	int i;
 
-	/* K_encr | K_auth = prf() | prf() */
-	if (!this->prf->set_key(this->prf, mk))
+	if (mutex && mk.len == HASH_SIZE_SHA1)
+	{	/* the keys depend on the master key only, reuse them over
+		 * subsequent fast re-authentication exchanges */
+		mutex->lock(mutex);
+		keys = reauth_keys->get(reauth_keys, &mk);
+		if (keys)
+		{
+			memcpy(buf, keys->k_encr, KENCR_LEN);
+			memcpy(buf + KENCR_LEN, keys->k_auth, KAUTH_LEN);
+			cached = TRUE;
+		}
+		mutex->unlock(mutex);
+	}
+	if (cached)
 	{
-		return FALSE;
+		k_encr = chunk_create(buf, KENCR_LEN);
+		k_auth = chunk_create(buf + KENCR_LEN, KAUTH_LEN);
 	}
-	str = chunk_alloca(this->prf->get_block_size(this->prf) * 2);
-	for (i = 0; i < 2; i++)
+	else
 	{
-		if (!this->prf->get_bytes(this->prf, chunk_empty,
-								  str.ptr + str.len / 2 * i))
+		/* K_encr | K_auth = prf() | prf() */
+		if (!this->prf->set_key(this->prf, mk))
 		{
 			return FALSE;
 		}
+		str = chunk_alloca(this->prf->get_block_size(this->prf) * 2);
+		for (i = 0; i < 2; i++)
+		{
+			if (!this->prf->get_bytes(this->prf, chunk_empty,
+									  str.ptr + str.len / 2 * i))
+			{
+				return FALSE;
+			}
+		}
+		k_encr = chunk_create(str.ptr, KENCR_LEN);
+		k_auth = chunk_create(str.ptr + KENCR_LEN, KAUTH_LEN);
 	}
-	k_encr = chunk_create(str.ptr, KENCR_LEN);
-	k_auth = chunk_create(str.ptr + KENCR_LEN, KAUTH_LEN);
 	DBG3(DBG_LIB, "K_encr %B\nK_auth %B", &k_encr, &k_auth);
 
 	if (!this->signer->set_key(this->signer, k_auth) ||
@@ -197,6 +350,35 @@ METHOD(simaka_crypto_t, derive_keys_reauth, bool,
 		return FALSE;
 	}
 
+	if (!cached && mutex && mk.len == HASH_SIZE_SHA1)
+	{
+		keys = malloc_thing(reauth_keys_t);
+		memcpy(keys->mk, mk.ptr, HASH_SIZE_SHA1);
+		memcpy(keys->k_encr, k_encr.ptr, KENCR_LEN);
+		memcpy(keys->k_auth, k_auth.ptr, KAUTH_LEN);
+		keys->key = chunk_create(keys->mk, HASH_SIZE_SHA1);
+
+		mutex->lock(mutex);
+		if (reauth_keys->get_count(reauth_keys) >= REAUTH_CACHE_SIZE)
+		{	/* drop an arbitrary entry to keep the cache bounded */
+			enumerator = reauth_keys->create_enumerator(reauth_keys);
+			if (enumerator->enumerate(enumerator, NULL, &old))
+			{
+				reauth_keys->remove_at(reauth_keys, enumerator);
+				memwipe(old, sizeof(*old));
+				free(old);
+			}
+			enumerator->destroy(enumerator);
+		}
+		old = reauth_keys->put(reauth_keys, &keys->key, keys);
+		mutex->unlock(mutex);
+		if (old)
+		{
+			memwipe(old, sizeof(*old));
+			free(old);
+		}
+	}
+
 	call_hook(this, k_encr, k_auth);
 
 	this->derived = TRUE;
@@ -248,11 +430,38 @@ METHOD(simaka_crypto_t, clear_keys, void,
 METHOD(simaka_crypto_t, destroy, void,
 	private_simaka_crypto_t *this)
 {
-	DESTROY_IF(this->rng);
-	DESTROY_IF(this->hasher);
-	DESTROY_IF(this->prf);
-	DESTROY_IF(this->signer);
-	DESTROY_IF(this->crypter);
+	transform_set_t *set = NULL;
+
+	if (mutex && this->rng && this->hasher && this->prf &&
+		this->signer && this->crypter)
+	{	/* return the complete transform set to the pool for reuse */
+		INIT(set,
+			.rng = this->rng,
+			.hasher = this->hasher,
+			.prf = this->prf,
+			.signer = this->signer,
+			.crypter = this->crypter,
+		);
+		mutex->lock(mutex);
+		if (transform_pool->get_count(transform_pool) < TRANSFORM_POOL_SIZE)
+		{
+			transform_pool->insert_last(transform_pool, set);
+			set = NULL;
+		}
+		mutex->unlock(mutex);
+		if (set)
+		{	/* pool is full */
+			transform_set_destroy(set);
+		}
+	}
+	else
+	{
+		DESTROY_IF(this->rng);
+		DESTROY_IF(this->hasher);
+		DESTROY_IF(this->prf);
+		DESTROY_IF(this->signer);
+		DESTROY_IF(this->crypter);
+	}
 	free(this);
 }
 
@@ -262,6 +471,7 @@ METHOD(simaka_crypto_t, destroy, void,
 simaka_crypto_t *simaka_crypto_create(eap_type_t type)
 {
 	private_simaka_crypto_t *this;
+	transform_set_t *set = NULL;
 
 	INIT(this,
 		.public = {
@@ -275,12 +485,33 @@ simaka_crypto_t *simaka_crypto_create(eap_type_t type)
 			.destroy = _destroy,
 		},
 		.type = type,
-		.rng = lib->crypto->create_rng(lib->crypto, RNG_WEAK),
-		.hasher = lib->crypto->create_hasher(lib->crypto, HASH_SHA1),
-		.prf = lib->crypto->create_prf(lib->crypto, PRF_FIPS_SHA1_160),
-		.signer = lib->crypto->create_signer(lib->crypto, AUTH_HMAC_SHA1_128),
-		.crypter = lib->crypto->create_crypter(lib->crypto, ENCR_AES_CBC, 16),
 	);
+
+	if (mutex)
+	{
+		mutex->lock(mutex);
+		transform_pool->remove_first(transform_pool, (void**)&set);
+		mutex->unlock(mutex);
+	}
+	if (set)
+	{	/* reuse a pooled transform set, skipping the crypto factory */
+		this->rng = set->rng;
+		this->hasher = set->hasher;
+		this->prf = set->prf;
+		this->signer = set->signer;
+		this->crypter = set->crypter;
+		free(set);
+	}
+	else
+	{
+		this->rng = lib->crypto->create_rng(lib->crypto, RNG_WEAK);
+		this->hasher = lib->crypto->create_hasher(lib->crypto, HASH_SHA1);
+		this->prf = lib->crypto->create_prf(lib->crypto, PRF_FIPS_SHA1_160);
+		this->signer = lib->crypto->create_signer(lib->crypto,
+												  AUTH_HMAC_SHA1_128);
+		this->crypter = lib->crypto->create_crypter(lib->crypto,
+													ENCR_AES_CBC, 16);
+	}
 	if (!this->rng || !this->hasher || !this->prf ||
 		!this->signer || !this->crypter)
 	{
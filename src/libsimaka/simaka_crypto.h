@@ -111,4 +111,18 @@ struct simaka_crypto_t {
  */
 simaka_crypto_t *simaka_crypto_create();
 
+/**
+ * Initialize the shared re-authentication key cache and transform pool.
+ *
+ * Called by libsimaka_init().
+ */
+void simaka_crypto_init(void);
+
+/**
+ * Free the shared re-authentication key cache and transform pool.
+ *
+ * Called by libsimaka_deinit().
+ */
+void simaka_crypto_deinit(void);
+
 #endif /** SIMAKA_CRYPTO_H_ @}*/
@@ -14,6 +14,7 @@
  */
 
 #include "simaka_manager.h"
+#include "simaka_crypto.h"
 
 #include <utils/debug.h>
 #include <collections/linked_list.h>
@@ -52,12 +53,31 @@ struct private_simaka_manager_t {
 	rwlock_t *lock;
 };
 
+/**
+ * Use counter for the shared crypto state
+ */
+static refcount_t libsimaka_users;
+
 /**
  * Described in header.
  */
 void libsimaka_init(void)
 {
-	/* empty */
+	if (ref_get(&libsimaka_users) == 1)
+	{
+		simaka_crypto_init();
+	}
+}
+
+/**
+ * Described in header.
+ */
+void libsimaka_deinit(void)
+{
+	if (ref_put(&libsimaka_users))
+	{
+		simaka_crypto_deinit();
+	}
 }
 
 METHOD(simaka_manager_t, add_card, void,
@@ -312,8 +312,16 @@ bool simaka_manager_register(plugin_t *plugin, plugin_feature_t *feature,
  * @addtogroup libsimaka
  * @{
  *
- * Dummy libsimaka initialization function needed for integrity test
+ * Initialize libsimaka, creating the shared re-authentication key cache
+ * and transform pool on first use.
+ *
+ * Each call must be matched by a call to libsimaka_deinit().
  */
 void libsimaka_init(void);
 
+/**
+ * Deinitialize libsimaka, releasing the shared crypto state on last use.
+ */
+void libsimaka_deinit(void);
+
 #endif /** SIMAKA_MANAGER_H_ @}*/
@@ -56,12 +56,74 @@ chunk_t asn1_algorithmIdentifier(int oid)
 	return asn1_wrap(ASN1_SEQUENCE, "mm", asn1_build_known_oid(oid), parameters);
 }
 
+/**
+ * 32 bit FNV-1a hash over an encoded OID, matching the hash used by oid.pl
+ * to generate oid_hash_table
+ */
+static u_int hash_oid(chunk_t object)
+{
+	u_int hash = 0x811c9dc5;
+	int i;
+
+	for (i = 0; i < object.len; i++)
+	{
+		hash ^= object.ptr[i];
+		hash *= 0x01000193;
+	}
+	return hash;
+}
+
+/**
+ * Check if object is exactly the encoded OID leading to oid_names[n],
+ * comparing backwards along the tree levels as asn1_build_known_oid() does
+ */
+static bool oid_matches(int n, chunk_t object)
+{
+	int i = oid_names[n].level + 1;
+
+	if (object.len != i)
+	{
+		return FALSE;
+	}
+	do
+	{
+		if (oid_names[n].level >= i)
+		{
+			n--;
+			continue;
+		}
+		if (object.ptr[--i] != oid_names[n--].octet)
+		{
+			return FALSE;
+		}
+	}
+	while (i > 0);
+
+	return TRUE;
+}
+
 /*
  * Defined in header.
  */
 int asn1_known_oid(chunk_t object)
 {
 	int oid = 0;
+	u_int hash, slot;
+
+	/* fast path for exact matches, which covers all known OIDs. The tree
+	 * walk below additionally matches object identifiers extending a known
+	 * terminal symbol, so fall through on a miss. */
+	hash = hash_oid(object);
+	slot = hash & OID_HASH_MASK;
+	while (oid_hash_table[slot].oid != OID_UNKNOWN)
+	{
+		if (oid_hash_table[slot].hash == hash &&
+			oid_matches(oid_hash_table[slot].oid, object))
+		{
+			return oid_hash_table[slot].oid;
+		}
+		slot = (slot + 1) & OID_HASH_MASK;
+	}
 
 	while (object.len)
 	{
@@ -43,6 +43,13 @@ print OID_H "/* Object identifiers (OIDs) used by strongSwan\n",
 	    "\n",
             "extern const oid_t oid_names[];\n",
 	    "\n",
+	    "typedef struct {\n",
+	    "    u_int  hash;\n",
+	    "    int    oid;\n",
+	    "} oid_hash_t;\n",
+	    "\n",
+            "extern const oid_hash_t oid_hash_table[];\n",
+	    "\n",
 	    "#define OID_UNKNOWN							-1\n";
 
 # parse oid.txt
@@ -77,7 +84,44 @@ while ($line = <SRC>)
     $counter++;
 }
 
+# build a hash table over the encoded OIDs for fast exact-match lookups
+
+$hash_size = 1;
+while ($hash_size < 2 * $counter)
+{
+    $hash_size *= 2;
+}
+$hash_mask = $hash_size - 1;
+
+@tbl_hash = (0) x $hash_size;
+@tbl_oid = (-1) x $hash_size;
+
+for ($c = 0; $c < $counter; $c++)
+{
+    # track the encoded OID leading to this entry
+    @path[@order[$c] / 2] = hex(@octet[$c]);
+
+    # 32 bit FNV-1a over the encoded OID, with the multiplication split
+    # to stay within perl's integer precision
+    $hash = 0x811c9dc5;
+    for ($d = 0; $d <= @order[$c] / 2; $d++)
+    {
+	$hash = $hash ^ @path[$d];
+	$hash = (($hash * 0x193) + (($hash & 0xff) * 0x1000000)) % 4294967296;
+    }
+
+    # insert with linear probing
+    $slot = $hash & $hash_mask;
+    while (@tbl_oid[$slot] != -1)
+    {
+	$slot = ($slot + 1) & $hash_mask;
+    }
+    @tbl_hash[$slot] = $hash;
+    @tbl_oid[$slot] = $c;
+}
+
 printf OID_H "\n#define OID_MAX%s%d\n", "\t" x 8, $counter;
+printf OID_H "\n#define OID_HASH_MASK%s0x%03x\n", "\t" x 6, $hash_mask;
 
 print OID_H "\n#endif /* OID_H_ */\n";
 
@@ -128,5 +172,17 @@ for ($c = 0; $c < $counter; $c++)
 	, $c;
 }
 
+print OID_C "};\n",
+	    "\n",
+            "const oid_hash_t oid_hash_table[] = {\n";
+
+for ($c = 0; $c < $hash_size; $c++)
+{
+    printf OID_C " {0x%08x, %3d}%s\n"
+	, @tbl_hash[$c]
+	, @tbl_oid[$c]
+	, $c != $hash_size-1 ? "," : " ";
+}
+
 print OID_C "};\n" ;
 close OID_C;
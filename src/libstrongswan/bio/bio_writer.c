@@ -41,26 +41,43 @@ struct private_bio_writer_t {
 	size_t used;
 
 	/**
-	 * Number of bytes to increase buffer size
+	 * Number of bytes to increase buffer size, at least
 	 */
 	size_t increase;
+
+	/**
+	 * TRUE if the buffer is allocated by us, FALSE for caller provided storage
+	 */
+	bool ours;
 };
 
 /**
- * Increase buffer size, if required
+ * Increase buffer size, if required. Grows geometrically to keep the number
+ * of reallocations logarithmic, and spills caller provided storage to heap.
  */
 static inline void increase(private_bio_writer_t *this, size_t required)
 {
-	bool inc = FALSE;
+	size_t newlen = this->buf.len;
+	u_char *buf;
 
-	while (this->used + required > this->buf.len)
+	while (this->used + required > newlen)
 	{
-		this->buf.len += this->increase;
-		inc = TRUE;
+		newlen = max(newlen * 2, this->increase);
 	}
-	if (inc)
+	if (newlen != this->buf.len)
 	{
-		this->buf.ptr = realloc(this->buf.ptr, this->buf.len);
+		if (this->ours)
+		{
+			this->buf.ptr = realloc(this->buf.ptr, newlen);
+		}
+		else
+		{
+			buf = malloc(newlen);
+			memcpy(buf, this->buf.ptr, this->used);
+			this->buf.ptr = buf;
+			this->ours = TRUE;
+		}
+		this->buf.len = newlen;
 	}
 }
 
@@ -196,6 +213,19 @@ METHOD(bio_writer_t, skip, chunk_t,
 	return skipped;
 }
 
+METHOD(bio_writer_t, reserve, u_char*,
+	private_bio_writer_t *this, size_t len)
+{
+	increase(this, len);
+	return this->buf.ptr + this->used;
+}
+
+METHOD(bio_writer_t, commit, void,
+	private_bio_writer_t *this, size_t len)
+{
+	this->used += len;
+}
+
 METHOD(bio_writer_t, get_buf, chunk_t,
 	private_bio_writer_t *this)
 {
@@ -206,6 +236,12 @@ METHOD(bio_writer_t, extract_buf, chunk_t,
 	private_bio_writer_t *this)
 {
 	chunk_t buf = get_buf(this);
+
+	if (!this->ours)
+	{	/* still writing to caller provided storage, which we can't hand out */
+		buf = chunk_clone(buf);
+		this->ours = TRUE;
+	}
 	this->buf = chunk_empty;
 	this->used = 0;
 	return buf;
@@ -214,7 +250,10 @@ METHOD(bio_writer_t, extract_buf, chunk_t,
 METHOD(bio_writer_t, destroy, void,
 	private_bio_writer_t *this)
 {
-	free(this->buf.ptr);
+	if (this->ours)
+	{
+		free(this->buf.ptr);
+	}
 	free(this);
 }
 
@@ -242,11 +281,14 @@ bio_writer_t *bio_writer_create(u_int32_t bufsize)
 			.wrap24 = _wrap24,
 			.wrap32 = _wrap32,
 			.skip = _skip,
+			.reserve = _reserve,
+			.commit = _commit,
 			.get_buf = _get_buf,
 			.extract_buf = _extract_buf,
 			.destroy = _destroy,
 		},
 		.increase = bufsize ? max(bufsize, 4) : 32,
+		.ours = TRUE,
 	);
 	if (bufsize)
 	{
@@ -255,3 +297,18 @@ bio_writer_t *bio_writer_create(u_int32_t bufsize)
 
 	return &this->public;
 }
+
+/**
+ * See header
+ */
+bio_writer_t *bio_writer_create_on(chunk_t buf)
+{
+	private_bio_writer_t *this;
+
+	this = (private_bio_writer_t*)bio_writer_create(0);
+	this->buf = buf;
+	this->increase = max(buf.len, 32);
+	this->ours = FALSE;
+
+	return &this->public;
+}
@@ -137,6 +137,28 @@ struct bio_writer_t {
 	 */
 	chunk_t (*skip)(bio_writer_t *this, size_t len);
 
+	/**
+	 * Reserve space for len bytes at the end of the buffer, without
+	 * advancing the write position.
+	 *
+	 * The returned pointer allows direct bulk writes, the data becomes part
+	 * of the buffer only once committed with commit(). Like skip(), the
+	 * pointer is not valid after calling any other writer function, as the
+	 * buffer might get reallocated.
+	 *
+	 * @param len		number of bytes to reserve
+	 * @return			pointer to reserved bytes in the internal buffer
+	 */
+	u_char* (*reserve)(bio_writer_t *this, size_t len);
+
+	/**
+	 * Commit bytes previously reserved with reserve(), advancing the write
+	 * position.
+	 *
+	 * @param len		number of bytes to commit, at most as reserved
+	 */
+	void (*commit)(bio_writer_t *this, size_t len);
+
 	/**
 	 * Get the encoded data buffer.
 	 *
@@ -168,4 +190,15 @@ struct bio_writer_t {
  */
 bio_writer_t *bio_writer_create(u_int32_t bufsize);
 
+/**
+ * Create a bio_writer instance writing to caller provided storage.
+ *
+ * Data is written to the given buffer, usually on the stack, and spills over
+ * to an allocated buffer only if it grows beyond it. extract_buf() returns an
+ * allocated copy while the data still fits the provided storage.
+ *
+ * @param buf			storage to write to
+ */
+bio_writer_t *bio_writer_create_on(chunk_t buf);
+
 #endif /** BIO_WRITER_H_ @}*/
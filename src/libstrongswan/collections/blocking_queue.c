@@ -20,6 +20,7 @@
 #include <threading/mutex.h>
 #include <threading/thread.h>
 #include <threading/condvar.h>
+#include <threading/semaphore.h>
 #include <collections/linked_list.h>
 
 typedef struct private_blocking_queue_t private_blocking_queue_t;
@@ -81,6 +82,17 @@ METHOD(blocking_queue_t, dequeue, void*,
 	return item;
 }
 
+METHOD(blocking_queue_t, try_dequeue, bool,
+	private_blocking_queue_t *this, void **item)
+{
+	bool gotten;
+
+	this->mutex->lock(this->mutex);
+	gotten = this->list->remove_last(this->list, item) == SUCCESS;
+	this->mutex->unlock(this->mutex);
+	return gotten;
+}
+
 METHOD(blocking_queue_t, destroy, void,
 	private_blocking_queue_t *this)
 {
@@ -104,6 +116,181 @@ METHOD(blocking_queue_t, destroy_function, void,
 	destroy(this);
 }
 
+typedef struct private_bounded_queue_t private_bounded_queue_t;
+
+/**
+ * Private data of the bounded variant, a lock-free MPMC ring buffer
+ */
+struct private_bounded_queue_t {
+
+	/**
+	 * Public part
+	 */
+	blocking_queue_t public;
+
+	/**
+	 * Ring of queued items, NULL for empty slots
+	 */
+	void **ring;
+
+	/**
+	 * Size of the ring minus one, to mask tickets to slots
+	 */
+	u_int mask;
+
+	/**
+	 * Enqueue ticket counter, atomically incremented
+	 */
+	refcount_t tail;
+
+	/**
+	 * Dequeue ticket counter, atomically incremented
+	 */
+	refcount_t head;
+
+	/**
+	 * Semaphore counting queued items, blocks consumers on an empty queue
+	 */
+	semaphore_t *items;
+
+	/**
+	 * Semaphore counting free slots, blocks producers on a full queue
+	 */
+	semaphore_t *space;
+};
+
+METHOD(blocking_queue_t, bounded_enqueue, void,
+	private_bounded_queue_t *this, void *item)
+{
+	u_int ticket;
+
+	this->space->wait(this->space);
+	ticket = ref_get(&this->tail) - 1;
+	/* the semaphore guarantees a free slot overall, but the consumer of the
+	 * previous round may not have cleared ours yet, so spin briefly */
+	while (!cas_ptr(&this->ring[ticket & this->mask], NULL, item))
+	{
+		/* spin */
+	}
+	this->items->post(this->items);
+}
+
+/**
+ * Claim a queued item, after its availability has been established by
+ * waiting on the item semaphore
+ */
+static void *claim_item(private_bounded_queue_t *this)
+{
+	u_int ticket;
+	void *item;
+
+	ticket = ref_get(&this->head) - 1;
+	do
+	{	/* wait until the producer assigned to our slot stored its item */
+		item = this->ring[ticket & this->mask];
+	}
+	while (!item || !cas_ptr(&this->ring[ticket & this->mask], item, NULL));
+	this->space->post(this->space);
+	return item;
+}
+
+METHOD(blocking_queue_t, bounded_dequeue, void*,
+	private_bounded_queue_t *this)
+{
+	bool oldstate;
+
+	/* ensure that a canceled thread does not dequeue any items */
+	thread_cancellation_point();
+	oldstate = thread_cancelability(TRUE);
+	this->items->wait(this->items);
+	thread_cancelability(oldstate);
+
+	return claim_item(this);
+}
+
+METHOD(blocking_queue_t, bounded_try_dequeue, bool,
+	private_bounded_queue_t *this, void **item)
+{
+	if (this->items->timed_wait(this->items, 0))
+	{	/* timed out, no items queued */
+		return FALSE;
+	}
+	*item = claim_item(this);
+	return TRUE;
+}
+
+METHOD(blocking_queue_t, bounded_destroy, void,
+	private_bounded_queue_t *this)
+{
+	this->items->destroy(this->items);
+	this->space->destroy(this->space);
+	free(this->ring);
+	free(this);
+}
+
+METHOD(blocking_queue_t, bounded_destroy_offset, void,
+	private_bounded_queue_t *this, size_t offset)
+{
+	linked_list_invoke_t *method;
+	u_int i;
+
+	for (i = 0; i <= this->mask; i++)
+	{
+		if (this->ring[i])
+		{
+			method = this->ring[i] + offset;
+			(*method)(this->ring[i]);
+		}
+	}
+	bounded_destroy(this);
+}
+
+METHOD(blocking_queue_t, bounded_destroy_function, void,
+	private_bounded_queue_t *this, void (*fn)(void*))
+{
+	u_int i;
+
+	for (i = 0; i <= this->mask; i++)
+	{
+		if (this->ring[i])
+		{
+			fn(this->ring[i]);
+		}
+	}
+	bounded_destroy(this);
+}
+
+/*
+ * Described in header.
+ */
+blocking_queue_t *blocking_queue_create_bounded(u_int size)
+{
+	private_bounded_queue_t *this;
+	u_int rounded = 1;
+
+	while (rounded < size)
+	{
+		rounded <<= 1;
+	}
+
+	INIT(this,
+		.public = {
+			.enqueue = _bounded_enqueue,
+			.dequeue = _bounded_dequeue,
+			.try_dequeue = _bounded_try_dequeue,
+			.destroy = _bounded_destroy,
+			.destroy_offset = _bounded_destroy_offset,
+			.destroy_function = _bounded_destroy_function,
+		},
+		.ring = calloc(rounded, sizeof(void*)),
+		.mask = rounded - 1,
+		.items = semaphore_create(0),
+		.space = semaphore_create(rounded),
+	);
+
+	return &this->public;
+}
+
 /*
  * Described in header.
  */
@@ -115,6 +302,7 @@ blocking_queue_t *blocking_queue_create()
 		.public = {
 			.enqueue = _enqueue,
 			.dequeue = _dequeue,
+			.try_dequeue = _try_dequeue,
 			.destroy = _destroy,
 			.destroy_offset = _destroy_offset,
 			.destroy_function = _destroy_function,
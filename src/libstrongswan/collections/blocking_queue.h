@@ -49,6 +49,14 @@ struct blocking_queue_t {
 	 */
 	void *(*dequeue)(blocking_queue_t *this);
 
+	/**
+	 * Removes the first item in the queue, if one is currently queued.
+	 *
+	 * @param item		removed item, if any
+	 * @return			TRUE if an item was dequeued
+	 */
+	bool (*try_dequeue)(blocking_queue_t *this, void **item);
+
 	/**
 	 * Destroys a blocking_queue_t object.
 	 *
@@ -93,5 +101,19 @@ struct blocking_queue_t {
  */
 blocking_queue_t *blocking_queue_create();
 
+/**
+ * Creates a bounded queue backed by a lock-free ring buffer.
+ *
+ * Enqueue and dequeue claim a slot with an atomic ticket and exchange the
+ * item with a compare-and-swap instead of taking a mutex; blocking is
+ * implemented with semaphores. In contrast to blocking_queue_create(),
+ * enqueue() blocks while the queue is full, and NULL can not be queued
+ * as item.
+ *
+ * @param size		maximum number of items, rounded up to a power of two
+ * @return			blocking_queue_t object.
+ */
+blocking_queue_t *blocking_queue_create_bounded(u_int size);
+
 #endif /** BLOCKING_QUEUE_H_ @}*/
 
@@ -409,28 +409,9 @@ enumerator_t* enumerator_create_token(const char *string, const char *sep,
 }
 
 /**
- * enumerator for nested enumerations
+ * Implementation of enumerator_create/init_nested().enumerate()
  */
-typedef struct {
-	/* implements enumerator_t */
-	enumerator_t public;
-	/* outer enumerator */
-	enumerator_t *outer;
-	/* inner enumerator */
-	enumerator_t *inner;
-	/* constructor for inner enumerator */
-	enumerator_t *(*create_inner)(void *outer, void *data);
-	/* data to pass to constructor above */
-	void *data;
-	/* destructor for data */
-	void (*destroy_data)(void *data);
-} nested_enumerator_t;
-
-
-/**
- * Implementation of enumerator_create_nested().enumerate()
- */
-static bool enumerate_nested(nested_enumerator_t *this, void *v1, void *v2,
+static bool enumerate_nested(enumerator_nested_t *this, void *v1, void *v2,
 							 void *v3, void *v4, void *v5)
 {
 	while (TRUE)
@@ -455,9 +436,10 @@ static bool enumerate_nested(nested_enumerator_t *this, void *v1, void *v2,
 }
 
 /**
- * Implementation of enumerator_create_nested().destroy()
+ * Implementation of enumerator_init_nested().destroy(), does not free the
+ * caller-provided storage
  **/
-static void destroy_nested(nested_enumerator_t *this)
+static void deinit_nested(enumerator_nested_t *this)
 {
 	if (this->destroy_data)
 	{
@@ -465,57 +447,78 @@ static void destroy_nested(nested_enumerator_t *this)
 	}
 	DESTROY_IF(this->inner);
 	this->outer->destroy(this->outer);
+}
+
+/**
+ * Implementation of enumerator_create_nested().destroy()
+ **/
+static void destroy_nested(enumerator_nested_t *this)
+{
+	deinit_nested(this);
 	free(this);
 }
 
 /**
  * See header
  */
-enumerator_t *enumerator_create_nested(enumerator_t *outer,
+enumerator_t *enumerator_init_nested(enumerator_nested_t *storage,
+					enumerator_t *outer,
 					enumerator_t *(inner_constructor)(void *outer, void *data),
 					void *data, void (*destroy_data)(void *data))
 {
-	nested_enumerator_t *enumerator = malloc_thing(nested_enumerator_t);
-
-	enumerator->public.enumerate = (void*)enumerate_nested;
-	enumerator->public.destroy = (void*)destroy_nested;
-	enumerator->outer = outer;
-	enumerator->inner = NULL;
-	enumerator->create_inner = (void*)inner_constructor;
-	enumerator->data = data;
-	enumerator->destroy_data = destroy_data;
-
-	return &enumerator->public;
+	storage->enumerator.enumerate = (void*)enumerate_nested;
+	storage->enumerator.destroy = (void*)deinit_nested;
+	storage->outer = outer;
+	storage->inner = NULL;
+	storage->create_inner = (void*)inner_constructor;
+	storage->data = data;
+	storage->destroy_data = destroy_data;
+
+	return &storage->enumerator;
 }
 
 /**
- * enumerator for filtered enumerator
+ * See header
  */
-typedef struct {
-	enumerator_t public;
-	enumerator_t *unfiltered;
-	void *data;
-	bool (*filter)(void *data, ...);
-	void (*destructor)(void *data);
-} filter_enumerator_t;
+enumerator_t *enumerator_create_nested(enumerator_t *outer,
+					enumerator_t *(inner_constructor)(void *outer, void *data),
+					void *data, void (*destroy_data)(void *data))
+{
+	enumerator_nested_t *enumerator = malloc_thing(enumerator_nested_t);
+
+	enumerator_init_nested(enumerator, outer, inner_constructor, data,
+						   destroy_data);
+	enumerator->enumerator.destroy = (void*)destroy_nested;
+
+	return &enumerator->enumerator;
+}
 
 /**
- * Implementation of enumerator_create_filter().destroy
+ * Implementation of enumerator_init_filter().destroy, does not free the
+ * caller-provided storage
  */
-static void destroy_filter(filter_enumerator_t *this)
+static void deinit_filter(enumerator_filter_t *this)
 {
 	if (this->destructor)
 	{
 		this->destructor(this->data);
 	}
 	this->unfiltered->destroy(this->unfiltered);
+}
+
+/**
+ * Implementation of enumerator_create_filter().destroy
+ */
+static void destroy_filter(enumerator_filter_t *this)
+{
+	deinit_filter(this);
 	free(this);
 }
 
 /**
- * Implementation of enumerator_create_filter().enumerate
+ * Implementation of enumerator_create/init_filter().enumerate
  */
-static bool enumerate_filter(filter_enumerator_t *this, void *o1, void *o2,
+static bool enumerate_filter(enumerator_filter_t *this, void *o1, void *o2,
 							 void *o3, void *o4, void *o5)
 {
 	void *i1, *i2, *i3, *i4, *i5;
@@ -530,6 +533,24 @@ static bool enumerate_filter(filter_enumerator_t *this, void *o1, void *o2,
 	return FALSE;
 }
 
+/**
+ * see header
+ */
+enumerator_t *enumerator_init_filter(enumerator_filter_t *storage,
+									 enumerator_t *unfiltered,
+									 bool (*filter)(void *data, ...),
+									 void *data, void (*destroy_data)(void *data))
+{
+	storage->enumerator.enumerate = (void*)enumerate_filter;
+	storage->enumerator.destroy = (void*)deinit_filter;
+	storage->unfiltered = unfiltered;
+	storage->filter = filter;
+	storage->data = data;
+	storage->destructor = destroy_data;
+
+	return &storage->enumerator;
+}
+
 /**
  * see header
  */
@@ -537,16 +558,12 @@ enumerator_t *enumerator_create_filter(enumerator_t *unfiltered,
 									   bool (*filter)(void *data, ...),
 									   void *data, void (*destructor)(void *data))
 {
-	filter_enumerator_t *this = malloc_thing(filter_enumerator_t);
+	enumerator_filter_t *this = malloc_thing(enumerator_filter_t);
 
-	this->public.enumerate = (void*)enumerate_filter;
-	this->public.destroy = (void*)destroy_filter;
-	this->unfiltered = unfiltered;
-	this->filter = filter;
-	this->data = data;
-	this->destructor = destructor;
+	enumerator_init_filter(this, unfiltered, filter, data, destructor);
+	this->enumerator.destroy = (void*)destroy_filter;
 
-	return &this->public;
+	return &this->enumerator;
 }
 
 /**
@@ -159,6 +159,49 @@ enumerator_t *enumerator_create_nested(enumerator_t *outer,
 					enumerator_t *(*inner_constructor)(void *outer, void *data),
 					void *data, void (*destroy_data)(void *data));
 
+typedef struct enumerator_nested_t enumerator_nested_t;
+
+/**
+ * Storage for a nested enumerator set up with enumerator_init_nested().
+ *
+ * All members are private, the struct is usually allocated on the stack of
+ * the function driving the enumeration.
+ */
+struct enumerator_nested_t {
+	/** public enumerator interface, as returned by enumerator_init_nested() */
+	enumerator_t enumerator;
+	/** outer enumerator */
+	enumerator_t *outer;
+	/** inner enumerator */
+	enumerator_t *inner;
+	/** constructor for inner enumerator */
+	enumerator_t *(*create_inner)(void *outer, void *data);
+	/** data to pass to constructor above */
+	void *data;
+	/** destructor for data */
+	void (*destroy_data)(void *data);
+};
+
+/**
+ * Set up a nested enumerator in caller-provided storage.
+ *
+ * Behaves like enumerator_create_nested(), but initializes the given
+ * storage instead of allocating the wrapper, avoiding a malloc per
+ * composition on hot paths.  destroy() of the returned enumerator cleans
+ * up the outer and inner enumerators, but does not free the storage.
+ *
+ * @param storage			storage for the enumerator, usually stack allocated
+ * @param outer				outer enumerator
+ * @param inner_constructor	constructor to inner enumerator
+ * @param data				data to pass to each inner_constructor call
+ * @param destroy_data		destructor to pass to data
+ * @return					enumerator set up within storage
+ */
+enumerator_t *enumerator_init_nested(enumerator_nested_t *storage,
+					enumerator_t *outer,
+					enumerator_t *(*inner_constructor)(void *outer, void *data),
+					void *data, void (*destroy_data)(void *data));
+
 /**
  * Creates an enumerator which filters output of another enumerator.
  *
@@ -180,6 +223,47 @@ enumerator_t *enumerator_create_filter(enumerator_t *unfiltered,
 					bool (*filter)(void *data, ...),
 					void *data, void (*destructor)(void *data));
 
+typedef struct enumerator_filter_t enumerator_filter_t;
+
+/**
+ * Storage for a filter enumerator set up with enumerator_init_filter().
+ *
+ * All members are private, the struct is usually allocated on the stack of
+ * the function driving the enumeration.
+ */
+struct enumerator_filter_t {
+	/** public enumerator interface, as returned by enumerator_init_filter() */
+	enumerator_t enumerator;
+	/** unfiltered enumerator */
+	enumerator_t *unfiltered;
+	/** filter function */
+	bool (*filter)(void *data, ...);
+	/** data to pass to filter function */
+	void *data;
+	/** destructor for data */
+	void (*destructor)(void *data);
+};
+
+/**
+ * Set up a filter enumerator in caller-provided storage.
+ *
+ * Behaves like enumerator_create_filter(), but initializes the given
+ * storage instead of allocating the wrapper.  destroy() of the returned
+ * enumerator cleans up the wrapped enumerator, but does not free the
+ * storage.
+ *
+ * @param storage			storage for the enumerator, usually stack allocated
+ * @param unfiltered		unfiltered enumerator to wrap
+ * @param filter			filter function
+ * @param data				user data to supply to filter
+ * @param destroy_data		function to call on destroy with data
+ * @return					enumerator set up within storage
+ */
+enumerator_t *enumerator_init_filter(enumerator_filter_t *storage,
+					enumerator_t *unfiltered,
+					bool (*filter)(void *data, ...),
+					void *data, void (*destroy_data)(void *data));
+
 /**
  * Create an enumerator wrapper which does a cleanup on destroy.
  *
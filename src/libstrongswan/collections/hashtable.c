@@ -463,6 +463,464 @@ METHOD(hashtable_t, destroy_function, void,
 	destroy_internal(this, fn);
 }
 
+typedef struct flat_slot_t flat_slot_t;
+
+/**
+ * Slot of an open addressing table, empty if key is NULL.
+ */
+struct flat_slot_t {
+	/**
+	 * Key of a hash table item.
+	 */
+	const void *key;
+
+	/**
+	 * Value of a hash table item.
+	 */
+	void *value;
+
+	/**
+	 * Cached hash of the key.
+	 */
+	u_int hash;
+
+	/**
+	 * Insertion sequence number of the item.  Displacement and rehashing
+	 * may reorder equal-hash items in a probe cluster, so get_match() uses
+	 * the age to return the first-inserted match, as the chained table does.
+	 */
+	u_int64_t age;
+};
+
+typedef struct private_flat_hashtable_t private_flat_hashtable_t;
+
+/**
+ * Private data of the open addressing (Robin Hood) hash table variant.
+ */
+struct private_flat_hashtable_t {
+	/**
+	 * Public part of hash table.
+	 */
+	hashtable_t public;
+
+	/**
+	 * The number of items in the hash table.
+	 */
+	u_int count;
+
+	/**
+	 * The current capacity of the hash table (always a power of 2).
+	 */
+	u_int capacity;
+
+	/**
+	 * The current mask to calculate the row index (capacity - 1).
+	 */
+	u_int mask;
+
+	/**
+	 * The load factor.
+	 */
+	float load_factor;
+
+	/**
+	 * The flat slot array.
+	 */
+	flat_slot_t *slots;
+
+	/**
+	 * Insertion sequence number assigned to the next new item.
+	 */
+	u_int64_t next_age;
+
+	/**
+	 * The hashing function.
+	 */
+	hashtable_hash_t hash;
+
+	/**
+	 * The equality function.
+	 */
+	hashtable_equals_t equals;
+};
+
+typedef struct private_flat_enumerator_t private_flat_enumerator_t;
+
+/**
+ * open addressing hash table enumerator implementation
+ */
+struct private_flat_enumerator_t {
+
+	/**
+	 * implements enumerator interface
+	 */
+	enumerator_t enumerator;
+
+	/**
+	 * associated hash table
+	 */
+	private_flat_hashtable_t *table;
+
+	/**
+	 * next row to examine
+	 */
+	u_int row;
+
+	/**
+	 * row of the last enumerated item (used by remove_at), -1 if none
+	 */
+	int current;
+};
+
+/**
+ * Probe distance of an item hashing to the given row when stored in the
+ * slot at the given row.
+ */
+static inline u_int flat_distance(private_flat_hashtable_t *this, u_int row,
+								  u_int hash)
+{
+	return (row - hash) & this->mask;
+}
+
+/**
+ * Insert an item into the slot array, displacing items that probed from a
+ * nearer row on the way (Robin Hood).  The key must not exist yet.
+ */
+static void flat_insert(private_flat_hashtable_t *this, const void *key,
+						void *value, u_int hash, u_int64_t age)
+{
+	flat_slot_t *slot, displaced;
+	u_int row, dist = 0;
+
+	row = hash & this->mask;
+	while (TRUE)
+	{
+		slot = &this->slots[row];
+		if (!slot->key)
+		{
+			slot->key = key;
+			slot->value = value;
+			slot->hash = hash;
+			slot->age = age;
+			return;
+		}
+		if (flat_distance(this, row, slot->hash) < dist)
+		{	/* the occupant is closer to its row than we are to ours, let it
+			 * make way and find a new slot for it further down instead */
+			displaced = *slot;
+			slot->key = key;
+			slot->value = value;
+			slot->hash = hash;
+			slot->age = age;
+			key = displaced.key;
+			value = displaced.value;
+			hash = displaced.hash;
+			age = displaced.age;
+			dist = flat_distance(this, row, hash);
+		}
+		row = (row + 1) & this->mask;
+		dist++;
+	}
+}
+
+/**
+ * Double the size of the flat table and reinsert all items.
+ */
+static void flat_rehash(private_flat_hashtable_t *this)
+{
+	flat_slot_t *old_slots;
+	u_int row, old_capacity;
+
+	if (this->capacity >= MAX_CAPACITY)
+	{
+		return;
+	}
+
+	old_capacity = this->capacity;
+	old_slots = this->slots;
+
+	this->capacity = old_capacity << 1;
+	this->mask = this->capacity - 1;
+	this->slots = calloc(this->capacity, sizeof(flat_slot_t));
+
+	for (row = 0; row < old_capacity; row++)
+	{
+		if (old_slots[row].key)
+		{
+			flat_insert(this, old_slots[row].key, old_slots[row].value,
+						old_slots[row].hash, old_slots[row].age);
+		}
+	}
+	free(old_slots);
+}
+
+/**
+ * Find the row of the given key.  The probe may stop early once it passes
+ * slots the key would have displaced on insertion.
+ */
+static bool flat_find(private_flat_hashtable_t *this, const void *key,
+					  u_int hash, u_int *row_out)
+{
+	flat_slot_t *slot;
+	u_int row, dist = 0;
+
+	row = hash & this->mask;
+	while (TRUE)
+	{
+		slot = &this->slots[row];
+		if (!slot->key || flat_distance(this, row, slot->hash) < dist)
+		{
+			return FALSE;
+		}
+		if (slot->hash == hash && this->equals(key, slot->key))
+		{
+			*row_out = row;
+			return TRUE;
+		}
+		row = (row + 1) & this->mask;
+		dist++;
+	}
+}
+
+/**
+ * Remove the item in the given row, backward-shifting the following
+ * cluster so that no tombstone is left behind.
+ */
+static void *flat_remove_row(private_flat_hashtable_t *this, u_int row)
+{
+	flat_slot_t *slot, *next_slot;
+	void *value;
+	u_int next;
+
+	slot = &this->slots[row];
+	value = slot->value;
+	while (TRUE)
+	{
+		next = (row + 1) & this->mask;
+		next_slot = &this->slots[next];
+		if (!next_slot->key || flat_distance(this, next, next_slot->hash) == 0)
+		{
+			break;
+		}
+		*slot = *next_slot;
+		slot = next_slot;
+		row = next;
+	}
+	slot->key = NULL;
+	slot->value = NULL;
+	this->count--;
+	return value;
+}
+
+METHOD(hashtable_t, flat_put, void*,
+	private_flat_hashtable_t *this, const void *key, void *value)
+{
+	void *old_value = NULL;
+	u_int hash, row;
+
+	hash = this->hash(key);
+	if (flat_find(this, key, hash, &row))
+	{
+		old_value = this->slots[row].value;
+		this->slots[row].value = value;
+		this->slots[row].key = key;
+	}
+	else
+	{
+		flat_insert(this, key, value, hash, this->next_age++);
+		this->count++;
+		if (this->count >= this->capacity * this->load_factor)
+		{
+			flat_rehash(this);
+		}
+	}
+	return old_value;
+}
+
+METHOD(hashtable_t, flat_get, void*,
+	private_flat_hashtable_t *this, const void *key)
+{
+	u_int row;
+
+	if (this->count &&
+		flat_find(this, key, this->hash(key), &row))
+	{
+		return this->slots[row].value;
+	}
+	return NULL;
+}
+
+METHOD(hashtable_t, flat_get_match, void*,
+	private_flat_hashtable_t *this, const void *key, hashtable_equals_t match)
+{
+	flat_slot_t *slot, *found = NULL;
+	u_int hash, row, dist = 0;
+
+	if (!this->count)
+	{
+		return NULL;
+	}
+	/* a match may not be unique, and equal-hash items may get reordered in
+	 * the probe cluster, so scan the whole cluster for the oldest match */
+	hash = this->hash(key);
+	row = hash & this->mask;
+	while (TRUE)
+	{
+		slot = &this->slots[row];
+		if (!slot->key || flat_distance(this, row, slot->hash) < dist)
+		{
+			break;
+		}
+		if (slot->hash == hash && match(key, slot->key) &&
+			(!found || slot->age < found->age))
+		{
+			found = slot;
+		}
+		row = (row + 1) & this->mask;
+		dist++;
+	}
+	return found ? found->value : NULL;
+}
+
+METHOD(hashtable_t, flat_remove_, void*,
+	private_flat_hashtable_t *this, const void *key)
+{
+	u_int row;
+
+	if (this->count &&
+		flat_find(this, key, this->hash(key), &row))
+	{
+		return flat_remove_row(this, row);
+	}
+	return NULL;
+}
+
+METHOD(hashtable_t, flat_remove_at, void,
+	private_flat_hashtable_t *this, private_flat_enumerator_t *enumerator)
+{
+	if (enumerator->table == this && enumerator->current != -1)
+	{
+		flat_remove_row(this, enumerator->current);
+		/* the backward shift may have moved an unseen item into the removed
+		 * row, have another look at it */
+		enumerator->row = enumerator->current;
+		enumerator->current = -1;
+	}
+}
+
+METHOD(hashtable_t, flat_get_count, u_int,
+	private_flat_hashtable_t *this)
+{
+	return this->count;
+}
+
+METHOD(enumerator_t, flat_enumerate, bool,
+	private_flat_enumerator_t *this, const void **key, void **value)
+{
+	flat_slot_t *slot;
+
+	while (this->row < this->table->capacity)
+	{
+		slot = &this->table->slots[this->row];
+		if (slot->key)
+		{
+			if (key)
+			{
+				*key = slot->key;
+			}
+			if (value)
+			{
+				*value = slot->value;
+			}
+			this->current = this->row++;
+			return TRUE;
+		}
+		this->row++;
+	}
+	return FALSE;
+}
+
+METHOD(hashtable_t, flat_create_enumerator, enumerator_t*,
+	private_flat_hashtable_t *this)
+{
+	private_flat_enumerator_t *enumerator;
+
+	INIT(enumerator,
+		.enumerator = {
+			.enumerate = (void*)_flat_enumerate,
+			.destroy = (void*)free,
+		},
+		.table = this,
+		.current = -1,
+	);
+
+	return &enumerator->enumerator;
+}
+
+static void flat_destroy_internal(private_flat_hashtable_t *this,
+								  void (*fn)(void*,const void*))
+{
+	u_int row;
+
+	if (fn)
+	{
+		for (row = 0; row < this->capacity; row++)
+		{
+			if (this->slots[row].key)
+			{
+				fn(this->slots[row].value, this->slots[row].key);
+			}
+		}
+	}
+	free(this->slots);
+	free(this);
+}
+
+METHOD(hashtable_t, flat_destroy, void,
+	private_flat_hashtable_t *this)
+{
+	flat_destroy_internal(this, NULL);
+}
+
+METHOD(hashtable_t, flat_destroy_function, void,
+	private_flat_hashtable_t *this, void (*fn)(void*,const void*))
+{
+	flat_destroy_internal(this, fn);
+}
+
+/*
+ * Described in header.
+ */
+hashtable_t *hashtable_create_flat(hashtable_hash_t hash,
+								   hashtable_equals_t equals, u_int capacity)
+{
+	private_flat_hashtable_t *this;
+
+	INIT(this,
+		.public = {
+			.put = _flat_put,
+			.get = _flat_get,
+			.get_match = _flat_get_match,
+			.remove = _flat_remove_,
+			.remove_at = (void*)_flat_remove_at,
+			.get_count = _flat_get_count,
+			.create_enumerator = _flat_create_enumerator,
+			.destroy = _flat_destroy,
+			.destroy_function = _flat_destroy_function,
+		},
+		.hash = hash,
+		.equals = equals,
+	);
+
+	capacity = max(1, min(capacity, MAX_CAPACITY));
+	this->capacity = get_nearest_powerof2(capacity);
+	this->mask = this->capacity - 1;
+	this->load_factor = 0.75;
+	this->slots = calloc(this->capacity, sizeof(flat_slot_t));
+
+	return &this->public;
+}
+
 /*
  * Described in header.
  */
@@ -178,4 +178,21 @@ struct hashtable_t {
 hashtable_t *hashtable_create(hashtable_hash_t hash, hashtable_equals_t equals,
 							  u_int capacity);
 
+/**
+ * Creates an empty hash table object using open addressing.
+ *
+ * In contrast to hashtable_create() the key/value pairs are stored directly
+ * in a flat slot array using Robin Hood probing, avoiding the allocation per
+ * pair and the pointer chasing of overflow lists during lookups.  Removed
+ * slots get closed by backward-shifting the following cluster, so no
+ * tombstones accumulate.  NULL is not supported as key by this variant.
+ *
+ * @param hash			hash function
+ * @param equals		equals function
+ * @param capacity		initial capacity
+ * @return				hashtable_t object.
+ */
+hashtable_t *hashtable_create_flat(hashtable_hash_t hash,
+								   hashtable_equals_t equals, u_int capacity);
+
 #endif /** HASHTABLE_H_ @}*/
@@ -17,9 +17,21 @@
 
 #include <stdlib.h>
 #include <stdarg.h>
+#include <pthread.h>
 
 #include "linked_list.h"
 
+/**
+ * Number of elements embedded in the list object itself, serving the very
+ * common short-lived lists of a few items without any element allocation.
+ */
+#define EMBEDDED_ELEMENTS 3
+
+/**
+ * Maximum number of elements cached in the thread specific freelist.
+ */
+#define POOL_LIMIT 64
+
 typedef struct element_t element_t;
 
 /**
@@ -59,6 +71,112 @@ element_t *element_create(void *value)
 	return this;
 }
 
+#ifndef LEAK_DETECTIVE
+
+typedef struct pool_t pool_t;
+
+/**
+ * Thread specific freelist of elements, so that the frequent list churn in
+ * the daemon does not hit malloc/free for every element.  Disabled with
+ * leak detective, which would report the cached elements as leaks.
+ */
+struct pool_t {
+
+	/**
+	 * first cached element, linked via next
+	 */
+	element_t *head;
+
+	/**
+	 * number of cached elements
+	 */
+	int count;
+};
+
+static pthread_key_t pool_key;
+static pthread_once_t pool_key_initialized = PTHREAD_ONCE_INIT;
+
+/**
+ * Free the elements cached by a terminating thread
+ */
+static void pool_cleanup(void *data)
+{
+	pool_t *pool = data;
+	element_t *element, *next;
+
+	for (element = pool->head; element; element = next)
+	{
+		next = element->next;
+		free(element);
+	}
+	free(pool);
+}
+
+/**
+ * Create the key used for the thread specific freelist
+ */
+static void initialize_pool_key()
+{
+	pthread_key_create(&pool_key, pool_cleanup);
+}
+
+/**
+ * Get an element from the thread specific pool, NULL if it is empty
+ */
+static element_t *pool_get()
+{
+	pool_t *pool;
+	element_t *element = NULL;
+
+	pthread_once(&pool_key_initialized, initialize_pool_key);
+	pool = pthread_getspecific(pool_key);
+	if (pool && pool->head)
+	{
+		element = pool->head;
+		pool->head = element->next;
+		pool->count--;
+	}
+	return element;
+}
+
+/**
+ * Return an element to the thread specific pool, FALSE if it is full
+ */
+static bool pool_put(element_t *element)
+{
+	pool_t *pool;
+
+	pthread_once(&pool_key_initialized, initialize_pool_key);
+	pool = pthread_getspecific(pool_key);
+	if (!pool)
+	{
+		pool = calloc(1, sizeof(pool_t));
+		pthread_setspecific(pool_key, pool);
+	}
+	if (pool->count >= POOL_LIMIT)
+	{
+		return FALSE;
+	}
+	element->next = pool->head;
+	pool->head = element;
+	pool->count++;
+	return TRUE;
+}
+
+#else /* LEAK_DETECTIVE */
+
+static element_t *pool_get()
+{
+	return NULL;
+}
+
+static bool pool_put(element_t *element)
+{
+	return FALSE;
+}
+
+#endif /* LEAK_DETECTIVE */
+
 
 typedef struct private_linked_list_t private_linked_list_t;
 
@@ -88,6 +206,16 @@ struct private_linked_list_t {
 	 * NULL if no elements in list.
 	 */
 	element_t *last;
+
+	/**
+	 * Elements embedded in the list object, used before allocating any.
+	 */
+	element_t embedded[EMBEDDED_ELEMENTS];
+
+	/**
+	 * Bitmask of embedded elements currently in use.
+	 */
+	u_int embedded_used;
 };
 
 typedef struct private_enumerator_t private_enumerator_t;
@@ -174,12 +302,64 @@ METHOD(linked_list_t, get_count, int,
 	return this->count;
 }
 
+/**
+ * Get a free element from the embedded slots, the thread's pool or by
+ * allocating a fresh one
+ */
+static element_t *get_element(private_linked_list_t *this, void *value)
+{
+	element_t *element;
+	int i;
+
+	if (this->embedded_used != (1 << EMBEDDED_ELEMENTS) - 1)
+	{
+		for (i = 0; i < EMBEDDED_ELEMENTS; i++)
+		{
+			if (!(this->embedded_used & (1 << i)))
+			{
+				this->embedded_used |= 1 << i;
+				element = &this->embedded[i];
+				element->value = value;
+				element->previous = NULL;
+				element->next = NULL;
+				return element;
+			}
+		}
+	}
+	element = pool_get();
+	if (element)
+	{
+		element->value = value;
+		element->previous = NULL;
+		element->next = NULL;
+		return element;
+	}
+	return element_create(value);
+}
+
+/**
+ * Release an element to its embedded slot or the thread's pool, or free it
+ */
+static void put_element(private_linked_list_t *this, element_t *element)
+{
+	if (element >= this->embedded &&
+		element < this->embedded + EMBEDDED_ELEMENTS)
+	{
+		this->embedded_used &= ~(1 << (element - this->embedded));
+		return;
+	}
+	if (!pool_put(element))
+	{
+		free(element);
+	}
+}
+
 METHOD(linked_list_t, insert_first, void,
 	private_linked_list_t *this, void *item)
 {
 	element_t *element;
 
-	element = element_create(item);
+	element = get_element(this, item);
 	if (this->count == 0)
 	{
 		/* first entry in list */
@@ -205,7 +385,7 @@ static element_t* remove_element(private_linked_list_t *this,
 
 	next = element->next;
 	previous = element->previous;
-	free(element);
+	put_element(this, element);
 	if (next)
 	{
 		next->previous = previous;
@@ -257,7 +437,7 @@ METHOD(linked_list_t, insert_last, void,
 {
 	element_t *element;
 
-	element = element_create(item);
+	element = get_element(this, item);
 	if (this->count == 0)
 	{
 		/* first entry in list */
@@ -292,7 +472,7 @@ METHOD(linked_list_t, insert_before, void,
 		}
 		return;
 	}
-	element = element_create(item);
+	element = get_element(this, item);
 	if (current->previous)
 	{
 		current->previous->next = element;
@@ -457,7 +637,7 @@ METHOD(linked_list_t, destroy_offset, void,
 		void (**method)(void*) = current->value + offset;
 		(*method)(current->value);
 		next = current->next;
-		free(current);
+		put_element(this, current);
 		current = next;
 	}
 	free(this);
@@ -472,7 +652,7 @@ METHOD(linked_list_t, destroy_function, void,
 	{
 		fn(current->value);
 		next = current->next;
-		free(current);
+		put_element(this, current);
 		current = next;
 	}
 	free(this);
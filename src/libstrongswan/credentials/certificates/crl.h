@@ -107,6 +107,20 @@ struct crl_t {
 	 * @return			enumerator over revoked certificates.
 	 */
 	enumerator_t* (*create_enumerator)(crl_t *this);
+
+	/**
+	 * Check if a specific certificate serial is revoked by this CRL.
+	 *
+	 * Optional method using an indexed lookup, implementations not setting
+	 * it leave the pointer NULL and callers fall back to create_enumerator().
+	 *
+	 * @param serial	certificate serial to look up
+	 * @param revocation	receives date of revocation, if revoked
+	 * @param reason	receives reason of revocation, if revoked
+	 * @return			TRUE if the serial is revoked
+	 */
+	bool (*is_revoked)(crl_t *this, chunk_t serial, time_t *revocation,
+					   crl_reason_t *reason);
 };
 
 /**
@@ -15,12 +15,17 @@
 
 #include "credential_manager.h"
 
+#include <time.h>
+
 #include <library.h>
 #include <utils/debug.h>
 #include <threading/thread_value.h>
 #include <threading/mutex.h>
+#include <threading/condvar.h>
 #include <threading/rwlock.h>
+#include <processing/jobs/callback_job.h>
 #include <collections/linked_list.h>
+#include <collections/hashtable.h>
 #include <credentials/sets/cert_cache.h>
 #include <credentials/sets/auth_cfg_wrapper.h>
 #include <credentials/certificates/x509.h>
@@ -82,6 +87,31 @@ struct private_credential_manager_t {
 	 */
 	mutex_t *queue_mutex;
 
+	/**
+	 * Memoized trust chain verifications, as memo_entry_t, NULL if disabled
+	 */
+	hashtable_t *memos;
+
+	/**
+	 * mutex for verification memos
+	 */
+	mutex_t *memo_mutex;
+
+	/**
+	 * seconds to cache successful trust chain verifications
+	 */
+	u_int memo_lifetime;
+
+	/**
+	 * time of the next purge of expired verification memos
+	 */
+	time_t memo_purge;
+
+	/**
+	 * fan out signature checks of trust chains to processor jobs
+	 */
+	bool parallel_verify;
+
 	/**
 	 * Registered hook to call on validation errors
 	 */
@@ -93,7 +123,7 @@ struct private_credential_manager_t {
 	void *hook_data;
 };
 
-/** data to pass to create_private_enumerator */
+/** data to pass to create_private */
 typedef struct {
 	private_credential_manager_t *this;
 	key_type_t type;
@@ -263,15 +293,26 @@ METHOD(credential_manager_t, get_cert, certificate_t*,
 	identification_t *id, bool trusted)
 {
 	certificate_t *current, *found = NULL;
+	enumerator_nested_t nested;
 	enumerator_t *enumerator;
+	cert_data_t data = {
+		.this = this,
+		.cert = cert,
+		.key = key,
+		.id = id,
+		.trusted = trusted,
+	};
 
-	enumerator = create_cert_enumerator(this, cert, key, id, trusted);
+	this->lock->read_lock(this->lock);
+	enumerator = enumerator_init_nested(&nested, create_sets_enumerator(this),
+										(void*)create_cert, &data, NULL);
 	if (enumerator->enumerate(enumerator, &current))
 	{
 		/* TODO: best match? order by keyid, subject, sualtname */
 		found = current->get_ref(current);
 	}
 	enumerator->destroy(enumerator);
+	this->lock->unlock(this->lock);
 	return found;
 }
 
@@ -310,15 +351,6 @@ METHOD(credential_manager_t, create_cdp_enumerator, enumerator_t*,
 									(void*)destroy_cdp_data);
 }
 
-/**
- * cleanup function for private data
- */
-static void destroy_private_data(private_data_t *data)
-{
-	data->this->lock->unlock(data->this->lock);
-	free(data);
-}
-
 /**
  * enumerator constructor for private keys
  */
@@ -327,25 +359,6 @@ static enumerator_t *create_private(credential_set_t *set, private_data_t *data)
 	return set->create_private_enumerator(set, data->type, data->keyid);
 }
 
-/**
- * Create an enumerator over private keys
- */
-static enumerator_t *create_private_enumerator(
-	private_credential_manager_t *this, key_type_t key, identification_t *keyid)
-{
-	private_data_t *data;
-
-	INIT(data,
-		.this = this,
-		.type = key,
-		.keyid = keyid,
-	);
-	this->lock->read_lock(this->lock);
-	return enumerator_create_nested(create_sets_enumerator(this),
-									(void*)create_private, data,
-									(void*)destroy_private_data);
-}
-
 /**
  * Look up a private key by its key identifier
  */
@@ -353,14 +366,23 @@ static private_key_t* get_private_by_keyid(private_credential_manager_t *this,
 									key_type_t key, identification_t *keyid)
 {
 	private_key_t *found = NULL;
+	enumerator_nested_t nested;
 	enumerator_t *enumerator;
+	private_data_t data = {
+		.this = this,
+		.type = key,
+		.keyid = keyid,
+	};
 
-	enumerator = create_private_enumerator(this, key, keyid);
+	this->lock->read_lock(this->lock);
+	enumerator = enumerator_init_nested(&nested, create_sets_enumerator(this),
+										(void*)create_private, &data, NULL);
 	if (enumerator->enumerate(enumerator, &found))
 	{
 		found->get_ref(found);
 	}
 	enumerator->destroy(enumerator);
+	this->lock->unlock(this->lock);
 	return found;
 }
 
@@ -406,9 +428,18 @@ METHOD(credential_manager_t, get_shared, shared_key_t*,
 	shared_key_t *current, *found = NULL;
 	id_match_t best_me = ID_MATCH_NONE, best_other = ID_MATCH_NONE;
 	id_match_t match_me, match_other;
+	enumerator_nested_t nested;
 	enumerator_t *enumerator;
+	shared_data_t data = {
+		.this = this,
+		.type = type,
+		.me = me,
+		.other = other,
+	};
 
-	enumerator = create_shared_enumerator(this, type, me, other);
+	this->lock->read_lock(this->lock);
+	enumerator = enumerator_init_nested(&nested, create_sets_enumerator(this),
+										(void*)create_shared, &data, NULL);
 	while (enumerator->enumerate(enumerator, &current, &match_me, &match_other))
 	{
 		if (match_other > best_other ||
@@ -425,6 +456,7 @@ METHOD(credential_manager_t, get_shared, shared_key_t*,
 		}
 	}
 	enumerator->destroy(enumerator);
+	this->lock->unlock(this->lock);
 	return found;
 }
 
@@ -708,6 +740,384 @@ static void get_key_strength(certificate_t *cert, auth_cfg_t *auth)
 	}
 }
 
+/**
+ * A memoized successful trust chain verification
+ */
+typedef struct {
+	/** subject certificate the chain was verified for */
+	certificate_t *subject;
+	/** verified trust chain, as returned by verify_trust_chain() */
+	auth_cfg_t *auth;
+	/** TRUE if the subject was pretrusted during verification */
+	bool trusted;
+	/** TRUE if revocation checking was done */
+	bool online;
+	/** expiration time of this memo */
+	time_t expires;
+} memo_entry_t;
+
+/**
+ * Destroy a verification memo
+ */
+static void memo_entry_destroy(memo_entry_t *this)
+{
+	this->subject->destroy(this->subject);
+	this->auth->destroy(this->auth);
+	free(this);
+}
+
+/**
+ * Hashtable hash function for verification memos
+ */
+static u_int memo_hash(memo_entry_t *entry)
+{
+	identification_t *id;
+
+	id = entry->subject->get_subject(entry->subject);
+	return chunk_hash_inc(id->get_encoding(id),
+						  chunk_hash(chunk_from_thing(entry->online)));
+}
+
+/**
+ * Hashtable equals function for verification memos
+ */
+static bool memo_equals(memo_entry_t *a, memo_entry_t *b)
+{
+	return a->online == b->online && a->trusted == b->trusted &&
+		   a->subject->equals(a->subject, b->subject);
+}
+
+/**
+ * Check for a memoized verification of subject, merge it into result if found
+ */
+static bool check_memo(private_credential_manager_t *this,
+					   certificate_t *subject, bool trusted, bool online,
+					   auth_cfg_t *result)
+{
+	memo_entry_t *entry, key = {
+		.subject = subject,
+		.trusted = trusted,
+		.online = online,
+	};
+	bool found = FALSE;
+
+	if (!this->memos)
+	{
+		return FALSE;
+	}
+	this->memo_mutex->lock(this->memo_mutex);
+	entry = this->memos->get(this->memos, &key);
+	if (entry)
+	{
+		if (entry->expires <= time(NULL))
+		{
+			this->memos->remove(this->memos, entry);
+			memo_entry_destroy(entry);
+		}
+		else
+		{
+			result->merge(result, entry->auth, TRUE);
+			found = TRUE;
+		}
+	}
+	this->memo_mutex->unlock(this->memo_mutex);
+	if (found)
+	{
+		DBG2(DBG_CFG, "  using memoized trust chain for \"%Y\"",
+			 subject->get_subject(subject));
+	}
+	return found;
+}
+
+/**
+ * Remove all expired verification memos
+ */
+static void purge_memos(private_credential_manager_t *this, time_t now)
+{
+	enumerator_t *enumerator;
+	memo_entry_t *entry;
+
+	enumerator = this->memos->create_enumerator(this->memos);
+	while (enumerator->enumerate(enumerator, NULL, &entry))
+	{
+		if (entry->expires <= now)
+		{
+			this->memos->remove_at(this->memos, enumerator);
+			memo_entry_destroy(entry);
+		}
+	}
+	enumerator->destroy(enumerator);
+}
+
+/**
+ * Memoize a successful verification of subject, bounded by the certificate
+ * lifetimes in the chain
+ */
+static void memoize(private_credential_manager_t *this, certificate_t *subject,
+					bool trusted, bool online, auth_cfg_t *auth)
+{
+	enumerator_t *enumerator;
+	certificate_t *cert;
+	memo_entry_t *entry, *old;
+	auth_rule_t rule;
+	time_t now, expires, not_after;
+
+	if (!this->memos)
+	{
+		return;
+	}
+	now = time(NULL);
+	expires = now + this->memo_lifetime;
+	enumerator = auth->create_enumerator(auth);
+	while (enumerator->enumerate(enumerator, &rule, &cert))
+	{
+		if (rule == AUTH_RULE_SUBJECT_CERT || rule == AUTH_RULE_IM_CERT ||
+			rule == AUTH_RULE_CA_CERT)
+		{
+			if (cert->get_validity(cert, &now, NULL, &not_after))
+			{
+				expires = min(expires, not_after);
+			}
+		}
+	}
+	enumerator->destroy(enumerator);
+	if (expires <= now)
+	{
+		return;
+	}
+	INIT(entry,
+		.subject = subject->get_ref(subject),
+		.auth = auth->clone(auth),
+		.trusted = trusted,
+		.online = online,
+		.expires = expires,
+	);
+	this->memo_mutex->lock(this->memo_mutex);
+	if (now >= this->memo_purge)
+	{	/* occasionally drop expired memos to keep the table bounded */
+		purge_memos(this, now);
+		this->memo_purge = now + this->memo_lifetime;
+	}
+	old = this->memos->put(this->memos, entry, entry);
+	this->memo_mutex->unlock(this->memo_mutex);
+	if (old)
+	{
+		memo_entry_destroy(old);
+	}
+}
+
+/**
+ * Upper bound of fanned out signature checks per chain
+ */
+#define MAX_CHAIN_CHECKS (MAX_TRUST_PATH_LEN * 3)
+
+/**
+ * Context shared between the verifying thread and its helper jobs
+ */
+typedef struct {
+	/** manager to verify with */
+	private_credential_manager_t *this;
+	/** mutex protecting the shared state */
+	mutex_t *mutex;
+	/** signalled whenever a check completes */
+	condvar_t *condvar;
+	/** outstanding signature checks, as chain_check_t */
+	linked_list_t *work;
+	/** number of checks currently being processed */
+	int active;
+	/** references by the verifying thread and each helper job */
+	refcount_t refs;
+} chain_warm_t;
+
+/**
+ * A single signature check of a candidate chain
+ */
+typedef struct {
+	/** certificate to check, gets a reference */
+	certificate_t *subject;
+	/** issuer candidate to check against, gets a reference */
+	certificate_t *issuer;
+} chain_check_t;
+
+/**
+ * Destroy a queued signature check
+ */
+static void chain_check_destroy(chain_check_t *check)
+{
+	check->subject->destroy(check->subject);
+	check->issuer->destroy(check->issuer);
+	free(check);
+}
+
+/**
+ * Release a reference to the shared warming context
+ */
+static void chain_warm_deref(chain_warm_t *ctx)
+{
+	if (ref_put(&ctx->refs))
+	{
+		ctx->work->destroy_function(ctx->work, (void*)chain_check_destroy);
+		ctx->condvar->destroy(ctx->condvar);
+		ctx->mutex->destroy(ctx->mutex);
+		free(ctx);
+	}
+}
+
+/**
+ * Process queued signature checks until the work list is drained. The
+ * results end up in the certificate cache, the authoritative serial
+ * verification then finds them there without redoing the crypto.
+ */
+static void process_chain_checks(chain_warm_t *ctx)
+{
+	chain_check_t *check;
+
+	ctx->mutex->lock(ctx->mutex);
+	while (ctx->work->remove_first(ctx->work, (void**)&check) == SUCCESS)
+	{
+		ctx->active++;
+		ctx->mutex->unlock(ctx->mutex);
+
+		issued_by(ctx->this, check->subject, check->issuer, NULL);
+		chain_check_destroy(check);
+
+		ctx->mutex->lock(ctx->mutex);
+		ctx->active--;
+		ctx->condvar->signal(ctx->condvar);
+	}
+	ctx->mutex->unlock(ctx->mutex);
+}
+
+/**
+ * Job callback processing signature checks on a worker thread
+ */
+static job_requeue_t chain_warm_job(chain_warm_t *ctx)
+{
+	process_chain_checks(ctx);
+	return JOB_REQUEUE_NONE;
+}
+
+/**
+ * Speculatively collect the signature checks of the candidate chain for
+ * subject. Candidates are selected by name/keyid matching only, the serial
+ * verification below remains authoritative if the speculation went wrong.
+ */
+static linked_list_t *collect_chain_checks(private_credential_manager_t *this,
+										   certificate_t *subject)
+{
+	linked_list_t *work;
+	enumerator_t *enumerator;
+	certificate_t *current, *candidate, *next;
+	chain_check_t *check;
+	identification_t *id;
+	int pathlen, count = 0;
+	bool trusted;
+
+	work = linked_list_create();
+	current = subject->get_ref(subject);
+	for (pathlen = 0; pathlen <= MAX_TRUST_PATH_LEN &&
+		 count < MAX_CHAIN_CHECKS; pathlen++)
+	{
+		next = NULL;
+		for (trusted = TRUE; ; trusted = FALSE)
+		{
+			enumerator = create_cert_enumerator(this,
+									current->get_type(current), KEY_ANY,
+									current->get_issuer(current), trusted);
+			while (enumerator->enumerate(enumerator, &candidate) &&
+				   count < MAX_CHAIN_CHECKS)
+			{
+				INIT(check,
+					.subject = current->get_ref(current),
+					.issuer = candidate->get_ref(candidate),
+				);
+				work->insert_last(work, check);
+				count++;
+				if (trusted)
+				{	/* the serial loop checks trusted issuers for being
+					 * self-signed trust anchors */
+					INIT(check,
+						.subject = candidate->get_ref(candidate),
+						.issuer = candidate->get_ref(candidate),
+					);
+					work->insert_last(work, check);
+					count++;
+				}
+				if (!next)
+				{
+					next = candidate->get_ref(candidate);
+				}
+			}
+			enumerator->destroy(enumerator);
+			if (next || !trusted)
+			{
+				break;
+			}
+		}
+		if (!next)
+		{
+			break;
+		}
+		id = next->get_issuer(next);
+		if (next->equals(next, current) ||
+			id->equals(id, next->get_subject(next)))
+		{	/* reached a (hopefully trusted) self-signed certificate */
+			next->destroy(next);
+			break;
+		}
+		current->destroy(current);
+		current = next;
+	}
+	current->destroy(current);
+	return work;
+}
+
+/**
+ * Warm the certificate cache with the signature checks of the candidate
+ * chain of subject, fanning them out to processor workers.
+ */
+static void warm_chain_cache(private_credential_manager_t *this,
+							 certificate_t *subject)
+{
+	chain_warm_t *ctx;
+	linked_list_t *work;
+	int jobs, count;
+
+	work = collect_chain_checks(this, subject);
+	count = work->get_count(work);
+	if (count <= 1)
+	{	/* nothing to parallelize */
+		work->destroy_function(work, (void*)chain_check_destroy);
+		return;
+	}
+	INIT(ctx,
+		.this = this,
+		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+		.condvar = condvar_create(CONDVAR_TYPE_DEFAULT),
+		.work = work,
+		.refs = 1,
+	);
+	jobs = min(count - 1, 4);
+	while (jobs--)
+	{
+		ref_get(&ctx->refs);
+		lib->processor->queue_job(lib->processor,
+			(job_t*)callback_job_create_with_prio((callback_job_cb_t)chain_warm_job,
+					ctx, (callback_job_cleanup_t)chain_warm_deref, NULL,
+					JOB_PRIO_HIGH));
+	}
+	/* process checks ourselves as well, we never block on helper jobs that
+	 * could not be scheduled */
+	process_chain_checks(ctx);
+	ctx->mutex->lock(ctx->mutex);
+	while (ctx->active)
+	{
+		ctx->condvar->wait(ctx->condvar, ctx->mutex);
+	}
+	ctx->mutex->unlock(ctx->mutex);
+	chain_warm_deref(ctx);
+}
+
 /**
  * try to verify the trust chain of subject, return TRUE if trusted
  */
@@ -718,8 +1128,20 @@ static bool verify_trust_chain(private_credential_manager_t *this,
 	certificate_t *current, *issuer;
 	auth_cfg_t *auth;
 	signature_scheme_t scheme;
+	bool pretrusted = trusted;
 	int pathlen;
 
+	if (check_memo(this, subject, trusted, online, result))
+	{
+		return TRUE;
+	}
+
+	if (this->parallel_verify && this->cache &&
+		lib->processor->get_total_threads(lib->processor) > 1)
+	{
+		warm_chain_cache(this, subject);
+	}
+
 	auth = auth_cfg_create();
 	get_key_strength(subject, auth);
 	current = subject->get_ref(subject);
@@ -800,6 +1222,7 @@ static bool verify_trust_chain(private_credential_manager_t *this,
 	}
 	if (trusted)
 	{
+		memoize(this, subject, pretrusted, online, auth);
 		result->merge(result, auth, FALSE);
 	}
 	auth->destroy(auth);
@@ -1260,6 +1683,12 @@ METHOD(credential_manager_t, flush_cache, void,
 	{
 		this->cache->flush(this->cache, type);
 	}
+	if (this->memos)
+	{	/* verification memos reference certificates, drop them all */
+		this->memo_mutex->lock(this->memo_mutex);
+		purge_memos(this, TIME_32_BIT_SIGNED_MAX);
+		this->memo_mutex->unlock(this->memo_mutex);
+	}
 }
 
 METHOD(credential_manager_t, add_set, void,
@@ -1299,6 +1728,12 @@ METHOD(credential_manager_t, destroy, void,
 {
 	cache_queue(this);
 	this->cache_queue->destroy(this->cache_queue);
+	if (this->memos)
+	{
+		purge_memos(this, TIME_32_BIT_SIGNED_MAX);
+		this->memos->destroy(this->memos);
+		this->memo_mutex->destroy(this->memo_mutex);
+	}
 	if (this->cache)
 	{
 		this->sets->remove(this->sets, this->cache, NULL);
@@ -1346,7 +1781,7 @@ credential_manager_t *credential_manager_create()
 		.sets = linked_list_create(),
 		.validators = linked_list_create(),
 		.cache_queue = linked_list_create(),
-		.lock = rwlock_create(RWLOCK_TYPE_DEFAULT),
+		.lock = rwlock_create(RWLOCK_TYPE_READ_BIASED),
 		.queue_mutex = mutex_create(MUTEX_TYPE_DEFAULT),
 	);
 
@@ -1357,6 +1792,17 @@ credential_manager_t *credential_manager_create()
 		this->cache = cert_cache_create();
 		this->sets->insert_first(this->sets, this->cache);
 	}
+	this->parallel_verify = lib->settings->get_bool(lib->settings,
+										"%s.parallel_chain_verify", FALSE,
+										lib->ns);
+	this->memo_lifetime = lib->settings->get_int(lib->settings,
+										"%s.cert_verify_memo", 0, lib->ns);
+	if (this->memo_lifetime)
+	{
+		this->memos = hashtable_create((hashtable_hash_t)memo_hash,
+									   (hashtable_equals_t)memo_equals, 32);
+		this->memo_mutex = mutex_create(MUTEX_TYPE_DEFAULT);
+	}
 
 	return &this->public;
 }
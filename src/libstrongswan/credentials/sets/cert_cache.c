@@ -21,14 +21,15 @@
 #include <threading/rwlock.h>
 #include <collections/linked_list.h>
 
-/** cache size, a power of 2 for fast modulo */
-#define CACHE_SIZE 32
+/** number of independently locked shards, a power of 2 */
+#define SHARD_COUNT 8
 
-/** attempts to acquire a cache lock */
-#define REPLACE_TRIES 5
+/** default overall cache size */
+#define DEFAULT_CACHE_SIZE 512
 
 typedef struct private_cert_cache_t private_cert_cache_t;
 typedef struct relation_t relation_t;
+typedef struct shard_t shard_t;
 
 /**
  * A trusted relation between subject and issuer
@@ -51,14 +52,40 @@ struct relation_t {
 	signature_scheme_t scheme;
 
 	/**
-	 * Cache hits
+	 * Hash of the subject/issuer fingerprints, to skip expensive compares
 	 */
-	u_int hits;
+	u_int32_t hash;
+
+	/**
+	 * Logical timestamp of the last cache hit, for LRU replacement
+	 */
+	u_int32_t last_use;
+};
+
+/**
+ * An independently locked cache shard
+ */
+struct shard_t {
+
+	/**
+	 * Relations cached in this shard, as relation_t
+	 */
+	linked_list_t *relations;
 
 	/**
-	 * Lock for this relation
+	 * Lock for this shard
 	 */
 	rwlock_t *lock;
+
+	/**
+	 * Cache hits in this shard
+	 */
+	u_int hits;
+
+	/**
+	 * Cache misses in this shard
+	 */
+	u_int misses;
 };
 
 /**
@@ -72,70 +99,95 @@ struct private_cert_cache_t {
 	cert_cache_t public;
 
 	/**
-	 * array of trusted subject-issuer relations
+	 * cache shards, selected by relation hash
+	 */
+	shard_t shards[SHARD_COUNT];
+
+	/**
+	 * maximum number of relations per shard
+	 */
+	u_int capacity;
+
+	/**
+	 * logical clock to order cache hits, incremented on each hit
 	 */
-	relation_t relations[CACHE_SIZE];
+	refcount_t use;
 };
 
 /**
- * Cache relation in a free slot/replace an other
+ * Destroy a cached relation
  */
-static void cache(private_cert_cache_t *this,
+static void relation_destroy(relation_t *this)
+{
+	this->subject->destroy(this->subject);
+	this->issuer->destroy(this->issuer);
+	free(this);
+}
+
+/**
+ * Hash a subject-issuer relation to a bucket, using the DN encodings as
+ * fingerprint. The hash is stable over different instances of a certificate.
+ */
+static u_int32_t relation_hash(certificate_t *subject, certificate_t *issuer)
+{
+	identification_t *id;
+	u_int32_t hash;
+
+	id = subject->get_subject(subject);
+	hash = chunk_hash(id->get_encoding(id));
+	id = issuer->get_subject(issuer);
+	return chunk_hash_inc(id->get_encoding(id), hash);
+}
+
+/**
+ * Get the shard a relation hash maps to
+ */
+static shard_t *get_shard(private_cert_cache_t *this, u_int32_t hash)
+{
+	return &this->shards[hash & (SHARD_COUNT - 1)];
+}
+
+/**
+ * Cache a relation in its shard, evicting the least recently used entry
+ * if the shard is full
+ */
+static void cache(private_cert_cache_t *this, u_int32_t hash,
 				  certificate_t *subject, certificate_t *issuer,
 				  signature_scheme_t scheme)
 {
-	relation_t *rel;
-	int i, offset, try;
-	u_int total_hits = 0;
+	relation_t *rel, *lru = NULL;
+	enumerator_t *enumerator;
+	shard_t *shard;
+
+	INIT(rel,
+		.subject = subject->get_ref(subject),
+		.issuer = issuer->get_ref(issuer),
+		.scheme = scheme,
+		.hash = hash,
+		.last_use = ref_get(&this->use),
+	);
 
-	/* check for a unused relation slot first */
-	for (i = 0; i < CACHE_SIZE; i++)
+	shard = get_shard(this, hash);
+	shard->lock->write_lock(shard->lock);
+	shard->relations->insert_first(shard->relations, rel);
+	if (shard->relations->get_count(shard->relations) > this->capacity)
 	{
-		rel = &this->relations[i];
-
-		if (!rel->subject && rel->lock->try_write_lock(rel->lock))
+		enumerator = shard->relations->create_enumerator(shard->relations);
+		while (enumerator->enumerate(enumerator, &rel))
 		{
-			/* double-check having lock */
-			if (!rel->subject)
+			if (!lru || rel->last_use < lru->last_use)
 			{
-				rel->subject = subject->get_ref(subject);
-				rel->issuer = issuer->get_ref(issuer);
-				rel->scheme = scheme;
-				return rel->lock->unlock(rel->lock);
+				lru = rel;
 			}
-			rel->lock->unlock(rel->lock);
 		}
-		total_hits += rel->hits;
+		enumerator->destroy(enumerator);
+		shard->relations->remove(shard->relations, lru, NULL);
 	}
-	/* run several attempts to replace a random slot, never block. */
-	for (try = 0; try < REPLACE_TRIES; try++)
-	{
-		/* replace a random relation */
-		offset = random();
-		for (i = 0; i < CACHE_SIZE; i++)
-		{
-			rel = &this->relations[(i + offset) % CACHE_SIZE];
+	shard->lock->unlock(shard->lock);
 
-			if (rel->hits > total_hits / CACHE_SIZE)
-			{	/* skip often used slots */
-				continue;
-			}
-			if (rel->lock->try_write_lock(rel->lock))
-			{
-				if (rel->subject)
-				{
-					rel->subject->destroy(rel->subject);
-					rel->issuer->destroy(rel->issuer);
-				}
-				rel->subject = subject->get_ref(subject);
-				rel->issuer = issuer->get_ref(issuer);
-				rel->scheme = scheme;
-				rel->hits = 0;
-				return rel->lock->unlock(rel->lock);
-			}
-		}
-		/* give other threads a chance to release locks */
-		sched_yield();
+	if (lru)
+	{
+		relation_destroy(lru);
 	}
 }
 
@@ -144,44 +196,54 @@ METHOD(cert_cache_t, issued_by, bool,
 	signature_scheme_t *schemep)
 {
 	certificate_t *cached_issuer = NULL;
-	relation_t *found = NULL, *current;
 	signature_scheme_t scheme;
-	int i;
+	enumerator_t *enumerator;
+	relation_t *rel;
+	shard_t *shard;
+	u_int32_t hash;
+	bool found = FALSE;
 
-	for (i = 0; i < CACHE_SIZE; i++)
-	{
-		current = &this->relations[i];
+	hash = relation_hash(subject, issuer);
+	shard = get_shard(this, hash);
 
-		current->lock->read_lock(current->lock);
-		if (current->subject)
+	shard->lock->read_lock(shard->lock);
+	enumerator = shard->relations->create_enumerator(shard->relations);
+	while (enumerator->enumerate(enumerator, &rel))
+	{
+		if (rel->hash == hash &&
+			issuer->equals(issuer, rel->issuer) &&
+			subject->equals(subject, rel->subject))
 		{
-			if (issuer->equals(issuer, current->issuer))
+			/* updated without write lock, as a raced update is harmless */
+			rel->last_use = ref_get(&this->use);
+			shard->hits++;
+			found = TRUE;
+			if (schemep)
 			{
-				if (subject->equals(subject, current->subject))
-				{
-					current->hits++;
-					found = current;
-					if (schemep)
-					{
-						*schemep = current->scheme;
-					}
-				}
-				else if (!cached_issuer)
-				{
-					cached_issuer = current->issuer->get_ref(current->issuer);
-				}
+				*schemep = rel->scheme;
 			}
+			break;
 		}
-		current->lock->unlock(current->lock);
-		if (found)
-		{
-			DESTROY_IF(cached_issuer);
-			return TRUE;
+		if (!cached_issuer && issuer->equals(issuer, rel->issuer))
+		{	/* prefer an already cached instance of this issuer */
+			cached_issuer = rel->issuer->get_ref(rel->issuer);
 		}
 	}
+	enumerator->destroy(enumerator);
+	if (!found)
+	{
+		shard->misses++;
+	}
+	shard->lock->unlock(shard->lock);
+
+	if (found)
+	{
+		DESTROY_IF(cached_issuer);
+		return TRUE;
+	}
 	if (subject->issued_by(subject, issuer, &scheme))
 	{
-		cache(this, subject, cached_issuer ?: issuer, scheme);
+		cache(this, hash, subject, cached_issuer ?: issuer, scheme);
 		if (schemep)
 		{
 			*schemep = scheme;
@@ -193,6 +255,23 @@ METHOD(cert_cache_t, issued_by, bool,
 	return FALSE;
 }
 
+METHOD(cert_cache_t, get_stats, void,
+	private_cert_cache_t *this, u_int *hits, u_int *misses)
+{
+	shard_t *shard;
+	int i;
+
+	*hits = *misses = 0;
+	for (i = 0; i < SHARD_COUNT; i++)
+	{
+		shard = &this->shards[i];
+		shard->lock->read_lock(shard->lock);
+		*hits += shard->hits;
+		*misses += shard->misses;
+		shard->lock->unlock(shard->lock);
+	}
+}
+
 /**
  * certificate enumerator implemenation
  */
@@ -206,11 +285,11 @@ typedef struct {
 	/** ID to get a cert for */
 	identification_t *id;
 	/** cache */
-	relation_t *relations;
-	/** current position in array cache */
-	int index;
-	/** currently locked relation */
-	int locked;
+	private_cert_cache_t *cache;
+	/** shard currently enumerated, read locked while inner is non-NULL */
+	int shard;
+	/** enumerator over the current shards relations */
+	enumerator_t *inner;
 } cert_enumerator_t;
 
 /**
@@ -220,20 +299,17 @@ static bool cert_enumerate(cert_enumerator_t *this, certificate_t **out)
 {
 	public_key_t *public;
 	relation_t *rel;
+	shard_t *shard;
 
-	if (this->locked >= 0)
-	{
-		rel = &this->relations[this->locked];
-		rel->lock->unlock(rel->lock);
-		this->locked = -1;
-	}
-
-	while (++this->index < CACHE_SIZE)
+	while (this->shard < SHARD_COUNT)
 	{
-		rel = &this->relations[this->index];
-		rel->lock->read_lock(rel->lock);
-		this->locked = this->index;
-		if (rel->subject)
+		shard = &this->cache->shards[this->shard];
+		if (!this->inner)
+		{
+			shard->lock->read_lock(shard->lock);
+			this->inner = shard->relations->create_enumerator(shard->relations);
+		}
+		while (this->inner->enumerate(this->inner, &rel))
 		{
 			/* CRL lookup is done using issuer/authkeyidentifier */
 			if (this->key == KEY_ANY && this->id &&
@@ -266,8 +342,10 @@ static bool cert_enumerate(cert_enumerator_t *this, certificate_t **out)
 				}
 			}
 		}
-		this->locked = -1;
-		rel->lock->unlock(rel->lock);
+		this->inner->destroy(this->inner);
+		this->inner = NULL;
+		shard->lock->unlock(shard->lock);
+		this->shard++;
 	}
 	return FALSE;
 }
@@ -277,12 +355,13 @@ static bool cert_enumerate(cert_enumerator_t *this, certificate_t **out)
  */
 static void cert_enumerator_destroy(cert_enumerator_t *this)
 {
-	relation_t *rel;
+	shard_t *shard;
 
-	if (this->locked >= 0)
+	if (this->inner)
 	{
-		rel = &this->relations[this->locked];
-		rel->lock->unlock(rel->lock);
+		this->inner->destroy(this->inner);
+		shard = &this->cache->shards[this->shard];
+		shard->lock->unlock(shard->lock);
 	}
 	free(this);
 }
@@ -303,9 +382,9 @@ METHOD(credential_set_t, create_enumerator, enumerator_t*,
 	enumerator->cert = cert;
 	enumerator->key = key;
 	enumerator->id = id;
-	enumerator->relations = this->relations;
-	enumerator->index = -1;
-	enumerator->locked = -1;
+	enumerator->cache = this;
+	enumerator->shard = 0;
+	enumerator->inner = NULL;
 
 	return &enumerator->public;
 }
@@ -313,59 +392,45 @@ METHOD(credential_set_t, create_enumerator, enumerator_t*,
 METHOD(cert_cache_t, flush, void,
 	private_cert_cache_t *this, certificate_type_t type)
 {
+	enumerator_t *enumerator;
+	linked_list_t *flushed;
 	relation_t *rel;
+	shard_t *shard;
 	int i;
 
-	for (i = 0; i < CACHE_SIZE; i++)
+	flushed = linked_list_create();
+	for (i = 0; i < SHARD_COUNT; i++)
 	{
-		rel = &this->relations[i];
-		if (!rel->subject)
-		{
-			continue;
-		}
-		/* check with cheap read lock first */
-		if (type != CERT_ANY)
+		shard = &this->shards[i];
+		shard->lock->write_lock(shard->lock);
+		enumerator = shard->relations->create_enumerator(shard->relations);
+		while (enumerator->enumerate(enumerator, &rel))
 		{
-			rel->lock->read_lock(rel->lock);
-			if (!rel->subject || type != rel->subject->get_type(rel->subject))
+			if (type == CERT_ANY ||
+				type == rel->subject->get_type(rel->subject))
 			{
-				rel->lock->unlock(rel->lock);
-				continue;
+				shard->relations->remove_at(shard->relations, enumerator);
+				flushed->insert_last(flushed, rel);
 			}
-			rel->lock->unlock(rel->lock);
 		}
-		/* double check in write lock */
-		rel->lock->write_lock(rel->lock);
-		if (rel->subject)
-		{
-			if (type == CERT_ANY || type == rel->subject->get_type(rel->subject))
-			{
-				rel->subject->destroy(rel->subject);
-				rel->issuer->destroy(rel->issuer);
-				rel->subject = NULL;
-				rel->issuer = NULL;
-				rel->hits = 0;
-			}
-		}
-		rel->lock->unlock(rel->lock);
+		enumerator->destroy(enumerator);
+		shard->lock->unlock(shard->lock);
 	}
+	flushed->destroy_function(flushed, (void*)relation_destroy);
 }
 
 METHOD(cert_cache_t, destroy, void,
 	private_cert_cache_t *this)
 {
-	relation_t *rel;
+	shard_t *shard;
 	int i;
 
-	for (i = 0; i < CACHE_SIZE; i++)
+	for (i = 0; i < SHARD_COUNT; i++)
 	{
-		rel = &this->relations[i];
-		if (rel->subject)
-		{
-			rel->subject->destroy(rel->subject);
-			rel->issuer->destroy(rel->issuer);
-		}
-		rel->lock->destroy(rel->lock);
+		shard = &this->shards[i];
+		shard->relations->destroy_function(shard->relations,
+										   (void*)relation_destroy);
+		shard->lock->destroy(shard->lock);
 	}
 	free(this);
 }
@@ -376,6 +441,7 @@ METHOD(cert_cache_t, destroy, void,
 cert_cache_t *cert_cache_create()
 {
 	private_cert_cache_t *this;
+	u_int size;
 	int i;
 
 	INIT(this,
@@ -388,17 +454,20 @@ cert_cache_t *cert_cache_create()
 				.cache_cert = (void*)nop,
 			},
 			.issued_by = _issued_by,
+			.get_stats = _get_stats,
 			.flush = _flush,
 			.destroy = _destroy,
 		},
 	);
 
-	for (i = 0; i < CACHE_SIZE; i++)
+	size = lib->settings->get_int(lib->settings, "%s.cert_cache_size",
+								  DEFAULT_CACHE_SIZE, lib->ns);
+	this->capacity = max(size / SHARD_COUNT, 1);
+
+	for (i = 0; i < SHARD_COUNT; i++)
 	{
-		this->relations[i].subject = NULL;
-		this->relations[i].issuer = NULL;
-		this->relations[i].hits = 0;
-		this->relations[i].lock = rwlock_create(RWLOCK_TYPE_DEFAULT);
+		this->shards[i].relations = linked_list_create();
+		this->shards[i].lock = rwlock_create(RWLOCK_TYPE_DEFAULT);
 	}
 
 	return &this->public;
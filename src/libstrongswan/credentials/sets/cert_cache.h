@@ -52,6 +52,14 @@ struct cert_cache_t {
 					  certificate_t *subject, certificate_t *issuer,
 					  signature_scheme_t *scheme);
 
+	/**
+	 * Get the number of cache hits and misses, for monitoring.
+	 *
+	 * @param hits			receives number of issued_by cache hits
+	 * @param misses		receives number of issued_by cache misses
+	 */
+	void (*get_stats)(cert_cache_t *this, u_int *hits, u_int *misses);
+
 	/**
 	 * Flush the certificate cache.
 	 *
@@ -17,8 +17,12 @@
 
 #include "mem_cred.h"
 
+#include <ctype.h>
+
 #include <threading/rwlock.h>
 #include <collections/linked_list.h>
+#include <collections/hashtable.h>
+#include <credentials/certificates/x509.h>
 
 typedef struct private_mem_cred_t private_mem_cred_t;
 
@@ -61,8 +65,474 @@ struct private_mem_cred_t {
 	 * List of CDPs, as cdp_t
 	 */
 	linked_list_t *cdps;
+
+	/**
+	 * Index over trusted, maps identification_t to index_entry_t
+	 */
+	hashtable_t *trusted_ids;
+
+	/**
+	 * Index over untrusted, maps identification_t to index_entry_t
+	 */
+	hashtable_t *untrusted_ids;
+
+	/**
+	 * Trusted certificates not coverable by the index, certificate_t
+	 */
+	linked_list_t *unindexed_trusted;
+
+	/**
+	 * Untrusted certificates not coverable by the index, certificate_t
+	 */
+	linked_list_t *unindexed_untrusted;
+
+	/**
+	 * Index over keys, maps fingerprint chunks to key_index_entry_t
+	 */
+	hashtable_t *key_fps;
+
+	/**
+	 * Private keys without extractable fingerprints, private_key_t
+	 */
+	linked_list_t *unindexed_keys;
 };
 
+/**
+ * Entry of the certificate index, certificates under one identity
+ */
+typedef struct {
+	/** indexed identity, owned by the entry */
+	identification_t *id;
+	/** certificates matching the identity exactly, weak certificate_t */
+	linked_list_t *certs;
+} index_entry_t;
+
+/**
+ * Entry of the private key index, keys under one fingerprint
+ */
+typedef struct {
+	/** indexed fingerprint, cloned */
+	chunk_t fp;
+	/** keys having this fingerprint, weak private_key_t */
+	linked_list_t *keys;
+} key_index_entry_t;
+
+/**
+ * Incrementally hash identity data, ignoring case
+ */
+static u_int hash_lower_inc(chunk_t data, u_int hash)
+{
+	u_char buf[64];
+	u_int i, len;
+
+	while (data.len)
+	{
+		len = min(data.len, sizeof(buf));
+		for (i = 0; i < len; i++)
+		{
+			buf[i] = tolower(data.ptr[i]);
+		}
+		hash = chunk_hash_inc(chunk_create(buf, len), hash);
+		data = chunk_skip(data, len);
+	}
+	return hash;
+}
+
+/**
+ * Hashtable hash function for identities, compatible to their equals()
+ * semantics: equal identities hash equally, even if their encoding differs
+ * in case or, for DNs, in RDN string types.
+ */
+static u_int id_hash(identification_t *id)
+{
+	id_type_t type;
+	chunk_t enc;
+	u_int hash;
+
+	type = id->get_type(id);
+	enc = id->get_encoding(id);
+	hash = chunk_hash(chunk_from_thing(type));
+	switch (type)
+	{
+		case ID_DER_ASN1_DN:
+		{
+			enumerator_t *parts;
+			id_part_t part;
+			chunk_t data;
+
+			/* equals() compares RDN values ignoring case and string types,
+			 * but requires an identical overall length */
+			hash = chunk_hash_inc(chunk_from_thing(enc.len), hash);
+			parts = id->create_part_enumerator(id);
+			while (parts->enumerate(parts, &part, &data))
+			{
+				hash = chunk_hash_inc(chunk_from_thing(part), hash);
+				hash = hash_lower_inc(data, hash);
+			}
+			parts->destroy(parts);
+			break;
+		}
+		case ID_FQDN:
+		case ID_RFC822_ADDR:
+			/* equals() ignores case */
+			hash = hash_lower_inc(enc, hash);
+			break;
+		default:
+			hash = chunk_hash_inc(enc, hash);
+			break;
+	}
+	return hash;
+}
+
+/**
+ * Hashtable equals function for identities
+ */
+static bool id_equals(identification_t *a, identification_t *b)
+{
+	return a->equals(a, b);
+}
+
+/**
+ * Hashtable hash function for fingerprint chunks
+ */
+static u_int fp_hash(chunk_t *fp)
+{
+	return chunk_hash(*fp);
+}
+
+/**
+ * Hashtable equals function for fingerprint chunks
+ */
+static bool fp_equals(chunk_t *a, chunk_t *b)
+{
+	return chunk_equals(*a, *b);
+}
+
+/**
+ * Add an identity to a list of index identities, avoiding duplicates.
+ * Consumes the passed identity.
+ */
+static void add_index_id(linked_list_t *ids, identification_t *id)
+{
+	identification_t *current;
+
+	if (ids->find_first(ids, (linked_list_match_t)id_equals,
+						(void**)&current, id) == SUCCESS)
+	{
+		id->destroy(id);
+		return;
+	}
+	ids->insert_last(ids, id);
+}
+
+/**
+ * Collect the identities a certificate is looked up by into ids. Returns
+ * FALSE if exact matching through the index can't be guaranteed for this
+ * certificate, such certificates are always enumerated as candidates.
+ */
+static bool create_index_ids(certificate_t *cert, linked_list_t *ids)
+{
+	identification_t *id;
+
+	id = cert->get_subject(cert);
+	switch (cert->get_type(cert))
+	{
+		case CERT_X509:
+		{
+			x509_t *x509 = (x509_t*)cert;
+			cred_encoding_type_t type;
+			enumerator_t *enumerator;
+			public_key_t *public;
+			hasher_t *hasher;
+			chunk_t chunk, encoding, hash = chunk_empty;
+
+			/* ID_KEY_ID identities additionally match the certificate hash,
+			 * subjectKeyIdentifier, key fingerprints and the serial */
+			hasher = lib->crypto->create_hasher(lib->crypto, HASH_SHA1);
+			if (!hasher ||
+				!cert->get_encoding(cert, CERT_ASN1_DER, &encoding))
+			{
+				DESTROY_IF(hasher);
+				return FALSE;
+			}
+			if (!hasher->allocate_hash(hasher, encoding, &hash))
+			{
+				hasher->destroy(hasher);
+				free(encoding.ptr);
+				return FALSE;
+			}
+			hasher->destroy(hasher);
+			free(encoding.ptr);
+			add_index_id(ids, identification_create_from_encoding(ID_KEY_ID,
+																  hash));
+			free(hash.ptr);
+
+			add_index_id(ids, id->clone(id));
+			enumerator = x509->create_subjectAltName_enumerator(x509);
+			while (enumerator->enumerate(enumerator, &id))
+			{
+				add_index_id(ids, id->clone(id));
+			}
+			enumerator->destroy(enumerator);
+
+			chunk = x509->get_subjectKeyIdentifier(x509);
+			if (chunk.len)
+			{
+				add_index_id(ids, identification_create_from_encoding(
+															ID_KEY_ID, chunk));
+			}
+			chunk = x509->get_serial(x509);
+			if (chunk.len)
+			{
+				add_index_id(ids, identification_create_from_encoding(
+															ID_KEY_ID, chunk));
+			}
+			public = cert->get_public_key(cert);
+			if (public)
+			{
+				for (type = 0; type < KEYID_MAX; type++)
+				{
+					if (public->get_fingerprint(public, type, &chunk))
+					{
+						add_index_id(ids, identification_create_from_encoding(
+															ID_KEY_ID, chunk));
+					}
+				}
+				public->destroy(public);
+			}
+			return TRUE;
+		}
+		case CERT_X509_CRL:
+		{
+			crl_t *crl = (crl_t*)cert;
+			chunk_t authkey;
+
+			/* CRLs are enumerated by issuer, get_subject() maps to it */
+			add_index_id(ids, id->clone(id));
+			authkey = crl->get_authKeyIdentifier(crl);
+			if (authkey.len)
+			{
+				add_index_id(ids, identification_create_from_encoding(
+															ID_KEY_ID, authkey));
+			}
+			return TRUE;
+		}
+		default:
+			/* other types have their own has_subject() semantics */
+			return FALSE;
+	}
+}
+
+/**
+ * Add a certificate under an identity to the given index
+ */
+static void index_cert_id(hashtable_t *ids, identification_t *id,
+						  certificate_t *cert)
+{
+	index_entry_t *entry;
+
+	entry = ids->get(ids, id);
+	if (!entry)
+	{
+		INIT(entry,
+			.id = id->clone(id),
+			.certs = linked_list_create(),
+		);
+		ids->put(ids, entry->id, entry);
+	}
+	entry->certs->insert_last(entry->certs, cert);
+}
+
+/**
+ * Remove a certificate under an identity from the given index
+ */
+static void unindex_cert_id(hashtable_t *ids, identification_t *id,
+							certificate_t *cert)
+{
+	index_entry_t *entry;
+
+	entry = ids->get(ids, id);
+	if (entry)
+	{
+		entry->certs->remove(entry->certs, cert, NULL);
+		if (entry->certs->get_count(entry->certs) == 0)
+		{
+			ids->remove(ids, id);
+			entry->certs->destroy(entry->certs);
+			entry->id->destroy(entry->id);
+			free(entry);
+		}
+	}
+}
+
+/**
+ * Add a certificate to the index, or to the unindexed fallback lists
+ */
+static void index_cert(private_mem_cred_t *this, bool trusted,
+					   certificate_t *cert)
+{
+	linked_list_t *ids;
+	enumerator_t *enumerator;
+	identification_t *id;
+
+	ids = linked_list_create();
+	if (create_index_ids(cert, ids))
+	{
+		enumerator = ids->create_enumerator(ids);
+		while (enumerator->enumerate(enumerator, &id))
+		{
+			index_cert_id(this->untrusted_ids, id, cert);
+			if (trusted)
+			{
+				index_cert_id(this->trusted_ids, id, cert);
+			}
+		}
+		enumerator->destroy(enumerator);
+	}
+	else
+	{
+		this->unindexed_untrusted->insert_first(this->unindexed_untrusted,
+												cert);
+		if (trusted)
+		{
+			this->unindexed_trusted->insert_first(this->unindexed_trusted,
+												  cert);
+		}
+	}
+	ids->destroy_offset(ids, offsetof(identification_t, destroy));
+}
+
+/**
+ * Remove a certificate from the index
+ */
+static void unindex_cert(private_mem_cred_t *this, certificate_t *cert)
+{
+	linked_list_t *ids;
+	enumerator_t *enumerator;
+	identification_t *id;
+
+	ids = linked_list_create();
+	if (create_index_ids(cert, ids))
+	{
+		enumerator = ids->create_enumerator(ids);
+		while (enumerator->enumerate(enumerator, &id))
+		{
+			unindex_cert_id(this->untrusted_ids, id, cert);
+			unindex_cert_id(this->trusted_ids, id, cert);
+		}
+		enumerator->destroy(enumerator);
+	}
+	this->unindexed_untrusted->remove(this->unindexed_untrusted, cert, NULL);
+	this->unindexed_trusted->remove(this->unindexed_trusted, cert, NULL);
+	ids->destroy_offset(ids, offsetof(identification_t, destroy));
+}
+
+/**
+ * Remove all entries from the certificate index
+ */
+static void flush_cert_index(private_mem_cred_t *this)
+{
+	hashtable_t *tables[] = { this->trusted_ids, this->untrusted_ids };
+	enumerator_t *enumerator;
+	index_entry_t *entry;
+	int i;
+
+	for (i = 0; i < countof(tables); i++)
+	{
+		enumerator = tables[i]->create_enumerator(tables[i]);
+		while (enumerator->enumerate(enumerator, NULL, &entry))
+		{
+			tables[i]->remove_at(tables[i], enumerator);
+			entry->certs->destroy(entry->certs);
+			entry->id->destroy(entry->id);
+			free(entry);
+		}
+		enumerator->destroy(enumerator);
+	}
+}
+
+/**
+ * Add a private key to the fingerprint index
+ */
+static void index_key(private_mem_cred_t *this, private_key_t *key)
+{
+	cred_encoding_type_t type;
+	key_index_entry_t *entry;
+	chunk_t fp;
+	bool found = FALSE;
+
+	for (type = 0; type < KEYID_MAX; type++)
+	{
+		if (key->get_fingerprint(key, type, &fp))
+		{
+			entry = this->key_fps->get(this->key_fps, &fp);
+			if (!entry)
+			{
+				INIT(entry,
+					.fp = chunk_clone(fp),
+					.keys = linked_list_create(),
+				);
+				this->key_fps->put(this->key_fps, &entry->fp, entry);
+			}
+			entry->keys->insert_last(entry->keys, key);
+			found = TRUE;
+		}
+	}
+	if (!found)
+	{
+		this->unindexed_keys->insert_first(this->unindexed_keys, key);
+	}
+}
+
+/**
+ * Remove a private key from the fingerprint index
+ */
+static void unindex_key(private_mem_cred_t *this, private_key_t *key)
+{
+	cred_encoding_type_t type;
+	key_index_entry_t *entry;
+	chunk_t fp;
+
+	for (type = 0; type < KEYID_MAX; type++)
+	{
+		if (key->get_fingerprint(key, type, &fp))
+		{
+			entry = this->key_fps->get(this->key_fps, &fp);
+			if (entry)
+			{
+				entry->keys->remove(entry->keys, key, NULL);
+				if (entry->keys->get_count(entry->keys) == 0)
+				{
+					this->key_fps->remove(this->key_fps, &fp);
+					entry->keys->destroy(entry->keys);
+					free(entry->fp.ptr);
+					free(entry);
+				}
+			}
+		}
+	}
+	this->unindexed_keys->remove(this->unindexed_keys, key, NULL);
+}
+
+/**
+ * Remove all entries from the private key index
+ */
+static void flush_key_index(private_mem_cred_t *this)
+{
+	enumerator_t *enumerator;
+	key_index_entry_t *entry;
+
+	enumerator = this->key_fps->create_enumerator(this->key_fps);
+	while (enumerator->enumerate(enumerator, NULL, &entry))
+	{
+		this->key_fps->remove_at(this->key_fps, enumerator);
+		entry->keys->destroy(entry->keys);
+		free(entry->fp.ptr);
+		free(entry);
+	}
+	enumerator->destroy(enumerator);
+}
+
 /**
  * Data for the certificate enumerator
  */
@@ -71,6 +541,7 @@ typedef struct {
 	certificate_type_t cert;
 	key_type_t key;
 	identification_t *id;
+	linked_list_t *candidates;
 } cert_data_t;
 
 /**
@@ -78,6 +549,7 @@ typedef struct {
  */
 static void cert_data_destroy(cert_data_t *data)
 {
+	DESTROY_IF(data->candidates);
 	data->lock->unlock(data->lock);
 	free(data);
 }
@@ -120,6 +592,26 @@ static bool certs_filter(cert_data_t *data, certificate_t **in, certificate_t **
 	return FALSE;
 }
 
+/**
+ * Check if a queried identity may be resolved through the index. Identity
+ * types matching with wildcard support need a linear search if the query
+ * actually contains one.
+ */
+static bool is_indexable(identification_t *id)
+{
+	switch (id->get_type(id))
+	{
+		case ID_ANY:
+			return FALSE;
+		case ID_FQDN:
+		case ID_RFC822_ADDR:
+		case ID_DER_ASN1_DN:
+			return !id->contains_wildcards(id);
+		default:
+			return TRUE;
+	}
+}
+
 METHOD(credential_set_t, create_cert_enumerator, enumerator_t*,
 	private_mem_cred_t *this, certificate_type_t cert, key_type_t key,
 	identification_t *id, bool trusted)
@@ -134,7 +626,44 @@ METHOD(credential_set_t, create_cert_enumerator, enumerator_t*,
 		.id = id,
 	);
 	this->lock->read_lock(this->lock);
-	if (trusted)
+	if (id && is_indexable(id))
+	{
+		hashtable_t *ids;
+		linked_list_t *unindexed;
+		index_entry_t *entry;
+		enumerator_t *certs;
+		certificate_t *current;
+
+		if (trusted)
+		{
+			ids = this->trusted_ids;
+			unindexed = this->unindexed_trusted;
+		}
+		else
+		{
+			ids = this->untrusted_ids;
+			unindexed = this->unindexed_untrusted;
+		}
+		data->candidates = linked_list_create();
+		entry = ids->get(ids, id);
+		if (entry)
+		{
+			certs = entry->certs->create_enumerator(entry->certs);
+			while (certs->enumerate(certs, &current))
+			{
+				data->candidates->insert_last(data->candidates, current);
+			}
+			certs->destroy(certs);
+		}
+		certs = unindexed->create_enumerator(unindexed);
+		while (certs->enumerate(certs, &current))
+		{
+			data->candidates->insert_last(data->candidates, current);
+		}
+		certs->destroy(certs);
+		enumerator = data->candidates->create_enumerator(data->candidates);
+	}
+	else if (trusted)
 	{
 		enumerator = this->trusted->create_enumerator(this->trusted);
 	}
@@ -174,6 +703,7 @@ static certificate_t *add_cert_internal(private_mem_cred_t *this, bool trusted,
 			this->trusted->insert_first(this->trusted, cert->get_ref(cert));
 		}
 		this->untrusted->insert_first(this->untrusted, cert->get_ref(cert));
+		index_cert(this, trusted, cert);
 	}
 	this->lock->unlock(this->lock);
 	return cert;
@@ -250,6 +780,8 @@ METHOD(mem_cred_t, add_crl, bool,
 				if (new)
 				{
 					this->untrusted->remove_at(this->untrusted, enumerator);
+					unindex_cert(this, current);
+					current->destroy(current);
 				}
 				else
 				{
@@ -264,6 +796,7 @@ METHOD(mem_cred_t, add_crl, bool,
 	if (new)
 	{
 		this->untrusted->insert_first(this->untrusted, cert);
+		index_cert(this, FALSE, cert);
 	}
 	this->lock->unlock(this->lock);
 	return new;
@@ -276,6 +809,7 @@ typedef struct {
 	rwlock_t *lock;
 	key_type_t type;
 	identification_t *id;
+	linked_list_t *candidates;
 } key_data_t;
 
 /**
@@ -283,6 +817,7 @@ typedef struct {
  */
 static void key_data_destroy(key_data_t *data)
 {
+	DESTROY_IF(data->candidates);
 	data->lock->unlock(data->lock);
 	free(data);
 }
@@ -311,6 +846,7 @@ METHOD(credential_set_t, create_private_enumerator, enumerator_t*,
 	private_mem_cred_t *this, key_type_t type, identification_t *id)
 {
 	key_data_t *data;
+	enumerator_t *enumerator;
 
 	INIT(data,
 		.lock = this->lock,
@@ -318,8 +854,40 @@ METHOD(credential_set_t, create_private_enumerator, enumerator_t*,
 		.id = id,
 	);
 	this->lock->read_lock(this->lock);
-	return enumerator_create_filter(this->keys->create_enumerator(this->keys),
-							(void*)key_filter, data, (void*)key_data_destroy);
+	if (id && id->get_encoding(id).len)
+	{
+		key_index_entry_t *entry;
+		enumerator_t *keys;
+		private_key_t *current;
+		chunk_t fp;
+
+		/* keys match by fingerprint only, serve them from the index */
+		data->candidates = linked_list_create();
+		fp = id->get_encoding(id);
+		entry = this->key_fps->get(this->key_fps, &fp);
+		if (entry)
+		{
+			keys = entry->keys->create_enumerator(entry->keys);
+			while (keys->enumerate(keys, &current))
+			{
+				data->candidates->insert_last(data->candidates, current);
+			}
+			keys->destroy(keys);
+		}
+		keys = this->unindexed_keys->create_enumerator(this->unindexed_keys);
+		while (keys->enumerate(keys, &current))
+		{
+			data->candidates->insert_last(data->candidates, current);
+		}
+		keys->destroy(keys);
+		enumerator = data->candidates->create_enumerator(data->candidates);
+	}
+	else
+	{
+		enumerator = this->keys->create_enumerator(this->keys);
+	}
+	return enumerator_create_filter(enumerator, (void*)key_filter, data,
+									(void*)key_data_destroy);
 }
 
 METHOD(mem_cred_t, add_key, void,
@@ -336,6 +904,7 @@ METHOD(mem_cred_t, add_key, void,
 		if (current->equals(current, key))
 		{
 			this->keys->remove_at(this->keys, enumerator);
+			unindex_key(this, current);
 			current->destroy(current);
 			break;
 		}
@@ -343,6 +912,7 @@ METHOD(mem_cred_t, add_key, void,
 	enumerator->destroy(enumerator);
 
 	this->keys->insert_first(this->keys, key);
+	index_key(this, key);
 
 	this->lock->unlock(this->lock);
 }
@@ -645,10 +1215,13 @@ METHOD(credential_set_t, create_cdp_enumerator, enumerator_t*,
 
 static void reset_secrets(private_mem_cred_t *this)
 {
+	flush_key_index(this);
 	this->keys->destroy_offset(this->keys, offsetof(private_key_t, destroy));
 	this->shared->destroy_function(this->shared, (void*)shared_entry_destroy);
+	this->unindexed_keys->destroy(this->unindexed_keys);
 	this->keys = linked_list_create();
 	this->shared = linked_list_create();
+	this->unindexed_keys = linked_list_create();
 }
 
 METHOD(mem_cred_t, replace_secrets, void,
@@ -669,6 +1242,7 @@ METHOD(mem_cred_t, replace_secrets, void,
 		while (enumerator->enumerate(enumerator, &key))
 		{
 			this->keys->insert_last(this->keys, key->get_ref(key));
+			index_key(this, key);
 		}
 		enumerator->destroy(enumerator);
 		enumerator = other->shared->create_enumerator(other->shared);
@@ -688,12 +1262,17 @@ METHOD(mem_cred_t, replace_secrets, void,
 		while (other->keys->remove_first(other->keys, (void**)&key) == SUCCESS)
 		{
 			this->keys->insert_last(this->keys, key);
+			index_key(this, key);
 		}
 		while (other->shared->remove_first(other->shared,
 										  (void**)&entry) == SUCCESS)
 		{
 			this->shared->insert_last(this->shared, entry);
 		}
+		/* drop the index references to the moved keys */
+		flush_key_index(other);
+		other->unindexed_keys->destroy(other->unindexed_keys);
+		other->unindexed_keys = linked_list_create();
 	}
 	this->lock->unlock(this->lock);
 }
@@ -710,14 +1289,19 @@ METHOD(mem_cred_t, clear_, void,
 	private_mem_cred_t *this)
 {
 	this->lock->write_lock(this->lock);
+	flush_cert_index(this);
 	this->trusted->destroy_offset(this->trusted,
 								  offsetof(certificate_t, destroy));
 	this->untrusted->destroy_offset(this->untrusted,
 									offsetof(certificate_t, destroy));
 	this->cdps->destroy_function(this->cdps, (void*)cdp_destroy);
+	this->unindexed_trusted->destroy(this->unindexed_trusted);
+	this->unindexed_untrusted->destroy(this->unindexed_untrusted);
 	this->trusted = linked_list_create();
 	this->untrusted = linked_list_create();
 	this->cdps = linked_list_create();
+	this->unindexed_trusted = linked_list_create();
+	this->unindexed_untrusted = linked_list_create();
 	this->lock->unlock(this->lock);
 
 	clear_secrets(this);
@@ -732,6 +1316,12 @@ METHOD(mem_cred_t, destroy, void,
 	this->keys->destroy(this->keys);
 	this->shared->destroy(this->shared);
 	this->cdps->destroy(this->cdps);
+	this->trusted_ids->destroy(this->trusted_ids);
+	this->untrusted_ids->destroy(this->untrusted_ids);
+	this->unindexed_trusted->destroy(this->unindexed_trusted);
+	this->unindexed_untrusted->destroy(this->unindexed_untrusted);
+	this->key_fps->destroy(this->key_fps);
+	this->unindexed_keys->destroy(this->unindexed_keys);
 	this->lock->destroy(this->lock);
 	free(this);
 }
@@ -770,6 +1360,15 @@ mem_cred_t *mem_cred_create()
 		.keys = linked_list_create(),
 		.shared = linked_list_create(),
 		.cdps = linked_list_create(),
+		.trusted_ids = hashtable_create((hashtable_hash_t)id_hash,
+										(hashtable_equals_t)id_equals, 8),
+		.untrusted_ids = hashtable_create((hashtable_hash_t)id_hash,
+										  (hashtable_equals_t)id_equals, 8),
+		.unindexed_trusted = linked_list_create(),
+		.unindexed_untrusted = linked_list_create(),
+		.key_fps = hashtable_create((hashtable_hash_t)fp_hash,
+									(hashtable_equals_t)fp_equals, 8),
+		.unindexed_keys = linked_list_create(),
 		.lock = rwlock_create(RWLOCK_TYPE_DEFAULT),
 	);
 
@@ -169,6 +169,39 @@ METHOD(aead_t, destroy, void,
 	free(this);
 }
 
+/**
+ * See header
+ */
+bool aead_encrypt_batch_generic(aead_t *this, chunk_t *plain, chunk_t *assoc,
+								chunk_t *iv, u_int count)
+{
+	u_int i;
+
+	for (i = 0; i < count; i++)
+	{
+		if (!this->encrypt(this, plain[i], assoc[i], iv[i], NULL))
+		{
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/**
+ * See header
+ */
+void aead_decrypt_batch_generic(aead_t *this, chunk_t *encrypted,
+								chunk_t *assoc, chunk_t *iv, bool *results,
+								u_int count)
+{
+	u_int i;
+
+	for (i = 0; i < count; i++)
+	{
+		results[i] = this->decrypt(this, encrypted[i], assoc[i], iv[i], NULL);
+	}
+}
+
 /**
  * See header
  */
@@ -180,6 +213,8 @@ aead_t *aead_create(crypter_t *crypter, signer_t *signer)
 		.public = {
 			.encrypt = _encrypt,
 			.decrypt = _decrypt,
+			.encrypt_batch = aead_encrypt_batch_generic,
+			.decrypt_batch = aead_decrypt_batch_generic,
 			.get_block_size = _get_block_size,
 			.get_icv_size = _get_icv_size,
 			.get_iv_size = _get_iv_size,
@@ -71,6 +71,41 @@ struct aead_t {
 	bool (*decrypt)(aead_t *this, chunk_t encrypted, chunk_t assoc, chunk_t iv,
 					chunk_t *plain);
 
+	/**
+	 * Encrypt and sign a batch of independent data chunks inline.
+	 *
+	 * Each chunk is processed as by an inline encrypt() call, i.e. it must
+	 * be a multiple of get_block_size() and have space for get_icv_size()
+	 * additional bytes for the silently appended ICV. Implementations may
+	 * pipeline the individual operations to exploit instruction level
+	 * parallelism of modern ciphers.
+	 *
+	 * @param plain			array of chunks to encrypt and sign
+	 * @param assoc			array of associated data chunks to sign
+	 * @param iv			array of initialization vectors
+	 * @param count			number of entries in the arrays
+	 * @return				TRUE if all chunks were encrypted successfully
+	 */
+	bool (*encrypt_batch)(aead_t *this, chunk_t *plain, chunk_t *assoc,
+						  chunk_t *iv,
+						  u_int count) __attribute__((warn_unused_result));
+
+	/**
+	 * Decrypt and verify a batch of independent data chunks inline.
+	 *
+	 * Each chunk is processed as by an inline decrypt() call. A failed ICV
+	 * verification of one chunk does not affect the others, the per-chunk
+	 * result is reported in results.
+	 *
+	 * @param encrypted		array of chunks to decrypt and verify
+	 * @param assoc			array of associated data chunks to verify
+	 * @param iv			array of initialization vectors
+	 * @param results		array receiving the per-chunk verification result
+	 * @param count			number of entries in the arrays
+	 */
+	void (*decrypt_batch)(aead_t *this, chunk_t *encrypted, chunk_t *assoc,
+						  chunk_t *iv, bool *results, u_int count);
+
 	/**
 	 * Get the block size for encryption.
 	 *
@@ -139,4 +174,23 @@ struct aead_t {
  */
 aead_t *aead_create(crypter_t *crypter, signer_t *signer);
 
+/**
+ * Generic encrypt_batch() implementation, processing chunks sequentially.
+ *
+ * Can be used as method by aead_t implementations without native support
+ * for batched operation.
+ */
+bool aead_encrypt_batch_generic(aead_t *this, chunk_t *plain, chunk_t *assoc,
+								chunk_t *iv, u_int count);
+
+/**
+ * Generic decrypt_batch() implementation, processing chunks sequentially.
+ *
+ * Can be used as method by aead_t implementations without native support
+ * for batched operation.
+ */
+void aead_decrypt_batch_generic(aead_t *this, chunk_t *encrypted,
+								chunk_t *assoc, chunk_t *iv, bool *results,
+								u_int count);
+
 #endif /** AEAD_H_ @}*/
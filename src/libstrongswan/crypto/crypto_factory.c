@@ -17,9 +17,12 @@
 #include "crypto_factory.h"
 
 #include <utils/debug.h>
+#include <crypto/transform_pool.h>
+#include <crypto/dh_pool.h>
 #include <threading/rwlock.h>
 #include <collections/linked_list.h>
 #include <crypto/crypto_tester.h>
+#include <processing/jobs/callback_job.h>
 #include <utils/test.h>
 
 const char *default_plugin_name = "default";
@@ -42,6 +45,16 @@ struct entry_t {
 	 */
 	u_int speed;
 
+	/**
+	 * test vectors verified, or no verification required
+	 */
+	bool tested;
+
+	/**
+	 * deferred test vectors failed, never use this entry
+	 */
+	bool failed;
+
 	/**
 	 * constructor
 	 */
@@ -120,6 +133,16 @@ struct private_crypto_factory_t {
 	 */
 	bool test_on_add;
 
+	/**
+	 * whether to defer "on_add" testing to first use/a background job
+	 */
+	bool test_deferred;
+
+	/**
+	 * whether the background job testing deferred entries was queued
+	 */
+	bool sweep_queued;
+
 	/**
 	 * whether to test algorithms on each crypto primitive construction
 	 */
@@ -139,8 +162,91 @@ struct private_crypto_factory_t {
 	 * rwlock to lock access to modules
 	 */
 	rwlock_t *lock;
+
+	/**
+	 * pool of reusable transform instances, NULL if pooling is disabled
+	 */
+	transform_pool_t *pool;
+
+	/**
+	 * pool of precomputed DH keypairs, NULL if precomputation is disabled
+	 */
+	dh_pool_t *dh_pool;
 };
 
+/**
+ * Whether "on_add" testing of new entries is deferred to first use
+ */
+static bool deferred_testing(private_crypto_factory_t *this)
+{
+	return this->test_on_add && this->test_deferred && !this->bench;
+}
+
+/**
+ * Run the full test vector set for the given entry, using the tester
+ * matching the list it is registered on.
+ */
+static bool test_entry(private_crypto_factory_t *this, linked_list_t *list,
+					   entry_t *entry)
+{
+	if (list == this->crypters)
+	{
+		return this->tester->test_crypter(this->tester, entry->algo, 0,
+							entry->create_crypter, NULL, entry->plugin_name);
+	}
+	if (list == this->aeads)
+	{
+		return this->tester->test_aead(this->tester, entry->algo, 0, 0,
+							entry->create_aead, NULL, entry->plugin_name);
+	}
+	if (list == this->signers)
+	{
+		return this->tester->test_signer(this->tester, entry->algo,
+							entry->create_signer, NULL, entry->plugin_name);
+	}
+	if (list == this->hashers)
+	{
+		return this->tester->test_hasher(this->tester, entry->algo,
+							entry->create_hasher, NULL, entry->plugin_name);
+	}
+	if (list == this->prfs)
+	{
+		return this->tester->test_prf(this->tester, entry->algo,
+							entry->create_prf, NULL, entry->plugin_name);
+	}
+	if (list == this->rngs)
+	{
+		return this->tester->test_rng(this->tester, entry->algo,
+							entry->create_rng, NULL, entry->plugin_name);
+	}
+	return TRUE;
+}
+
+/**
+ * Run the deferred test vectors for an entry on first use, if still
+ * required. Returns FALSE if the entry failed its vectors and must not
+ * be used.
+ *
+ * Called with the read lock held. The flags are idempotent booleans, so
+ * concurrent first users at worst run the vectors more than once.
+ */
+static bool check_entry_tested(private_crypto_factory_t *this,
+							   linked_list_t *list, entry_t *entry)
+{
+	if (!entry->tested && !entry->failed)
+	{
+		if (test_entry(this, list, entry))
+		{
+			entry->tested = TRUE;
+		}
+		else
+		{
+			entry->failed = TRUE;
+		}
+	}
+	return !entry->failed;
+}
+
 METHOD(crypto_factory_t, create_crypter, crypter_t*,
 	private_crypto_factory_t *this, encryption_algorithm_t algo,
 	size_t key_size)
@@ -149,12 +255,24 @@ METHOD(crypto_factory_t, create_crypter, crypter_t*,
 	entry_t *entry;
 	crypter_t *crypter = NULL;
 
+	if (this->pool)
+	{
+		crypter = this->pool->get_crypter(this->pool, algo, key_size);
+		if (crypter)
+		{
+			return crypter;
+		}
+	}
 	this->lock->read_lock(this->lock);
 	enumerator = this->crypters->create_enumerator(this->crypters);
 	while (enumerator->enumerate(enumerator, &entry))
 	{
 		if (entry->algo == algo)
 		{
+			if (!check_entry_tested(this, this->crypters, entry))
+			{
+				continue;
+			}
 			if (this->test_on_create &&
 				!this->tester->test_crypter(this->tester, algo, key_size,
 											entry->create_crypter, NULL,
@@ -171,6 +289,10 @@ METHOD(crypto_factory_t, create_crypter, crypter_t*,
 	}
 	enumerator->destroy(enumerator);
 	this->lock->unlock(this->lock);
+	if (crypter && this->pool)
+	{
+		crypter = this->pool->wrap_crypter(this->pool, algo, key_size, crypter);
+	}
 	return crypter;
 }
 
@@ -182,12 +304,24 @@ METHOD(crypto_factory_t, create_aead, aead_t*,
 	entry_t *entry;
 	aead_t *aead = NULL;
 
+	if (this->pool)
+	{
+		aead = this->pool->get_aead(this->pool, algo, key_size, salt_size);
+		if (aead)
+		{
+			return aead;
+		}
+	}
 	this->lock->read_lock(this->lock);
 	enumerator = this->aeads->create_enumerator(this->aeads);
 	while (enumerator->enumerate(enumerator, &entry))
 	{
 		if (entry->algo == algo)
 		{
+			if (!check_entry_tested(this, this->aeads, entry))
+			{
+				continue;
+			}
 			if (this->test_on_create &&
 				!this->tester->test_aead(this->tester, algo, key_size,
 										 salt_size, entry->create_aead, NULL,
@@ -204,6 +338,11 @@ METHOD(crypto_factory_t, create_aead, aead_t*,
 	}
 	enumerator->destroy(enumerator);
 	this->lock->unlock(this->lock);
+	if (aead && this->pool)
+	{
+		aead = this->pool->wrap_aead(this->pool, algo, key_size, salt_size,
+									 aead);
+	}
 	return aead;
 }
 
@@ -220,6 +359,10 @@ METHOD(crypto_factory_t, create_signer, signer_t*,
 	{
 		if (entry->algo == algo)
 		{
+			if (!check_entry_tested(this, this->signers, entry))
+			{
+				continue;
+			}
 			if (this->test_on_create &&
 				!this->tester->test_signer(this->tester, algo,
 										   entry->create_signer, NULL,
@@ -246,12 +389,24 @@ METHOD(crypto_factory_t, create_hasher, hasher_t*,
 	entry_t *entry;
 	hasher_t *hasher = NULL;
 
+	if (this->pool)
+	{
+		hasher = this->pool->get_hasher(this->pool, algo);
+		if (hasher)
+		{
+			return hasher;
+		}
+	}
 	this->lock->read_lock(this->lock);
 	enumerator = this->hashers->create_enumerator(this->hashers);
 	while (enumerator->enumerate(enumerator, &entry))
 	{
 		if (entry->algo == algo)
 		{
+			if (!check_entry_tested(this, this->hashers, entry))
+			{
+				continue;
+			}
 			if (this->test_on_create &&
 				!this->tester->test_hasher(this->tester, algo,
 										   entry->create_hasher, NULL,
@@ -268,6 +423,10 @@ METHOD(crypto_factory_t, create_hasher, hasher_t*,
 	}
 	enumerator->destroy(enumerator);
 	this->lock->unlock(this->lock);
+	if (hasher && this->pool)
+	{
+		hasher = this->pool->wrap_hasher(this->pool, algo, hasher);
+	}
 	return hasher;
 }
 
@@ -278,12 +437,24 @@ METHOD(crypto_factory_t, create_prf, prf_t*,
 	entry_t *entry;
 	prf_t *prf = NULL;
 
+	if (this->pool)
+	{
+		prf = this->pool->get_prf(this->pool, algo);
+		if (prf)
+		{
+			return prf;
+		}
+	}
 	this->lock->read_lock(this->lock);
 	enumerator = this->prfs->create_enumerator(this->prfs);
 	while (enumerator->enumerate(enumerator, &entry))
 	{
 		if (entry->algo == algo)
 		{
+			if (!check_entry_tested(this, this->prfs, entry))
+			{
+				continue;
+			}
 			if (this->test_on_create &&
 				!this->tester->test_prf(this->tester, algo,
 										entry->create_prf, NULL,
@@ -300,6 +471,10 @@ METHOD(crypto_factory_t, create_prf, prf_t*,
 	}
 	enumerator->destroy(enumerator);
 	this->lock->unlock(this->lock);
+	if (prf && this->pool)
+	{
+		prf = this->pool->wrap_prf(this->pool, algo, prf);
+	}
 	return prf;
 }
 
@@ -316,6 +491,10 @@ METHOD(crypto_factory_t, create_rng, rng_t*,
 	{	/* find the best matching quality, but at least as good as requested */
 		if (entry->algo >= quality)
 		{
+			if (!check_entry_tested(this, this->rngs, entry))
+			{
+				continue;
+			}
 			if (this->test_on_create &&
 				!this->tester->test_rng(this->tester, quality,
 										entry->create_rng, NULL,
@@ -370,6 +549,14 @@ METHOD(crypto_factory_t, create_dh, diffie_hellman_t*,
 		p = va_arg(args, chunk_t);
 		va_end(args);
 	}
+	else if (this->dh_pool)
+	{
+		diffie_hellman = this->dh_pool->get(this->dh_pool, group);
+		if (diffie_hellman)
+		{
+			return diffie_hellman;
+		}
+	}
 
 	this->lock->read_lock(this->lock);
 	enumerator = this->dhs->create_enumerator(this->dhs);
@@ -389,6 +576,92 @@ METHOD(crypto_factory_t, create_dh, diffie_hellman_t*,
 	return diffie_hellman;
 }
 
+/**
+ * Precompute a DH keypair for the pool, bypassing the pool itself
+ */
+static diffie_hellman_t *create_dh_pooled(private_crypto_factory_t *this,
+										  diffie_hellman_group_t group)
+{
+	enumerator_t *enumerator;
+	entry_t *entry;
+	diffie_hellman_t *diffie_hellman = NULL;
+
+	this->lock->read_lock(this->lock);
+	enumerator = this->dhs->create_enumerator(this->dhs);
+	while (enumerator->enumerate(enumerator, &entry))
+	{
+		if (entry->algo == group)
+		{
+			diffie_hellman = entry->create_dh(group, chunk_empty, chunk_empty);
+			if (diffie_hellman)
+			{
+				break;
+			}
+		}
+	}
+	enumerator->destroy(enumerator);
+	this->lock->unlock(this->lock);
+	return diffie_hellman;
+}
+
+/**
+ * Background job testing all entries whose vector verification was deferred,
+ * removing those that failed.
+ */
+static job_requeue_t sweep_untested(private_crypto_factory_t *this)
+{
+	linked_list_t *lists[] = { this->crypters, this->aeads, this->signers,
+							   this->hashers, this->prfs, this->rngs };
+	enumerator_t *enumerator;
+	entry_t *entry;
+	bool more;
+	int i;
+
+	this->lock->write_lock(this->lock);
+	/* cleared up front, so entries added while we sweep requeue the job and
+	 * do not stay untested if we happen to miss them */
+	this->sweep_queued = FALSE;
+	this->lock->unlock(this->lock);
+
+	for (i = 0; i < countof(lists); i++)
+	{
+		do
+		{	/* test one entry at a time, so that the lock is not held across
+			 * the whole sweep and writers can interleave */
+			more = FALSE;
+			this->lock->read_lock(this->lock);
+			enumerator = lists[i]->create_enumerator(lists[i]);
+			while (enumerator->enumerate(enumerator, &entry))
+			{
+				if (!entry->tested && !entry->failed)
+				{
+					check_entry_tested(this, lists[i], entry);
+					more = TRUE;
+					break;
+				}
+			}
+			enumerator->destroy(enumerator);
+			this->lock->unlock(this->lock);
+		}
+		while (more);
+
+		this->lock->write_lock(this->lock);
+		enumerator = lists[i]->create_enumerator(lists[i]);
+		while (enumerator->enumerate(enumerator, &entry))
+		{
+			if (entry->failed)
+			{
+				lists[i]->remove_at(lists[i], enumerator);
+				this->test_failures++;
+				free(entry);
+			}
+		}
+		enumerator->destroy(enumerator);
+		this->lock->unlock(this->lock);
+	}
+	return JOB_REQUEUE_NONE;
+}
+
 /**
  * Insert an algorithm entry to a list
  *
@@ -409,6 +682,8 @@ static void add_entry(private_crypto_factory_t *this, linked_list_t *list,
 		.algo = algo,
 		.plugin_name = plugin_name,
 		.speed = speed,
+		.tested = !deferred_testing(this) ||
+				  list == this->nonce_gens || list == this->dhs,
 	);
 	entry->create = create;
 
@@ -434,6 +709,14 @@ static void add_entry(private_crypto_factory_t *this, linked_list_t *list,
 		}
 	}
 	list->insert_before(list, enumerator, entry);
+	if (!entry->tested && !this->sweep_queued)
+	{	/* queued once here, it runs as soon as processor threads exist */
+		this->sweep_queued = TRUE;
+		lib->processor->queue_job(lib->processor,
+			(job_t*)callback_job_create_with_prio(
+							(callback_job_cb_t)sweep_untested, this, NULL,
+							(callback_job_cancel_t)return_false, JOB_PRIO_LOW));
+	}
 	enumerator->destroy(enumerator);
 	this->lock->unlock(this->lock);
 }
@@ -444,7 +727,7 @@ METHOD(crypto_factory_t, add_crypter, bool,
 {
 	u_int speed = 0;
 
-	if (!this->test_on_add ||
+	if (!this->test_on_add || deferred_testing(this) ||
 		this->tester->test_crypter(this->tester, algo, 0, create,
 								   this->bench ? &speed : NULL,	plugin_name))
 	{
@@ -473,6 +756,10 @@ METHOD(crypto_factory_t, remove_crypter, void,
 	}
 	enumerator->destroy(enumerator);
 	this->lock->unlock(this->lock);
+	if (this->pool)
+	{	/* don't hand out pooled instances of unregistered algorithms */
+		this->pool->flush(this->pool);
+	}
 }
 
 METHOD(crypto_factory_t, add_aead, bool,
@@ -481,7 +768,7 @@ METHOD(crypto_factory_t, add_aead, bool,
 {
 	u_int speed = 0;
 
-	if (!this->test_on_add ||
+	if (!this->test_on_add || deferred_testing(this) ||
 		this->tester->test_aead(this->tester, algo, 0, 0, create,
 								this->bench ? &speed : NULL, plugin_name))
 	{
@@ -510,6 +797,10 @@ METHOD(crypto_factory_t, remove_aead, void,
 	}
 	enumerator->destroy(enumerator);
 	this->lock->unlock(this->lock);
+	if (this->pool)
+	{	/* don't hand out pooled instances of unregistered algorithms */
+		this->pool->flush(this->pool);
+	}
 }
 
 METHOD(crypto_factory_t, add_signer, bool,
@@ -518,7 +809,7 @@ METHOD(crypto_factory_t, add_signer, bool,
 {
 	u_int speed = 0;
 
-	if (!this->test_on_add ||
+	if (!this->test_on_add || deferred_testing(this) ||
 		this->tester->test_signer(this->tester, algo, create,
 								  this->bench ? &speed : NULL, plugin_name))
 	{
@@ -555,7 +846,7 @@ METHOD(crypto_factory_t, add_hasher, bool,
 {
 	u_int speed = 0;
 
-	if (!this->test_on_add ||
+	if (!this->test_on_add || deferred_testing(this) ||
 		this->tester->test_hasher(this->tester, algo, create,
 								  this->bench ? &speed : NULL, plugin_name))
 	{
@@ -584,6 +875,10 @@ METHOD(crypto_factory_t, remove_hasher, void,
 	}
 	enumerator->destroy(enumerator);
 	this->lock->unlock(this->lock);
+	if (this->pool)
+	{	/* don't hand out pooled instances of unregistered algorithms */
+		this->pool->flush(this->pool);
+	}
 }
 
 METHOD(crypto_factory_t, add_prf, bool,
@@ -592,7 +887,7 @@ METHOD(crypto_factory_t, add_prf, bool,
 {
 	u_int speed = 0;
 
-	if (!this->test_on_add ||
+	if (!this->test_on_add || deferred_testing(this) ||
 		this->tester->test_prf(this->tester, algo, create,
 							   this->bench ? &speed : NULL, plugin_name))
 	{
@@ -621,6 +916,10 @@ METHOD(crypto_factory_t, remove_prf, void,
 	}
 	enumerator->destroy(enumerator);
 	this->lock->unlock(this->lock);
+	if (this->pool)
+	{	/* don't hand out pooled instances of unregistered algorithms */
+		this->pool->flush(this->pool);
+	}
 }
 
 METHOD(crypto_factory_t, add_rng, bool,
@@ -629,7 +928,7 @@ METHOD(crypto_factory_t, add_rng, bool,
 {
 	u_int speed = 0;
 
-	if (!this->test_on_add ||
+	if (!this->test_on_add || deferred_testing(this) ||
 		this->tester->test_rng(this->tester, quality, create,
 							   this->bench ? &speed : NULL, plugin_name))
 	{
@@ -714,6 +1013,10 @@ METHOD(crypto_factory_t, remove_dh, void,
 	}
 	enumerator->destroy(enumerator);
 	this->lock->unlock(this->lock);
+	if (this->dh_pool)
+	{	/* don't hand out keypairs precomputed by unregistered providers */
+		this->dh_pool->flush(this->dh_pool);
+	}
 }
 
 /**
@@ -907,6 +1210,8 @@ METHOD(crypto_factory_t, get_test_vector_failures, u_int,
 METHOD(crypto_factory_t, destroy, void,
 	private_crypto_factory_t *this)
 {
+	DESTROY_IF(this->pool);
+	DESTROY_IF(this->dh_pool);
 	this->crypters->destroy(this->crypters);
 	this->aeads->destroy(this->aeads);
 	this->signers->destroy(this->signers);
@@ -926,6 +1231,7 @@ METHOD(crypto_factory_t, destroy, void,
 crypto_factory_t *crypto_factory_create()
 {
 	private_crypto_factory_t *this;
+	int count;
 
 	INIT(this,
 		.public = {
@@ -977,12 +1283,27 @@ crypto_factory_t *crypto_factory_create()
 		.tester = crypto_tester_create(),
 		.test_on_add = lib->settings->get_bool(lib->settings,
 								"%s.crypto_test.on_add", FALSE, lib->ns),
+		.test_deferred = lib->settings->get_bool(lib->settings,
+								"%s.crypto_test.deferred", FALSE, lib->ns),
 		.test_on_create = lib->settings->get_bool(lib->settings,
 								"%s.crypto_test.on_create", FALSE, lib->ns),
 		.bench = lib->settings->get_bool(lib->settings,
 								"%s.crypto_test.bench", FALSE, lib->ns),
 	);
 
+	if (lib->settings->get_bool(lib->settings,
+								"%s.crypto_pool", FALSE, lib->ns))
+	{
+		this->pool = transform_pool_create();
+	}
+	count = lib->settings->get_int(lib->settings,
+								"%s.dh_pool", 0, lib->ns);
+	if (count > 0)
+	{
+		this->dh_pool = dh_pool_create(count,
+							(dh_pool_constructor_t)create_dh_pooled, this);
+	}
+
 	return &this->public;
 }
 
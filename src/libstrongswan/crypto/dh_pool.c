@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Hochschule fuer Technik Rapperswil
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include "dh_pool.h"
+
+#include <utils/debug.h>
+#include <threading/mutex.h>
+#include <collections/linked_list.h>
+#include <processing/jobs/callback_job.h>
+
+typedef struct private_dh_pool_t private_dh_pool_t;
+typedef struct pool_entry_t pool_entry_t;
+
+/**
+ * Private data of an dh_pool_t object.
+ */
+struct private_dh_pool_t {
+
+	/**
+	 * Public dh_pool_t interface.
+	 */
+	dh_pool_t public;
+
+	/**
+	 * Number of keypairs to keep warm per group
+	 */
+	u_int size;
+
+	/**
+	 * Constructor to precompute a keypair
+	 */
+	dh_pool_constructor_t create;
+
+	/**
+	 * Data to supply to constructor
+	 */
+	void *data;
+
+	/**
+	 * List of groups to precompute for, as pool_entry_t
+	 */
+	linked_list_t *entries;
+
+	/**
+	 * TRUE while a refill job is queued or running
+	 */
+	bool scheduled;
+
+	/**
+	 * Mutex to lock entry list
+	 */
+	mutex_t *mutex;
+};
+
+/**
+ * Precomputed keypairs for a single group
+ */
+struct pool_entry_t {
+
+	/**
+	 * Group to precompute keypairs for
+	 */
+	diffie_hellman_group_t group;
+
+	/**
+	 * Precomputed keypairs, as diffie_hellman_t
+	 */
+	linked_list_t *keypairs;
+};
+
+/**
+ * Destroy a pool entry with all keypairs
+ */
+static void destroy_entry(pool_entry_t *entry)
+{
+	entry->keypairs->destroy_offset(entry->keypairs,
+									offsetof(diffie_hellman_t, destroy));
+	free(entry);
+}
+
+/**
+ * Find the entry for a group, optionally creating one
+ */
+static pool_entry_t *find_entry(private_dh_pool_t *this,
+								diffie_hellman_group_t group, bool create)
+{
+	enumerator_t *enumerator;
+	pool_entry_t *entry, *found = NULL;
+
+	enumerator = this->entries->create_enumerator(this->entries);
+	while (enumerator->enumerate(enumerator, &entry))
+	{
+		if (entry->group == group)
+		{
+			found = entry;
+			break;
+		}
+	}
+	enumerator->destroy(enumerator);
+
+	if (!found && create)
+	{
+		INIT(found,
+			.group = group,
+			.keypairs = linked_list_create(),
+		);
+		this->entries->insert_last(this->entries, found);
+	}
+	return found;
+}
+
+/**
+ * Find a group having less precomputed keypairs than the pool size
+ */
+static bool find_depleted(private_dh_pool_t *this,
+						  diffie_hellman_group_t *group)
+{
+	enumerator_t *enumerator;
+	pool_entry_t *entry;
+	bool found = FALSE;
+
+	enumerator = this->entries->create_enumerator(this->entries);
+	while (enumerator->enumerate(enumerator, &entry))
+	{
+		if (entry->keypairs->get_count(entry->keypairs) < this->size)
+		{
+			*group = entry->group;
+			found = TRUE;
+			break;
+		}
+	}
+	enumerator->destroy(enumerator);
+	return found;
+}
+
+/**
+ * Refill all depleted groups, computing keypairs outside of the lock
+ */
+static job_requeue_t refill(private_dh_pool_t *this)
+{
+	diffie_hellman_group_t group;
+	diffie_hellman_t *dh;
+	pool_entry_t *entry;
+	bool depleted;
+
+	while (TRUE)
+	{
+		this->mutex->lock(this->mutex);
+		depleted = find_depleted(this, &group);
+		if (!depleted)
+		{
+			this->scheduled = FALSE;
+		}
+		this->mutex->unlock(this->mutex);
+		if (!depleted)
+		{
+			break;
+		}
+
+		dh = this->create(this->data, group);
+
+		this->mutex->lock(this->mutex);
+		entry = find_entry(this, group, FALSE);
+		if (!dh)
+		{	/* no usable provider, stop precomputing for this group */
+			if (entry && this->entries->remove(this->entries, entry, NULL))
+			{
+				DBG1(DBG_LIB, "disabling DH precomputation for %N, "
+					 "no implementation found", diffie_hellman_group_names,
+					 group);
+				destroy_entry(entry);
+			}
+		}
+		else if (entry &&
+				 entry->keypairs->get_count(entry->keypairs) < this->size)
+		{
+			entry->keypairs->insert_last(entry->keypairs, dh);
+			dh = NULL;
+		}
+		this->mutex->unlock(this->mutex);
+
+		if (dh)
+		{	/* pool got filled or flushed while computing */
+			dh->destroy(dh);
+		}
+	}
+	return JOB_REQUEUE_NONE;
+}
+
+METHOD(dh_pool_t, get, diffie_hellman_t*,
+	private_dh_pool_t *this, diffie_hellman_group_t group)
+{
+	diffie_hellman_t *dh = NULL;
+	pool_entry_t *entry;
+	bool schedule = FALSE;
+
+	this->mutex->lock(this->mutex);
+	entry = find_entry(this, group, TRUE);
+	entry->keypairs->remove_first(entry->keypairs, (void**)&dh);
+	if (!this->scheduled)
+	{
+		this->scheduled = schedule = TRUE;
+	}
+	this->mutex->unlock(this->mutex);
+
+	if (schedule)
+	{
+		lib->processor->queue_job(lib->processor,
+			(job_t*)callback_job_create_with_prio((callback_job_cb_t)refill,
+										this, NULL, NULL, JOB_PRIO_LOW));
+	}
+	return dh;
+}
+
+METHOD(dh_pool_t, flush, void,
+	private_dh_pool_t *this)
+{
+	enumerator_t *enumerator;
+	pool_entry_t *entry;
+	linked_list_t *pending;
+	diffie_hellman_t *dh;
+
+	pending = linked_list_create();
+
+	this->mutex->lock(this->mutex);
+	enumerator = this->entries->create_enumerator(this->entries);
+	while (enumerator->enumerate(enumerator, &entry))
+	{
+		while (entry->keypairs->remove_first(entry->keypairs,
+											 (void**)&dh) == SUCCESS)
+		{
+			pending->insert_last(pending, dh);
+		}
+	}
+	enumerator->destroy(enumerator);
+	this->mutex->unlock(this->mutex);
+
+	pending->destroy_offset(pending, offsetof(diffie_hellman_t, destroy));
+}
+
+METHOD(dh_pool_t, destroy, void,
+	private_dh_pool_t *this)
+{
+	this->entries->destroy_function(this->entries, (void*)destroy_entry);
+	this->mutex->destroy(this->mutex);
+	free(this);
+}
+
+/*
+ * Described in header
+ */
+dh_pool_t *dh_pool_create(u_int size, dh_pool_constructor_t create,
+						  void *data)
+{
+	private_dh_pool_t *this;
+
+	INIT(this,
+		.public = {
+			.get = _get,
+			.flush = _flush,
+			.destroy = _destroy,
+		},
+		.size = size,
+		.create = create,
+		.data = data,
+		.entries = linked_list_create(),
+		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+	);
+
+	return &this->public;
+}
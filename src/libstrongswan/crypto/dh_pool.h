@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Hochschule fuer Technik Rapperswil
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/**
+ * @defgroup dh_pool dh_pool
+ * @{ @ingroup crypto
+ */
+
+#ifndef DH_POOL_H_
+#define DH_POOL_H_
+
+typedef struct dh_pool_t dh_pool_t;
+
+#include <library.h>
+#include <crypto/diffie_hellman.h>
+
+/**
+ * Constructor invoked by the pool to precompute a keypair.
+ *
+ * Must create the instance directly, without consulting the pool again.
+ *
+ * @param data		data supplied to dh_pool_create()
+ * @param group		group to create an instance for
+ * @return			DH implementation, NULL if not supported
+ */
+typedef diffie_hellman_t* (*dh_pool_constructor_t)(void *data,
+											diffie_hellman_group_t group);
+
+/**
+ * Pool of precomputed ephemeral Diffie-Hellman keypairs.
+ *
+ * The pool keeps a configured number of ready-to-use keypairs per group warm
+ * using a low priority background job. Computing the ephemeral exponentiation
+ * is the most expensive part of a DH exchange; handing out a precomputed
+ * keypair leaves only the shared secret computation on the hot path.
+ *
+ * Groups get warmed on demand: the first request for a group returns NULL,
+ * but registers it for precomputation.
+ */
+struct dh_pool_t {
+
+	/**
+	 * Get a precomputed keypair for a group, scheduling a refill.
+	 *
+	 * @param group		group to get an instance for
+	 * @return			precomputed DH implementation, NULL if none pooled
+	 */
+	diffie_hellman_t* (*get)(dh_pool_t *this, diffie_hellman_group_t group);
+
+	/**
+	 * Discard all precomputed keypairs, i.e. after unregistering a provider.
+	 */
+	void (*flush)(dh_pool_t *this);
+
+	/**
+	 * Destroy a dh_pool_t, destroying all pooled keypairs.
+	 */
+	void (*destroy)(dh_pool_t *this);
+};
+
+/**
+ * Create a dh_pool instance.
+ *
+ * @param size		number of keypairs to keep warm per group
+ * @param create	constructor to precompute a keypair
+ * @param data		data to supply to constructor
+ * @return			Diffie-Hellman pool
+ */
+dh_pool_t *dh_pool_create(u_int size, dh_pool_constructor_t create,
+						  void *data);
+
+#endif /** DH_POOL_H_ @}*/
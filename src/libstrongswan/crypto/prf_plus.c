@@ -57,6 +57,36 @@ struct private_prf_plus_t {
 	chunk_t buffer;
 };
 
+/**
+ * Derive the next PRF block to out, chaining over the previous block
+ */
+static bool expand(private_prf_plus_t *this, u_int8_t *previous, u_int8_t *out)
+{
+	if (!this->prf->get_bytes(this->prf,
+							  chunk_create(previous, this->buffer.len), NULL))
+	{
+		return FALSE;
+	}
+	if (this->counter)
+	{
+		if (!this->prf->get_bytes(this->prf, this->seed, NULL) ||
+			!this->prf->get_bytes(this->prf,
+								  chunk_from_thing(this->counter), out))
+		{
+			return FALSE;
+		}
+		this->counter++;
+	}
+	else
+	{
+		if (!this->prf->get_bytes(this->prf, this->seed, out))
+		{
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
 METHOD(prf_plus_t, get_bytes, bool,
 	private_prf_plus_t *this, size_t length, u_int8_t *buffer)
 {
@@ -66,28 +96,10 @@ METHOD(prf_plus_t, get_bytes, bool,
 	{
 		if (this->buffer.len == this->used)
 		{	/* buffer used, get next round */
-			if (!this->prf->get_bytes(this->prf, this->buffer, NULL))
+			if (!expand(this, this->buffer.ptr, this->buffer.ptr))
 			{
 				return FALSE;
 			}
-			if (this->counter)
-			{
-				if (!this->prf->get_bytes(this->prf, this->seed, NULL) ||
-					!this->prf->get_bytes(this->prf,
-							chunk_from_thing(this->counter), this->buffer.ptr))
-				{
-					return FALSE;
-				}
-				this->counter++;
-			}
-			else
-			{
-				if (!this->prf->get_bytes(this->prf, this->seed,
-										  this->buffer.ptr))
-				{
-					return FALSE;
-				}
-			}
 			this->used = 0;
 		}
 		round = min(length, this->buffer.len - this->used);
@@ -112,6 +124,53 @@ METHOD(prf_plus_t, allocate_bytes, bool,
 	return TRUE;
 }
 
+METHOD(prf_plus_t, allocate_all, bool,
+	private_prf_plus_t *this, size_t length, chunk_t *chunk)
+{
+	u_int8_t *previous;
+	size_t written;
+
+	if (!length)
+	{
+		*chunk = chunk_empty;
+		return TRUE;
+	}
+	*chunk = chunk_alloc(length);
+	/* hand out remaining bytes of the current block first */
+	written = min(length, this->buffer.len - this->used);
+	memcpy(chunk->ptr, this->buffer.ptr + this->used, written);
+	this->used += written;
+	/* derive all full blocks directly into the target, chaining within it */
+	previous = this->buffer.ptr;
+	while (length - written >= this->buffer.len)
+	{
+		if (!expand(this, previous, chunk->ptr + written))
+		{
+			chunk_clear(chunk);
+			return FALSE;
+		}
+		previous = chunk->ptr + written;
+		written += this->buffer.len;
+	}
+	if (written < length)
+	{	/* derive a last partial block through the buffer, keeping the
+		 * remainder for subsequent calls */
+		if (!expand(this, previous, this->buffer.ptr))
+		{
+			chunk_clear(chunk);
+			return FALSE;
+		}
+		memcpy(chunk->ptr + written, this->buffer.ptr, length - written);
+		this->used = length - written;
+	}
+	else if (previous != this->buffer.ptr)
+	{	/* preserve the last block, subsequent calls chain over it */
+		memcpy(this->buffer.ptr, previous, this->buffer.len);
+		this->used = this->buffer.len;
+	}
+	return TRUE;
+}
+
 METHOD(prf_plus_t, destroy, void,
 	private_prf_plus_t *this)
 {
@@ -131,6 +190,7 @@ prf_plus_t *prf_plus_create(prf_t *prf, bool counter, chunk_t seed)
 		.public = {
 			.get_bytes = _get_bytes,
 			.allocate_bytes = _allocate_bytes,
+			.allocate_all = _allocate_all,
 			.destroy = _destroy,
 		},
 		.prf = prf,
@@ -51,6 +51,20 @@ struct prf_plus_t {
 	bool (*allocate_bytes)(prf_plus_t *this, size_t length,
 						   chunk_t *chunk) __attribute__((warn_unused_result));
 
+	/**
+	 * Allocate a complete keymat in a single pass.
+	 *
+	 * Unlike allocate_bytes(), full PRF blocks are derived directly into
+	 * the returned chunk, avoiding the internal block buffering. The
+	 * derived stream is identical, mixing both calls is fine.
+	 *
+	 * @param length	number of bytes to derive
+	 * @param chunk		chunk which will hold derived bytes
+	 * @return			TRUE if bytes derived successfully
+	 */
+	bool (*allocate_all)(prf_plus_t *this, size_t length,
+						 chunk_t *chunk) __attribute__((warn_unused_result));
+
 	/**
 	 * Destroys a prf_plus_t object.
 	 */
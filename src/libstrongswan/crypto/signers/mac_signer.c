@@ -85,7 +85,7 @@ METHOD(signer_t, verify_signature, bool,
 		return FALSE;
 	}
 	return this->mac->get_mac(this->mac, data, mac) &&
-		   memeq(signature.ptr, mac, this->truncation);
+		   memeq_const(signature.ptr, mac, this->truncation);
 }
 
 METHOD(signer_t, get_key_size, size_t,
@@ -0,0 +1,661 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Hochschule fuer Technik Rapperswil
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include "transform_pool.h"
+
+#include <crypto/transform.h>
+#include <collections/linked_list.h>
+#include <threading/spinlock.h>
+
+/**
+ * Maximum number of idle instances pooled per algorithm
+ */
+#define MAX_POOLED_INSTANCES 8
+
+typedef struct private_transform_pool_t private_transform_pool_t;
+
+/**
+ * Private data of a transform_pool
+ */
+struct private_transform_pool_t {
+
+	/**
+	 * Public functions
+	 */
+	transform_pool_t public;
+
+	/**
+	 * Per-algorithm freelists, as pool_entry_t
+	 */
+	linked_list_t *entries;
+
+	/**
+	 * Lock for the freelists
+	 */
+	spinlock_t *lock;
+};
+
+typedef struct pool_entry_t pool_entry_t;
+
+/**
+ * Freelist for one algorithm/key size combination
+ */
+struct pool_entry_t {
+
+	/**
+	 * Transform type of the pooled instances
+	 */
+	transform_type_t type;
+
+	/**
+	 * Algorithm identifier
+	 */
+	u_int algo;
+
+	/**
+	 * Key size the instances were created with
+	 */
+	size_t key_size;
+
+	/**
+	 * Salt size the instances were created with
+	 */
+	size_t salt_size;
+
+	/**
+	 * Idle instances, as pooled_transform_t
+	 */
+	linked_list_t *instances;
+};
+
+typedef struct pooled_transform_t pooled_transform_t;
+
+/**
+ * Proxy around a reusable transform, returning it to the pool on destroy()
+ */
+struct pooled_transform_t {
+
+	/**
+	 * Public interface of the wrapped transform type
+	 */
+	union {
+		crypter_t crypter;
+		aead_t aead;
+		prf_t prf;
+		hasher_t hasher;
+	} public;
+
+	/**
+	 * Wrapped transform instance
+	 */
+	void *inner;
+
+	/**
+	 * Pool this instance belongs to
+	 */
+	private_transform_pool_t *pool;
+
+	/**
+	 * Transform type of inner
+	 */
+	transform_type_t type;
+
+	/**
+	 * Algorithm identifier of inner
+	 */
+	u_int algo;
+
+	/**
+	 * Key size inner was created with
+	 */
+	size_t key_size;
+
+	/**
+	 * Salt size inner was created with
+	 */
+	size_t salt_size;
+};
+
+/**
+ * Destroy a pooled transform, including the wrapped instance
+ */
+static void destroy_pooled(pooled_transform_t *this)
+{
+	switch (this->type)
+	{
+		case ENCRYPTION_ALGORITHM:
+		{
+			crypter_t *crypter = this->inner;
+			crypter->destroy(crypter);
+			break;
+		}
+		case AEAD_ALGORITHM:
+		{
+			aead_t *aead = this->inner;
+			aead->destroy(aead);
+			break;
+		}
+		case PSEUDO_RANDOM_FUNCTION:
+		{
+			prf_t *prf = this->inner;
+			prf->destroy(prf);
+			break;
+		}
+		case HASH_ALGORITHM:
+		{
+			hasher_t *hasher = this->inner;
+			hasher->destroy(hasher);
+			break;
+		}
+		default:
+			break;
+	}
+	free(this);
+}
+
+/**
+ * Find the freelist for a given algorithm, create it if requested
+ */
+static pool_entry_t *find_entry(private_transform_pool_t *this,
+								transform_type_t type, u_int algo,
+								size_t key_size, size_t salt_size, bool create)
+{
+	enumerator_t *enumerator;
+	pool_entry_t *entry, *found = NULL;
+
+	enumerator = this->entries->create_enumerator(this->entries);
+	while (enumerator->enumerate(enumerator, &entry))
+	{
+		if (entry->type == type && entry->algo == algo &&
+			entry->key_size == key_size && entry->salt_size == salt_size)
+		{
+			found = entry;
+			break;
+		}
+	}
+	enumerator->destroy(enumerator);
+
+	if (!found && create)
+	{
+		INIT(found,
+			.type = type,
+			.algo = algo,
+			.key_size = key_size,
+			.salt_size = salt_size,
+			.instances = linked_list_create(),
+		);
+		this->entries->insert_last(this->entries, found);
+	}
+	return found;
+}
+
+/**
+ * Return a transform to its pool, destroy it if the freelist is full
+ */
+static void recycle(pooled_transform_t *this)
+{
+	private_transform_pool_t *pool = this->pool;
+	pool_entry_t *entry;
+	bool pooled = FALSE;
+
+	pool->lock->lock(pool->lock);
+	entry = find_entry(pool, this->type, this->algo, this->key_size,
+					   this->salt_size, TRUE);
+	if (entry->instances->get_count(entry->instances) < MAX_POOLED_INSTANCES)
+	{
+		entry->instances->insert_last(entry->instances, this);
+		pooled = TRUE;
+	}
+	pool->lock->unlock(pool->lock);
+
+	if (!pooled)
+	{
+		destroy_pooled(this);
+	}
+}
+
+/**
+ * Pop an idle instance for a given algorithm from the pool, if any
+ */
+static pooled_transform_t *get_pooled(private_transform_pool_t *this,
+									  transform_type_t type, u_int algo,
+									  size_t key_size, size_t salt_size)
+{
+	pooled_transform_t *pooled = NULL;
+	pool_entry_t *entry;
+
+	this->lock->lock(this->lock);
+	entry = find_entry(this, type, algo, key_size, salt_size, FALSE);
+	if (entry)
+	{
+		entry->instances->remove_last(entry->instances, (void**)&pooled);
+	}
+	this->lock->unlock(this->lock);
+	return pooled;
+}
+
+/**
+ * Allocate a proxy for a fresh transform instance
+ */
+static pooled_transform_t *create_wrapper(private_transform_pool_t *pool,
+										  transform_type_t type, u_int algo,
+										  size_t key_size, size_t salt_size,
+										  void *inner)
+{
+	pooled_transform_t *this;
+
+	INIT(this,
+		.inner = inner,
+		.pool = pool,
+		.type = type,
+		.algo = algo,
+		.key_size = key_size,
+		.salt_size = salt_size,
+	);
+	return this;
+}
+
+METHOD(crypter_t, crypter_encrypt, bool,
+	pooled_transform_t *this, chunk_t data, chunk_t iv, chunk_t *encrypted)
+{
+	crypter_t *inner = this->inner;
+
+	return inner->encrypt(inner, data, iv, encrypted);
+}
+
+METHOD(crypter_t, crypter_decrypt, bool,
+	pooled_transform_t *this, chunk_t data, chunk_t iv, chunk_t *decrypted)
+{
+	crypter_t *inner = this->inner;
+
+	return inner->decrypt(inner, data, iv, decrypted);
+}
+
+METHOD(crypter_t, crypter_get_block_size, size_t,
+	pooled_transform_t *this)
+{
+	crypter_t *inner = this->inner;
+
+	return inner->get_block_size(inner);
+}
+
+METHOD(crypter_t, crypter_get_iv_size, size_t,
+	pooled_transform_t *this)
+{
+	crypter_t *inner = this->inner;
+
+	return inner->get_iv_size(inner);
+}
+
+METHOD(crypter_t, crypter_get_key_size, size_t,
+	pooled_transform_t *this)
+{
+	crypter_t *inner = this->inner;
+
+	return inner->get_key_size(inner);
+}
+
+METHOD(crypter_t, crypter_set_key, bool,
+	pooled_transform_t *this, chunk_t key)
+{
+	crypter_t *inner = this->inner;
+
+	return inner->set_key(inner, key);
+}
+
+METHOD(crypter_t, crypter_destroy, void,
+	pooled_transform_t *this)
+{
+	recycle(this);
+}
+
+METHOD(transform_pool_t, wrap_crypter, crypter_t*,
+	private_transform_pool_t *this, encryption_algorithm_t algo,
+	size_t key_size, crypter_t *crypter)
+{
+	pooled_transform_t *pooled;
+
+	pooled = create_wrapper(this, ENCRYPTION_ALGORITHM, algo, key_size, 0,
+							crypter);
+	pooled->public.crypter = (crypter_t){
+		.encrypt = _crypter_encrypt,
+		.decrypt = _crypter_decrypt,
+		.get_block_size = _crypter_get_block_size,
+		.get_iv_size = _crypter_get_iv_size,
+		.get_key_size = _crypter_get_key_size,
+		.set_key = _crypter_set_key,
+		.destroy = _crypter_destroy,
+	};
+	return &pooled->public.crypter;
+}
+
+METHOD(transform_pool_t, get_crypter, crypter_t*,
+	private_transform_pool_t *this, encryption_algorithm_t algo,
+	size_t key_size)
+{
+	pooled_transform_t *pooled;
+
+	pooled = get_pooled(this, ENCRYPTION_ALGORITHM, algo, key_size, 0);
+	return pooled ? &pooled->public.crypter : NULL;
+}
+
+METHOD(aead_t, aead_encrypt, bool,
+	pooled_transform_t *this, chunk_t plain, chunk_t assoc, chunk_t iv,
+	chunk_t *encrypted)
+{
+	aead_t *inner = this->inner;
+
+	return inner->encrypt(inner, plain, assoc, iv, encrypted);
+}
+
+METHOD(aead_t, aead_decrypt, bool,
+	pooled_transform_t *this, chunk_t encrypted, chunk_t assoc, chunk_t iv,
+	chunk_t *plain)
+{
+	aead_t *inner = this->inner;
+
+	return inner->decrypt(inner, encrypted, assoc, iv, plain);
+}
+
+METHOD(aead_t, aead_get_block_size, size_t,
+	pooled_transform_t *this)
+{
+	aead_t *inner = this->inner;
+
+	return inner->get_block_size(inner);
+}
+
+METHOD(aead_t, aead_get_icv_size, size_t,
+	pooled_transform_t *this)
+{
+	aead_t *inner = this->inner;
+
+	return inner->get_icv_size(inner);
+}
+
+METHOD(aead_t, aead_get_iv_size, size_t,
+	pooled_transform_t *this)
+{
+	aead_t *inner = this->inner;
+
+	return inner->get_iv_size(inner);
+}
+
+METHOD(aead_t, aead_get_iv_gen, iv_gen_t*,
+	pooled_transform_t *this)
+{
+	aead_t *inner = this->inner;
+
+	return inner->get_iv_gen(inner);
+}
+
+METHOD(aead_t, aead_get_key_size, size_t,
+	pooled_transform_t *this)
+{
+	aead_t *inner = this->inner;
+
+	return inner->get_key_size(inner);
+}
+
+METHOD(aead_t, aead_set_key, bool,
+	pooled_transform_t *this, chunk_t key)
+{
+	aead_t *inner = this->inner;
+
+	return inner->set_key(inner, key);
+}
+
+METHOD(aead_t, aead_destroy, void,
+	pooled_transform_t *this)
+{
+	recycle(this);
+}
+
+METHOD(transform_pool_t, wrap_aead, aead_t*,
+	private_transform_pool_t *this, encryption_algorithm_t algo,
+	size_t key_size, size_t salt_size, aead_t *aead)
+{
+	pooled_transform_t *pooled;
+
+	pooled = create_wrapper(this, AEAD_ALGORITHM, algo, key_size, salt_size,
+							aead);
+	pooled->public.aead = (aead_t){
+		.encrypt = _aead_encrypt,
+		.decrypt = _aead_decrypt,
+		.get_block_size = _aead_get_block_size,
+		.get_icv_size = _aead_get_icv_size,
+		.get_iv_size = _aead_get_iv_size,
+		.get_iv_gen = _aead_get_iv_gen,
+		.get_key_size = _aead_get_key_size,
+		.set_key = _aead_set_key,
+		.destroy = _aead_destroy,
+	};
+	return &pooled->public.aead;
+}
+
+METHOD(transform_pool_t, get_aead, aead_t*,
+	private_transform_pool_t *this, encryption_algorithm_t algo,
+	size_t key_size, size_t salt_size)
+{
+	pooled_transform_t *pooled;
+
+	pooled = get_pooled(this, AEAD_ALGORITHM, algo, key_size, salt_size);
+	return pooled ? &pooled->public.aead : NULL;
+}
+
+METHOD(prf_t, prf_get_bytes, bool,
+	pooled_transform_t *this, chunk_t seed, u_int8_t *buffer)
+{
+	prf_t *inner = this->inner;
+
+	return inner->get_bytes(inner, seed, buffer);
+}
+
+METHOD(prf_t, prf_allocate_bytes, bool,
+	pooled_transform_t *this, chunk_t seed, chunk_t *chunk)
+{
+	prf_t *inner = this->inner;
+
+	return inner->allocate_bytes(inner, seed, chunk);
+}
+
+METHOD(prf_t, prf_get_block_size, size_t,
+	pooled_transform_t *this)
+{
+	prf_t *inner = this->inner;
+
+	return inner->get_block_size(inner);
+}
+
+METHOD(prf_t, prf_get_key_size, size_t,
+	pooled_transform_t *this)
+{
+	prf_t *inner = this->inner;
+
+	return inner->get_key_size(inner);
+}
+
+METHOD(prf_t, prf_set_key, bool,
+	pooled_transform_t *this, chunk_t key)
+{
+	prf_t *inner = this->inner;
+
+	return inner->set_key(inner, key);
+}
+
+METHOD(prf_t, prf_destroy, void,
+	pooled_transform_t *this)
+{
+	recycle(this);
+}
+
+METHOD(transform_pool_t, wrap_prf, prf_t*,
+	private_transform_pool_t *this, pseudo_random_function_t algo, prf_t *prf)
+{
+	pooled_transform_t *pooled;
+
+	pooled = create_wrapper(this, PSEUDO_RANDOM_FUNCTION, algo, 0, 0, prf);
+	pooled->public.prf = (prf_t){
+		.get_bytes = _prf_get_bytes,
+		.allocate_bytes = _prf_allocate_bytes,
+		.get_block_size = _prf_get_block_size,
+		.get_key_size = _prf_get_key_size,
+		.set_key = _prf_set_key,
+		.destroy = _prf_destroy,
+	};
+	return &pooled->public.prf;
+}
+
+METHOD(transform_pool_t, get_prf, prf_t*,
+	private_transform_pool_t *this, pseudo_random_function_t algo)
+{
+	pooled_transform_t *pooled;
+
+	pooled = get_pooled(this, PSEUDO_RANDOM_FUNCTION, algo, 0, 0);
+	return pooled ? &pooled->public.prf : NULL;
+}
+
+METHOD(hasher_t, hasher_get_hash, bool,
+	pooled_transform_t *this, chunk_t data, u_int8_t *hash)
+{
+	hasher_t *inner = this->inner;
+
+	return inner->get_hash(inner, data, hash);
+}
+
+METHOD(hasher_t, hasher_allocate_hash, bool,
+	pooled_transform_t *this, chunk_t data, chunk_t *hash)
+{
+	hasher_t *inner = this->inner;
+
+	return inner->allocate_hash(inner, data, hash);
+}
+
+METHOD(hasher_t, hasher_get_hash_size, size_t,
+	pooled_transform_t *this)
+{
+	hasher_t *inner = this->inner;
+
+	return inner->get_hash_size(inner);
+}
+
+METHOD(hasher_t, hasher_reset, bool,
+	pooled_transform_t *this)
+{
+	hasher_t *inner = this->inner;
+
+	return inner->reset(inner);
+}
+
+METHOD(hasher_t, hasher_destroy, void,
+	pooled_transform_t *this)
+{
+	recycle(this);
+}
+
+METHOD(transform_pool_t, wrap_hasher, hasher_t*,
+	private_transform_pool_t *this, hash_algorithm_t algo, hasher_t *hasher)
+{
+	pooled_transform_t *pooled;
+
+	pooled = create_wrapper(this, HASH_ALGORITHM, algo, 0, 0, hasher);
+	pooled->public.hasher = (hasher_t){
+		.get_hash = _hasher_get_hash,
+		.allocate_hash = _hasher_allocate_hash,
+		.get_hash_size = _hasher_get_hash_size,
+		.reset = _hasher_reset,
+		.destroy = _hasher_destroy,
+	};
+	return &pooled->public.hasher;
+}
+
+METHOD(transform_pool_t, get_hasher, hasher_t*,
+	private_transform_pool_t *this, hash_algorithm_t algo)
+{
+	pooled_transform_t *pooled;
+
+	pooled = get_pooled(this, HASH_ALGORITHM, algo, 0, 0);
+	if (pooled && !hasher_reset(pooled))
+	{	/* don't hand out a hasher with leftover state */
+		destroy_pooled(pooled);
+		return NULL;
+	}
+	return pooled ? &pooled->public.hasher : NULL;
+}
+
+METHOD(transform_pool_t, flush, void,
+	private_transform_pool_t *this)
+{
+	linked_list_t *pending;
+	pooled_transform_t *pooled;
+	pool_entry_t *entry;
+
+	/* move idle instances out of the lock before destroying them */
+	pending = linked_list_create();
+	this->lock->lock(this->lock);
+	while (this->entries->remove_last(this->entries, (void**)&entry) == SUCCESS)
+	{
+		while (entry->instances->remove_last(entry->instances,
+											 (void**)&pooled) == SUCCESS)
+		{
+			pending->insert_last(pending, pooled);
+		}
+		entry->instances->destroy(entry->instances);
+		free(entry);
+	}
+	this->lock->unlock(this->lock);
+
+	while (pending->remove_last(pending, (void**)&pooled) == SUCCESS)
+	{
+		destroy_pooled(pooled);
+	}
+	pending->destroy(pending);
+}
+
+METHOD(transform_pool_t, destroy, void,
+	private_transform_pool_t *this)
+{
+	flush(this);
+	this->entries->destroy(this->entries);
+	this->lock->destroy(this->lock);
+	free(this);
+}
+
+/*
+ * see header file
+ */
+transform_pool_t *transform_pool_create()
+{
+	private_transform_pool_t *this;
+
+	INIT(this,
+		.public = {
+			.wrap_crypter = _wrap_crypter,
+			.get_crypter = _get_crypter,
+			.wrap_aead = _wrap_aead,
+			.get_aead = _get_aead,
+			.wrap_prf = _wrap_prf,
+			.get_prf = _get_prf,
+			.wrap_hasher = _wrap_hasher,
+			.get_hasher = _get_hasher,
+			.flush = _flush,
+			.destroy = _destroy,
+		},
+		.entries = linked_list_create(),
+		.lock = spinlock_create(),
+	);
+
+	return &this->public;
+}
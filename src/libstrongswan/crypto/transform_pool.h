@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Hochschule fuer Technik Rapperswil
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/**
+ * @defgroup transform_pool transform_pool
+ * @{ @ingroup crypto
+ */
+
+#ifndef TRANSFORM_POOL_H_
+#define TRANSFORM_POOL_H_
+
+typedef struct transform_pool_t transform_pool_t;
+
+#include <crypto/crypters/crypter.h>
+#include <crypto/aead.h>
+#include <crypto/prfs/prf.h>
+#include <crypto/hashers/hasher.h>
+
+/**
+ * Pool of reusable transform instances, managed by crypto_factory_t.
+ *
+ * Freshly constructed transforms get wrapped in a proxy whose destroy()
+ * returns the instance to a per-algorithm freelist instead of destroying it.
+ * A subsequent create for the same algorithm and key size then pops a pooled
+ * instance, skipping constructor, allocator and self-test overhead. Callers
+ * rekey recycled instances through the usual set_key()/reset() entry points,
+ * as they do for fresh ones.
+ *
+ * Pooled idle instances retain their last key schedule until they get
+ * recycled or flushed.
+ */
+struct transform_pool_t {
+
+	/**
+	 * Wrap a fresh crypter so its destroy() returns it to the pool.
+	 *
+	 * @param algo			algorithm the crypter was created for
+	 * @param key_size		key size the crypter was created with
+	 * @param crypter		fresh crypter instance, gets owned
+	 * @return				wrapped crypter
+	 */
+	crypter_t *(*wrap_crypter)(transform_pool_t *this,
+							   encryption_algorithm_t algo, size_t key_size,
+							   crypter_t *crypter);
+
+	/**
+	 * Get a pooled crypter for the given algorithm, if any.
+	 *
+	 * @param algo			algorithm to get a crypter for
+	 * @param key_size		key size to get a crypter for
+	 * @return				pooled crypter, NULL if none available
+	 */
+	crypter_t *(*get_crypter)(transform_pool_t *this,
+							  encryption_algorithm_t algo, size_t key_size);
+
+	/**
+	 * Wrap a fresh aead transform so its destroy() returns it to the pool.
+	 *
+	 * @param algo			algorithm the aead was created for
+	 * @param key_size		key size the aead was created with
+	 * @param salt_size		salt size the aead was created with
+	 * @param aead			fresh aead instance, gets owned
+	 * @return				wrapped aead
+	 */
+	aead_t *(*wrap_aead)(transform_pool_t *this, encryption_algorithm_t algo,
+						 size_t key_size, size_t salt_size, aead_t *aead);
+
+	/**
+	 * Get a pooled aead transform for the given algorithm, if any.
+	 *
+	 * @param algo			algorithm to get an aead for
+	 * @param key_size		key size to get an aead for
+	 * @param salt_size		salt size to get an aead for
+	 * @return				pooled aead, NULL if none available
+	 */
+	aead_t *(*get_aead)(transform_pool_t *this, encryption_algorithm_t algo,
+						size_t key_size, size_t salt_size);
+
+	/**
+	 * Wrap a fresh prf so its destroy() returns it to the pool.
+	 *
+	 * @param algo			algorithm the prf was created for
+	 * @param prf			fresh prf instance, gets owned
+	 * @return				wrapped prf
+	 */
+	prf_t *(*wrap_prf)(transform_pool_t *this, pseudo_random_function_t algo,
+					   prf_t *prf);
+
+	/**
+	 * Get a pooled prf for the given algorithm, if any.
+	 *
+	 * @param algo			algorithm to get a prf for
+	 * @return				pooled prf, NULL if none available
+	 */
+	prf_t *(*get_prf)(transform_pool_t *this, pseudo_random_function_t algo);
+
+	/**
+	 * Wrap a fresh hasher so its destroy() returns it to the pool.
+	 *
+	 * @param algo			algorithm the hasher was created for
+	 * @param hasher		fresh hasher instance, gets owned
+	 * @return				wrapped hasher
+	 */
+	hasher_t *(*wrap_hasher)(transform_pool_t *this, hash_algorithm_t algo,
+							 hasher_t *hasher);
+
+	/**
+	 * Get a pooled hasher for the given algorithm, if any.
+	 *
+	 * @param algo			algorithm to get a hasher for
+	 * @return				pooled hasher, NULL if none available
+	 */
+	hasher_t *(*get_hasher)(transform_pool_t *this, hash_algorithm_t algo);
+
+	/**
+	 * Destroy all pooled idle instances, e.g. after unregistering algorithms.
+	 */
+	void (*flush)(transform_pool_t *this);
+
+	/**
+	 * Destroy a transform_pool_t, including all pooled instances.
+	 */
+	void (*destroy)(transform_pool_t *this);
+};
+
+/**
+ * Create a transform_pool instance.
+ *
+ * @return				transform pool
+ */
+transform_pool_t *transform_pool_create();
+
+#endif /** TRANSFORM_POOL_H_ @}*/
@@ -112,6 +112,22 @@ struct database_t {
 	 */
 	int (*execute)(database_t *this, int *rowid, char *sql, ...);
 
+	/**
+	 * Queue a query not returning rows for asynchronous execution.
+	 *
+	 * The statement is prepared and its arguments are bound in the calling
+	 * thread, but the database round trip is deferred to a background worker,
+	 * overlapping database I/O with the callers work. Queued statements
+	 * execute in order, but outside of any transaction of the caller, and
+	 * errors are logged only; use execute() if the result or the inserted
+	 * row ID is needed.
+	 *
+	 * @param sql		sql string, containing '?' placeholders
+	 * @param ...		list of sql placeholder db_type_t followed by its value
+	 * @return			TRUE if the statement was queued for execution
+	 */
+	bool (*execute_async)(database_t *this, char *sql, ...);
+
 	/**
 	 * Start a transaction.
 	 *
@@ -120,8 +120,10 @@ void library_deinit()
 
 	this->public.streams->destroy(this->public.streams);
 	this->public.watcher->destroy(this->public.watcher);
+	this->public.watchdog->destroy(this->public.watchdog);
 	this->public.scheduler->destroy(this->public.scheduler);
 	this->public.processor->destroy(this->public.processor);
+	this->public.metrics->destroy(this->public.metrics);
 	this->public.plugins->destroy(this->public.plugins);
 	this->public.hosts->destroy(this->public.hosts);
 	this->public.settings->destroy(this->public.settings);
@@ -141,6 +143,9 @@ void library_deinit()
 		this->public.integrity->destroy(this->public.integrity);
 	}
 
+	/* destroy the intern table before the leak report, it may have grown */
+	identification_deinit();
+
 	if (lib->leak_detective)
 	{
 		lib->leak_detective->report(lib->leak_detective, detailed);
@@ -271,6 +276,7 @@ bool library_init(char *settings, const char *namespace)
 
 	threads_init();
 	utils_init();
+	identification_init();
 	arrays_init();
 	backtrace_init();
 
@@ -324,8 +330,10 @@ bool library_init(char *settings, const char *namespace)
 	this->public.fetcher = fetcher_manager_create();
 	this->public.resolver = resolver_manager_create();
 	this->public.db = database_factory_create();
+	this->public.metrics = metrics_create();
 	this->public.processor = processor_create();
 	this->public.scheduler = scheduler_create();
+	this->public.watchdog = watchdog_create();
 	this->public.watcher = watcher_create();
 	this->public.streams = stream_manager_create();
 	this->public.plugins = plugin_loader_create();
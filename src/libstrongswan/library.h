@@ -103,6 +103,7 @@
 #include "networking/streams/stream_manager.h"
 #include "processing/processor.h"
 #include "processing/scheduler.h"
+#include "processing/watchdog.h"
 #include "processing/watcher.h"
 #include "crypto/crypto_factory.h"
 #include "crypto/proposal/proposal_keywords.h"
@@ -116,6 +117,7 @@
 #include "utils/capabilities.h"
 #include "utils/integrity_checker.h"
 #include "utils/leak_detective.h"
+#include "utils/metrics.h"
 #include "plugins/plugin_loader.h"
 #include "settings/settings.h"
 
@@ -214,11 +216,21 @@ struct library_t {
 	 */
 	processor_t *processor;
 
+	/**
+	 * registry of global numeric counters
+	 */
+	metrics_t *metrics;
+
 	/**
 	 * schedule jobs
 	 */
 	scheduler_t *scheduler;
 
+	/**
+	 * scheduler/processor latency watchdog
+	 */
+	watchdog_t *watchdog;
+
 	/**
 	 * File descriptor monitoring
 	 */
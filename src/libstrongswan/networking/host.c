@@ -52,6 +52,16 @@ struct private_host_t {
 	 * length of address structure
 	 */
 	socklen_t socklen;
+
+	/**
+	 * cached hash over the address, computed on first use
+	 */
+	u_int addr_hash;
+
+	/**
+	 * whether addr_hash has been computed
+	 */
+	bool addr_hashed;
 };
 
 /**
@@ -233,6 +243,26 @@ METHOD(host_t, set_port, void,
 	}
 }
 
+METHOD(host_t, hash_, u_int,
+	private_host_t *this, bool inc_port)
+{
+	u_int16_t port;
+	u_int hash;
+
+	if (!this->addr_hashed)
+	{	/* benign if raced, both threads compute the same value */
+		this->addr_hash = chunk_hash(get_address(this));
+		this->addr_hashed = TRUE;
+	}
+	hash = this->addr_hash;
+	if (inc_port)
+	{
+		port = get_port(this);
+		hash = chunk_hash_inc(chunk_from_thing(port), hash);
+	}
+	return hash;
+}
+
 METHOD(host_t, clone_, host_t*,
 	private_host_t *this)
 {
@@ -321,6 +351,7 @@ static private_host_t *host_create_empty(void)
 			.get_address = _get_address,
 			.get_port = _get_port,
 			.set_port = _set_port,
+			.hash = _hash_,
 			.ip_equals = (bool (*)(host_t *,host_t *))ip_equals,
 			.equals = (bool (*)(host_t *,host_t *)) equals,
 			.is_anyaddr = _is_anyaddr,
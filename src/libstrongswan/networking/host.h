@@ -116,6 +116,19 @@ struct host_t {
 	 */
 	bool (*ip_equals) (host_t *this, host_t *other);
 
+	/**
+	 * Get a non-cryptographic hash over the address of this host.
+	 *
+	 * The address hash is computed once and cached, so keying hash tables
+	 * by frequently compared hosts avoids rehashing the sockaddr bytes on
+	 * every lookup. The cache is retained by clone(). Note that %any and
+	 * %any6 hash differently, while ip_equals() considers them equal.
+	 *
+	 * @param inc_port	TRUE to include the port in the hash
+	 * @return			hash of the address (and port)
+	 */
+	u_int (*hash) (host_t *this, bool inc_port);
+
 	/**
 	 * Compare two hosts, with port.
 	 *
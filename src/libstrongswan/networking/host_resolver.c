@@ -24,6 +24,7 @@
 #include <threading/thread.h>
 #include <collections/hashtable.h>
 #include <collections/linked_list.h>
+#include <collections/array.h>
 
 /**
  * Default minimum and maximum number of threads
@@ -98,6 +99,15 @@ struct private_host_resolver_t {
 	 */
 	bool disabled;
 
+	/**
+	 * Cache of completed queries, cache_entry_t*, if cache_ttl is set
+	 */
+	hashtable_t *cache;
+
+	/**
+	 * Seconds to serve completed queries from the cache, 0 to disable
+	 */
+	u_int cache_ttl;
 };
 
 typedef struct {
@@ -111,8 +121,45 @@ typedef struct {
 	refcount_t refcount;
 	/** the result if successful */
 	host_t *result;
+	/** callbacks of asynchronous requesters, as async_cb_t* */
+	array_t *callbacks;
 } query_t;
 
+/**
+ * Registered callback of an asynchronous requester
+ */
+typedef struct {
+	/** callback function */
+	host_resolver_cb_t cb;
+	/** user data */
+	void *user;
+} async_cb_t;
+
+/**
+ * Cached result of a completed query. Shares the name/family prefix with
+ * query_t, so the query hash/equals functions apply to both.
+ */
+typedef struct {
+	/** resolved DNS name */
+	char *name;
+	/** address family that was requested */
+	int family;
+	/** resolved host, NULL for cached negative results */
+	host_t *host;
+	/** monotonic time the entry expires at */
+	time_t expires;
+} cache_entry_t;
+
+/**
+ * Destroy a cache entry
+ */
+static void cache_entry_destroy(cache_entry_t *this)
+{
+	DESTROY_IF(this->host);
+	free(this->name);
+	free(this);
+}
+
 /**
  * Destroy the given query_t object if refcount is zero
  */
@@ -121,6 +168,7 @@ static void query_destroy(query_t *this)
 	if (ref_put(&this->refcount))
 	{
 		DESTROY_IF(this->result);
+		array_destroy_function(this->callbacks, (void*)free, NULL);
 		this->done->destroy(this->done);
 		free(this->name);
 		free(this);
@@ -153,6 +201,68 @@ static bool query_equals(query_t *this, query_t *other)
 	return this->family == other->family && streq(this->name, other->name);
 }
 
+/**
+ * Look up a fresh cached result, returns FALSE on a cache miss. Must be
+ * called with this->mutex held.
+ */
+static bool cache_lookup(private_host_resolver_t *this, query_t *lookup,
+						 host_t **host)
+{
+	cache_entry_t *entry;
+
+	entry = this->cache->get(this->cache, lookup);
+	if (!entry)
+	{
+		return FALSE;
+	}
+	if (entry->expires <= time_monotonic(NULL))
+	{
+		this->cache->remove(this->cache, entry);
+		cache_entry_destroy(entry);
+		return FALSE;
+	}
+	*host = entry->host ? entry->host->clone(entry->host) : NULL;
+	return TRUE;
+}
+
+/**
+ * Cache the result of a completed query, positive or negative. Must be
+ * called with this->mutex held.
+ */
+static void cache_insert(private_host_resolver_t *this, query_t *query)
+{
+	cache_entry_t *entry;
+
+	entry = this->cache->get(this->cache, (cache_entry_t*)query);
+	if (!entry)
+	{
+		INIT(entry,
+			.name = strdup(query->name),
+			.family = query->family,
+		);
+		this->cache->put(this->cache, entry, entry);
+	}
+	DESTROY_IF(entry->host);
+	entry->host = query->result ? query->result->clone(query->result) : NULL;
+	entry->expires = time_monotonic(NULL) + this->cache_ttl;
+}
+
+/**
+ * Invoke and release the detached asynchronous callbacks of a query
+ */
+static void invoke_callbacks(query_t *query, array_t *callbacks)
+{
+	async_cb_t *acb;
+
+	while (array_remove(callbacks, ARRAY_HEAD, &acb))
+	{
+		acb->cb(acb->user, query->name,
+				query->result ? query->result->clone(query->result) : NULL);
+		free(acb);
+	}
+	array_destroy(callbacks);
+}
+
 /**
  * Main function of resolver threads
  */
@@ -160,6 +270,7 @@ static void *resolve_hosts(private_host_resolver_t *this)
 {
 	struct addrinfo hints, *result;
 	query_t *query;
+	array_t *callbacks;
 	int error;
 	bool old, timed_out;
 
@@ -220,53 +331,58 @@ static void *resolve_hosts(private_host_resolver_t *this)
 			query->result = host_create_from_sockaddr(result->ai_addr);
 			freeaddrinfo(result);
 		}
+		if (this->cache_ttl)
+		{
+			cache_insert(this, query);
+		}
 		this->queries->remove(this->queries, query);
+		callbacks = query->callbacks;
+		query->callbacks = NULL;
 		query->done->broadcast(query->done);
 		this->mutex->unlock(this->mutex);
+		if (callbacks)
+		{
+			invoke_callbacks(query, callbacks);
+		}
 		query_destroy(query);
 	}
 	return NULL;
 }
 
-METHOD(host_resolver_t, resolve, host_t*,
-	private_host_resolver_t *this, char *name, int family)
+/**
+ * Check if a name can't possibly resolve in the given address family
+ */
+static bool invalid_for_family(char *name, int family)
 {
-	query_t *query, lookup = {
-		.name = name,
-		.family = family,
-	};
-	host_t *result;
 	struct in_addr addr;
 
 	switch (family)
 	{
 		case AF_INET:
 			/* do not try to convert v6 addresses for v4 family */
-			if (strchr(name, ':'))
-			{
-				return NULL;
-			}
-			break;
+			return strchr(name, ':') != NULL;
 		case AF_INET6:
 			/* do not try to convert v4 addresses for v6 family */
-			if (inet_pton(AF_INET, name, &addr) == 1)
-			{
-				return NULL;
-			}
-			break;
+			return inet_pton(AF_INET, name, &addr) == 1;
 	}
-	this->mutex->lock(this->mutex);
-	if (this->disabled)
-	{
-		this->mutex->unlock(this->mutex);
-		return NULL;
-	}
-	query = this->queries->get(this->queries, &lookup);
+	return FALSE;
+}
+
+/**
+ * Find a pending query, or create and enqueue a new one, spawning an
+ * additional resolver thread if all are busy. Must be called with
+ * this->mutex held.
+ */
+static query_t *enqueue_query(private_host_resolver_t *this, query_t *lookup)
+{
+	query_t *query;
+
+	query = this->queries->get(this->queries, lookup);
 	if (!query)
 	{
 		INIT(query,
-			.name = strdup(name),
-			.family = family,
+			.name = strdup(lookup->name),
+			.family = lookup->family,
 			.done = condvar_create(CONDVAR_TYPE_DEFAULT),
 			.refcount = 1,
 		);
@@ -274,7 +390,6 @@ METHOD(host_resolver_t, resolve, host_t*,
 		this->queue->insert_last(this->queue, query);
 		this->new_query->signal(this->new_query);
 	}
-	ref_get(&query->refcount);
 	if (this->busy_threads == this->threads &&
 		this->threads < this->max_threads)
 	{
@@ -287,6 +402,35 @@ METHOD(host_resolver_t, resolve, host_t*,
 			this->pool->insert_last(this->pool, thread);
 		}
 	}
+	return query;
+}
+
+METHOD(host_resolver_t, resolve, host_t*,
+	private_host_resolver_t *this, char *name, int family)
+{
+	query_t *query, lookup = {
+		.name = name,
+		.family = family,
+	};
+	host_t *result;
+
+	if (invalid_for_family(name, family))
+	{
+		return NULL;
+	}
+	this->mutex->lock(this->mutex);
+	if (this->disabled)
+	{
+		this->mutex->unlock(this->mutex);
+		return NULL;
+	}
+	if (this->cache_ttl && cache_lookup(this, &lookup, &result))
+	{
+		this->mutex->unlock(this->mutex);
+		return result;
+	}
+	query = enqueue_query(this, &lookup);
+	ref_get(&query->refcount);
 	query->done->wait(query->done, this->mutex);
 	this->mutex->unlock(this->mutex);
 
@@ -295,26 +439,92 @@ METHOD(host_resolver_t, resolve, host_t*,
 	return result;
 }
 
+METHOD(host_resolver_t, resolve_async, void,
+	private_host_resolver_t *this, char *name, int family,
+	host_resolver_cb_t cb, void *user)
+{
+	query_t *query, lookup = {
+		.name = name,
+		.family = family,
+	};
+	async_cb_t *acb;
+	host_t *cached;
+
+	if (invalid_for_family(name, family))
+	{
+		cb(user, name, NULL);
+		return;
+	}
+	this->mutex->lock(this->mutex);
+	if (this->disabled)
+	{
+		this->mutex->unlock(this->mutex);
+		cb(user, name, NULL);
+		return;
+	}
+	if (this->cache_ttl && cache_lookup(this, &lookup, &cached))
+	{
+		this->mutex->unlock(this->mutex);
+		cb(user, name, cached);
+		return;
+	}
+	query = enqueue_query(this, &lookup);
+	INIT(acb,
+		.cb = cb,
+		.user = user,
+	);
+	array_insert_create(&query->callbacks, ARRAY_TAIL, acb);
+	this->mutex->unlock(this->mutex);
+}
+
 METHOD(host_resolver_t, flush, void,
 	private_host_resolver_t *this)
 {
 	enumerator_t *enumerator;
+	linked_list_t *queries, *callbacks;
+	cache_entry_t *entry;
 	query_t *query;
+	array_t *cbs;
 
+	queries = linked_list_create();
+	callbacks = linked_list_create();
 	this->mutex->lock(this->mutex);
 	enumerator = this->queries->create_enumerator(this->queries);
 	while (enumerator->enumerate(enumerator, &query, NULL))
 	{	/* use the hashtable here as we also want to signal dequeued queries */
 		this->queries->remove_at(this->queries, enumerator);
+		if (query->callbacks)
+		{	/* answer asynchronous requesters after unlocking */
+			ref_get(&query->refcount);
+			queries->insert_last(queries, query);
+			callbacks->insert_last(callbacks, query->callbacks);
+			query->callbacks = NULL;
+		}
 		query->done->broadcast(query->done);
 	}
 	enumerator->destroy(enumerator);
+	enumerator = this->cache->create_enumerator(this->cache);
+	while (enumerator->enumerate(enumerator, &entry, NULL))
+	{
+		this->cache->remove_at(this->cache, enumerator);
+		cache_entry_destroy(entry);
+	}
+	enumerator->destroy(enumerator);
 	this->queue->destroy_function(this->queue, (void*)query_destroy);
 	this->queue = linked_list_create();
 	this->disabled = TRUE;
 	/* this will already terminate most idle threads */
 	this->new_query->broadcast(this->new_query);
 	this->mutex->unlock(this->mutex);
+
+	while (queries->remove_first(queries, (void**)&query) == SUCCESS &&
+		   callbacks->remove_first(callbacks, (void**)&cbs) == SUCCESS)
+	{
+		invoke_callbacks(query, cbs);
+		query_destroy(query);
+	}
+	queries->destroy(queries);
+	callbacks->destroy(callbacks);
 }
 
 METHOD(host_resolver_t, destroy, void,
@@ -331,6 +541,7 @@ METHOD(host_resolver_t, destroy, void,
 	this->pool->destroy(this->pool);
 	this->queue->destroy(this->queue);
 	this->queries->destroy(this->queries);
+	this->cache->destroy(this->cache);
 	this->new_query->destroy(this->new_query);
 	this->mutex->destroy(this->mutex);
 	free(this);
@@ -346,11 +557,14 @@ host_resolver_t *host_resolver_create()
 	INIT(this,
 		.public = {
 			.resolve = _resolve,
+			.resolve_async = _resolve_async,
 			.flush = _flush,
 			.destroy = _destroy,
 		},
 		.queries = hashtable_create((hashtable_hash_t)query_hash,
 									(hashtable_equals_t)query_equals, 8),
+		.cache = hashtable_create((hashtable_hash_t)query_hash,
+								  (hashtable_equals_t)query_equals, 8),
 		.queue = linked_list_create(),
 		.pool = linked_list_create(),
 		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
@@ -364,5 +578,8 @@ host_resolver_t *host_resolver_create()
 							lib->settings->get_int(lib->settings,
 												"%s.host_resolver.max_threads",
 												MAX_THREADS_DEFAULT, lib->ns));
+	this->cache_ttl = max(0, lib->settings->get_int(lib->settings,
+												"%s.host_resolver.cache_ttl",
+												0, lib->ns));
 	return &this->public;
 }
@@ -25,6 +25,18 @@
 
 typedef struct host_resolver_t host_resolver_t;
 
+/**
+ * Callback invoked when an asynchronous resolution completes.
+ *
+ * The callback runs on a resolver thread, so it should not block; queue a
+ * job for any heavy lifting.
+ *
+ * @param user		user data supplied during registration
+ * @param name		name that was looked up
+ * @param host		resolved host, NULL if failed or canceled (gets owned)
+ */
+typedef void (*host_resolver_cb_t)(void *user, char *name, host_t *host);
+
 /**
  * Resolve hosts by DNS name but do so in a separate thread (calling
  * getaddrinfo(3) directly might block indefinitely, or at least a very long
@@ -41,6 +53,21 @@ struct host_resolver_t {
 	 */
 	host_t *(*resolve)(host_resolver_t *this, char *name, int family);
 
+	/**
+	 * Resolve host from the given DNS name, without blocking the caller.
+	 *
+	 * Identical queries get coalesced, the callback is invoked once the
+	 * lookup completes, fails or the resolver gets flushed. With a cached
+	 * result the callback may fire before this method returns.
+	 *
+	 * @param name		name to lookup
+	 * @param family	requested address family
+	 * @param cb		callback to invoke with the result
+	 * @param user		user data to pass to callback
+	 */
+	void (*resolve_async)(host_resolver_t *this, char *name, int family,
+						  host_resolver_cb_t cb, void *user);
+
 	/**
 	 * Flush the queue of queries. No new queries will be accepted afterwards.
 	 */
@@ -53,8 +53,34 @@ struct private_packet_t {
 	 * actual chunk returned from get_data, adjusted when skip_bytes is called
 	 */
 	chunk_t adjusted_data;
+
+	/**
+	 * reference count for the data buffer if it is shared between clones,
+	 * NULL if this packet is its sole owner
+	 */
+	refcount_t *ref;
 };
 
+/**
+ * Release the data buffer, considering shared ownership
+ */
+static void release_data(private_packet_t *this)
+{
+	if (this->ref)
+	{
+		if (ref_put(this->ref))
+		{
+			free(this->ref);
+			free(this->data.ptr);
+		}
+		this->ref = NULL;
+	}
+	else
+	{
+		free(this->data.ptr);
+	}
+}
+
 METHOD(packet_t, set_source, void,
 	private_packet_t *this, host_t *source)
 {
@@ -90,7 +116,7 @@ METHOD(packet_t, get_data, chunk_t,
 METHOD(packet_t, set_data, void,
 	private_packet_t *this, chunk_t data)
 {
-	free(this->data.ptr);
+	release_data(this);
 	this->adjusted_data = this->data = data;
 }
 
@@ -116,31 +142,40 @@ METHOD(packet_t, destroy, void,
 {
 	DESTROY_IF(this->source);
 	DESTROY_IF(this->destination);
-	free(this->data.ptr);
+	release_data(this);
 	free(this);
 }
 
 METHOD(packet_t, clone_, packet_t*,
 	private_packet_t *this)
 {
-	packet_t *other;
+	private_packet_t *other;
 
-	other = packet_create();
+	other = (private_packet_t*)packet_create();
 	if (this->destination)
 	{
-		other->set_destination(other,
-							   this->destination->clone(this->destination));
+		set_destination(other, this->destination->clone(this->destination));
 	}
 	if (this->source)
 	{
-		other->set_source(other, this->source->clone(this->source));
+		set_source(other, this->source->clone(this->source));
 	}
 	if (this->data.ptr)
-	{
-		other->set_data(other, chunk_clone(this->adjusted_data));
+	{	/* share the data buffer instead of copying it, packets are
+		 * read-only once their data is set */
+		if (!this->ref)
+		{
+			this->ref = malloc_thing(refcount_t);
+			*this->ref = 1;
+		}
+		ref_get(this->ref);
+		other->ref = this->ref;
+		/* the clone shares the buffer, but excludes skipped bytes as well */
+		other->data = this->data;
+		other->adjusted_data = this->adjusted_data;
 	}
-	other->set_dscp(other, this->dscp);
-	return other;
+	set_dscp(other, this->dscp);
+	return &other->public;
 }
 
 /**
@@ -110,6 +110,10 @@ struct packet_t {
 	 *
 	 * @note Data is cloned without skipped bytes.
 	 *
+	 * @note The data buffer is shared between the clones and released when
+	 * the last packet referencing it gets destroyed, so treat the data of a
+	 * cloned packet as read-only.
+	 *
 	 * @param clone		clone of the packet
 	 */
 	packet_t* (*clone)(packet_t *packet);
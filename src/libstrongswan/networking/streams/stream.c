@@ -85,6 +85,38 @@ METHOD(stream_t, read_, ssize_t,
 	}
 }
 
+METHOD(stream_t, readv_, ssize_t,
+	private_stream_t *this, struct iovec *iov, int iovcnt, bool block)
+{
+	struct msghdr msg = {
+		.msg_iov = iov,
+		.msg_iovlen = iovcnt,
+	};
+	ssize_t ret;
+
+	while (TRUE)
+	{
+		if (block)
+		{
+			ret = recvmsg(this->fd, &msg, 0);
+		}
+		else
+		{
+			ret = recvmsg(this->fd, &msg, MSG_DONTWAIT);
+			if (ret == -1 && errno == EAGAIN)
+			{
+				/* unify EGAIN and EWOULDBLOCK */
+				errno = EWOULDBLOCK;
+			}
+		}
+		if (ret == -1 && errno == EINTR)
+		{	/* interrupted, try again */
+			continue;
+		}
+		return ret;
+	}
+}
+
 METHOD(stream_t, read_all, bool,
 	private_stream_t *this, void *buf, size_t len)
 {
@@ -136,6 +168,38 @@ METHOD(stream_t, write_, ssize_t,
 	}
 }
 
+METHOD(stream_t, writev_, ssize_t,
+	private_stream_t *this, struct iovec *iov, int iovcnt, bool block)
+{
+	struct msghdr msg = {
+		.msg_iov = iov,
+		.msg_iovlen = iovcnt,
+	};
+	ssize_t ret;
+
+	while (TRUE)
+	{
+		if (block)
+		{
+			ret = sendmsg(this->fd, &msg, 0);
+		}
+		else
+		{
+			ret = sendmsg(this->fd, &msg, MSG_DONTWAIT);
+			if (ret == -1 && errno == EAGAIN)
+			{
+				/* unify EGAIN and EWOULDBLOCK */
+				errno = EWOULDBLOCK;
+			}
+		}
+		if (ret == -1 && errno == EINTR)
+		{	/* interrupted, try again */
+			continue;
+		}
+		return ret;
+	}
+}
+
 METHOD(stream_t, write_all, bool,
 	private_stream_t *this, void *buf, size_t len)
 {
@@ -275,9 +339,11 @@ stream_t *stream_create_from_fd(int fd)
 	INIT(this,
 		.public = {
 			.read = _read_,
+			.readv = _readv_,
 			.read_all = _read_all,
 			.on_read = _on_read,
 			.write = _write_,
+			.writev = _writev_,
 			.write_all = _write_all,
 			.on_write = _on_write,
 			.get_file = _get_file,
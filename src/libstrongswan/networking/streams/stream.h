@@ -25,6 +25,8 @@ typedef struct stream_t stream_t;
 
 #include <library.h>
 
+#include <sys/uio.h>
+
 /**
  * Constructor function prototype for stream_t.
  *
@@ -67,6 +69,19 @@ struct stream_t {
 	 */
 	ssize_t (*read)(stream_t *this, void *buf, size_t len, bool block);
 
+	/**
+	 * Read data from the stream into multiple buffers.
+	 *
+	 * Like read(), but scatters the data over the given iovec array with a
+	 * single system call. A short read may end within any of the buffers.
+	 *
+	 * @param iov		array of buffers to read into
+	 * @param iovcnt	number of buffers in iov
+	 * @param block		TRUE to use a blocking read
+	 * @return			number of bytes read, -1 on error
+	 */
+	ssize_t (*readv)(stream_t *this, struct iovec *iov, int iovcnt, bool block);
+
 	/**
 	 * Read data from the stream, avoiding short reads.
 	 *
@@ -101,6 +116,20 @@ struct stream_t {
 	 */
 	ssize_t (*write)(stream_t *this, void *buf, size_t len, bool block);
 
+	/**
+	 * Write data from multiple buffers to the stream.
+	 *
+	 * Like write(), but gathers the data from the given iovec array with a
+	 * single system call.  A short write may end within any of the buffers.
+	 *
+	 * @param iov		array of buffers to write
+	 * @param iovcnt	number of buffers in iov
+	 * @param block		TRUE to use a blocking write
+	 * @return			number of bytes written, -1 on error
+	 */
+	ssize_t (*writev)(stream_t *this, struct iovec *iov, int iovcnt,
+					  bool block);
+
 	/**
 	 * Write data to the stream, avoiding short writes.
 	 *
@@ -13,6 +13,7 @@
  * for more details.
  */
 
+#define _GNU_SOURCE
 #include <library.h>
 #include <threading/thread.h>
 #include <threading/mutex.h>
@@ -23,7 +24,9 @@
 
 #include <errno.h>
 #include <unistd.h>
+#include <poll.h>
 #include <sys/stat.h>
+#include <sys/socket.h>
 
 typedef struct private_stream_service_t private_stream_service_t;
 
@@ -192,6 +195,32 @@ static job_requeue_t accept_async(async_data_t *data)
 	return JOB_REQUEUE_NONE;
 }
 
+/**
+ * Accept a connection on the service socket
+ */
+static int accept_connection(int fd)
+{
+#ifdef HAVE_ACCEPT4
+	return accept4(fd, NULL, NULL, SOCK_CLOEXEC);
+#else
+	return accept(fd, NULL, NULL);
+#endif
+}
+
+/**
+ * Check if further connections are pending on the service socket, without
+ * risking to block in accept()
+ */
+static bool pending_connection(int fd)
+{
+	struct pollfd pfd = {
+		.fd = fd,
+		.events = POLLIN,
+	};
+
+	return poll(&pfd, 1, 0) == 1;
+}
+
 /**
  * Watcher callback function
  */
@@ -200,15 +229,20 @@ static bool watch(private_stream_service_t *this, int fd, watcher_event_t event)
 	async_data_t *data;
 	bool keep = TRUE;
 
-	INIT(data,
-		.cb = this->cb,
-		.data = this->data,
-		.fd = accept(fd, NULL, NULL),
-		.this = this,
-	);
-
-	if (data->fd != -1 && !this->terminated)
+	while (keep)
 	{
+		INIT(data,
+			.cb = this->cb,
+			.data = this->data,
+			.fd = accept_connection(fd),
+			.this = this,
+		);
+
+		if (data->fd == -1 || this->terminated)
+		{
+			free(data);
+			break;
+		}
 		this->mutex->lock(this->mutex);
 		if (++this->active == this->cncrncy)
 		{
@@ -222,10 +256,11 @@ static bool watch(private_stream_service_t *this, int fd, watcher_event_t event)
 			(job_t*)callback_job_create_with_prio((void*)accept_async, data,
 				(void*)destroy_async_data, (callback_job_cancel_t)return_false,
 				this->prio));
-	}
-	else
-	{
-		free(data);
+
+		if (keep && !pending_connection(fd))
+		{	/* backlog drained for this wakeup */
+			break;
+		}
 	}
 	return keep;
 }
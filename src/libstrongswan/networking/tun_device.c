@@ -29,6 +29,11 @@ tun_device_t *tun_device_create(const char *name_tmpl)
 	return NULL;
 }
 
+tun_device_t *tun_device_create_queues(const char *name_tmpl, u_int queues)
+{
+	return tun_device_create(name_tmpl);
+}
+
 #else /* TUN devices supported */
 
 #include <errno.h>
@@ -73,6 +78,16 @@ struct private_tun_device_t {
 	 */
 	int tunfd;
 
+	/**
+	 * File descriptors of all device queues, the first equals tunfd
+	 */
+	int *queue_fds;
+
+	/**
+	 * Number of device queues
+	 */
+	u_int queues;
+
 	/**
 	 * Name of the TUN device
 	 */
@@ -318,6 +333,22 @@ METHOD(tun_device_t, get_fd, int,
 	return this->tunfd;
 }
 
+METHOD(tun_device_t, get_queues, u_int,
+	private_tun_device_t *this)
+{
+	return this->queues;
+}
+
+METHOD(tun_device_t, get_queue_fd, int,
+	private_tun_device_t *this, u_int queue)
+{
+	if (queue >= this->queues)
+	{
+		return -1;
+	}
+	return this->queue_fds[queue];
+}
+
 METHOD(tun_device_t, write_packet, bool,
 	private_tun_device_t *this, chunk_t packet)
 {
@@ -343,8 +374,10 @@ METHOD(tun_device_t, write_packet, bool,
 	return TRUE;
 }
 
-METHOD(tun_device_t, read_packet, bool,
-	private_tun_device_t *this, chunk_t *packet)
+/**
+ * Read a packet from the given queue FD
+ */
+static bool read_packet_fd(private_tun_device_t *this, int fd, chunk_t *packet)
 {
 	chunk_t data;
 	ssize_t len;
@@ -353,10 +386,14 @@ METHOD(tun_device_t, read_packet, bool,
 	data = chunk_alloca(get_mtu(this));
 
 	old = thread_cancelability(TRUE);
-	len = read(this->tunfd, data.ptr, data.len);
+	len = read(fd, data.ptr, data.len);
 	thread_cancelability(old);
 	if (len < 0)
 	{
+		if (errno == EAGAIN || errno == EWOULDBLOCK)
+		{	/* the FD is non-blocking and the device is drained */
+			return FALSE;
+		}
 		DBG1(DBG_LIB, "reading from TUN device %s failed: %s", this->if_name,
 			 strerror(errno));
 		return FALSE;
@@ -370,9 +407,34 @@ METHOD(tun_device_t, read_packet, bool,
 	return TRUE;
 }
 
+METHOD(tun_device_t, read_packet, bool,
+	private_tun_device_t *this, chunk_t *packet)
+{
+	return read_packet_fd(this, this->tunfd, packet);
+}
+
+METHOD(tun_device_t, read_packet_queue, bool,
+	private_tun_device_t *this, u_int queue, chunk_t *packet)
+{
+	if (queue >= this->queues)
+	{
+		return FALSE;
+	}
+	return read_packet_fd(this, this->queue_fds[queue], packet);
+}
+
 METHOD(tun_device_t, destroy, void,
 	private_tun_device_t *this)
 {
+	u_int i;
+
+	/* the first queue FD equals tunfd and is closed below */
+	for (i = 1; i < this->queues; i++)
+	{
+		close(this->queue_fds[i]);
+	}
+	free(this->queue_fds);
+
 	if (this->tunfd > 0)
 	{
 		close(this->tunfd);
@@ -455,6 +517,8 @@ static bool init_tun(private_tun_device_t *this, const char *name_tmpl)
 #elif defined(IFF_TUN)
 
 	struct ifreq ifr;
+	u_int i;
+	int fd;
 
 	strncpy(this->if_name, name_tmpl ?: "tun%d", IFNAMSIZ);
 	this->if_name[IFNAMSIZ-1] = '\0';
@@ -471,6 +535,19 @@ static bool init_tun(private_tun_device_t *this, const char *name_tmpl)
 	/* TUN device, no packet info */
 	ifr.ifr_flags = IFF_TUN | IFF_NO_PI;
 
+#ifdef IFF_MULTI_QUEUE
+	if (this->queues > 1)
+	{
+		ifr.ifr_flags |= IFF_MULTI_QUEUE;
+	}
+#else
+	if (this->queues > 1)
+	{
+		DBG1(DBG_LIB, "multi-queue TUN devices are not supported");
+		this->queues = 1;
+	}
+#endif
+
 	strncpy(ifr.ifr_name, this->if_name, IFNAMSIZ);
 	if (ioctl(this->tunfd, TUNSETIFF, (void*)&ifr) < 0)
 	{
@@ -479,6 +556,26 @@ static bool init_tun(private_tun_device_t *this, const char *name_tmpl)
 		return FALSE;
 	}
 	strncpy(this->if_name, ifr.ifr_name, IFNAMSIZ);
+
+	/* attach the additional queues, ifr still holds the device name */
+	this->queue_fds = malloc(this->queues * sizeof(int));
+	this->queue_fds[0] = this->tunfd;
+	for (i = 1; i < this->queues; i++)
+	{
+		fd = open("/dev/net/tun", O_RDWR);
+		if (fd < 0 || ioctl(fd, TUNSETIFF, (void*)&ifr) < 0)
+		{
+			DBG1(DBG_LIB, "failed to attach queue %u to TUN device %s: %s",
+				 i, this->if_name, strerror(errno));
+			if (fd >= 0)
+			{
+				close(fd);
+			}
+			this->queues = i;
+			break;
+		}
+		this->queue_fds[i] = fd;
+	}
 	return TRUE;
 
 #else /* !IFF_TUN */
@@ -516,18 +613,21 @@ static bool init_tun(private_tun_device_t *this, const char *name_tmpl)
 /*
  * Described in header
  */
-tun_device_t *tun_device_create(const char *name_tmpl)
+tun_device_t *tun_device_create_queues(const char *name_tmpl, u_int queues)
 {
 	private_tun_device_t *this;
 
 	INIT(this,
 		.public = {
 			.read_packet = _read_packet,
+			.read_packet_queue = _read_packet_queue,
 			.write_packet = _write_packet,
 			.get_mtu = _get_mtu,
 			.set_mtu = _set_mtu,
 			.get_name = _get_name,
 			.get_fd = _get_fd,
+			.get_queues = _get_queues,
+			.get_queue_fd = _get_queue_fd,
 			.set_address = _set_address,
 			.get_address = _get_address,
 			.up = _up,
@@ -535,13 +635,21 @@ tun_device_t *tun_device_create(const char *name_tmpl)
 		},
 		.tunfd = -1,
 		.sock = -1,
+		.queues = max(1, queues),
 	);
 
 	if (!init_tun(this, name_tmpl))
 	{
+		free(this->queue_fds);
 		free(this);
 		return NULL;
 	}
+	if (!this->queue_fds)
+	{	/* platforms without multi-queue support only have the single FD */
+		this->queues = 1;
+		this->queue_fds = malloc(sizeof(int));
+		this->queue_fds[0] = this->tunfd;
+	}
 	DBG1(DBG_LIB, "created TUN device: %s", this->if_name);
 
 	this->sock = socket(AF_INET, SOCK_DGRAM, 0);
@@ -554,4 +662,12 @@ tun_device_t *tun_device_create(const char *name_tmpl)
 	return &this->public;
 }
 
+/*
+ * Described in header
+ */
+tun_device_t *tun_device_create(const char *name_tmpl)
+{
+	return tun_device_create_queues(name_tmpl, 1);
+}
+
 #endif /* TUN devices supported */
@@ -38,13 +38,26 @@ struct tun_device_t {
 	 * Read a packet from the TUN device
 	 *
 	 * @note This call blocks until a packet is available. It is a thread
-	 * cancellation point.
+	 * cancellation point. If the file descriptor was set non-blocking, it
+	 * instead returns FALSE once the device is drained.
 	 *
 	 * @param packet		the packet read from the device, allocated
 	 * @return				TRUE if successful
 	 */
 	bool (*read_packet)(tun_device_t *this, chunk_t *packet);
 
+	/**
+	 * Read a packet from a specific queue of the TUN device
+	 *
+	 * Semantics are the same as for read_packet(), which reads from the
+	 * first queue.
+	 *
+	 * @param queue			queue to read from
+	 * @param packet		the packet read from the device, allocated
+	 * @return				TRUE if successful
+	 */
+	bool (*read_packet_queue)(tun_device_t *this, u_int queue, chunk_t *packet);
+
 	/**
 	 * Write a packet to the TUN device
 	 *
@@ -106,6 +119,22 @@ struct tun_device_t {
 	 */
 	int (*get_fd)(tun_device_t *this);
 
+	/**
+	 * Get the number of queues of this device, 1 unless created with
+	 * tun_device_create_queues() on a platform supporting it.
+	 *
+	 * @return				number of queues
+	 */
+	u_int (*get_queues)(tun_device_t *this);
+
+	/**
+	 * Get the file descriptor of a specific queue.
+	 *
+	 * @param queue			queue to get the file descriptor for
+	 * @return				file descriptor, -1 if queue does not exist
+	 */
+	int (*get_queue_fd)(tun_device_t *this, u_int queue);
+
 	/**
 	 * Destroy a tun_device_t
 	 */
@@ -121,4 +150,18 @@ struct tun_device_t {
  */
 tun_device_t *tun_device_create(const char *name_tmpl);
 
+/**
+ * Create a TUN device with multiple queues.
+ *
+ * On Linux, the device is created with IFF_MULTI_QUEUE and a separate file
+ * descriptor per queue, so each queue can be drained by its own thread.  On
+ * platforms without multi-queue support, the device falls back to a single
+ * queue.
+ *
+ * @param name_tmpl			name template, defaults to "tun%d" if not given
+ * @param queues			number of queues to create
+ * @return					TUN device
+ */
+tun_device_t *tun_device_create_queues(const char *name_tmpl, u_int queues);
+
 #endif /** TUN_DEVICE_H_ @}*/
@@ -0,0 +1,486 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Hochschule fuer Technik Rapperswil
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include "aesni_gcm.h"
+#include "aesni_key.h"
+
+#include <crypto/iv/iv_gen_seq.h>
+
+#include <tmmintrin.h>
+
+#define NONCE_SIZE 12
+#define IV_SIZE 8
+#define SALT_SIZE (NONCE_SIZE - IV_SIZE)
+
+/**
+ * Parallel pipelining we use for CTR en/decryption
+ */
+#define GCM_CRYPT_PARALLELISM 4
+
+typedef struct private_aesni_gcm_t private_aesni_gcm_t;
+
+/**
+ * Private data of an aesni_gcm_t object.
+ */
+struct private_aesni_gcm_t {
+
+	/**
+	 * Public aesni_gcm_t interface.
+	 */
+	aesni_gcm_t public;
+
+	/**
+	 * Encryption key schedule
+	 */
+	aesni_key_t *key;
+
+	/**
+	 * IV generator.
+	 */
+	iv_gen_t *iv_gen;
+
+	/**
+	 * Length of the integrity check value
+	 */
+	size_t icv_size;
+
+	/**
+	 * Length of the key in bytes
+	 */
+	size_t key_size;
+
+	/**
+	 * GHASH subkey H, in bit-reflected form
+	 */
+	__m128i h;
+
+	/**
+	 * Salt value
+	 */
+	u_char salt[SALT_SIZE];
+};
+
+/**
+ * Byte-swap a 128-bit integer, as GHASH works on big endian blocks
+ */
+static inline __m128i swap128(__m128i x)
+{
+	return _mm_shuffle_epi8(x,
+			_mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+}
+
+/**
+ * Multiply two blocks in GF(2^128), using carry-less multiplication
+ */
+static __m128i mult_block(__m128i h, __m128i y)
+{
+	__m128i t2, t3, t4, t5, t6, t7, t8, t9;
+
+	t3 = _mm_clmulepi64_si128(y, h, 0x00);
+	t4 = _mm_clmulepi64_si128(y, h, 0x10);
+	t5 = _mm_clmulepi64_si128(y, h, 0x01);
+	t6 = _mm_clmulepi64_si128(y, h, 0x11);
+
+	t4 = _mm_xor_si128(t4, t5);
+	t5 = _mm_slli_si128(t4, 8);
+	t4 = _mm_srli_si128(t4, 8);
+	t3 = _mm_xor_si128(t3, t5);
+	t6 = _mm_xor_si128(t6, t4);
+
+	t7 = _mm_srli_epi32(t3, 31);
+	t8 = _mm_srli_epi32(t6, 31);
+	t3 = _mm_slli_epi32(t3, 1);
+	t6 = _mm_slli_epi32(t6, 1);
+
+	t9 = _mm_srli_si128(t7, 12);
+	t8 = _mm_slli_si128(t8, 4);
+	t7 = _mm_slli_si128(t7, 4);
+	t3 = _mm_or_si128(t3, t7);
+	t6 = _mm_or_si128(t6, t8);
+	t6 = _mm_or_si128(t6, t9);
+
+	t7 = _mm_slli_epi32(t3, 31);
+	t8 = _mm_slli_epi32(t3, 30);
+	t9 = _mm_slli_epi32(t3, 25);
+
+	t7 = _mm_xor_si128(t7, t8);
+	t7 = _mm_xor_si128(t7, t9);
+	t8 = _mm_srli_si128(t7, 4);
+	t7 = _mm_slli_si128(t7, 12);
+	t3 = _mm_xor_si128(t3, t7);
+
+	t2 = _mm_srli_epi32(t3, 1);
+	t4 = _mm_srli_epi32(t3, 2);
+	t5 = _mm_srli_epi32(t3, 7);
+	t2 = _mm_xor_si128(t2, t4);
+	t2 = _mm_xor_si128(t2, t5);
+	t2 = _mm_xor_si128(t2, t8);
+	t3 = _mm_xor_si128(t3, t2);
+	t6 = _mm_xor_si128(t6, t3);
+
+	return t6;
+}
+
+/**
+ * Fold a full block into the GHASH state
+ */
+static inline __m128i ghash_block(__m128i h, __m128i y, __m128i block)
+{
+	return mult_block(h, _mm_xor_si128(y, swap128(block)));
+}
+
+/**
+ * Fold a chunk of data into the GHASH state, zero-padding the last block
+ */
+static __m128i ghash_chunk(__m128i h, __m128i y, chunk_t data)
+{
+	u_char buf[AES_BLOCK_SIZE];
+
+	while (data.len >= AES_BLOCK_SIZE)
+	{
+		y = ghash_block(h, y, _mm_loadu_si128((__m128i*)data.ptr));
+		data = chunk_skip(data, AES_BLOCK_SIZE);
+	}
+	if (data.len)
+	{
+		memset(buf, 0, AES_BLOCK_SIZE);
+		memcpy(buf, data.ptr, data.len);
+		y = ghash_block(h, y, _mm_loadu_si128((__m128i*)buf));
+	}
+	return y;
+}
+
+/**
+ * Encrypt a single counter block
+ */
+static __m128i encrypt_block(aesni_key_t *key, __m128i block)
+{
+	__m128i *ks = key->schedule;
+	u_int round;
+
+	block = _mm_xor_si128(block, ks[0]);
+	for (round = 1; round < key->rounds; round++)
+	{
+		block = _mm_aesenc_si128(block, ks[round]);
+	}
+	return _mm_aesenclast_si128(block, ks[key->rounds]);
+}
+
+/**
+ * Build the counter block for a given counter value
+ */
+static inline __m128i counter_block(u_char *j, u_int32_t counter)
+{
+	u_char cb[AES_BLOCK_SIZE];
+
+	memcpy(cb, j, NONCE_SIZE);
+	htoun32(cb + NONCE_SIZE, counter);
+	return _mm_loadu_si128((__m128i*)cb);
+}
+
+/**
+ * En-/decrypt the payload in counter mode, four blocks pipelined
+ */
+static void crypt_ctr(private_aesni_gcm_t *this, u_char *j,
+					  chunk_t in, u_char *out)
+{
+	__m128i *ks, *bi, *bo;
+	__m128i t1, t2, t3, t4, d1, d2, d3, d4;
+	u_int32_t counter = 2;
+	u_int blocks, pblocks, rem, round, i;
+	u_char buf[AES_BLOCK_SIZE];
+
+	ks = this->key->schedule;
+	bi = (__m128i*)in.ptr;
+	bo = (__m128i*)out;
+	blocks = in.len / AES_BLOCK_SIZE;
+	pblocks = blocks - (blocks % GCM_CRYPT_PARALLELISM);
+	rem = in.len % AES_BLOCK_SIZE;
+
+	for (i = 0; i < pblocks; i += GCM_CRYPT_PARALLELISM)
+	{
+		t1 = counter_block(j, counter++);
+		t2 = counter_block(j, counter++);
+		t3 = counter_block(j, counter++);
+		t4 = counter_block(j, counter++);
+
+		t1 = _mm_xor_si128(t1, ks[0]);
+		t2 = _mm_xor_si128(t2, ks[0]);
+		t3 = _mm_xor_si128(t3, ks[0]);
+		t4 = _mm_xor_si128(t4, ks[0]);
+
+		for (round = 1; round < this->key->rounds; round++)
+		{
+			t1 = _mm_aesenc_si128(t1, ks[round]);
+			t2 = _mm_aesenc_si128(t2, ks[round]);
+			t3 = _mm_aesenc_si128(t3, ks[round]);
+			t4 = _mm_aesenc_si128(t4, ks[round]);
+		}
+		t1 = _mm_aesenclast_si128(t1, ks[this->key->rounds]);
+		t2 = _mm_aesenclast_si128(t2, ks[this->key->rounds]);
+		t3 = _mm_aesenclast_si128(t3, ks[this->key->rounds]);
+		t4 = _mm_aesenclast_si128(t4, ks[this->key->rounds]);
+
+		d1 = _mm_loadu_si128(bi + i + 0);
+		d2 = _mm_loadu_si128(bi + i + 1);
+		d3 = _mm_loadu_si128(bi + i + 2);
+		d4 = _mm_loadu_si128(bi + i + 3);
+
+		_mm_storeu_si128(bo + i + 0, _mm_xor_si128(t1, d1));
+		_mm_storeu_si128(bo + i + 1, _mm_xor_si128(t2, d2));
+		_mm_storeu_si128(bo + i + 2, _mm_xor_si128(t3, d3));
+		_mm_storeu_si128(bo + i + 3, _mm_xor_si128(t4, d4));
+	}
+	for (i = pblocks; i < blocks; i++)
+	{
+		t1 = encrypt_block(this->key, counter_block(j, counter++));
+		d1 = _mm_loadu_si128(bi + i);
+		_mm_storeu_si128(bo + i, _mm_xor_si128(t1, d1));
+	}
+	if (rem)
+	{
+		t1 = encrypt_block(this->key, counter_block(j, counter));
+		_mm_storeu_si128((__m128i*)buf, t1);
+		memxor(memcpy(out + blocks * AES_BLOCK_SIZE,
+					  in.ptr + blocks * AES_BLOCK_SIZE, rem), buf, rem);
+	}
+}
+
+/**
+ * Calculate the ICV for the given encrypted payload and associated data
+ */
+static void create_icv(private_aesni_gcm_t *this, chunk_t assoc, chunk_t crypt,
+					   u_char *j, u_char *icv)
+{
+	u_char buf[AES_BLOCK_SIZE];
+	__m128i y, t;
+
+	y = _mm_setzero_si128();
+	y = ghash_chunk(this->h, y, assoc);
+	y = ghash_chunk(this->h, y, crypt);
+
+	htoun64(buf, assoc.len * 8);
+	htoun64(buf + 8, crypt.len * 8);
+	y = ghash_block(this->h, y, _mm_loadu_si128((__m128i*)buf));
+
+	t = encrypt_block(this->key, counter_block(j, 1));
+	t = _mm_xor_si128(t, swap128(y));
+
+	_mm_storeu_si128((__m128i*)buf, t);
+	memcpy(icv, buf, this->icv_size);
+}
+
+/**
+ * Verify the ICV value of a received message
+ */
+static bool verify_icv(private_aesni_gcm_t *this, chunk_t assoc, chunk_t crypt,
+					   u_char *j, u_char *icv)
+{
+	u_char tmp[this->icv_size];
+
+	create_icv(this, assoc, crypt, j, tmp);
+	return memeq_const(tmp, icv, this->icv_size);
+}
+
+/**
+ * Generate the block J, the implicit nonce concatenated with the IV
+ */
+static void create_j(private_aesni_gcm_t *this, u_char *iv, u_char *j)
+{
+	memcpy(j, this->salt, SALT_SIZE);
+	memcpy(j + SALT_SIZE, iv, IV_SIZE);
+}
+
+METHOD(aead_t, encrypt, bool,
+	private_aesni_gcm_t *this, chunk_t plain, chunk_t assoc, chunk_t iv,
+	chunk_t *encrypted)
+{
+	u_char j[NONCE_SIZE];
+	chunk_t crypt;
+
+	if (!this->key)
+	{
+		return FALSE;
+	}
+	create_j(this, iv.ptr, j);
+
+	if (encrypted)
+	{
+		*encrypted = chunk_alloc(plain.len + this->icv_size);
+		crypt = chunk_create(encrypted->ptr, plain.len);
+	}
+	else
+	{
+		crypt = plain;
+	}
+	crypt_ctr(this, j, plain, crypt.ptr);
+	create_icv(this, assoc, crypt, j, crypt.ptr + crypt.len);
+	return TRUE;
+}
+
+METHOD(aead_t, decrypt, bool,
+	private_aesni_gcm_t *this, chunk_t encrypted, chunk_t assoc, chunk_t iv,
+	chunk_t *plain)
+{
+	u_char j[NONCE_SIZE];
+
+	if (!this->key || encrypted.len < this->icv_size)
+	{
+		return FALSE;
+	}
+	create_j(this, iv.ptr, j);
+
+	encrypted.len -= this->icv_size;
+	if (!verify_icv(this, assoc, encrypted, j,
+					encrypted.ptr + encrypted.len))
+	{
+		return FALSE;
+	}
+	if (plain)
+	{
+		*plain = chunk_alloc(encrypted.len);
+		crypt_ctr(this, j, encrypted, plain->ptr);
+	}
+	else
+	{
+		crypt_ctr(this, j, encrypted, encrypted.ptr);
+	}
+	return TRUE;
+}
+
+METHOD(aead_t, get_block_size, size_t,
+	private_aesni_gcm_t *this)
+{
+	return 1;
+}
+
+METHOD(aead_t, get_icv_size, size_t,
+	private_aesni_gcm_t *this)
+{
+	return this->icv_size;
+}
+
+METHOD(aead_t, get_iv_size, size_t,
+	private_aesni_gcm_t *this)
+{
+	return IV_SIZE;
+}
+
+METHOD(aead_t, get_iv_gen, iv_gen_t*,
+	private_aesni_gcm_t *this)
+{
+	return this->iv_gen;
+}
+
+METHOD(aead_t, get_key_size, size_t,
+	private_aesni_gcm_t *this)
+{
+	return this->key_size + SALT_SIZE;
+}
+
+METHOD(aead_t, set_key, bool,
+	private_aesni_gcm_t *this, chunk_t key)
+{
+	if (key.len != this->key_size + SALT_SIZE)
+	{
+		return FALSE;
+	}
+	memcpy(this->salt, key.ptr + key.len - SALT_SIZE, SALT_SIZE);
+	key.len -= SALT_SIZE;
+
+	DESTROY_IF(this->key);
+	this->key = aesni_key_create(TRUE, key);
+	if (!this->key)
+	{
+		return FALSE;
+	}
+	/* H = E(0), byte-swapped for GHASH */
+	this->h = swap128(encrypt_block(this->key, _mm_setzero_si128()));
+	return TRUE;
+}
+
+METHOD(aead_t, destroy, void,
+	private_aesni_gcm_t *this)
+{
+	DESTROY_IF(this->key);
+	memwipe(&this->h, sizeof(this->h));
+	this->iv_gen->destroy(this->iv_gen);
+	free(this);
+}
+
+/**
+ * See header
+ */
+aesni_gcm_t *aesni_gcm_create(encryption_algorithm_t algo,
+							  size_t key_size, size_t salt_size)
+{
+	private_aesni_gcm_t *this;
+	size_t icv_size;
+
+	switch (key_size)
+	{
+		case 0:
+			key_size = 16;
+			break;
+		case 16:
+		case 24:
+		case 32:
+			break;
+		default:
+			return NULL;
+	}
+	if (salt_size && salt_size != SALT_SIZE)
+	{
+		/* currently not supported */
+		return NULL;
+	}
+	switch (algo)
+	{
+		case ENCR_AES_GCM_ICV8:
+			icv_size = 8;
+			break;
+		case ENCR_AES_GCM_ICV12:
+			icv_size = 12;
+			break;
+		case ENCR_AES_GCM_ICV16:
+			icv_size = 16;
+			break;
+		default:
+			return NULL;
+	}
+
+	INIT(this,
+		.public = {
+			.aead = {
+				.encrypt = _encrypt,
+				.decrypt = _decrypt,
+				.encrypt_batch = aead_encrypt_batch_generic,
+				.decrypt_batch = aead_decrypt_batch_generic,
+				.get_block_size = _get_block_size,
+				.get_icv_size = _get_icv_size,
+				.get_iv_size = _get_iv_size,
+				.get_iv_gen = _get_iv_gen,
+				.get_key_size = _get_key_size,
+				.set_key = _set_key,
+				.destroy = _destroy,
+			},
+		},
+		.iv_gen = iv_gen_seq_create(),
+		.key_size = key_size,
+		.icv_size = icv_size,
+	);
+
+	return &this->public;
+}
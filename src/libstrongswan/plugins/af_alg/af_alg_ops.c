@@ -17,10 +17,29 @@
 
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <linux/socket.h>
 
 #include <utils/debug.h>
 
+/* vmsplice()/splice() are GNU extensions; we can't define _GNU_SOURCE to get
+ * their declarations, as that pulls in a libc crypt() prototype conflicting
+ * with our method of the same name */
+ssize_t vmsplice(int fd, const struct iovec *iov, unsigned long nr_segs,
+				 unsigned int flags);
+ssize_t splice(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out,
+			   size_t len, unsigned int flags);
+
+#ifndef SPLICE_F_MORE
+#define SPLICE_F_MORE 4
+#endif
+
+/**
+ * Maximum number of bytes submitted per splice() batch; both the default
+ * pipe capacity and the AF_ALG operation limit are 16 pages.
+ */
+#define SPLICE_CHUNK 65536
+
 typedef struct private_af_alg_ops_t private_af_alg_ops_t;
 
 /**
@@ -42,8 +61,36 @@ struct private_af_alg_ops_t {
 	 * Operation FD
 	 */
 	int op;
+
+	/**
+	 * Pipe to vmsplice() data into the operation socket, -1 if unavailable
+	 */
+	int pipes[2];
+
+	/**
+	 * Use the zero-copy vmsplice()/splice() submission path?
+	 */
+	bool splice;
 };
 
+/**
+ * Accept the persistent operation socket from the transform, if not open yet
+ */
+static bool open_op(private_af_alg_ops_t *this, char *kind)
+{
+	while (this->op == -1)
+	{
+		this->op = accept(this->tfm, NULL, 0);
+		if (this->op == -1 && errno != EINTR)
+		{
+			DBG1(DBG_LIB, "opening AF_ALG %s failed: %s", kind,
+				 strerror(errno));
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
 METHOD(af_alg_ops_t, reset, void,
 	private_af_alg_ops_t *this)
 {
@@ -59,14 +106,9 @@ METHOD(af_alg_ops_t, hash, bool,
 {
 	ssize_t len;
 
-	while (this->op == -1)
+	if (!open_op(this, "hasher"))
 	{
-		this->op = accept(this->tfm, NULL, 0);
-		if (this->op == -1 && errno != EINTR)
-		{
-			DBG1(DBG_LIB, "opening AF_ALG hasher failed: %s", strerror(errno));
-			return FALSE;
-		}
+		return FALSE;
 	}
 
 	do
@@ -107,6 +149,74 @@ METHOD(af_alg_ops_t, hash, bool,
 	return TRUE;
 }
 
+/**
+ * Read processed data back from the operation socket
+ */
+static bool read_out(private_af_alg_ops_t *this, char *out, size_t outlen)
+{
+	ssize_t len;
+
+	while (outlen)
+	{
+		len = read(this->op, out, outlen);
+		if (len == -1)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			DBG1(DBG_LIB, "reading from AF_ALG crypter failed: %s",
+				 strerror(errno));
+			return FALSE;
+		}
+		outlen -= len;
+		out += len;
+	}
+	return TRUE;
+}
+
+/**
+ * Map a batch of data into the pipe and splice it into the operation socket,
+ * avoiding the copy to kernel space
+ */
+static bool splice_in(private_af_alg_ops_t *this, chunk_t data, bool more)
+{
+	struct iovec iov;
+	ssize_t len, done;
+
+	while (data.len)
+	{
+		iov.iov_base = data.ptr;
+		iov.iov_len = data.len;
+
+		len = vmsplice(this->pipes[1], &iov, 1, 0);
+		if (len == -1)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return FALSE;
+		}
+		data = chunk_skip(data, len);
+		while (len)
+		{
+			done = splice(this->pipes[0], NULL, this->op, NULL, len,
+						  (more || data.len) ? SPLICE_F_MORE : 0);
+			if (done == -1)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+				return FALSE;
+			}
+			len -= done;
+		}
+	}
+	return TRUE;
+}
+
 METHOD(af_alg_ops_t, crypt, bool,
 	private_af_alg_ops_t *this, u_int32_t type, chunk_t iv, chunk_t data,
 	char *out)
@@ -118,18 +228,11 @@ METHOD(af_alg_ops_t, crypt, bool,
 	char buf[CMSG_SPACE(sizeof(type)) +
 			 CMSG_SPACE(offsetof(struct af_alg_iv, iv) + iv.len)];
 	ssize_t len;
-	int op;
 
-	do
+	if (!open_op(this, "crypter"))
 	{
-		op = accept(this->tfm, NULL, 0);
-		if (op == -1 && errno != EINTR)
-		{
-			DBG1(DBG_LIB, "accepting AF_ALG crypter failed: %s", strerror(errno));
-			return FALSE;
-		}
+		return FALSE;
 	}
-	while (op == -1);
 
 	memset(buf, 0, sizeof(buf));
 
@@ -150,6 +253,39 @@ METHOD(af_alg_ops_t, crypt, bool,
 	ivm->ivlen = iv.len;
 	memcpy(ivm->iv, iv.ptr, iv.len);
 
+	if (this->splice)
+	{
+		/* announce the request with the control data only, the payload
+		 * follows through the pipe without getting copied */
+		if (sendmsg(this->op, &msg, MSG_MORE) == -1)
+		{
+			DBG1(DBG_LIB, "writing to AF_ALG crypter failed: %s",
+				 strerror(errno));
+			reset(this);
+			return FALSE;
+		}
+		while (data.len)
+		{
+			len = min(data.len, SPLICE_CHUNK);
+			if (!splice_in(this, chunk_create(data.ptr, len), data.len > len))
+			{
+				DBG1(DBG_LIB, "splicing to AF_ALG crypter failed, "
+					 "using copying fallback: %s", strerror(errno));
+				this->splice = FALSE;
+				reset(this);
+				return FALSE;
+			}
+			if (!read_out(this, out, len))
+			{
+				reset(this);
+				return FALSE;
+			}
+			data = chunk_skip(data, len);
+			out += len;
+		}
+		return TRUE;
+	}
+
 	msg.msg_iov = &iov;
 	msg.msg_iovlen = 1;
 
@@ -158,7 +294,7 @@ METHOD(af_alg_ops_t, crypt, bool,
 		iov.iov_base = data.ptr;
 		iov.iov_len = data.len;
 
-		len = sendmsg(op, &msg, 0);
+		len = sendmsg(this->op, &msg, 0);
 		if (len == -1)
 		{
 			if (errno == EINTR)
@@ -166,28 +302,28 @@ METHOD(af_alg_ops_t, crypt, bool,
 				continue;
 			}
 			DBG1(DBG_LIB, "writing to AF_ALG crypter failed: %s", strerror(errno));
+			reset(this);
 			return FALSE;
 		}
-		while (read(op, out, len) != len)
+		if (!read_out(this, out, len))
 		{
-			if (errno != EINTR)
-			{
-				DBG1(DBG_LIB, "reading from AF_ALG crypter failed: %s",
-					 strerror(errno));
-				return FALSE;
-			}
+			reset(this);
+			return FALSE;
 		}
 		data = chunk_skip(data, len);
+		out += len;
 		/* no IV for subsequent data chunks */
 		msg.msg_controllen = 0;
 	}
-	close(op);
 	return TRUE;
 }
 
 METHOD(af_alg_ops_t, set_key, bool,
 	private_af_alg_ops_t *this, chunk_t key)
 {
+	/* the kernel refuses to change the key while operation sockets exist */
+	reset(this);
+
 	if (setsockopt(this->tfm, SOL_ALG, ALG_SET_KEY, key.ptr, key.len) == -1)
 	{
 		DBG1(DBG_LIB, "setting AF_ALG key failed: %s", strerror(errno));
@@ -204,6 +340,11 @@ METHOD(af_alg_ops_t, destroy, void,
 	{
 		close(this->op);
 	}
+	if (this->pipes[0] != -1)
+	{
+		close(this->pipes[0]);
+		close(this->pipes[1]);
+	}
 	free(this);
 }
 
@@ -230,6 +371,7 @@ af_alg_ops_t *af_alg_ops_create(char *type, char *alg)
 		},
 		.tfm = socket(AF_ALG, SOCK_SEQPACKET, 0),
 		.op = -1,
+		.pipes = { -1, -1 },
 	);
 	if (this->tfm == -1)
 	{
@@ -237,6 +379,14 @@ af_alg_ops_t *af_alg_ops_create(char *type, char *alg)
 		free(this);
 		return NULL;
 	}
+	if (pipe(this->pipes) == 0)
+	{
+		this->splice = TRUE;
+	}
+	else
+	{
+		this->pipes[0] = this->pipes[1] = -1;
+	}
 	if (bind(this->tfm, (struct sockaddr*)&sa, sizeof(sa)) == -1)
 	{
 		if (errno != ENOENT)
@@ -14,6 +14,7 @@
  */
 
 #include "bliss_fft.h"
+#include "bliss_fft_avx2.h"
 
 typedef struct private_bliss_fft_t private_bliss_fft_t;
 
@@ -31,6 +32,11 @@ struct private_bliss_fft_t {
 	 */
 	bliss_fft_params_t *p;
 
+	/**
+	 * Use the AVX2 butterfly code path?
+	 */
+	bool avx2;
+
 };
 
 METHOD(bliss_fft_t, get_size, uint16_t,
@@ -133,13 +139,20 @@ METHOD(bliss_fft_t, transform, void,
 			{
 				butterfly_last(this, b, t);
 			}
+#if BLISS_HAVE_AVX2
+			else if (this->avx2 && m >= 8)
+			{
+				bliss_fft_avx2_butterflies(b, this->p->w, t, m, k, n, q,
+										   inverse);
+			}
+#endif
 			else
 			{
 				for (i = 0; i < m; i++)
 				{
 					iw = 2 * (inverse ? (n - i * k) : (i * k));
 					butterfly(this, b, t + i, t + i + m, iw);
-				}				
+				}
 			}
 			t += 2*m;
 		}
@@ -193,6 +206,7 @@ bliss_fft_t *bliss_fft_create(bliss_fft_params_t *params)
 			.destroy = _destroy,
 		},
 		.p = params,
+		.avx2 = BLISS_HAVE_AVX2 && bliss_fft_avx2_available(),
 	);
 
 	return &this->public;
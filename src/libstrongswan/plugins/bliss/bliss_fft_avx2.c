@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Hochschule fuer Technik Rapperswil
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include "bliss_fft_avx2.h"
+
+#if BLISS_HAVE_AVX2
+
+#include <immintrin.h>
+
+/**
+ * CPUID leaf 7 AVX2 flag, returned in ebx
+ */
+#define CPUID7_AVX2 (1 << 5)
+
+/**
+ * Get cpuid for info/subleaf, return eax, ebx, ecx and edx.
+ * -fPIC requires to save ebx on IA-32.
+ */
+static void cpuid(u_int op, u_int sub, u_int *a, u_int *b, u_int *c, u_int *d)
+{
+#ifdef __x86_64__
+	asm("cpuid" : "=a" (*a), "=b" (*b), "=c" (*c), "=d" (*d)
+			: "a" (op), "c" (sub));
+#else /* __i386__ */
+	asm("pushl %%ebx;"
+		"cpuid;"
+		"movl %%ebx, %1;"
+		"popl %%ebx;"
+		: "=a" (*a), "=r" (*b), "=c" (*c), "=d" (*d) : "a" (op), "c" (sub));
+#endif /* __x86_64__ / __i386__*/
+}
+
+/**
+ * See header
+ */
+bool bliss_fft_avx2_available()
+{
+	u_int a, b, c, d;
+
+	cpuid(0, 0, &a, &b, &c, &d);
+	if (a < 7)
+	{
+		return FALSE;
+	}
+	cpuid(7, 0, &a, &b, &c, &d);
+	return (b & CPUID7_AVX2) != 0;
+}
+
+/**
+ * Unsigned high 32-bit multiplication of eight lanes
+ */
+__attribute__((target("avx2")))
+static inline __m256i mulhi_epu32(__m256i a, __m256i b)
+{
+	__m256i lo, hi;
+
+	lo = _mm256_srli_epi64(_mm256_mul_epu32(a, b), 32);
+	hi = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32));
+	hi = _mm256_and_si256(hi, _mm256_set1_epi64x(0xffffffff00000000LL));
+	return _mm256_or_si256(lo, hi);
+}
+
+/**
+ * See header
+ */
+__attribute__((target("avx2")))
+void bliss_fft_avx2_butterflies(uint32_t *x, uint16_t *w, int t, int m,
+								int k, int n, uint16_t q, bool inverse)
+{
+	__m256i vq, vmagic, x1, x2, xp, xm, vw, mul, qhat, r;
+	uint32_t tw[8];
+	int i, l, iw;
+
+	vq = _mm256_set1_epi32(q);
+	/* Barrett reciprocal; as the butterfly products stay below 2^29, the
+	 * quotient estimate is off by at most one */
+	vmagic = _mm256_set1_epi32((uint32_t)((1ULL << 32) / q));
+
+	for (i = 0; i < m; i += 8)
+	{
+		for (l = 0; l < 8; l++)
+		{
+			iw = 2 * (inverse ? (n - (i + l) * k) : ((i + l) * k));
+			tw[l] = w[iw];
+		}
+		vw = _mm256_loadu_si256((__m256i*)tw);
+		x1 = _mm256_loadu_si256((__m256i*)&x[t + i]);
+		x2 = _mm256_loadu_si256((__m256i*)&x[t + i + m]);
+
+		/* xp = x1 + x2 mod q; the subtraction wraps around if xp < q,
+		 * making the minimum pick the unreduced value */
+		xp = _mm256_add_epi32(x1, x2);
+		xp = _mm256_min_epu32(xp, _mm256_sub_epi32(xp, vq));
+
+		/* xm = (x1 - x2 + q) * w mod q, reduced via Barrett */
+		xm = _mm256_add_epi32(x1, _mm256_sub_epi32(vq, x2));
+		mul = _mm256_mullo_epi32(xm, vw);
+		qhat = mulhi_epu32(mul, vmagic);
+		r = _mm256_sub_epi32(mul, _mm256_mullo_epi32(qhat, vq));
+		r = _mm256_min_epu32(r, _mm256_sub_epi32(r, vq));
+
+		_mm256_storeu_si256((__m256i*)&x[t + i], xp);
+		_mm256_storeu_si256((__m256i*)&x[t + i + m], r);
+	}
+}
+
+#endif /* BLISS_HAVE_AVX2 */
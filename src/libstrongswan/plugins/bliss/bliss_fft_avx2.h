@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Hochschule fuer Technik Rapperswil
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/**
+ * @defgroup bliss_fft_avx2 bliss_fft_avx2
+ * @{ @ingroup bliss_p
+ */
+
+#ifndef BLISS_FFT_AVX2_H_
+#define BLISS_FFT_AVX2_H_
+
+#include <library.h>
+
+/**
+ * TRUE if we can build the AVX2 code path for this target
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && \
+	(__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define BLISS_HAVE_AVX2 1
+#else
+#define BLISS_HAVE_AVX2 0
+#endif
+
+/**
+ * Check if the CPU supports the AVX2 instructions.
+ *
+ * @return		TRUE if bliss_fft_avx2_butterflies() may be used
+ */
+bool bliss_fft_avx2_available();
+
+/**
+ * Compute the butterflies of one FFT stage block using AVX2 instructions,
+ * eight butterflies at a time.
+ *
+ * May be called only if bliss_fft_avx2_available() returned TRUE and m is
+ * a multiple of eight.
+ *
+ * @param x			coefficient array the butterflies operate on
+ * @param w			twiddle factor table of the FFT parameter set
+ * @param t			offset of the stage block in x
+ * @param m			distance between the butterfly inputs
+ * @param k			twiddle factor stride of the stage
+ * @param n			transform size
+ * @param q			prime modulus
+ * @param inverse	TRUE for the inverse transform
+ */
+void bliss_fft_avx2_butterflies(uint32_t *x, uint16_t *w, int t, int m,
+								int k, int n, uint16_t q, bool inverse);
+
+#endif /** BLISS_FFT_AVX2_H_ @}*/
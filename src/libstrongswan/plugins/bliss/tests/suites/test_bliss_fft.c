@@ -91,6 +91,33 @@ START_TEST(test_bliss_fft_wrap)
 }
 END_TEST
 
+START_TEST(test_bliss_fft_roundtrip)
+{
+	bliss_fft_t *fft;
+	uint16_t n = fft_params[_i]->n;
+	uint16_t q = fft_params[_i]->q;
+	uint32_t x[n], X[n], y[n];
+	uint32_t seed = 1;
+	int i;
+
+	/* deterministic pseudo-random coefficients covering the full range */
+	for (i = 0; i < n; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		x[i] = seed % q;
+	}
+	fft = bliss_fft_create(fft_params[_i]);
+	fft->transform(fft, x, X, FALSE);
+	fft->transform(fft, X, y, TRUE);
+
+	for (i = 0; i < n; i++)
+	{
+		ck_assert(y[i] == x[i]);
+	}
+	fft->destroy(fft);
+}
+END_TEST
+
 Suite *bliss_fft_suite_create()
 {
 	Suite *s;
@@ -106,5 +133,9 @@ Suite *bliss_fft_suite_create()
 	tcase_add_loop_test(tc, test_bliss_fft_wrap, 0, countof(fft_params));
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("roundtrip");
+	tcase_add_loop_test(tc, test_bliss_fft_roundtrip, 0, countof(fft_params));
+	suite_add_tcase(s, tc);
+
 	return s;
 }
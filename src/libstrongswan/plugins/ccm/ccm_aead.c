@@ -401,6 +401,8 @@ ccm_aead_t *ccm_aead_create(encryption_algorithm_t algo,
 			.aead = {
 				.encrypt = _encrypt,
 				.decrypt = _decrypt,
+				.encrypt_batch = aead_encrypt_batch_generic,
+				.decrypt_batch = aead_decrypt_batch_generic,
 				.get_block_size = _get_block_size,
 				.get_icv_size = _get_icv_size,
 				.get_iv_size = _get_iv_size,
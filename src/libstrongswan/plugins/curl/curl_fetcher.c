@@ -20,6 +20,7 @@
 #include <utils/debug.h>
 
 #include "curl_fetcher.h"
+#include "curl_plugin.h"
 
 #define CONNECT_TIMEOUT 10
 
@@ -229,7 +230,7 @@ METHOD(fetcher_t, destroy, void,
 	private_curl_fetcher_t *this)
 {
 	curl_slist_free_all(this->headers);
-	curl_easy_cleanup(this->curl);
+	curl_plugin_release_handle(this->curl);
 	free(this);
 }
 
@@ -248,7 +249,7 @@ curl_fetcher_t *curl_fetcher_create()
 				.destroy = _destroy,
 			},
 		},
-		.curl = curl_easy_init(),
+		.curl = curl_plugin_create_handle(),
 		.cb = fetcher_default_callback,
 	);
 
@@ -17,10 +17,17 @@
 
 #include <library.h>
 #include <utils/debug.h>
+#include <threading/mutex.h>
+#include <collections/linked_list.h>
 #include "curl_fetcher.h"
 
 #include <curl/curl.h>
 
+/**
+ * Default number of idle easy handles kept for reuse
+ */
+#define DEFAULT_POOL_SIZE 8
+
 typedef struct private_curl_plugin_t private_curl_plugin_t;
 
 /**
@@ -42,8 +49,111 @@ struct private_curl_plugin_t {
 	 * Number of supported features
 	 */
 	int count;
+
+	/**
+	 * Idle easy handles kept for reuse, as CURL*
+	 */
+	linked_list_t *pool;
+
+	/**
+	 * Maximum number of idle handles to keep
+	 */
+	int pool_size;
+
+	/**
+	 * Mutex protecting the handle pool
+	 */
+	mutex_t *mutex;
+
+	/**
+	 * Share handle with DNS and SSL session caches, common to all fetchers
+	 */
+	CURLSH *share;
+
+	/**
+	 * Locks for the share handle data, as required by libcurl
+	 */
+	mutex_t *share_locks[CURL_LOCK_DATA_LAST];
 };
 
+/**
+ * The plugin instance, for handle pool access from fetchers
+ */
+static private_curl_plugin_t *singleton;
+
+/**
+ * Share handle lock callback
+ */
+static void share_lock(CURL *handle, curl_lock_data data,
+					   curl_lock_access access, void *user)
+{
+	private_curl_plugin_t *this = user;
+
+	this->share_locks[data]->lock(this->share_locks[data]);
+}
+
+/**
+ * Share handle unlock callback
+ */
+static void share_unlock(CURL *handle, curl_lock_data data, void *user)
+{
+	private_curl_plugin_t *this = user;
+
+	this->share_locks[data]->unlock(this->share_locks[data]);
+}
+
+/*
+ * Described in header
+ */
+CURL *curl_plugin_create_handle()
+{
+	private_curl_plugin_t *this = singleton;
+	CURL *handle = NULL;
+
+	if (this)
+	{
+		this->mutex->lock(this->mutex);
+		this->pool->remove_first(this->pool, (void**)&handle);
+		this->mutex->unlock(this->mutex);
+	}
+	if (!handle)
+	{
+		handle = curl_easy_init();
+	}
+	if (handle && this && this->share)
+	{
+		curl_easy_setopt(handle, CURLOPT_SHARE, this->share);
+	}
+	return handle;
+}
+
+/*
+ * Described in header
+ */
+void curl_plugin_release_handle(CURL *handle)
+{
+	private_curl_plugin_t *this = singleton;
+	bool pooled = FALSE;
+
+	/* drops all options, but keeps live connections and the share binding,
+	 * so a later fetch to the same origin reuses the connection */
+	curl_easy_reset(handle);
+	if (this)
+	{
+		this->mutex->lock(this->mutex);
+		if (this->pool->get_count(this->pool) < this->pool_size)
+		{
+			this->pool->insert_first(this->pool, handle);
+			pooled = TRUE;
+		}
+		this->mutex->unlock(this->mutex);
+	}
+	if (!pooled)
+	{
+		curl_easy_cleanup(handle);
+	}
+}
+
 /**
  * Append a feature to supported feature list
  */
@@ -149,6 +259,24 @@ METHOD(plugin_t, get_features, int,
 METHOD(plugin_t, destroy, void,
 	private_curl_plugin_t *this)
 {
+	CURL *handle;
+	int i;
+
+	singleton = NULL;
+	while (this->pool->remove_first(this->pool, (void**)&handle) == SUCCESS)
+	{
+		curl_easy_cleanup(handle);
+	}
+	this->pool->destroy(this->pool);
+	if (this->share)
+	{
+		curl_share_cleanup(this->share);
+	}
+	for (i = 0; i < CURL_LOCK_DATA_LAST; i++)
+	{
+		this->share_locks[i]->destroy(this->share_locks[i]);
+	}
+	this->mutex->destroy(this->mutex);
 	curl_global_cleanup();
 	free(this->features);
 	free(this);
@@ -161,6 +289,7 @@ plugin_t *curl_plugin_create()
 {
 	CURLcode res;
 	private_curl_plugin_t *this;
+	int i;
 
 	INIT(this,
 		.public = {
@@ -170,7 +299,16 @@ plugin_t *curl_plugin_create()
 				.destroy = _destroy,
 			},
 		},
+		.pool = linked_list_create(),
+		.pool_size = lib->settings->get_int(lib->settings,
+								"%s.plugins.curl.pool", DEFAULT_POOL_SIZE,
+								lib->ns),
+		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
 	);
+	for (i = 0; i < CURL_LOCK_DATA_LAST; i++)
+	{
+		this->share_locks[i] = mutex_create(MUTEX_TYPE_DEFAULT);
+	}
 
 	res = curl_global_init(CURL_GLOBAL_SSL);
 	if (res != CURLE_OK)
@@ -193,5 +331,17 @@ plugin_t *curl_plugin_create()
 		return NULL;
 	}
 
+	this->share = curl_share_init();
+	if (this->share)
+	{
+		curl_share_setopt(this->share, CURLSHOPT_LOCKFUNC, share_lock);
+		curl_share_setopt(this->share, CURLSHOPT_UNLOCKFUNC, share_unlock);
+		curl_share_setopt(this->share, CURLSHOPT_USERDATA, this);
+		curl_share_setopt(this->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+		curl_share_setopt(this->share, CURLSHOPT_SHARE,
+						  CURL_LOCK_DATA_SSL_SESSION);
+	}
+	singleton = this;
+
 	return &this->public.plugin;
 }
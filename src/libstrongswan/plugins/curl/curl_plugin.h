@@ -26,6 +26,8 @@
 
 #include <plugins/plugin.h>
 
+#include <curl/curl.h>
+
 typedef struct curl_plugin_t curl_plugin_t;
 
 /**
@@ -39,4 +41,24 @@ struct curl_plugin_t {
 	plugin_t plugin;
 };
 
+/**
+ * Lease an easy handle from the plugin's handle pool.
+ *
+ * Pooled handles keep their persistent connections and are bound to a share
+ * handle with common DNS and SSL session caches, so repeated fetches to the
+ * same origin skip connection setup.
+ *
+ * @return			easy handle, NULL on failure
+ */
+CURL *curl_plugin_create_handle();
+
+/**
+ * Return a leased easy handle to the pool.
+ *
+ * The handle's options get reset, live connections are kept.
+ *
+ * @param handle	handle to return
+ */
+void curl_plugin_release_handle(CURL *handle);
+
 #endif /** CURL_PLUGIN_H_ @}*/
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Hochschule fuer Technik Rapperswil
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include "drbg_plugin.h"
+#include "drbg_rng.h"
+
+#include <library.h>
+
+typedef struct private_drbg_plugin_t private_drbg_plugin_t;
+
+/**
+ * private data of drbg_plugin
+ */
+struct private_drbg_plugin_t {
+
+	/**
+	 * public functions
+	 */
+	drbg_plugin_t public;
+};
+
+METHOD(plugin_t, get_name, char*,
+	private_drbg_plugin_t *this)
+{
+	return "drbg";
+}
+
+METHOD(plugin_t, get_features, int,
+	private_drbg_plugin_t *this, plugin_feature_t *features[])
+{
+	static plugin_feature_t f[] = {
+		PLUGIN_REGISTER(RNG, drbg_rng_create),
+			PLUGIN_PROVIDE(RNG, RNG_WEAK),
+				PLUGIN_DEPENDS(RNG, RNG_TRUE),
+			PLUGIN_PROVIDE(RNG, RNG_STRONG),
+				PLUGIN_DEPENDS(RNG, RNG_TRUE),
+	};
+	*features = f;
+	return countof(f);
+}
+
+METHOD(plugin_t, destroy, void,
+	private_drbg_plugin_t *this)
+{
+	drbg_rng_deinit();
+	free(this);
+}
+
+/*
+ * see header file
+ */
+plugin_t *drbg_plugin_create()
+{
+	private_drbg_plugin_t *this;
+
+	if (!drbg_rng_init())
+	{
+		return NULL;
+	}
+
+	INIT(this,
+		.public = {
+			.plugin = {
+				.get_name = _get_name,
+				.get_features = _get_features,
+				.reload = (void*)return_false,
+				.destroy = _destroy,
+			},
+		},
+	);
+
+	return &this->public.plugin;
+}
@@ -0,0 +1,317 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Hochschule fuer Technik Rapperswil
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include "drbg_rng.h"
+
+#include <utils/debug.h>
+#include <threading/thread_value.h>
+
+/**
+ * Number of 64-byte ChaCha20 blocks generated per refill
+ */
+#define DRBG_BLOCKS 16
+
+/**
+ * Bytes handed out per refill; the first 32 bytes become the next key
+ */
+#define DRBG_BUFFER_SIZE (DRBG_BLOCKS * 64 - 32)
+
+/**
+ * Number of refills after which the generator gets reseeded (~1 MiB output)
+ */
+#define DRBG_RESEED_REFILLS 1024
+
+typedef struct private_drbg_rng_t private_drbg_rng_t;
+typedef struct drbg_state_t drbg_state_t;
+
+/**
+ * Private data of a drbg_rng_t object.
+ */
+struct private_drbg_rng_t {
+
+	/**
+	 * Public drbg_rng_t interface.
+	 */
+	drbg_rng_t public;
+};
+
+/**
+ * Per-thread generator state, kept in thread local storage
+ */
+struct drbg_state_t {
+
+	/**
+	 * Current ChaCha20 key words
+	 */
+	u_int32_t key[8];
+
+	/**
+	 * Buffered output not yet handed out
+	 */
+	u_char buf[DRBG_BUFFER_SIZE];
+
+	/**
+	 * Read position in buf, buffer is depleted if == sizeof(buf)
+	 */
+	size_t pos;
+
+	/**
+	 * Number of refills since the last reseed
+	 */
+	u_int refills;
+
+	/**
+	 * TRUE once the state got seeded successfully
+	 */
+	bool seeded;
+};
+
+/**
+ * Thread specific generator states, as drbg_state_t
+ */
+static thread_value_t *states;
+
+/**
+ * ChaCha20 quarter round
+ */
+#define ROTL(v, n) ((v) << (n) | (v) >> (32 - (n)))
+#define QR(a, b, c, d) do { \
+	a += b; d ^= a; d = ROTL(d, 16); \
+	c += d; b ^= c; b = ROTL(b, 12); \
+	a += b; d ^= a; d = ROTL(d, 8); \
+	c += d; b ^= c; b = ROTL(b, 7); \
+} while (0)
+
+/**
+ * Generate a single ChaCha20 block for a key and block counter, zero nonce
+ */
+static void chacha_block(u_int32_t key[8], u_int64_t counter, u_char out[64])
+{
+	u_int32_t state[16], x[16];
+	int i;
+
+	state[0] = 0x61707865;
+	state[1] = 0x3320646e;
+	state[2] = 0x79622d32;
+	state[3] = 0x6b206574;
+	for (i = 0; i < 8; i++)
+	{
+		state[4 + i] = key[i];
+	}
+	state[12] = counter;
+	state[13] = counter >> 32;
+	state[14] = 0;
+	state[15] = 0;
+
+	memcpy(x, state, sizeof(x));
+	for (i = 0; i < 10; i++)
+	{
+		QR(x[0], x[4], x[ 8], x[12]);
+		QR(x[1], x[5], x[ 9], x[13]);
+		QR(x[2], x[6], x[10], x[14]);
+		QR(x[3], x[7], x[11], x[15]);
+		QR(x[0], x[5], x[10], x[15]);
+		QR(x[1], x[6], x[11], x[12]);
+		QR(x[2], x[7], x[ 8], x[13]);
+		QR(x[3], x[4], x[ 9], x[14]);
+	}
+	for (i = 0; i < 16; i++)
+	{
+		x[i] += state[i];
+		out[i * 4 + 0] = x[i];
+		out[i * 4 + 1] = x[i] >> 8;
+		out[i * 4 + 2] = x[i] >> 16;
+		out[i * 4 + 3] = x[i] >> 24;
+	}
+	memwipe(x, sizeof(x));
+	memwipe(state, sizeof(state));
+}
+
+/**
+ * Seed the generator key from a true quality RNG
+ */
+static bool reseed(drbg_state_t *state)
+{
+	rng_t *entropy;
+
+	entropy = lib->crypto->create_rng(lib->crypto, RNG_TRUE);
+	if (!entropy)
+	{
+		DBG1(DBG_LIB, "no true RNG found to seed DRBG");
+		return FALSE;
+	}
+	if (!entropy->get_bytes(entropy, sizeof(state->key),
+							(u_int8_t*)state->key))
+	{
+		entropy->destroy(entropy);
+		return FALSE;
+	}
+	entropy->destroy(entropy);
+	state->refills = 0;
+	state->seeded = TRUE;
+	return TRUE;
+}
+
+/**
+ * Refill the output buffer, replacing the key by the first generated bytes
+ * so backtracking to previously handed out output is not possible
+ */
+static bool refill(drbg_state_t *state)
+{
+	u_char out[DRBG_BLOCKS * 64];
+	u_int64_t counter;
+
+	if (!state->seeded || state->refills >= DRBG_RESEED_REFILLS)
+	{
+		if (!reseed(state))
+		{
+			return FALSE;
+		}
+	}
+	for (counter = 0; counter < DRBG_BLOCKS; counter++)
+	{
+		chacha_block(state->key, counter, out + counter * 64);
+	}
+	memcpy(state->key, out, sizeof(state->key));
+	memcpy(state->buf, out + sizeof(state->key), sizeof(state->buf));
+	memwipe(out, sizeof(out));
+	state->pos = 0;
+	state->refills++;
+	return TRUE;
+}
+
+/**
+ * Get or lazily create the generator state of the calling thread
+ */
+static drbg_state_t *get_state()
+{
+	drbg_state_t *state;
+
+	state = states->get(states);
+	if (!state)
+	{
+		INIT(state,
+			.pos = DRBG_BUFFER_SIZE,
+		);
+		states->set(states, state);
+	}
+	return state;
+}
+
+METHOD(rng_t, get_bytes, bool,
+	private_drbg_rng_t *this, size_t bytes, u_int8_t *buffer)
+{
+	drbg_state_t *state;
+	size_t len;
+
+	state = get_state();
+	while (bytes)
+	{
+		if (state->pos == sizeof(state->buf))
+		{
+			if (!refill(state))
+			{
+				return FALSE;
+			}
+		}
+		len = min(bytes, sizeof(state->buf) - state->pos);
+		memcpy(buffer, state->buf + state->pos, len);
+		memwipe(state->buf + state->pos, len);
+		state->pos += len;
+		buffer += len;
+		bytes -= len;
+	}
+	return TRUE;
+}
+
+METHOD(rng_t, allocate_bytes, bool,
+	private_drbg_rng_t *this, size_t bytes, chunk_t *chunk)
+{
+	*chunk = chunk_alloc(bytes);
+	if (!get_bytes(this, chunk->len, chunk->ptr))
+	{
+		chunk_clear(chunk);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+METHOD(rng_t, destroy, void,
+	private_drbg_rng_t *this)
+{
+	free(this);
+}
+
+/*
+ * Described in header.
+ */
+drbg_rng_t *drbg_rng_create(rng_quality_t quality)
+{
+	private_drbg_rng_t *this;
+
+	if (quality > RNG_STRONG)
+	{	/* this is a PRG, true randomness comes from the seeder only */
+		return NULL;
+	}
+
+	INIT(this,
+		.public = {
+			.rng = {
+				.get_bytes = _get_bytes,
+				.allocate_bytes = _allocate_bytes,
+				.destroy = _destroy,
+			},
+		},
+	);
+
+	return &this->public;
+}
+
+/**
+ * Wipe and free the generator state of a terminated thread
+ */
+static void destroy_state(drbg_state_t *state)
+{
+	memwipe(state, sizeof(*state));
+	free(state);
+}
+
+/*
+ * Described in header.
+ */
+bool drbg_rng_init()
+{
+	states = thread_value_create((thread_cleanup_t)destroy_state);
+	return TRUE;
+}
+
+/*
+ * Described in header.
+ */
+void drbg_rng_deinit()
+{
+	drbg_state_t *state;
+
+	/* clean up the state of the unloading thread; states of other threads
+	 * are released by their thread cleanup handler */
+	state = states->get(states);
+	if (state)
+	{
+		destroy_state(state);
+		states->set(states, NULL);
+	}
+	states->destroy(states);
+	states = NULL;
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Hochschule fuer Technik Rapperswil
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/**
+ * @defgroup drbg_rng drbg_rng
+ * @{ @ingroup drbg_p
+ */
+
+#ifndef DRBG_RNG_H_
+#define DRBG_RNG_H_
+
+typedef struct drbg_rng_t drbg_rng_t;
+
+#include <library.h>
+
+/**
+ * rng_t implementation using a per-thread buffered ChaCha20 DRBG.
+ *
+ * Each thread keeps its own generator state, seeded and periodically
+ * reseeded from a true quality RNG, so bulk nonce/IV generation does not
+ * issue a syscall per request.
+ */
+struct drbg_rng_t {
+
+	/**
+	 * Implements rng_t.
+	 */
+	rng_t rng;
+};
+
+/**
+ * Creates a drbg_rng_t instance.
+ *
+ * @param quality	required quality of randomness
+ * @return			created drbg_rng_t
+ */
+drbg_rng_t *drbg_rng_create(rng_quality_t quality);
+
+/**
+ * Initialize the per-thread generator states, called on plugin load.
+ *
+ * @return			FALSE on failure
+ */
+bool drbg_rng_init();
+
+/**
+ * Release the per-thread generator states, called on plugin unload.
+ */
+void drbg_rng_deinit();
+
+#endif /** DRBG_RNG_H_ @} */
@@ -421,6 +421,8 @@ gcm_aead_t *gcm_aead_create(encryption_algorithm_t algo,
 			.aead = {
 				.encrypt = _encrypt,
 				.decrypt = _decrypt,
+				.encrypt_batch = aead_encrypt_batch_generic,
+				.decrypt_batch = aead_decrypt_batch_generic,
 				.get_block_size = _get_block_size,
 				.get_icv_size = _get_icv_size,
 				.get_iv_size = _get_iv_size,
@@ -27,6 +27,7 @@
 #include <asn1/oid.h>
 #include <asn1/asn1.h>
 #include <asn1/asn1_parser.h>
+#include <threading/thread.h>
 
 #ifdef HAVE_MPZ_POWM_SEC
 # undef mpz_powm
@@ -217,6 +218,29 @@ static status_t compute_prime(size_t prime_size, bool safe, mpz_t *p, mpz_t *q)
 	return SUCCESS;
 }
 
+/**
+ * Parameters and result of a prime computation running in its own thread
+ */
+typedef struct {
+	/** size of the prime to compute */
+	size_t prime_size;
+	/** TRUE to compute a safe prime */
+	bool safe;
+	/** computed prime and prime-1, initialized on SUCCESS only */
+	mpz_t p, p1;
+	/** result of the computation */
+	status_t status;
+} prime_job_t;
+
+/**
+ * Thread computing the second prime concurrently to the first
+ */
+static void *compute_prime_async(prime_job_t *job)
+{
+	job->status = compute_prime(job->prime_size, job->safe, &job->p, &job->p1);
+	return NULL;
+}
+
 /**
  * PKCS#1 RSADP function
  */
@@ -687,16 +711,49 @@ gmp_rsa_private_key_t *gmp_rsa_private_key_gen(key_type_t type, va_list args)
 	}
 	key_size = key_size / BITS_PER_BYTE;
 
-	/* Get values of primes p and q  */
-	if (compute_prime(key_size/2, safe_prime, &p, &p1) != SUCCESS)
-	{
-		return NULL;
-	}
-	if (compute_prime(key_size/2, safe_prime, &q, &q1) != SUCCESS)
+	/* Get values of primes p and q, computing the second one in a concurrent
+	 * thread to use a second core for the prime search */
 	{
-		mpz_clear(p);
-		mpz_clear(p1);
-		return NULL;
+		prime_job_t job = {
+			.prime_size = key_size/2,
+			.safe = safe_prime,
+			.status = FAILED,
+		};
+		thread_t *thread;
+		status_t status;
+
+		thread = thread_create((thread_main_t)compute_prime_async, &job);
+		status = compute_prime(key_size/2, safe_prime, &p, &p1);
+		if (thread)
+		{
+			thread->join(thread);
+		}
+		if (status != SUCCESS)
+		{
+			if (thread && job.status == SUCCESS)
+			{
+				mpz_clear(job.p);
+				mpz_clear(job.p1);
+			}
+			return NULL;
+		}
+		if (thread)
+		{
+			if (job.status != SUCCESS)
+			{
+				mpz_clear(p);
+				mpz_clear(p1);
+				return NULL;
+			}
+			*q = *job.p;
+			*q1 = *job.p1;
+		}
+		else if (compute_prime(key_size/2, safe_prime, &q, &q1) != SUCCESS)
+		{	/* thread creation failed, fall back to sequential computation */
+			mpz_clear(p);
+			mpz_clear(p1);
+			return NULL;
+		}
 	}
 
 	/* Swapping Primes so p is larger then q */
@@ -25,6 +25,7 @@
 #include <threading/thread_value.h>
 #include <threading/mutex.h>
 #include <collections/linked_list.h>
+#include <processing/jobs/callback_job.h>
 
 /* Older mysql.h headers do not define it, but we need it. It is not returned
  * in in MySQL 4 by default, but by MySQL 5. To avoid this problem, we catch
@@ -84,6 +85,16 @@ struct private_mysql_database_t {
 	 * tcp port
 	 */
 	int port;
+
+	/**
+	 * statements queued for asynchronous execution, as async_stmt_t
+	 */
+	linked_list_t *queue;
+
+	/**
+	 * TRUE if a worker job is draining the queue
+	 */
+	bool job_scheduled;
 };
 
 typedef struct conn_t conn_t;
@@ -198,7 +209,8 @@ static void conn_destroy(conn_t *this)
 /**
  * Acquire/Reuse a mysql connection
  */
-static conn_t *conn_get(private_mysql_database_t *this, transaction_t **trans)
+static conn_t *conn_get(private_mysql_database_t *this, transaction_t **trans,
+						bool use_trans)
 {
 	conn_t *current, *found = NULL;
 	enumerator_t *enumerator;
@@ -206,14 +218,17 @@ static conn_t *conn_get(private_mysql_database_t *this, transaction_t **trans)
 
 	thread_initialize();
 
-	transaction = this->transaction->get(this->transaction);
-	if (transaction)
+	if (use_trans)
 	{
-		if (trans)
+		transaction = this->transaction->get(this->transaction);
+		if (transaction)
 		{
-			*trans = transaction;
+			if (trans)
+			{
+				*trans = transaction;
+			}
+			return transaction->conn;
 		}
-		return transaction->conn;
 	}
 
 	while (TRUE)
@@ -381,6 +396,185 @@ static MYSQL_STMT* run(MYSQL *mysql, char *sql, va_list *args)
 	return stmt;
 }
 
+/**
+ * Statement queued for asynchronous execution, prepared and bound
+ */
+typedef struct {
+	/** prepared statement with parameters bound */
+	MYSQL_STMT *stmt;
+	/** connection the statement was prepared on, checked out */
+	conn_t *conn;
+	/** heap copies of the bound parameter values */
+	MYSQL_BIND *bind;
+	/** number of bound parameters */
+	int params;
+} async_stmt_t;
+
+/**
+ * Clean up a queued statement, releasing its connection
+ */
+static void async_stmt_destroy(private_mysql_database_t *this,
+							   async_stmt_t *async)
+{
+	int i;
+
+	for (i = 0; i < async->params; i++)
+	{
+		free(async->bind[i].buffer);
+	}
+	free(async->bind);
+	mysql_stmt_close(async->stmt);
+	conn_release(this, async->conn);
+	free(async);
+}
+
+/**
+ * Prepare a statement for deferred execution, copying all bound values
+ */
+static async_stmt_t *prepare_async(private_mysql_database_t *this,
+								   conn_t *conn, char *sql, va_list *args)
+{
+	async_stmt_t *async;
+	MYSQL_STMT *stmt;
+	chunk_t chunk;
+	char *text;
+	int i;
+
+	stmt = mysql_stmt_init(conn->mysql);
+	if (stmt == NULL)
+	{
+		DBG1(DBG_LIB, "creating MySQL statement failed: %s",
+			 mysql_error(conn->mysql));
+		return NULL;
+	}
+	if (mysql_stmt_prepare(stmt, sql, strlen(sql)))
+	{
+		DBG1(DBG_LIB, "preparing MySQL statement failed: %s",
+			 mysql_stmt_error(stmt));
+		mysql_stmt_close(stmt);
+		return NULL;
+	}
+	INIT(async,
+		.stmt = stmt,
+		.conn = conn,
+		.params = mysql_stmt_param_count(stmt),
+	);
+	async->bind = calloc(max(async->params, 1), sizeof(MYSQL_BIND));
+	for (i = 0; i < async->params; i++)
+	{
+		switch (va_arg(*args, db_type_t))
+		{
+			case DB_INT:
+			{
+				async->bind[i].buffer_type = MYSQL_TYPE_LONG;
+				async->bind[i].buffer = malloc(sizeof(int));
+				*(int*)async->bind[i].buffer = va_arg(*args, int);
+				async->bind[i].buffer_length = sizeof(int);
+				break;
+			}
+			case DB_UINT:
+			{
+				async->bind[i].buffer_type = MYSQL_TYPE_LONG;
+				async->bind[i].buffer = malloc(sizeof(u_int));
+				*(u_int*)async->bind[i].buffer = va_arg(*args, u_int);
+				async->bind[i].buffer_length = sizeof(u_int);
+				async->bind[i].is_unsigned = TRUE;
+				break;
+			}
+			case DB_TEXT:
+			{
+				async->bind[i].buffer_type = MYSQL_TYPE_STRING;
+				text = va_arg(*args, char*);
+				if (text)
+				{
+					async->bind[i].buffer = strdup(text);
+					async->bind[i].buffer_length = strlen(text);
+				}
+				break;
+			}
+			case DB_BLOB:
+			{
+				chunk = va_arg(*args, chunk_t);
+				async->bind[i].buffer_type = MYSQL_TYPE_BLOB;
+				async->bind[i].buffer = chunk_clone(chunk).ptr;
+				async->bind[i].buffer_length = chunk.len;
+				break;
+			}
+			case DB_DOUBLE:
+			{
+				async->bind[i].buffer_type = MYSQL_TYPE_DOUBLE;
+				async->bind[i].buffer = malloc(sizeof(double));
+				*(double*)async->bind[i].buffer = va_arg(*args, double);
+				async->bind[i].buffer_length = sizeof(double);
+				break;
+			}
+			case DB_NULL:
+			{
+				async->bind[i].buffer_type = MYSQL_TYPE_NULL;
+				break;
+			}
+			default:
+			{
+				DBG1(DBG_LIB, "invalid data type supplied");
+				async->params = i;
+				async->conn = NULL;
+				for (i = 0; i < async->params; i++)
+				{
+					free(async->bind[i].buffer);
+				}
+				free(async->bind);
+				mysql_stmt_close(stmt);
+				free(async);
+				return NULL;
+			}
+		}
+	}
+	if (async->params > 0 && mysql_stmt_bind_param(stmt, async->bind))
+	{
+		DBG1(DBG_LIB, "binding MySQL param failed: %s",
+			 mysql_stmt_error(stmt));
+		async->conn = NULL;
+		for (i = 0; i < async->params; i++)
+		{
+			free(async->bind[i].buffer);
+		}
+		free(async->bind);
+		mysql_stmt_close(stmt);
+		free(async);
+		return NULL;
+	}
+	return async;
+}
+
+/**
+ * Worker job draining queued asynchronous statements
+ */
+static job_requeue_t execute_async_job(private_mysql_database_t *this)
+{
+	async_stmt_t *async;
+
+	thread_initialize();
+	while (TRUE)
+	{
+		this->mutex->lock(this->mutex);
+		if (this->queue->remove_first(this->queue, (void**)&async) != SUCCESS)
+		{
+			this->job_scheduled = FALSE;
+			this->mutex->unlock(this->mutex);
+			break;
+		}
+		this->mutex->unlock(this->mutex);
+
+		if (mysql_stmt_execute(async->stmt))
+		{
+			DBG1(DBG_LIB, "async MySQL execute failed: %s",
+				 mysql_stmt_error(async->stmt));
+		}
+		async_stmt_destroy(this, async);
+	}
+	return JOB_REQUEUE_NONE;
+}
+
 typedef struct {
 	/** implements enumerator_t */
 	enumerator_t public;
@@ -538,7 +732,7 @@ METHOD(database_t, query, enumerator_t*,
 	mysql_enumerator_t *enumerator = NULL;
 	conn_t *conn;
 
-	conn = conn_get(this, NULL);
+	conn = conn_get(this, NULL, TRUE);
 	if (!conn)
 	{
 		return NULL;
@@ -630,7 +824,7 @@ METHOD(database_t, execute, int,
 	conn_t *conn;
 	int affected = -1;
 
-	conn = conn_get(this, NULL);
+	conn = conn_get(this, NULL, TRUE);
 	if (!conn)
 	{
 		return -1;
@@ -651,13 +845,48 @@ METHOD(database_t, execute, int,
 	return affected;
 }
 
+METHOD(database_t, execute_async, bool,
+	private_mysql_database_t *this, char *sql, ...)
+{
+	async_stmt_t *async;
+	va_list args;
+	conn_t *conn;
+
+	/* use a dedicated pooled connection, as the statement outlives the call
+	 * and may not share a connection a transaction runs on */
+	conn = conn_get(this, NULL, FALSE);
+	if (!conn)
+	{
+		return FALSE;
+	}
+	va_start(args, sql);
+	async = prepare_async(this, conn, sql, &args);
+	va_end(args);
+	if (!async)
+	{
+		conn_release(this, conn);
+		return FALSE;
+	}
+	this->mutex->lock(this->mutex);
+	this->queue->insert_last(this->queue, async);
+	if (!this->job_scheduled)
+	{
+		this->job_scheduled = TRUE;
+		lib->processor->queue_job(lib->processor, (job_t*)
+				callback_job_create((callback_job_cb_t)execute_async_job, this,
+									NULL, (callback_job_cancel_t)return_false));
+	}
+	this->mutex->unlock(this->mutex);
+	return TRUE;
+}
+
 METHOD(database_t, transaction, bool,
 	private_mysql_database_t *this, bool serializable)
 {
 	transaction_t *trans = NULL;
 	conn_t *conn;
 
-	conn = conn_get(this, &trans);
+	conn = conn_get(this, &trans, TRUE);
 	if (!conn)
 	{
 		return FALSE;
@@ -751,6 +980,19 @@ METHOD(database_t, get_driver,db_driver_t,
 METHOD(database_t, destroy, void,
 	private_mysql_database_t *this)
 {
+	async_stmt_t *async;
+
+	/* flush statements still queued for asynchronous execution */
+	while (this->queue->remove_first(this->queue, (void**)&async) == SUCCESS)
+	{
+		if (mysql_stmt_execute(async->stmt))
+		{
+			DBG1(DBG_LIB, "async MySQL execute failed: %s",
+				 mysql_stmt_error(async->stmt));
+		}
+		async_stmt_destroy(this, async);
+	}
+	this->queue->destroy(this->queue);
 	this->transaction->destroy(this->transaction);
 	this->pool->destroy_function(this->pool, (void*)conn_destroy);
 	this->mutex->destroy(this->mutex);
@@ -829,6 +1071,7 @@ mysql_database_t *mysql_database_create(char *uri)
 			.db = {
 				.query = _query,
 				.execute = _execute,
+				.execute_async = _execute_async,
 				.transaction = _transaction,
 				.commit = _commit_,
 				.rollback = _rollback,
@@ -845,10 +1088,11 @@ mysql_database_t *mysql_database_create(char *uri)
 	}
 	this->mutex = mutex_create(MUTEX_TYPE_DEFAULT);
 	this->pool = linked_list_create();
+	this->queue = linked_list_create();
 	this->transaction = thread_value_create(NULL);
 
 	/* check connectivity */
-	conn = conn_get(this, NULL);
+	conn = conn_get(this, NULL, TRUE);
 	if (!conn)
 	{
 		destroy(this);
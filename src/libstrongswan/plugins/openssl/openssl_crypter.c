@@ -38,6 +38,11 @@ struct private_openssl_crypter_t {
 	 * the cipher to use
 	 */
 	const EVP_CIPHER *cipher;
+
+	/*
+	 * reused cipher context, instances are not used concurrently
+	 */
+	EVP_CIPHER_CTX ctx;
 };
 
 /**
@@ -102,16 +107,16 @@ static bool crypt(private_openssl_crypter_t *this, chunk_t data, chunk_t iv,
 		*dst = chunk_alloc(data.len);
 		out = dst->ptr;
 	}
-	EVP_CIPHER_CTX ctx;
-	EVP_CIPHER_CTX_init(&ctx);
-	return EVP_CipherInit_ex(&ctx, this->cipher, NULL, NULL, NULL, enc) &&
-		   EVP_CIPHER_CTX_set_padding(&ctx, 0) /* disable padding */ &&
-		   EVP_CIPHER_CTX_set_key_length(&ctx, this->key.len) &&
-		   EVP_CipherInit_ex(&ctx, NULL, NULL, this->key.ptr, iv.ptr, enc) &&
-		   EVP_CipherUpdate(&ctx, out, &len, data.ptr, data.len) &&
+	/* reusing the context lets EVP_CipherInit_ex() keep the cipher data
+	 * allocation, as the cipher never changes for an instance */
+	return EVP_CipherInit_ex(&this->ctx, this->cipher, NULL, NULL, NULL, enc) &&
+		   EVP_CIPHER_CTX_set_padding(&this->ctx, 0) /* disable padding */ &&
+		   EVP_CIPHER_CTX_set_key_length(&this->ctx, this->key.len) &&
+		   EVP_CipherInit_ex(&this->ctx, NULL, NULL, this->key.ptr, iv.ptr,
+							 enc) &&
+		   EVP_CipherUpdate(&this->ctx, out, &len, data.ptr, data.len) &&
 		   /* since padding is disabled this does nothing */
-		   EVP_CipherFinal_ex(&ctx, out + len, &len) &&
-		   EVP_CIPHER_CTX_cleanup(&ctx);
+		   EVP_CipherFinal_ex(&this->ctx, out + len, &len);
 }
 
 METHOD(crypter_t, decrypt, bool,
@@ -154,6 +159,7 @@ METHOD(crypter_t, set_key, bool,
 METHOD(crypter_t, destroy, void,
 	private_openssl_crypter_t *this)
 {
+	EVP_CIPHER_CTX_cleanup(&this->ctx);
 	chunk_clear(&this->key);
 	free(this);
 }
@@ -253,6 +259,7 @@ openssl_crypter_t *openssl_crypter_create(encryption_algorithm_t algo,
 		return NULL;
 	}
 
+	EVP_CIPHER_CTX_init(&this->ctx);
 	this->key = chunk_alloc(key_size);
 
 	return &this->public;
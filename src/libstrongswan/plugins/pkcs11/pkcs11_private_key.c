@@ -24,6 +24,8 @@
 
 #include <utils/debug.h>
 #include <asn1/asn1.h>
+#include <collections/linked_list.h>
+#include <threading/mutex.h>
 
 typedef struct private_pkcs11_private_key_t private_pkcs11_private_key_t;
 
@@ -72,6 +74,21 @@ struct private_pkcs11_private_key_t {
 	 */
 	public_key_t *pubkey;
 
+	/**
+	 * Pool of idle sessions for private key operations
+	 */
+	linked_list_t *sessions;
+
+	/**
+	 * Mutex protecting the session pool
+	 */
+	mutex_t *mutex;
+
+	/**
+	 * Maximum number of idle sessions to keep in the pool
+	 */
+	int pool_size;
+
 	/**
 	 * References to this key
 	 */
@@ -221,6 +238,61 @@ static bool reauth(private_pkcs11_private_key_t *this,
 	return success;
 }
 
+/**
+ * Get a session for a private key operation, using a pooled one if available
+ */
+static bool get_op_session(private_pkcs11_private_key_t *this,
+						   CK_SESSION_HANDLE *session)
+{
+	CK_SESSION_HANDLE *handle;
+	CK_RV rv;
+
+	this->mutex->lock(this->mutex);
+	if (this->sessions->remove_first(this->sessions,
+									 (void**)&handle) == SUCCESS)
+	{
+		this->mutex->unlock(this->mutex);
+		*session = *handle;
+		free(handle);
+		return TRUE;
+	}
+	this->mutex->unlock(this->mutex);
+	rv = this->lib->f->C_OpenSession(this->slot, CKF_SERIAL_SESSION, NULL, NULL,
+									 session);
+	if (rv != CKR_OK)
+	{
+		DBG1(DBG_CFG, "opening PKCS#11 session failed: %N", ck_rv_names, rv);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * Return a session after a private key operation. Only sessions that
+ * completed their operation successfully go back to the pool, others might
+ * have an operation still active and are closed instead.
+ */
+static void put_op_session(private_pkcs11_private_key_t *this,
+						   CK_SESSION_HANDLE session, bool completed)
+{
+	CK_SESSION_HANDLE *handle;
+
+	if (completed)
+	{
+		this->mutex->lock(this->mutex);
+		if (this->sessions->get_count(this->sessions) < this->pool_size)
+		{
+			handle = malloc_thing(CK_SESSION_HANDLE);
+			*handle = session;
+			this->sessions->insert_last(this->sessions, handle);
+			this->mutex->unlock(this->mutex);
+			return;
+		}
+		this->mutex->unlock(this->mutex);
+	}
+	this->lib->f->C_CloseSession(session);
+}
+
 METHOD(private_key_t, sign, bool,
 	private_pkcs11_private_key_t *this, signature_scheme_t scheme,
 	chunk_t data, chunk_t *signature)
@@ -241,22 +313,19 @@ METHOD(private_key_t, sign, bool,
 			 signature_scheme_names, scheme);
 		return FALSE;
 	}
-	rv = this->lib->f->C_OpenSession(this->slot, CKF_SERIAL_SESSION, NULL, NULL,
-									 &session);
-	if (rv != CKR_OK)
+	if (!get_op_session(this, &session))
 	{
-		DBG1(DBG_CFG, "opening PKCS#11 session failed: %N", ck_rv_names, rv);
 		return FALSE;
 	}
 	rv = this->lib->f->C_SignInit(session, mechanism, this->object);
 	if (this->reauth && !reauth(this, session))
 	{
-		this->lib->f->C_CloseSession(session);
+		put_op_session(this, session, FALSE);
 		return FALSE;
 	}
 	if (rv != CKR_OK)
 	{
-		this->lib->f->C_CloseSession(session);
+		put_op_session(this, session, FALSE);
 		DBG1(DBG_LIB, "C_SignInit() failed: %N", ck_rv_names, rv);
 		return FALSE;
 	}
@@ -268,7 +337,7 @@ METHOD(private_key_t, sign, bool,
 		if (!hasher || !hasher->allocate_hash(hasher, data, &hash))
 		{
 			DESTROY_IF(hasher);
-			this->lib->f->C_CloseSession(session);
+			put_op_session(this, session, FALSE);
 			return FALSE;
 		}
 		hasher->destroy(hasher);
@@ -281,7 +350,7 @@ METHOD(private_key_t, sign, bool,
 	}
 	buf = malloc(len);
 	rv = this->lib->f->C_Sign(session, data.ptr, data.len, buf, &len);
-	this->lib->f->C_CloseSession(session);
+	put_op_session(this, session, rv == CKR_OK);
 	chunk_free(&hash);
 	if (rv != CKR_OK)
 	{
@@ -326,29 +395,26 @@ METHOD(private_key_t, decrypt, bool,
 			 encryption_scheme_names, scheme);
 		return FALSE;
 	}
-	rv = this->lib->f->C_OpenSession(this->slot, CKF_SERIAL_SESSION, NULL, NULL,
-									 &session);
-	if (rv != CKR_OK)
+	if (!get_op_session(this, &session))
 	{
-		DBG1(DBG_CFG, "opening PKCS#11 session failed: %N", ck_rv_names, rv);
 		return FALSE;
 	}
 	rv = this->lib->f->C_DecryptInit(session, mechanism, this->object);
 	if (this->reauth && !reauth(this, session))
 	{
-		this->lib->f->C_CloseSession(session);
+		put_op_session(this, session, FALSE);
 		return FALSE;
 	}
 	if (rv != CKR_OK)
 	{
-		this->lib->f->C_CloseSession(session);
+		put_op_session(this, session, FALSE);
 		DBG1(DBG_LIB, "C_DecryptInit() failed: %N", ck_rv_names, rv);
 		return FALSE;
 	}
 	len = (get_keysize(this) + 7) / 8;
 	buf = malloc(len);
 	rv = this->lib->f->C_Decrypt(session, crypt.ptr, crypt.len, buf, &len);
-	this->lib->f->C_CloseSession(session);
+	put_op_session(this, session, rv == CKR_OK);
 	if (rv != CKR_OK)
 	{
 		DBG1(DBG_LIB, "C_Decrypt() failed: %N", ck_rv_names, rv);
@@ -389,6 +455,8 @@ METHOD(private_key_t, get_ref, private_key_t*,
 METHOD(private_key_t, destroy, void,
 	private_pkcs11_private_key_t *this)
 {
+	CK_SESSION_HANDLE *handle;
+
 	if (ref_put(&this->ref))
 	{
 		if (this->pubkey)
@@ -396,6 +464,14 @@ METHOD(private_key_t, destroy, void,
 			this->pubkey->destroy(this->pubkey);
 		}
 		this->keyid->destroy(this->keyid);
+		while (this->sessions->remove_first(this->sessions,
+											(void**)&handle) == SUCCESS)
+		{
+			this->lib->f->C_CloseSession(*handle);
+			free(handle);
+		}
+		this->sessions->destroy(this->sessions);
+		this->mutex->destroy(this->mutex);
 		this->lib->f->C_CloseSession(this->session);
 		free(this);
 	}
@@ -725,6 +801,10 @@ pkcs11_private_key_t *pkcs11_private_key_connect(key_type_t type, va_list args)
 
 	this->slot = slot;
 	this->keyid = identification_create_from_encoding(ID_KEY_ID, keyid);
+	this->sessions = linked_list_create();
+	this->mutex = mutex_create(MUTEX_TYPE_DEFAULT);
+	this->pool_size = lib->settings->get_int(lib->settings,
+						"%s.plugins.pkcs11.session_pool_size", 0, lib->ns);
 
 	if (!login(this, slot))
 	{
@@ -19,6 +19,7 @@
 #include <asn1/oid.h>
 #include <asn1/asn1.h>
 #include <asn1/asn1_parser.h>
+#include <collections/array.h>
 #include <credentials/sets/mem_cred.h>
 
 typedef struct private_pkcs12_t private_pkcs12_t;
@@ -33,6 +34,11 @@ struct private_pkcs12_t {
 	 */
 	pkcs12_t public;
 
+	/**
+	 * Raw DER encoding of contained certificates, chunk_t
+	 */
+	array_t *certs;
+
 	/**
 	 * Contained credentials
 	 */
@@ -60,11 +66,70 @@ METHOD(container_t, get_encoding, bool,
 	return FALSE;
 }
 
+/**
+ * Certificate enumerator, decoding one certificate at a time
+ */
+typedef struct {
+	/** implements enumerator */
+	enumerator_t public;
+	/** currently decoded certificate */
+	certificate_t *cert;
+	/** raw encodings to enumerate, chunk_t */
+	array_t *certs;
+	/** current position in certs */
+	int i;
+} cert_enumerator_t;
+
+METHOD(enumerator_t, cert_enumerate, bool,
+	cert_enumerator_t *this, certificate_t **out)
+{
+	chunk_t encoding;
+
+	/* the previously enumerated certificate is gone unless it got a
+	 * reference, keeping the decoded set unbuffered */
+	DESTROY_IF(this->cert);
+	this->cert = NULL;
+	while (!this->cert && array_get(this->certs, this->i, &encoding))
+	{
+		this->i++;
+		DBG2(DBG_ASN, "-- > parsing certificate from PKCS#12");
+		this->cert = lib->creds->create(lib->creds, CRED_CERTIFICATE, CERT_X509,
+										BUILD_BLOB_ASN1_DER, encoding,
+										BUILD_END);
+		if (!this->cert)
+		{
+			DBG2(DBG_ASN, "-- < failed parsing certificate from PKCS#12");
+		}
+	}
+	if (this->cert)
+	{
+		DBG2(DBG_ASN, "-- < --");
+		*out = this->cert;
+		return TRUE;
+	}
+	return FALSE;
+}
+
+METHOD(enumerator_t, cert_enumerator_destroy, void,
+	cert_enumerator_t *this)
+{
+	DESTROY_IF(this->cert);
+	free(this);
+}
+
 METHOD(pkcs12_t, create_cert_enumerator, enumerator_t*,
 	private_pkcs12_t *this)
 {
-	return this->creds->set.create_cert_enumerator(&this->creds->set, CERT_ANY,
-												   KEY_ANY, NULL, FALSE);
+	cert_enumerator_t *enumerator;
+
+	INIT(enumerator,
+		.public = {
+			.enumerate = (void*)_cert_enumerate,
+			.destroy = _cert_enumerator_destroy,
+		},
+		.certs = this->certs,
+	);
+	return &enumerator->public;
 }
 
 METHOD(pkcs12_t, create_key_enumerator, enumerator_t*,
@@ -74,9 +139,19 @@ METHOD(pkcs12_t, create_key_enumerator, enumerator_t*,
 													  KEY_ANY, NULL);
 }
 
+/**
+ * Free the raw encoding of a contained certificate
+ */
+static void free_cert_encoding(chunk_t *encoding, int idx, void *unused)
+{
+	free(encoding->ptr);
+}
+
 METHOD(container_t, destroy, void,
 	private_pkcs12_t *this)
 {
+	array_destroy_function(this->certs, (array_callback_t)free_cert_encoding,
+						   NULL);
 	this->creds->destroy(this->creds);
 	free(this);
 }
@@ -141,23 +216,14 @@ static bool add_certificate(private_pkcs12_t *this, int level0, chunk_t blob)
 					asn1_parse_simple_object(&object, ASN1_OCTET_STRING,
 								parser->get_level(parser)+1, "x509Certificate"))
 				{
-					certificate_t *cert;
-
-					DBG2(DBG_ASN, "-- > parsing certificate from PKCS#12");
-					cert = lib->creds->create(lib->creds,
-											  CRED_CERTIFICATE, CERT_X509,
-											  BUILD_BLOB_ASN1_DER, object,
-											  BUILD_END);
-					if (cert)
-					{
-						this->creds->add_cert(this->creds, FALSE, cert);
-						DBG2(DBG_ASN, "-- < --");
-					}
-					else
-					{
-						DBG2(DBG_ASN, "-- < failed parsing certificate from "
-							 "PKCS#12");
-					}
+					chunk_t encoding;
+
+					/* object points into the decrypted SafeContents buffer,
+					 * which does not outlive decoding. Keep a copy of the raw
+					 * DER and decode the certificate on enumeration only */
+					encoding = chunk_clone(object);
+					array_insert_create_value(&this->certs, sizeof(chunk_t),
+											  ARRAY_TAIL, &encoding);
 				}
 				break;
 			}
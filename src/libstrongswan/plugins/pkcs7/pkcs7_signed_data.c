@@ -22,6 +22,7 @@
 #include <asn1/oid.h>
 #include <asn1/asn1.h>
 #include <asn1/asn1_parser.h>
+#include <collections/array.h>
 #include <credentials/sets/mem_cred.h>
 #include <credentials/certificates/x509.h>
 #include <credentials/keys/private_key.h>
@@ -53,6 +54,16 @@ struct private_pkcs7_signed_data_t {
 	 */
 	linked_list_t *signerinfos;
 
+	/**
+	 * Raw DER encoding of contained certificates, chunk_t
+	 */
+	array_t *certs;
+
+	/**
+	 * TRUE once contained certificates were decoded into creds
+	 */
+	bool certs_decoded;
+
 	/**
 	 * Contained certificates
 	 */
@@ -293,11 +304,41 @@ METHOD(enumerator_t, enumerator_destroy, void,
 	free(this);
 }
 
+/**
+ * Decode contained certificates into the credential set. Required to resolve
+ * the signer certificate during verification, done on first use only.
+ */
+static void decode_certs(private_pkcs7_signed_data_t *this)
+{
+	certificate_t *cert;
+	chunk_t encoding;
+	int i;
+
+	if (this->certs_decoded)
+	{
+		return;
+	}
+	for (i = 0; i < array_count(this->certs); i++)
+	{
+		array_get(this->certs, i, &encoding);
+		DBG2(DBG_LIB, "  parsing pkcs7-wrapped certificate");
+		cert = lib->creds->create(lib->creds, CRED_CERTIFICATE, CERT_X509,
+								  BUILD_BLOB_ASN1_DER, encoding, BUILD_END);
+		if (cert)
+		{
+			this->creds->add_cert(this->creds, FALSE, cert);
+		}
+	}
+	this->certs_decoded = TRUE;
+}
+
 METHOD(container_t, create_signature_enumerator, enumerator_t*,
 	private_pkcs7_signed_data_t *this)
 {
 	signature_enumerator_t *enumerator;
 
+	decode_certs(this);
+
 	INIT(enumerator,
 		.public = {
 			.enumerate = (void*)_enumerate,
@@ -330,11 +371,70 @@ METHOD(pkcs7_t, get_attribute, bool,
 	return FALSE;
 }
 
+/**
+ * Certificate enumerator, decoding one certificate at a time
+ */
+typedef struct {
+	/** implements enumerator */
+	enumerator_t public;
+	/** currently decoded certificate */
+	certificate_t *cert;
+	/** raw encodings to enumerate, chunk_t */
+	array_t *certs;
+	/** current position in certs */
+	int i;
+} cert_enumerator_t;
+
+METHOD(enumerator_t, cert_enumerate, bool,
+	cert_enumerator_t *this, certificate_t **out)
+{
+	chunk_t encoding;
+
+	/* the previously enumerated certificate is gone unless it got a
+	 * reference, keeping the decoded set unbuffered */
+	DESTROY_IF(this->cert);
+	this->cert = NULL;
+	while (!this->cert && array_get(this->certs, this->i, &encoding))
+	{
+		this->i++;
+		DBG2(DBG_LIB, "  parsing pkcs7-wrapped certificate");
+		this->cert = lib->creds->create(lib->creds, CRED_CERTIFICATE, CERT_X509,
+										BUILD_BLOB_ASN1_DER, encoding,
+										BUILD_END);
+	}
+	if (this->cert)
+	{
+		*out = this->cert;
+		return TRUE;
+	}
+	return FALSE;
+}
+
+METHOD(enumerator_t, cert_enumerator_destroy, void,
+	cert_enumerator_t *this)
+{
+	DESTROY_IF(this->cert);
+	free(this);
+}
+
 METHOD(pkcs7_t, create_cert_enumerator, enumerator_t*,
 	private_pkcs7_signed_data_t *this)
 {
-	return this->creds->set.create_cert_enumerator(&this->creds->set,
+	cert_enumerator_t *enumerator;
+
+	if (!array_count(this->certs))
+	{	/* generated containers keep their certificates in creds only */
+		return this->creds->set.create_cert_enumerator(&this->creds->set,
 											CERT_ANY, KEY_ANY, NULL, FALSE);
+	}
+	INIT(enumerator,
+		.public = {
+			.enumerate = (void*)_cert_enumerate,
+			.destroy = _cert_enumerator_destroy,
+		},
+		.certs = this->certs,
+	);
+	return &enumerator->public;
 }
 
 METHOD(container_t, get_data, bool,
@@ -354,9 +454,19 @@ METHOD(container_t, get_encoding, bool,
 	return TRUE;
 }
 
+/**
+ * Free the raw encoding of a contained certificate
+ */
+static void free_cert_encoding(chunk_t *encoding, int idx, void *unused)
+{
+	free(encoding->ptr);
+}
+
 METHOD(container_t, destroy, void,
 	private_pkcs7_signed_data_t *this)
 {
+	array_destroy_function(this->certs, (array_callback_t)free_cert_encoding,
+						   NULL);
 	this->creds->destroy(this->creds);
 	this->signerinfos->destroy_function(this->signerinfos,
 										(void*)signerinfo_destroy);
@@ -421,17 +531,13 @@ static bool parse(private_pkcs7_signed_data_t *this, chunk_t content)
 				break;
 			case PKCS7_CERT:
 			{
-				certificate_t *cert;
-
-				DBG2(DBG_LIB, "  parsing pkcs7-wrapped certificate");
-				cert = lib->creds->create(lib->creds,
-										  CRED_CERTIFICATE, CERT_X509,
-										  BUILD_BLOB_ASN1_DER, object,
-										  BUILD_END);
-				if (cert)
-				{
-					this->creds->add_cert(this->creds, FALSE, cert);
-				}
+				chunk_t encoding;
+
+				/* decoded on demand when enumerated or needed to verify
+				 * a signature, avoiding a buffered certificate set */
+				encoding = chunk_clone(object);
+				array_insert_create_value(&this->certs, sizeof(chunk_t),
+										  ARRAY_TAIL, &encoding);
 				break;
 			}
 			case PKCS7_SIGNER_INFO:
@@ -33,6 +33,7 @@
 #include <collections/array.h>
 #include <collections/linked_list.h>
 #include <plugins/plugin.h>
+#include <threading/thread.h>
 #include <utils/integrity_checker.h>
 
 typedef struct private_plugin_loader_t private_plugin_loader_t;
@@ -349,7 +350,7 @@ static status_t create_plugin(private_plugin_loader_t *this, void *handle,
 }
 
 /**
- * load a single plugin
+ * load a single plugin, the returned entry is not yet part of the plugin list
  */
 static plugin_entry_t *load_plugin(private_plugin_loader_t *this, char *name,
 								   char *file, bool critical)
@@ -360,7 +361,6 @@ static plugin_entry_t *load_plugin(private_plugin_loader_t *this, char *name,
 	switch (create_plugin(this, RTLD_DEFAULT, name, FALSE, critical, &entry))
 	{
 		case SUCCESS:
-			this->plugins->insert_last(this->plugins, entry);
 			return entry;
 		case NOT_FOUND:
 			if (file)
@@ -400,7 +400,6 @@ static plugin_entry_t *load_plugin(private_plugin_loader_t *this, char *name,
 		return NULL;
 	}
 	entry->handle = handle;
-	this->plugins->insert_last(this->plugins, entry);
 	return entry;
 }
 
@@ -1099,12 +1098,102 @@ static char *modular_pluginlist(char *list)
 	return plugins;
 }
 
+/**
+ * State of a single plugin load task
+ */
+typedef struct {
+	/** loader instance */
+	private_plugin_loader_t *loader;
+	/** name of the plugin to load */
+	char *name;
+	/** path of the plugin file, if any */
+	char *file;
+	/** TRUE if a critical plugin */
+	bool critical;
+	/** created entry, or NULL if loading failed */
+	plugin_entry_t *entry;
+} plugin_load_task_t;
+
+/**
+ * State shared by the threads loading plugins concurrently
+ */
+typedef struct {
+	/** tasks to process, as plugin_load_task_t */
+	array_t *tasks;
+	/** number of tasks already claimed by a thread */
+	refcount_t next;
+} plugin_load_pool_t;
+
+/**
+ * Claim and process load tasks until all are taken
+ */
+static void *load_task_worker(plugin_load_pool_t *pool)
+{
+	plugin_load_task_t *task;
+	int idx;
+
+	while (TRUE)
+	{
+		idx = ref_get(&pool->next) - 1;
+		if (idx >= array_count(pool->tasks))
+		{
+			return NULL;
+		}
+		array_get(pool->tasks, idx, &task);
+		task->entry = load_plugin(task->loader, task->name, task->file,
+								  task->critical);
+	}
+}
+
+/**
+ * Process the given load tasks, using additional threads if configured.
+ * Plugin constructors only get invoked concurrently, features are still
+ * registered and loaded in plugin list order afterwards.
+ */
+static void load_plugin_tasks(private_plugin_loader_t *this, array_t *tasks)
+{
+	plugin_load_pool_t pool = {
+		.tasks = tasks,
+	};
+	thread_t **threads;
+	int i, count;
+
+	count = lib->settings->get_int(lib->settings, "%s.plugin_threads", 0,
+								   lib->ns);
+	count = min(count, array_count(tasks)) - 1;
+	if (count > 0)
+	{
+		DBG2(DBG_LIB, "loading plugins with %d threads", count + 1);
+		threads = malloc(count * sizeof(thread_t*));
+		for (i = 0; i < count; i++)
+		{
+			threads[i] = thread_create((thread_main_t)load_task_worker, &pool);
+		}
+		load_task_worker(&pool);
+		for (i = 0; i < count; i++)
+		{
+			if (threads[i])
+			{
+				threads[i]->join(threads[i]);
+			}
+		}
+		free(threads);
+	}
+	else
+	{
+		load_task_worker(&pool);
+	}
+}
+
 METHOD(plugin_loader_t, load_plugins, bool,
 	private_plugin_loader_t *this, char *list)
 {
 	enumerator_t *enumerator;
+	plugin_load_task_t *task;
+	array_t *tasks = NULL;
 	char *default_path = NULL, *plugins, *token;
 	bool critical_failed = FALSE;
+	int i;
 
 #ifdef PLUGINDIR
 	default_path = PLUGINDIR;
@@ -1113,10 +1202,9 @@ METHOD(plugin_loader_t, load_plugins, bool,
 	plugins = modular_pluginlist(list);
 
 	enumerator = enumerator_create_token(plugins, " ", " ");
-	while (!critical_failed && enumerator->enumerate(enumerator, &token))
+	while (enumerator->enumerate(enumerator, &token))
 	{
-		plugin_entry_t *entry;
-		bool critical = FALSE;
+		bool critical = FALSE, duplicate = FALSE;
 		char buf[PATH_MAX], *file = NULL;
 		int len;
 
@@ -1127,7 +1215,16 @@ METHOD(plugin_loader_t, load_plugins, bool,
 			critical = TRUE;
 			token[len-1] = '\0';
 		}
-		if (plugin_loaded(this, token))
+		for (i = 0; i < array_count(tasks); i++)
+		{
+			array_get(tasks, i, &task);
+			if (streq(task->name, token))
+			{
+				duplicate = TRUE;
+				break;
+			}
+		}
+		if (duplicate || plugin_loaded(this, token))
 		{
 			free(token);
 			continue;
@@ -1141,19 +1238,44 @@ METHOD(plugin_loader_t, load_plugins, bool,
 		{
 			find_plugin(default_path, token, buf, &file);
 		}
-		entry = load_plugin(this, token, file, critical);
-		if (entry)
+		INIT(task,
+			.loader = this,
+			.name = token,
+			.file = strdupnull(file),
+			.critical = critical,
+		);
+		array_insert_create(&tasks, ARRAY_TAIL, task);
+	}
+	enumerator->destroy(enumerator);
+
+	load_plugin_tasks(this, tasks);
+
+	for (i = 0; i < array_count(tasks); i++)
+	{
+		array_get(tasks, i, &task);
+		if (critical_failed)
+		{	/* don't use plugins after a failed critical one, as if loading
+			 * had stopped there */
+			if (task->entry)
+			{
+				plugin_entry_destroy(task->entry);
+			}
+		}
+		else if (task->entry)
 		{
-			register_features(this, entry);
+			this->plugins->insert_last(this->plugins, task->entry);
+			register_features(this, task->entry);
 		}
-		else if (critical)
+		else if (task->critical)
 		{
 			critical_failed = TRUE;
-			DBG1(DBG_LIB, "loading critical plugin '%s' failed", token);
+			DBG1(DBG_LIB, "loading critical plugin '%s' failed", task->name);
 		}
-		free(token);
+		free(task->name);
+		free(task->file);
+		free(task);
 	}
-	enumerator->destroy(enumerator);
+	array_destroy(tasks);
 	if (!critical_failed)
 	{
 		load_features(this);
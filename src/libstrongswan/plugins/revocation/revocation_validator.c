@@ -17,7 +17,12 @@
 
 #include "revocation_validator.h"
 
+#include <time.h>
+
 #include <utils/debug.h>
+#include <threading/mutex.h>
+#include <collections/linked_list.h>
+#include <processing/jobs/callback_job.h>
 #include <credentials/certificates/x509.h>
 #include <credentials/certificates/crl.h>
 #include <credentials/certificates/ocsp_request.h>
@@ -36,6 +41,21 @@ struct private_revocation_validator_t {
 	 * Public revocation_validator_t interface.
 	 */
 	revocation_validator_t public;
+
+	/**
+	 * TRUE to fetch OCSP responses in background jobs only
+	 */
+	bool prefetch;
+
+	/**
+	 * OCSP fetches currently queued or in progress, as ocsp_fetch_data_t
+	 */
+	linked_list_t *fetching;
+
+	/**
+	 * mutex to lock fetching list
+	 */
+	mutex_t *mutex;
 };
 
 /**
@@ -257,10 +277,148 @@ static certificate_t *get_better_ocsp(certificate_t *cand, certificate_t *best,
 	return best;
 }
 
+/**
+ * Data passed to an asynchronous OCSP fetch job
+ */
+typedef struct {
+	/** validator owning the fetch */
+	private_revocation_validator_t *this;
+	/** OCSP responder URL to query */
+	char *uri;
+	/** certificate to get status for */
+	certificate_t *subject;
+	/** issuing CA of subject */
+	certificate_t *issuer;
+} ocsp_fetch_data_t;
+
+/**
+ * Clean up OCSP fetch job data, unregistering the fetch
+ */
+static void ocsp_fetch_data_destroy(ocsp_fetch_data_t *data)
+{
+	data->this->mutex->lock(data->this->mutex);
+	data->this->fetching->remove(data->this->fetching, data, NULL);
+	data->this->mutex->unlock(data->this->mutex);
+
+	data->subject->destroy(data->subject);
+	data->issuer->destroy(data->issuer);
+	free(data->uri);
+	free(data);
+}
+
+/**
+ * Fetch, verify and cache an OCSP response in a background job
+ */
+static job_requeue_t ocsp_prefetch(ocsp_fetch_data_t *data)
+{
+	cert_validation_t valid = VALIDATION_SKIPPED;
+	certificate_t *response, *best;
+
+	response = fetch_ocsp(data->uri, data->subject, data->issuer);
+	if (response)
+	{	/* verification and caching as done for inline fetches */
+		best = get_better_ocsp(response, NULL, (x509_t*)data->subject,
+							   (x509_t*)data->issuer, &valid, TRUE);
+		DESTROY_IF(best);
+	}
+	return JOB_REQUEUE_NONE;
+}
+
+/**
+ * Queue a background fetch of an OCSP response, unless one is pending already
+ */
+static void queue_ocsp_fetch(private_revocation_validator_t *this, char *uri,
+							 x509_t *subject, x509_t *issuer)
+{
+	ocsp_fetch_data_t *data, *current;
+	enumerator_t *enumerator;
+	bool pending = FALSE;
+
+	this->mutex->lock(this->mutex);
+	enumerator = this->fetching->create_enumerator(this->fetching);
+	while (enumerator->enumerate(enumerator, &current))
+	{
+		if (streq(current->uri, uri) &&
+			current->subject->equals(current->subject, &subject->interface))
+		{
+			pending = TRUE;
+			break;
+		}
+	}
+	enumerator->destroy(enumerator);
+	if (!pending)
+	{
+		INIT(data,
+			.this = this,
+			.uri = strdup(uri),
+			.subject = subject->interface.get_ref(&subject->interface),
+			.issuer = issuer->interface.get_ref(&issuer->interface),
+		);
+		this->fetching->insert_last(this->fetching, data);
+		lib->processor->queue_job(lib->processor,
+			(job_t*)callback_job_create_with_prio((callback_job_cb_t)ocsp_prefetch,
+				data, (callback_job_cleanup_t)ocsp_fetch_data_destroy, NULL,
+				JOB_PRIO_LOW));
+	}
+	this->mutex->unlock(this->mutex);
+}
+
+/**
+ * Queue a background fetch using the first OCSP responder URL found, return
+ * TRUE if one was found
+ */
+static bool queue_ocsp_refresh(private_revocation_validator_t *this,
+							   identification_t *keyid,
+							   x509_t *subject, x509_t *issuer)
+{
+	enumerator_t *enumerator;
+	bool found = FALSE;
+	char *uri;
+
+	if (keyid)
+	{
+		enumerator = lib->credmgr->create_cdp_enumerator(lib->credmgr,
+											CERT_X509_OCSP_RESPONSE, keyid);
+		if (enumerator->enumerate(enumerator, &uri))
+		{
+			queue_ocsp_fetch(this, uri, subject, issuer);
+			found = TRUE;
+		}
+		enumerator->destroy(enumerator);
+	}
+	if (!found)
+	{
+		enumerator = subject->create_ocsp_uri_enumerator(subject);
+		if (enumerator->enumerate(enumerator, &uri))
+		{
+			queue_ocsp_fetch(this, uri, subject, issuer);
+			found = TRUE;
+		}
+		enumerator->destroy(enumerator);
+	}
+	return found;
+}
+
+/**
+ * Check if a cached OCSP response is due for a background refresh, i.e. has
+ * passed three quarters of its validity
+ */
+static bool ocsp_refresh_due(certificate_t *response)
+{
+	time_t this_update, next_update;
+
+	if (!response->get_validity(response, NULL, &this_update, &next_update))
+	{
+		return TRUE;
+	}
+	return time(NULL) > this_update + (next_update - this_update) * 3 / 4;
+}
+
 /**
  * validate a x509 certificate using OCSP
  */
-static cert_validation_t check_ocsp(x509_t *subject, x509_t *issuer,
+static cert_validation_t check_ocsp(private_revocation_validator_t *this,
+									x509_t *subject, x509_t *issuer,
 									auth_cfg_t *auth)
 {
 	enumerator_t *enumerator;
@@ -269,7 +427,8 @@ static cert_validation_t check_ocsp(x509_t *subject, x509_t *issuer,
 	identification_t *keyid = NULL;
 	public_key_t *public;
 	chunk_t chunk;
-	char *uri = NULL;
+	bool uri_found = FALSE;
+	char *uri;
 
 	/** lookup cache for valid OCSP responses */
 	enumerator = lib->credmgr->create_cert_enumerator(lib->credmgr,
@@ -293,50 +452,74 @@ static cert_validation_t check_ocsp(x509_t *subject, x509_t *issuer,
 	{
 		keyid = identification_create_from_encoding(ID_KEY_ID, chunk);
 	}
-	/** fetch from configured OCSP responder URLs */
-	if (keyid && valid != VALIDATION_GOOD && valid != VALIDATION_REVOKED)
+	if (this->prefetch)
 	{
-		enumerator = lib->credmgr->create_cdp_enumerator(lib->credmgr,
-											CERT_X509_OCSP_RESPONSE, keyid);
-		while (enumerator->enumerate(enumerator, &uri))
+		/* answer from the cache only, fetch and refresh in the background */
+		if (valid == VALIDATION_GOOD || valid == VALIDATION_REVOKED)
 		{
-			current = fetch_ocsp(uri, &subject->interface, &issuer->interface);
-			if (current)
+			if (best && ocsp_refresh_due(best))
 			{
-				best = get_better_ocsp(current, best, subject, issuer,
-									   &valid, TRUE);
-				if (best && valid != VALIDATION_STALE)
+				queue_ocsp_refresh(this, keyid, subject, issuer);
+			}
+		}
+		else
+		{
+			uri_found = queue_ocsp_refresh(this, keyid, subject, issuer);
+		}
+		DESTROY_IF(public);
+		DESTROY_IF(keyid);
+	}
+	else
+	{
+		/** fetch from configured OCSP responder URLs */
+		if (keyid && valid != VALIDATION_GOOD && valid != VALIDATION_REVOKED)
+		{
+			enumerator = lib->credmgr->create_cdp_enumerator(lib->credmgr,
+												CERT_X509_OCSP_RESPONSE, keyid);
+			while (enumerator->enumerate(enumerator, &uri))
+			{
+				uri_found = TRUE;
+				current = fetch_ocsp(uri, &subject->interface,
+									 &issuer->interface);
+				if (current)
 				{
-					break;
+					best = get_better_ocsp(current, best, subject, issuer,
+										   &valid, TRUE);
+					if (best && valid != VALIDATION_STALE)
+					{
+						break;
+					}
 				}
 			}
+			enumerator->destroy(enumerator);
 		}
-		enumerator->destroy(enumerator);
-	}
-	DESTROY_IF(public);
-	DESTROY_IF(keyid);
+		DESTROY_IF(public);
+		DESTROY_IF(keyid);
 
-	/* fallback to URL fetching from subject certificate's URIs */
-	if (valid != VALIDATION_GOOD && valid != VALIDATION_REVOKED)
-	{
-		enumerator = subject->create_ocsp_uri_enumerator(subject);
-		while (enumerator->enumerate(enumerator, &uri))
+		/* fallback to URL fetching from subject certificate's URIs */
+		if (valid != VALIDATION_GOOD && valid != VALIDATION_REVOKED)
 		{
-			current = fetch_ocsp(uri, &subject->interface, &issuer->interface);
-			if (current)
+			enumerator = subject->create_ocsp_uri_enumerator(subject);
+			while (enumerator->enumerate(enumerator, &uri))
 			{
-				best = get_better_ocsp(current, best, subject, issuer,
-									   &valid, TRUE);
-				if (best && valid != VALIDATION_STALE)
+				uri_found = TRUE;
+				current = fetch_ocsp(uri, &subject->interface,
+									 &issuer->interface);
+				if (current)
 				{
-					break;
+					best = get_better_ocsp(current, best, subject, issuer,
+										   &valid, TRUE);
+					if (best && valid != VALIDATION_STALE)
+					{
+						break;
+					}
 				}
 			}
+			enumerator->destroy(enumerator);
 		}
-		enumerator->destroy(enumerator);
 	}
 	/* an uri was found, but no result. switch validation state to failed */
-	if (valid == VALIDATION_SKIPPED && uri)
+	if (valid == VALIDATION_SKIPPED && uri_found)
 	{
 		valid = VALIDATION_FAILED;
 	}
@@ -414,6 +597,7 @@ static certificate_t *get_better_crl(certificate_t *cand, certificate_t *best,
 	time_t revocation, valid_until;
 	crl_reason_t reason;
 	chunk_t serial;
+	bool revoked;
 	crl_t *crl = (crl_t*)cand;
 
 	if (base)
@@ -442,28 +626,41 @@ static certificate_t *get_better_crl(certificate_t *cand, certificate_t *best,
 		return best;
 	}
 
-	enumerator = crl->create_enumerator(crl);
-	while (enumerator->enumerate(enumerator, &serial, &revocation, &reason))
+	revoked = FALSE;
+	if (crl->is_revoked)
+	{	/* use the indexed lookup, if the implementation provides one */
+		revoked = crl->is_revoked(crl, subject->get_serial(subject),
+								  &revocation, &reason);
+	}
+	else
 	{
-		if (chunk_equals(serial, subject->get_serial(subject)))
+		enumerator = crl->create_enumerator(crl);
+		while (enumerator->enumerate(enumerator, &serial, &revocation, &reason))
 		{
-			DBG1(DBG_CFG, "certificate was revoked on %T, reason: %N",
-				 &revocation, TRUE, crl_reason_names, reason);
-			if (reason != CRL_REASON_CERTIFICATE_HOLD)
+			if (chunk_equals(serial, subject->get_serial(subject)))
 			{
-				*valid = VALIDATION_REVOKED;
-			}
-			else
-			{
-				/* if the cert is on hold, a newer CRL might not contain it */
-				*valid = VALIDATION_ON_HOLD;
+				revoked = TRUE;
+				break;
 			}
-			enumerator->destroy(enumerator);
-			DESTROY_IF(best);
-			return cand;
 		}
+		enumerator->destroy(enumerator);
+	}
+	if (revoked)
+	{
+		DBG1(DBG_CFG, "certificate was revoked on %T, reason: %N",
+			 &revocation, TRUE, crl_reason_names, reason);
+		if (reason != CRL_REASON_CERTIFICATE_HOLD)
+		{
+			*valid = VALIDATION_REVOKED;
+		}
+		else
+		{
+			/* if the cert is on hold, a newer CRL might not contain it */
+			*valid = VALIDATION_ON_HOLD;
+		}
+		DESTROY_IF(best);
+		return cand;
 	}
-	enumerator->destroy(enumerator);
 
 	/* select the better of the two CRLs */
 	if (best == NULL || crl_is_newer(crl, (crl_t*)best))
@@ -723,7 +920,7 @@ METHOD(cert_validator_t, validate, bool,
 	{
 		DBG1(DBG_CFG, "checking certificate status of \"%Y\"",
 					   subject->get_subject(subject));
-		switch (check_ocsp((x509_t*)subject, (x509_t*)issuer,
+		switch (check_ocsp(this, (x509_t*)subject, (x509_t*)issuer,
 						   pathlen ? NULL : auth))
 		{
 			case VALIDATION_GOOD:
@@ -774,6 +971,8 @@ METHOD(cert_validator_t, validate, bool,
 METHOD(revocation_validator_t, destroy, void,
 	private_revocation_validator_t *this)
 {
+	this->fetching->destroy(this->fetching);
+	this->mutex->destroy(this->mutex);
 	free(this);
 }
 
@@ -789,6 +988,11 @@ revocation_validator_t *revocation_validator_create()
 			.validator.validate = _validate,
 			.destroy = _destroy,
 		},
+		.prefetch = lib->settings->get_bool(lib->settings,
+								"%s.plugins.revocation.prefetch", FALSE,
+								lib->ns),
+		.fetching = linked_list_create(),
+		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
 	);
 
 	return &this->public;
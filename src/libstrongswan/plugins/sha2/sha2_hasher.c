@@ -19,6 +19,7 @@
 #include <string.h>
 
 #include "sha2_hasher.h"
+#include "sha2_sha_ni.h"
 
 
 typedef struct private_sha512_hasher_t private_sha512_hasher_t;
@@ -55,6 +56,7 @@ struct private_sha256_hasher_t {
 	u_int32_t       sha_H[8];
 	u_int64_t       sha_blocks;
 	int             sha_bufCnt;
+	bool            sha_ni;         /* CPU supports the SHA extensions */
 };
 
 
@@ -146,6 +148,13 @@ static void sha256_transform(private_sha256_hasher_t *ctx,
 	u_int32_t       a, b, c, d, e, f, g, h;
 	u_int32_t       T1, T2, W[64], Wm2, Wm15;
 
+	if(ctx->sha_ni)
+	{
+		sha2_sha_ni_compress(ctx->sha_H, datap, 1);
+		ctx->sha_blocks++;
+		return;
+	}
+
 	/* read the data, big endian byte order */
 	j = 0;
 	do {
@@ -205,6 +214,15 @@ static void sha256_write(private_sha256_hasher_t *ctx,
 	{
 		if(!ctx->sha_bufCnt)
 		{
+			if(ctx->sha_ni && length >= sizeof(ctx->sha_out))
+			{	/* compress all complete blocks in a single call */
+				register int blocks = length / sizeof(ctx->sha_out);
+
+				sha2_sha_ni_compress(ctx->sha_H, datap, blocks);
+				ctx->sha_blocks += blocks;
+				datap += blocks * sizeof(ctx->sha_out);
+				length -= blocks * sizeof(ctx->sha_out);
+			}
 			while(length >= sizeof(ctx->sha_out))
 			{
 				sha256_transform(ctx, datap);
@@ -639,6 +657,7 @@ sha2_hasher_t *sha2_hasher_create(hash_algorithm_t algorithm)
 						.destroy = _destroy,
 					},
 				},
+				.sha_ni = SHA2_HAVE_SHA_NI && sha2_sha_ni_available(),
 			);
 			reset224(this);
 			return &this->public;
@@ -657,6 +676,7 @@ sha2_hasher_t *sha2_hasher_create(hash_algorithm_t algorithm)
 					.destroy = _destroy,
 					},
 				},
+				.sha_ni = SHA2_HAVE_SHA_NI && sha2_sha_ni_available(),
 			);
 			reset256(this);
 			return &this->public;
@@ -0,0 +1,279 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Hochschule fuer Technik Rapperswil
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include "sha2_sha_ni.h"
+
+#if SHA2_HAVE_SHA_NI
+
+#include <immintrin.h>
+
+/**
+ * CPUID leaf 7 SHA extension flag, returned in ebx
+ */
+#define CPUID7_SHA (1 << 29)
+
+/**
+ * Get cpuid for info/subleaf, return eax, ebx, ecx and edx.
+ * -fPIC requires to save ebx on IA-32.
+ */
+static void cpuid(u_int op, u_int sub, u_int *a, u_int *b, u_int *c, u_int *d)
+{
+#ifdef __x86_64__
+	asm("cpuid" : "=a" (*a), "=b" (*b), "=c" (*c), "=d" (*d)
+			: "a" (op), "c" (sub));
+#else /* __i386__ */
+	asm("pushl %%ebx;"
+		"cpuid;"
+		"movl %%ebx, %1;"
+		"popl %%ebx;"
+		: "=a" (*a), "=r" (*b), "=c" (*c), "=d" (*d) : "a" (op), "c" (sub));
+#endif /* __x86_64__ / __i386__*/
+}
+
+/**
+ * See header
+ */
+bool sha2_sha_ni_available()
+{
+	u_int a, b, c, d;
+
+	cpuid(0, 0, &a, &b, &c, &d);
+	if (a < 7)
+	{
+		return FALSE;
+	}
+	cpuid(7, 0, &a, &b, &c, &d);
+	return (b & CPUID7_SHA) != 0;
+}
+
+/**
+ * See header
+ */
+__attribute__((target("sha,sse4.1,ssse3")))
+void sha2_sha_ni_compress(u_int32_t state[8], const unsigned char *data,
+						  u_int blocks)
+{
+	__m128i state0, state1, abef_save, cdgh_save;
+	__m128i msg, msg0, msg1, msg2, msg3, tmp;
+	const __m128i shuf_mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+											 0x0405060700010203ULL);
+
+	/* reorder {a,b,c,d} / {e,f,g,h} into the ABEF/CDGH register layout */
+	tmp = _mm_shuffle_epi32(_mm_loadu_si128((__m128i*)&state[0]), 0xb1);
+	state1 = _mm_shuffle_epi32(_mm_loadu_si128((__m128i*)&state[4]), 0x1b);
+	state0 = _mm_alignr_epi8(tmp, state1, 8);
+	state1 = _mm_blend_epi16(state1, tmp, 0xf0);
+
+	while (blocks--)
+	{
+		abef_save = state0;
+		cdgh_save = state1;
+
+		/* rounds 0-3 */
+		msg0 = _mm_shuffle_epi8(
+					_mm_loadu_si128((__m128i*)(data + 0)), shuf_mask);
+		msg = _mm_add_epi32(msg0,
+					_mm_set_epi64x(0xE9B5DBA5B5C0FBCFULL, 0x71374491428A2F98ULL));
+		state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+		msg = _mm_shuffle_epi32(msg, 0x0e);
+		state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+
+		/* rounds 4-7 */
+		msg1 = _mm_shuffle_epi8(
+					_mm_loadu_si128((__m128i*)(data + 16)), shuf_mask);
+		msg = _mm_add_epi32(msg1,
+					_mm_set_epi64x(0xAB1C5ED5923F82A4ULL, 0x59F111F13956C25BULL));
+		state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+		msg = _mm_shuffle_epi32(msg, 0x0e);
+		state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+		msg0 = _mm_sha256msg1_epu32(msg0, msg1);
+
+		/* rounds 8-11 */
+		msg2 = _mm_shuffle_epi8(
+					_mm_loadu_si128((__m128i*)(data + 32)), shuf_mask);
+		msg = _mm_add_epi32(msg2,
+					_mm_set_epi64x(0x550C7DC3243185BEULL, 0x12835B01D807AA98ULL));
+		state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+		msg = _mm_shuffle_epi32(msg, 0x0e);
+		state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+		msg1 = _mm_sha256msg1_epu32(msg1, msg2);
+
+		/* rounds 12-15 */
+		msg3 = _mm_shuffle_epi8(
+					_mm_loadu_si128((__m128i*)(data + 48)), shuf_mask);
+		msg = _mm_add_epi32(msg3,
+					_mm_set_epi64x(0xC19BF1749BDC06A7ULL, 0x80DEB1FE72BE5D74ULL));
+		state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+		tmp = _mm_alignr_epi8(msg3, msg2, 4);
+		msg0 = _mm_add_epi32(msg0, tmp);
+		msg0 = _mm_sha256msg2_epu32(msg0, msg3);
+		msg = _mm_shuffle_epi32(msg, 0x0e);
+		state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+		msg2 = _mm_sha256msg1_epu32(msg2, msg3);
+
+		/* rounds 16-19 */
+		msg = _mm_add_epi32(msg0,
+					_mm_set_epi64x(0x240CA1CC0FC19DC6ULL, 0xEFBE4786E49B69C1ULL));
+		state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+		tmp = _mm_alignr_epi8(msg0, msg3, 4);
+		msg1 = _mm_add_epi32(msg1, tmp);
+		msg1 = _mm_sha256msg2_epu32(msg1, msg0);
+		msg = _mm_shuffle_epi32(msg, 0x0e);
+		state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+		msg3 = _mm_sha256msg1_epu32(msg3, msg0);
+
+		/* rounds 20-23 */
+		msg = _mm_add_epi32(msg1,
+					_mm_set_epi64x(0x76F988DA5CB0A9DCULL, 0x4A7484AA2DE92C6FULL));
+		state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+		tmp = _mm_alignr_epi8(msg1, msg0, 4);
+		msg2 = _mm_add_epi32(msg2, tmp);
+		msg2 = _mm_sha256msg2_epu32(msg2, msg1);
+		msg = _mm_shuffle_epi32(msg, 0x0e);
+		state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+		msg0 = _mm_sha256msg1_epu32(msg0, msg1);
+
+		/* rounds 24-27 */
+		msg = _mm_add_epi32(msg2,
+					_mm_set_epi64x(0xBF597FC7B00327C8ULL, 0xA831C66D983E5152ULL));
+		state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+		tmp = _mm_alignr_epi8(msg2, msg1, 4);
+		msg3 = _mm_add_epi32(msg3, tmp);
+		msg3 = _mm_sha256msg2_epu32(msg3, msg2);
+		msg = _mm_shuffle_epi32(msg, 0x0e);
+		state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+		msg1 = _mm_sha256msg1_epu32(msg1, msg2);
+
+		/* rounds 28-31 */
+		msg = _mm_add_epi32(msg3,
+					_mm_set_epi64x(0x1429296706CA6351ULL, 0xD5A79147C6E00BF3ULL));
+		state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+		tmp = _mm_alignr_epi8(msg3, msg2, 4);
+		msg0 = _mm_add_epi32(msg0, tmp);
+		msg0 = _mm_sha256msg2_epu32(msg0, msg3);
+		msg = _mm_shuffle_epi32(msg, 0x0e);
+		state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+		msg2 = _mm_sha256msg1_epu32(msg2, msg3);
+
+		/* rounds 32-35 */
+		msg = _mm_add_epi32(msg0,
+					_mm_set_epi64x(0x53380D134D2C6DFCULL, 0x2E1B213827B70A85ULL));
+		state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+		tmp = _mm_alignr_epi8(msg0, msg3, 4);
+		msg1 = _mm_add_epi32(msg1, tmp);
+		msg1 = _mm_sha256msg2_epu32(msg1, msg0);
+		msg = _mm_shuffle_epi32(msg, 0x0e);
+		state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+		msg3 = _mm_sha256msg1_epu32(msg3, msg0);
+
+		/* rounds 36-39 */
+		msg = _mm_add_epi32(msg1,
+					_mm_set_epi64x(0x92722C8581C2C92EULL, 0x766A0ABB650A7354ULL));
+		state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+		tmp = _mm_alignr_epi8(msg1, msg0, 4);
+		msg2 = _mm_add_epi32(msg2, tmp);
+		msg2 = _mm_sha256msg2_epu32(msg2, msg1);
+		msg = _mm_shuffle_epi32(msg, 0x0e);
+		state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+		msg0 = _mm_sha256msg1_epu32(msg0, msg1);
+
+		/* rounds 40-43 */
+		msg = _mm_add_epi32(msg2,
+					_mm_set_epi64x(0xC76C51A3C24B8B70ULL, 0xA81A664BA2BFE8A1ULL));
+		state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+		tmp = _mm_alignr_epi8(msg2, msg1, 4);
+		msg3 = _mm_add_epi32(msg3, tmp);
+		msg3 = _mm_sha256msg2_epu32(msg3, msg2);
+		msg = _mm_shuffle_epi32(msg, 0x0e);
+		state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+		msg1 = _mm_sha256msg1_epu32(msg1, msg2);
+
+		/* rounds 44-47 */
+		msg = _mm_add_epi32(msg3,
+					_mm_set_epi64x(0x106AA070F40E3585ULL, 0xD6990624D192E819ULL));
+		state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+		tmp = _mm_alignr_epi8(msg3, msg2, 4);
+		msg0 = _mm_add_epi32(msg0, tmp);
+		msg0 = _mm_sha256msg2_epu32(msg0, msg3);
+		msg = _mm_shuffle_epi32(msg, 0x0e);
+		state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+		msg2 = _mm_sha256msg1_epu32(msg2, msg3);
+
+		/* rounds 48-51 */
+		msg = _mm_add_epi32(msg0,
+					_mm_set_epi64x(0x34B0BCB52748774CULL, 0x1E376C0819A4C116ULL));
+		state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+		tmp = _mm_alignr_epi8(msg0, msg3, 4);
+		msg1 = _mm_add_epi32(msg1, tmp);
+		msg1 = _mm_sha256msg2_epu32(msg1, msg0);
+		msg = _mm_shuffle_epi32(msg, 0x0e);
+		state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+		msg3 = _mm_sha256msg1_epu32(msg3, msg0);
+
+		/* rounds 52-55 */
+		msg = _mm_add_epi32(msg1,
+					_mm_set_epi64x(0x682E6FF35B9CCA4FULL, 0x4ED8AA4A391C0CB3ULL));
+		state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+		tmp = _mm_alignr_epi8(msg1, msg0, 4);
+		msg2 = _mm_add_epi32(msg2, tmp);
+		msg2 = _mm_sha256msg2_epu32(msg2, msg1);
+		msg = _mm_shuffle_epi32(msg, 0x0e);
+		state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+
+		/* rounds 56-59 */
+		msg = _mm_add_epi32(msg2,
+					_mm_set_epi64x(0x8CC7020884C87814ULL, 0x78A5636F748F82EEULL));
+		state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+		tmp = _mm_alignr_epi8(msg2, msg1, 4);
+		msg3 = _mm_add_epi32(msg3, tmp);
+		msg3 = _mm_sha256msg2_epu32(msg3, msg2);
+		msg = _mm_shuffle_epi32(msg, 0x0e);
+		state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+
+		/* rounds 60-63 */
+		msg = _mm_add_epi32(msg3,
+					_mm_set_epi64x(0xC67178F2BEF9A3F7ULL, 0xA4506CEB90BEFFFAULL));
+		state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+		msg = _mm_shuffle_epi32(msg, 0x0e);
+		state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+
+		state0 = _mm_add_epi32(state0, abef_save);
+		state1 = _mm_add_epi32(state1, cdgh_save);
+
+		data += 64;
+	}
+
+	/* restore the {a,b,c,d} / {e,f,g,h} layout */
+	tmp = _mm_shuffle_epi32(state0, 0x1b);
+	state1 = _mm_shuffle_epi32(state1, 0xb1);
+	state0 = _mm_blend_epi16(tmp, state1, 0xf0);
+	state1 = _mm_alignr_epi8(state1, tmp, 8);
+	_mm_storeu_si128((__m128i*)&state[0], state0);
+	_mm_storeu_si128((__m128i*)&state[4], state1);
+}
+
+#else /* !SHA2_HAVE_SHA_NI */
+
+bool sha2_sha_ni_available()
+{
+	return FALSE;
+}
+
+void sha2_sha_ni_compress(u_int32_t state[8], const unsigned char *data,
+						  u_int blocks)
+{
+}
+
+#endif /* SHA2_HAVE_SHA_NI */
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Hochschule fuer Technik Rapperswil
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/**
+ * @defgroup sha2_sha_ni sha2_sha_ni
+ * @{ @ingroup sha2_p
+ */
+
+#ifndef SHA2_SHA_NI_H_
+#define SHA2_SHA_NI_H_
+
+#include <library.h>
+
+/**
+ * TRUE if we can build the SHA extension code path for this target
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && \
+	(__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define SHA2_HAVE_SHA_NI 1
+#else
+#define SHA2_HAVE_SHA_NI 0
+#endif
+
+/**
+ * Check if the CPU supports the SHA extension instructions.
+ *
+ * @return		TRUE if sha2_sha_ni_compress() may be used
+ */
+bool sha2_sha_ni_available();
+
+/**
+ * Compress a number of 64-byte blocks into a SHA-256 state using
+ * the SHA extension instructions.
+ *
+ * May be called only if sha2_sha_ni_available() returned TRUE.
+ *
+ * @param state		SHA-256 state words, updated in-place
+ * @param data		input data to compress
+ * @param blocks	number of 64-byte blocks at data
+ */
+void sha2_sha_ni_compress(u_int32_t state[8], const unsigned char *data,
+						  u_int blocks);
+
+#endif /** SHA2_SHA_NI_H_ @}*/
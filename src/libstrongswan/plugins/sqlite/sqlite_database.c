@@ -22,6 +22,8 @@
 #include <utils/debug.h>
 #include <threading/mutex.h>
 #include <threading/thread_value.h>
+#include <collections/linked_list.h>
+#include <processing/jobs/callback_job.h>
 
 typedef struct private_sqlite_database_t private_sqlite_database_t;
 
@@ -49,6 +51,16 @@ struct private_sqlite_database_t {
 	 * mutex used to lock execute(), if necessary
 	 */
 	mutex_t *mutex;
+
+	/**
+	 * prepared statements queued for asynchronous execution, as sqlite3_stmt
+	 */
+	linked_list_t *queue;
+
+	/**
+	 * TRUE if a worker job is draining the queue
+	 */
+	bool job_scheduled;
 };
 
 /**
@@ -306,6 +318,62 @@ METHOD(database_t, execute, int,
 	return affected;
 }
 
+/**
+ * Worker job draining queued asynchronous statements
+ */
+static job_requeue_t execute_async_job(private_sqlite_database_t *this)
+{
+	sqlite3_stmt *stmt;
+
+	while (TRUE)
+	{
+		this->mutex->lock(this->mutex);
+		if (this->queue->remove_first(this->queue, (void**)&stmt) != SUCCESS)
+		{
+			this->job_scheduled = FALSE;
+			this->mutex->unlock(this->mutex);
+			break;
+		}
+		this->mutex->unlock(this->mutex);
+
+		if (sqlite3_step(stmt) != SQLITE_DONE)
+		{
+			DBG1(DBG_LIB, "async sqlite execute failed: %s",
+				 sqlite3_errmsg(this->db));
+		}
+		sqlite3_finalize(stmt);
+	}
+	return JOB_REQUEUE_NONE;
+}
+
+METHOD(database_t, execute_async, bool,
+	private_sqlite_database_t *this, char *sql, ...)
+{
+	sqlite3_stmt *stmt;
+	va_list args;
+
+	/* values are bound with SQLITE_TRANSIENT, so the prepared statement
+	 * holds private copies and can get stepped later */
+	va_start(args, sql);
+	stmt = run(this, sql, &args);
+	va_end(args);
+	if (!stmt)
+	{
+		return FALSE;
+	}
+	this->mutex->lock(this->mutex);
+	this->queue->insert_last(this->queue, stmt);
+	if (!this->job_scheduled)
+	{
+		this->job_scheduled = TRUE;
+		lib->processor->queue_job(lib->processor, (job_t*)
+				callback_job_create((callback_job_cb_t)execute_async_job, this,
+									NULL, (callback_job_cancel_t)return_false));
+	}
+	this->mutex->unlock(this->mutex);
+	return TRUE;
+}
+
 METHOD(database_t, transaction, bool,
 	private_sqlite_database_t *this, bool serializable)
 {
@@ -399,6 +467,19 @@ static int busy_handler(private_sqlite_database_t *this, int count)
 METHOD(database_t, destroy, void,
 	private_sqlite_database_t *this)
 {
+	sqlite3_stmt *stmt;
+
+	/* flush statements still queued for asynchronous execution */
+	while (this->queue->remove_first(this->queue, (void**)&stmt) == SUCCESS)
+	{
+		if (sqlite3_step(stmt) != SQLITE_DONE)
+		{
+			DBG1(DBG_LIB, "async sqlite execute failed: %s",
+				 sqlite3_errmsg(this->db));
+		}
+		sqlite3_finalize(stmt);
+	}
+	this->queue->destroy(this->queue);
 	if (sqlite3_close(this->db) == SQLITE_BUSY)
 	{
 		DBG1(DBG_LIB, "sqlite close failed because database is busy");
@@ -430,6 +511,7 @@ sqlite_database_t *sqlite_database_create(char *uri)
 			.db = {
 				.query = _query,
 				.execute = _execute,
+				.execute_async = _execute_async,
 				.transaction = _transaction,
 				.commit = _commit_,
 				.rollback = _rollback,
@@ -439,6 +521,7 @@ sqlite_database_t *sqlite_database_create(char *uri)
 		},
 		.mutex = mutex_create(MUTEX_TYPE_RECURSIVE),
 		.transaction = thread_value_create(NULL),
+		.queue = linked_list_create(),
 	);
 
 	if (sqlite3_open(file, &this->db) != SQLITE_OK)
@@ -451,5 +534,16 @@ sqlite_database_t *sqlite_database_create(char *uri)
 
 	sqlite3_busy_handler(this->db, (void*)busy_handler, this);
 
+	if (lib->settings->get_bool(lib->settings, "%s.plugins.sqlite.wal",
+								FALSE, lib->ns))
+	{
+		if (sqlite3_exec(this->db, "PRAGMA journal_mode=WAL",
+						 NULL, NULL, NULL) != SQLITE_OK)
+		{
+			DBG1(DBG_LIB, "enabling sqlite WAL mode failed: %s",
+				 sqlite3_errmsg(this->db));
+		}
+	}
+
 	return &this->public;
 }
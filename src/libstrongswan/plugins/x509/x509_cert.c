@@ -38,6 +38,7 @@
 #include <collections/linked_list.h>
 #include <utils/identification.h>
 #include <selectors/traffic_selector.h>
+#include <threading/mutex.h>
 
 /**
  * Different kinds of generalNames
@@ -151,6 +152,46 @@ struct private_x509_cert_t {
 	 */
 	linked_list_t *policy_mappings;
 
+	/**
+	 * Raw subjectAltName extnValue, deferred for lazy parsing
+	 */
+	chunk_t deferred_alt_names;
+
+	/**
+	 * Raw crlDistributionPoints extnValue, deferred for lazy parsing
+	 */
+	chunk_t deferred_crl_dps;
+
+	/**
+	 * Raw authorityInfoAccess extnValue, deferred for lazy parsing
+	 */
+	chunk_t deferred_info_access;
+
+	/**
+	 * Raw nameConstraints extnValue, deferred for lazy parsing
+	 */
+	chunk_t deferred_name_constraints;
+
+	/**
+	 * Raw certificatePolicies extnValue, deferred for lazy parsing
+	 */
+	chunk_t deferred_cert_policies;
+
+	/**
+	 * Raw policyMappings extnValue, deferred for lazy parsing
+	 */
+	chunk_t deferred_policy_mappings;
+
+	/**
+	 * ASN.1 parse level of the deferred extnValues
+	 */
+	u_int extn_level;
+
+	/**
+	 * Lock protecting lazy extension parsing
+	 */
+	mutex_t *lazy_lock;
+
 	/**
 	 * certificate's embedded public key
 	 */
@@ -1376,6 +1417,7 @@ static bool parse_certificate(private_x509_cert_t *this)
 				break;
 			case X509_OBJ_EXTN_VALUE:
 			{
+				this->extn_level = level;
 				switch (extn_oid)
 				{
 					case OID_SUBJECT_KEY_ID:
@@ -1387,22 +1429,20 @@ static bool parse_certificate(private_x509_cert_t *this)
 						this->subjectKeyIdentifier = object;
 						break;
 					case OID_SUBJECT_ALT_NAME:
-						x509_parse_generalNames(object, level, FALSE,
-												this->subjectAltNames);
+						this->deferred_alt_names = object;
 						break;
 					case OID_BASIC_CONSTRAINTS:
 						parse_basicConstraints(object, level, this);
 						break;
 					case OID_CRL_DISTRIBUTION_POINTS:
-						x509_parse_crlDistributionPoints(object, level,
-														 this->crl_uris);
+						this->deferred_crl_dps = object;
 						break;
 					case OID_AUTHORITY_KEY_ID:
 						this->authKeyIdentifier = x509_parse_authorityKeyIdentifier(object,
 														level, &this->authKeySerialNumber);
 						break;
 					case OID_AUTHORITY_INFO_ACCESS:
-						parse_authorityInfoAccess(object, level, this);
+						this->deferred_info_access = object;
 						break;
 					case OID_KEY_USAGE:
 						parse_keyUsage(object, this);
@@ -1414,13 +1454,13 @@ static bool parse_certificate(private_x509_cert_t *this)
 						parse_ipAddrBlocks(object, level, this);
 						break;
 					case OID_NAME_CONSTRAINTS:
-						parse_nameConstraints(object, level, this);
+						this->deferred_name_constraints = object;
 						break;
 					case OID_CERTIFICATE_POLICIES:
-						parse_certificatePolicies(object, level, this);
+						this->deferred_cert_policies = object;
 						break;
 					case OID_POLICY_MAPPINGS:
-						parse_policyMappings(object, level, this);
+						this->deferred_policy_mappings = object;
 						break;
 					case OID_POLICY_CONSTRAINTS:
 						parse_policyConstraints(object, level, this);
@@ -1501,6 +1541,98 @@ end:
 	return success;
 }
 
+/**
+ * Parse the subjectAltName extension body deferred by parse_certificate()
+ * on first access. The raw extnValue aliases this->encoding, which is
+ * retained for the certificate lifetime.
+ */
+static void resolve_alt_names(private_x509_cert_t *this)
+{
+	this->lazy_lock->lock(this->lazy_lock);
+	if (this->deferred_alt_names.len)
+	{
+		x509_parse_generalNames(this->deferred_alt_names, this->extn_level,
+								FALSE, this->subjectAltNames);
+		this->deferred_alt_names = chunk_empty;
+	}
+	this->lazy_lock->unlock(this->lazy_lock);
+}
+
+/**
+ * Parse the crlDistributionPoints extension body on first access
+ */
+static void resolve_crl_dps(private_x509_cert_t *this)
+{
+	this->lazy_lock->lock(this->lazy_lock);
+	if (this->deferred_crl_dps.len)
+	{
+		x509_parse_crlDistributionPoints(this->deferred_crl_dps,
+										 this->extn_level, this->crl_uris);
+		this->deferred_crl_dps = chunk_empty;
+	}
+	this->lazy_lock->unlock(this->lazy_lock);
+}
+
+/**
+ * Parse the authorityInfoAccess extension body on first access
+ */
+static void resolve_info_access(private_x509_cert_t *this)
+{
+	this->lazy_lock->lock(this->lazy_lock);
+	if (this->deferred_info_access.len)
+	{
+		parse_authorityInfoAccess(this->deferred_info_access,
+								  this->extn_level, this);
+		this->deferred_info_access = chunk_empty;
+	}
+	this->lazy_lock->unlock(this->lazy_lock);
+}
+
+/**
+ * Parse the nameConstraints extension body on first access
+ */
+static void resolve_name_constraints(private_x509_cert_t *this)
+{
+	this->lazy_lock->lock(this->lazy_lock);
+	if (this->deferred_name_constraints.len)
+	{
+		parse_nameConstraints(this->deferred_name_constraints,
+							  this->extn_level, this);
+		this->deferred_name_constraints = chunk_empty;
+	}
+	this->lazy_lock->unlock(this->lazy_lock);
+}
+
+/**
+ * Parse the certificatePolicies extension body on first access
+ */
+static void resolve_cert_policies(private_x509_cert_t *this)
+{
+	this->lazy_lock->lock(this->lazy_lock);
+	if (this->deferred_cert_policies.len)
+	{
+		parse_certificatePolicies(this->deferred_cert_policies,
+								  this->extn_level, this);
+		this->deferred_cert_policies = chunk_empty;
+	}
+	this->lazy_lock->unlock(this->lazy_lock);
+}
+
+/**
+ * Parse the policyMappings extension body on first access
+ */
+static void resolve_policy_mappings(private_x509_cert_t *this)
+{
+	this->lazy_lock->lock(this->lazy_lock);
+	if (this->deferred_policy_mappings.len)
+	{
+		parse_policyMappings(this->deferred_policy_mappings,
+							 this->extn_level, this);
+		this->deferred_policy_mappings = chunk_empty;
+	}
+	this->lazy_lock->unlock(this->lazy_lock);
+}
+
 METHOD(certificate_t, get_type, certificate_type_t,
 	private_x509_cert_t *this)
 {
@@ -1552,6 +1684,7 @@ METHOD(certificate_t, has_subject, id_match_t,
 		}
 	}
 	best = this->subject->matches(this->subject, subject);
+	resolve_alt_names(this);
 	enumerator = this->subjectAltNames->create_enumerator(this->subjectAltNames);
 	while (enumerator->enumerate(enumerator, &current))
 	{
@@ -1757,18 +1890,21 @@ METHOD(x509_t, get_constraint, u_int,
 METHOD(x509_t, create_subjectAltName_enumerator, enumerator_t*,
 	private_x509_cert_t *this)
 {
+	resolve_alt_names(this);
 	return this->subjectAltNames->create_enumerator(this->subjectAltNames);
 }
 
 METHOD(x509_t, create_ocsp_uri_enumerator, enumerator_t*,
 	private_x509_cert_t *this)
 {
+	resolve_info_access(this);
 	return this->ocsp_uris->create_enumerator(this->ocsp_uris);
 }
 
 METHOD(x509_t, create_crl_uri_enumerator, enumerator_t*,
 	private_x509_cert_t *this)
 {
+	resolve_crl_dps(this);
 	return this->crl_uris->create_enumerator(this->crl_uris);
 }
 
@@ -1781,6 +1917,7 @@ METHOD(x509_t, create_ipAddrBlock_enumerator, enumerator_t*,
 METHOD(x509_t, create_name_constraint_enumerator, enumerator_t*,
 	private_x509_cert_t *this, bool perm)
 {
+	resolve_name_constraints(this);
 	if (perm)
 	{
 		return this->permitted_names->create_enumerator(this->permitted_names);
@@ -1791,12 +1928,14 @@ METHOD(x509_t, create_name_constraint_enumerator, enumerator_t*,
 METHOD(x509_t, create_cert_policy_enumerator, enumerator_t*,
 	private_x509_cert_t *this)
 {
+	resolve_cert_policies(this);
 	return this->cert_policies->create_enumerator(this->cert_policies);
 }
 
 METHOD(x509_t, create_policy_mapping_enumerator, enumerator_t*,
 	private_x509_cert_t *this)
 {
+	resolve_policy_mappings(this);
 	return this->policy_mappings->create_enumerator(this->policy_mappings);
 }
 
@@ -1819,6 +1958,7 @@ METHOD(certificate_t, destroy, void,
 											  (void*)cert_policy_destroy);
 		this->policy_mappings->destroy_function(this->policy_mappings,
 											  (void*)policy_mapping_destroy);
+		this->lazy_lock->destroy(this->lazy_lock);
 		DESTROY_IF(this->issuer);
 		DESTROY_IF(this->subject);
 		DESTROY_IF(this->public_key);
@@ -1882,6 +2022,7 @@ static private_x509_cert_t* create_empty(void)
 		.excluded_names = linked_list_create(),
 		.cert_policies = linked_list_create(),
 		.policy_mappings = linked_list_create(),
+		.lazy_lock = mutex_create(MUTEX_TYPE_DEFAULT),
 		.pathLenConstraint = X509_NO_CONSTRAINT,
 		.require_explicit = X509_NO_CONSTRAINT,
 		.inhibit_mapping = X509_NO_CONSTRAINT,
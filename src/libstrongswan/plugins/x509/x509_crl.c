@@ -34,7 +34,7 @@ typedef struct revoked_t revoked_t;
  */
 struct revoked_t {
 	/**
-	 * serial of the revoked certificate
+	 * serial of the revoked certificate, points into encoding for parsed CRLs
 	 */
 	chunk_t serial;
 
@@ -95,9 +95,24 @@ struct private_x509_crl_t {
 	time_t nextUpdate;
 
 	/**
-	 * list of revoked certificates as revoked_t
+	 * array of revoked certificates as revoked_t, in CRL order
 	 */
-	linked_list_t *revoked;
+	revoked_t *revoked;
+
+	/**
+	 * number of entries in revoked
+	 */
+	u_int revoked_count;
+
+	/**
+	 * allocated size of revoked, in entries
+	 */
+	u_int revoked_size;
+
+	/**
+	 * pointers into revoked, sorted by serial for binary search
+	 */
+	revoked_t **index;
 
 	/**
 	 * List of Freshest CRL distribution points
@@ -214,6 +229,52 @@ static const asn1Object_t crlObjects[] = {
 #define CRL_OBJ_ALGORITHM				27
 #define CRL_OBJ_SIGNATURE				28
 
+/**
+ * Append an entry to the revoked array, growing it as needed
+ */
+static revoked_t* add_revoked(private_x509_crl_t *this,
+							  chunk_t serial, time_t date)
+{
+	revoked_t *revoked;
+
+	if (this->revoked_count == this->revoked_size)
+	{
+		this->revoked_size = max(this->revoked_size * 2, 32);
+		this->revoked = realloc(this->revoked,
+								this->revoked_size * sizeof(revoked_t));
+	}
+	revoked = &this->revoked[this->revoked_count++];
+	revoked->serial = serial;
+	revoked->date = date;
+	revoked->reason = CRL_REASON_UNSPECIFIED;
+	return revoked;
+}
+
+/**
+ * qsort() comparison function for the serial index
+ */
+static int compare_revoked(const void *a, const void *b)
+{
+	return chunk_compare((*(revoked_t**)a)->serial, (*(revoked_t**)b)->serial);
+}
+
+/**
+ * (Re)build the index over the revoked array, sorted by serial
+ */
+static void build_index(private_x509_crl_t *this)
+{
+	u_int i;
+
+	free(this->index);
+	this->index = malloc(sizeof(revoked_t*) * max(this->revoked_count, 1));
+	for (i = 0; i < this->revoked_count; i++)
+	{
+		this->index[i] = &this->revoked[i];
+	}
+	qsort(this->index, this->revoked_count, sizeof(revoked_t*),
+		  compare_revoked);
+}
+
 /**
  *  Parses an X.509 Certificate Revocation List (CRL)
  */
@@ -261,11 +322,12 @@ static bool parse(private_x509_crl_t *this)
 				userCertificate = object;
 				break;
 			case CRL_OBJ_REVOCATION_DATE:
-				revoked = malloc_thing(revoked_t);
-				revoked->serial = chunk_clone(userCertificate);
-				revoked->date = asn1_parse_time(object, level);
-				revoked->reason = CRL_REASON_UNSPECIFIED;
-				this->revoked->insert_last(this->revoked, (void *)revoked);
+				/* the serial points into the encoding kept for the lifetime
+				 * of the CRL, no need to clone it. the pointer stays valid
+				 * until the next entry is added, i.e. past this entry's
+				 * crlEntryExtensions. */
+				revoked = add_revoked(this, userCertificate,
+									  asn1_parse_time(object, level));
 				break;
 			case CRL_OBJ_CRL_ENTRY_EXTN_ID:
 			case CRL_OBJ_EXTN_ID:
@@ -354,6 +416,10 @@ static bool parse(private_x509_crl_t *this)
 		}
 	}
 	success = parser->success(parser);
+	if (success)
+	{
+		build_index(this);
+	}
 
 end:
 	parser->destroy(parser);
@@ -361,22 +427,41 @@ end:
 }
 
 /**
- * enumerator filter callback for create_enumerator
+ * enumerator over the revoked array
+ */
+typedef struct {
+	/** implements enumerator_t */
+	enumerator_t public;
+	/** enumerated CRL */
+	private_x509_crl_t *crl;
+	/** position in revoked array */
+	u_int i;
+} crl_enumerator_t;
+
+/**
+ * enumerate function for crl_enumerator_t
  */
-static bool filter(void *data, revoked_t **revoked, chunk_t *serial, void *p2,
-				   time_t *date, void *p3, crl_reason_t *reason)
+static bool crl_enumerate(crl_enumerator_t *this, chunk_t *serial,
+						  time_t *date, crl_reason_t *reason)
 {
+	revoked_t *revoked;
+
+	if (this->i >= this->crl->revoked_count)
+	{
+		return FALSE;
+	}
+	revoked = &this->crl->revoked[this->i++];
 	if (serial)
 	{
-		*serial = (*revoked)->serial;
+		*serial = revoked->serial;
 	}
 	if (date)
 	{
-		*date = (*revoked)->date;
+		*date = revoked->date;
 	}
 	if (reason)
 	{
-		*reason = (*revoked)->reason;
+		*reason = revoked->reason;
 	}
 	return TRUE;
 }
@@ -416,9 +501,52 @@ METHOD(crl_t, create_delta_crl_uri_enumerator, enumerator_t*,
 METHOD(crl_t, create_enumerator, enumerator_t*,
 	private_x509_crl_t *this)
 {
-	return enumerator_create_filter(
-								this->revoked->create_enumerator(this->revoked),
-								(void*)filter, NULL, NULL);
+	crl_enumerator_t *enumerator;
+
+	INIT(enumerator,
+		.public = {
+			.enumerate = (void*)crl_enumerate,
+			.destroy = (void*)free,
+		},
+		.crl = this,
+	);
+	return &enumerator->public;
+}
+
+METHOD(crl_t, is_revoked, bool,
+	private_x509_crl_t *this, chunk_t serial, time_t *revocation,
+	crl_reason_t *reason)
+{
+	revoked_t *revoked;
+	int lo = 0, hi = (int)this->revoked_count - 1, mid, cmp;
+
+	while (lo <= hi)
+	{
+		mid = (lo + hi) / 2;
+		revoked = this->index[mid];
+		cmp = chunk_compare(serial, revoked->serial);
+		if (cmp == 0)
+		{
+			if (revocation)
+			{
+				*revocation = revoked->date;
+			}
+			if (reason)
+			{
+				*reason = revoked->reason;
+			}
+			return TRUE;
+		}
+		if (cmp < 0)
+		{
+			hi = mid - 1;
+		}
+		else
+		{
+			lo = mid + 1;
+		}
+	}
+	return FALSE;
 }
 
 METHOD(certificate_t, get_type, certificate_type_t,
@@ -564,15 +692,6 @@ METHOD(certificate_t, equals, bool,
 	return equal;
 }
 
-/**
- * Destroy a revoked_t entry
- */
-static void revoked_destroy(revoked_t *revoked)
-{
-	free(revoked->serial.ptr);
-	free(revoked);
-}
-
 /**
  * Destroy a CDP entry
  */
@@ -588,7 +707,18 @@ METHOD(certificate_t, destroy, void,
 {
 	if (ref_put(&this->ref))
 	{
-		this->revoked->destroy_function(this->revoked, (void*)revoked_destroy);
+		if (this->generated)
+		{	/* only generated CRLs own the serials, parsed ones point
+			 * into the retained encoding */
+			u_int i;
+
+			for (i = 0; i < this->revoked_count; i++)
+			{
+				free(this->revoked[i].serial.ptr);
+			}
+		}
+		free(this->revoked);
+		free(this->index);
 		this->crl_uris->destroy_function(this->crl_uris, (void*)cdp_destroy);
 		DESTROY_IF(this->issuer);
 		free(this->authKeyIdentifier.ptr);
@@ -633,9 +763,9 @@ static private_x509_crl_t* create_empty(void)
 				.is_delta_crl = _is_delta_crl,
 				.create_delta_crl_uri_enumerator = _create_delta_crl_uri_enumerator,
 				.create_enumerator = _create_enumerator,
+				.is_revoked = _is_revoked,
 			},
 		},
-		.revoked = linked_list_create(),
 		.crl_uris = linked_list_create(),
 		.ref = 1,
 	);
@@ -682,20 +812,15 @@ x509_crl_t *x509_crl_load(certificate_type_t type, va_list args)
  */
 static void read_revoked(private_x509_crl_t *crl, enumerator_t *enumerator)
 {
-	revoked_t *revoked;
 	chunk_t serial;
 	time_t date;
 	crl_reason_t reason;
 
 	while (enumerator->enumerate(enumerator, &serial, &date, &reason))
 	{
-		INIT(revoked,
-			.serial = chunk_clone(serial),
-			.date = date,
-			.reason = reason,
-		);
-		crl->revoked->insert_last(crl->revoked, revoked);
+		add_revoked(crl, chunk_clone(serial), date)->reason = reason;
 	}
+	build_index(crl);
 }
 
 /**
@@ -22,15 +22,34 @@
 
 #include "processor.h"
 
+#include <library.h>
 #include <utils/debug.h>
 #include <threading/thread.h>
 #include <threading/condvar.h>
 #include <threading/mutex.h>
+#include <threading/spinlock.h>
 #include <threading/thread_value.h>
 #include <collections/linked_list.h>
+#include <processing/jobs/callback_job.h>
+#include <utils/probes.h>
 
 typedef struct private_processor_t private_processor_t;
 
+/**
+ * Number of job lanes used to bind affinity groups to worker threads
+ */
+#define AFFINITY_LANES 16
+
+/**
+ * Interval the adaptive pool samples queue depth and idle threads, in ms
+ */
+#define ADAPT_INTERVAL_MS 1000
+
+/**
+ * Consecutive idle samples before the adaptive pool shrinks by a thread
+ */
+#define ADAPT_SHRINK_SAMPLES 30
+
 /**
  * Private data of processor_t class.
  */
@@ -67,11 +86,59 @@ struct private_processor_t {
 	 */
 	linked_list_t *jobs[JOB_PRIO_MAX];
 
+	/**
+	 * Queued jobs with an affinity group, assigned to lanes by group hash.
+	 * Each worker thread prefers the jobs of its own lane, other workers
+	 * steal from the opposite end of the deque.
+	 */
+	linked_list_t *lanes[AFFINITY_LANES];
+
+	/**
+	 * Spinlock for each lane, so affine jobs get queued and picked up
+	 * without serializing all workers on the global mutex
+	 */
+	spinlock_t *lane_locks[AFFINITY_LANES];
+
+	/**
+	 * Number of jobs queued in any lane, atomic
+	 */
+	refcount_t pending;
+
+	/**
+	 * Number of threads waiting for new jobs, atomic
+	 */
+	refcount_t sleeping;
+
+	/**
+	 * Lane to assign to the next spawned worker thread
+	 */
+	u_int next_lane;
+
 	/**
 	 * Threads reserved for each priority
 	 */
 	int prio_threads[JOB_PRIO_MAX];
 
+	/**
+	 * Lower bound the adaptive pool shrinks to, 0 for the initial count
+	 */
+	u_int min_threads;
+
+	/**
+	 * Upper bound the adaptive pool grows to, 0 to disable adaptive mode
+	 */
+	u_int max_threads;
+
+	/**
+	 * Whether the adaptive sampling job has been scheduled
+	 */
+	bool monitoring;
+
+	/**
+	 * Consecutive samples the pool was idle, for shrinking
+	 */
+	u_int idle_samples;
+
 	/**
 	 * access to job lists is locked through this mutex
 	 */
@@ -113,6 +180,11 @@ typedef struct {
 	 */
 	job_priority_t priority;
 
+	/**
+	 * Lane this worker prefers when picking up affine jobs
+	 */
+	u_int lane;
+
 } worker_thread_t;
 
 static void process_jobs(worker_thread_t *worker);
@@ -148,6 +220,7 @@ static void restart(worker_thread_t *worker)
 
 		INIT(new_worker,
 			.processor = this,
+			.lane = worker->lane,
 		);
 		new_worker->thread = thread_create((thread_main_t)process_jobs,
 										   new_worker);
@@ -179,6 +252,47 @@ static u_int get_idle_threads_nolock(private_processor_t *this)
 	return count;
 }
 
+/**
+ * Check priority bounds
+ */
+static job_priority_t sane_prio(job_priority_t prio)
+{
+	if ((int)prio < 0 || prio >= JOB_PRIO_MAX)
+	{
+		return JOB_PRIO_MAX - 1;
+	}
+	return prio;
+}
+
+/**
+ * Get an affine job from the given lane, which is locked by its spinlock
+ * only. The owning worker pops from the head of the deque, thieves steal
+ * from the tail, keeping recently queued group state with the owner.
+ */
+static bool get_affine_job(private_processor_t *this, worker_thread_t *worker,
+						   u_int lane, bool steal)
+{
+	linked_list_t *list = this->lanes[lane];
+	bool gotten;
+
+	this->lane_locks[lane]->lock(this->lane_locks[lane]);
+	if (steal)
+	{
+		gotten = list->remove_last(list, (void**)&worker->job) == SUCCESS;
+	}
+	else
+	{
+		gotten = list->remove_first(list, (void**)&worker->job) == SUCCESS;
+	}
+	this->lane_locks[lane]->unlock(this->lane_locks[lane]);
+	if (gotten)
+	{
+		ignore_result(ref_put(&this->pending));
+		worker->priority = sane_prio(worker->job->get_priority(worker->job));
+	}
+	return gotten;
+}
+
 /**
  * Get a job from any job queue, starting with the highest priority.
  *
@@ -188,6 +302,12 @@ static bool get_job(private_processor_t *this, worker_thread_t *worker)
 {
 	int i, reserved = 0, idle;
 
+	if (get_affine_job(this, worker, worker->lane, FALSE))
+	{	/* jobs bound to our lane come first, their state is likely to sit
+		 * in our cache from a previous job of the same group */
+		return TRUE;
+	}
+
 	idle = get_idle_threads_nolock(this);
 
 	for (i = 0; i < JOB_PRIO_MAX; i++)
@@ -197,8 +317,9 @@ static bool get_job(private_processor_t *this, worker_thread_t *worker)
 			DBG2(DBG_JOB, "delaying %N priority jobs: %d threads idle, "
 				 "but %d reserved for higher priorities",
 				 job_priority_names, i, idle, reserved);
-			/* wait until a job of higher priority gets queued */
-			return FALSE;
+			/* wait until a job of higher priority gets queued, but still
+			 * try to steal affine jobs below */
+			break;
 		}
 		if (this->working_threads[i] < this->prio_threads[i])
 		{
@@ -211,6 +332,14 @@ static bool get_job(private_processor_t *this, worker_thread_t *worker)
 			return TRUE;
 		}
 	}
+	for (i = 1; i < AFFINITY_LANES; i++)
+	{	/* instead of going idle, steal affine jobs from other lanes */
+		if (get_affine_job(this, worker,
+						   (worker->lane + i) % AFFINITY_LANES, TRUE))
+		{
+			return TRUE;
+		}
+	}
 	return FALSE;
 }
 
@@ -230,6 +359,8 @@ static void process_job(private_processor_t *this, worker_thread_t *worker)
 	this->mutex->unlock(this->mutex);
 	/* canceled threads are restarted to get a constant pool */
 	thread_cleanup_push((thread_cleanup_t)restart, worker);
+	PROBE1(job_run, worker->priority);
+	lib->metrics->increment(lib->metrics, METRIC_JOBS_EXECUTED);
 	while (TRUE)
 	{
 		requeue = worker->job->execute(worker->job);
@@ -243,6 +374,7 @@ static void process_job(private_processor_t *this, worker_thread_t *worker)
 			break;
 		}
 	}
+	PROBE1(job_run_done, worker->priority);
 	thread_cleanup_pop(FALSE);
 	this->mutex->lock(this->mutex);
 	this->working_threads[worker->priority]--;
@@ -322,7 +454,15 @@ static void process_jobs(worker_thread_t *worker)
 		}
 		else
 		{
-			this->job_added->wait(this->job_added, this->mutex);
+			/* announce ourself before the final check of the lanes, the
+			 * atomic counters pair with those in queue_job_group() to
+			 * avoid a lost wakeup without its queuers taking the mutex */
+			ref_get(&this->sleeping);
+			if (!ref_cur(&this->pending))
+			{
+				this->job_added->wait(this->job_added, this->mutex);
+			}
+			ignore_result(ref_put(&this->sleeping));
 		}
 	}
 	this->total_threads--;
@@ -352,18 +492,6 @@ METHOD(processor_t, get_idle_threads, u_int,
 	return count;
 }
 
-/**
- * Check priority bounds
- */
-static job_priority_t sane_prio(job_priority_t prio)
-{
-	if ((int)prio < 0 || prio >= JOB_PRIO_MAX)
-	{
-		return JOB_PRIO_MAX - 1;
-	}
-	return prio;
-}
-
 METHOD(processor_t, get_working_threads, u_int,
 	private_processor_t *this, job_priority_t prio)
 {
@@ -378,11 +506,28 @@ METHOD(processor_t, get_working_threads, u_int,
 METHOD(processor_t, get_job_load, u_int,
 	private_processor_t *this, job_priority_t prio)
 {
+	enumerator_t *enumerator;
+	job_t *job;
 	u_int load;
+	int i;
 
 	prio = sane_prio(prio);
 	this->mutex->lock(this->mutex);
 	load = this->jobs[prio]->get_count(this->jobs[prio]);
+	for (i = 0; i < AFFINITY_LANES; i++)
+	{
+		this->lane_locks[i]->lock(this->lane_locks[i]);
+		enumerator = this->lanes[i]->create_enumerator(this->lanes[i]);
+		while (enumerator->enumerate(enumerator, &job))
+		{
+			if (sane_prio(job->get_priority(job)) == prio)
+			{
+				load++;
+			}
+		}
+		enumerator->destroy(enumerator);
+		this->lane_locks[i]->unlock(this->lane_locks[i]);
+	}
 	this->mutex->unlock(this->mutex);
 	return load;
 }
@@ -395,12 +540,35 @@ METHOD(processor_t, queue_job, void,
 	prio = sane_prio(job->get_priority(job));
 	job->status = JOB_STATUS_QUEUED;
 
+	PROBE1(job_queue, prio);
+	lib->metrics->increment(lib->metrics, METRIC_JOBS_QUEUED);
 	this->mutex->lock(this->mutex);
 	this->jobs[prio]->insert_last(this->jobs[prio], job);
 	this->job_added->signal(this->job_added);
 	this->mutex->unlock(this->mutex);
 }
 
+METHOD(processor_t, queue_job_group, void,
+	private_processor_t *this, job_t *job, u_int group)
+{
+	u_int lane = group % AFFINITY_LANES;
+
+	job->status = JOB_STATUS_QUEUED;
+
+	this->lane_locks[lane]->lock(this->lane_locks[lane]);
+	this->lanes[lane]->insert_last(this->lanes[lane], job);
+	this->lane_locks[lane]->unlock(this->lane_locks[lane]);
+
+	ref_get(&this->pending);
+	if (ref_cur(&this->sleeping))
+	{	/* take the mutex only if a worker has to be woken, otherwise it
+		 * either is busy or has not checked the pending count yet */
+		this->mutex->lock(this->mutex);
+		this->job_added->signal(this->job_added);
+		this->mutex->unlock(this->mutex);
+	}
+}
+
 METHOD(processor_t, execute_job, void,
 	private_processor_t *this, job_t *job)
 {
@@ -426,8 +594,68 @@ METHOD(processor_t, execute_job, void,
 	}
 }
 
-METHOD(processor_t, set_threads, void,
-	private_processor_t *this, u_int count)
+static void set_threads_internal(private_processor_t *this, u_int count);
+
+/**
+ * Sample job queue depth and idle threads, growing or shrinking the pool
+ * between the configured bounds.
+ *
+ * A backlog with no idle threads means jobs currently sit in the queue
+ * at least for the sampling interval, so additional threads are spawned
+ * immediately. Shrinking only happens after the pool was idle for many
+ * consecutive samples, as a terminated thread is cheap to keep but
+ * expensive to miss during a morning peak.
+ */
+static job_requeue_t adapt_pool(private_processor_t *this)
+{
+	u_int total, idle, load = 0, target = 0, i;
+
+	this->mutex->lock(this->mutex);
+	if (this->desired_threads == 0)
+	{	/* pool is shutting down */
+		this->mutex->unlock(this->mutex);
+		return JOB_REQUEUE_NONE;
+	}
+	total = this->desired_threads;
+	idle = get_idle_threads_nolock(this);
+	for (i = 0; i < JOB_PRIO_MAX; i++)
+	{
+		load += this->jobs[i]->get_count(this->jobs[i]);
+	}
+	load += ref_cur(&this->pending);
+
+	if (load && !idle && total < this->max_threads)
+	{
+		target = min(this->max_threads, total + max(load, 1));
+		this->idle_samples = 0;
+	}
+	else if (!load && idle && total > this->min_threads)
+	{
+		if (++this->idle_samples >= ADAPT_SHRINK_SAMPLES)
+		{
+			target = total - 1;
+			this->idle_samples = 0;
+		}
+	}
+	else
+	{
+		this->idle_samples = 0;
+	}
+	this->mutex->unlock(this->mutex);
+
+	if (target)
+	{
+		DBG1(DBG_JOB, "adapting pool from %d to %d threads "
+			 "(%d jobs queued, %d threads idle)", total, target, load, idle);
+		set_threads_internal(this, target);
+	}
+	return JOB_RESCHEDULE_MS(ADAPT_INTERVAL_MS);
+}
+
+/**
+ * Adjust the number of pooled threads, see set_threads()
+ */
+static void set_threads_internal(private_processor_t *this, u_int count)
 {
 	this->mutex->lock(this->mutex);
 	if (count > this->total_threads)
@@ -441,6 +669,7 @@ METHOD(processor_t, set_threads, void,
 		{
 			INIT(worker,
 				.processor = this,
+				.lane = this->next_lane++ % AFFINITY_LANES,
 			);
 			worker->thread = thread_create((thread_main_t)process_jobs, worker);
 			if (worker->thread)
@@ -462,6 +691,27 @@ METHOD(processor_t, set_threads, void,
 	this->mutex->unlock(this->mutex);
 }
 
+METHOD(processor_t, set_threads, void,
+	private_processor_t *this, u_int count)
+{
+	set_threads_internal(this, count);
+
+	this->mutex->lock(this->mutex);
+	if (count && !this->monitoring && this->max_threads > count)
+	{
+		if (this->min_threads == 0 || this->min_threads > count)
+		{
+			this->min_threads = count;
+		}
+		this->monitoring = TRUE;
+		lib->scheduler->schedule_job_ms(lib->scheduler,
+			(job_t*)callback_job_create_with_prio((callback_job_cb_t)adapt_pool,
+				this, NULL, (callback_job_cancel_t)return_false,
+				JOB_PRIO_CRITICAL), ADAPT_INTERVAL_MS);
+	}
+	this->mutex->unlock(this->mutex);
+}
+
 METHOD(processor_t, cancel, void,
 	private_processor_t *this)
 {
@@ -506,6 +756,17 @@ METHOD(processor_t, cancel, void,
 			job->destroy(job);
 		}
 	}
+	for (i = 0; i < AFFINITY_LANES; i++)
+	{
+		this->lane_locks[i]->lock(this->lane_locks[i]);
+		while (this->lanes[i]->remove_first(this->lanes[i],
+											(void**)&job) == SUCCESS)
+		{
+			job->destroy(job);
+		}
+		this->lane_locks[i]->unlock(this->lane_locks[i]);
+	}
+	this->pending = 0;
 	this->mutex->unlock(this->mutex);
 }
 
@@ -522,6 +783,11 @@ METHOD(processor_t, destroy, void,
 	{
 		this->jobs[i]->destroy(this->jobs[i]);
 	}
+	for (i = 0; i < AFFINITY_LANES; i++)
+	{
+		this->lanes[i]->destroy(this->lanes[i]);
+		this->lane_locks[i]->destroy(this->lane_locks[i]);
+	}
 	this->threads->destroy(this->threads);
 	free(this);
 }
@@ -541,6 +807,7 @@ processor_t *processor_create()
 			.get_working_threads = _get_working_threads,
 			.get_job_load = _get_job_load,
 			.queue_job = _queue_job,
+			.queue_job_group = _queue_job_group,
 			.execute_job = _execute_job,
 			.set_threads = _set_threads,
 			.cancel = _cancel,
@@ -551,6 +818,11 @@ processor_t *processor_create()
 		.job_added = condvar_create(CONDVAR_TYPE_DEFAULT),
 		.thread_terminated = condvar_create(CONDVAR_TYPE_DEFAULT),
 	);
+	for (i = 0; i < AFFINITY_LANES; i++)
+	{
+		this->lanes[i] = linked_list_create();
+		this->lane_locks[i] = spinlock_create();
+	}
 	for (i = 0; i < JOB_PRIO_MAX; i++)
 	{
 		this->jobs[i] = linked_list_create();
@@ -558,6 +830,10 @@ processor_t *processor_create()
 						"%s.processor.priority_threads.%N", 0, lib->ns,
 						job_priority_names, i);
 	}
+	this->min_threads = lib->settings->get_int(lib->settings,
+						"%s.processor.min_threads", 0, lib->ns);
+	this->max_threads = lib->settings->get_int(lib->settings,
+						"%s.processor.max_threads", 0, lib->ns);
 
 	return &this->public;
 }
@@ -76,6 +76,20 @@ struct processor_t {
 	 */
 	void (*queue_job) (processor_t *this, job_t *job);
 
+	/**
+	 * Adds a job to the queue, preferring a specific worker thread.
+	 *
+	 * Jobs queued with the same group value are handed to the same worker
+	 * thread whenever possible, keeping the state they operate on warm in
+	 * that worker's CPU cache. Workers that would otherwise go idle steal
+	 * affine jobs queued for other workers, so jobs don't starve if their
+	 * preferred worker is busy.
+	 *
+	 * @param job			job to add to the queue
+	 * @param group			affinity group the job belongs to, e.g. a hash
+	 */
+	void (*queue_job_group)(processor_t *this, job_t *job, u_int group);
+
 	/**
 	 * Directly execute a job with an idle worker thread.
 	 *
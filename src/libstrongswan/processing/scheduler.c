@@ -26,8 +26,21 @@
 #include <threading/condvar.h>
 #include <threading/mutex.h>
 
-/* the initial size of the heap */
-#define HEAP_SIZE_DEFAULT 64
+/* resolution of the timer wheels, in ms */
+#define TICK_MS 10
+
+/* number of bits indexing the slots of a single wheel */
+#define WHEEL_BITS 8
+
+/* the number of slots per wheel */
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+
+/* mask to map a tick to a slot in a wheel */
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+
+/* the number of cascaded wheels, 4 levels with 8 bits each cover 2^32 ticks,
+ * i.e. more than a year of uptime at 10 ms resolution */
+#define WHEEL_COUNT 4
 
 typedef struct event_t event_t;
 
@@ -36,14 +49,19 @@ typedef struct event_t event_t;
  */
 struct event_t {
 	/**
-	 * Time to fire the event.
+	 * Time to fire the event, in ticks.
 	 */
-	timeval_t time;
+	u_int64_t tick;
 
 	/**
 	 * Every event has its assigned job.
 	 */
 	job_t *job;
+
+	/**
+	 * Next event in the slot list.
+	 */
+	event_t *next;
 };
 
 /**
@@ -55,6 +73,30 @@ static void event_destroy(event_t *event)
 	free(event);
 }
 
+typedef struct wheel_t wheel_t;
+
+/**
+ * A single level of the timer hierarchy.
+ */
+struct wheel_t {
+	/**
+	 * Lock protecting the slots (and, for the innermost wheel, the tick
+	 * counter and the condvar the scheduler thread sleeps on).
+	 */
+	mutex_t *mutex;
+
+	/**
+	 * Tick boundary up to which slots of this wheel have been cascaded to
+	 * the next lower wheel, unused for the innermost wheel.
+	 */
+	u_int64_t cascaded;
+
+	/**
+	 * Slots with unordered lists of pending events.
+	 */
+	event_t *slots[WHEEL_SLOTS];
+};
+
 typedef struct private_scheduler_t private_scheduler_t;
 
 /**
@@ -68,160 +110,268 @@ struct private_scheduler_t {
 	 scheduler_t public;
 
 	/**
-	 * The heap in which the events are stored.
+	 * The hierarchical timer wheels the events are stored in.
 	 */
-	event_t **heap;
+	wheel_t wheels[WHEEL_COUNT];
 
 	/**
-	 * The size of the heap.
+	 * The next tick the scheduler thread has not yet processed, protected
+	 * by the innermost wheel's lock.
 	 */
-	u_int heap_size;
+	u_int64_t tick;
 
 	/**
 	 * The number of scheduled events.
 	 */
-	u_int event_count;
+	refcount_t event_count;
 
 	/**
-	 * Exclusive access to list
-	 */
-	mutex_t *mutex;
-
-	/**
-	 * Condvar to wait for next job.
+	 * Condvar the scheduler thread waits on for the next tick, tied to the
+	 * innermost wheel's lock.
 	 */
 	condvar_t *condvar;
 };
 
 /**
- * Comparse two timevals, return >0 if a > b, <0 if a < b and =0 if equal
+ * Convert an absolute monotonic time to the tick the event expires at.
+ * Rounded up, so events never fire before their scheduled time.
  */
-static int timeval_cmp(timeval_t *a, timeval_t *b)
+static u_int64_t time_to_tick(timeval_t *tv)
 {
-	if (a->tv_sec > b->tv_sec)
-	{
-		return 1;
-	}
-	if (a->tv_sec < b->tv_sec)
-	{
-		return -1;
-	}
-	if (a->tv_usec > b->tv_usec)
-	{
-		return 1;
-	}
-	if (a->tv_usec < b->tv_usec)
+	u_int64_t ms;
+
+	ms = (u_int64_t)tv->tv_sec * 1000 + tv->tv_usec / 1000;
+	if (tv->tv_usec % 1000)
 	{
-		return -1;
+		ms++;
 	}
-	return 0;
+	return (ms + TICK_MS - 1) / TICK_MS;
+}
+
+/**
+ * Get the current time as a tick count, rounded down.
+ */
+static u_int64_t current_tick()
+{
+	timeval_t now;
+
+	time_monotonic(&now);
+	return ((u_int64_t)now.tv_sec * 1000 + now.tv_usec / 1000) / TICK_MS;
 }
 
 /**
- * Returns the top event without removing it. Returns NULL if the heap is empty.
+ * Insert an event into the innermost wheel.  The event fires at the given
+ * tick, which must not have been processed yet.  The caller must hold the
+ * innermost wheel's lock.
  */
-static event_t *peek_event(private_scheduler_t *this)
+static void insert_inner(private_scheduler_t *this, event_t *event,
+						 u_int64_t tick)
 {
-	return this->event_count > 0 ? this->heap[1] : NULL;
+	wheel_t *wheel = &this->wheels[0];
+
+	event->next = wheel->slots[tick & WHEEL_MASK];
+	wheel->slots[tick & WHEEL_MASK] = event;
 }
 
 /**
- * Removes the top event from the heap and returns it. Returns NULL if the heap
- * is empty.
+ * Insert an event into the wheel hierarchy.  Only the lock of the wheel the
+ * event ends up in is taken, so concurrent inserts on different levels (or
+ * on the outer levels while the scheduler thread drains the innermost one)
+ * don't contend.
  */
-static event_t *remove_event(private_scheduler_t *this)
+static void insert_event(private_scheduler_t *this, event_t *event)
 {
-	event_t *event, *top;
-	if (!this->event_count)
+	u_int64_t delta, boundary;
+	wheel_t *wheel;
+	int level;
+
+	for (level = WHEEL_COUNT - 1; level > 0; level--)
 	{
-		return NULL;
+		boundary = event->tick & ~(((u_int64_t)1 << (WHEEL_BITS * level)) - 1);
+
+		wheel = &this->wheels[level];
+		wheel->mutex->lock(wheel->mutex);
+		if (boundary > wheel->cascaded)
+		{	/* the slot has not been cascaded down yet, check whether the
+			 * event actually belongs to this level */
+			delta = event->tick - wheel->cascaded;
+			if (delta >= ((u_int64_t)1 << (WHEEL_BITS * level)))
+			{
+				event->next = wheel->slots[(event->tick >> (WHEEL_BITS * level))
+										   & WHEEL_MASK];
+				wheel->slots[(event->tick >> (WHEEL_BITS * level))
+							 & WHEEL_MASK] = event;
+				wheel->mutex->unlock(wheel->mutex);
+				return;
+			}
+		}
+		wheel->mutex->unlock(wheel->mutex);
+	}
+
+	wheel = &this->wheels[0];
+	wheel->mutex->lock(wheel->mutex);
+	if (event->tick < this->tick)
+	{	/* overdue, fire at the next tick */
+		event->tick = this->tick;
+	}
+	if (event->tick - this->tick < WHEEL_SLOTS)
+	{
+		insert_inner(this, event, event->tick);
+		/* wake the scheduler thread in case this event is due before the
+		 * tick it is currently waiting for */
+		this->condvar->signal(this->condvar);
+		wheel->mutex->unlock(wheel->mutex);
+		return;
 	}
+	/* does not fit into the innermost wheel, but outer wheels already
+	 * cascaded past it: the scheduler thread is lagging behind, park the
+	 * event in the slot of the last tick of the inner window, it gets
+	 * reexamined once the thread catches up */
+	insert_inner(this, event, this->tick + WHEEL_SLOTS - 1);
+	this->condvar->signal(this->condvar);
+	wheel->mutex->unlock(wheel->mutex);
+}
 
-	/* store the value to return */
-	event = this->heap[1];
-	/* move the bottom event to the top */
-	top = this->heap[1] = this->heap[this->event_count];
+/**
+ * Cascade the due slot of the given level down to the next lower wheel,
+ * recursively cascading higher levels at their boundaries first.  The caller
+ * must hold the innermost wheel's lock; locks of outer wheels are taken
+ * inside-out, inserts take a single wheel lock only, so this cannot deadlock.
+ */
+static void cascade(private_scheduler_t *this, u_int64_t tick, int level)
+{
+	u_int64_t span = (u_int64_t)1 << (WHEEL_BITS * level);
+	wheel_t *wheel = &this->wheels[level];
+	event_t *event, *list;
 
-	if (--this->event_count > 1)
+	if (level < WHEEL_COUNT - 1 &&
+		(tick & ((span << WHEEL_BITS) - 1)) == 0)
 	{
-		/* seep down the top event */
-		u_int position = 1;
-		while ((position << 1) <= this->event_count)
-		{
-			u_int child = position << 1;
+		cascade(this, tick, level + 1);
+	}
 
-			if ((child + 1) <= this->event_count &&
-				timeval_cmp(&this->heap[child + 1]->time,
-							&this->heap[child]->time) < 0)
-			{
-				/* the "right" child is smaller */
-				child++;
-			}
+	wheel->mutex->lock(wheel->mutex);
+	list = wheel->slots[(tick >> (WHEEL_BITS * level)) & WHEEL_MASK];
+	wheel->slots[(tick >> (WHEEL_BITS * level)) & WHEEL_MASK] = NULL;
+	wheel->cascaded = tick;
+	wheel->mutex->unlock(wheel->mutex);
 
-			if (timeval_cmp(&top->time, &this->heap[child]->time) <= 0)
-			{
-				/* the top event fires before the smaller of the two children,
-				 * stop */
-				break;
-			}
+	while ((event = list))
+	{
+		list = event->next;
+		if (level > 1)
+		{	/* hand the event down one level, events due in the very first
+			 * slot of the lower wheel end up in the slot that wheel cascades
+			 * once we return from the recursion, so they trickle through all
+			 * levels correctly */
+			wheel = &this->wheels[level - 1];
+			wheel->mutex->lock(wheel->mutex);
+			event->next = wheel->slots[(event->tick >> (WHEEL_BITS * (level - 1)))
+									   & WHEEL_MASK];
+			wheel->slots[(event->tick >> (WHEEL_BITS * (level - 1)))
+						 & WHEEL_MASK] = event;
+			wheel->mutex->unlock(wheel->mutex);
+		}
+		else
+		{	/* events from the second wheel are due less than span ticks
+			 * after the current boundary and fit the innermost wheel */
+			insert_inner(this, event, max(event->tick, tick));
+		}
+	}
+}
+
+/**
+ * Find the next tick the scheduler thread has to wake up at: the next
+ * occupied slot of the innermost wheel, or the next cascade boundary,
+ * whatever comes first.  Caller must hold the innermost wheel's lock.
+ */
+static u_int64_t peek_inner(private_scheduler_t *this)
+{
+	u_int64_t tick;
+	u_int i;
 
-			/* swap with the smaller child */
-			this->heap[position] = this->heap[child];
-			position = child;
+	for (i = 0;; i++)
+	{
+		tick = this->tick + i;
+		if (this->wheels[0].slots[tick & WHEEL_MASK])
+		{
+			return tick;
+		}
+		if (((tick + 1) & WHEEL_MASK) == 0)
+		{	/* stop at the next cascade boundary, outer wheels might move
+			 * events into the slots we already looked at */
+			return tick + 1;
 		}
-		this->heap[position] = top;
 	}
-	return event;
 }
 
 /**
- * Get events from the queue and pass it to the processor
+ * Get events from the wheels and pass them to the processor
  */
 static job_requeue_t schedule(private_scheduler_t * this)
 {
-	timeval_t now;
-	event_t *event;
-	bool timed = FALSE, oldstate;
+	u_int64_t now, next;
+	event_t *event, *list = NULL;
+	timeval_t tv;
+	bool oldstate;
+	mutex_t *mutex = this->wheels[0].mutex;
 
-	this->mutex->lock(this->mutex);
+	mutex->lock(mutex);
 
-	time_monotonic(&now);
+	now = current_tick();
 
-	if ((event = peek_event(this)) != NULL)
+	while (this->tick <= now)
 	{
-		if (timeval_cmp(&now, &event->time) >= 0)
+		if ((this->tick & WHEEL_MASK) == 0)
 		{
-			remove_event(this);
-			this->mutex->unlock(this->mutex);
-			DBG2(DBG_JOB, "got event, queuing job for execution");
-			lib->processor->queue_job(lib->processor, event->job);
-			free(event);
-			return JOB_REQUEUE_DIRECT;
+			cascade(this, this->tick, 1);
 		}
-		timersub(&event->time, &now, &now);
-		if (now.tv_sec)
+		while ((event = this->wheels[0].slots[this->tick & WHEEL_MASK]))
 		{
-			DBG2(DBG_JOB, "next event in %ds %dms, waiting",
-				 now.tv_sec, now.tv_usec/1000);
+			this->wheels[0].slots[this->tick & WHEEL_MASK] = event->next;
+			event->next = list;
+			list = event;
 		}
-		else
+		this->tick++;
+	}
+	if (list)
+	{
+		mutex->unlock(mutex);
+		DBG2(DBG_JOB, "got events, queuing jobs for execution");
+		while ((event = list))
 		{
-			DBG2(DBG_JOB, "next event in %dms, waiting", now.tv_usec/1000);
+			list = event->next;
+			if (event->tick > now)
+			{	/* parked event that was not due yet, see insert_event() */
+				insert_event(this, event);
+				continue;
+			}
+			ignore_result(ref_put(&this->event_count));
+			lib->processor->queue_job(lib->processor, event->job);
+			free(event);
 		}
-		timed = TRUE;
+		return JOB_REQUEUE_DIRECT;
 	}
-	thread_cleanup_push((thread_cleanup_t)this->mutex->unlock, this->mutex);
-	oldstate = thread_cancelability(TRUE);
 
-	if (timed)
+	if (ref_cur(&this->event_count))
 	{
-		this->condvar->timed_wait_abs(this->condvar, this->mutex, event->time);
+		next = peek_inner(this);
+		DBG2(DBG_JOB, "next event in %dms, waiting",
+			 (int)((next - now) * TICK_MS));
 	}
 	else
-	{
+	{	/* nothing scheduled, wake up at the next cascade boundary, outer
+		 * level inserts don't signal the condvar */
+		next = (this->tick + WHEEL_SLOTS) & ~(u_int64_t)WHEEL_MASK;
 		DBG2(DBG_JOB, "no events, waiting");
-		this->condvar->wait(this->condvar, this->mutex);
 	}
+	tv.tv_sec = (next * TICK_MS) / 1000;
+	tv.tv_usec = ((next * TICK_MS) % 1000) * 1000;
+	thread_cleanup_push((thread_cleanup_t)mutex->unlock, mutex);
+	oldstate = thread_cancelability(TRUE);
+
+	this->condvar->timed_wait_abs(this->condvar, mutex, tv);
+
 	thread_cancelability(oldstate);
 	thread_cleanup_pop(TRUE);
 	return JOB_REQUEUE_DIRECT;
@@ -230,49 +380,22 @@ static job_requeue_t schedule(private_scheduler_t * this)
 METHOD(scheduler_t, get_job_load, u_int,
 	private_scheduler_t *this)
 {
-	int count;
-	this->mutex->lock(this->mutex);
-	count = this->event_count;
-	this->mutex->unlock(this->mutex);
-	return count;
+	return (u_int)ref_cur(&this->event_count);
 }
 
 METHOD(scheduler_t, schedule_job_tv, void,
 	private_scheduler_t *this, job_t *job, timeval_t tv)
 {
 	event_t *event;
-	u_int position;
 
 	event = malloc_thing(event_t);
 	event->job = job;
 	event->job->status = JOB_STATUS_QUEUED;
-	event->time = tv;
-
-	this->mutex->lock(this->mutex);
+	event->tick = time_to_tick(&tv);
+	event->next = NULL;
 
-	this->event_count++;
-	if (this->event_count > this->heap_size)
-	{
-		/* double the size of the heap */
-		this->heap_size <<= 1;
-		this->heap = (event_t**)realloc(this->heap,
-									(this->heap_size + 1) * sizeof(event_t*));
-	}
-	/* "put" the event to the bottom */
-	position = this->event_count;
-
-	/* then bubble it up */
-	while (position > 1 && timeval_cmp(&this->heap[position >> 1]->time,
-									   &event->time) > 0)
-	{
-		/* parent has to be fired after the new event, move up */
-		this->heap[position] = this->heap[position >> 1];
-		position >>= 1;
-	}
-	this->heap[position] = event;
-
-	this->condvar->signal(this->condvar);
-	this->mutex->unlock(this->mutex);
+	ref_get(&this->event_count);
+	insert_event(this, event);
 }
 
 METHOD(scheduler_t, schedule_job, void,
@@ -304,23 +427,47 @@ METHOD(scheduler_t, flush, void,
 	private_scheduler_t *this)
 {
 	event_t *event;
+	wheel_t *wheel;
+	int level;
+	u_int i;
 
-	this->mutex->lock(this->mutex);
-	while ((event = remove_event(this)) != NULL)
+	for (level = 0; level < WHEEL_COUNT; level++)
 	{
-		event_destroy(event);
+		wheel = &this->wheels[level];
+		wheel->mutex->lock(wheel->mutex);
+	}
+	for (level = 0; level < WHEEL_COUNT; level++)
+	{
+		wheel = &this->wheels[level];
+		for (i = 0; i < WHEEL_SLOTS; i++)
+		{
+			while ((event = wheel->slots[i]))
+			{
+				wheel->slots[i] = event->next;
+				ignore_result(ref_put(&this->event_count));
+				event_destroy(event);
+			}
+		}
 	}
 	this->condvar->signal(this->condvar);
-	this->mutex->unlock(this->mutex);
+	for (level = WHEEL_COUNT - 1; level >= 0; level--)
+	{
+		wheel = &this->wheels[level];
+		wheel->mutex->unlock(wheel->mutex);
+	}
 }
 
 METHOD(scheduler_t, destroy, void,
 	private_scheduler_t *this)
 {
+	int level;
+
 	flush(this);
 	this->condvar->destroy(this->condvar);
-	this->mutex->destroy(this->mutex);
-	free(this->heap);
+	for (level = 0; level < WHEEL_COUNT; level++)
+	{
+		this->wheels[level].mutex->destroy(this->wheels[level].mutex);
+	}
 	free(this);
 }
 
@@ -331,6 +478,8 @@ scheduler_t * scheduler_create()
 {
 	private_scheduler_t *this;
 	callback_job_t *job;
+	u_int64_t now;
+	int level;
 
 	INIT(this,
 		.public = {
@@ -341,12 +490,17 @@ scheduler_t * scheduler_create()
 			.flush = _flush,
 			.destroy = _destroy,
 		},
-		.heap_size = HEAP_SIZE_DEFAULT,
-		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
 		.condvar = condvar_create(CONDVAR_TYPE_DEFAULT),
 	);
 
-	this->heap = (event_t**)calloc(this->heap_size + 1, sizeof(event_t*));
+	now = current_tick();
+	this->tick = now;
+	for (level = 0; level < WHEEL_COUNT; level++)
+	{
+		this->wheels[level].mutex = mutex_create(MUTEX_TYPE_DEFAULT);
+		this->wheels[level].cascaded =
+						now & ~(((u_int64_t)1 << (WHEEL_BITS * level)) - 1);
+	}
 
 	job = callback_job_create_with_prio((callback_job_cb_t)schedule, this,
 										NULL, return_false, JOB_PRIO_CRITICAL);
@@ -354,4 +508,3 @@ scheduler_t * scheduler_create()
 
 	return &this->public;
 }
-
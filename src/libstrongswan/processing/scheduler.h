@@ -31,52 +31,29 @@ typedef struct scheduler_t scheduler_t;
 /**
  * The scheduler queues timed events which are then passed to the processor.
  *
- * The scheduler is implemented as a heap. A heap is a special kind of tree-
- * based data structure that satisfies the following property: if B is a child
- * node of A, then key(A) >= (or <=) key(B). So either the element with the
- * greatest (max-heap) or the smallest (min-heap) key is the root of the heap.
- * We use a min-heap with the key being the absolute unix time at which an
- * event is scheduled. So the root is always the event that will fire next.
+ * The scheduler is implemented as a hierarchy of timer wheels. Time is
+ * divided into fixed-size ticks, and each wheel is an array of slots, where
+ * a slot holds the unordered list of events due in that tick. The innermost
+ * wheel covers the next 256 ticks with one tick per slot, each further wheel
+ * covers 256 times the span of the wheel below it with correspondingly
+ * coarser slots. When the scheduler thread crosses a slot boundary of an
+ * outer wheel, that slot's events are redistributed ("cascaded") into the
+ * finer slots of the wheels below.
  *
- * An earlier implementation of the scheduler used a sorted linked list to store
- * the events. That had the advantage that removing the next event was extremely
- * fast, also, adding an event scheduled before or after all other events was
- * equally fast (all in O(1)). The problem was, though, that adding an event
- * in-between got slower, as the number of events grew larger (O(n)).
- * For each connection there could be several events: IKE-rekey, NAT-keepalive,
- * retransmissions, expire (half-open), and others. So a gateway that probably
- * has to handle thousands of concurrent connnections has to be able to queue a
- * large number of events as fast as possible. Locking makes this even worse, to
- * provide thread-safety, no events can be processed, while an event is queued,
- * so making the insertion fast is even more important.
+ * Earlier implementations of the scheduler used a sorted linked list and
+ * later a binary min-heap keyed by the absolute firing time. The heap made
+ * both insertion and removal O(log n), but all operations shared a single
+ * mutex, and with tens of thousands of connections - each scheduling rekey,
+ * retransmit, NAT-keepalive and DPD events - the scheduler thread and the
+ * worker threads queueing events degraded into a contention point.
  *
- * That's the advantage of the heap. Adding an element to the heap can be
- * achieved in O(log n) - on the other hand, removing the root node also
- * requires O(log n) operations. Consider 10000 queued events. Inserting a new
- * event in the list implementation required up to 10000 comparisons. In the
- * heap implementation, the worst case is about 13.3 comparisons. That's a
- * drastic improvement.
- *
- * The implementation itself uses a binary tree mapped to a one-based array to
- * store the elements. This reduces storage overhead and simplifies navigation:
- * the children of the node at position n are at position 2n and 2n+1 (likewise
- * the parent node of the node at position n is at position [n/2]). Thus,
- * navigating up and down the tree is reduced to simple index computations.
- *
- * Adding an element to the heap works as follows: The heap is always filled
- * from left to right, until a row is full, then the next row is filled. Mapped
- * to an array this gets as simple as putting the new element to the first free
- * position. In a one-based array that position equals the number of elements
- * currently stored in the heap. Then the heap property has to be restored, i.e.
- * the new element has to be "bubbled up" the tree until the parent node's key
- * is smaller or the element got the new root of the tree.
- *
- * Removing the next event from the heap works similarly. The event itself is
- * the root node and stored at position 1 of the array. After removing it, the
- * root has to be replaced and the heap property has to be restored. This is
- * done by moving the bottom element (last row, rightmost element) to the root
- * and then "seep it down" by swapping it with child nodes until none of the
- * children has a smaller key or it is again a leaf node.
+ * With the timer wheels both insertion and expiry are O(1): inserting an
+ * event is prepending it to the slot list its expiration tick maps to, and
+ * expiring a tick is detaching that slot's list. Each wheel has its own
+ * lock, so an insert only contends with inserts mapping to the same level
+ * and with the periodic cascade, not with every other insert and the
+ * scheduler thread. The price is that firing is quantized to the tick
+ * resolution; expiration ticks are rounded up, so events never fire early.
  */
 struct scheduler_t {
 
@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Hochschule fuer Technik Rapperswil
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include "watchdog.h"
+
+#include <utils/debug.h>
+#include <processing/jobs/callback_job.h>
+
+typedef struct private_watchdog_t private_watchdog_t;
+
+/**
+ * Private data of an watchdog_t object.
+ */
+struct private_watchdog_t {
+
+	/**
+	 * Public watchdog_t interface.
+	 */
+	watchdog_t public;
+
+	/**
+	 * Watchdog run interval, in seconds, 0 if disabled
+	 */
+	u_int interval;
+
+	/**
+	 * Latency warning threshold, in ms
+	 */
+	u_int warn;
+
+	/**
+	 * Expected fire time of the next watchdog run
+	 */
+	timeval_t expected;
+};
+
+/**
+ * Queue wait canary for a single priority class
+ */
+typedef struct {
+	/** watchdog queueing the canary */
+	private_watchdog_t *this;
+	/** priority class the canary probes */
+	job_priority_t prio;
+	/** time the canary was queued */
+	timeval_t queued;
+} canary_t;
+
+/**
+ * Elapsed time since the given timestamp, in us
+ */
+static u_int64_t elapsed_us(timeval_t *since)
+{
+	timeval_t now, diff;
+
+	time_monotonic(&now);
+	timersub(&now, since, &diff);
+	return diff.tv_sec * 1000000ULL + diff.tv_usec;
+}
+
+/**
+ * Measure how long a canary job waited in its queue
+ */
+static job_requeue_t canary_run(canary_t *canary)
+{
+	u_int64_t wait;
+
+	wait = elapsed_us(&canary->queued);
+	lib->metrics->add(lib->metrics,
+					  METRIC_JOB_WAIT_CRITICAL_US + canary->prio, wait);
+	if (wait / 1000 >= canary->this->warn)
+	{
+		DBG1(DBG_JOB, "watchdog: %N priority job waited %llu ms in queue",
+			 job_priority_names, canary->prio, (unsigned long long)wait / 1000);
+		lib->metrics->increment(lib->metrics, METRIC_WATCHDOG_WARNINGS);
+	}
+	return JOB_REQUEUE_NONE;
+}
+
+/**
+ * Measure scheduler fire latency, then sample the job queues
+ */
+static job_requeue_t watchdog_run(private_watchdog_t *this)
+{
+	canary_t *canary;
+	u_int64_t lag;
+	int prio;
+
+	if (timerisset(&this->expected))
+	{
+		lag = elapsed_us(&this->expected);
+		lib->metrics->add(lib->metrics, METRIC_SCHEDULER_LAG_US, lag);
+		if (lag / 1000 >= this->warn)
+		{
+			DBG1(DBG_JOB, "watchdog: scheduled job fired %llu ms late",
+				 (unsigned long long)lag / 1000);
+			lib->metrics->increment(lib->metrics, METRIC_WATCHDOG_WARNINGS);
+		}
+	}
+
+	for (prio = 0; prio < JOB_PRIO_MAX; prio++)
+	{
+		INIT(canary,
+			.this = this,
+			.prio = prio,
+		);
+		time_monotonic(&canary->queued);
+		lib->processor->queue_job(lib->processor,
+			(job_t*)callback_job_create_with_prio((callback_job_cb_t)canary_run,
+											canary, free, NULL, prio));
+	}
+
+	time_monotonic(&this->expected);
+	this->expected.tv_sec += this->interval;
+	return JOB_RESCHEDULE(this->interval);
+}
+
+METHOD(watchdog_t, destroy, void,
+	private_watchdog_t *this)
+{
+	free(this);
+}
+
+/**
+ * See header
+ */
+watchdog_t *watchdog_create()
+{
+	private_watchdog_t *this;
+
+	INIT(this,
+		.public = {
+			.destroy = _destroy,
+		},
+		.interval = lib->settings->get_int(lib->settings,
+								"%s.watchdog.interval", 0, lib->ns),
+		.warn = lib->settings->get_int(lib->settings,
+								"%s.watchdog.warn", 1000, lib->ns),
+	);
+
+	if (this->interval)
+	{
+		lib->scheduler->schedule_job(lib->scheduler,
+			(job_t*)callback_job_create_with_prio(
+							(callback_job_cb_t)watchdog_run, this, NULL, NULL,
+							JOB_PRIO_CRITICAL), this->interval);
+	}
+	return &this->public;
+}
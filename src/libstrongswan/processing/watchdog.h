@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Hochschule fuer Technik Rapperswil
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/**
+ * @defgroup watchdog watchdog
+ * @{ @ingroup processing
+ */
+
+#ifndef WATCHDOG_H_
+#define WATCHDOG_H_
+
+typedef struct watchdog_t watchdog_t;
+
+#include <library.h>
+
+/**
+ * Scheduler/processor latency watchdog.
+ *
+ * If enabled, a periodic high priority job measures how late the scheduler
+ * fires it and queues a canary job at each priority class to sample the
+ * job queue wait. Samples go to the metrics registry, measurements past
+ * the warn threshold get logged. This catches conditions where all worker
+ * threads block on a stuck operation and timers silently stop firing.
+ */
+struct watchdog_t {
+
+	/**
+	 * Destroy a watchdog_t.
+	 */
+	void (*destroy)(watchdog_t *this);
+};
+
+/**
+ * Create a watchdog instance.
+ *
+ * The watchdog schedules itself if the %ns.watchdog.interval setting is
+ * non-zero, it is dormant otherwise.
+ *
+ * @return				watchdog_t instance
+ */
+watchdog_t *watchdog_create();
+
+#endif /** WATCHDOG_H_ @}*/
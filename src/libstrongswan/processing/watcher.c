@@ -26,6 +26,10 @@
 #include <errno.h>
 #include <fcntl.h>
 
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
 typedef struct private_watcher_t private_watcher_t;
 
 /**
@@ -68,6 +72,13 @@ struct private_watcher_t {
 	 */
 	int notify[2];
 
+#ifdef HAVE_SYS_EPOLL_H
+	/**
+	 * epoll instance the FDs are registered with
+	 */
+	int epoll;
+#endif
+
 	/**
 	 * List of callback jobs to process by watcher thread, as job_t
 	 */
@@ -125,6 +136,36 @@ static void update(private_watcher_t *this)
 	}
 }
 
+#ifdef HAVE_SYS_EPOLL_H
+
+/**
+ * Register the events of an entry with epoll, using one-shot dispatch
+ */
+static void register_epoll(private_watcher_t *this, entry_t *entry, int op)
+{
+	struct epoll_event ev = {
+		.events = EPOLLONESHOT,
+		.data = { .fd = entry->fd, },
+	};
+
+	if (entry->events & WATCHER_READ)
+	{
+		ev.events |= EPOLLIN;
+	}
+	if (entry->events & WATCHER_WRITE)
+	{
+		ev.events |= EPOLLOUT;
+	}
+	/* EPOLLERR and EPOLLHUP are reported in any case */
+	if (epoll_ctl(this->epoll, op, entry->fd, &ev) != 0)
+	{
+		DBG1(DBG_JOB, "registering FD %d with epoll failed: %s",
+			 entry->fd, strerror(errno));
+	}
+}
+
+#endif /* HAVE_SYS_EPOLL_H */
+
 /**
  * Cleanup function if callback gets cancelled
  */
@@ -168,18 +209,29 @@ static void notify_end(notify_data_t *data)
 				entry->events &= ~data->event;
 				if (!entry->events)
 				{
+#ifdef HAVE_SYS_EPOLL_H
+					epoll_ctl(this->epoll, EPOLL_CTL_DEL, entry->fd, NULL);
+#endif
 					this->fds->remove_at(this->fds, enumerator);
 					free(entry);
 					break;
 				}
 			}
 			entry->in_callback--;
+#ifdef HAVE_SYS_EPOLL_H
+			if (!entry->in_callback)
+			{	/* re-arm the one-shot registration */
+				register_epoll(this, entry, EPOLL_CTL_MOD);
+			}
+#endif
 			break;
 		}
 	}
 	enumerator->destroy(enumerator);
 
+#ifndef HAVE_SYS_EPOLL_H
 	update(this);
+#endif
 	this->condvar->broadcast(this->condvar);
 	this->mutex->unlock(this->mutex);
 
@@ -237,6 +289,128 @@ static void activate_all(private_watcher_t *this)
 	this->mutex->unlock(this->mutex);
 }
 
+#ifdef HAVE_SYS_EPOLL_H
+
+/**
+ * Find the registered entry for an FD
+ */
+static entry_t *find_entry(private_watcher_t *this, int fd)
+{
+	enumerator_t *enumerator;
+	entry_t *entry, *found = NULL;
+
+	enumerator = this->fds->create_enumerator(this->fds);
+	while (enumerator->enumerate(enumerator, &entry))
+	{
+		if (entry->fd == fd)
+		{
+			found = entry;
+			break;
+		}
+	}
+	enumerator->destroy(enumerator);
+	return found;
+}
+
+/**
+ * Dispatching function, using epoll
+ *
+ * FDs stay registered with the kernel between iterations, so dispatch
+ * cost does not grow with the number of watched FDs. The one-shot
+ * registration disables an FD once an event fired until its callback
+ * completed and re-armed it, matching the temporarily disabled entries
+ * of the poll() based fallback.
+ */
+static job_requeue_t watch(private_watcher_t *this)
+{
+	struct epoll_event evs[16];
+	entry_t *entry;
+	job_t *job;
+	char buf[1];
+	bool old;
+	int count, i;
+
+	this->mutex->lock(this->mutex);
+	if (this->fds->get_count(this->fds) == 0)
+	{
+		this->state = WATCHER_STOPPED;
+		this->mutex->unlock(this->mutex);
+		return JOB_REQUEUE_NONE;
+	}
+	if (this->state == WATCHER_QUEUED)
+	{
+		this->state = WATCHER_RUNNING;
+	}
+	this->mutex->unlock(this->mutex);
+
+	DBG2(DBG_JOB, "watcher going to epoll_wait()");
+	thread_cleanup_push((void*)activate_all, this);
+	old = thread_cancelability(TRUE);
+
+	count = epoll_wait(this->epoll, evs, countof(evs), -1);
+
+	thread_cancelability(old);
+	thread_cleanup_pop(FALSE);
+
+	if (count < 0)
+	{
+		if (errno != EINTR)
+		{
+			DBG1(DBG_JOB, "watcher epoll_wait() error: %s", strerror(errno));
+		}
+		return JOB_REQUEUE_DIRECT;
+	}
+
+	this->mutex->lock(this->mutex);
+	for (i = 0; i < count; i++)
+	{
+		if (evs[i].data.fd == this->notify[0])
+		{
+			while (read(this->notify[0], buf, sizeof(buf)) != -1)
+			{
+				/* drain notifications */
+			}
+			this->pending = FALSE;
+			continue;
+		}
+		entry = find_entry(this, evs[i].data.fd);
+		if (!entry || entry->in_callback)
+		{	/* removed or disabled in the meantime */
+			continue;
+		}
+		if (evs[i].events & (EPOLLERR | EPOLLHUP) &&
+			entry->events & WATCHER_EXCEPT)
+		{
+			DBG2(DBG_JOB, "watched FD %d has exception", entry->fd);
+			notify(this, entry, WATCHER_EXCEPT);
+		}
+		else
+		{
+			if (evs[i].events & (EPOLLIN | EPOLLHUP) &&
+				entry->events & WATCHER_READ)
+			{
+				DBG2(DBG_JOB, "watched FD %d ready to read", entry->fd);
+				notify(this, entry, WATCHER_READ);
+			}
+			if (evs[i].events & (EPOLLOUT | EPOLLHUP) &&
+				entry->events & WATCHER_WRITE)
+			{
+				DBG2(DBG_JOB, "watched FD %d ready to write", entry->fd);
+				notify(this, entry, WATCHER_WRITE);
+			}
+		}
+	}
+	this->mutex->unlock(this->mutex);
+
+	while (this->jobs->remove_first(this->jobs, (void**)&job) == SUCCESS)
+	{
+		lib->processor->execute_job(lib->processor, job);
+	}
+	return JOB_REQUEUE_DIRECT;
+}
+
+#else /* !HAVE_SYS_EPOLL_H */
+
 /**
  * Find flagged revents in a pollfd set by fd
  */
@@ -425,6 +599,8 @@ static job_requeue_t watch(private_watcher_t *this)
 	return JOB_REQUEUE_DIRECT;
 }
 
+#endif /* HAVE_SYS_EPOLL_H */
+
 METHOD(watcher_t, add, void,
 	private_watcher_t *this, int fd, watcher_event_t events,
 	watcher_cb_t cb, void *data)
@@ -440,6 +616,9 @@ METHOD(watcher_t, add, void,
 
 	this->mutex->lock(this->mutex);
 	this->fds->insert_last(this->fds, entry);
+#ifdef HAVE_SYS_EPOLL_H
+	register_epoll(this, entry, EPOLL_CTL_ADD);
+#endif
 	if (this->state == WATCHER_STOPPED)
 	{
 		this->state = WATCHER_QUEUED;
@@ -447,10 +626,12 @@ METHOD(watcher_t, add, void,
 			(job_t*)callback_job_create_with_prio((void*)watch, this,
 				NULL, (callback_job_cancel_t)return_false, JOB_PRIO_CRITICAL));
 	}
+#ifndef HAVE_SYS_EPOLL_H
 	else
 	{
 		update(this);
 	}
+#endif
 	this->mutex->unlock(this->mutex);
 }
 
@@ -461,6 +642,9 @@ METHOD(watcher_t, remove_, void,
 	entry_t *entry;
 
 	this->mutex->lock(this->mutex);
+#ifdef HAVE_SYS_EPOLL_H
+	epoll_ctl(this->epoll, EPOLL_CTL_DEL, fd, NULL);
+#endif
 	while (TRUE)
 	{
 		bool is_in_callback = FALSE;
@@ -517,6 +701,12 @@ METHOD(watcher_t, destroy, void,
 	{
 		close(this->notify[1]);
 	}
+#ifdef HAVE_SYS_EPOLL_H
+	if (this->epoll != -1)
+	{
+		close(this->epoll);
+	}
+#endif
 	this->jobs->destroy(this->jobs);
 	free(this);
 }
@@ -591,10 +781,30 @@ watcher_t *watcher_create()
 		.state = WATCHER_STOPPED,
 	);
 
+#ifdef HAVE_SYS_EPOLL_H
+	this->epoll = epoll_create1(EPOLL_CLOEXEC);
+	if (this->epoll == -1)
+	{
+		DBG1(DBG_LIB, "creating watcher epoll instance failed: %s",
+			 strerror(errno));
+	}
+#endif
+
 	if (!create_notify(this))
 	{
 		DBG1(DBG_LIB, "creating watcher notify pipe failed: %s",
 			 strerror(errno));
 	}
+#ifdef HAVE_SYS_EPOLL_H
+	else if (this->epoll != -1)
+	{
+		struct epoll_event ev = {
+			.events = EPOLLIN,
+			.data = { .fd = this->notify[0], },
+		};
+
+		epoll_ctl(this->epoll, EPOLL_CTL_ADD, this->notify[0], &ev);
+	}
+#endif
 	return &this->public;
 }
@@ -60,6 +60,11 @@ struct private_traffic_selector_t {
 	 */
 	bool dynamic;
 
+	/**
+	 * reference counter
+	 */
+	refcount_t refcount;
+
 	/**
 	 * subnet size in CIDR notation, 255 means a non-subnet address range
 	 */
@@ -696,10 +701,20 @@ METHOD(traffic_selector_t, hash, u_int,
 				hash)))));
 }
 
+METHOD(traffic_selector_t, get_ref, traffic_selector_t*,
+	private_traffic_selector_t *this)
+{
+	ref_get(&this->refcount);
+	return &this->public;
+}
+
 METHOD(traffic_selector_t, destroy, void,
 	private_traffic_selector_t *this)
 {
-	free(this);
+	if (ref_put(&this->refcount))
+	{
+		free(this);
+	}
 }
 
 /**
@@ -986,12 +1001,14 @@ static private_traffic_selector_t *traffic_selector_create(u_int8_t protocol,
 			.to_subnet = _to_subnet,
 			.clone = _clone_,
 			.hash = _hash,
+			.get_ref = _get_ref,
 			.destroy = _destroy,
 		},
 		.from_port = from_port,
 		.to_port = to_port,
 		.protocol = protocol,
 		.type = type,
+		.refcount = 1,
 	);
 	if (protocol == IPPROTO_ICMP || protocol == IPPROTO_ICMPV6)
 	{
@@ -229,7 +229,17 @@ struct traffic_selector_t {
 	u_int (*hash)(traffic_selector_t *this, u_int inc);
 
 	/**
-	 * Destroys the ts object
+	 * Get an additional reference to this traffic selector.
+	 *
+	 * The traffic selector must not get modified while multiple references
+	 * exist, use clone() before calling set_address().
+	 *
+	 * @return			this, with an increased refcount
+	 */
+	traffic_selector_t* (*get_ref)(traffic_selector_t *this);
+
+	/**
+	 * Destroys the ts object, or releases a reference to it
 	 */
 	void (*destroy) (traffic_selector_t *this);
 };
@@ -31,15 +31,42 @@
 #include "collections/array.h"
 #include "collections/hashtable.h"
 #include "collections/linked_list.h"
+#include "bio/bio_reader.h"
+#include "bio/bio_writer.h"
 #include "threading/rwlock.h"
 #include "utils/debug.h"
+#include "utils/parser_helper.h"
 
 typedef struct private_settings_t private_settings_t;
+typedef struct snapshot_t snapshot_t;
 
 /**
- * Parse function provided by the generated parser.
+ * Parse functions provided by the generated parser.
  */
 bool settings_parser_parse_file(section_t *root, char *name);
+bool settings_parser_parse_file_tracked(section_t *root, char *name,
+										parser_helper_t **helperp);
+
+static void update_snapshot(private_settings_t *this);
+
+/**
+ * Maximum length of a fully expanded key in a snapshot
+ */
+#define SNAPSHOT_KEY_LEN 512
+
+/**
+ * Immutable flattened snapshot of the section tree, queried by lock-free
+ * readers. A new snapshot is published whenever the tree changes.
+ */
+struct snapshot_t {
+
+	/**
+	 * Full dotted keys (char*, owned) mapped to live kv values (char*, not
+	 * owned). The values stay valid after modifications, as replaced strings
+	 * are retired to the contents array.
+	 */
+	hashtable_t *map;
+};
 
 /**
  * Private data of settings
@@ -64,6 +91,17 @@ struct private_settings_t {
 	 */
 	array_t *contents;
 
+	/**
+	 * Current snapshot of the section tree, readable without the lock
+	 */
+	snapshot_t *snapshot;
+
+	/**
+	 * Retired snapshots, kept around as lock-free readers may still look
+	 * up a snapshot published before a modification
+	 */
+	array_t *old_snapshots;
+
 	/**
 	 * Lock to safely access the settings
 	 */
@@ -316,6 +354,7 @@ static void add_fallback_to_section(private_settings_t *this,
 			fallback->fallbacks = array_create(0, 0);
 		}
 		array_insert_create(&found->fallbacks, ARRAY_TAIL, fallback);
+		update_snapshot(this);
 	}
 	this->lock->unlock(this->lock);
 }
@@ -404,6 +443,158 @@ static kv_t *find_value_buffered(section_t *section, char *start, char *key,
 	return kv;
 }
 
+/**
+ * Destroy a snapshot with its owned keys
+ */
+static void snapshot_destroy(snapshot_t *snap)
+{
+	enumerator_t *enumerator;
+	char *key;
+
+	enumerator = snap->map->create_enumerator(snap->map);
+	while (enumerator->enumerate(enumerator, &key, NULL))
+	{
+		free(key);
+	}
+	enumerator->destroy(enumerator);
+	snap->map->destroy(snap->map);
+	free(snap);
+}
+
+/**
+ * Insert a key/value pair into a snapshot, unless the key is present already.
+ * The value pointer is shared with the section tree, so lookups return the
+ * identical pointer as the locked path does.
+ */
+static void snapshot_put(snapshot_t *snap, char *key, char *value)
+{
+	if (!snap->map->get(snap->map, key))
+	{
+		snap->map->put(snap->map, strdup(key), value);
+	}
+}
+
+/**
+ * Add all keys below a section to a snapshot, recursing into subsections
+ * and fallbacks. The locked resolution consults fallbacks only after own
+ * entries at each level, which insertion order replicates as existing
+ * entries are never replaced.
+ */
+static void snapshot_add_section(snapshot_t *snap, section_t *section,
+								 char *buf, int len, int prefix)
+{
+	section_t *sub;
+	kv_t *kv;
+	int i;
+
+	for (i = 0; i < array_count(section->kv); i++)
+	{
+		array_get(section->kv, i, &kv);
+		if (kv->value &&
+			snprintf(buf + prefix, len - prefix, "%s", kv->key) < len - prefix)
+		{
+			snapshot_put(snap, buf, kv->value);
+		}
+	}
+	for (i = 0; i < array_count(section->sections); i++)
+	{
+		array_get(section->sections, i, &sub);
+		if (snprintf(buf + prefix, len - prefix, "%s.", sub->name) <
+															len - prefix)
+		{
+			snapshot_add_section(snap, sub, buf, len,
+								 prefix + strlen(sub->name) + 1);
+		}
+	}
+	for (i = 0; i < array_count(section->fallbacks); i++)
+	{
+		array_get(section->fallbacks, i, &sub);
+		snapshot_add_section(snap, sub, buf, len, prefix);
+	}
+}
+
+/**
+ * Publish a new snapshot of the section tree (requires the write lock).
+ * Lock-free readers rely on the barrier implied by cas_ptr(). The retired
+ * snapshot is kept around as readers may still look it up concurrently.
+ */
+static void update_snapshot(private_settings_t *this)
+{
+	char buf[SNAPSHOT_KEY_LEN];
+	snapshot_t *snap, *old;
+
+	INIT(snap,
+		.map = hashtable_create(hashtable_hash_str, hashtable_equals_str, 64),
+	);
+	snapshot_add_section(snap, this->top, buf, sizeof(buf), 0);
+	old = this->snapshot;
+	cas_ptr(&this->snapshot, old, snap);
+	if (old)
+	{
+		array_insert_create(&this->old_snapshots, ARRAY_TAIL, old);
+	}
+}
+
+/**
+ * Expand and normalize a full key into buf, dropping empty path segments
+ * the way per-segment resolution does. Returns FALSE if the key contains
+ * format specifiers or path segments a snapshot can't represent, requiring
+ * the locked slow path.
+ */
+static bool expand_key(char *key, va_list args, char *buf, int len)
+{
+	char tmp[SNAPSHOT_KEY_LEN], *pos, *src;
+	va_list copy;
+	int used = 0, written;
+
+	pos = key;
+	while ((pos = strchr(pos, '%')) != NULL)
+	{
+		pos++;
+		if (*pos != 's' && *pos != 'd' && *pos != '%')
+		{
+			return FALSE;
+		}
+		pos++;
+	}
+	va_copy(copy, args);
+	written = vsnprintf(tmp, sizeof(tmp), key, copy);
+	va_end(copy);
+	if (written < 0 || written >= sizeof(tmp))
+	{
+		return FALSE;
+	}
+	src = tmp;
+	while (TRUE)
+	{
+		pos = strchr(src, '.');
+		if (pos)
+		{
+			*pos = '\0';
+		}
+		if (strlen(src))
+		{
+			written = snprintf(buf + used, len - used, "%s%s",
+							   used ? "." : "", src);
+			if (written >= len - used)
+			{
+				return FALSE;
+			}
+			used += written;
+		}
+		else if (!pos)
+		{	/* trailing empty segment, let the slow path handle it */
+			return FALSE;
+		}
+		if (!pos)
+		{
+			break;
+		}
+		src = pos + 1;
+	}
+	return TRUE;
+}
+
 /**
  * Find the string value for a key (thread-safe).
  */
@@ -411,8 +602,17 @@ static char *find_value(private_settings_t *this, section_t *section,
 						char *key, va_list args)
 {
 	char buf[128], keybuf[512], *value = NULL;
+	snapshot_t *snap;
 	kv_t *kv;
 
+	/* try the current snapshot first, a lock-free lookup. A stale snapshot
+	 * read concurrently to a writer is as good as a lookup right before the
+	 * modification. */
+	snap = this->snapshot;
+	if (snap && expand_key(key, args, keybuf, sizeof(keybuf)))
+	{
+		return snap->map->get(snap->map, keybuf);
+	}
 	if (snprintf(keybuf, sizeof(keybuf), "%s", key) >= sizeof(keybuf))
 	{
 		return NULL;
@@ -447,6 +647,7 @@ static void set_value(private_settings_t *this, section_t *section,
 	if (kv)
 	{
 		settings_kv_set(kv, strdupnull(value), this->contents);
+		update_snapshot(this);
 	}
 	this->lock->unlock(this->lock);
 }
@@ -842,6 +1043,273 @@ METHOD(settings_t, add_fallback, void,
 	va_end(args);
 }
 
+/**
+ * Magic and version identifying a compiled settings cache file
+ */
+#define CACHE_MAGIC 0x73777363
+#define CACHE_VERSION 1
+
+/**
+ * Duplicate a string stored in a cache file
+ */
+static char *cache_strdup(chunk_t chunk)
+{
+	char *str;
+
+	str = malloc(chunk.len + 1);
+	memcpy(str, chunk.ptr, chunk.len);
+	str[chunk.len] = '\0';
+	return str;
+}
+
+/**
+ * Serialize the given section with all key/value pairs and subsections
+ */
+static void cache_write_section(bio_writer_t *writer, section_t *section)
+{
+	enumerator_t *enumerator;
+	section_t *sub;
+	kv_t *kv;
+	u_int32_t count = 0;
+
+	enumerator = array_create_enumerator(section->kv_order);
+	while (enumerator->enumerate(enumerator, &kv))
+	{
+		if (kv->value)
+		{
+			count++;
+		}
+	}
+	enumerator->destroy(enumerator);
+	writer->write_uint32(writer, count);
+
+	enumerator = array_create_enumerator(section->kv_order);
+	while (enumerator->enumerate(enumerator, &kv))
+	{
+		if (kv->value)
+		{
+			writer->write_data16(writer, chunk_from_str(kv->key));
+			writer->write_data32(writer, chunk_from_str(kv->value));
+		}
+	}
+	enumerator->destroy(enumerator);
+
+	writer->write_uint32(writer, array_count(section->sections_order));
+	enumerator = array_create_enumerator(section->sections_order);
+	while (enumerator->enumerate(enumerator, &sub))
+	{
+		writer->write_data16(writer, chunk_from_str(sub->name));
+		cache_write_section(writer, sub);
+	}
+	enumerator->destroy(enumerator);
+}
+
+/**
+ * Deserialize a section written by cache_write_section()
+ */
+static bool cache_read_section(bio_reader_t *reader, section_t *section)
+{
+	section_t *sub;
+	chunk_t name, value;
+	u_int32_t count;
+
+	if (!reader->read_uint32(reader, &count))
+	{
+		return FALSE;
+	}
+	while (count--)
+	{
+		if (!reader->read_data16(reader, &name) ||
+			!reader->read_data32(reader, &value))
+		{
+			return FALSE;
+		}
+		settings_kv_add(section, settings_kv_create(cache_strdup(name),
+													cache_strdup(value)), NULL);
+	}
+	if (!reader->read_uint32(reader, &count))
+	{
+		return FALSE;
+	}
+	while (count--)
+	{
+		if (!reader->read_data16(reader, &name))
+		{
+			return FALSE;
+		}
+		sub = settings_section_create(cache_strdup(name));
+		settings_section_add(section, sub, NULL);
+		if (!cache_read_section(reader, sub))
+		{
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/**
+ * Write a compiled representation of the given parsed section tree, keyed
+ * by the include patterns and the mtime/size of every file that
+ * contributed to it.
+ */
+static void cache_save(char *file, char *pattern, parser_helper_t *helper,
+					   section_t *section)
+{
+	bio_writer_t *writer;
+	enumerator_t *includes, *names;
+	array_t *matched;
+	struct stat st;
+	char *pat, *name, *scope;
+	u_int32_t count = 0;
+	bool failed = FALSE;
+
+	writer = bio_writer_create(0);
+	writer->write_uint32(writer, CACHE_MAGIC);
+	writer->write_uint32(writer, CACHE_VERSION);
+	writer->write_data16(writer, chunk_from_str(pattern));
+
+	includes = helper->create_include_enumerator(helper);
+	while (includes->enumerate(includes, &pat, &matched, &scope))
+	{
+		count++;
+	}
+	includes->destroy(includes);
+	writer->write_uint32(writer, count);
+
+	includes = helper->create_include_enumerator(helper);
+	while (!failed && includes->enumerate(includes, &pat, &matched, &scope))
+	{
+		writer->write_data16(writer, chunk_from_str(pat));
+		writer->write_uint32(writer, array_count(matched));
+		names = array_create_enumerator(matched);
+		while (names->enumerate(names, &name))
+		{
+			if (stat(name, &st) != 0)
+			{	/* the file vanished since parsing it, don't cache */
+				failed = TRUE;
+				break;
+			}
+			writer->write_data16(writer, chunk_from_str(name));
+			writer->write_uint64(writer, st.st_mtime);
+			writer->write_uint64(writer, st.st_size);
+		}
+		names->destroy(names);
+	}
+	includes->destroy(includes);
+
+	if (!failed)
+	{
+		cache_write_section(writer, section);
+		if (!chunk_write(writer->get_buf(writer), file, 0022, TRUE))
+		{
+			DBG1(DBG_CFG, "writing settings cache '%s' failed: %s", file,
+				 strerror(errno));
+		}
+	}
+	writer->destroy(writer);
+}
+
+/**
+ * Check that the files currently matching the given include pattern are
+ * exactly the recorded ones, with unchanged mtimes and sizes.
+ */
+static bool cache_check_pattern(bio_reader_t *reader, chunk_t pattern)
+{
+	enumerator_t *matches;
+	char pat[PATH_MAX], *name;
+	chunk_t cached;
+	u_int64_t mtime, size;
+	u_int32_t count;
+	struct stat st;
+	bool valid = TRUE;
+
+	if (!reader->read_uint32(reader, &count) ||
+		snprintf(pat, sizeof(pat), "%.*s", (int)pattern.len,
+				 pattern.ptr) >= sizeof(pat))
+	{
+		return FALSE;
+	}
+	matches = enumerator_create_glob(pat);
+	if (!matches)
+	{	/* mirror the fallback the parser uses without glob(3) */
+		matches = enumerator_create_single(strdup(pat), free);
+	}
+	while (valid && matches->enumerate(matches, &name, NULL))
+	{
+		if (stat(name, &st) != 0)
+		{	/* as above, the fallback yields the pattern itself, which does
+			 * not necessarily exist */
+			continue;
+		}
+		valid = count-- &&
+				reader->read_data16(reader, &cached) &&
+				reader->read_uint64(reader, &mtime) &&
+				reader->read_uint64(reader, &size) &&
+				chunk_equals(cached, chunk_from_str(name)) &&
+				mtime == (u_int64_t)st.st_mtime &&
+				size == (u_int64_t)st.st_size;
+	}
+	matches->destroy(matches);
+	return valid && count == 0;
+}
+
+/**
+ * Try to load the section tree from a compiled settings cache. Fails if
+ * the cache is missing or malformed, was written for a different config
+ * file, or any file matching one of the recorded include patterns was
+ * added, removed or changed since it was written.
+ */
+static bool cache_load(private_settings_t *this, char *file, char *pattern)
+{
+	bio_reader_t *reader;
+	section_t *section;
+	chunk_t *map, data;
+	u_int32_t magic, version, count;
+	bool success = FALSE;
+
+	map = chunk_map(file, FALSE);
+	if (!map)
+	{
+		return FALSE;
+	}
+	reader = bio_reader_create(*map);
+	if (reader->read_uint32(reader, &magic) && magic == CACHE_MAGIC &&
+		reader->read_uint32(reader, &version) && version == CACHE_VERSION &&
+		reader->read_data16(reader, &data) &&
+		chunk_equals(data, chunk_from_str(pattern)) &&
+		reader->read_uint32(reader, &count))
+	{
+		success = TRUE;
+		while (success && count--)
+		{
+			success = reader->read_data16(reader, &data) &&
+					  cache_check_pattern(reader, data);
+		}
+		if (success)
+		{
+			section = settings_section_create(NULL);
+			if (cache_read_section(reader, section) &&
+				!reader->remaining(reader))
+			{
+				this->lock->write_lock(this->lock);
+				settings_section_extend(this->top, section, this->contents,
+										TRUE);
+				update_snapshot(this);
+				this->lock->unlock(this->lock);
+				DBG2(DBG_CFG, "loaded settings from cache '%s'", file);
+			}
+			else
+			{
+				success = FALSE;
+			}
+			settings_section_destroy(section, NULL);
+		}
+	}
+	reader->destroy(reader);
+	chunk_unmap(map);
+	return success;
+}
+
 /**
  * Load settings from files matching the given file pattern.
  * All sections and values are added relative to "parent".
@@ -868,6 +1336,35 @@ static bool load_files_internal(private_settings_t *this, section_t *parent,
 
 	this->lock->write_lock(this->lock);
 	settings_section_extend(parent, section, this->contents, !merge);
+	update_snapshot(this);
+	this->lock->unlock(this->lock);
+
+	settings_section_destroy(section, NULL);
+	return TRUE;
+}
+
+/**
+ * As load_files_internal(), but additionally write a compiled settings
+ * cache for the parsed files to the given cache file.
+ */
+static bool load_files_cached(private_settings_t *this, char *cache,
+							  char *pattern)
+{
+	parser_helper_t *helper;
+	section_t *section;
+
+	section = settings_section_create(NULL);
+	if (!settings_parser_parse_file_tracked(section, pattern, &helper))
+	{
+		settings_section_destroy(section, NULL);
+		return FALSE;
+	}
+	cache_save(cache, pattern, helper, section);
+	helper->destroy(helper);
+
+	this->lock->write_lock(this->lock);
+	settings_section_extend(this->top, section, this->contents, TRUE);
+	update_snapshot(this);
 	this->lock->unlock(this->lock);
 
 	settings_section_destroy(section, NULL);
@@ -902,6 +1399,11 @@ METHOD(settings_t, destroy, void,
 {
 	settings_section_destroy(this->top, NULL);
 	array_destroy_function(this->contents, (void*)free, NULL);
+	if (this->snapshot)
+	{
+		snapshot_destroy(this->snapshot);
+	}
+	array_destroy_function(this->old_snapshots, (void*)snapshot_destroy, NULL);
 	this->lock->destroy(this->lock);
 	free(this);
 }
@@ -912,6 +1414,7 @@ METHOD(settings_t, destroy, void,
 settings_t *settings_create(char *file)
 {
 	private_settings_t *this;
+	char *cache;
 
 	INIT(this,
 		.public = {
@@ -935,10 +1438,25 @@ settings_t *settings_create(char *file)
 		},
 		.top = settings_section_create(NULL),
 		.contents = array_create(0, 0),
-		.lock = rwlock_create(RWLOCK_TYPE_DEFAULT),
+		.lock = rwlock_create(RWLOCK_TYPE_READ_BIASED),
 	);
 
-	load_files(this, file, FALSE);
+	cache = getenv("STRONGSWAN_CONF_CACHE");
+	if (!file || !file[0] || !cache || !cache[0])
+	{
+		load_files(this, file, FALSE);
+	}
+	else if (!cache_load(this, cache, file))
+	{
+		load_files_cached(this, cache, file);
+	}
+
+	if (!this->snapshot)
+	{	/* no files loaded, make the empty tree queryable without the lock */
+		this->lock->write_lock(this->lock);
+		update_snapshot(this);
+		this->lock->unlock(this->lock);
+	}
 
 	return &this->public;
 }
@@ -343,6 +343,11 @@ struct settings_t {
 /**
  * Load settings from a file.
  *
+ * If the STRONGSWAN_CONF_CACHE environment variable points to a file, a
+ * compiled representation of the parsed settings is maintained there and
+ * loaded instead of parsing the config files, as long as none of them
+ * (including globbed ones) was added, removed or modified.
+ *
  * @note If parsing the file fails the object is still created.
  *
  * @param file			optional file to read settings from
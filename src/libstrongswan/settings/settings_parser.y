@@ -237,11 +237,41 @@ static void add_setting(parser_helper_t *ctx, kv_t *kv)
 	settings_kv_add(section, kv, NULL);
 }
 
+/**
+ * Describe the current scope as dotted section path, e.g. "charon.plugins"
+ * (empty string at the top level). Registered as get_scope callback so the
+ * helper can record where include patterns were processed.
+ */
+static char *get_scope(const void *context)
+{
+	array_t *sections = (array_t*)context;
+	section_t *section;
+	char buf[512];
+	size_t len = 0;
+	int i;
+
+	buf[0] = '\0';
+	for (i = 1; i < array_count(sections); i++)
+	{
+		array_get(sections, i, &section);
+		len += snprintf(buf + len, sizeof(buf) - len, "%s%s",
+						len ? "." : "", section->name);
+		if (len >= sizeof(buf))
+		{
+			return NULL;
+		}
+	}
+	return strdup(buf);
+}
+
 /**
  * Parse the given file and add all sections and key/value pairs to the
- * given section.
+ * given section. If helperp is given, the parser helper is handed to the
+ * caller on success, instead of getting destroyed, so that the processed
+ * include patterns and files may be inspected.
  */
-bool settings_parser_parse_file(section_t *root, char *name)
+bool settings_parser_parse_file_tracked(section_t *root, char *name,
+										parser_helper_t **helperp)
 {
 	parser_helper_t *helper;
 	array_t *sections = NULL;
@@ -250,6 +280,7 @@ bool settings_parser_parse_file(section_t *root, char *name)
 	array_insert_create(&sections, ARRAY_TAIL, root);
 	helper = parser_helper_create(sections);
 	helper->get_lineno = settings_parser_get_lineno;
+	helper->get_scope = get_scope;
 	if (settings_parser_lex_init_extra(helper, &helper->scanner) != 0)
 	{
 		helper->destroy(helper);
@@ -283,6 +314,22 @@ bool settings_parser_parse_file(section_t *root, char *name)
 	}
 	array_destroy(sections);
 	settings_parser_lex_destroy(helper->scanner);
-	helper->destroy(helper);
+	if (success && helperp)
+	{
+		*helperp = helper;
+	}
+	else
+	{
+		helper->destroy(helper);
+	}
 	return success;
 }
+
+/**
+ * Parse the given file and add all sections and key/value pairs to the
+ * given section.
+ */
+bool settings_parser_parse_file(section_t *root, char *name)
+{
+	return settings_parser_parse_file_tracked(root, name, NULL);
+}
@@ -0,0 +1,345 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Hochschule fuer Technik Rapperswil
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include "settings_watcher.h"
+
+#include <library.h>
+#include <utils/debug.h>
+#include <utils/parser_helper.h>
+#include <settings/settings_types.h>
+#include <collections/array.h>
+
+#ifdef HAVE_SYS_INOTIFY_H
+
+#include <sys/inotify.h>
+#include <fnmatch.h>
+#include <limits.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+/**
+ * Defined in settings_parser.y
+ */
+bool settings_parser_parse_file_tracked(section_t *root, char *name,
+										parser_helper_t **helperp);
+
+typedef struct private_settings_watcher_t private_settings_watcher_t;
+
+struct private_settings_watcher_t {
+
+	/**
+	 * Public interface.
+	 */
+	settings_watcher_t public;
+
+	/**
+	 * Settings changed files get merged into.
+	 */
+	settings_t *settings;
+
+	/**
+	 * Root configuration file.
+	 */
+	char *file;
+
+	/**
+	 * inotify file descriptor, registered with lib->watcher.
+	 */
+	int fd;
+
+	/**
+	 * Watched directories, as dir_entry_t.
+	 */
+	array_t *dirs;
+
+	/**
+	 * Known configuration files, as target_entry_t.
+	 */
+	array_t *files;
+
+	/**
+	 * Processed include patterns, as target_entry_t.
+	 */
+	array_t *patterns;
+};
+
+typedef struct {
+	/** inotify watch descriptor */
+	int wd;
+	/** watched directory */
+	char *dir;
+} dir_entry_t;
+
+typedef struct {
+	/** file path, or glob pattern for pattern entries */
+	char *path;
+	/** dotted section path the file gets merged into, "" for the top level */
+	char *scope;
+} target_entry_t;
+
+/**
+ * Destroy the given directory entry.
+ */
+static void dir_entry_destroy(dir_entry_t *this)
+{
+	free(this->dir);
+	free(this);
+}
+
+/**
+ * Destroy the given file/pattern entry.
+ */
+static void target_entry_destroy(target_entry_t *this)
+{
+	free(this->path);
+	free(this->scope);
+	free(this);
+}
+
+/**
+ * Watch the given directory, unless we do already.
+ */
+static void watch_dir(private_settings_watcher_t *this, char *dir)
+{
+	dir_entry_t *entry;
+	int i, wd;
+
+	for (i = 0; i < array_count(this->dirs); i++)
+	{
+		array_get(this->dirs, i, &entry);
+		if (streq(entry->dir, dir))
+		{
+			return;
+		}
+	}
+	wd = inotify_add_watch(this->fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+	if (wd == -1)
+	{
+		DBG1(DBG_CFG, "watching config directory '%s' failed: %s", dir,
+			 strerror(errno));
+		return;
+	}
+	INIT(entry,
+		.wd = wd,
+		.dir = strdup(dir),
+	);
+	array_insert_create(&this->dirs, ARRAY_TAIL, entry);
+	DBG2(DBG_CFG, "watching config directory '%s'", dir);
+}
+
+/**
+ * Track the given file or pattern and watch the directory containing it.
+ */
+static void add_target(private_settings_watcher_t *this, array_t **targets,
+					   char *path, char *scope)
+{
+	target_entry_t *target;
+	char *dir;
+
+	INIT(target,
+		.path = strdup(path),
+		.scope = strdup(scope ? scope : ""),
+	);
+	array_insert_create(targets, ARRAY_TAIL, target);
+
+	dir = path_dirname(path);
+	watch_dir(this, dir);
+	free(dir);
+}
+
+/**
+ * Resolve the files and include patterns making up the config tree by
+ * parsing the root file into a throwaway section.
+ */
+static void discover(private_settings_watcher_t *this)
+{
+	section_t *root;
+	parser_helper_t *helper;
+	enumerator_t *includes, *names;
+	array_t *matched;
+	char *pattern, *name, *scope;
+
+	add_target(this, &this->files, this->file, "");
+
+	root = settings_section_create(NULL);
+	if (!settings_parser_parse_file_tracked(root, this->file, &helper))
+	{
+		settings_section_destroy(root, NULL);
+		return;
+	}
+	includes = helper->create_include_enumerator(helper);
+	while (includes->enumerate(includes, &pattern, &matched, &scope))
+	{
+		add_target(this, &this->patterns, pattern, scope);
+		names = array_create_enumerator(matched);
+		while (names->enumerate(names, &name))
+		{
+			add_target(this, &this->files, name, scope);
+		}
+		names->destroy(names);
+	}
+	includes->destroy(includes);
+	helper->destroy(helper);
+	settings_section_destroy(root, NULL);
+}
+
+/**
+ * Re-parse a single changed file and merge it into its section.
+ */
+static void reload_file(private_settings_watcher_t *this, char *path,
+						char *scope)
+{
+	bool success;
+
+	DBG1(DBG_CFG, "config file '%s' changed, reloading", path);
+	if (scope[0])
+	{
+		success = this->settings->load_files_section(this->settings, path,
+													 TRUE, "%s", scope);
+	}
+	else
+	{
+		success = this->settings->load_files(this->settings, path, TRUE);
+	}
+	if (!success)
+	{
+		DBG1(DBG_CFG, "reloading config file '%s' failed, keeping old", path);
+	}
+}
+
+/**
+ * Handle a change notification for a file in a watched directory.
+ */
+static void handle_change(private_settings_watcher_t *this, int wd, char *name)
+{
+	target_entry_t *target;
+	dir_entry_t *entry;
+	char path[PATH_MAX], *dir = NULL;
+	int i;
+
+	for (i = 0; i < array_count(this->dirs); i++)
+	{
+		array_get(this->dirs, i, &entry);
+		if (entry->wd == wd)
+		{
+			dir = entry->dir;
+			break;
+		}
+	}
+	if (!dir || snprintf(path, sizeof(path), "%s%s%s", dir,
+						 DIRECTORY_SEPARATOR, name) >= sizeof(path))
+	{
+		return;
+	}
+	for (i = 0; i < array_count(this->files); i++)
+	{
+		array_get(this->files, i, &target);
+		if (streq(target->path, path))
+		{
+			reload_file(this, path, target->scope);
+			return;
+		}
+	}
+	for (i = 0; i < array_count(this->patterns); i++)
+	{
+		array_get(this->patterns, i, &target);
+		if (fnmatch(target->path, path, FNM_PATHNAME) == 0)
+		{	/* a new file matching an include pattern appeared */
+			reload_file(this, path, target->scope);
+			return;
+		}
+	}
+}
+
+CALLBACK(handle_events, bool,
+	private_settings_watcher_t *this, int fd, watcher_event_t event)
+{
+	char buf[sizeof(struct inotify_event) + NAME_MAX + 1]
+			 __attribute__((aligned(__alignof__(struct inotify_event))));
+	struct inotify_event *ev;
+	ssize_t len;
+	size_t pos;
+
+	while (TRUE)
+	{
+		len = read(fd, buf, sizeof(buf));
+		if (len <= 0)
+		{	/* EAGAIN, or nothing more to read */
+			return TRUE;
+		}
+		for (pos = 0; pos < len; pos += sizeof(*ev) + ev->len)
+		{
+			ev = (struct inotify_event*)(buf + pos);
+			if (ev->len)
+			{
+				handle_change(this, ev->wd, ev->name);
+			}
+		}
+	}
+}
+
+METHOD(settings_watcher_t, destroy, void,
+	private_settings_watcher_t *this)
+{
+	lib->watcher->remove(lib->watcher, this->fd);
+	close(this->fd);
+	array_destroy_function(this->dirs, (void*)dir_entry_destroy, NULL);
+	array_destroy_function(this->files, (void*)target_entry_destroy, NULL);
+	array_destroy_function(this->patterns, (void*)target_entry_destroy, NULL);
+	free(this->file);
+	free(this);
+}
+
+/*
+ * Described in header
+ */
+settings_watcher_t *settings_watcher_create(settings_t *settings, char *file)
+{
+	private_settings_watcher_t *this;
+
+	INIT(this,
+		.public = {
+			.destroy = _destroy,
+		},
+		.settings = settings,
+		.file = strdup(file),
+		.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC),
+	);
+	if (this->fd == -1)
+	{
+		DBG1(DBG_CFG, "creating inotify instance failed: %s", strerror(errno));
+		free(this->file);
+		free(this);
+		return NULL;
+	}
+	discover(this);
+	lib->watcher->add(lib->watcher, this->fd, WATCHER_READ,
+					  handle_events, this);
+	return &this->public;
+}
+
+#else /* !HAVE_SYS_INOTIFY_H */
+
+/*
+ * Described in header
+ */
+settings_watcher_t *settings_watcher_create(settings_t *settings, char *file)
+{
+	DBG1(DBG_CFG, "config file watching unavailable, inotify not supported");
+	return NULL;
+}
+
+#endif /* HAVE_SYS_INOTIFY_H */
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Hochschule fuer Technik Rapperswil
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/**
+ * @defgroup settings_watcher settings_watcher
+ * @{ @ingroup settings
+ */
+
+#ifndef SETTINGS_WATCHER_H_
+#define SETTINGS_WATCHER_H_
+
+typedef struct settings_watcher_t settings_watcher_t;
+
+#include <settings/settings.h>
+
+/**
+ * Monitor a settings file tree for changes and reload files incrementally.
+ *
+ * The watcher resolves all files included from the given root file and
+ * registers inotify watches on the directories containing them, as well as on
+ * the directories of include patterns, so that newly dropped files matching a
+ * pattern get picked up. When a file changes, only that file is re-parsed and
+ * merged into the section it was included in, avoiding a full re-parse of the
+ * whole tree.
+ *
+ * As changed files are merged, settings removed from a file keep their
+ * previous value until a full reload (e.g. via SIGHUP). The same applies to
+ * include statements added to already loaded files, which get processed but
+ * not watched until the tree is re-resolved.
+ */
+struct settings_watcher_t {
+
+	/**
+	 * Destroy a settings_watcher_t.
+	 */
+	void (*destroy)(settings_watcher_t *this);
+};
+
+/**
+ * Create a watcher reloading changed files below the given root config file.
+ *
+ * The file descriptor is monitored through lib->watcher, so changed files
+ * get reloaded by a thread from the processor pool.
+ *
+ * @param settings		settings to merge reloaded files into
+ * @param file			root configuration file, e.g. lib->conf
+ * @return				watcher instance, NULL if inotify is not supported
+ */
+settings_watcher_t *settings_watcher_create(settings_t *settings, char *file);
+
+#endif /** SETTINGS_WATCHER_H_ @}*/
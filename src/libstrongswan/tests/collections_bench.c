@@ -0,0 +1,355 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Hochschule fuer Technik Rapperswil
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/**
+ * Standalone microbenchmark for the collection classes.
+ *
+ * Measures ns/op and, where perf counters are available, cache misses per
+ * operation for hashtable, linked list, array and enumerator primitives at
+ * multiple working set sizes, and prints them as CSV. Run it before and
+ * after a data structure change to land the change with numbers.
+ */
+
+#include <library.h>
+#include <collections/hashtable.h>
+#include <collections/linked_list.h>
+#include <collections/array.h>
+
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#endif
+
+/**
+ * Benchmarked working set sizes, in elements
+ */
+static const size_t sizes[] = { 10, 100, 1000, 10000, 100000 };
+
+/**
+ * Rough number of operations to spend per measurement
+ */
+#define OPS_BUDGET 200000
+
+/**
+ * Accumulated cost of a single operation type
+ */
+typedef struct {
+	/** total time spent, in ns */
+	u_int64_t ns;
+	/** total cache misses */
+	u_int64_t misses;
+	/** total number of operations */
+	u_int64_t ops;
+} cbench_t;
+
+/**
+ * perf counter file descriptor, -1 if unavailable
+ */
+static int perf_fd = -1;
+
+/**
+ * Try to open a cache miss perf counter for the calling thread
+ */
+static void perf_open()
+{
+#ifdef __linux__
+	struct perf_event_attr attr = {
+		.type = PERF_TYPE_HARDWARE,
+		.size = sizeof(struct perf_event_attr),
+		.config = PERF_COUNT_HW_CACHE_MISSES,
+		.disabled = 1,
+		.exclude_kernel = 1,
+		.exclude_hv = 1,
+	};
+
+	perf_fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+}
+
+/**
+ * Get a monotonic timestamp in nanoseconds
+ */
+static u_int64_t now_ns()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u_int64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Timestamp taken by lap_start()
+ */
+static u_int64_t lap_ns;
+
+/**
+ * Start timing a batch of operations
+ */
+static void lap_start()
+{
+#ifdef __linux__
+	if (perf_fd >= 0)
+	{
+		ioctl(perf_fd, PERF_EVENT_IOC_RESET, 0);
+		ioctl(perf_fd, PERF_EVENT_IOC_ENABLE, 0);
+	}
+#endif
+	lap_ns = now_ns();
+}
+
+/**
+ * Stop timing and account the batch to a measurement
+ */
+static void lap_end(cbench_t *b, u_int64_t ops)
+{
+	u_int64_t misses = 0;
+
+	b->ns += now_ns() - lap_ns;
+#ifdef __linux__
+	if (perf_fd >= 0)
+	{
+		ioctl(perf_fd, PERF_EVENT_IOC_DISABLE, 0);
+		if (read(perf_fd, &misses, sizeof(misses)) != sizeof(misses))
+		{
+			misses = 0;
+		}
+	}
+#endif
+	b->misses += misses;
+	b->ops += ops;
+}
+
+/**
+ * Print a CSV row for a finished measurement
+ */
+static void row(char *structure, char *op, size_t size, cbench_t *b)
+{
+	if (!b->ops)
+	{
+		return;
+	}
+	printf("%s,%s,%zu,%.1f,", structure, op, size, (double)b->ns / b->ops);
+	if (perf_fd >= 0)
+	{
+		printf("%.2f\n", (double)b->misses / b->ops);
+	}
+	else
+	{
+		printf("-\n");
+	}
+}
+
+/**
+ * Simple LCG for reproducible pseudo-random access patterns
+ */
+static u_int32_t rand_next(u_int32_t *state)
+{
+	*state = *state * 1664525 + 1013904223;
+	return *state;
+}
+
+/**
+ * Benchmark hashtable operations for a given table size
+ */
+static void bench_hashtable(size_t size)
+{
+	cbench_t put = {}, get = {}, get_rand = {}, enumerate = {}, del = {};
+	hashtable_t *table;
+	enumerator_t *enumerator;
+	u_int32_t state;
+	uintptr_t i;
+	void *key, *value;
+	int round, rounds = max(1, OPS_BUDGET / size);
+
+	for (round = 0; round < rounds; round++)
+	{
+		table = hashtable_create(hashtable_hash_ptr, hashtable_equals_ptr, 8);
+
+		lap_start();
+		for (i = 1; i <= size; i++)
+		{
+			table->put(table, (void*)i, (void*)i);
+		}
+		lap_end(&put, size);
+
+		lap_start();
+		for (i = 1; i <= size; i++)
+		{
+			value = table->get(table, (void*)i);
+		}
+		lap_end(&get, size);
+
+		state = 0x5353414e + round;
+		lap_start();
+		for (i = 1; i <= size; i++)
+		{
+			value = table->get(table,
+							   (void*)(uintptr_t)(rand_next(&state) % size + 1));
+		}
+		lap_end(&get_rand, size);
+
+		lap_start();
+		enumerator = table->create_enumerator(table);
+		while (enumerator->enumerate(enumerator, &key, &value))
+		{
+			/* count the traversal only */
+		}
+		enumerator->destroy(enumerator);
+		lap_end(&enumerate, size);
+
+		lap_start();
+		for (i = 1; i <= size; i++)
+		{
+			value = table->remove(table, (void*)i);
+		}
+		lap_end(&del, size);
+
+		table->destroy(table);
+	}
+	row("hashtable", "put", size, &put);
+	row("hashtable", "get", size, &get);
+	row("hashtable", "get_rand", size, &get_rand);
+	row("hashtable", "enumerate", size, &enumerate);
+	row("hashtable", "remove", size, &del);
+}
+
+/**
+ * Benchmark linked list operations for a given list length
+ */
+static void bench_linked_list(size_t size)
+{
+	cbench_t insert = {}, enumerate = {}, del = {};
+	linked_list_t *list;
+	enumerator_t *enumerator;
+	uintptr_t i;
+	void *value;
+	int round, rounds = max(1, OPS_BUDGET / size);
+
+	for (round = 0; round < rounds; round++)
+	{
+		list = linked_list_create();
+
+		lap_start();
+		for (i = 1; i <= size; i++)
+		{
+			list->insert_last(list, (void*)i);
+		}
+		lap_end(&insert, size);
+
+		lap_start();
+		enumerator = list->create_enumerator(list);
+		while (enumerator->enumerate(enumerator, &value))
+		{
+			/* count the traversal only */
+		}
+		enumerator->destroy(enumerator);
+		lap_end(&enumerate, size);
+
+		lap_start();
+		while (list->remove_first(list, &value) == SUCCESS)
+		{
+			/* drain the list */
+		}
+		lap_end(&del, size);
+
+		list->destroy(list);
+	}
+	row("linked_list", "insert_last", size, &insert);
+	row("linked_list", "enumerate", size, &enumerate);
+	row("linked_list", "remove_first", size, &del);
+}
+
+/**
+ * Benchmark array operations for a given array size
+ */
+static void bench_array(size_t size)
+{
+	cbench_t insert = {}, get_rand = {}, enumerate = {};
+	array_t *array;
+	enumerator_t *enumerator;
+	u_int32_t state;
+	uintptr_t i;
+	void *value;
+	int round, rounds = max(1, OPS_BUDGET / size);
+
+	for (round = 0; round < rounds; round++)
+	{
+		array = array_create(0, 0);
+
+		lap_start();
+		for (i = 1; i <= size; i++)
+		{
+			array_insert(array, ARRAY_TAIL, (void*)i);
+		}
+		lap_end(&insert, size);
+
+		state = 0x5353414e + round;
+		lap_start();
+		for (i = 1; i <= size; i++)
+		{
+			array_get(array, rand_next(&state) % size, &value);
+		}
+		lap_end(&get_rand, size);
+
+		lap_start();
+		enumerator = array_create_enumerator(array);
+		while (enumerator->enumerate(enumerator, &value))
+		{
+			/* count the traversal only */
+		}
+		enumerator->destroy(enumerator);
+		lap_end(&enumerate, size);
+
+		array_destroy(array);
+	}
+	row("array", "insert_tail", size, &insert);
+	row("array", "get_rand", size, &get_rand);
+	row("array", "enumerate", size, &enumerate);
+}
+
+int main(int argc, char *argv[])
+{
+	int i;
+
+	library_init(NULL, "collections-bench");
+	atexit(library_deinit);
+
+	perf_open();
+	if (perf_fd < 0)
+	{
+		fprintf(stderr, "perf counters unavailable, "
+				"skipping cache miss rates\n");
+	}
+
+	printf("structure,operation,size,ns_per_op,cache_misses_per_op\n");
+	for (i = 0; i < countof(sizes); i++)
+	{
+		bench_hashtable(sizes[i]);
+	}
+	for (i = 0; i < countof(sizes); i++)
+	{
+		bench_linked_list(sizes[i]);
+	}
+	for (i = 0; i < countof(sizes); i++)
+	{
+		bench_array(sizes[i]);
+	}
+	return 0;
+}
@@ -0,0 +1,456 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Hochschule fuer Technik Rapperswil
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/**
+ * Standalone benchmark for registered crypto implementations.
+ *
+ * Measures throughput and operation latency percentiles for all registered
+ * crypters, AEADs, hashers, PRFs and DH groups across a range of message
+ * sizes, and prints them as CSV to compare plugin stacks. The plugins to
+ * load can be set with the BENCH_PLUGINS environment variable, i.e.:
+ *
+ *   BENCH_PLUGINS="aes gcm sha2" ./crypto_bench
+ */
+
+#include <library.h>
+#include <plugins/plugin_loader.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ * Message sizes benchmarked for bulk transforms, in bytes
+ */
+static const size_t msg_sizes[] = { 64, 256, 1024, 4096, 16384 };
+
+/**
+ * Time budget per measurement, in nanoseconds
+ */
+#define TIME_BUDGET (200 * 1000 * 1000ULL)
+
+/**
+ * Maximum number of latency samples kept per measurement
+ */
+#define MAX_SAMPLES 4096
+
+/**
+ * Collected samples for a single measurement
+ */
+typedef struct {
+	/** per-operation latencies, in ns */
+	u_int64_t samples[MAX_SAMPLES];
+	/** number of collected samples */
+	int count;
+	/** total time spent, in ns */
+	u_int64_t total;
+	/** total number of operations */
+	u_int64_t ops;
+} bench_t;
+
+/**
+ * Get a monotonic timestamp in nanoseconds
+ */
+static u_int64_t now_ns()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u_int64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Record a single operation taking ns nanoseconds
+ */
+static void record(bench_t *b, u_int64_t ns)
+{
+	if (b->count < MAX_SAMPLES)
+	{
+		b->samples[b->count++] = ns;
+	}
+	b->total += ns;
+	b->ops++;
+}
+
+/**
+ * qsort() callback ordering latency samples
+ */
+static int cmp_samples(const void *a, const void *b)
+{
+	const u_int64_t *x = a, *y = b;
+
+	return (*x > *y) - (*x < *y);
+}
+
+/**
+ * Get the given latency percentile from the collected samples, in ns
+ */
+static u_int64_t percentile(bench_t *b, int p)
+{
+	int idx;
+
+	if (!b->count)
+	{
+		return 0;
+	}
+	idx = b->count * p / 100;
+	return b->samples[min(idx, b->count - 1)];
+}
+
+/**
+ * Print a CSV row for a finished measurement
+ */
+static void report(char *type, enum_name_t *names, u_int alg, u_int key_size,
+				   const char *plugin, size_t msg_size, bench_t *b)
+{
+	double secs, mbps = 0;
+
+	if (!b->ops)
+	{
+		return;
+	}
+	qsort(b->samples, b->count, sizeof(b->samples[0]), cmp_samples);
+	secs = b->total / 1e9;
+	if (msg_size)
+	{
+		mbps = b->ops * msg_size * 8 / secs / 1e6;
+	}
+	printf("%s,%N,%u,%s,%zu,%.0f,%.1f,%llu,%llu,%llu\n",
+		   type, names, alg, key_size, plugin, msg_size,
+		   b->ops / secs, mbps, (unsigned long long)percentile(b, 50),
+		   (unsigned long long)percentile(b, 90),
+		   (unsigned long long)percentile(b, 99));
+}
+
+/**
+ * Key sizes tried for keyed bulk transforms, in bytes
+ */
+static const size_t key_sizes[] = { 8, 16, 24, 32 };
+
+/**
+ * Buffer used as message, key and IV material, with ICV headroom
+ */
+static u_char buf[16384 + 64];
+
+/**
+ * Benchmark all registered crypters
+ */
+static void bench_crypters()
+{
+	enumerator_t *enumerator;
+	encryption_algorithm_t alg;
+	const char *plugin;
+	crypter_t *crypter;
+	chunk_t key, iv, data;
+	u_int64_t start;
+	bench_t b;
+	size_t bs, len;
+	int i, j;
+
+	enumerator = lib->crypto->create_crypter_enumerator(lib->crypto);
+	while (enumerator->enumerate(enumerator, &alg, &plugin))
+	{
+		for (i = 0; i < countof(key_sizes); i++)
+		{
+			crypter = lib->crypto->create_crypter(lib->crypto, alg,
+												  key_sizes[i]);
+			if (!crypter)
+			{
+				continue;
+			}
+			key = chunk_create(buf, crypter->get_key_size(crypter));
+			iv = chunk_create(buf, crypter->get_iv_size(crypter));
+			bs = crypter->get_block_size(crypter);
+			if (!crypter->set_key(crypter, key))
+			{
+				crypter->destroy(crypter);
+				continue;
+			}
+			for (j = 0; j < countof(msg_sizes); j++)
+			{
+				len = max(msg_sizes[j] / bs, 1) * bs;
+				data = chunk_create(buf, len);
+				memset(&b, 0, sizeof(b));
+				while (b.total < TIME_BUDGET)
+				{
+					start = now_ns();
+					if (!crypter->encrypt(crypter, data, iv, NULL))
+					{
+						break;
+					}
+					record(&b, now_ns() - start);
+				}
+				report("crypter", encryption_algorithm_names, alg,
+					   key_sizes[i], plugin, len, &b);
+			}
+			crypter->destroy(crypter);
+		}
+	}
+	enumerator->destroy(enumerator);
+}
+
+/**
+ * Get the salt size to request for an AEAD algorithm
+ */
+static size_t aead_salt_size(encryption_algorithm_t alg)
+{
+	switch (alg)
+	{
+		case ENCR_AES_CCM_ICV8:
+		case ENCR_AES_CCM_ICV12:
+		case ENCR_AES_CCM_ICV16:
+		case ENCR_CAMELLIA_CCM_ICV8:
+		case ENCR_CAMELLIA_CCM_ICV12:
+		case ENCR_CAMELLIA_CCM_ICV16:
+			return 3;
+		default:
+			return 4;
+	}
+}
+
+/**
+ * Benchmark all registered AEAD transforms
+ */
+static void bench_aeads()
+{
+	enumerator_t *enumerator;
+	encryption_algorithm_t alg;
+	const char *plugin;
+	aead_t *aead;
+	chunk_t key, iv, data;
+	u_int64_t start;
+	bench_t b;
+	size_t bs, len;
+	int i, j;
+
+	enumerator = lib->crypto->create_aead_enumerator(lib->crypto);
+	while (enumerator->enumerate(enumerator, &alg, &plugin))
+	{
+		for (i = 0; i < countof(key_sizes); i++)
+		{
+			aead = lib->crypto->create_aead(lib->crypto, alg, key_sizes[i],
+											aead_salt_size(alg));
+			if (!aead)
+			{
+				continue;
+			}
+			key = chunk_create(buf, aead->get_key_size(aead));
+			iv = chunk_create(buf, aead->get_iv_size(aead));
+			bs = aead->get_block_size(aead);
+			if (!aead->set_key(aead, key))
+			{
+				aead->destroy(aead);
+				continue;
+			}
+			for (j = 0; j < countof(msg_sizes); j++)
+			{
+				len = max(msg_sizes[j] / bs, 1) * bs;
+				data = chunk_create(buf, len);
+				memset(&b, 0, sizeof(b));
+				while (b.total < TIME_BUDGET)
+				{
+					start = now_ns();
+					if (!aead->encrypt(aead, data, chunk_empty, iv, NULL))
+					{
+						break;
+					}
+					record(&b, now_ns() - start);
+				}
+				report("aead", encryption_algorithm_names, alg, key_sizes[i],
+					   plugin, len, &b);
+			}
+			aead->destroy(aead);
+		}
+	}
+	enumerator->destroy(enumerator);
+}
+
+/**
+ * Benchmark all registered hashers
+ */
+static void bench_hashers()
+{
+	enumerator_t *enumerator;
+	hash_algorithm_t alg;
+	const char *plugin;
+	hasher_t *hasher;
+	u_char hash[HASH_SIZE_SHA512];
+	u_int64_t start;
+	bench_t b;
+	int j;
+
+	enumerator = lib->crypto->create_hasher_enumerator(lib->crypto);
+	while (enumerator->enumerate(enumerator, &alg, &plugin))
+	{
+		hasher = lib->crypto->create_hasher(lib->crypto, alg);
+		if (!hasher)
+		{
+			continue;
+		}
+		for (j = 0; j < countof(msg_sizes); j++)
+		{
+			memset(&b, 0, sizeof(b));
+			while (b.total < TIME_BUDGET)
+			{
+				start = now_ns();
+				if (!hasher->get_hash(hasher,
+									  chunk_create(buf, msg_sizes[j]), hash))
+				{
+					break;
+				}
+				record(&b, now_ns() - start);
+			}
+			report("hasher", hash_algorithm_names, alg, 0, plugin,
+				   msg_sizes[j], &b);
+		}
+		hasher->destroy(hasher);
+	}
+	enumerator->destroy(enumerator);
+}
+
+/**
+ * Benchmark all registered PRFs
+ */
+static void bench_prfs()
+{
+	enumerator_t *enumerator;
+	pseudo_random_function_t alg;
+	const char *plugin;
+	prf_t *prf;
+	u_char out[64];
+	u_int64_t start;
+	bench_t b;
+	int j;
+
+	enumerator = lib->crypto->create_prf_enumerator(lib->crypto);
+	while (enumerator->enumerate(enumerator, &alg, &plugin))
+	{
+		prf = lib->crypto->create_prf(lib->crypto, alg);
+		if (!prf)
+		{
+			continue;
+		}
+		if (prf->get_block_size(prf) > sizeof(out) ||
+			!prf->set_key(prf, chunk_create(buf, prf->get_key_size(prf))))
+		{
+			prf->destroy(prf);
+			continue;
+		}
+		for (j = 0; j < countof(msg_sizes); j++)
+		{
+			memset(&b, 0, sizeof(b));
+			while (b.total < TIME_BUDGET)
+			{
+				start = now_ns();
+				if (!prf->get_bytes(prf, chunk_create(buf, msg_sizes[j]), out))
+				{
+					break;
+				}
+				record(&b, now_ns() - start);
+			}
+			report("prf", pseudo_random_function_names, alg, 0, plugin,
+				   msg_sizes[j], &b);
+		}
+		prf->destroy(prf);
+	}
+	enumerator->destroy(enumerator);
+}
+
+/**
+ * Benchmark all registered DH groups, one side of a full exchange
+ */
+static void bench_dhs()
+{
+	enumerator_t *enumerator;
+	diffie_hellman_group_t group;
+	const char *plugin;
+	diffie_hellman_t *dh, *peer;
+	chunk_t public, secret;
+	u_int64_t start;
+	bench_t b;
+
+	enumerator = lib->crypto->create_dh_enumerator(lib->crypto);
+	while (enumerator->enumerate(enumerator, &group, &plugin))
+	{
+		if (group == MODP_CUSTOM)
+		{
+			continue;
+		}
+		peer = lib->crypto->create_dh(lib->crypto, group);
+		if (!peer)
+		{
+			continue;
+		}
+		peer->get_my_public_value(peer, &public);
+		memset(&b, 0, sizeof(b));
+		while (b.total < TIME_BUDGET)
+		{
+			start = now_ns();
+			dh = lib->crypto->create_dh(lib->crypto, group);
+			if (!dh)
+			{
+				break;
+			}
+			dh->set_other_public_value(dh, public);
+			if (dh->get_shared_secret(dh, &secret) == SUCCESS)
+			{
+				chunk_clear(&secret);
+			}
+			dh->destroy(dh);
+			record(&b, now_ns() - start);
+		}
+		report("dh", diffie_hellman_group_names, group, 0, plugin, 0, &b);
+		chunk_free(&public);
+		peer->destroy(peer);
+	}
+	enumerator->destroy(enumerator);
+}
+
+int main(int argc, char *argv[])
+{
+	char *plugins;
+	int i;
+
+	library_init(NULL, "crypto-bench");
+	atexit(library_deinit);
+
+	plugins = getenv("BENCH_PLUGINS");
+	if (!plugins)
+	{
+		plugins = PLUGINS;
+	}
+	plugin_loader_add_plugindirs(PLUGINDIR, plugins);
+	if (!lib->plugins->load(lib->plugins, plugins))
+	{
+		fprintf(stderr, "loading plugins failed\n");
+		return 1;
+	}
+
+	for (i = 0; i < sizeof(buf); i++)
+	{
+		buf[i] = i;
+	}
+
+	printf("type,algorithm,key_size,plugin,msg_size,"
+		   "ops_per_sec,mbps,p50_ns,p90_ns,p99_ns\n");
+	bench_crypters();
+	bench_aeads();
+	bench_hashers();
+	bench_prfs();
+	bench_dhs();
+
+	lib->plugins->unload(lib->plugins);
+	return 0;
+}
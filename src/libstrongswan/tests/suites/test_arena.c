@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Hochschule fuer Technik Rapperswil
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include "test_suite.h"
+
+#include <utils/arena.h>
+
+START_TEST(test_alloc)
+{
+	arena_t *arena;
+	char *a, *b;
+
+	arena = arena_create(64);
+
+	a = arena->alloc(arena, 16);
+	ck_assert(a != NULL);
+	memset(a, 0xaa, 16);
+
+	b = arena->alloc(arena, 16);
+	ck_assert(b != NULL);
+	ck_assert(a != b);
+	memset(b, 0xbb, 16);
+
+	/* allocations don't overlap */
+	ck_assert_int_eq((unsigned char)a[0], 0xaa);
+	ck_assert_int_eq((unsigned char)a[15], 0xaa);
+	ck_assert_int_eq((unsigned char)b[0], 0xbb);
+
+	arena->destroy(arena);
+}
+END_TEST
+
+START_TEST(test_alignment)
+{
+	arena_t *arena;
+	uintptr_t p;
+	int i;
+
+	arena = arena_create(64);
+
+	for (i = 1; i <= 9; i++)
+	{
+		p = (uintptr_t)arena->alloc(arena, i);
+		ck_assert_int_eq(p % sizeof(u_int64_t), 0);
+	}
+	arena->destroy(arena);
+}
+END_TEST
+
+START_TEST(test_large)
+{
+	arena_t *arena;
+	char *a;
+
+	arena = arena_create(16);
+
+	/* larger than the block size gets its own block */
+	a = arena->alloc(arena, 1024);
+	ck_assert(a != NULL);
+	memset(a, 0xcc, 1024);
+
+	a = arena->alloc(arena, 8);
+	ck_assert(a != NULL);
+
+	arena->destroy(arena);
+}
+END_TEST
+
+START_TEST(test_reset)
+{
+	arena_t *arena;
+	char *a;
+	int round, i;
+
+	arena = arena_create(32);
+
+	for (round = 0; round < 4; round++)
+	{
+		for (i = 0; i < 16; i++)
+		{
+			a = arena->alloc(arena, 24);
+			ck_assert(a != NULL);
+			memset(a, i, 24);
+		}
+		arena->reset(arena);
+	}
+	/* reset on an empty arena is a no-op */
+	arena->reset(arena);
+	ck_assert(arena->alloc(arena, 8) != NULL);
+
+	arena->destroy(arena);
+}
+END_TEST
+
+Suite *arena_suite_create()
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("arena");
+
+	tc = tcase_create("alloc");
+	tcase_add_test(tc, test_alloc);
+	tcase_add_test(tc, test_alignment);
+	tcase_add_test(tc, test_large);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("reset");
+	tcase_add_test(tc, test_reset);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
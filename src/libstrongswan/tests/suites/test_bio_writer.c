@@ -349,6 +349,87 @@ START_TEST(test_extract_buf)
 }
 END_TEST
 
+/*******************************************************************************
+ * test reserve/commit
+ */
+
+START_TEST(test_reserve_commit)
+{
+	bio_writer_t *writer;
+	chunk_t data;
+	u_char *ptr;
+
+	writer = bio_writer_create(0);
+	writer->write_uint8(writer, 1);
+
+	ptr = writer->reserve(writer, 2);
+	data = writer->get_buf(writer);
+	ck_assert_int_eq(data.len, 1);
+
+	ptr[0] = 2;
+	ptr[1] = 3;
+	writer->commit(writer, 2);
+	data = writer->get_buf(writer);
+	ck_assert_int_eq(data.len, 3);
+	ck_assert(data.ptr[0] == 1);
+	ck_assert(data.ptr[1] == 2);
+	ck_assert(data.ptr[2] == 3);
+
+	/* commit less than reserved */
+	ptr = writer->reserve(writer, 8);
+	ptr[0] = 4;
+	writer->commit(writer, 1);
+	data = writer->get_buf(writer);
+	ck_assert_int_eq(data.len, 4);
+	ck_assert(data.ptr[3] == 4);
+
+	writer->destroy(writer);
+}
+END_TEST
+
+/*******************************************************************************
+ * test writing to caller provided storage
+ */
+
+START_TEST(test_create_on)
+{
+	bio_writer_t *writer;
+	u_char buf[8];
+	chunk_t data;
+	int i;
+
+	writer = bio_writer_create_on(chunk_from_thing(buf));
+	for (i = 0; i < 4; i++)
+	{
+		writer->write_uint16(writer, i);
+	}
+	data = writer->get_buf(writer);
+	ck_assert_int_eq(data.len, sizeof(buf));
+	ck_assert(data.ptr == buf);
+
+	/* exceeding the provided storage spills to an allocated buffer */
+	writer->write_uint16(writer, i);
+	data = writer->get_buf(writer);
+	ck_assert_int_eq(data.len, 10);
+	ck_assert(data.ptr != buf);
+	for (i = 0; i < 5; i++)
+	{
+		ck_assert_int_eq(untoh16(data.ptr + i * 2), i);
+	}
+	writer->destroy(writer);
+
+	/* extracting data still on provided storage returns a copy */
+	writer = bio_writer_create_on(chunk_from_thing(buf));
+	writer->write_uint8(writer, 1);
+	data = writer->extract_buf(writer);
+	ck_assert_int_eq(data.len, 1);
+	ck_assert(data.ptr != buf);
+	ck_assert(data.ptr[0] == 1);
+	chunk_free(&data);
+	writer->destroy(writer);
+}
+END_TEST
+
 Suite *bio_writer_suite_create()
 {
 	Suite *s;
@@ -367,6 +448,8 @@ Suite *bio_writer_suite_create()
 	tc = tcase_create("data writes/skip");
 	tcase_add_test(tc, test_write_data);
 	tcase_add_test(tc, test_skip);
+	tcase_add_test(tc, test_reserve_commit);
+	tcase_add_test(tc, test_create_on);
 	suite_add_tcase(s, tc);
 
 	tc = tcase_create("data length writes");
@@ -57,6 +57,30 @@ ENUM_NEXT(test_enum_split_names, SPLIT5, SPLIT5, SPLIT4,
 	"SPLIT5");
 ENUM_END(test_enum_split_names, SPLIT5);
 
+/*******************************************************************************
+ * large enum, above the sorted index threshold of enum_from_name()
+ */
+enum {
+	LARGE1,
+	LARGE2,
+	LARGE3,
+	LARGE4,
+	LARGE5,
+	LARGE6,
+	LARGE7,
+	LARGE8,
+	LARGE9,
+	LARGE10,
+} test_enum_large;
+
+/* can't be static */
+enum_name_t *test_enum_large_names;
+
+ENUM_BEGIN(test_enum_large_names, LARGE1, LARGE10,
+	"LARGE1", "LARGE2", "LARGE3", "LARGE4", "LARGE5",
+	"LARGE6", "LARGE7", "LARGE8", "LARGE9", "LARGE10");
+ENUM_END(test_enum_large_names, LARGE10);
+
 /*******************************************************************************
  * enum flags
  */
@@ -177,6 +201,17 @@ static struct {
 	{FALSE, 0, "asdf"},
 	{FALSE, 0, ""},
 	{FALSE, 0, NULL},
+}, enum_tests_large[] = {
+	{TRUE, LARGE1, "LARGE1"},
+	{TRUE, LARGE1, "large1"},
+	{TRUE, LARGE5, "LARGE5"},
+	{TRUE, LARGE9, "LaRgE9"},
+	{TRUE, LARGE10, "LARGE10"},
+	{FALSE, 0, "LARGE"},
+	{FALSE, 0, "LARGE11"},
+	{FALSE, 0, "asdf"},
+	{FALSE, 0, ""},
+	{FALSE, 0, NULL},
 };
 
 START_TEST(test_enum_from_name_cont)
@@ -201,6 +236,17 @@ START_TEST(test_enum_from_name_split)
 }
 END_TEST
 
+START_TEST(test_enum_from_name_large)
+{
+	int val = 0;
+	bool found;
+
+	found = enum_from_name(test_enum_large_names, enum_tests_large[_i].str, &val);
+	ck_assert(enum_tests_large[_i].found == found);
+	ck_assert_int_eq(val, enum_tests_large[_i].val);
+}
+END_TEST
+
 /*******************************************************************************
  * enum_printf_hook
  */
@@ -396,6 +442,7 @@ Suite *enum_suite_create()
 	tc = tcase_create("enum_from_name");
 	tcase_add_loop_test(tc, test_enum_from_name_cont, 0, countof(enum_tests_cont));
 	tcase_add_loop_test(tc, test_enum_from_name_split, 0, countof(enum_tests_split));
+	tcase_add_loop_test(tc, test_enum_from_name_large, 0, countof(enum_tests_large));
 	suite_add_tcase(s, tc);
 
 	tc = tcase_create("enum_flags_to_string");
@@ -33,24 +33,20 @@ static bool equals(char *key1, char *key2)
 }
 
 /*******************************************************************************
- * test fixture
+ * table variants, tests are run against both implementations
  */
 
 static hashtable_t *ht;
 
-START_SETUP(setup_ht)
+static hashtable_t *create_ht(int variant, hashtable_hash_t hash,
+							  hashtable_equals_t equals, u_int capacity)
 {
-	ht = hashtable_create((hashtable_hash_t)hash,
-						  (hashtable_equals_t)equals, 0);
-	ck_assert_int_eq(ht->get_count(ht), 0);
-}
-END_SETUP
-
-START_TEARDOWN(teardown_ht)
-{
-	ht->destroy(ht);
+	if (variant)
+	{
+		return hashtable_create_flat(hash, equals, capacity);
+	}
+	return hashtable_create(hash, equals, capacity);
 }
-END_TEARDOWN
 
 /*******************************************************************************
  * put/get
@@ -61,6 +57,9 @@ START_TEST(test_put_get)
 	char *k1 = "key1", *k2 = "key2", *k3 = "key3";
 	char *v1 = "val1", *v2 = "val2", *v3 = "val3", *value;
 
+	ht = create_ht(_i, (hashtable_hash_t)hash, (hashtable_equals_t)equals, 0);
+	ck_assert_int_eq(ht->get_count(ht), 0);
+
 	value = ht->put(ht, k1, v1);
 	ck_assert_int_eq(ht->get_count(ht), 1);
 	ck_assert(streq(ht->get(ht, k1), v1));
@@ -79,6 +78,8 @@ START_TEST(test_put_get)
 	ck_assert_int_eq(ht->get_count(ht), 3);
 	ck_assert(streq(value, v2));
 	ck_assert(streq(ht->get(ht, k2), v1));
+
+	ht->destroy(ht);
 }
 END_TEST
 
@@ -106,8 +107,8 @@ START_TEST(test_get_match)
 	char *k1 = "key1_a", *k2 = "key2", *k3 = "key1_b", *k4 = "key1_c";
 	char *v1 = "val1", *v2 = "val2", *v3 = "val3", *value;
 
-	ht = hashtable_create((hashtable_hash_t)hash_match,
-						  (hashtable_equals_t)equals, 0);
+	ht = create_ht(_i, (hashtable_hash_t)hash_match,
+				   (hashtable_equals_t)equals, 0);
 
 	ht->put(ht, k1, v1);
 	ht->put(ht, k2, v2);
@@ -170,7 +171,9 @@ START_TEST(test_remove)
 {
 	char *k1 = "key1", *k2 = "key2", *k3 = "key3";
 
+	ht = create_ht(_i, (hashtable_hash_t)hash, (hashtable_equals_t)equals, 0);
 	do_remove(k1, k2, k3);
+	ht->destroy(ht);
 }
 END_TEST
 
@@ -178,12 +181,12 @@ START_TEST(test_remove_one_bucket)
 {
 	char *k1 = "key1_a", *k2 = "key1_b", *k3 = "key1_c";
 
-	ht->destroy(ht);
 	/* set a capacity to avoid rehashing, which would change the items' order */
-	ht = hashtable_create((hashtable_hash_t)hash_match,
-						  (hashtable_equals_t)equals, 8);
+	ht = create_ht(_i, (hashtable_hash_t)hash_match,
+				   (hashtable_equals_t)equals, 8);
 
 	do_remove(k1, k2, k3);
+	ht->destroy(ht);
 }
 END_TEST
 
@@ -198,6 +201,8 @@ START_TEST(test_enumerator)
 	enumerator_t *enumerator;
 	int count;
 
+	ht = create_ht(_i, (hashtable_hash_t)hash, (hashtable_equals_t)equals, 0);
+
 	ht->put(ht, k1, v1);
 	ht->put(ht, k2, v2);
 	ht->put(ht, k3, v3);
@@ -237,6 +242,8 @@ START_TEST(test_enumerator)
 	}
 	enumerator->destroy(enumerator);
 	ck_assert_int_eq(count, 0);
+
+	ht->destroy(ht);
 }
 END_TEST
 
@@ -293,7 +300,9 @@ START_TEST(test_remove_at)
 {
 	char *k1 = "key1", *k2 = "key2", *k3 = "key3";
 
+	ht = create_ht(_i, (hashtable_hash_t)hash, (hashtable_equals_t)equals, 0);
 	do_remove_at(k1, k2, k3);
+	ht->destroy(ht);
 }
 END_TEST
 
@@ -301,11 +310,11 @@ START_TEST(test_remove_at_one_bucket)
 {
 	char *k1 = "key1_a", *k2 = "key1_b", *k3 = "key1_c";
 
-	ht->destroy(ht);
 	/* set a capacity to avoid rehashing, which would change the items' order */
-	ht = hashtable_create((hashtable_hash_t)hash_match,
-						  (hashtable_equals_t)equals, 8);
+	ht = create_ht(_i, (hashtable_hash_t)hash_match,
+				   (hashtable_equals_t)equals, 8);
 	do_remove_at(k1, k2, k3);
+	ht->destroy(ht);
 }
 END_TEST
 
@@ -317,29 +326,25 @@ Suite *hashtable_suite_create()
 	s = suite_create("hashtable");
 
 	tc = tcase_create("put/get");
-	tcase_add_checked_fixture(tc, setup_ht, teardown_ht);
-	tcase_add_test(tc, test_put_get);
+	tcase_add_loop_test(tc, test_put_get, 0, 2);
 	suite_add_tcase(s, tc);
 
 	tc = tcase_create("get_match");
-	tcase_add_test(tc, test_get_match);
+	tcase_add_loop_test(tc, test_get_match, 0, 2);
 	suite_add_tcase(s, tc);
 
 	tc = tcase_create("remove");
-	tcase_add_checked_fixture(tc, setup_ht, teardown_ht);
-	tcase_add_test(tc, test_remove);
-	tcase_add_test(tc, test_remove_one_bucket);
+	tcase_add_loop_test(tc, test_remove, 0, 2);
+	tcase_add_loop_test(tc, test_remove_one_bucket, 0, 2);
 	suite_add_tcase(s, tc);
 
 	tc = tcase_create("enumerator");
-	tcase_add_checked_fixture(tc, setup_ht, teardown_ht);
-	tcase_add_test(tc, test_enumerator);
+	tcase_add_loop_test(tc, test_enumerator, 0, 2);
 	suite_add_tcase(s, tc);
 
 	tc = tcase_create("remove_at");
-	tcase_add_checked_fixture(tc, setup_ht, teardown_ht);
-	tcase_add_test(tc, test_remove_at);
-	tcase_add_test(tc, test_remove_at_one_bucket);
+	tcase_add_loop_test(tc, test_remove_at, 0, 2);
+	tcase_add_loop_test(tc, test_remove_at_one_bucket, 0, 2);
 	suite_add_tcase(s, tc);
 
 	return s;
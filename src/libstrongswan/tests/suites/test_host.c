@@ -627,6 +627,33 @@ START_TEST(test_equals_any)
 }
 END_TEST
 
+/*******************************************************************************
+ * hash
+ */
+
+START_TEST(test_hash)
+{
+	host_t *a, *b;
+
+	a = host_create_from_string("192.168.0.1", 500);
+	b = host_create_from_string("192.168.0.1", 0);
+	ck_assert_int_eq(a->hash(a, FALSE), b->hash(b, FALSE));
+	ck_assert(a->hash(a, TRUE) != b->hash(b, TRUE));
+	b->set_port(b, 500);
+	ck_assert_int_eq(a->hash(a, TRUE), b->hash(b, TRUE));
+	b->destroy(b);
+	b = host_create_from_string("192.168.0.2", 500);
+	ck_assert(a->hash(a, FALSE) != b->hash(b, FALSE));
+	b->destroy(b);
+	/* the cached hash is retained by clone() */
+	b = a->clone(a);
+	ck_assert_int_eq(a->hash(a, FALSE), b->hash(b, FALSE));
+	ck_assert_int_eq(a->hash(a, TRUE), b->hash(b, TRUE));
+	a->destroy(a);
+	b->destroy(b);
+}
+END_TEST
+
 /*******************************************************************************
  * clone
  */
@@ -775,6 +802,10 @@ Suite *host_suite_create()
 	tcase_add_test(tc, test_equals_any);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("hash");
+	tcase_add_test(tc, test_hash);
+	suite_add_tcase(s, tc);
+
 	tc = tcase_create("clone");
 	tcase_add_test(tc, test_clone);
 	suite_add_tcase(s, tc);
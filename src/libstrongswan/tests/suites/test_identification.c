@@ -806,11 +806,14 @@ START_TEST(test_clone)
 	a_enc = a->get_encoding(a);
 	b = a->clone(a);
 	ck_assert(b != NULL);
-	ck_assert(a != b);
+	/* identities are interned, cloning returns another reference */
+	ck_assert(a == b);
 	b_enc = b->get_encoding(b);
-	ck_assert(a_enc.ptr != b_enc.ptr);
 	ck_assert(chunk_equals(a_enc, b_enc));
 	a->destroy(a);
+	/* the second reference keeps the shared instance alive */
+	ck_assert(b->get_type(b) == ID_RFC822_ADDR);
+	ck_assert(chunk_equals(b->get_encoding(b), b_enc));
 	b->destroy(b);
 }
 END_TEST
@@ -16,6 +16,8 @@
 #include "test_suite.h"
 
 #include <unistd.h>
+#include <utime.h>
+#include <sys/stat.h>
 
 #include <settings/settings.h>
 #include <utils/chunk.h>
@@ -600,6 +602,66 @@ START_TEST(test_include)
 }
 END_TEST
 
+#ifdef WIN32
+# define cachefile "C:\\Windows\\Temp\\strongswan-settings-test-cache"
+#else
+# define cachefile "/tmp/strongswan-settings-test-cache"
+#endif
+
+START_TEST(test_cache)
+{
+	struct stat st;
+	struct utimbuf times;
+	chunk_t contents = chunk_from_str(
+		"main {\n"
+		"	key1 = val1\n"
+		"	key2 = val2\n"
+		"	none = x\n"
+		"	sub1 {\n"
+		"		include = value\n"
+		"		key2 = value2\n"
+		"		include " include2 "\n"
+		"	}\n"
+		"}\n"
+		"include " include1);
+
+	setenv("STRONGSWAN_CONF_CACHE", cachefile, 1);
+	create_settings(contents);
+	verify_include();
+
+	/* a second instance is served from the cache */
+	settings->destroy(settings);
+	settings = settings_create(path);
+	verify_include();
+
+	/* changing an included file while preserving its size and mtime proves
+	 * that the cache is actually used */
+	ck_assert(stat(include2, &st) == 0);
+	ck_assert(chunk_write(chunk_from_str(
+		"key2 = XX\n"
+		"sub1 {\n"
+		"	key = XXX\n"
+		"}"), include2, 0022, TRUE));
+	times.actime = st.st_atime;
+	times.modtime = st.st_mtime;
+	ck_assert(utime(include2, &times) == 0);
+	settings->destroy(settings);
+	settings = settings_create(path);
+	verify_include();
+
+	/* bumping the mtime invalidates the cache */
+	times.modtime = st.st_mtime + 1;
+	ck_assert(utime(include2, &times) == 0);
+	settings->destroy(settings);
+	settings = settings_create(path);
+	verify_string("XX", "main.key2");
+	verify_string("XXX", "main.sub1.key");
+
+	unsetenv("STRONGSWAN_CONF_CACHE");
+	unlink(cachefile);
+}
+END_TEST
+
 START_TEST(test_load_files)
 {
 	chunk_t contents = chunk_from_str(
@@ -1054,6 +1116,7 @@ Suite *settings_suite_create()
 	tc = tcase_create("include/load_files[_section]");
 	tcase_add_checked_fixture(tc, setup_include_config, teardown_include_config);
 	tcase_add_test(tc, test_include);
+	tcase_add_test(tc, test_cache);
 	tcase_add_test(tc, test_load_files);
 	tcase_add_test(tc, test_load_files_section);
 	tcase_add_test(tc, test_order_kv);
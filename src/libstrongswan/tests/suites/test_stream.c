@@ -192,6 +192,58 @@ START_TEST(test_all)
 }
 END_TEST
 
+static bool vectored(void *data, stream_t *stream)
+{
+	char buf[64];
+	struct iovec iov[] = {
+		{ .iov_base = buf, .iov_len = 5 },
+		{ .iov_base = buf + 5, .iov_len = sizeof(buf) - 5 },
+	};
+	ssize_t len, total;
+
+	for (total = 0; total < msglen; total += len)
+	{
+		len = stream->readv(stream, iov, countof(iov), TRUE);
+		ck_assert(len > 0);
+	}
+	ck_assert(streq(buf, msg));
+	ck_assert(stream->write_all(stream, buf, msglen));
+
+	return FALSE;
+}
+
+START_TEST(test_vectored)
+{
+	char buf[64];
+	stream_service_t *service;
+	stream_t *stream;
+	struct iovec iov[] = {
+		{ .iov_base = msg, .iov_len = 4 },
+		{ .iov_base = msg + 4, .iov_len = msglen - 4 },
+	};
+	ssize_t len, total;
+
+	lib->processor->set_threads(lib->processor, 8);
+
+	service = lib->streams->create_service(lib->streams, services[_i], 1);
+	ck_assert(service != NULL);
+	service->on_accept(service, vectored, NULL, JOB_PRIO_HIGH, 1);
+
+	stream = lib->streams->connect(lib->streams, services[_i]);
+	ck_assert(stream != NULL);
+	for (total = 0; total < msglen; total += len)
+	{
+		len = stream->writev(stream, iov, countof(iov), TRUE);
+		ck_assert(len > 0);
+	}
+	ck_assert(stream->read_all(stream, buf, msglen));
+	ck_assert(streq(buf, msg));
+	stream->destroy(stream);
+
+	service->destroy(service);
+}
+END_TEST
+
 static bool concurrency(void *data, stream_t *stream)
 {
 	static refcount_t refs = 0;
@@ -260,6 +312,10 @@ Suite *stream_suite_create()
 	tcase_add_loop_test(tc, test_all, 0, countof(services));
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("vectored");
+	tcase_add_loop_test(tc, test_vectored, 0, countof(services));
+	suite_add_tcase(s, tc);
+
 	tc = tcase_create("concurrency");
 	tcase_add_loop_test(tc, test_concurrency, 0, countof(services));
 	suite_add_tcase(s, tc);
@@ -22,6 +22,7 @@ TEST_SUITE(linked_list_suite_create)
 TEST_SUITE(linked_list_enumerator_suite_create)
 TEST_SUITE(hashtable_suite_create)
 TEST_SUITE(array_suite_create)
+TEST_SUITE(arena_suite_create)
 TEST_SUITE(identification_suite_create)
 TEST_SUITE(traffic_selector_suite_create)
 TEST_SUITE(threading_suite_create)
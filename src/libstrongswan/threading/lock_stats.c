@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2015 Tobias Brunner
+ * Hochschule fuer Technik Rapperswil
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include "lock_stats.h"
+
+#include <library.h>
+
+#if defined(HAVE_GCC_ATOMIC_OPERATIONS)
+#define stats_add(ptr, val) __atomic_add_fetch(ptr, val, __ATOMIC_RELAXED)
+#elif defined(HAVE_GCC_SYNC_OPERATIONS)
+#define stats_add(ptr, val) __sync_add_and_fetch(ptr, val)
+#endif
+
+#ifdef stats_add
+
+/**
+ * Number of per-site aggregation slots
+ */
+#define LOCK_STATS_SLOTS 128
+
+/**
+ * Number of slots probed on a hash collision before a sample gets dropped
+ */
+#define LOCK_STATS_PROBES 8
+
+/**
+ * Aggregated statistics for a single lock call site
+ */
+typedef struct {
+	/** call site owning this slot, claimed with an atomic swap */
+	void *site;
+	/** number of contended acquisitions at this site */
+	refcount_t contended;
+	/** total time threads waited at this site, in microseconds */
+	refcount_t waited;
+} stat_slot_t;
+
+/**
+ * Slot table, hashed by call site
+ */
+static stat_slot_t slots[LOCK_STATS_SLOTS];
+
+/**
+ * Whether collection is enabled, -1 until the setting has been read
+ */
+static int enabled = -1;
+
+/*
+ * Described in header
+ */
+bool lock_stats_enabled()
+{
+	if (enabled == -1)
+	{
+		if (!lib || !lib->settings)
+		{	/* too early during initialization to tell, keep probing */
+			return FALSE;
+		}
+		enabled = lib->settings->get_bool(lib->settings,
+										  "libstrongswan.lock_stats", FALSE);
+	}
+	return enabled;
+}
+
+/*
+ * Described in header
+ */
+bool lock_stats_start(timeval_t *start)
+{
+	if (!lock_stats_enabled())
+	{
+		return FALSE;
+	}
+	time_monotonic(start);
+	return TRUE;
+}
+
+/*
+ * Described in header
+ */
+void lock_stats_waited(void *site, timeval_t *start)
+{
+	timeval_t end, diff;
+	stat_slot_t *slot;
+	u_int hash, i;
+
+	if (!site)
+	{
+		return;
+	}
+	time_monotonic(&end);
+	timersub(&end, start, &diff);
+
+	hash = ((uintptr_t)site >> 4) % LOCK_STATS_SLOTS;
+	for (i = 0; i < LOCK_STATS_PROBES; i++)
+	{
+		slot = &slots[(hash + i) % LOCK_STATS_SLOTS];
+		if (slot->site != site &&
+			!cas_ptr(&slot->site, NULL, site) && slot->site != site)
+		{	/* slot owned by another site, probe the next one */
+			continue;
+		}
+		ref_get(&slot->contended);
+		stats_add(&slot->waited, diff.tv_sec * 1000000 + diff.tv_usec);
+		return;
+	}
+	/* all probed slots taken, drop the sample */
+}
+
+/*
+ * Described in header
+ */
+bool lock_stats_get(int *index, void **site, u_int *contended, u_int *waited)
+{
+	stat_slot_t *slot;
+
+	while (*index < LOCK_STATS_SLOTS)
+	{
+		slot = &slots[(*index)++];
+		if (slot->site)
+		{
+			*site = slot->site;
+			*contended = ref_cur(&slot->contended);
+			*waited = ref_cur(&slot->waited);
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+#else /* !stats_add */
+
+bool lock_stats_enabled()
+{
+	return FALSE;
+}
+
+bool lock_stats_start(timeval_t *start)
+{
+	return FALSE;
+}
+
+void lock_stats_waited(void *site, timeval_t *start)
+{
+}
+
+bool lock_stats_get(int *index, void **site, u_int *contended, u_int *waited)
+{
+	return FALSE;
+}
+
+#endif /* stats_add */
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2015 Tobias Brunner
+ * Hochschule fuer Technik Rapperswil
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/**
+ * @defgroup lock_stats lock_stats
+ * @{ @ingroup threading
+ */
+
+#ifndef THREADING_LOCK_STATS_H_
+#define THREADING_LOCK_STATS_H_
+
+#include <utils/utils.h>
+
+/**
+ * Lightweight lock contention statistics for production use.
+ *
+ * In contrast to the LOCK_PROFILER developer facility, collection is a
+ * runtime option (libstrongswan.lock_stats), only contended acquisitions
+ * pay for sampling, and the aggregated numbers stay queryable while the
+ * daemon runs. Samples are aggregated per lock call site in a fixed table
+ * of atomic counters; sites are raw code addresses to be resolved with
+ * addr2line or a debugger.
+ */
+
+/**
+ * Call site of the current lock operation, used as aggregation key
+ */
+#ifdef __GNUC__
+#define LOCK_SITE() __builtin_return_address(0)
+#else
+#define LOCK_SITE() NULL
+#endif
+
+/**
+ * Check if lock contention statistics are enabled.
+ *
+ * @return			TRUE if samples get collected
+ */
+bool lock_stats_enabled();
+
+/**
+ * Take a timestamp before blocking on a contended lock.
+ *
+ * @param start		receives the timestamp, if enabled
+ * @return			TRUE if enabled and the lock should get sampled
+ */
+bool lock_stats_start(timeval_t *start);
+
+/**
+ * Record a contended lock acquisition that started blocking at start.
+ *
+ * @param site		lock call site, usually LOCK_SITE()
+ * @param start		timestamp taken with lock_stats_start()
+ */
+void lock_stats_waited(void *site, timeval_t *start);
+
+/**
+ * Enumerate the aggregated per-site counters.
+ *
+ * @param index		iteration state, initialize to 0, gets advanced
+ * @param site		receives the lock call site
+ * @param contended	receives the number of contended acquisitions
+ * @param waited	receives the total wait time in us (may wrap)
+ * @return			TRUE if a site was returned, FALSE when done
+ */
+bool lock_stats_get(int *index, void **site, u_int *contended, u_int *waited);
+
+#endif /** THREADING_LOCK_STATS_H_ @} */
@@ -27,6 +27,7 @@
 #include "condvar.h"
 #include "mutex.h"
 #include "lock_profiler.h"
+#include "lock_stats.h"
 
 typedef struct private_mutex_t private_mutex_t;
 typedef struct private_r_mutex_t private_r_mutex_t;
@@ -103,7 +104,22 @@ METHOD(mutex_t, lock, void,
 	int err;
 
 	profiler_start(&this->profile);
-	err = pthread_mutex_lock(&this->mutex);
+	if (pthread_mutex_trylock(&this->mutex) == 0)
+	{	/* uncontended fast path */
+		err = 0;
+	}
+	else
+	{
+		timeval_t start;
+		bool stats;
+
+		stats = lock_stats_start(&start);
+		err = pthread_mutex_lock(&this->mutex);
+		if (stats)
+		{
+			lock_stats_waited(LOCK_SITE(), &start);
+		}
+	}
 	if (err)
 	{
 		DBG1(DBG_LIB, "!!! MUTEX LOCK ERROR: %s !!!", strerror(err));
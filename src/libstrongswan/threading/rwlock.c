@@ -23,9 +23,11 @@
 #include "rwlock.h"
 #include "rwlock_condvar.h"
 #include "thread.h"
+#include "thread_value.h"
 #include "condvar.h"
 #include "mutex.h"
 #include "lock_profiler.h"
+#include "lock_stats.h"
 
 #ifdef __APPLE__
 /* while pthread_rwlock_rdlock(3) says that it supports multiple read locks,
@@ -94,6 +96,222 @@ struct private_rwlock_t {
 	lock_profile_t profile;
 };
 
+#if defined(HAVE_GCC_ATOMIC_OPERATIONS) || defined(HAVE_GCC_SYNC_OPERATIONS)
+#define HAVE_BRLOCK
+
+/**
+ * Number of reader slots of a read-biased lock. Threads hash to a slot
+ * by their ID, approximating per-CPU counters.
+ */
+#define BRLOCK_SLOTS 16
+
+typedef struct private_brlock_t private_brlock_t;
+
+/**
+ * A big-reader variant of the rwlock_t interface. Readers increment one
+ * of several padded slot counters and check a writer flag, so concurrent
+ * readers do not bounce a common cache line. Writers mark the lock and
+ * sweep all slots until they drained, which is considerably more
+ * expensive than with the other implementations.
+ */
+struct private_brlock_t {
+
+	/**
+	 * public functions
+	 */
+	rwlock_t public;
+
+	/**
+	 * reader counts, hashed by thread ID, each on its own cache line
+	 */
+	struct {
+		volatile u_int count;
+		char pad[64 - sizeof(u_int)];
+	} slots[BRLOCK_SLOTS];
+
+	/**
+	 * TRUE while a writer holds or sweeps the lock
+	 */
+	volatile bool writer;
+
+	/**
+	 * mutex for writer coordination and the reader slow path
+	 */
+	mutex_t *mutex;
+
+	/**
+	 * condvar readers and further writers wait on while a writer is active
+	 */
+	condvar_t *readers;
+
+	/**
+	 * condvar the writer waits on while sweeping the reader slots
+	 */
+	condvar_t *drained;
+
+	/**
+	 * per-thread read lock depth, to support recursive read locks while
+	 * a writer sweeps
+	 */
+	thread_value_t *reading;
+};
+
+METHOD(rwlock_t, br_read_lock, void,
+	private_brlock_t *this)
+{
+	volatile u_int *count;
+	uintptr_t reading;
+	bool old;
+
+	reading = (uintptr_t)this->reading->get(this->reading);
+	count = &this->slots[thread_current_id() % BRLOCK_SLOTS].count;
+	/* the counter increment is a full barrier, a writer marking the lock
+	 * afterwards waits for our slot, while we see its mark below */
+	__sync_add_and_fetch(count, 1);
+	if (!reading)
+	{	/* threads already holding a read lock pass even while a writer
+		 * sweeps, as it waits for their slot to drain anyway */
+		while (this->writer)
+		{
+			__sync_sub_and_fetch(count, 1);
+			this->mutex->lock(this->mutex);
+			/* we might have been the reader the writer sweeps for */
+			this->drained->signal(this->drained);
+			old = thread_cancelability(FALSE);
+			while (this->writer)
+			{
+				this->readers->wait(this->readers, this->mutex);
+			}
+			thread_cancelability(old);
+			/* reclaim our slot while holding the mutex, a new writer
+			 * has to take it before marking the lock */
+			__sync_add_and_fetch(count, 1);
+			this->mutex->unlock(this->mutex);
+		}
+	}
+	this->reading->set(this->reading, (void*)(reading + 1));
+}
+
+METHOD(rwlock_t, br_write_lock, void,
+	private_brlock_t *this)
+{
+	bool old;
+	int i;
+
+	this->mutex->lock(this->mutex);
+	old = thread_cancelability(FALSE);
+	while (this->writer)
+	{	/* serialize with the current writer */
+		this->readers->wait(this->readers, this->mutex);
+	}
+	this->writer = TRUE;
+	/* the mark has to hit memory before we inspect the reader slots */
+	__sync_synchronize();
+	for (i = 0; i < BRLOCK_SLOTS; i++)
+	{
+		while (this->slots[i].count)
+		{
+			this->drained->wait(this->drained, this->mutex);
+		}
+	}
+	thread_cancelability(old);
+	this->mutex->unlock(this->mutex);
+}
+
+METHOD(rwlock_t, br_try_write_lock, bool,
+	private_brlock_t *this)
+{
+	bool res = TRUE;
+	int i;
+
+	this->mutex->lock(this->mutex);
+	if (this->writer)
+	{
+		res = FALSE;
+	}
+	else
+	{	/* mark the lock before checking the slots, mirroring the reader
+		 * fast path ordering, and roll back on any active reader */
+		this->writer = TRUE;
+		__sync_synchronize();
+		for (i = 0; i < BRLOCK_SLOTS; i++)
+		{
+			if (this->slots[i].count)
+			{
+				this->writer = FALSE;
+				this->readers->broadcast(this->readers);
+				res = FALSE;
+				break;
+			}
+		}
+	}
+	this->mutex->unlock(this->mutex);
+	return res;
+}
+
+METHOD(rwlock_t, br_unlock, void,
+	private_brlock_t *this)
+{
+	uintptr_t reading;
+
+	reading = (uintptr_t)this->reading->get(this->reading);
+	if (reading)
+	{
+		this->reading->set(this->reading, (void*)(reading - 1));
+		__sync_sub_and_fetch(
+				&this->slots[thread_current_id() % BRLOCK_SLOTS].count, 1);
+		if (this->writer)
+		{	/* wake a writer possibly sweeping our slot */
+			this->mutex->lock(this->mutex);
+			this->drained->signal(this->drained);
+			this->mutex->unlock(this->mutex);
+		}
+	}
+	else
+	{
+		this->mutex->lock(this->mutex);
+		this->writer = FALSE;
+		this->readers->broadcast(this->readers);
+		this->mutex->unlock(this->mutex);
+	}
+}
+
+METHOD(rwlock_t, br_destroy, void,
+	private_brlock_t *this)
+{
+	this->reading->destroy(this->reading);
+	this->drained->destroy(this->drained);
+	this->readers->destroy(this->readers);
+	this->mutex->destroy(this->mutex);
+	free(this);
+}
+
+/**
+ * Create a read-biased big-reader lock
+ */
+static rwlock_t *brlock_create()
+{
+	private_brlock_t *this;
+
+	INIT(this,
+		.public = {
+			.read_lock = _br_read_lock,
+			.write_lock = _br_write_lock,
+			.try_write_lock = _br_try_write_lock,
+			.unlock = _br_unlock,
+			.destroy = _br_destroy,
+		},
+		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+		.readers = condvar_create(CONDVAR_TYPE_DEFAULT),
+		.drained = condvar_create(CONDVAR_TYPE_DEFAULT),
+		.reading = thread_value_create(NULL),
+	);
+
+	return &this->public;
+}
+
+#endif /* HAVE_BRLOCK */
+
 /**
  * private data of condvar
  */
@@ -124,7 +342,22 @@ METHOD(rwlock_t, read_lock, void,
 	int err;
 
 	profiler_start(&this->profile);
-	err = pthread_rwlock_rdlock(&this->rwlock);
+	if (pthread_rwlock_tryrdlock(&this->rwlock) == 0)
+	{	/* uncontended fast path */
+		err = 0;
+	}
+	else
+	{
+		timeval_t start;
+		bool stats;
+
+		stats = lock_stats_start(&start);
+		err = pthread_rwlock_rdlock(&this->rwlock);
+		if (stats)
+		{
+			lock_stats_waited(LOCK_SITE(), &start);
+		}
+	}
 	if (err != 0)
 	{
 		DBG1(DBG_LIB, "!!! RWLOCK READ LOCK ERROR: %s !!!", strerror(err));
@@ -138,7 +371,22 @@ METHOD(rwlock_t, write_lock, void,
 	int err;
 
 	profiler_start(&this->profile);
-	err = pthread_rwlock_wrlock(&this->rwlock);
+	if (pthread_rwlock_trywrlock(&this->rwlock) == 0)
+	{	/* uncontended fast path */
+		err = 0;
+	}
+	else
+	{
+		timeval_t start;
+		bool stats;
+
+		stats = lock_stats_start(&start);
+		err = pthread_rwlock_wrlock(&this->rwlock);
+		if (stats)
+		{
+			lock_stats_waited(LOCK_SITE(), &start);
+		}
+	}
 	if (err != 0)
 	{
 		DBG1(DBG_LIB, "!!! RWLOCK WRITE LOCK ERROR: %s !!!", strerror(err));
@@ -179,6 +427,10 @@ rwlock_t *rwlock_create(rwlock_type_t type)
 {
 	switch (type)
 	{
+#ifdef HAVE_BRLOCK
+		case RWLOCK_TYPE_READ_BIASED:
+			return brlock_create();
+#endif
 		case RWLOCK_TYPE_DEFAULT:
 		default:
 		{
@@ -368,6 +620,10 @@ rwlock_t *rwlock_create(rwlock_type_t type)
 
 	switch (type)
 	{
+#ifdef HAVE_BRLOCK
+		case RWLOCK_TYPE_READ_BIASED:
+			return brlock_create();
+#endif
 		case RWLOCK_TYPE_DEFAULT:
 		default:
 		{
@@ -31,6 +31,10 @@ typedef enum rwlock_type_t rwlock_type_t;
 enum rwlock_type_t {
 	/** default condvar */
 	RWLOCK_TYPE_DEFAULT = 0,
+	/** read-biased lock using per-slot reader counters; shared acquisition
+	 * is very cheap, exclusive acquisition sweeps all slots and is
+	 * considerably more expensive, use for read-mostly data only */
+	RWLOCK_TYPE_READ_BIASED = 1,
 };
 
 /**
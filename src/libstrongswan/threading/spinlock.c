@@ -22,6 +22,21 @@
 #include "mutex.h"
 #include "lock_profiler.h"
 
+#if defined(__linux__) && (defined(HAVE_GCC_ATOMIC_OPERATIONS) || \
+						   defined(HAVE_GCC_SYNC_OPERATIONS))
+#define USE_FUTEX_SPINLOCK
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+ * Maximum number of spin iterations before falling back to a futex wait,
+ * to avoid burning cycles against a preempted lock holder
+ */
+#define SPIN_MAX 1024
+
+#endif /* __linux__ */
+
 typedef struct private_spinlock_t private_spinlock_t;
 
 /**
@@ -34,7 +49,19 @@ struct private_spinlock_t {
 	 */
 	spinlock_t public;
 
-#ifdef HAVE_PTHREAD_SPIN_INIT
+#ifdef USE_FUTEX_SPINLOCK
+
+	/**
+	 * lock state: 0 unlocked, 1 locked, 2 locked with threads sleeping
+	 */
+	volatile int state;
+
+	/**
+	 * profiling info, if enabled (the mutex below does profile itself)
+	 */
+	lock_profile_t profile;
+
+#elif defined(HAVE_PTHREAD_SPIN_INIT)
 
 	/**
 	 * wrapped pthread spin lock
@@ -56,10 +83,48 @@ struct private_spinlock_t {
 #endif /* HAVE_PTHREAD_SPIN_INIT */
 };
 
+#ifdef USE_FUTEX_SPINLOCK
+
+/**
+ * Wait on or wake up threads sleeping on the lock state
+ */
+static void sys_futex(private_spinlock_t *this, int op, int val)
+{
+	syscall(SYS_futex, &this->state, op, val, NULL, NULL, 0);
+}
+
+#endif /* USE_FUTEX_SPINLOCK */
+
 METHOD(spinlock_t, lock, void,
 	private_spinlock_t *this)
 {
-#ifdef HAVE_PTHREAD_SPIN_INIT
+#ifdef USE_FUTEX_SPINLOCK
+	u_int spins = 1, i;
+
+	profiler_start(&this->profile);
+	while (!__sync_bool_compare_and_swap(&this->state, 0, 1))
+	{
+		if (spins <= SPIN_MAX)
+		{	/* spin with exponential backoff, waiting on plain reads to
+			 * keep the cache line shared among the spinning CPUs */
+			for (i = 0; i < spins && this->state != 0; i++)
+			{
+				/* spin */
+			}
+			spins <<= 1;
+			continue;
+		}
+		/* once we sleep we only ever acquire the lock in the contended
+		 * state, so a subsequent unlock() is guaranteed to wake the
+		 * remaining sleepers */
+		while (__sync_lock_test_and_set(&this->state, 2) != 0)
+		{
+			sys_futex(this, FUTEX_WAIT_PRIVATE, 2);
+		}
+		break;
+	}
+	profiler_end(&this->profile);
+#elif defined(HAVE_PTHREAD_SPIN_INIT)
 	int err;
 
 	profiler_start(&this->profile);
@@ -77,7 +142,12 @@ METHOD(spinlock_t, lock, void,
 METHOD(spinlock_t, unlock, void,
 	private_spinlock_t *this)
 {
-#ifdef HAVE_PTHREAD_SPIN_INIT
+#ifdef USE_FUTEX_SPINLOCK
+	if (__sync_fetch_and_and(&this->state, 0) == 2)
+	{	/* wake up one of the sleeping threads */
+		sys_futex(this, FUTEX_WAKE_PRIVATE, 1);
+	}
+#elif defined(HAVE_PTHREAD_SPIN_INIT)
 	int err;
 
 	err = pthread_spin_unlock(&this->spinlock);
@@ -93,7 +163,9 @@ METHOD(spinlock_t, unlock, void,
 METHOD(spinlock_t, destroy, void,
 	private_spinlock_t *this)
 {
-#ifdef HAVE_PTHREAD_SPIN_INIT
+#ifdef USE_FUTEX_SPINLOCK
+	profiler_cleanup(&this->profile);
+#elif defined(HAVE_PTHREAD_SPIN_INIT)
 	profiler_cleanup(&this->profile);
 	pthread_spin_destroy(&this->spinlock);
 #else
@@ -117,7 +189,9 @@ spinlock_t *spinlock_create()
 		},
 	);
 
-#ifdef HAVE_PTHREAD_SPIN_INIT
+#ifdef USE_FUTEX_SPINLOCK
+	profiler_init(&this->profile);
+#elif defined(HAVE_PTHREAD_SPIN_INIT)
 	pthread_spin_init(&this->spinlock, PTHREAD_PROCESS_PRIVATE);
 	profiler_init(&this->profile);
 #else
@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Hochschule fuer Technik Rapperswil
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include "arena.h"
+
+#include <stdlib.h>
+
+typedef struct private_arena_t private_arena_t;
+typedef struct arena_block_t arena_block_t;
+
+/**
+ * Alignment guaranteed for returned memory
+ */
+#define ARENA_ALIGN sizeof(u_int64_t)
+
+/**
+ * A single backing block, allocation data follows the header
+ */
+struct arena_block_t {
+
+	/** next block in the list */
+	arena_block_t *next;
+
+	/** usable bytes following the header */
+	size_t size;
+
+	/** bytes already handed out */
+	size_t used;
+};
+
+/**
+ * Private data of an arena_t object.
+ */
+struct private_arena_t {
+
+	/**
+	 * Public arena_t interface.
+	 */
+	arena_t public;
+
+	/**
+	 * List of backing blocks, current block first
+	 */
+	arena_block_t *blocks;
+
+	/**
+	 * Minimum size of newly allocated blocks
+	 */
+	size_t block_size;
+};
+
+/**
+ * Get the data area of a block
+ */
+static void *block_data(arena_block_t *block)
+{
+	return (char*)(block + 1);
+}
+
+/**
+ * Allocate a new backing block serving at least size bytes
+ */
+static arena_block_t *create_block(private_arena_t *this, size_t size)
+{
+	arena_block_t *block;
+
+	size = max(size, this->block_size);
+	block = malloc(sizeof(arena_block_t) + size);
+	block->size = size;
+	block->used = 0;
+	block->next = this->blocks;
+	this->blocks = block;
+	return block;
+}
+
+METHOD(arena_t, alloc, void*,
+	private_arena_t *this, size_t size)
+{
+	arena_block_t *block;
+	void *ptr;
+
+	size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+	block = this->blocks;
+	if (!block || block->size - block->used < size)
+	{
+		block = create_block(this, size);
+	}
+	ptr = (char*)block_data(block) + block->used;
+	block->used += size;
+	return ptr;
+}
+
+METHOD(arena_t, reset, void,
+	private_arena_t *this)
+{
+	arena_block_t *block, *next, *largest = NULL;
+
+	/* keep the largest block, release the others */
+	for (block = this->blocks; block; block = block->next)
+	{
+		if (!largest || block->size > largest->size)
+		{
+			largest = block;
+		}
+	}
+	for (block = this->blocks; block; block = next)
+	{
+		next = block->next;
+		if (block != largest)
+		{
+			free(block);
+		}
+	}
+	this->blocks = largest;
+	if (largest)
+	{
+		largest->next = NULL;
+		largest->used = 0;
+	}
+}
+
+METHOD(arena_t, destroy, void,
+	private_arena_t *this)
+{
+	arena_block_t *block, *next;
+
+	for (block = this->blocks; block; block = next)
+	{
+		next = block->next;
+		free(block);
+	}
+	free(this);
+}
+
+/**
+ * See header
+ */
+arena_t *arena_create(size_t block_size)
+{
+	private_arena_t *this;
+
+	INIT(this,
+		.public = {
+			.alloc = _alloc,
+			.reset = _reset,
+			.destroy = _destroy,
+		},
+		.block_size = block_size,
+	);
+
+	return &this->public;
+}
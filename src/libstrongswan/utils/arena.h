@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Hochschule fuer Technik Rapperswil
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/**
+ * @defgroup arena arena
+ * @{ @ingroup utils
+ */
+
+#ifndef ARENA_H_
+#define ARENA_H_
+
+typedef struct arena_t arena_t;
+
+#include <utils/utils.h>
+
+/**
+ * Simple bump allocator for scratch memory with batch lifetime.
+ *
+ * Allocations are served from large blocks by advancing a pointer, there
+ * is no way to free an individual allocation. Instead, reset() recycles
+ * all memory at once, keeping the largest block for reuse. This makes
+ * repeated allocation patterns, such as per-message scratch buffers, run
+ * mostly malloc-free after warmup.
+ *
+ * An arena is not thread-safe, each user needs its own instance.
+ */
+struct arena_t {
+
+	/**
+	 * Allocate a block of memory from the arena.
+	 *
+	 * The returned memory is aligned suitably for any type, but not
+	 * initialized. It stays valid until reset() or destroy().
+	 *
+	 * @param size		size to allocate, in bytes
+	 * @return			allocated memory
+	 */
+	void *(*alloc)(arena_t *this, size_t size);
+
+	/**
+	 * Release all allocations at once, keeping memory for reuse.
+	 */
+	void (*reset)(arena_t *this);
+
+	/**
+	 * Destroy an arena_t, releasing all memory.
+	 */
+	void (*destroy)(arena_t *this);
+};
+
+/**
+ * Create an arena instance.
+ *
+ * @param block_size	minimum size of allocated blocks, in bytes
+ * @return				arena_t instance
+ */
+arena_t *arena_create(size_t block_size);
+
+#endif /** ARENA_H_ @}*/
@@ -815,11 +815,13 @@ static inline void sipround(u_int64_t *v0, u_int64_t *v1, u_int64_t *v2,
 }
 
 static inline void sipcompress(u_int64_t *v0, u_int64_t *v1, u_int64_t *v2,
-							   u_int64_t *v3, u_int64_t m)
+							   u_int64_t *v3, u_int64_t m, int c)
 {
 	*v3 ^= m;
-	sipround(v0, v1, v2, v3);
-	sipround(v0, v1, v2, v3);
+	while (c--)
+	{
+		sipround(v0, v1, v2, v3);
+	}
 	*v0 ^= m;
 }
 
@@ -853,9 +855,9 @@ static inline u_int64_t siplast(size_t len, u_char *pos)
 }
 
 /**
- * Caculate SipHash-2-4 with an optional first block given as argument.
+ * Caculate SipHash-c-d with an optional first block given as argument.
  */
-static u_int64_t chunk_mac_inc(chunk_t chunk, u_char *key, u_int64_t m)
+static u_int64_t siphash(chunk_t chunk, u_char *key, u_int64_t m, int c, int d)
 {
 	u_int64_t v0, v1, v2, v3, k0, k1;
 	size_t len = chunk.len;
@@ -873,26 +875,35 @@ static u_int64_t chunk_mac_inc(chunk_t chunk, u_char *key, u_int64_t m)
 
 	if (m)
 	{
-		sipcompress(&v0, &v1, &v2, &v3, m);
+		sipcompress(&v0, &v1, &v2, &v3, m, c);
 	}
 
-	/* compression with c = 2 */
+	/* compression rounds */
 	for (; pos != end; pos += 8)
 	{
 		m = sipget(pos);
-		sipcompress(&v0, &v1, &v2, &v3, m);
+		sipcompress(&v0, &v1, &v2, &v3, m, c);
 	}
-	sipcompress(&v0, &v1, &v2, &v3, siplast(len, pos));
+	sipcompress(&v0, &v1, &v2, &v3, siplast(len, pos), c);
 
-	/* finalization with d = 4 */
+	/* finalization rounds */
 	v2 ^= 0xff;
-	sipround(&v0, &v1, &v2, &v3);
-	sipround(&v0, &v1, &v2, &v3);
-	sipround(&v0, &v1, &v2, &v3);
-	sipround(&v0, &v1, &v2, &v3);
+	while (d--)
+	{
+		sipround(&v0, &v1, &v2, &v3);
+	}
 	return v0 ^ v1 ^ v2  ^ v3;
 }
 
+/**
+ * Calculate SipHash-2-4, the conservative parameters recommended for use
+ * as a MAC, with an optional first block given as argument.
+ */
+static u_int64_t chunk_mac_inc(chunk_t chunk, u_char *key, u_int64_t m)
+{
+	return siphash(chunk, key, m, 2, 4);
+}
+
 /**
  * Described in header.
  */
@@ -960,7 +971,7 @@ void chunk_hash_seed()
 u_int32_t chunk_hash_inc(chunk_t chunk, u_int32_t hash)
 {
 	/* we could use a mac of the previous hash, but this is faster */
-	return chunk_mac_inc(chunk, key, ((u_int64_t)hash) << 32 | hash);
+	return siphash(chunk, key, ((u_int64_t)hash) << 32 | hash, 1, 3);
 }
 
 /**
@@ -968,7 +979,10 @@ u_int32_t chunk_hash_inc(chunk_t chunk, u_int32_t hash)
  */
 u_int32_t chunk_hash(chunk_t chunk)
 {
-	return chunk_mac(chunk, key);
+	/* SipHash-1-3: as the key stays secret this is still resistant against
+	 * hash flooding, but about twice as fast on bulk data than the full
+	 * SipHash-2-4 used by chunk_mac() */
+	return siphash(chunk, key, 0, 1, 3);
 }
 
 /**
@@ -15,12 +15,59 @@
 
 #include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include <library.h>
 #include <utils/utils.h>
+#include <collections/hashtable.h>
+#include <threading/rwlock.h>
 
 #include "enum.h"
 
+/**
+ * Only build a sorted index for tables with at least this many names,
+ * smaller tables are faster to scan linearly.
+ */
+#define INDEX_THRESHOLD 8
+
+/**
+ * A name/value pair of a sorted per-table lookup index.
+ */
+typedef struct {
+	/** name, as stored in the enum_name_t table */
+	char *name;
+	/** associated enum value */
+	int val;
+	/** position in table scan order, to break ties between duplicates */
+	int pos;
+} enum_index_entry_t;
+
+/**
+ * Lookup index for a single enum_name_t table, sorted by name.
+ */
+typedef struct {
+	/** sorted entries */
+	enum_index_entry_t *entries;
+	/** number of entries */
+	int count;
+} enum_index_t;
+
+/**
+ * Sentinel for tables not worth indexing.
+ */
+static enum_index_t index_none;
+
+/**
+ * Lookup indexes, enum_name_t* => enum_index_t*. As enum name tables are
+ * static data, indexes are built once on first lookup and never invalidated.
+ */
+static hashtable_t *indexes;
+
+/**
+ * Lock protecting the index table.
+ */
+static rwlock_t *index_lock;
+
 /**
  * See header.
  */
@@ -38,9 +85,10 @@ char *enum_to_name(enum_name_t *e, int val)
 }
 
 /**
- * See header.
+ * Linear scan over all ranges of a table, as used before indexes existed
+ * and for tables below the index threshold.
  */
-bool enum_from_name_as_int(enum_name_t *e, const char *name, int *val)
+static bool from_name_linear(enum_name_t *e, const char *name, int *val)
 {
 	do
 	{
@@ -48,17 +96,177 @@ bool enum_from_name_as_int(enum_name_t *e, const char *name, int *val)
 
 		for (i = 0; i < count; i++)
 		{
-			if (name && strcaseeq(name, e->names[i]))
+			if (name && e->names[i] && strcaseeq(name, e->names[i]))
 			{
 				*val = e->first + i;
 				return TRUE;
 			}
 		}
 	}
-	while ((e = e->next));
+	while ((e = e->next) && e != ENUM_FLAG_MAGIC);
 	return FALSE;
 }
 
+/**
+ * qsort() comparator sorting index entries by name, case-insensitively.
+ * Entries with equal names keep their relative table order, so lookups
+ * resolve duplicates to the same entry a linear scan would.
+ */
+static int index_entry_sort(const void *a, const void *b)
+{
+	const enum_index_entry_t *ea = a, *eb = b;
+	int res;
+
+	res = strcasecmp(ea->name, eb->name);
+	if (res == 0)
+	{
+		return ea->pos - eb->pos;
+	}
+	return res;
+}
+
+/**
+ * Build the sorted index for the given table, returns the sentinel for
+ * tables below the threshold.
+ */
+static enum_index_t *build_index(enum_name_t *e)
+{
+	enum_index_t *index;
+	enum_name_t *range;
+	int i, count = 0;
+
+	for (range = e; range; range = range->next)
+	{
+		count += range->last - range->first + 1;
+	}
+	if (count < INDEX_THRESHOLD)
+	{
+		return &index_none;
+	}
+	INIT(index,
+		.entries = calloc(count, sizeof(enum_index_entry_t)),
+	);
+	for (range = e; range; range = range->next)
+	{
+		for (i = 0; i <= range->last - range->first; i++)
+		{
+			if (range->names[i])
+			{
+				index->entries[index->count].name = range->names[i];
+				index->entries[index->count].val = range->first + i;
+				index->entries[index->count].pos = index->count;
+				index->count++;
+			}
+		}
+	}
+	qsort(index->entries, index->count, sizeof(enum_index_entry_t),
+		  index_entry_sort);
+	return index;
+}
+
+/**
+ * Binary search the given index for a name.
+ */
+static bool index_lookup(enum_index_t *index, const char *name, int *val)
+{
+	int lo = 0, hi = index->count - 1, mid, res;
+
+	while (lo <= hi)
+	{
+		mid = (lo + hi) / 2;
+		res = strcasecmp(name, index->entries[mid].name);
+		if (res == 0)
+		{	/* resolve duplicates to the first table entry */
+			while (mid > 0 &&
+				   strcaseeq(name, index->entries[mid - 1].name))
+			{
+				mid--;
+			}
+			*val = index->entries[mid].val;
+			return TRUE;
+		}
+		if (res < 0)
+		{
+			hi = mid - 1;
+		}
+		else
+		{
+			lo = mid + 1;
+		}
+	}
+	return FALSE;
+}
+
+/**
+ * See header.
+ */
+bool enum_from_name_as_int(enum_name_t *e, const char *name, int *val)
+{
+	enum_index_t *index;
+
+	if (!name)
+	{
+		return FALSE;
+	}
+	if (!indexes || e->next == ENUM_FLAG_MAGIC)
+	{	/* before utils_init(), or a flag table with an abused next pointer */
+		return from_name_linear(e, name, val);
+	}
+	index_lock->read_lock(index_lock);
+	index = indexes->get(indexes, e);
+	index_lock->unlock(index_lock);
+	if (!index)
+	{
+		index_lock->write_lock(index_lock);
+		index = indexes->get(indexes, e);
+		if (!index)
+		{
+			index = build_index(e);
+			indexes->put(indexes, e, index);
+		}
+		index_lock->unlock(index_lock);
+	}
+	if (index == &index_none)
+	{
+		return from_name_linear(e, name, val);
+	}
+	return index_lookup(index, name, val);
+}
+
+/**
+ * See header.
+ */
+void enum_names_init()
+{
+	indexes = hashtable_create(hashtable_hash_ptr, hashtable_equals_ptr, 8);
+	index_lock = rwlock_create(RWLOCK_TYPE_DEFAULT);
+}
+
+/**
+ * See header.
+ */
+void enum_names_deinit()
+{
+	enumerator_t *enumerator;
+	enum_index_t *index;
+	hashtable_t *table;
+
+	table = indexes;
+	indexes = NULL;
+	enumerator = table->create_enumerator(table);
+	while (enumerator->enumerate(enumerator, NULL, &index))
+	{
+		if (index != &index_none)
+		{
+			free(index->entries);
+			free(index);
+		}
+	}
+	enumerator->destroy(enumerator);
+	table->destroy(table);
+	index_lock->destroy(index_lock);
+}
+
 /**
  * Get the position of a flag name using offset calculation
  */
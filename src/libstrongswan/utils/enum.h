@@ -187,4 +187,18 @@ char *enum_flags_to_string(enum_name_t *e, u_int val, char *buf, size_t len);
 int enum_printf_hook(printf_hook_data_t *data, printf_hook_spec_t *spec,
 					 const void *const *args);
 
+/**
+ * Initialize the sorted lookup indexes accelerating enum_from_name(),
+ * called by library_init().
+ *
+ * Before initialization, and for small tables, lookups fall back to a
+ * linear scan over the name tables.
+ */
+void enum_names_init();
+
+/**
+ * Free any lookup indexes built for enum_from_name().
+ */
+void enum_names_deinit();
+
 #endif /** ENUM_H_ @}*/
@@ -24,7 +24,9 @@
 #include <utils/utils.h>
 #include <asn1/oid.h>
 #include <asn1/asn1.h>
+#include <collections/hashtable.h>
 #include <crypto/hashers/hasher.h>
+#include <threading/spinlock.h>
 
 ENUM_BEGIN(id_match_names, ID_MATCH_NONE, ID_MATCH_MAX_WILDCARDS,
 	"MATCH_NONE",
@@ -119,8 +121,100 @@ struct private_identification_t {
 	 * Type of this ID.
 	 */
 	id_type_t type;
+
+	/**
+	 * Cached hash over type and encoding, 0 if not yet calculated.
+	 */
+	u_int hash;
+
+	/**
+	 * References to this instance if shared through the intern table,
+	 * protected by the intern lock.
+	 */
+	u_int refs;
+
+	/**
+	 * TRUE if this instance is shared through the intern table.
+	 */
+	bool interned;
 };
 
+/**
+ * Table of interned identities, maps (type, encoding) to the single shared
+ * instance, NULL before identification_init()
+ */
+static hashtable_t *intern_table;
+
+/**
+ * Lock protecting the intern table and the reference counts of its entries
+ */
+static spinlock_t *intern_lock;
+
+/**
+ * Calculate the hash of an identity over its type and encoding
+ */
+static u_int hash_encoding(private_identification_t *this)
+{
+	return chunk_hash_inc(this->encoded,
+						  chunk_hash(chunk_from_thing(this->type)));
+}
+
+/**
+ * Hashtable hash function for interned identities
+ */
+static u_int intern_hash(private_identification_t *key)
+{
+	return key->hash;
+}
+
+/**
+ * Hashtable equals function for interned identities, binary equality only
+ * so e.g. differently cased FQDNs keep their distinct encodings
+ */
+static bool intern_equals(private_identification_t *a,
+						  private_identification_t *b)
+{
+	if (a->type != b->type)
+	{
+		return FALSE;
+	}
+	if (!a->encoded.len)
+	{	/* e.g. ID_ANY, chunk_equals() does not consider empty chunks equal */
+		return !b->encoded.len;
+	}
+	return chunk_equals(a->encoded, b->encoded);
+}
+
+/**
+ * Replace a newly created identity by the interned shared instance, or
+ * register it as such. Consumes the passed instance.
+ */
+static identification_t *intern(private_identification_t *this)
+{
+	private_identification_t *found;
+
+	this->hash = hash_encoding(this);
+	if (!intern_lock)
+	{	/* created before library initialization, stays private */
+		return &this->public;
+	}
+	intern_lock->lock(intern_lock);
+	found = intern_table->get(intern_table, this);
+	if (found)
+	{
+		found->refs++;
+		intern_lock->unlock(intern_lock);
+		chunk_free(&this->encoded);
+		free(this);
+		return &found->public;
+	}
+	this->interned = TRUE;
+	this->refs = 1;
+	intern_table->put(intern_table, this, this);
+	intern_lock->unlock(intern_lock);
+	return &this->public;
+}
+
 /**
  * Enumerator over RDNs
  */
@@ -579,9 +673,27 @@ METHOD(identification_t, contains_wildcards_memchr, bool,
 	return memchr(this->encoded.ptr, '*', this->encoded.len) != NULL;
 }
 
+METHOD(identification_t, hash_, u_int,
+	private_identification_t *this, u_int inc)
+{
+	if (inc)
+	{
+		return chunk_hash_inc(this->encoded, inc);
+	}
+	if (!this->hash)
+	{	/* benign race, both threads calculate the same value */
+		this->hash = hash_encoding(this);
+	}
+	return this->hash;
+}
+
 METHOD(identification_t, equals_binary, bool,
 	private_identification_t *this, identification_t *other)
 {
+	if (&this->public == other)
+	{	/* interned identities are equal iff they are the same instance */
+		return TRUE;
+	}
 	if (this->type == other->get_type(other))
 	{
 		if (this->type == ID_ANY)
@@ -684,14 +796,23 @@ static bool compare_dn(chunk_t t_dn, chunk_t o_dn, int *wc)
 METHOD(identification_t, equals_dn, bool,
 	private_identification_t *this, identification_t *other)
 {
+	if (&this->public == other)
+	{
+		return TRUE;
+	}
 	return compare_dn(this->encoded, other->get_encoding(other), NULL);
 }
 
 METHOD(identification_t, equals_strcasecmp,  bool,
 	private_identification_t *this, identification_t *other)
 {
-	chunk_t encoded = other->get_encoding(other);
+	chunk_t encoded;
 
+	if (&this->public == other)
+	{
+		return TRUE;
+	}
+	encoded = other->get_encoding(other);
 	/* we do some extra sanity checks to check for invalid IDs with a
 	 * terminating null in it. */
 	if (this->encoded.len == encoded.len &&
@@ -865,8 +986,16 @@ int identification_printf_hook(printf_hook_data_t *data,
 METHOD(identification_t, clone_, identification_t*,
 	private_identification_t *this)
 {
-	private_identification_t *clone = malloc_thing(private_identification_t);
+	private_identification_t *clone;
 
+	if (this->interned && intern_lock)
+	{	/* shared instances are immutable, just take another reference */
+		intern_lock->lock(intern_lock);
+		this->refs++;
+		intern_lock->unlock(intern_lock);
+		return &this->public;
+	}
+	clone = malloc_thing(private_identification_t);
 	memcpy(clone, this, sizeof(private_identification_t));
 	if (this->encoded.len)
 	{
@@ -878,6 +1007,17 @@ METHOD(identification_t, clone_, identification_t*,
 METHOD(identification_t, destroy, void,
 	private_identification_t *this)
 {
+	if (this->interned && intern_lock)
+	{
+		intern_lock->lock(intern_lock);
+		if (--this->refs)
+		{
+			intern_lock->unlock(intern_lock);
+			return;
+		}
+		intern_table->remove(intern_table, this);
+		intern_lock->unlock(intern_lock);
+	}
 	chunk_free(&this->encoded);
 	free(this);
 }
@@ -893,6 +1033,7 @@ static private_identification_t *identification_create(id_type_t type)
 		.public = {
 			.get_encoding = _get_encoding,
 			.get_type = _get_type,
+			.hash = _hash_,
 			.create_part_enumerator = _create_part_enumerator,
 			.clone = _clone_,
 			.destroy = _destroy,
@@ -1019,12 +1160,12 @@ identification_t *identification_create_from_string(char *string)
 	this = create_from_string_with_prefix_type(string);
 	if (this)
 	{
-		return &this->public;
+		return intern(this);
 	}
 	this = create_from_string_with_num_type(string);
 	if (this)
 	{
-		return &this->public;
+		return intern(this);
 	}
 	if (strchr(string, '=') != NULL)
 	{
@@ -1041,7 +1182,7 @@ identification_t *identification_create_from_string(char *string)
 			this = identification_create(ID_KEY_ID);
 			this->encoded = chunk_from_str(strdup(string));
 		}
-		return &this->public;
+		return intern(this);
 	}
 	else if (strchr(string, '@') == NULL)
 	{
@@ -1055,7 +1196,7 @@ identification_t *identification_create_from_string(char *string)
 		{
 			/* any ID will be accepted */
 			this = identification_create(ID_ANY);
-			return &this->public;
+			return intern(this);
 		}
 		else
 		{
@@ -1074,7 +1215,7 @@ identification_t *identification_create_from_string(char *string)
 					this = identification_create(ID_FQDN);
 					this->encoded = chunk_from_str(strdup(string));
 				}
-				return &this->public;
+				return intern(this);
 			}
 			else
 			{
@@ -1091,7 +1232,7 @@ identification_t *identification_create_from_string(char *string)
 					this = identification_create(ID_KEY_ID);
 					this->encoded = chunk_from_str(strdup(string));
 				}
-				return &this->public;
+				return intern(this);
 			}
 		}
 	}
@@ -1104,26 +1245,26 @@ identification_t *identification_create_from_string(char *string)
 			{
 				this = identification_create(ID_KEY_ID);
 				this->encoded = chunk_from_hex(chunk_from_str(string + 1), NULL);
-				return &this->public;
+				return intern(this);
 			}
 			else if (*string == '@')
 			{
 				this = identification_create(ID_USER_FQDN);
 				this->encoded = chunk_clone(chunk_from_str(string + 1));
-				return &this->public;
+				return intern(this);
 			}
 			else
 			{
 				this = identification_create(ID_FQDN);
 				this->encoded = chunk_clone(chunk_from_str(string));
-				return &this->public;
+				return intern(this);
 			}
 		}
 		else
 		{
 			this = identification_create(ID_RFC822_ADDR);
 			this->encoded = chunk_from_str(strdup(string));
-			return &this->public;
+			return intern(this);
 		}
 	}
 }
@@ -1160,7 +1301,7 @@ identification_t *identification_create_from_encoding(id_type_t type,
 	{
 		this->encoded = chunk_clone(encoded);
 	}
-	return &(this->public);
+	return intern(this);
 }
 
 /*
@@ -1188,7 +1329,31 @@ identification_t *identification_create_from_sockaddr(sockaddr_t *sockaddr)
 		{
 			private_identification_t *this = identification_create(ID_ANY);
 
-			return &(this->public);
+			return intern(this);
 		}
 	}
 }
+
+/*
+ * Described in header.
+ */
+void identification_init()
+{
+	intern_table = hashtable_create_flat((hashtable_hash_t)intern_hash,
+										 (hashtable_equals_t)intern_equals, 32);
+	intern_lock = spinlock_create();
+}
+
+/*
+ * Described in header.
+ */
+void identification_deinit()
+{
+	spinlock_t *lock = intern_lock;
+
+	/* identities outliving the library keep working, but private */
+	intern_lock = NULL;
+	lock->destroy(lock);
+	intern_table->destroy(intern_table);
+	intern_table = NULL;
+}
@@ -226,6 +226,17 @@ struct identification_t {
 	 */
 	bool (*equals) (identification_t *this, identification_t *other);
 
+	/**
+	 * Get a hash of this identity, suitable for hash tables.
+	 *
+	 * The hash over type and encoding is calculated just once per identity
+	 * and cached, making repeated table lookups cheap.
+	 *
+	 * @param inc		hash value to append this identity to, 0 to start over
+	 * @return 			hash value
+	 */
+	u_int (*hash) (identification_t *this, u_int inc);
+
 	/**
 	 * Check if an ID matches a wildcard ID.
 	 *
@@ -353,4 +364,19 @@ identification_t * identification_create_from_sockaddr(sockaddr_t *sockaddr);
 int identification_printf_hook(printf_hook_data_t *data,
 							printf_hook_spec_t *spec, const void *const *args);
 
+/**
+ * Initialize the identity interning table, called by library_init().
+ *
+ * Once initialized, the constructors above return a shared immutable
+ * instance per distinct identity, making equals() a pointer comparison
+ * on the fast path and avoiding repeated parsing and allocation during
+ * config matching.
+ */
+void identification_init();
+
+/**
+ * Deinitialize the identity interning table, called by library_deinit().
+ */
+void identification_deinit();
+
 #endif /** IDENTIFICATION_H_ @}*/
@@ -169,6 +169,17 @@ static bool enabled = FALSE;
  */
 static thread_value_t *thread_disabled;
 
+/**
+ * Sampling rate, record a backtrace every sample_rate'th allocation only.
+ * 0 tracks every allocation with poison patterns, as before.
+ */
+static u_int sample_rate = 0;
+
+/**
+ * Allocations seen since sampling was enabled
+ */
+static refcount_t sample_counter = 0;
+
 /**
  * Installs the malloc hooks, enables leak detection
  */
@@ -651,6 +662,10 @@ static int print_traces(private_leak_detective_t *this,
 	lock->lock(lock);
 	for (hdr = first_header.next; hdr != NULL; hdr = hdr->next)
 	{
+		if (!hdr->backtrace)
+		{	/* allocation not sampled, no backtrace to group it by */
+			continue;
+		}
 		if (whitelisted &&
 			hdr->backtrace->contains_function(hdr->backtrace,
 											  whitelist, countof(whitelist)))
@@ -690,8 +705,8 @@ static int print_traces(private_leak_detective_t *this,
 			{
 				if (!thresh_count || entry->count >= thresh_count)
 				{
-					this->report_cb(this->report_data, entry->count,
-									entry->bytes, entry->backtrace, detailed);
+					cb(user, entry->count, entry->bytes, entry->backtrace,
+					   detailed);
 				}
 			}
 		}
@@ -745,6 +760,18 @@ METHOD(leak_detective_t, set_state, bool,
 	return enable_thread(enable);
 }
 
+METHOD(leak_detective_t, set_sampling, void,
+	private_leak_detective_t *this, u_int rate)
+{
+	sample_rate = rate;
+}
+
+METHOD(leak_detective_t, get_sampling, u_int,
+	private_leak_detective_t *this)
+{
+	return sample_rate;
+}
+
 METHOD(leak_detective_t, usage, void,
 	private_leak_detective_t *this, leak_detective_report_cb_t cb,
 	leak_detective_summary_cb_t scb, void *user)
@@ -784,13 +811,26 @@ HOOK(void*, malloc, size_t bytes)
 
 	hdr = real_malloc(sizeof(memory_header_t) + bytes + sizeof(memory_tail_t));
 	tail = ((void*)hdr) + bytes + sizeof(memory_header_t);
-	/* set to something which causes crashes */
-	memset(hdr, MEMORY_ALLOC_PATTERN,
-		   sizeof(memory_header_t) + bytes + sizeof(memory_tail_t));
+	if (sample_rate)
+	{	/* sampling: skip the poison patterns, backtrace every Nth only */
+		hdr->backtrace = NULL;
+		if (ref_get(&sample_counter) % sample_rate == 0)
+		{
+			before = enable_thread(FALSE);
+			hdr->backtrace = backtrace_create(2);
+			enable_thread(before);
+		}
+	}
+	else
+	{
+		/* set to something which causes crashes */
+		memset(hdr, MEMORY_ALLOC_PATTERN,
+			   sizeof(memory_header_t) + bytes + sizeof(memory_tail_t));
 
-	before = enable_thread(FALSE);
-	hdr->backtrace = backtrace_create(2);
-	enable_thread(before);
+		before = enable_thread(FALSE);
+		hdr->backtrace = backtrace_create(2);
+		enable_thread(before);
+	}
 
 	hdr->magic = MEMORY_HEADER_MAGIC;
 	hdr->bytes = bytes;
@@ -871,12 +911,21 @@ HOOK(void, free, void *ptr)
 	{
 		remove_hdr(hdr);
 
-		hdr->backtrace->destroy(hdr->backtrace);
-
-		/* clear MAGIC, set mem to something remarkable */
-		memset(hdr, MEMORY_FREE_PATTERN,
-			   sizeof(memory_header_t) + hdr->bytes + sizeof(memory_tail_t));
+		if (hdr->backtrace)
+		{
+			hdr->backtrace->destroy(hdr->backtrace);
+		}
 
+		if (!sample_rate)
+		{
+			/* clear MAGIC, set mem to something remarkable */
+			memset(hdr, MEMORY_FREE_PATTERN,
+				   sizeof(memory_header_t) + hdr->bytes + sizeof(memory_tail_t));
+		}
+		else
+		{	/* clear MAGIC only, a stale header could alias a new one */
+			hdr->magic = 0;
+		}
 		real_free(hdr);
 	}
 	enable_thread(before);
@@ -936,8 +985,15 @@ HOOK(void*, realloc, void *old, size_t bytes)
 	hdr->bytes = bytes;
 
 	before = enable_thread(FALSE);
-	hdr->backtrace->destroy(hdr->backtrace);
-	hdr->backtrace = backtrace_create(2);
+	if (hdr->backtrace)
+	{
+		hdr->backtrace->destroy(hdr->backtrace);
+		hdr->backtrace = NULL;
+	}
+	if (!sample_rate || ref_get(&sample_counter) % sample_rate == 0)
+	{
+		hdr->backtrace = backtrace_create(2);
+	}
 	enable_thread(before);
 
 	add_hdr(hdr);
@@ -969,6 +1025,8 @@ leak_detective_t *leak_detective_create()
 			.usage = _usage,
 			.leaks = _leaks,
 			.set_state = _set_state,
+			.set_sampling = _set_sampling,
+			.get_sampling = _get_sampling,
 			.destroy = _destroy,
 		},
 	);
@@ -978,6 +1036,10 @@ leak_detective_t *leak_detective_create()
 		free(this);
 		return NULL;
 	}
+	if (getenv("LEAK_DETECTIVE_SAMPLING") != NULL)
+	{
+		sample_rate = atoi(getenv("LEAK_DETECTIVE_SAMPLING"));
+	}
 
 	lock = spinlock_create();
 	thread_disabled = thread_value_create(NULL);
@@ -99,6 +99,27 @@ struct leak_detective_t {
 	 */
 	bool (*set_state)(leak_detective_t *this, bool enabled);
 
+	/**
+	 * Set the allocation sampling rate.
+	 *
+	 * With a non-zero rate, poison patterns are skipped and only every
+	 * rate'th allocation captures a backtrace, making the hooks cheap
+	 * enough to stay enabled on production gateways to track slow leaks.
+	 * A rate of 0 restores exhaustive tracking. The initial rate may be
+	 * set with the LEAK_DETECTIVE_SAMPLING environment variable.
+	 *
+	 * @param rate			record a backtrace every rate'th allocation, 0 for
+	 *						every allocation
+	 */
+	void (*set_sampling)(leak_detective_t *this, u_int rate);
+
+	/**
+	 * Get the current allocation sampling rate.
+	 *
+	 * @return				sampling rate, 0 if tracking exhaustively
+	 */
+	u_int (*get_sampling)(leak_detective_t *this);
+
 	/**
 	 * Destroy a leak_detective instance.
 	 */
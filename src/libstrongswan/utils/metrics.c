@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Hochschule fuer Technik Rapperswil
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#include "metrics.h"
+
+#include <threading/thread_value.h>
+#include <threading/spinlock.h>
+#include <collections/linked_list.h>
+
+ENUM(metric_names, METRIC_PACKETS_RECEIVED, METRIC_JOB_WAIT_LOW_US,
+	"packets-received",
+	"exchanges-processed",
+	"retransmits",
+	"jobs-queued",
+	"jobs-executed",
+	"ike-sas-created",
+	"ike-sas-destroyed",
+	"watchdog-warnings",
+	"scheduler-lag-us",
+	"job-wait-critical-us",
+	"job-wait-high-us",
+	"job-wait-medium-us",
+	"job-wait-low-us",
+);
+
+typedef struct private_metrics_t private_metrics_t;
+typedef struct counter_block_t counter_block_t;
+
+/**
+ * Private data of an metrics_t object.
+ */
+struct private_metrics_t {
+
+	/**
+	 * Public metrics_t interface.
+	 */
+	metrics_t public;
+
+	/**
+	 * Per-thread counter block, counter_block_t
+	 */
+	thread_value_t *block;
+
+	/**
+	 * All live counter blocks, counter_block_t
+	 */
+	linked_list_t *blocks;
+
+	/**
+	 * Counters inherited from terminated threads
+	 */
+	u_int64_t retired[METRIC_MAX];
+
+	/**
+	 * Lock protecting blocks and retired
+	 */
+	spinlock_t *lock;
+};
+
+/**
+ * Counter block owned by a single thread
+ */
+struct counter_block_t {
+
+	/** counter values, written by the owning thread only */
+	u_int64_t values[METRIC_MAX];
+
+	/** registry the block is accounted in */
+	private_metrics_t *metrics;
+};
+
+/**
+ * Thread termination cleanup, fold the block into the retired counters
+ */
+static void retire_block(counter_block_t *block)
+{
+	private_metrics_t *this = block->metrics;
+	int i;
+
+	this->lock->lock(this->lock);
+	this->blocks->remove(this->blocks, block, NULL);
+	for (i = 0; i < METRIC_MAX; i++)
+	{
+		this->retired[i] += block->values[i];
+	}
+	this->lock->unlock(this->lock);
+	free(block);
+}
+
+METHOD(metrics_t, add, void,
+	private_metrics_t *this, metric_t metric, u_int64_t value)
+{
+	counter_block_t *block;
+
+	block = this->block->get(this->block);
+	if (!block)
+	{
+		INIT(block,
+			.metrics = this,
+		);
+		this->lock->lock(this->lock);
+		this->blocks->insert_last(this->blocks, block);
+		this->lock->unlock(this->lock);
+		this->block->set(this->block, block);
+	}
+	block->values[metric] += value;
+}
+
+METHOD(metrics_t, increment, void,
+	private_metrics_t *this, metric_t metric)
+{
+	add(this, metric, 1);
+}
+
+METHOD(metrics_t, get, u_int64_t,
+	private_metrics_t *this, metric_t metric)
+{
+	enumerator_t *enumerator;
+	counter_block_t *block;
+	u_int64_t sum;
+
+	this->lock->lock(this->lock);
+	sum = this->retired[metric];
+	enumerator = this->blocks->create_enumerator(this->blocks);
+	while (enumerator->enumerate(enumerator, &block))
+	{
+		sum += block->values[metric];
+	}
+	enumerator->destroy(enumerator);
+	this->lock->unlock(this->lock);
+
+	return sum;
+}
+
+METHOD(metrics_t, destroy, void,
+	private_metrics_t *this)
+{
+	/* no cleanup handler runs for threads still alive, free blocks here */
+	this->block->destroy(this->block);
+	this->blocks->destroy_function(this->blocks, free);
+	this->lock->destroy(this->lock);
+	free(this);
+}
+
+/**
+ * See header
+ */
+metrics_t *metrics_create()
+{
+	private_metrics_t *this;
+
+	INIT(this,
+		.public = {
+			.increment = _increment,
+			.add = _add,
+			.get = _get,
+			.destroy = _destroy,
+		},
+		.block = thread_value_create((thread_cleanup_t)retire_block),
+		.blocks = linked_list_create(),
+		.lock = spinlock_create(),
+	);
+
+	return &this->public;
+}
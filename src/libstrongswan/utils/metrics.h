@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Hochschule fuer Technik Rapperswil
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/**
+ * @defgroup metrics metrics
+ * @{ @ingroup utils
+ */
+
+#ifndef METRICS_H_
+#define METRICS_H_
+
+typedef enum metric_t metric_t;
+typedef struct metrics_t metrics_t;
+
+#include <utils/utils.h>
+#include <utils/enum.h>
+
+/**
+ * Monotonic counters maintained in the metrics registry.
+ */
+enum metric_t {
+	/** IKE packets read from the socket */
+	METRIC_PACKETS_RECEIVED,
+	/** exchanges handed to a task manager for processing */
+	METRIC_EXCHANGES_PROCESSED,
+	/** requests retransmitted after a timeout */
+	METRIC_RETRANSMITS,
+	/** jobs queued to the processor */
+	METRIC_JOBS_QUEUED,
+	/** jobs executed by a worker thread */
+	METRIC_JOBS_EXECUTED,
+	/** IKE_SAs created in the manager */
+	METRIC_IKE_SAS_CREATED,
+	/** IKE_SAs checked in for destruction */
+	METRIC_IKE_SAS_DESTROYED,
+	/** watchdog canary measurements exceeding the warn threshold */
+	METRIC_WATCHDOG_WARNINGS,
+	/** cumulative scheduler fire latency seen by the watchdog, in us */
+	METRIC_SCHEDULER_LAG_US,
+	/** cumulative canary job queue wait, in us, in job_priority_t order */
+	METRIC_JOB_WAIT_CRITICAL_US,
+	METRIC_JOB_WAIT_HIGH_US,
+	METRIC_JOB_WAIT_MEDIUM_US,
+	METRIC_JOB_WAIT_LOW_US,
+	METRIC_MAX,
+};
+
+/**
+ * Names for metric_t, usable as stable scraping keys.
+ */
+extern enum_name_t *metric_names;
+
+/**
+ * Registry of global numeric counters, lock-free on the update path.
+ *
+ * Each thread increments a private counter block; blocks get aggregated
+ * only when a counter is read, so instrumentation points on hot paths
+ * cost a single uncontended memory increment.
+ */
+struct metrics_t {
+
+	/**
+	 * Increment a counter by one, lock-free after the first call per thread.
+	 *
+	 * @param metric	counter to increment
+	 */
+	void (*increment)(metrics_t *this, metric_t metric);
+
+	/**
+	 * Add an arbitrary value to a counter, lock-free as well.
+	 *
+	 * Useful for cumulative counters, such as total latency in us.
+	 *
+	 * @param metric	counter to add to
+	 * @param value		value to add
+	 */
+	void (*add)(metrics_t *this, metric_t metric, u_int64_t value);
+
+	/**
+	 * Get the aggregated value of a counter over all threads.
+	 *
+	 * Values of terminated threads are retained, the result is monotonic.
+	 *
+	 * @param metric	counter to query
+	 * @return			sum over all thread-local counters
+	 */
+	u_int64_t (*get)(metrics_t *this, metric_t metric);
+
+	/**
+	 * Destroy a metrics_t.
+	 */
+	void (*destroy)(metrics_t *this);
+};
+
+/**
+ * Create a metrics registry.
+ *
+ * @return				metrics_t instance
+ */
+metrics_t *metrics_create();
+
+#endif /** METRICS_H_ @}*/
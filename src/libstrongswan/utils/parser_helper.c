@@ -23,6 +23,7 @@
 
 typedef struct private_parser_helper_t private_parser_helper_t;
 typedef struct parser_helper_file_t parser_helper_file_t;
+typedef struct parser_helper_include_t parser_helper_include_t;
 
 struct private_parser_helper_t {
 
@@ -36,12 +37,35 @@ struct private_parser_helper_t {
 	 */
 	array_t *files;
 
+	/**
+	 * Processed include patterns, as parser_helper_include_t.
+	 */
+	array_t *includes;
+
 	/**
 	 * Helper for parsing strings.
 	 */
 	bio_writer_t *writer;
 };
 
+struct parser_helper_include_t {
+
+	/**
+	 * Resolved include pattern
+	 */
+	char *pattern;
+
+	/**
+	 * Names of the files opened for this pattern, as char*.
+	 */
+	array_t *names;
+
+	/**
+	 * Parser scope the inclusion happened in, NULL if unknown.
+	 */
+	char *scope;
+};
+
 struct parser_helper_file_t {
 
 	/**
@@ -58,8 +82,24 @@ struct parser_helper_file_t {
 	 * Enumerator of paths matching the most recent inclusion pattern.
 	 */
 	enumerator_t *matches;
+
+	/**
+	 * Tracking data for the most recent inclusion pattern.
+	 */
+	parser_helper_include_t *include;
 };
 
+/**
+ * Destroy the given include data.
+ */
+static void parser_helper_include_destroy(parser_helper_include_t *this)
+{
+	free(this->pattern);
+	free(this->scope);
+	array_destroy_function(this->names, (void*)free, NULL);
+	free(this);
+}
+
 /**
  * Destroy the given file data.
  */
@@ -114,6 +154,11 @@ METHOD(parser_helper_t, file_next, FILE*,
 
 			if (next->file)
 			{
+				if (file->include)
+				{
+					array_insert_create(&file->include->names, ARRAY_TAIL,
+										strdup(name));
+				}
 				array_insert(this->files, ARRAY_TAIL, next);
 				return next->file;
 			}
@@ -122,6 +167,7 @@ METHOD(parser_helper_t, file_next, FILE*,
 		}
 		file->matches->destroy(file->matches);
 		file->matches = NULL;
+		file->include = NULL;
 	}
 	return NULL;
 }
@@ -133,6 +179,7 @@ METHOD(parser_helper_t, file_include, void,
 	char pat[PATH_MAX];
 
 	array_get(this->files, ARRAY_TAIL, &file);
+	file->include = NULL;
 	if (!pattern || !*pattern)
 	{
 		PARSER_DBG1(&this->public, "no include pattern specified, ignored");
@@ -163,6 +210,13 @@ METHOD(parser_helper_t, file_include, void,
 		free(dir);
 	}
 
+	INIT(file->include,
+		.pattern = strdup(pat),
+		.scope = this->public.get_scope ?
+					this->public.get_scope(this->public.context) : NULL,
+	);
+	array_insert(this->includes, ARRAY_TAIL, file->include);
+
 	file->matches = enumerator_create_glob(pat);
 	if (!file->matches)
 	{	/* if glob(3) is not available, try to load pattern directly */
@@ -170,6 +224,26 @@ METHOD(parser_helper_t, file_include, void,
 	}
 }
 
+/**
+ * Enumerator filter to expose the pattern and file names of an include.
+ */
+static bool include_filter(void *unused, parser_helper_include_t **include,
+						   char **pattern, void *dummy, array_t **names,
+						   void *dummy2, char **scope)
+{
+	*pattern = (*include)->pattern;
+	*names = (*include)->names;
+	*scope = (*include)->scope;
+	return TRUE;
+}
+
+METHOD(parser_helper_t, create_include_enumerator, enumerator_t*,
+	private_parser_helper_t *this)
+{
+	return enumerator_create_filter(array_create_enumerator(this->includes),
+									(void*)include_filter, NULL, NULL);
+}
+
 METHOD(parser_helper_t, string_init, void,
 	private_parser_helper_t *this)
 {
@@ -199,6 +273,8 @@ METHOD(parser_helper_t, destroy, void,
 	private_parser_helper_t *this)
 {
 	array_destroy_function(this->files, (void*)parser_helper_file_destroy, NULL);
+	array_destroy_function(this->includes,
+						   (void*)parser_helper_include_destroy, NULL);
 	this->writer->destroy(this->writer);
 	free(this);
 }
@@ -243,12 +319,14 @@ parser_helper_t *parser_helper_create(void *context)
 			.context = context,
 			.file_include = _file_include,
 			.file_next = _file_next,
+			.create_include_enumerator = _create_include_enumerator,
 			.string_init = _string_init,
 			.string_add = _string_add,
 			.string_get = _string_get,
 			.destroy = _destroy,
 		},
 		.files = array_create(0, 0),
+		.includes = array_create(0, 0),
 		.writer = bio_writer_create(0),
 	);
 
@@ -58,6 +58,18 @@ struct parser_helper_t {
 	 */
 	int (*get_lineno)(void *scanner);
 
+	/**
+	 * Optional function to describe the current parser scope (defined by the
+	 * parser, may be NULL).
+	 *
+	 * If set, the returned string is recorded with each include pattern
+	 * processed via file_include() and exposed by create_include_enumerator().
+	 *
+	 * @param context	user defined parser context
+	 * @return			allocated scope description, NULL if unknown
+	 */
+	char *(*get_scope)(const void *context);
+
 	/**
 	 * Resolves the given include pattern, relative to the location of the
 	 * current file.
@@ -94,6 +106,16 @@ struct parser_helper_t {
 	 */
 	FILE *(*file_next)(parser_helper_t *this);
 
+	/**
+	 * Enumerate the resolved include patterns processed via file_include()
+	 * and, for each of them, the names of the files that were actually
+	 * opened, in processing order, and the parser scope the inclusion
+	 * happened in (NULL without a get_scope callback).
+	 *
+	 * @return		enumerator over (char *pattern, array_t *names, char *scope)
+	 */
+	enumerator_t *(*create_include_enumerator)(parser_helper_t *this);
+
 	/**
 	 * Start parsing a string, discards any currently stored data.
 	 */
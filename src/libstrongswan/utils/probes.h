@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Hochschule fuer Technik Rapperswil
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/**
+ * @defgroup probes probes
+ * @{ @ingroup utils
+ */
+
+#ifndef PROBES_H_
+#define PROBES_H_
+
+/**
+ * SystemTap/USDT static tracepoints on daemon hot paths.
+ *
+ * If built with --enable-tracepoints (requires sys/sdt.h from the SystemTap
+ * development package), the PROBE macros emit userspace probe points under
+ * the "strongswan" provider that tools like perf, bpftrace or stap can
+ * attach to on a live daemon. Without the option, the macros compile to
+ * nothing; an enabled but unattached probe is a single nop instruction.
+ */
+
+#ifdef USDT_PROBES
+
+#include <sys/sdt.h>
+
+#define PROBE(name)				DTRACE_PROBE(strongswan, name)
+#define PROBE1(name, a)			DTRACE_PROBE1(strongswan, name, a)
+#define PROBE2(name, a, b)		DTRACE_PROBE2(strongswan, name, a, b)
+#define PROBE3(name, a, b, c)	DTRACE_PROBE3(strongswan, name, a, b, c)
+
+#else /* !USDT_PROBES */
+
+#define PROBE(name)				{}
+#define PROBE1(name, a)			{}
+#define PROBE2(name, a, b)		{}
+#define PROBE3(name, a, b, c)	{}
+
+#endif /* USDT_PROBES */
+
+#endif /** PROBES_H_ @}*/
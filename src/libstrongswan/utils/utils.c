@@ -58,42 +58,29 @@ ENUM(status_names, SUCCESS, NEED_MORE,
 	"NEED_MORE",
 );
 
+#ifdef __GNUC__
+/**
+ * Unaligned 16 byte vector, lowered to SSE2/NEON instructions where the
+ * target supports them, and to plain word operations everywhere else
+ */
+typedef u_int8_t memxor_v16_t __attribute__((vector_size(16), aligned(1),
+											 may_alias));
+#endif
+
 /**
  * Described in header.
  */
 void memxor(u_int8_t dst[], u_int8_t src[], size_t n)
 {
-	int m, i;
+	size_t i = 0;
 
-	/* byte wise XOR until dst aligned */
-	for (i = 0; (uintptr_t)&dst[i] % sizeof(long) && i < n; i++)
-	{
-		dst[i] ^= src[i];
-	}
-	/* try to use words if src shares an aligment with dst */
-	switch (((uintptr_t)&src[i] % sizeof(long)))
+#ifdef __GNUC__
+	/* XOR 16 byte blocks, regardless of alignment */
+	for (; i + sizeof(memxor_v16_t) <= n; i += sizeof(memxor_v16_t))
 	{
-		case 0:
-			for (m = n - sizeof(long); i <= m; i += sizeof(long))
-			{
-				*(long*)&dst[i] ^= *(long*)&src[i];
-			}
-			break;
-		case sizeof(int):
-			for (m = n - sizeof(int); i <= m; i += sizeof(int))
-			{
-				*(int*)&dst[i] ^= *(int*)&src[i];
-			}
-			break;
-		case sizeof(short):
-			for (m = n - sizeof(short); i <= m; i += sizeof(short))
-			{
-				*(short*)&dst[i] ^= *(short*)&src[i];
-			}
-			break;
-		default:
-			break;
+		*(memxor_v16_t*)&dst[i] ^= *(memxor_v16_t*)&src[i];
 	}
+#endif
 	/* byte wise XOR of the rest */
 	for (; i < n; i++)
 	{
@@ -101,6 +88,22 @@ void memxor(u_int8_t dst[], u_int8_t src[], size_t n)
 	}
 }
 
+/**
+ * Described in header.
+ */
+bool memeq_const(const void *x, const void *y, size_t len)
+{
+	const u_char *a = x, *b = y;
+	u_int bad = 0;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+	{
+		bad |= a[i] != b[i];
+	}
+	return !bad;
+}
+
 /**
  * Described in header.
  */
@@ -792,6 +795,7 @@ void utils_init()
 #endif
 
 	strerror_init();
+	enum_names_init();
 }
 
 /**
@@ -809,6 +813,7 @@ void utils_deinit()
 #endif
 
 	strerror_deinit();
+	enum_names_deinit();
 }
 
 /**
@@ -184,6 +184,18 @@ static inline bool memeq(const void *x, const void *y, size_t len)
 	return memcmp(x, y, len) == 0;
 }
 
+/**
+ * Same as memeq(), but with a runtime that does not depend on the contents,
+ * i.e. does not bail out at the first mismatching byte. Use this to compare
+ * MACs/ICVs and other authentication tags to avoid timing side-channels.
+ *
+ * @param x			first blob to compare
+ * @param y			second blob to compare
+ * @param len		number of bytes to compare
+ * @return			TRUE if the blobs are equal
+ */
+bool memeq_const(const void *x, const void *y, size_t len);
+
 /**
  * Calling memcpy() with NULL pointers, even with n == 0, results in undefined
  * behavior according to the C standard.  This version is guaranteed to not
@@ -16,6 +16,7 @@
 #include "tls.h"
 
 #include <utils/debug.h>
+#include <bio/bio_writer.h>
 
 #include "tls_protection.h"
 #include "tls_compression.h"
@@ -182,12 +183,47 @@ struct private_tls_t {
 	tls_record_t head;
 };
 
+/**
+ * Session cache shared by all EAP-TLS/TTLS/PEAP instances
+ */
+static tls_cache_t *eap_cache;
+
+/**
+ * Number of users of libtls
+ */
+static refcount_t libtls_users;
+
 /**
  * Described in header.
  */
 void libtls_init(void)
 {
-	/* empty */
+	u_int sessions;
+
+	if (ref_get(&libtls_users) == 1)
+	{
+		lib->settings->add_fallback(lib->settings, "%s.tls", "libtls", lib->ns);
+		sessions = lib->settings->get_int(lib->settings,
+						"%s.tls.session_cache_size", 1000, lib->ns);
+		if (sessions)
+		{
+			eap_cache = tls_cache_create(sessions,
+					lib->settings->get_int(lib->settings,
+						"%s.tls.session_cache_lifetime", 3600, lib->ns));
+		}
+	}
+}
+
+/**
+ * Described in header.
+ */
+void libtls_deinit(void)
+{
+	if (ref_put(&libtls_users))
+	{
+		DESTROY_IF(eap_cache);
+		eap_cache = NULL;
+	}
 }
 
 METHOD(tls_t, process, status_t,
@@ -292,7 +328,10 @@ METHOD(tls_t, build, status_t,
 	len = *buflen;
 	if (this->output.len == 0)
 	{
+		bio_writer_t *writer;
+
 		/* query upper layers for new records, as many as we can get */
+		writer = bio_writer_create(0);
 		while (TRUE)
 		{
 			status = this->protection->build(this->protection, &type, &data);
@@ -302,22 +341,27 @@ METHOD(tls_t, build, status_t,
 					record.type = type;
 					htoun16(&record.version, this->version);
 					htoun16(&record.length, data.len);
-					this->output = chunk_cat("mcm", this->output,
-											 chunk_from_thing(record), data);
+					writer->write_data(writer, chunk_from_thing(record));
+					writer->write_data(writer, data);
+					free(data.ptr);
 					DBG2(DBG_TLS, "sending TLS %N record (%d bytes)",
 						 tls_content_type_names, type, data.len);
 					continue;
 				case INVALID_STATE:
-					if (this->output.len == 0)
+					if (writer->get_buf(writer).len == 0)
 					{
+						writer->destroy(writer);
 						return INVALID_STATE;
 					}
 					break;
 				default:
+					writer->destroy(writer);
 					return status;
 			}
 			break;
 		}
+		this->output = writer->extract_buf(writer);
+		writer->destroy(writer);
 		if (msglen)
 		{
 			*msglen = this->output.len;
@@ -452,6 +496,11 @@ tls_t *tls_create(bool is_server, identification_t *server,
 		case TLS_PURPOSE_EAP_TLS:
 		case TLS_PURPOSE_EAP_TTLS:
 		case TLS_PURPOSE_EAP_PEAP:
+			if (!cache)
+			{	/* resume sessions over a cache shared by all EAP methods */
+				cache = eap_cache;
+			}
+			break;
 		case TLS_PURPOSE_GENERIC:
 		case TLS_PURPOSE_GENERIC_NULLOK:
 			break;
@@ -265,10 +265,18 @@ struct tls_t {
 };
 
 /**
- * Dummy libtls initialization function needed for integrity test
+ * Initialize libtls, creating the shared EAP session cache on first use.
+ *
+ * Also needed for the integrity test. May be called multiple times, each
+ * call has to be matched by a call to libtls_deinit().
  */
 void libtls_init(void);
 
+/**
+ * Deinitialize libtls, destroying the shared EAP session cache on last use.
+ */
+void libtls_deinit(void);
+
 /**
  * Create a tls instance.
  *
@@ -20,35 +20,72 @@
 #include <collections/hashtable.h>
 #include <threading/rwlock.h>
 
+/**
+ * Number of session table shards, spreading lock contention
+ */
+#define SHARD_COUNT 8
+
 typedef struct private_tls_cache_t private_tls_cache_t;
 
 /**
- * Private data of an tls_cache_t object.
+ * Hashtable entry
  */
-struct private_tls_cache_t {
+typedef struct {
+	/** session identifier */
+	chunk_t session;
+	/** master secret */
+	chunk_t master;
+	/** TLS cipher suite */
+	tls_cipher_suite_t suite;
+	/** optional identity this entry is bound to */
+	identification_t *id;
+	/** time of add */
+	time_t t;
+} entry_t;
+
+/**
+ * Cache shard, sessions are distributed by session identifier hash
+ */
+typedef struct {
 
 	/**
-	 * Public tls_cache_t interface.
+	 * Mapping session => entry_t, fast lookup by session
 	 */
-	tls_cache_t public;
+	hashtable_t *sessions;
 
 	/**
-	 * Mapping session => entry_t, fast lookup by session
+	 * Mapping identity => most recently added entry_t, for clients
 	 */
-	hashtable_t *table;
+	hashtable_t *ids;
 
 	/**
-	 * List containing all entries
+	 * List containing all entries of this shard, oldest last
 	 */
 	linked_list_t *list;
 
 	/**
-	 * Lock to list and table
+	 * Lock for tables and list
 	 */
 	rwlock_t *lock;
+} shard_t;
+
+/**
+ * Private data of an tls_cache_t object.
+ */
+struct private_tls_cache_t {
 
 	/**
-	 * Session limit
+	 * Public tls_cache_t interface.
+	 */
+	tls_cache_t public;
+
+	/**
+	 * Cache shards
+	 */
+	shard_t shards[SHARD_COUNT];
+
+	/**
+	 * Session limit, per shard
 	 */
 	u_int max_sessions;
 
@@ -58,22 +95,6 @@ struct private_tls_cache_t {
 	u_int max_age;
 };
 
-/**
- * Hashtable entry
- */
-typedef struct {
-	/** session identifier */
-	chunk_t session;
-	/** master secret */
-	chunk_t master;
-	/** TLS cipher suite */
-	tls_cipher_suite_t suite;
-	/** optional identity this entry is bound to */
-	identification_t *id;
-	/** time of add */
-	time_t t;
-} entry_t;
-
 /**
  * Destroy an entry
  */
@@ -86,7 +107,7 @@ static void entry_destroy(entry_t *entry)
 }
 
 /**
- * Hashtable hash function
+ * Hashtable hash function for sessions
  */
 static u_int hash(chunk_t *key)
 {
@@ -94,17 +115,42 @@ static u_int hash(chunk_t *key)
 }
 
 /**
- * Hashtable equals function
+ * Hashtable equals function for sessions
  */
 static bool equals(chunk_t *a, chunk_t *b)
 {
 	return chunk_equals(*a, *b);
 }
 
+/**
+ * Hashtable hash function for identities
+ */
+static u_int id_hash(identification_t *id)
+{
+	return chunk_hash(id->get_encoding(id));
+}
+
+/**
+ * Hashtable equals function for identities
+ */
+static bool id_equals(identification_t *a, identification_t *b)
+{
+	return a->equals(a, b);
+}
+
+/**
+ * Get the shard a session is stored in
+ */
+static shard_t *shard_for(private_tls_cache_t *this, chunk_t session)
+{
+	return &this->shards[chunk_hash(session) % SHARD_COUNT];
+}
+
 METHOD(tls_cache_t, create_, void,
 	private_tls_cache_t *this, chunk_t session, identification_t *id,
 	chunk_t master, tls_cipher_suite_t suite)
 {
+	shard_t *shard;
 	entry_t *entry;
 
 	INIT(entry,
@@ -115,21 +161,30 @@ METHOD(tls_cache_t, create_, void,
 		.t = time_monotonic(NULL),
 	);
 
-	this->lock->write_lock(this->lock);
-	this->list->insert_first(this->list, entry);
-	this->table->put(this->table, &entry->session, entry);
-	if (this->list->get_count(this->list) > this->max_sessions &&
-		this->list->remove_last(this->list, (void**)&entry) == SUCCESS)
+	shard = shard_for(this, session);
+	shard->lock->write_lock(shard->lock);
+	shard->list->insert_first(shard->list, entry);
+	shard->sessions->put(shard->sessions, &entry->session, entry);
+	if (entry->id)
+	{
+		shard->ids->put(shard->ids, entry->id, entry);
+	}
+	if (shard->list->get_count(shard->list) > this->max_sessions &&
+		shard->list->remove_last(shard->list, (void**)&entry) == SUCCESS)
 	{
 		DBG2(DBG_TLS, "session limit of %u reached, deleting %#B",
-			 this->max_sessions, &entry->session);
-		this->table->remove(this->table, &entry->session);
+			 this->max_sessions * SHARD_COUNT, &entry->session);
+		shard->sessions->remove(shard->sessions, &entry->session);
+		if (entry->id &&
+			shard->ids->get(shard->ids, entry->id) == entry)
+		{
+			shard->ids->remove(shard->ids, entry->id);
+		}
 		entry_destroy(entry);
 	}
-	this->lock->unlock(this->lock);
+	shard->lock->unlock(shard->lock);
 
-	DBG2(DBG_TLS, "created TLS session %#B, %d sessions",
-		 &session, this->list->get_count(this->list));
+	DBG2(DBG_TLS, "created TLS session %#B", &session);
 }
 
 METHOD(tls_cache_t, lookup, tls_cipher_suite_t,
@@ -137,14 +192,16 @@ METHOD(tls_cache_t, lookup, tls_cipher_suite_t,
 	chunk_t* master)
 {
 	tls_cipher_suite_t suite = 0;
+	shard_t *shard;
 	entry_t *entry;
 	time_t now;
 	u_int age;
 
 	now = time_monotonic(NULL);
 
-	this->lock->write_lock(this->lock);
-	entry = this->table->get(this->table, &session);
+	shard = shard_for(this, session);
+	shard->lock->read_lock(shard->lock);
+	entry = shard->sessions->get(shard->sessions, &session);
 	if (entry)
 	{
 		age = now - entry->t;
@@ -161,7 +218,7 @@ METHOD(tls_cache_t, lookup, tls_cipher_suite_t,
 			DBG2(DBG_TLS, "TLS session %#B expired: %u seconds", &session, age);
 		}
 	}
-	this->lock->unlock(this->lock);
+	shard->lock->unlock(shard->lock);
 
 	if (suite)
 	{
@@ -174,40 +231,45 @@ METHOD(tls_cache_t, check, chunk_t,
 	private_tls_cache_t *this, identification_t *id)
 {
 	chunk_t session = chunk_empty;
-	enumerator_t *enumerator;
+	shard_t *shard;
 	entry_t *entry;
 	time_t now;
+	int i;
 
 	now = time_monotonic(NULL);
-	this->lock->read_lock(this->lock);
-	enumerator = this->list->create_enumerator(this->list);
-	while (enumerator->enumerate(enumerator, &entry))
+	for (i = 0; i < SHARD_COUNT && !session.len; i++)
 	{
-		if (entry->t + this->max_age >= now &&
-			entry->id && id->equals(id, entry->id))
+		shard = &this->shards[i];
+		shard->lock->read_lock(shard->lock);
+		entry = shard->ids->get(shard->ids, id);
+		if (entry && entry->t + this->max_age >= now)
 		{
 			session = chunk_clone(entry->session);
-			break;
 		}
+		shard->lock->unlock(shard->lock);
 	}
-	enumerator->destroy(enumerator);
-	this->lock->unlock(this->lock);
-
 	return session;
 }
 
 METHOD(tls_cache_t, destroy, void,
 	private_tls_cache_t *this)
 {
+	shard_t *shard;
 	entry_t *entry;
+	int i;
 
-	while (this->list->remove_last(this->list, (void**)&entry) == SUCCESS)
+	for (i = 0; i < SHARD_COUNT; i++)
 	{
-		entry_destroy(entry);
+		shard = &this->shards[i];
+		while (shard->list->remove_last(shard->list, (void**)&entry) == SUCCESS)
+		{
+			entry_destroy(entry);
+		}
+		shard->list->destroy(shard->list);
+		shard->sessions->destroy(shard->sessions);
+		shard->ids->destroy(shard->ids);
+		shard->lock->destroy(shard->lock);
 	}
-	this->list->destroy(this->list);
-	this->table->destroy(this->table);
-	this->lock->destroy(this->lock);
 	free(this);
 }
 
@@ -217,6 +279,7 @@ METHOD(tls_cache_t, destroy, void,
 tls_cache_t *tls_cache_create(u_int max_sessions, u_int max_age)
 {
 	private_tls_cache_t *this;
+	int i;
 
 	INIT(this,
 		.public = {
@@ -225,13 +288,19 @@ tls_cache_t *tls_cache_create(u_int max_sessions, u_int max_age)
 			.check = _check,
 			.destroy = _destroy,
 		},
-		.table = hashtable_create((hashtable_hash_t)hash,
-								  (hashtable_equals_t)equals, 8),
-		.list = linked_list_create(),
-		.lock = rwlock_create(RWLOCK_TYPE_DEFAULT),
-		.max_sessions = max_sessions,
+		.max_sessions = max(max_sessions / SHARD_COUNT, 1),
 		.max_age = max_age,
 	);
 
+	for (i = 0; i < SHARD_COUNT; i++)
+	{
+		this->shards[i].sessions = hashtable_create((hashtable_hash_t)hash,
+												(hashtable_equals_t)equals, 8);
+		this->shards[i].ids = hashtable_create((hashtable_hash_t)id_hash,
+												(hashtable_equals_t)id_equals, 8);
+		this->shards[i].list = linked_list_create();
+		this->shards[i].lock = rwlock_create(RWLOCK_TYPE_DEFAULT);
+	}
+
 	return &this->public;
 }
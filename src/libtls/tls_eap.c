@@ -27,6 +27,12 @@
  */
 #define TLS_MAX_MESSAGE_LEN		4 * (TLS_MAX_FRAGMENT_LEN + 2048)
 
+/**
+ * Lower limit for adaptive fragment sizing, RFC 3748 guarantees an EAP
+ * MTU of at least 1020 bytes
+ */
+#define TLS_MIN_FRAGMENT_LEN	1020
+
 typedef struct private_tls_eap_t private_tls_eap_t;
 
 /**
@@ -77,10 +83,20 @@ struct private_tls_eap_t {
 	bool first_fragment;
 
 	/**
-	 * Maximum size of an outgoing EAP-TLS fragment
+	 * Maximum size of an outgoing EAP-TLS fragment, reduced on retransmits
 	 */
 	size_t frag_size;
 
+	/**
+	 * Copy of the last packet sent, retransmitted on duplicates
+	 */
+	chunk_t last_out;
+
+	/**
+	 * EAP identifier of the last packet processed
+	 */
+	uint8_t last_identifier;
+
 	/**
 	 * Number of EAP messages/fragments processed so far
 	 */
@@ -292,6 +308,17 @@ static status_t build_pkt(private_tls_eap_t *this, chunk_t *out)
 	return NEED_MORE;
 }
 
+/**
+ * Remember the last packet sent, to retransmit it on duplicates
+ */
+static void remember_pkt(private_tls_eap_t *this, uint8_t identifier,
+						 chunk_t out)
+{
+	free(this->last_out.ptr);
+	this->last_out = chunk_clone(out);
+	this->last_identifier = identifier;
+}
+
 /**
  * Send an ack to request next fragment
  */
@@ -349,6 +376,24 @@ METHOD(tls_eap_t, process, status_t,
 		return FAILED;
 	}
 
+	/* a duplicate of the last packet indicates that our answer was lost or
+	 * too big for the path; retransmit it unmodified, but back off to smaller
+	 * fragments for anything sent afterwards */
+	if (this->last_out.len && pkt->identifier == this->last_identifier &&
+		!(this->type == EAP_PT_EAP ? pkt->flags & EAP_PT_START
+								   : pkt->flags & EAP_TLS_START))
+	{
+		if (this->frag_size / 2 >= TLS_MIN_FRAGMENT_LEN)
+		{
+			this->frag_size /= 2;
+			DBG1(DBG_TLS, "received duplicate %N packet, reducing fragment "
+				 "size to %zu bytes", eap_type_names, this->type,
+				 this->frag_size);
+		}
+		*out = chunk_clone(this->last_out);
+		return NEED_MORE;
+	}
+
 	/* update EAP identifier */
 	if (!this->is_server)
 	{
@@ -377,6 +422,10 @@ METHOD(tls_eap_t, process, status_t,
 			{
 				return SUCCESS;
 			}
+			if (status == NEED_MORE)
+			{
+				remember_pkt(this, pkt->identifier, *out);
+			}
 			return status;
 		}
 		status = process_pkt(this, pkt);
@@ -395,17 +444,23 @@ METHOD(tls_eap_t, process, status_t,
 	{
 		case INVALID_STATE:
 			*out = create_ack(this);
-			return NEED_MORE;
+			status = NEED_MORE;
+			break;
 		case FAILED:
 			if (!this->is_server)
 			{
 				*out = create_ack(this);
-				return NEED_MORE;
+				status = NEED_MORE;
 			}
-			return FAILED;
+			break;
 		default:
-			return status;
+			break;
+	}
+	if (status == NEED_MORE)
+	{
+		remember_pkt(this, pkt->identifier, *out);
 	}
+	return status;
 }
 
 METHOD(tls_eap_t, get_msk, chunk_t,
@@ -436,6 +491,7 @@ METHOD(tls_eap_t, destroy, void,
 	private_tls_eap_t *this)
 {
 	this->tls->destroy(this->tls);
+	free(this->last_out.ptr);
 	free(this);
 }
 
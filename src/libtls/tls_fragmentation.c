@@ -87,6 +87,11 @@ struct private_tls_fragmentation_t {
 	 */
 	chunk_t output;
 
+	/**
+	 * Position in output buffer
+	 */
+	size_t outpos;
+
 	/**
 	 * Type of data in output buffer
 	 */
@@ -321,7 +326,7 @@ static bool check_alerts(private_tls_fragmentation_t *this, chunk_t *data)
 		writer->write_uint8(writer, level);
 		writer->write_uint8(writer, desc);
 
-		*data = chunk_clone(writer->get_buf(writer));
+		*data = writer->extract_buf(writer);
 		writer->destroy(writer);
 		return TRUE;
 	}
@@ -361,7 +366,7 @@ static status_t build_handshake(private_tls_fragmentation_t *this)
 				/* FALL */
 			case INVALID_STATE:
 				this->output_type = TLS_HANDSHAKE;
-				this->output = chunk_clone(msg->get_buf(msg));
+				this->output = msg->extract_buf(msg);
 				break;
 			default:
 				break;
@@ -391,7 +396,7 @@ static status_t build_application(private_tls_fragmentation_t *this)
 				continue;
 			case INVALID_STATE:
 				this->output_type = TLS_APPLICATION_DATA;
-				this->output = chunk_clone(msg->get_buf(msg));
+				this->output = msg->extract_buf(msg);
 				break;
 			case SUCCESS:
 				this->application_finished = TRUE;
@@ -463,14 +468,23 @@ METHOD(tls_fragmentation_t, build, status_t,
 	if (this->output.len)
 	{
 		*type = this->output_type;
-		if (this->output.len <= TLS_MAX_FRAGMENT_LEN)
-		{
+		if (!this->outpos && this->output.len <= TLS_MAX_FRAGMENT_LEN)
+		{	/* fits in a single record, hand out the buffer */
 			*data = this->output;
 			this->output = chunk_empty;
 			return NEED_MORE;
 		}
-		*data = chunk_create(this->output.ptr, TLS_MAX_FRAGMENT_LEN);
-		this->output = chunk_clone(chunk_skip(this->output, TLS_MAX_FRAGMENT_LEN));
+		/* copy out fragments at the current position, avoiding a reallocation
+		 * of the shrinking remainder for each fragment sent */
+		*data = chunk_clone(chunk_create(this->output.ptr + this->outpos,
+							min(this->output.len - this->outpos,
+								TLS_MAX_FRAGMENT_LEN)));
+		this->outpos += data->len;
+		if (this->outpos == this->output.len)
+		{
+			chunk_free(&this->output);
+			this->outpos = 0;
+		}
 		return NEED_MORE;
 	}
 	return status;
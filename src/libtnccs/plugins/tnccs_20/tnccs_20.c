@@ -36,6 +36,8 @@
 #include <tnc/imv/imv_manager.h>
 
 #include <threading/mutex.h>
+#include <threading/condvar.h>
+#include <processing/jobs/callback_job.h>
 #include <utils/debug.h>
 #include <collections/linked_list.h>
 #include <pen/pen.h>
@@ -122,6 +124,11 @@ struct private_tnccs_20_t {
 	 */
 	mutex_t *mutex;
 
+	/**
+	 * Deliver PB-PA messages to independent IMC/IMV pairs in parallel
+	 */
+	bool parallel_delivery;
+
 	/**
 	 * Flag set while processing
 	 */
@@ -250,6 +257,54 @@ METHOD(tnccs_t, send_msg, TNC_Result,
 	return TNC_RESULT_SUCCESS;
 }
 
+/**
+ * Deliver a single PB-PA message to the addressed IMC/IMV, the send_msg
+ * flag must be set by the caller
+ */
+static void deliver_pa_msg(private_tnccs_20_t *this, pb_pa_msg_t *pa_msg)
+{
+	pen_type_t msg_subtype;
+	u_int16_t imc_id, imv_id;
+	chunk_t msg_body;
+	bool excl;
+	enum_name_t *pa_subtype_names;
+
+	msg_subtype = pa_msg->get_subtype(pa_msg);
+	msg_body = pa_msg->get_body(pa_msg);
+	imc_id = pa_msg->get_collector_id(pa_msg);
+	imv_id = pa_msg->get_validator_id(pa_msg);
+	excl = pa_msg->get_exclusive_flag(pa_msg);
+
+	pa_subtype_names = get_pa_subtype_names(msg_subtype.vendor_id);
+	if (pa_subtype_names)
+	{
+		DBG2(DBG_TNC, "handling PB-PA message type '%N/%N' 0x%06x/0x%08x",
+			 pen_names, msg_subtype.vendor_id, pa_subtype_names,
+			 msg_subtype.type, msg_subtype.vendor_id, msg_subtype.type);
+	}
+	else
+	{
+		DBG2(DBG_TNC, "handling PB-PA message type '%N' 0x%06x/0x%08x",
+			 pen_names, msg_subtype.vendor_id, msg_subtype.vendor_id,
+			 msg_subtype.type);
+	}
+
+	if (this->is_server)
+	{
+		tnc->imvs->receive_message(tnc->imvs, this->connection_id,
+								   excl, msg_body.ptr, msg_body.len,
+								   msg_subtype.vendor_id,
+								   msg_subtype.type, imc_id, imv_id);
+	}
+	else
+	{
+		tnc->imcs->receive_message(tnc->imcs, this->connection_id,
+								   excl, msg_body.ptr, msg_body.len,
+								   msg_subtype.vendor_id,
+								   msg_subtype.type, imv_id, imc_id);
+	}
+}
+
 /**
  * Handle a single PB-TNC IETF standard message according to its type
  */
@@ -264,49 +319,8 @@ static void handle_ietf_message(private_tnccs_20_t *this, pb_tnc_msg_t *msg)
 			break;
 		case PB_MSG_PA:
 		{
-			pb_pa_msg_t *pa_msg;
-			pen_type_t msg_subtype;
-			u_int16_t imc_id, imv_id;
-			chunk_t msg_body;
-			bool excl;
-			enum_name_t *pa_subtype_names;
-
-			pa_msg = (pb_pa_msg_t*)msg;
-			msg_subtype = pa_msg->get_subtype(pa_msg);
-			msg_body = pa_msg->get_body(pa_msg);
-			imc_id = pa_msg->get_collector_id(pa_msg);
-			imv_id = pa_msg->get_validator_id(pa_msg);
-			excl = pa_msg->get_exclusive_flag(pa_msg);
-
-			pa_subtype_names = get_pa_subtype_names(msg_subtype.vendor_id);
-			if (pa_subtype_names)
-			{
-				DBG2(DBG_TNC, "handling PB-PA message type '%N/%N' 0x%06x/0x%08x",
-					 pen_names, msg_subtype.vendor_id, pa_subtype_names,
-					 msg_subtype.type, msg_subtype.vendor_id, msg_subtype.type);
-			}
-			else
-			{
-				DBG2(DBG_TNC, "handling PB-PA message type '%N' 0x%06x/0x%08x",
-					 pen_names, msg_subtype.vendor_id, msg_subtype.vendor_id,
-					 msg_subtype.type);
-			}
-
 			this->send_msg = TRUE;
-			if (this->is_server)
-			{
-				tnc->imvs->receive_message(tnc->imvs, this->connection_id,
-										   excl, msg_body.ptr, msg_body.len,
-										   msg_subtype.vendor_id,
-										   msg_subtype.type, imc_id, imv_id);
-			}
-			else
-			{
-				tnc->imcs->receive_message(tnc->imcs, this->connection_id,
-										   excl, msg_body.ptr, msg_body.len,
-										   msg_subtype.vendor_id,
-										   msg_subtype.type, imv_id, imc_id);
-			}
+			deliver_pa_msg(this, (pb_pa_msg_t*)msg);
 			this->send_msg = FALSE;
 			break;
 		}
@@ -527,6 +541,166 @@ static void handle_message(private_tnccs_20_t *this, pb_tnc_msg_t *msg)
 	}
 }
 
+/**
+ * Completion state shared by parallel PB-PA message deliveries
+ */
+typedef struct {
+	/** mutex protecting the completion count */
+	mutex_t *mutex;
+	/** condvar to wait for completion of all deliveries */
+	condvar_t *condvar;
+	/** number of IMC/IMV pairs not yet delivered to */
+	int remaining;
+} pa_delivery_t;
+
+/**
+ * PB-PA messages addressed to a single IMC/IMV pair
+ */
+typedef struct {
+	/** TNCCS connection the messages were received on */
+	private_tnccs_20_t *tnccs;
+	/** PB-PA messages for this pair, in receive order */
+	linked_list_t *msgs;
+	/** shared completion state */
+	pa_delivery_t *delivery;
+	/** IMC ID of the pair */
+	u_int16_t imc_id;
+	/** IMV ID of the pair */
+	u_int16_t imv_id;
+} pa_group_t;
+
+/**
+ * Destroy a pa_group_t, the contained messages are owned by the batch
+ */
+static void pa_group_destroy(pa_group_t *group)
+{
+	group->msgs->destroy(group->msgs);
+	free(group);
+}
+
+/**
+ * Deliver the PB-PA messages of one IMC/IMV pair on a worker thread
+ */
+static job_requeue_t deliver_group(pa_group_t *group)
+{
+	pa_delivery_t *delivery = group->delivery;
+	pb_tnc_msg_t *msg;
+
+	while (group->msgs->remove_first(group->msgs, (void**)&msg) == SUCCESS)
+	{
+		deliver_pa_msg(group->tnccs, (pb_pa_msg_t*)msg);
+	}
+	delivery->mutex->lock(delivery->mutex);
+	delivery->remaining--;
+	delivery->condvar->signal(delivery->condvar);
+	delivery->mutex->unlock(delivery->mutex);
+
+	return JOB_REQUEUE_NONE;
+}
+
+/**
+ * Handle the messages of a batch, overlapping the delivery of PB-PA messages
+ * addressed to independent IMC/IMV pairs. Returns TRUE if any message was
+ * handled.
+ */
+static bool handle_messages_parallel(private_tnccs_20_t *this,
+									 pb_tnc_batch_t *batch)
+{
+	enumerator_t *enumerator, *groups_enum;
+	linked_list_t *groups;
+	pa_group_t *group;
+	pb_tnc_msg_t *msg;
+	pa_delivery_t delivery;
+	bool empty = TRUE;
+
+	groups = linked_list_create();
+
+	enumerator = batch->create_msg_enumerator(batch);
+	while (enumerator->enumerate(enumerator, &msg))
+	{
+		pen_type_t msg_type = msg->get_type(msg);
+
+		empty = FALSE;
+		if (msg_type.vendor_id == PEN_IETF && msg_type.type == PB_MSG_PA)
+		{
+			pb_pa_msg_t *pa_msg = (pb_pa_msg_t*)msg;
+			u_int16_t imc_id, imv_id;
+			bool found = FALSE;
+
+			imc_id = pa_msg->get_collector_id(pa_msg);
+			imv_id = pa_msg->get_validator_id(pa_msg);
+
+			groups_enum = groups->create_enumerator(groups);
+			while (groups_enum->enumerate(groups_enum, &group))
+			{
+				if (group->imc_id == imc_id && group->imv_id == imv_id)
+				{
+					found = TRUE;
+					break;
+				}
+			}
+			groups_enum->destroy(groups_enum);
+
+			if (!found)
+			{
+				INIT(group,
+					.tnccs = this,
+					.msgs = linked_list_create(),
+					.delivery = &delivery,
+					.imc_id = imc_id,
+					.imv_id = imv_id,
+				);
+				groups->insert_last(groups, group);
+			}
+			group->msgs->insert_last(group->msgs, msg);
+		}
+		else
+		{
+			handle_message(this, msg);
+		}
+	}
+	enumerator->destroy(enumerator);
+
+	this->send_msg = TRUE;
+	if (groups->get_count(groups) > 1)
+	{
+		delivery.mutex = mutex_create(MUTEX_TYPE_DEFAULT);
+		delivery.condvar = condvar_create(CONDVAR_TYPE_DEFAULT);
+		delivery.remaining = groups->get_count(groups);
+
+		groups_enum = groups->create_enumerator(groups);
+		while (groups_enum->enumerate(groups_enum, &group))
+		{
+			lib->processor->queue_job(lib->processor,
+				(job_t*)callback_job_create((callback_job_cb_t)deliver_group,
+											group, NULL, NULL));
+		}
+		groups_enum->destroy(groups_enum);
+
+		delivery.mutex->lock(delivery.mutex);
+		while (delivery.remaining)
+		{
+			delivery.condvar->wait(delivery.condvar, delivery.mutex);
+		}
+		delivery.mutex->unlock(delivery.mutex);
+
+		delivery.condvar->destroy(delivery.condvar);
+		delivery.mutex->destroy(delivery.mutex);
+	}
+	else if (groups->get_first(groups, (void**)&group) == SUCCESS)
+	{
+		while (group->msgs->remove_first(group->msgs, (void**)&msg) == SUCCESS)
+		{
+			deliver_pa_msg(this, (pb_pa_msg_t*)msg);
+		}
+	}
+	this->send_msg = FALSE;
+
+	groups->destroy_function(groups, (void*)pa_group_destroy);
+
+	return !empty;
+}
+
 /**
  *  Build a CRETRY or SRETRY batch
  */
@@ -624,13 +798,20 @@ METHOD(tls_t, process, status_t,
 			this->send_msg = FALSE;
 		}
 
-		enumerator = batch->create_msg_enumerator(batch);
-		while (enumerator->enumerate(enumerator, &msg))
+		if (this->parallel_delivery)
 		{
-			handle_message(this, msg);
-			empty = FALSE;
+			empty = !handle_messages_parallel(this, batch);
+		}
+		else
+		{
+			enumerator = batch->create_msg_enumerator(batch);
+			while (enumerator->enumerate(enumerator, &msg))
+			{
+				handle_message(this, msg);
+				empty = FALSE;
+			}
+			enumerator->destroy(enumerator);
 		}
-		enumerator->destroy(enumerator);
 
 		/* received an empty CLOSE batch from PB-TNC client */
 		if (this->is_server && batch_type == PB_BATCH_CLOSE && empty)
@@ -868,19 +1049,61 @@ METHOD(tls_t, build, status_t,
 			batch = pb_tnc_batch_create(this->is_server, this->batch_type,
 										min(this->max_batch_len, *buflen));
 
+			linked_list_t *deferred;
+			uintptr_t dest, deferred_dest;
+			enumerator_t *deferred_enum;
+			bool is_pa, skip;
+
+			/* fill the batch up to its maximum size, deferring all further
+			 * PB-PA messages of an IMC/IMV pair once one of its messages
+			 * did not fit, to preserve the per-pair message order */
+			deferred = linked_list_create();
 			enumerator = this->messages->create_enumerator(this->messages);
 			while (enumerator->enumerate(enumerator, &msg))
 			{
+				pen_type_t msg_type = msg->get_type(msg);
+
+				is_pa = (msg_type.vendor_id == PEN_IETF &&
+						 msg_type.type == PB_MSG_PA);
+				dest = 0;
+				if (is_pa)
+				{
+					pb_pa_msg_t *pa_msg = (pb_pa_msg_t*)msg;
+
+					dest = ((uintptr_t)pa_msg->get_collector_id(pa_msg) << 16) |
+									   pa_msg->get_validator_id(pa_msg);
+					skip = FALSE;
+					deferred_enum = deferred->create_enumerator(deferred);
+					while (deferred_enum->enumerate(deferred_enum,
+													&deferred_dest))
+					{
+						if (deferred_dest == dest)
+						{
+							skip = TRUE;
+							break;
+						}
+					}
+					deferred_enum->destroy(deferred_enum);
+					if (skip)
+					{
+						continue;
+					}
+				}
 				if (batch->add_msg(batch, msg))
 				{
 					this->messages->remove_at(this->messages, enumerator);
 				}
+				else if (is_pa)
+				{
+					deferred->insert_last(deferred, (void*)dest);
+				}
 				else
 				{
 					break;
 				}
 			}
 			enumerator->destroy(enumerator);
+			deferred->destroy(deferred);
 
 			batch->build(batch);
 			data = batch->get_encoding(batch);
@@ -1122,6 +1345,9 @@ tnccs_t* tnccs_20_create(bool is_server, identification_t *server_id,
 		.callback = cb,
 		.state_machine = pb_tnc_state_machine_create(is_server),
 		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+		.parallel_delivery = lib->settings->get_bool(lib->settings,
+									"%s.plugins.tnccs-20.parallel_delivery",
+									 FALSE, lib->ns),
 		.messages = linked_list_create(),
 		.max_batch_len = max_batch_size,
 		.max_msg_len = max_message_size,
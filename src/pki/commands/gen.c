@@ -16,6 +16,179 @@
 
 #include "pki.h"
 
+#include <errno.h>
+#include <limits.h>
+
+#include <threading/mutex.h>
+#include <threading/condvar.h>
+#include <processing/jobs/callback_job.h>
+
+/**
+ * Create a private key with the given parameters
+ */
+static private_key_t *generate_key(key_type_t type, u_int size,
+								   bool safe_primes, u_int shares,
+								   u_int threshold)
+{
+	if (type == KEY_RSA && shares)
+	{
+		return lib->creds->create(lib->creds, CRED_PRIVATE_KEY, type,
+							BUILD_KEY_SIZE, size, BUILD_SAFE_PRIMES,
+							BUILD_SHARES, shares, BUILD_THRESHOLD, threshold,
+							BUILD_END);
+	}
+	if (type == KEY_RSA && safe_primes)
+	{
+		return lib->creds->create(lib->creds, CRED_PRIVATE_KEY, type,
+							BUILD_KEY_SIZE, size, BUILD_SAFE_PRIMES, BUILD_END);
+	}
+	return lib->creds->create(lib->creds, CRED_PRIVATE_KEY, type,
+							BUILD_KEY_SIZE, size, BUILD_END);
+}
+
+/**
+ * State shared by concurrent key generation jobs
+ */
+typedef struct {
+	/** type of keys to generate */
+	key_type_t type;
+	/** key size in bits */
+	u_int size;
+	/** generate RSA safe primes */
+	bool safe_primes;
+	/** number of RSA key shares */
+	u_int shares;
+	/** key share threshold */
+	u_int threshold;
+	/** output encoding */
+	cred_encoding_type_t form;
+	/** directory to write generated keys to */
+	char *outdir;
+	/** mutex to lock counters and the output index */
+	mutex_t *mutex;
+	/** condvar to wait for outstanding jobs */
+	condvar_t *condvar;
+	/** jobs not yet finished */
+	u_int remaining;
+	/** number of failed generations */
+	u_int failed;
+} batch_t;
+
+/**
+ * A single key generation of a batch
+ */
+typedef struct {
+	/** batch this generation belongs to */
+	batch_t *batch;
+	/** position of the key in the batch */
+	u_int index;
+} batch_item_t;
+
+/**
+ * Clean up a batch item, accounting the finished job
+ */
+static void batch_item_destroy(batch_item_t *item)
+{
+	batch_t *batch = item->batch;
+
+	batch->mutex->lock(batch->mutex);
+	batch->remaining--;
+	batch->condvar->signal(batch->condvar);
+	batch->mutex->unlock(batch->mutex);
+	free(item);
+}
+
+/**
+ * Generate a single key of a batch
+ */
+static job_requeue_t generate_item(batch_item_t *item)
+{
+	batch_t *batch = item->batch;
+	private_key_t *key;
+	chunk_t encoding = chunk_empty;
+	char path[PATH_MAX];
+	char *error = NULL;
+	FILE *file;
+
+	key = generate_key(batch->type, batch->size, batch->safe_primes,
+					   batch->shares, batch->threshold);
+	if (!key)
+	{
+		error = "private key generation failed";
+	}
+	else if (!key->get_encoding(key, batch->form, &encoding))
+	{
+		error = "private key encoding failed";
+	}
+	else
+	{
+		snprintf(path, sizeof(path), "%s/%u.%s", batch->outdir, item->index,
+				 batch->form == PRIVKEY_PEM ? "pem" : "der");
+		file = fopen(path, "wb");
+		if (!file || fwrite(encoding.ptr, encoding.len, 1, file) != 1)
+		{
+			error = "writing private key failed";
+		}
+		if (file)
+		{
+			fclose(file);
+		}
+	}
+	DESTROY_IF(key);
+	chunk_clear(&encoding);
+
+	batch->mutex->lock(batch->mutex);
+	if (error)
+	{
+		batch->failed++;
+		fprintf(stderr, "%u failed: %s\n", item->index, error);
+	}
+	else
+	{	/* index line mapping batch position to key file */
+		printf("%u %s\n", item->index, path);
+	}
+	batch->mutex->unlock(batch->mutex);
+	return JOB_REQUEUE_NONE;
+}
+
+/**
+ * Generate count keys with a pool of worker jobs
+ */
+static int gen_batch(batch_t *batch, u_int count, u_int jobs)
+{
+	batch_item_t *item;
+	u_int i;
+
+	batch->mutex = mutex_create(MUTEX_TYPE_DEFAULT);
+	batch->condvar = condvar_create(CONDVAR_TYPE_DEFAULT);
+	batch->remaining = count;
+
+	lib->processor->set_threads(lib->processor, max(1, jobs));
+	for (i = 0; i < count; i++)
+	{
+		INIT(item,
+			.batch = batch,
+			.index = i,
+		);
+		lib->processor->queue_job(lib->processor,
+			(job_t*)callback_job_create((callback_job_cb_t)generate_item, item,
+										(void*)batch_item_destroy, NULL));
+	}
+	batch->mutex->lock(batch->mutex);
+	while (batch->remaining)
+	{
+		batch->condvar->wait(batch->condvar, batch->mutex);
+	}
+	batch->mutex->unlock(batch->mutex);
+
+	fprintf(stderr, "generated %u keys, %u failed\n",
+			count - batch->failed, batch->failed);
+
+	batch->condvar->destroy(batch->condvar);
+	batch->mutex->destroy(batch->mutex);
+	return batch->failed ? 1 : 0;
+}
+
 /**
  * Generate a private key
  */
@@ -23,11 +196,11 @@ static int gen()
 {
 	cred_encoding_type_t form = PRIVKEY_ASN1_DER;
 	key_type_t type = KEY_RSA;
-	u_int size = 0, shares = 0, threshold = 1;
+	u_int size = 0, shares = 0, threshold = 1, count = 1, jobs = 1;
 	private_key_t *key;
 	chunk_t encoding;
 	bool safe_primes = FALSE;
-	char *arg;
+	char *arg, *outdir = ".";
 
 	while (TRUE)
 	{
@@ -83,6 +256,23 @@ static int gen()
 					return command_usage("invalid key share threshold");
 				}
 				continue;
+			case 'c':
+				count = atoi(arg);
+				if (!count)
+				{
+					return command_usage("invalid key count");
+				}
+				continue;
+			case 'o':
+				outdir = arg;
+				continue;
+			case 'j':
+				jobs = atoi(arg);
+				if (!jobs)
+				{
+					return command_usage("invalid --jobs value");
+				}
+				continue;
 			case EOF:
 				break;
 			default:
@@ -108,27 +298,27 @@ static int gen()
 				break;
 		}
 	}
-	if (type == KEY_RSA && shares)
+	if (type == KEY_RSA && shares && threshold > shares)
 	{
-		if (threshold > shares)
-		{
-			return command_usage("threshold is larger than number of shares");
-		}
-		key = lib->creds->create(lib->creds, CRED_PRIVATE_KEY, type,
-							BUILD_KEY_SIZE, size, BUILD_SAFE_PRIMES,
-							BUILD_SHARES, shares, BUILD_THRESHOLD, threshold,
-							BUILD_END);
-	}
-	else if (type == KEY_RSA && safe_primes)
-	{
-		key = lib->creds->create(lib->creds, CRED_PRIVATE_KEY, type,
-							BUILD_KEY_SIZE, size, BUILD_SAFE_PRIMES, BUILD_END);
+		return command_usage("threshold is larger than number of shares");
 	}
-	else
+
+	if (count > 1)
 	{
-		key = lib->creds->create(lib->creds, CRED_PRIVATE_KEY, type,
-							BUILD_KEY_SIZE, size, BUILD_END);
+		batch_t batch = {
+			.type = type,
+			.size = size,
+			.safe_primes = safe_primes,
+			.shares = shares,
+			.threshold = threshold,
+			.form = form,
+			.outdir = outdir,
+		};
+
+		return gen_batch(&batch, count, jobs);
 	}
+
+	key = generate_key(type, size, safe_primes, shares, threshold);
 	if (!key)
 	{
 		fprintf(stderr, "private key generation failed\n");
@@ -160,7 +350,8 @@ static void __attribute__ ((constructor))reg()
 	command_register((command_t) {
 		gen, 'g', "gen", "generate a new private key",
 		{"  [--type rsa|ecdsa|bliss] [--size bits] [--safe-primes]",
-		 "[--shares n] [--threshold l] [--outform der|pem]"},
+		 "[--shares n] [--threshold l] [--outform der|pem]",
+		 "[--count n [--outdir dir] [--jobs cnt]]"},
 		{
 			{"help",		'h', 0, "show usage information"},
 			{"type",		't', 1, "type of key, default: rsa"},
@@ -169,6 +360,9 @@ static void __attribute__ ((constructor))reg()
 			{"shares",		'n', 1, "number of private rsa key shares"},
 			{"threshold",	'l', 1, "minimum number of participating rsa key shares"},
 			{"outform",		'f', 1, "encoding of generated private key, default: der"},
+			{"count",		'c', 1, "generate multiple keys into --outdir, default: 1"},
+			{"outdir",		'o', 1, "directory to write generated keys to, default: ."},
+			{"jobs",		'j', 1, "concurrent generation jobs in batch mode, default: 1"},
 		}
 	});
 }
@@ -16,6 +16,8 @@
 
 #include <time.h>
 #include <errno.h>
+#include <limits.h>
+#include <sys/stat.h>
 
 #include "pki.h"
 
@@ -25,6 +27,9 @@
 #include <credentials/certificates/certificate.h>
 #include <credentials/certificates/x509.h>
 #include <credentials/certificates/pkcs10.h>
+#include <threading/mutex.h>
+#include <threading/condvar.h>
+#include <processing/jobs/callback_job.h>
 
 /**
  * Free cert policy with OID
@@ -54,6 +59,242 @@ static void destroy_cdp(x509_cdp_t *this)
 	free(this);
 }
 
+/**
+ * State shared by all signing jobs of a batch
+ */
+typedef struct {
+	/** CA certificate */
+	certificate_t *ca;
+	/** CA private key, reused for all requests */
+	private_key_t *private;
+	/** RNG for serial numbers, used with the mutex held */
+	rng_t *rng;
+	/** mutex to lock rng, counters and the output index */
+	mutex_t *mutex;
+	/** condvar to wait for outstanding jobs */
+	condvar_t *condvar;
+	/** jobs not yet finished */
+	u_int remaining;
+	/** number of failed requests */
+	u_int failed;
+	/** directory to write issued certificates to */
+	char *outdir;
+	/** output encoding */
+	cred_encoding_type_t form;
+	/** digest for signature creation */
+	hash_algorithm_t digest;
+	/** validity of issued certificates */
+	time_t not_before, not_after;
+	/** X.509 flags to set */
+	x509_flag_t flags;
+	/** shared CRL distribution points, as x509_cdp_t */
+	linked_list_t *cdps;
+	/** shared OCSP URIs, as char* */
+	linked_list_t *ocsp;
+} batch_t;
+
+/**
+ * A single certificate request processed in a batch
+ */
+typedef struct {
+	/** batch this request belongs to */
+	batch_t *batch;
+	/** path of the PKCS#10 request file */
+	char *path;
+	/** position of the request in the batch */
+	u_int index;
+} batch_item_t;
+
+/**
+ * Clean up a batch item, accounting the finished job
+ */
+static void batch_item_destroy(batch_item_t *item)
+{
+	batch_t *batch = item->batch;
+
+	batch->mutex->lock(batch->mutex);
+	batch->remaining--;
+	batch->condvar->signal(batch->condvar);
+	batch->mutex->unlock(batch->mutex);
+	free(item->path);
+	free(item);
+}
+
+/**
+ * Issue a single certificate request of a batch
+ */
+static job_requeue_t issue_item(batch_item_t *item)
+{
+	batch_t *batch = item->batch;
+	certificate_t *cert_req = NULL, *cert = NULL;
+	public_key_t *public = NULL;
+	identification_t *id, *subjectAltName;
+	enumerator_t *enumerator;
+	linked_list_t *san;
+	pkcs10_t *req;
+	chunk_t serial = chunk_empty, encoding = chunk_empty;
+	char path[PATH_MAX];
+	char *error = NULL;
+	FILE *file;
+	bool ok;
+
+	san = linked_list_create();
+
+	cert_req = lib->creds->create(lib->creds, CRED_CERTIFICATE,
+								  CERT_PKCS10_REQUEST,
+								  BUILD_FROM_FILE, item->path, BUILD_END);
+	if (!cert_req)
+	{
+		error = "parsing certificate request failed";
+		goto end;
+	}
+	id = cert_req->get_subject(cert_req);
+	req = (pkcs10_t*)cert_req;
+	enumerator = req->create_subjectAltName_enumerator(req);
+	while (enumerator->enumerate(enumerator, &subjectAltName))
+	{
+		san->insert_last(san, subjectAltName->clone(subjectAltName));
+	}
+	enumerator->destroy(enumerator);
+	public = cert_req->get_public_key(cert_req);
+	if (!public)
+	{
+		error = "extracting public key from request failed";
+		goto end;
+	}
+
+	batch->mutex->lock(batch->mutex);
+	ok = rng_allocate_bytes_not_zero(batch->rng, 8, &serial, FALSE);
+	batch->mutex->unlock(batch->mutex);
+	if (!ok)
+	{
+		error = "failed to generate serial number";
+		goto end;
+	}
+	serial.ptr[0] &= 0x7F;
+
+	cert = lib->creds->create(lib->creds, CRED_CERTIFICATE, CERT_X509,
+					BUILD_SIGNING_KEY, batch->private,
+					BUILD_SIGNING_CERT, batch->ca,
+					BUILD_PUBLIC_KEY, public, BUILD_SUBJECT, id,
+					BUILD_NOT_BEFORE_TIME, batch->not_before,
+					BUILD_NOT_AFTER_TIME, batch->not_after,
+					BUILD_DIGEST_ALG, batch->digest,
+					BUILD_SERIAL, serial,
+					BUILD_SUBJECT_ALTNAMES, san,
+					BUILD_X509_FLAG, batch->flags,
+					BUILD_CRL_DISTRIBUTION_POINTS, batch->cdps,
+					BUILD_OCSP_ACCESS_LOCATIONS, batch->ocsp,
+					BUILD_END);
+	if (!cert)
+	{
+		error = "generating certificate failed";
+		goto end;
+	}
+	if (!cert->get_encoding(cert, batch->form, &encoding))
+	{
+		error = "encoding certificate failed";
+		goto end;
+	}
+	snprintf(path, sizeof(path), "%s/%u.crt", batch->outdir, item->index);
+	file = fopen(path, "wb");
+	if (!file || fwrite(encoding.ptr, encoding.len, 1, file) != 1)
+	{
+		error = "writing certificate failed";
+	}
+	if (file)
+	{
+		fclose(file);
+	}
+
+end:
+	batch->mutex->lock(batch->mutex);
+	if (error)
+	{
+		batch->failed++;
+		fprintf(stderr, "%u %s failed: %s\n", item->index, item->path, error);
+	}
+	else
+	{	/* index line mapping request to certificate, subject and serial */
+		printf("%u %s %s %Y %#B\n", item->index, item->path, path, id, &serial);
+	}
+	batch->mutex->unlock(batch->mutex);
+
+	DESTROY_IF(cert);
+	DESTROY_IF(cert_req);
+	DESTROY_IF(public);
+	san->destroy_offset(san, offsetof(identification_t, destroy));
+	free(encoding.ptr);
+	free(serial.ptr);
+	return JOB_REQUEUE_NONE;
+}
+
+/**
+ * Issue all PKCS#10 requests found in a directory, reusing the loaded CA
+ * key and signing with a pool of worker jobs
+ */
+static int issue_batch(batch_t *batch, char *indir, u_int jobs)
+{
+	enumerator_t *enumerator;
+	batch_item_t *item;
+	struct stat st;
+	char *abs;
+	u_int index = 0;
+
+	batch->rng = lib->crypto->create_rng(lib->crypto, RNG_WEAK);
+	if (!batch->rng)
+	{
+		fprintf(stderr, "no random number generator found\n");
+		return 1;
+	}
+	enumerator = enumerator_create_directory(indir);
+	if (!enumerator)
+	{
+		fprintf(stderr, "opening '%s' failed: %s\n", indir, strerror(errno));
+		batch->rng->destroy(batch->rng);
+		return 1;
+	}
+	batch->mutex = mutex_create(MUTEX_TYPE_DEFAULT);
+	batch->condvar = condvar_create(CONDVAR_TYPE_DEFAULT);
+
+	lib->processor->set_threads(lib->processor, max(1, jobs));
+
+	while (enumerator->enumerate(enumerator, NULL, &abs, &st))
+	{
+		if (!S_ISREG(st.st_mode))
+		{
+			continue;
+		}
+		INIT(item,
+			.batch = batch,
+			.path = strdup(abs),
+			.index = index++,
+		);
+		batch->mutex->lock(batch->mutex);
+		batch->remaining++;
+		batch->mutex->unlock(batch->mutex);
+		lib->processor->queue_job(lib->processor,
+			(job_t*)callback_job_create((callback_job_cb_t)issue_item, item,
+										(void*)batch_item_destroy, NULL));
+	}
+	enumerator->destroy(enumerator);
+
+	batch->mutex->lock(batch->mutex);
+	while (batch->remaining)
+	{
+		batch->condvar->wait(batch->condvar, batch->mutex);
+	}
+	batch->mutex->unlock(batch->mutex);
+
+	fprintf(stderr, "issued %u certificates, %u failed\n",
+			index - batch->failed, batch->failed);
+
+	batch->condvar->destroy(batch->condvar);
+	batch->mutex->destroy(batch->mutex);
+	batch->rng->destroy(batch->rng);
+	return batch->failed ? 1 : 0;
+}
+
 /**
  * Issue a certificate using a CA certificate and key
  */
@@ -66,7 +307,8 @@ static int issue()
 	public_key_t *public = NULL;
 	bool pkcs10 = FALSE;
 	char *file = NULL, *dn = NULL, *hex = NULL, *cacert = NULL, *cakey = NULL;
-	char *error = NULL, *keyid = NULL;
+	char *error = NULL, *keyid = NULL, *batchdir = NULL, *outdir = ".";
+	u_int jobs = 1;
 	identification_t *id = NULL;
 	linked_list_t *san, *cdps, *ocsp, *permitted, *excluded, *policies, *mappings;
 	int pathlen = X509_NO_CONSTRAINT, inhibit_any = X509_NO_CONSTRAINT;
@@ -116,6 +358,20 @@ static int issue()
 			case 'i':
 				file = arg;
 				continue;
+			case 'B':
+				batchdir = arg;
+				continue;
+			case 'O':
+				outdir = arg;
+				continue;
+			case 'j':
+				jobs = atoi(arg);
+				if (!jobs)
+				{
+					error = "invalid --jobs value";
+					goto usage;
+				}
+				continue;
 			case 'c':
 				cacert = arg;
 				continue;
@@ -372,6 +628,29 @@ static int issue()
 			digest = HASH_SHA512;
 		}
 	}
+
+	if (batchdir)
+	{
+		batch_t batch = {
+			.ca = ca,
+			.private = private,
+			.outdir = outdir,
+			.form = form,
+			.digest = digest,
+			.not_before = not_before,
+			.not_after = not_after,
+			.flags = flags,
+			.cdps = cdps,
+			.ocsp = ocsp,
+		};
+
+		if (issue_batch(&batch, batchdir, jobs))
+		{
+			error = "issuing some certificate requests failed";
+		}
+		goto end;
+	}
+
 	if (hex)
 	{
 		serial = chunk_from_hex(chunk_create(hex, strlen(hex)), NULL);
@@ -561,7 +840,8 @@ static void __attribute__ ((constructor))reg()
 	command_register((command_t) {
 		issue, 'i', "issue",
 		"issue a certificate using a CA certificate and key",
-		{"[--in file] [--type pub|pkcs10] --cakey file|--cakeyid hex",
+		{"[--in file|--batch dir [--outdir dir] [--jobs cnt]]",
+		 "[--type pub|pkcs10] --cakey file|--cakeyid hex",
 		 " --cacert file [--dn subject-dn] [--san subjectAltName]+",
 		 "[--lifetime days] [--serial hex] [--ca] [--pathlen len]",
 		 "[--flag serverAuth|clientAuth|crlSign|ocspSigning|msSmartcardLogon]+",
@@ -573,6 +853,9 @@ static void __attribute__ ((constructor))reg()
 		{
 			{"help",			'h', 0, "show usage information"},
 			{"in",				'i', 1, "public key/request file to issue, default: stdin"},
+			{"batch",			'B', 1, "directory of PKCS#10 requests to issue in batch mode"},
+			{"outdir",			'O', 1, "directory to write batch certificates to, default: ."},
+			{"jobs",			'j', 1, "concurrent signing jobs in batch mode, default: 1"},
 			{"type",			't', 1, "type of input, default: pub"},
 			{"cacert",			'c', 1, "CA certificate file"},
 			{"cakey",			'k', 1, "CA private key file"},
@@ -84,6 +84,56 @@ static u_int create_pool(char *name, chunk_t start, chunk_t end, int timeout)
 	return pool;
 }
 
+/**
+ * number of address rows inserted by a single batched statement
+ */
+#define ADDR_BATCH_SIZE 10
+
+/**
+ * Insert ADDR_BATCH_SIZE addresses with a single multi-row statement. The
+ * UNION ALL form is understood by all drivers, including older SQLite
+ * versions lacking multi-row VALUES support.
+ */
+static bool insert_address_batch(u_int pool_id, chunk_t addr[ADDR_BATCH_SIZE])
+{
+	return db->execute(db, NULL,
+		"INSERT INTO addresses (pool, address, identity, acquired, released) "
+		"SELECT ?, ?, ?, ?, ? UNION ALL SELECT ?, ?, ?, ?, ? "
+		"UNION ALL SELECT ?, ?, ?, ?, ? UNION ALL SELECT ?, ?, ?, ?, ? "
+		"UNION ALL SELECT ?, ?, ?, ?, ? UNION ALL SELECT ?, ?, ?, ?, ? "
+		"UNION ALL SELECT ?, ?, ?, ?, ? UNION ALL SELECT ?, ?, ?, ?, ? "
+		"UNION ALL SELECT ?, ?, ?, ?, ? UNION ALL SELECT ?, ?, ?, ?, ?",
+		DB_UINT, pool_id, DB_BLOB, addr[0], DB_UINT, 0, DB_UINT, 0, DB_UINT, 1,
+		DB_UINT, pool_id, DB_BLOB, addr[1], DB_UINT, 0, DB_UINT, 0, DB_UINT, 1,
+		DB_UINT, pool_id, DB_BLOB, addr[2], DB_UINT, 0, DB_UINT, 0, DB_UINT, 1,
+		DB_UINT, pool_id, DB_BLOB, addr[3], DB_UINT, 0, DB_UINT, 0, DB_UINT, 1,
+		DB_UINT, pool_id, DB_BLOB, addr[4], DB_UINT, 0, DB_UINT, 0, DB_UINT, 1,
+		DB_UINT, pool_id, DB_BLOB, addr[5], DB_UINT, 0, DB_UINT, 0, DB_UINT, 1,
+		DB_UINT, pool_id, DB_BLOB, addr[6], DB_UINT, 0, DB_UINT, 0, DB_UINT, 1,
+		DB_UINT, pool_id, DB_BLOB, addr[7], DB_UINT, 0, DB_UINT, 0, DB_UINT, 1,
+		DB_UINT, pool_id, DB_BLOB, addr[8], DB_UINT, 0, DB_UINT, 0, DB_UINT, 1,
+		DB_UINT, pool_id, DB_BLOB, addr[9], DB_UINT, 0, DB_UINT, 0, DB_UINT, 1)
+			== ADDR_BATCH_SIZE;
+}
+
+/**
+ * Insert a partial batch row by row, also the fallback if a driver rejects
+ * the batched statement
+ */
+static void insert_addresses(u_int pool_id, chunk_t *addr, u_int count)
+{
+	u_int i;
+
+	for (i = 0; i < count; i++)
+	{
+		db->execute(db, NULL,
+			"INSERT INTO addresses (pool, address, identity, acquired, released) "
+			"VALUES (?, ?, ?, ?, ?)",
+			DB_UINT, pool_id, DB_BLOB, addr[i],
+			DB_UINT, 0, DB_UINT, 0, DB_UINT, 1);
+	}
+}
+
 /**
  * instead of a pool handle a DNS or NBNS attribute
  */
@@ -319,7 +369,10 @@ next_pool:
 static void add(char *name, host_t *start, host_t *end, int timeout)
 {
 	chunk_t start_addr, end_addr, cur_addr;
-	u_int id, count;
+	chunk_t batch[ADDR_BATCH_SIZE];
+	u_char bufs[ADDR_BATCH_SIZE][16];
+	u_int id, count, n;
+	bool last = FALSE;
 
 	start_addr = start->get_address(start);
 	end_addr = end->get_address(end);
@@ -336,17 +389,19 @@ static void add(char *name, host_t *start, host_t *end, int timeout)
 	printf("allocating %d addresses... ", count);
 	fflush(stdout);
 	db->transaction(db, FALSE);
-	while (TRUE)
+	while (!last)
 	{
-		db->execute(db, NULL,
-			"INSERT INTO addresses (pool, address, identity, acquired, released) "
-			"VALUES (?, ?, ?, ?, ?)",
-			DB_UINT, id, DB_BLOB, cur_addr,	DB_UINT, 0, DB_UINT, 0, DB_UINT, 1);
-		if (chunk_equals(cur_addr, end_addr))
+		for (n = 0; n < ADDR_BATCH_SIZE && !last; n++)
 		{
-			break;
+			memcpy(bufs[n], cur_addr.ptr, cur_addr.len);
+			batch[n] = chunk_create(bufs[n], cur_addr.len);
+			last = chunk_equals(cur_addr, end_addr);
+			chunk_increment(cur_addr);
+		}
+		if (n < ADDR_BATCH_SIZE || !insert_address_batch(id, batch))
+		{
+			insert_addresses(id, batch, n);
 		}
-		chunk_increment(cur_addr);
 	}
 	db->commit(db);
 	printf("done.\n");
@@ -525,7 +580,9 @@ static void resize(char *name, host_t *end)
 {
 	enumerator_t *query;
 	chunk_t old_addr, new_addr, cur_addr;
-	u_int id, count;
+	chunk_t batch[ADDR_BATCH_SIZE];
+	u_char bufs[ADDR_BATCH_SIZE][16];
+	u_int id, count, n;
 	host_t *old_end;
 
 	new_addr = end->get_address(end);
@@ -570,13 +627,18 @@ static void resize(char *name, host_t *end)
 
 	printf("allocating %d new addresses... ", count);
 	fflush(stdout);
-	while (count-- > 0)
+	while (count)
 	{
-		chunk_increment(cur_addr);
-		db->execute(db, NULL,
-			"INSERT INTO addresses (pool, address, identity, acquired, released) "
-			"VALUES (?, ?, ?, ?, ?)",
-			DB_UINT, id, DB_BLOB, cur_addr,	DB_UINT, 0, DB_UINT, 0, DB_UINT, 1);
+		for (n = 0; n < ADDR_BATCH_SIZE && count; n++, count--)
+		{
+			chunk_increment(cur_addr);
+			memcpy(bufs[n], cur_addr.ptr, cur_addr.len);
+			batch[n] = chunk_create(bufs[n], cur_addr.len);
+		}
+		if (n < ADDR_BATCH_SIZE || !insert_address_batch(id, batch))
+		{
+			insert_addresses(id, batch, n);
+		}
 	}
 	db->commit(db);
 	printf("done.\n");
@@ -373,7 +373,6 @@ bool scep_http_request(const char *url, chunk_t msg, scep_op_t op,
 			free(escaped_req);
 
 			status = lib->fetcher->fetch(lib->fetcher, complete_url, response,
-										 FETCH_HTTP_VERSION_1_0,
 										 FETCH_TIMEOUT, timeout,
 										 FETCH_REQUEST_HEADER, "Pragma:",
 										 FETCH_REQUEST_HEADER, "Host:",
@@ -389,7 +388,6 @@ bool scep_http_request(const char *url, chunk_t msg, scep_op_t op,
 			snprintf(complete_url, len, "%s?operation=%s", url, operation);
 
 			status = lib->fetcher->fetch(lib->fetcher, complete_url, response,
-										 FETCH_HTTP_VERSION_1_0,
 										 FETCH_TIMEOUT, timeout,
 										 FETCH_REQUEST_DATA, msg,
 										 FETCH_REQUEST_TYPE, "",
@@ -419,7 +417,6 @@ bool scep_http_request(const char *url, chunk_t msg, scep_op_t op,
 				 url, operation, (int)msg.len, msg.ptr);
 
 		status = lib->fetcher->fetch(lib->fetcher, complete_url, response,
-									 FETCH_HTTP_VERSION_1_0,
 									 FETCH_TIMEOUT, timeout,
 									 FETCH_SOURCEIP, srcip,
 									 FETCH_END);
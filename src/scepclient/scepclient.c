@@ -385,7 +385,7 @@ static void usage(const char *message)
 		"Options for enrollment (cert):\n"
 		" --url (-u) <url>                  url of the SCEP server\n"
 		" --method (-m) post | get          http request type\n"
-		" --interval (-t) <seconds>         poll interval in seconds (default 20s)\n"
+		" --interval (-t) <seconds>         max poll interval in seconds (default 20s)\n"
 		" --maxpolltime (-x) <seconds>      max poll time in seconds when in manual mode\n"
 		"                                   (default: unlimited)\n"
 		"\n"
@@ -1328,6 +1328,7 @@ int main(int argc, char **argv)
 		enumerator_t  *enumerator;
 		char path[PATH_MAX];
 		time_t poll_start = 0;
+		u_int poll_delay = 0;
 		pkcs7_t *p7;
 		container_t *container = NULL;
 		chunk_t chunk;
@@ -1360,8 +1361,10 @@ int main(int argc, char **argv)
 		{
 			identification_t *issuer = x509_ca_sig->get_subject(x509_ca_sig);
 
-			DBG1(DBG_APP, "  scep request pending, polling every %d seconds",
-				 poll_interval);
+			DBG1(DBG_APP, "  scep request pending, polling up to every %d "
+				 "seconds", poll_interval);
+			/* poll quickly at first, backing off to the configured interval */
+			poll_delay = min(poll_interval, 2);
 			poll_start = time_monotonic(NULL);
 			issuerAndSubject = asn1_wrap(ASN1_SEQUENCE, "cc",
 									issuer->get_encoding(issuer),
@@ -1375,8 +1378,9 @@ int main(int argc, char **argv)
 				exit_scepclient("maximum poll time reached: %d seconds"
 							   , max_poll_time);
 			}
-			DBG2(DBG_APP, "going to sleep for %d seconds", poll_interval);
-			sleep(poll_interval);
+			DBG2(DBG_APP, "going to sleep for %d seconds", poll_delay);
+			sleep(poll_delay);
+			poll_delay = min(poll_delay * 2, poll_interval);
 			free(scep_response.ptr);
 			container->destroy(container);
 
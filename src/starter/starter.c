@@ -37,6 +37,7 @@
 #include <utils/backtrace.h>
 #include <threading/thread.h>
 #include <utils/debug.h>
+#include <collections/hashtable.h>
 
 #include "confread.h"
 #include "files.h"
@@ -752,25 +753,35 @@ int main (int argc, char **argv)
 
 			if (new_cfg && (new_cfg->err == 0))
 			{
+				hashtable_t *table;
+
 				/* Switch to new config. New conn will be loaded below */
 
+				/* index new sections by name, as comparing each old against
+				 * each new section does not scale to many connections */
+				table = hashtable_create(hashtable_hash_str,
+										 hashtable_equals_str, 64);
+				for (conn2 = new_cfg->conn_first; conn2; conn2 = conn2->next)
+				{
+					table->put(table, conn2->name, conn2);
+				}
+
 				/* Look for new connections that are already loaded */
 				for (conn = cfg->conn_first; conn; conn = conn->next)
 				{
 					if (conn->state == STATE_ADDED)
 					{
-						for (conn2 = new_cfg->conn_first; conn2; conn2 = conn2->next)
+						conn2 = table->get(table, conn->name);
+						if (conn2 && conn2->state == STATE_TO_ADD &&
+							starter_cmp_conn(conn, conn2))
 						{
-							if (conn2->state == STATE_TO_ADD && starter_cmp_conn(conn, conn2))
-							{
-								conn->state = STATE_REPLACED;
-								conn2->state = STATE_ADDED;
-								conn2->id = conn->id;
-								break;
-							}
+							conn->state = STATE_REPLACED;
+							conn2->state = STATE_ADDED;
+							conn2->id = conn->id;
 						}
 					}
 				}
+				table->destroy(table);
 
 				/* Remove conn sections that have become unused */
 				for (conn = cfg->conn_first; conn; conn = conn->next)
@@ -789,21 +800,26 @@ int main (int argc, char **argv)
 				}
 
 				/* Look for new ca sections that are already loaded */
+				table = hashtable_create(hashtable_hash_str,
+										 hashtable_equals_str, 8);
+				for (ca2 = new_cfg->ca_first; ca2; ca2 = ca2->next)
+				{
+					table->put(table, ca2->name, ca2);
+				}
 				for (ca = cfg->ca_first; ca; ca = ca->next)
 				{
 					if (ca->state == STATE_ADDED)
 					{
-						for (ca2 = new_cfg->ca_first; ca2; ca2 = ca2->next)
+						ca2 = table->get(table, ca->name);
+						if (ca2 && ca2->state == STATE_TO_ADD &&
+							starter_cmp_ca(ca, ca2))
 						{
-							if (ca2->state == STATE_TO_ADD && starter_cmp_ca(ca, ca2))
-							{
-								ca->state = STATE_REPLACED;
-								ca2->state = STATE_ADDED;
-								break;
-							}
+							ca->state = STATE_REPLACED;
+							ca2->state = STATE_ADDED;
 						}
 					}
 				}
+				table->destroy(table);
 
 				/* Remove ca sections that have become unused */
 				for (ca = cfg->ca_first; ca; ca = ca->next)
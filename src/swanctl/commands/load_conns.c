@@ -21,6 +21,7 @@
 #include "command.h"
 #include "swanctl.h"
 #include "load_conns.h"
+#include "../pipeline.h"
 
 /**
  * Check if we should handle a key as a list of comma separated values
@@ -206,15 +207,12 @@ static bool add_sections(vici_req_t *req, settings_t *cfg, char *section)
 }
 
 /**
- * Load an IKE_SA config with CHILD_SA configs from a section
+ * Queue loading an IKE_SA config with CHILD_SA configs from a section
  */
-static bool load_conn(vici_conn_t *conn, settings_t *cfg,
-					  char *section, command_format_options_t format)
+static bool load_conn(pipeline_t *pipeline, settings_t *cfg, char *section)
 {
 	vici_req_t *req;
-	vici_res_t *res;
-	bool ret = TRUE;
-	char buf[128];
+	char buf[128], success[256], failure[256];
 
 	snprintf(buf, sizeof(buf), "%s.%s", "connections", section);
 
@@ -229,29 +227,10 @@ static bool load_conn(vici_conn_t *conn, settings_t *cfg,
 	}
 	vici_end_section(req);
 
-	res = vici_submit(req, conn);
-	if (!res)
-	{
-		fprintf(stderr, "load-conn request failed: %s\n", strerror(errno));
-		return FALSE;
-	}
-	if (format & COMMAND_FORMAT_RAW)
-	{
-		vici_dump(res, "load-conn reply", format & COMMAND_FORMAT_PRETTY,
-				  stdout);
-	}
-	else if (!streq(vici_find_str(res, "no", "success"), "yes"))
-	{
-		fprintf(stderr, "loading connection '%s' failed: %s\n",
-				section, vici_find_str(res, "", "errmsg"));
-		ret = FALSE;
-	}
-	else
-	{
-		printf("loaded connection '%s'\n", section);
-	}
-	vici_free_res(res);
-	return ret;
+	snprintf(success, sizeof(success), "loaded connection '%s'", section);
+	snprintf(failure, sizeof(failure), "loading connection '%s'", section);
+	pipeline->queue(pipeline, req, "load-conn", success, failure);
+	return TRUE;
 }
 
 CALLBACK(list_conn, int,
@@ -315,36 +294,17 @@ static void remove_from_list(linked_list_t *list, char *str)
 }
 
 /**
- * Unload a connection by name
+ * Queue unloading a connection by name
  */
-static bool unload_conn(vici_conn_t *conn, char *name,
-					    command_format_options_t format)
+static void unload_conn(pipeline_t *pipeline, char *name)
 {
 	vici_req_t *req;
-	vici_res_t *res;
-	bool ret = TRUE;
+	char failure[256];
 
 	req = vici_begin("unload-conn");
 	vici_add_key_valuef(req, "name", "%s", name);
-	res = vici_submit(req, conn);
-	if (!res)
-	{
-		fprintf(stderr, "unload-conn request failed: %s\n", strerror(errno));
-		return FALSE;
-	}
-	if (format & COMMAND_FORMAT_RAW)
-	{
-		vici_dump(res, "unload-conn reply", format & COMMAND_FORMAT_PRETTY,
-				  stdout);
-	}
-	else if (!streq(vici_find_str(res, "no", "success"), "yes"))
-	{
-		fprintf(stderr, "unloading connection '%s' failed: %s\n",
-				name, vici_find_str(res, "", "errmsg"));
-		ret = FALSE;
-	}
-	vici_free_res(res);
-	return ret;
+	snprintf(failure, sizeof(failure), "unloading connection '%s'", name);
+	pipeline->queue(pipeline, req, "unload-conn", NULL, failure);
 }
 
 /**
@@ -353,36 +313,42 @@ static bool unload_conn(vici_conn_t *conn, char *name,
 int load_conns_cfg(vici_conn_t *conn, command_format_options_t format,
 				   settings_t *cfg)
 {
-	u_int found = 0, loaded = 0, unloaded = 0;
+	u_int found = 0, loaded = 0, unloaded = 0, failed = 0;
 	char *section;
 	enumerator_t *enumerator;
 	linked_list_t *conns;
+	pipeline_t *pipeline;
 
 	conns = list_conns(conn, format);
 
+	pipeline = pipeline_create(conn, format);
+
 	enumerator = cfg->create_section_enumerator(cfg, "connections");
 	while (enumerator->enumerate(enumerator, &section))
 	{
 		remove_from_list(conns, section);
 		found++;
-		if (load_conn(conn, cfg, section, format))
+		if (!load_conn(pipeline, cfg, section))
 		{
-			loaded++;
+			failed++;
 		}
 	}
 	enumerator->destroy(enumerator);
 
+	loaded = found - failed - pipeline->finish(pipeline);
+
 	/* unload all connection in daemon, but not in file */
 	while (conns->remove_first(conns, (void**)&section) == SUCCESS)
 	{
-		if (unload_conn(conn, section, format))
-		{
-			unloaded++;
-		}
+		unload_conn(pipeline, section);
+		unloaded++;
 		free(section);
 	}
 	conns->destroy(conns);
 
+	unloaded -= pipeline->finish(pipeline);
+	pipeline->destroy(pipeline);
+
 	if (format & COMMAND_FORMAT_RAW)
 	{
 		return 0;
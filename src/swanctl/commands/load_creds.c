@@ -22,56 +22,44 @@
 #include "command.h"
 #include "swanctl.h"
 #include "load_creds.h"
+#include "../pipeline.h"
 
 #include <credentials/sets/mem_cred.h>
 #include <credentials/sets/callback_cred.h>
 #include <credentials/containers/pkcs12.h>
+#include <collections/array.h>
+#include <threading/thread.h>
+#include <threading/mutex.h>
 
 /**
- * Load a single certificate over vici
+ * Number of threads used to parse credential files
  */
-static bool load_cert(vici_conn_t *conn, command_format_options_t format,
-					  char *dir, char *type, chunk_t data)
+#define PARSE_THREADS 4
+
+/**
+ * Queue loading a single certificate over vici
+ */
+static bool load_cert(pipeline_t *pipeline, char *dir, char *type,
+					  chunk_t data)
 {
 	vici_req_t *req;
-	vici_res_t *res;
-	bool ret = TRUE;
+	char success[512], failure[512];
 
 	req = vici_begin("load-cert");
 
 	vici_add_key_valuef(req, "type", "%s", type);
 	vici_add_key_value(req, "data", data.ptr, data.len);
 
-	res = vici_submit(req, conn);
-	if (!res)
-	{
-		fprintf(stderr, "load-cert request failed: %s\n", strerror(errno));
-		return FALSE;
-	}
-	if (format & COMMAND_FORMAT_RAW)
-	{
-		vici_dump(res, "load-cert reply", format & COMMAND_FORMAT_PRETTY,
-				  stdout);
-	}
-	else if (!streq(vici_find_str(res, "no", "success"), "yes"))
-	{
-		fprintf(stderr, "loading '%s' failed: %s\n",
-				dir, vici_find_str(res, "", "errmsg"));
-		ret = FALSE;
-	}
-	else
-	{
-		printf("loaded %s certificate from '%s'\n", type, dir);
-	}
-	vici_free_res(res);
-	return ret;
+	snprintf(success, sizeof(success), "loaded %s certificate from '%s'",
+			 type, dir);
+	snprintf(failure, sizeof(failure), "loading '%s'", dir);
+	return pipeline->queue(pipeline, req, "load-cert", success, failure);
 }
 
 /**
  * Load certficiates from a directory
  */
-static void load_certs(vici_conn_t *conn, command_format_options_t format,
-					   char *type, char *dir)
+static void load_certs(pipeline_t *pipeline, char *type, char *dir)
 {
 	enumerator_t *enumerator;
 	struct stat st;
@@ -88,7 +76,7 @@ static void load_certs(vici_conn_t *conn, command_format_options_t format,
 				map = chunk_map(path, FALSE);
 				if (map)
 				{
-					load_cert(conn, format, path, type, *map);
+					load_cert(pipeline, path, type, *map);
 					chunk_unmap(map);
 				}
 				else
@@ -103,14 +91,12 @@ static void load_certs(vici_conn_t *conn, command_format_options_t format,
 }
 
 /**
- * Load a single private key over vici
+ * Queue loading a single private key over vici
  */
-static bool load_key(vici_conn_t *conn, command_format_options_t format,
-					 char *dir, char *type, chunk_t data)
+static bool load_key(pipeline_t *pipeline, char *dir, char *type, chunk_t data)
 {
 	vici_req_t *req;
-	vici_res_t *res;
-	bool ret = TRUE;
+	char success[512], failure[512];
 
 	req = vici_begin("load-key");
 
@@ -124,36 +110,16 @@ static bool load_key(vici_conn_t *conn, command_format_options_t format,
 	}
 	vici_add_key_value(req, "data", data.ptr, data.len);
 
-	res = vici_submit(req, conn);
-	if (!res)
-	{
-		fprintf(stderr, "load-key request failed: %s\n", strerror(errno));
-		return FALSE;
-	}
-	if (format & COMMAND_FORMAT_RAW)
-	{
-		vici_dump(res, "load-key reply", format & COMMAND_FORMAT_PRETTY,
-				  stdout);
-	}
-	else if (!streq(vici_find_str(res, "no", "success"), "yes"))
-	{
-		fprintf(stderr, "loading '%s' failed: %s\n",
-				dir, vici_find_str(res, "", "errmsg"));
-		ret = FALSE;
-	}
-	else
-	{
-		printf("loaded %s key from '%s'\n", type, dir);
-	}
-	vici_free_res(res);
-	return ret;
+	snprintf(success, sizeof(success), "loaded %s key from '%s'", type, dir);
+	snprintf(failure, sizeof(failure), "loading '%s'", dir);
+	return pipeline->queue(pipeline, req, "load-key", success, failure);
 }
 
 /**
- * Load a private key of any type to vici
+ * Queue loading a private key of any type to vici
  */
-static bool load_key_anytype(vici_conn_t *conn, command_format_options_t format,
-							 char *path, private_key_t *private)
+static bool load_key_anytype(pipeline_t *pipeline, char *path,
+							 private_key_t *private)
 {
 	bool loaded = FALSE;
 	chunk_t encoding;
@@ -166,10 +132,10 @@ static bool load_key_anytype(vici_conn_t *conn, command_format_options_t format,
 	switch (private->get_type(private))
 	{
 		case KEY_RSA:
-			loaded = load_key(conn, format, path, "rsa", encoding);
+			loaded = load_key(pipeline, path, "rsa", encoding);
 			break;
 		case KEY_ECDSA:
-			loaded = load_key(conn, format, path, "ecdsa", encoding);
+			loaded = load_key(pipeline, path, "ecdsa", encoding);
 			break;
 		default:
 			fprintf(stderr, "unsupported key type in '%s'\n", path);
@@ -359,73 +325,163 @@ static void* decrypt_with_config(settings_t *cfg, char *name, char *type,
 }
 
 /**
- * Try to decrypt and load a private key
+ * A private key file collected for parsing
  */
-static bool load_encrypted_key(vici_conn_t *conn,
-							   command_format_options_t format, settings_t *cfg,
-							   char *rel, char *path, char *type, bool noprompt,
-							   chunk_t data)
-{
+typedef struct {
+	/** path to the key file */
+	char *path;
+	/** path relative to the credential directory */
+	char *rel;
+	/** mapped file content */
+	chunk_t *map;
+	/** parsed (and decrypted) private key, if successful */
 	private_key_t *private;
-	bool loaded = FALSE;
+} key_entry_t;
 
-	private = decrypt_with_config(cfg, rel, type, data);
-	if (!private && !noprompt)
-	{
-		private = decrypt(rel, type, data);
-	}
-	if (private)
+/**
+ * State shared between key parsing threads
+ */
+typedef struct {
+	/** lock protecting the position counter */
+	mutex_t *mutex;
+	/** key files to parse */
+	array_t *keys;
+	/** position of next entry to parse */
+	int pos;
+	/** swanctl configuration */
+	settings_t *cfg;
+	/** type of the parsed keys */
+	char *type;
+	/** TRUE if no password prompting is allowed */
+	bool noprompt;
+} parse_data_t;
+
+/**
+ * Thread function parsing queued key files until none are left
+ */
+static void* parse_keys(parse_data_t *data)
+{
+	credential_type_t credtype;
+	key_entry_t *entry;
+	int subtype;
+
+	while (TRUE)
 	{
-		loaded = load_key_anytype(conn, format, path, private);
-		private->destroy(private);
+		data->mutex->lock(data->mutex);
+		if (data->pos >= array_count(data->keys))
+		{
+			data->mutex->unlock(data->mutex);
+			break;
+		}
+		array_get(data->keys, data->pos++, &entry);
+		data->mutex->unlock(data->mutex);
+
+		entry->private = decrypt_with_config(data->cfg, entry->rel,
+											 data->type, *entry->map);
+		if (!entry->private && !data->noprompt &&
+			determine_credtype(data->type, &credtype, &subtype))
+		{	/* try to parse without any password, any file still needing
+			 * a prompt gets handled serially afterwards */
+			entry->private = lib->creds->create(lib->creds, credtype, subtype,
+										BUILD_BLOB_PEM, *entry->map, BUILD_END);
+		}
 	}
-	return loaded;
+	return NULL;
 }
 
 /**
- * Load private keys from a directory
+ * Load private keys from a directory, parsing them in parallel
  */
-static void load_keys(vici_conn_t *conn, command_format_options_t format,
-					  bool noprompt, settings_t *cfg, char *type, char *dir)
+static void load_keys(pipeline_t *pipeline, bool noprompt, settings_t *cfg,
+					  char *type, char *dir)
 {
 	enumerator_t *enumerator;
+	thread_t *threads[PARSE_THREADS];
 	struct stat st;
+	array_t *keys = NULL;
+	key_entry_t *entry;
+	parse_data_t data;
 	chunk_t *map;
 	char *path, *rel;
+	int i, count;
 
 	enumerator = enumerator_create_directory(dir);
-	if (enumerator)
+	if (!enumerator)
 	{
-		while (enumerator->enumerate(enumerator, &rel, &path, &st))
+		return;
+	}
+	while (enumerator->enumerate(enumerator, &rel, &path, &st))
+	{
+		if (S_ISREG(st.st_mode))
 		{
-			if (S_ISREG(st.st_mode))
+			map = chunk_map(path, FALSE);
+			if (map)
 			{
-				map = chunk_map(path, FALSE);
-				if (map)
-				{
-					if (!load_encrypted_key(conn, format, cfg, rel, path, type,
-											noprompt, *map))
-					{
-						load_key(conn, format, path, type, *map);
-					}
-					chunk_unmap(map);
-				}
-				else
-				{
-					fprintf(stderr, "mapping '%s' failed: %s, skipped\n",
-							path, strerror(errno));
-				}
+				INIT(entry,
+					.path = strdup(path),
+					.rel = strdup(rel),
+					.map = map,
+				);
+				array_insert_create(&keys, ARRAY_TAIL, entry);
+			}
+			else
+			{
+				fprintf(stderr, "mapping '%s' failed: %s, skipped\n",
+						path, strerror(errno));
 			}
 		}
-		enumerator->destroy(enumerator);
 	}
+	enumerator->destroy(enumerator);
+
+	data = (parse_data_t){
+		.mutex = mutex_create(MUTEX_TYPE_DEFAULT),
+		.keys = keys,
+		.cfg = cfg,
+		.type = type,
+		.noprompt = noprompt,
+	};
+	count = min(array_count(keys), PARSE_THREADS);
+	for (i = 0; i < count; i++)
+	{
+		threads[i] = thread_create((thread_main_t)parse_keys, &data);
+	}
+	for (i = 0; i < count; i++)
+	{
+		if (threads[i])
+		{
+			threads[i]->join(threads[i]);
+		}
+	}
+	data.mutex->destroy(data.mutex);
+
+	for (i = 0; i < array_count(keys); i++)
+	{
+		array_get(keys, i, &entry);
+		if (!entry->private && !noprompt)
+		{	/* may prompt for a password */
+			entry->private = decrypt(entry->rel, type, *entry->map);
+		}
+		if (entry->private)
+		{
+			load_key_anytype(pipeline, entry->path, entry->private);
+			entry->private->destroy(entry->private);
+		}
+		else
+		{
+			load_key(pipeline, entry->path, type, *entry->map);
+		}
+		chunk_unmap(entry->map);
+		free(entry->path);
+		free(entry->rel);
+		free(entry);
+	}
+	array_destroy(keys);
 }
 
 /**
- * Load credentials from a PKCS#12 container over vici
+ * Queue loading credentials from a PKCS#12 container over vici
  */
-static bool load_pkcs12(vici_conn_t *conn, command_format_options_t format,
-						char *path, pkcs12_t *p12)
+static bool load_pkcs12(pipeline_t *pipeline, char *path, pkcs12_t *p12)
 {
 	enumerator_t *enumerator;
 	certificate_t *cert;
@@ -434,21 +490,20 @@ static bool load_pkcs12(vici_conn_t *conn, command_format_options_t format,
 	bool loaded = TRUE;
 
 	enumerator = p12->create_cert_enumerator(p12);
-	while (loaded && enumerator->enumerate(enumerator, &cert))
+	while (enumerator->enumerate(enumerator, &cert))
 	{
-		loaded = FALSE;
 		if (cert->get_encoding(cert, CERT_ASN1_DER, &encoding))
 		{
-			loaded = load_cert(conn, format, path, "x509", encoding);
-			if (loaded)
+			if (!load_cert(pipeline, path, "x509", encoding))
 			{
-				fprintf(stderr, "  %Y\n", cert->get_subject(cert));
+				loaded = FALSE;
 			}
 			free(encoding.ptr);
 		}
 		else
 		{
 			fprintf(stderr, "encoding certificate from '%s' failed\n", path);
+			loaded = FALSE;
 		}
 	}
 	enumerator->destroy(enumerator);
@@ -456,7 +511,7 @@ static bool load_pkcs12(vici_conn_t *conn, command_format_options_t format,
 	enumerator = p12->create_key_enumerator(p12);
 	while (loaded && enumerator->enumerate(enumerator, &private))
 	{
-		loaded = load_key_anytype(conn, format, path, private);
+		loaded = load_key_anytype(pipeline, path, private);
 	}
 	enumerator->destroy(enumerator);
 
@@ -466,9 +521,9 @@ static bool load_pkcs12(vici_conn_t *conn, command_format_options_t format,
 /**
  * Try to decrypt and load credentials from a container
  */
-static bool load_encrypted_container(vici_conn_t *conn,
-					command_format_options_t format, settings_t *cfg, char *rel,
-					char *path, char *type, bool noprompt, chunk_t data)
+static bool load_encrypted_container(pipeline_t *pipeline, settings_t *cfg,
+						char *rel, char *path, char *type, bool noprompt,
+						chunk_t data)
 {
 	container_t *container;
 	bool loaded = FALSE;
@@ -483,7 +538,7 @@ static bool load_encrypted_container(vici_conn_t *conn,
 		switch (container->get_type(container))
 		{
 			case CONTAINER_PKCS12:
-				loaded = load_pkcs12(conn, format, path, (pkcs12_t*)container);
+				loaded = load_pkcs12(pipeline, path, (pkcs12_t*)container);
 				break;
 			default:
 				break;
@@ -496,8 +551,8 @@ static bool load_encrypted_container(vici_conn_t *conn,
 /**
  * Load credential containers from a directory
  */
-static void load_containers(vici_conn_t *conn, command_format_options_t format,
-						bool noprompt, settings_t *cfg, char *type, char *dir)
+static void load_containers(pipeline_t *pipeline, bool noprompt,
+							settings_t *cfg, char *type, char *dir)
 {
 	enumerator_t *enumerator;
 	struct stat st;
@@ -514,7 +569,7 @@ static void load_containers(vici_conn_t *conn, command_format_options_t format,
 				map = chunk_map(path, FALSE);
 				if (map)
 				{
-					load_encrypted_container(conn, format, cfg, rel, path,
+					load_encrypted_container(pipeline, cfg, rel, path,
 											 type, noprompt, *map);
 					chunk_unmap(map);
 				}
@@ -530,17 +585,14 @@ static void load_containers(vici_conn_t *conn, command_format_options_t format,
 }
 
 /**
- * Load a single secret over VICI
+ * Queue loading a single secret over VICI
  */
-static bool load_secret(vici_conn_t *conn, settings_t *cfg,
-						char *section, command_format_options_t format)
+static bool load_secret(pipeline_t *pipeline, settings_t *cfg, char *section)
 {
 	enumerator_t *enumerator;
 	vici_req_t *req;
-	vici_res_t *res;
 	chunk_t data;
-	char *key, *value, buf[128], *type = NULL;
-	bool ret = TRUE;
+	char *key, *value, buf[128], success[512], *type = NULL;
 	int i;
 	char *types[] = {
 		"eap",
@@ -608,29 +660,9 @@ static bool load_secret(vici_conn_t *conn, settings_t *cfg,
 	enumerator->destroy(enumerator);
 	vici_end_list(req);
 
-	res = vici_submit(req, conn);
-	if (!res)
-	{
-		fprintf(stderr, "load-shared request failed: %s\n", strerror(errno));
-		return FALSE;
-	}
-	if (format & COMMAND_FORMAT_RAW)
-	{
-		vici_dump(res, "load-shared reply", format & COMMAND_FORMAT_PRETTY,
-				  stdout);
-	}
-	else if (!streq(vici_find_str(res, "no", "success"), "yes"))
-	{
-		fprintf(stderr, "loading shared secret failed: %s\n",
-				vici_find_str(res, "", "errmsg"));
-		ret = FALSE;
-	}
-	else
-	{
-		printf("loaded %s secret '%s'\n", type, section);
-	}
-	vici_free_res(res);
-	return ret;
+	snprintf(success, sizeof(success), "loaded %s secret '%s'", type, section);
+	return pipeline->queue(pipeline, req, "load-shared", success,
+						   "loading shared secret");
 }
 
 /**
@@ -662,6 +694,7 @@ int load_creds_cfg(vici_conn_t *conn, command_format_options_t format,
 				   settings_t *cfg, bool clear, bool noprompt)
 {
 	enumerator_t *enumerator;
+	pipeline_t *pipeline;
 	char *section;
 
 	if (clear)
@@ -672,25 +705,29 @@ int load_creds_cfg(vici_conn_t *conn, command_format_options_t format,
 		}
 	}
 
-	load_certs(conn, format, "x509", SWANCTL_X509DIR);
-	load_certs(conn, format, "x509ca", SWANCTL_X509CADIR);
-	load_certs(conn, format, "x509aa", SWANCTL_X509AADIR);
-	load_certs(conn, format, "x509crl", SWANCTL_X509CRLDIR);
-	load_certs(conn, format, "x509ac", SWANCTL_X509ACDIR);
+	pipeline = pipeline_create(conn, format);
+
+	load_certs(pipeline, "x509", SWANCTL_X509DIR);
+	load_certs(pipeline, "x509ca", SWANCTL_X509CADIR);
+	load_certs(pipeline, "x509aa", SWANCTL_X509AADIR);
+	load_certs(pipeline, "x509crl", SWANCTL_X509CRLDIR);
+	load_certs(pipeline, "x509ac", SWANCTL_X509ACDIR);
 
-	load_keys(conn, format, noprompt, cfg, "rsa", SWANCTL_RSADIR);
-	load_keys(conn, format, noprompt, cfg, "ecdsa", SWANCTL_ECDSADIR);
-	load_keys(conn, format, noprompt, cfg, "pkcs8", SWANCTL_PKCS8DIR);
+	load_keys(pipeline, noprompt, cfg, "rsa", SWANCTL_RSADIR);
+	load_keys(pipeline, noprompt, cfg, "ecdsa", SWANCTL_ECDSADIR);
+	load_keys(pipeline, noprompt, cfg, "pkcs8", SWANCTL_PKCS8DIR);
 
-	load_containers(conn, format, noprompt, cfg, "pkcs12", SWANCTL_PKCS12DIR);
+	load_containers(pipeline, noprompt, cfg, "pkcs12", SWANCTL_PKCS12DIR);
 
 	enumerator = cfg->create_section_enumerator(cfg, "secrets");
 	while (enumerator->enumerate(enumerator, &section))
 	{
-		load_secret(conn, cfg, section, format);
+		load_secret(pipeline, cfg, section);
 	}
 	enumerator->destroy(enumerator);
 
+	pipeline->destroy(pipeline);
+
 	return 0;
 }
 
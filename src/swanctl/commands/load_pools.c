@@ -21,6 +21,7 @@
 #include "command.h"
 #include "swanctl.h"
 #include "load_pools.h"
+#include "../pipeline.h"
 
 /**
  * Add a vici list from a comma separated string value
@@ -65,15 +66,12 @@ static void add_key_values(vici_req_t *req, settings_t *cfg, char *section)
 }
 
 /**
- * Load a pool configuration
+ * Queue loading a pool configuration
  */
-static bool load_pool(vici_conn_t *conn, settings_t *cfg,
-					  char *section, command_format_options_t format)
+static void load_pool(pipeline_t *pipeline, settings_t *cfg, char *section)
 {
 	vici_req_t *req;
-	vici_res_t *res;
-	bool ret = TRUE;
-	char buf[128];
+	char buf[128], success[256], failure[256];
 
 	snprintf(buf, sizeof(buf), "%s.%s", "pools", section);
 
@@ -83,29 +81,9 @@ static bool load_pool(vici_conn_t *conn, settings_t *cfg,
 	add_key_values(req, cfg, buf);
 	vici_end_section(req);
 
-	res = vici_submit(req, conn);
-	if (!res)
-	{
-		fprintf(stderr, "load-pool request failed: %s\n", strerror(errno));
-		return FALSE;
-	}
-	if (format & COMMAND_FORMAT_RAW)
-	{
-		vici_dump(res, "load-pool reply", format & COMMAND_FORMAT_PRETTY,
-				  stdout);
-	}
-	else if (!streq(vici_find_str(res, "no", "success"), "yes"))
-	{
-		fprintf(stderr, "loading pool '%s' failed: %s\n",
-				section, vici_find_str(res, "", "errmsg"));
-		ret = FALSE;
-	}
-	else
-	{
-		printf("loaded pool '%s'\n", section);
-	}
-	vici_free_res(res);
-	return ret;
+	snprintf(success, sizeof(success), "loaded pool '%s'", section);
+	snprintf(failure, sizeof(failure), "loading pool '%s'", section);
+	pipeline->queue(pipeline, req, "load-pool", success, failure);
 }
 
 CALLBACK(list_pool, int,
@@ -161,36 +139,17 @@ static void remove_from_list(linked_list_t *list, char *str)
 }
 
 /**
- * Unload a pool by name
+ * Queue unloading a pool by name
  */
-static bool unload_pool(vici_conn_t *conn, char *name,
-						command_format_options_t format)
+static void unload_pool(pipeline_t *pipeline, char *name)
 {
 	vici_req_t *req;
-	vici_res_t *res;
-	bool ret = TRUE;
+	char failure[256];
 
 	req = vici_begin("unload-pool");
 	vici_add_key_valuef(req, "name", "%s", name);
-	res = vici_submit(req, conn);
-	if (!res)
-	{
-		fprintf(stderr, "unload-pool request failed: %s\n", strerror(errno));
-		return FALSE;
-	}
-	if (format & COMMAND_FORMAT_RAW)
-	{
-		vici_dump(res, "unload-pool reply", format & COMMAND_FORMAT_PRETTY,
-				  stdout);
-	}
-	else if (!streq(vici_find_str(res, "no", "success"), "yes"))
-	{
-		fprintf(stderr, "unloading pool '%s' failed: %s\n",
-				name, vici_find_str(res, "", "errmsg"));
-		ret = FALSE;
-	}
-	vici_free_res(res);
-	return ret;
+	snprintf(failure, sizeof(failure), "unloading pool '%s'", name);
+	pipeline->queue(pipeline, req, "unload-pool", NULL, failure);
 }
 
 /**
@@ -203,32 +162,35 @@ int load_pools_cfg(vici_conn_t *conn, command_format_options_t format,
 	char *section;
 	enumerator_t *enumerator;
 	linked_list_t *pools;
+	pipeline_t *pipeline;
 
 	pools = list_pools(conn, format);
 
+	pipeline = pipeline_create(conn, format);
+
 	enumerator = cfg->create_section_enumerator(cfg, "pools");
 	while (enumerator->enumerate(enumerator, &section))
 	{
 		remove_from_list(pools, section);
 		found++;
-		if (load_pool(conn, cfg, section, format))
-		{
-			loaded++;
-		}
+		load_pool(pipeline, cfg, section);
 	}
 	enumerator->destroy(enumerator);
 
+	loaded = found - pipeline->finish(pipeline);
+
 	/* unload all pools in daemon, but not in file */
 	while (pools->remove_first(pools, (void**)&section) == SUCCESS)
 	{
-		if (unload_pool(conn, section, format))
-		{
-			unloaded++;
-		}
+		unload_pool(pipeline, section);
+		unloaded++;
 		free(section);
 	}
 	pools->destroy(pools);
 
+	unloaded -= pipeline->finish(pipeline);
+	pipeline->destroy(pipeline);
+
 	if (format & COMMAND_FORMAT_RAW)
 	{
 		return 0;
@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Copyright (C) 2015 revosec AG
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <errno.h>
+
+#include "pipeline.h"
+
+#include <collections/linked_list.h>
+
+/**
+ * Maximum number of outstanding requests before collecting responses
+ */
+#define PIPELINE_WINDOW 32
+
+typedef struct private_pipeline_t private_pipeline_t;
+
+/**
+ * Private data of a pipeline_t object.
+ */
+struct private_pipeline_t {
+
+	/**
+	 * Public pipeline_t interface.
+	 */
+	pipeline_t public;
+
+	/**
+	 * Vici connection requests get queued over
+	 */
+	vici_conn_t *conn;
+
+	/**
+	 * Output format options
+	 */
+	command_format_options_t format;
+
+	/**
+	 * Outstanding requests, as queued_t*
+	 */
+	linked_list_t *outstanding;
+
+	/**
+	 * Number of failed requests since create/last finish
+	 */
+	u_int failed;
+};
+
+/**
+ * Context of a queued request, used to report its result
+ */
+typedef struct {
+	/** command name, for error reporting */
+	char command[32];
+	/** message to print on success */
+	char success[512];
+	/** subject to print on failure */
+	char failure[512];
+} queued_t;
+
+/**
+ * Collect and report the response of the oldest outstanding request
+ */
+static void collect_one(private_pipeline_t *this)
+{
+	vici_res_t *res;
+	queued_t *queued;
+	char label[64];
+
+	if (this->outstanding->remove_first(this->outstanding,
+										(void**)&queued) != SUCCESS)
+	{
+		return;
+	}
+	res = vici_collect(this->conn);
+	if (!res)
+	{
+		fprintf(stderr, "%s request failed: %s\n",
+				queued->command, strerror(errno));
+		this->failed++;
+	}
+	else
+	{
+		if (this->format & COMMAND_FORMAT_RAW)
+		{
+			snprintf(label, sizeof(label), "%s reply", queued->command);
+			vici_dump(res, label, this->format & COMMAND_FORMAT_PRETTY, stdout);
+		}
+		else if (!streq(vici_find_str(res, "no", "success"), "yes"))
+		{
+			fprintf(stderr, "%s failed: %s\n",
+					queued->failure, vici_find_str(res, "", "errmsg"));
+			this->failed++;
+		}
+		else if (queued->success[0])
+		{
+			printf("%s\n", queued->success);
+		}
+		vici_free_res(res);
+	}
+	free(queued);
+}
+
+METHOD(pipeline_t, queue_, bool,
+	private_pipeline_t *this, vici_req_t *req, char *command,
+	char *success, char *failure)
+{
+	queued_t *queued;
+
+	while (this->outstanding->get_count(this->outstanding) >= PIPELINE_WINDOW)
+	{
+		collect_one(this);
+	}
+
+	INIT(queued);
+	snprintf(queued->command, sizeof(queued->command), "%s", command);
+	snprintf(queued->success, sizeof(queued->success), "%s", success ?: "");
+	snprintf(queued->failure, sizeof(queued->failure), "%s", failure ?: command);
+
+	if (vici_queue(req, this->conn) != 0)
+	{
+		fprintf(stderr, "%s request failed: %s\n", command, strerror(errno));
+		this->failed++;
+		free(queued);
+		return FALSE;
+	}
+	this->outstanding->insert_last(this->outstanding, queued);
+	return TRUE;
+}
+
+METHOD(pipeline_t, finish, u_int,
+	private_pipeline_t *this)
+{
+	u_int failed;
+
+	while (this->outstanding->get_count(this->outstanding))
+	{
+		collect_one(this);
+	}
+	failed = this->failed;
+	this->failed = 0;
+	return failed;
+}
+
+METHOD(pipeline_t, destroy, void,
+	private_pipeline_t *this)
+{
+	finish(this);
+	this->outstanding->destroy(this->outstanding);
+	free(this);
+}
+
+/**
+ * See header
+ */
+pipeline_t *pipeline_create(vici_conn_t *conn, command_format_options_t format)
+{
+	private_pipeline_t *this;
+
+	INIT(this,
+		.public = {
+			.queue = _queue_,
+			.finish = _finish,
+			.destroy = _destroy,
+		},
+		.conn = conn,
+		.format = format,
+		.outstanding = linked_list_create(),
+	);
+
+	return &this->public;
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2015 Martin Willi
+ * Copyright (C) 2015 revosec AG
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.  See <http://www.fsf.org/copyleft/gpl.txt>.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/**
+ * @defgroup pipeline pipeline
+ * @{ @ingroup swanctl
+ */
+
+#ifndef PIPELINE_H_
+#define PIPELINE_H_
+
+#include "command.h"
+
+typedef struct pipeline_t pipeline_t;
+
+/**
+ * Helper to pipeline vici requests without waiting for each response.
+ *
+ * Requests get queued over the connection, responses are collected and
+ * reported once a window of outstanding requests is exceeded or the
+ * pipeline gets finished. While a pipeline has outstanding requests, no
+ * other request may get submitted synchronously over the same connection.
+ */
+struct pipeline_t {
+
+	/**
+	 * Queue a request, collecting outstanding responses if required.
+	 *
+	 * The success and failure strings get copied and used to report the
+	 * result once the response for this request has been collected.
+	 *
+	 * @param req		request to queue, gets cleaned up
+	 * @param command	command name, for error reporting
+	 * @param success	message to print when the request succeeded
+	 * @param failure	subject to print when the request failed
+	 * @return			TRUE if request queued successfully
+	 */
+	bool (*queue)(pipeline_t *this, vici_req_t *req, char *command,
+				  char *success, char *failure);
+
+	/**
+	 * Collect the responses for all outstanding requests.
+	 *
+	 * @return			number of failed requests since create/last finish
+	 */
+	u_int (*finish)(pipeline_t *this);
+
+	/**
+	 * Destroy a pipeline_t, collecting any outstanding responses.
+	 */
+	void (*destroy)(pipeline_t *this);
+};
+
+/**
+ * Create a pipeline instance over an established vici connection.
+ *
+ * @param conn		vici connection to queue requests over
+ * @param format	output format options for reply dumping
+ * @return			pipeline instance
+ */
+pipeline_t *pipeline_create(vici_conn_t *conn, command_format_options_t format);
+
+#endif /** PIPELINE_H_ @}*/